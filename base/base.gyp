@@ -459,9 +459,13 @@
         'cancelable_callback_unittest.cc',
         'command_line_unittest.cc',
         'containers/adapters_unittest.cc',
+        'containers/flat_hash_map_unittest.cc',
+        'containers/flat_hash_set_unittest.cc',
         'containers/hash_tables_unittest.cc',
+        'containers/intrusive_mru_cache_unittest.cc',
         'containers/linked_list_unittest.cc',
         'containers/mru_cache_unittest.cc',
+        'containers/sharded_mru_cache_unittest.cc',
         'containers/small_map_unittest.cc',
         'containers/stack_container_unittest.cc',
         'cpu_unittest.cc',
@@ -829,6 +833,9 @@
         '../testing/gtest.gyp:gtest',
       ],
       'sources': [
+        'containers/flat_hash_map_perftest.cc',
+        'containers/mru_cache_perftest.cc',
+        'rand_util_perftest.cc',
         'threading/thread_perftest.cc',
         'message_loop/message_pump_perftest.cc',
         'test/run_all_unittests.cc',
@@ -0,0 +1,82 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_CONTAINERS_FLAT_HASH_MAP_H_
+#define BASE_CONTAINERS_FLAT_HASH_MAP_H_
+
+#include <utility>
+
+#include "base/containers/flat_hash_table.h"
+
+namespace base {
+
+// FlatHashMap is a hash map that stores its elements inline in a single open
+// addressing table instead of allocating a node per element like
+// base::hash_map does. See flat_hash_table.h for how the table works.
+//
+// WHEN TO USE IT
+// --------------
+//
+// Prefer FlatHashMap over base::hash_map for large, hot tables with small
+// keys and values, where node allocations and pointer chasing dominate. The
+// interface is a subset of std::unordered_map's with these differences:
+//
+//  - Inserting an element may move all other elements in memory, and
+//    invalidates all iterators, pointers and references into the map.
+//  - Erasing an element only invalidates iterators to that element, so
+//    erase(it++) works while iterating. erase(iterator) returns nothing.
+//  - Values must be copy constructible, since rehashing copies them.
+//
+// Maps with std::string keys accept StringPiece (or const char*) in find(),
+// count() and erase() without building a temporary std::string. Any other
+// hasher and equality functor pair that both declare |is_transparent| gets
+// the same heterogeneous lookup.
+//
+// USAGE
+// -----
+//
+//   base::FlatHashMap<uint64, EntryMetadata> entries;
+//   entries.insert(std::make_pair(hash, metadata));
+//   base::FlatHashMap<uint64, EntryMetadata>::iterator it =
+//       entries.find(hash);
+//   if (it != entries.end())
+//     it->second.SetLastUsedTime(now);
+template <typename Key,
+          typename Value,
+          typename Hash = typename internal::FlatHashDefaults<Key>::Hash,
+          typename Equal = typename internal::FlatHashDefaults<Key>::Equal>
+class FlatHashMap
+    : public internal::FlatHashTable<internal::FlatHashMapPolicy<Key, Value>,
+                                     Hash,
+                                     Equal> {
+ private:
+  typedef internal::FlatHashTable<internal::FlatHashMapPolicy<Key, Value>,
+                                  Hash,
+                                  Equal> Table;
+
+ public:
+  typedef Value mapped_type;
+  typedef typename Table::key_type key_type;
+  typedef typename Table::value_type value_type;
+  typedef typename Table::iterator iterator;
+  typedef typename Table::const_iterator const_iterator;
+
+  FlatHashMap() {}
+
+  // Returns a reference to the value mapped to |key|, inserting a
+  // default-constructed value first if there is none.
+  Value& operator[](const key_type& key) {
+    size_t hash = this->HashOf(key);
+    iterator it = this->FindWithHash(key, hash);
+    if (it != this->end())
+      return it->second;
+    size_t i = this->PrepareInsert(hash);
+    value_type* slot = new (this->slot(i)) value_type(key, Value());
+    return slot->second;
+  }
+};
+
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_FLAT_HASH_MAP_H_
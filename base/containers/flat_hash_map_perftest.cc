@@ -0,0 +1,104 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/flat_hash_map.h"
+#include "base/containers/hash_tables.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_time_logger.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const size_t kNumEntries = 1000000;
+
+// Returns |count| distinct pseudo-random keys.
+std::vector<uint64> MakeKeys(size_t count, uint64 seed) {
+  std::vector<uint64> keys;
+  keys.reserve(count);
+  uint64 state = seed;
+  for (size_t i = 0; i < count; ++i) {
+    state = state * GG_UINT64_C(6364136223846793005) +
+            GG_UINT64_C(1442695040888963407);
+    // Keep the index in the low bits so the keys are distinct.
+    keys.push_back((state & ~GG_UINT64_C(0xfffff)) | i);
+  }
+  return keys;
+}
+
+// Times inserting, finding (hits and misses) and erasing |keys| in a |Map|.
+template <typename Map, typename Key>
+void RunMapTest(const char* map_name,
+                const std::vector<Key>& keys,
+                const std::vector<Key>& missing_keys) {
+  Map map;
+  {
+    PerfTimeLogger timer(StringPrintf("%s_Insert", map_name).c_str());
+    for (size_t i = 0; i < keys.size(); ++i)
+      map[keys[i]] = i;
+  }
+  ASSERT_EQ(keys.size(), map.size());
+
+  size_t found = 0;
+  {
+    PerfTimeLogger timer(StringPrintf("%s_LookupHit", map_name).c_str());
+    for (size_t i = 0; i < keys.size(); ++i)
+      found += map.find(keys[i]) != map.end();
+  }
+  {
+    PerfTimeLogger timer(StringPrintf("%s_LookupMiss", map_name).c_str());
+    for (size_t i = 0; i < missing_keys.size(); ++i)
+      found += map.find(missing_keys[i]) != map.end();
+  }
+  EXPECT_EQ(keys.size(), found);
+
+  {
+    PerfTimeLogger timer(StringPrintf("%s_Erase", map_name).c_str());
+    for (size_t i = 0; i < keys.size(); ++i)
+      map.erase(keys[i]);
+  }
+  EXPECT_TRUE(map.empty());
+}
+
+}  // namespace
+
+TEST(FlatHashMapPerfTest, Uint64Keys) {
+  std::vector<uint64> keys = MakeKeys(kNumEntries, 1);
+  std::vector<uint64> missing_keys = MakeKeys(kNumEntries, 2);
+  for (size_t i = 0; i < missing_keys.size(); ++i)
+    missing_keys[i] |= GG_UINT64_C(1) << 63;
+  for (size_t i = 0; i < keys.size(); ++i)
+    keys[i] &= ~(GG_UINT64_C(1) << 63);
+
+  RunMapTest<hash_map<uint64, size_t> >("hash_map_uint64", keys,
+                                         missing_keys);
+  RunMapTest<FlatHashMap<uint64, size_t> >("FlatHashMap_uint64", keys,
+                                            missing_keys);
+}
+
+TEST(FlatHashMapPerfTest, StringKeys) {
+  std::vector<uint64> numbers = MakeKeys(kNumEntries, 3);
+  std::vector<std::string> keys;
+  std::vector<std::string> missing_keys;
+  keys.reserve(numbers.size());
+  missing_keys.reserve(numbers.size());
+  for (size_t i = 0; i < numbers.size(); ++i) {
+    keys.push_back("https://" + Uint64ToString(numbers[i]) + ".example/");
+    missing_keys.push_back("http://" + Uint64ToString(numbers[i]) +
+                           ".example/");
+  }
+
+  RunMapTest<hash_map<std::string, size_t> >("hash_map_string", keys,
+                                              missing_keys);
+  RunMapTest<FlatHashMap<std::string, size_t> >("FlatHashMap_string", keys,
+                                                 missing_keys);
+}
+
+}  // namespace base
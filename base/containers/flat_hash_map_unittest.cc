@@ -0,0 +1,246 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/containers/flat_hash_map.h"
+
+#include <map>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Counts live instances to check that the map constructs and destroys its
+// values in pairs.
+class Counted {
+ public:
+  Counted() : value_(0) { ++live_; }
+  explicit Counted(int value) : value_(value) { ++live_; }
+  Counted(const Counted& other) : value_(other.value_) { ++live_; }
+  ~Counted() { --live_; }
+
+  Counted& operator=(const Counted& other) {
+    value_ = other.value_;
+    return *this;
+  }
+
+  int value() const { return value_; }
+
+  static int live() { return live_; }
+
+ private:
+  int value_;
+  static int live_;
+};
+
+int Counted::live_ = 0;
+
+// A hasher that sends every key to the same probe sequence.
+struct CollidingHash {
+  size_t operator()(int key) const { return 42; }
+};
+
+}  // namespace
+
+TEST(FlatHashMapTest, Basic) {
+  FlatHashMap<int, int> map;
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(0u, map.size());
+  EXPECT_TRUE(map.begin() == map.end());
+  EXPECT_TRUE(map.find(1) == map.end());
+  EXPECT_EQ(0u, map.count(1));
+  EXPECT_EQ(0u, map.erase(1));
+
+  std::pair<FlatHashMap<int, int>::iterator, bool> result =
+      map.insert(std::make_pair(1, 10));
+  EXPECT_TRUE(result.second);
+  EXPECT_EQ(1, result.first->first);
+  EXPECT_EQ(10, result.first->second);
+
+  result = map.insert(std::make_pair(1, 20));
+  EXPECT_FALSE(result.second);
+  EXPECT_EQ(10, result.first->second);
+  EXPECT_EQ(1u, map.size());
+
+  map[2] = 30;
+  EXPECT_EQ(2u, map.size());
+  EXPECT_EQ(30, map[2]);
+  EXPECT_EQ(0, map[3]);
+  EXPECT_EQ(3u, map.size());
+
+  FlatHashMap<int, int>::iterator it = map.find(2);
+  ASSERT_TRUE(it != map.end());
+  it->second = 40;
+  EXPECT_EQ(40, map.find(2)->second);
+
+  EXPECT_EQ(1u, map.erase(2));
+  EXPECT_EQ(0u, map.erase(2));
+  EXPECT_TRUE(map.find(2) == map.end());
+  EXPECT_EQ(2u, map.size());
+
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.find(1) == map.end());
+}
+
+// Compares against std::map through many inserts and erases, including enough
+// of them to grow the table several times and to fill it with tombstones.
+TEST(FlatHashMapTest, MatchesStdMap) {
+  FlatHashMap<uint64, int> map;
+  std::map<uint64, int> reference;
+
+  uint64 key = 1;
+  for (int i = 0; i < 20000; ++i) {
+    key = key * GG_UINT64_C(6364136223846793005) + 1;
+    uint64 k = key % 5000;
+    if (key & (GG_UINT64_C(1) << 40)) {
+      EXPECT_EQ(reference.erase(k), map.erase(k));
+    } else {
+      map[k] = i;
+      reference[k] = i;
+    }
+    ASSERT_EQ(reference.size(), map.size());
+  }
+
+  size_t visited = 0;
+  for (FlatHashMap<uint64, int>::const_iterator it = map.begin();
+       it != map.end(); ++it) {
+    std::map<uint64, int>::const_iterator ref = reference.find(it->first);
+    ASSERT_TRUE(ref != reference.end());
+    EXPECT_EQ(ref->second, it->second);
+    ++visited;
+  }
+  EXPECT_EQ(reference.size(), visited);
+
+  for (std::map<uint64, int>::const_iterator it = reference.begin();
+       it != reference.end(); ++it) {
+    FlatHashMap<uint64, int>::const_iterator found = map.find(it->first);
+    ASSERT_TRUE(found != map.end());
+    EXPECT_EQ(it->second, found->second);
+  }
+}
+
+TEST(FlatHashMapTest, Collisions) {
+  FlatHashMap<int, int, CollidingHash> map;
+  for (int i = 0; i < 100; ++i)
+    map[i] = i * 2;
+  EXPECT_EQ(100u, map.size());
+  for (int i = 0; i < 100; i += 2)
+    EXPECT_EQ(1u, map.erase(i));
+  for (int i = 0; i < 100; ++i) {
+    if (i % 2)
+      EXPECT_EQ(i * 2, map.find(i)->second);
+    else
+      EXPECT_TRUE(map.find(i) == map.end());
+  }
+}
+
+TEST(FlatHashMapTest, EraseWhileIterating) {
+  FlatHashMap<int, int> map;
+  for (int i = 0; i < 1000; ++i)
+    map[i] = i;
+
+  for (FlatHashMap<int, int>::iterator it = map.begin(); it != map.end();) {
+    if (it->first % 3)
+      map.erase(it++);
+    else
+      ++it;
+  }
+
+  EXPECT_EQ(334u, map.size());
+  for (FlatHashMap<int, int>::iterator it = map.begin(); it != map.end(); ++it)
+    EXPECT_EQ(0, it->first % 3);
+}
+
+TEST(FlatHashMapTest, Reserve) {
+  FlatHashMap<int, int> map;
+  map.reserve(1000);
+  size_t capacity = map.capacity();
+  EXPECT_GE(capacity, 1000u);
+  for (int i = 0; i < 1000; ++i)
+    map[i] = i;
+  EXPECT_EQ(capacity, map.capacity());
+}
+
+// Erasing and re-inserting many keys must not grow the table without bound:
+// tombstones are reclaimed by rehashing in place.
+TEST(FlatHashMapTest, TombstonesDoNotGrowTable) {
+  FlatHashMap<int, int> map;
+  for (int i = 0; i < 100; ++i)
+    map[i] = i;
+  for (int i = 100; i < 1000; ++i) {
+    map.erase(i - 100);
+    map[i] = i;
+  }
+  size_t capacity = map.capacity();
+  for (int i = 1000; i < 100000; ++i) {
+    map.erase(i - 100);
+    map[i] = i;
+  }
+  EXPECT_EQ(100u, map.size());
+  EXPECT_EQ(capacity, map.capacity());
+}
+
+TEST(FlatHashMapTest, ValueLifetime) {
+  {
+    FlatHashMap<int, Counted> map;
+    for (int i = 0; i < 500; ++i)
+      map.insert(std::make_pair(i, Counted(i)));
+    EXPECT_EQ(500, Counted::live());
+    for (int i = 0; i < 250; ++i)
+      map.erase(i);
+    EXPECT_EQ(250, Counted::live());
+
+    FlatHashMap<int, Counted> copy(map);
+    EXPECT_EQ(500, Counted::live());
+    EXPECT_EQ(499, copy.find(499)->second.value());
+
+    copy.clear();
+    EXPECT_EQ(250, Counted::live());
+  }
+  EXPECT_EQ(0, Counted::live());
+}
+
+TEST(FlatHashMapTest, CopyAndSwap) {
+  FlatHashMap<int, int> a;
+  FlatHashMap<int, int> b;
+  for (int i = 0; i < 100; ++i)
+    a[i] = i;
+  b[1000] = 1;
+
+  FlatHashMap<int, int> c;
+  c = a;
+  EXPECT_EQ(100u, c.size());
+  EXPECT_EQ(50, c[50]);
+
+  a.swap(b);
+  EXPECT_EQ(1u, a.size());
+  EXPECT_EQ(100u, b.size());
+  EXPECT_EQ(1, a[1000]);
+  EXPECT_EQ(99, b[99]);
+}
+
+TEST(FlatHashMapTest, StringPieceLookup) {
+  FlatHashMap<std::string, int> map;
+  map["foo"] = 1;
+  map[std::string("bar")] = 2;
+
+  EXPECT_EQ(1, map.find(StringPiece("foo"))->second);
+  EXPECT_EQ(2, map.find("bar")->second);
+  EXPECT_EQ(1u, map.count(StringPiece("bar")));
+  EXPECT_TRUE(map.find(StringPiece("baz")) == map.end());
+
+  std::string long_key("foobar");
+  EXPECT_EQ(1, map.find(StringPiece(long_key).substr(0, 3))->second);
+
+  EXPECT_EQ(1u, map.erase(StringPiece("foo")));
+  EXPECT_EQ(1u, map.size());
+}
+
+}  // namespace base
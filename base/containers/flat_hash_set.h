@@ -0,0 +1,34 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_CONTAINERS_FLAT_HASH_SET_H_
+#define BASE_CONTAINERS_FLAT_HASH_SET_H_
+
+#include "base/containers/flat_hash_table.h"
+
+namespace base {
+
+// FlatHashSet is the set counterpart of base::FlatHashMap: a hash set that
+// stores its elements inline in a single open addressing table. Iterators are
+// always const, and the same invalidation rules as FlatHashMap apply. See
+// flat_hash_map.h for when to use it.
+//
+//   base::FlatHashSet<std::string> hosts;
+//   hosts.insert("example.com");
+//   if (hosts.count(base::StringPiece(url.host())))
+//     ...
+template <typename Key,
+          typename Hash = typename internal::FlatHashDefaults<Key>::Hash,
+          typename Equal = typename internal::FlatHashDefaults<Key>::Equal>
+class FlatHashSet
+    : public internal::FlatHashTable<internal::FlatHashSetPolicy<Key>,
+                                     Hash,
+                                     Equal> {
+ public:
+  FlatHashSet() {}
+};
+
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_FLAT_HASH_SET_H_
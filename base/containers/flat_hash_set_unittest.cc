@@ -0,0 +1,61 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/containers/flat_hash_set.h"
+
+#include <set>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_number_conversions.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+TEST(FlatHashSetTest, Basic) {
+  FlatHashSet<int> set;
+  EXPECT_TRUE(set.empty());
+
+  EXPECT_TRUE(set.insert(3).second);
+  EXPECT_FALSE(set.insert(3).second);
+  EXPECT_TRUE(set.insert(4).second);
+  EXPECT_EQ(2u, set.size());
+  EXPECT_EQ(1u, set.count(3));
+  EXPECT_EQ(3, *set.find(3));
+
+  EXPECT_EQ(1u, set.erase(3));
+  EXPECT_EQ(0u, set.count(3));
+  EXPECT_EQ(1u, set.size());
+}
+
+TEST(FlatHashSetTest, RangeInsertAndIterate) {
+  std::set<uint64> reference;
+  for (uint64 i = 0; i < 3000; ++i)
+    reference.insert(i * GG_UINT64_C(0x100000001));
+
+  FlatHashSet<uint64> set;
+  set.insert(reference.begin(), reference.end());
+  EXPECT_EQ(reference.size(), set.size());
+
+  std::set<uint64> visited;
+  for (FlatHashSet<uint64>::const_iterator it = set.begin(); it != set.end();
+       ++it) {
+    EXPECT_TRUE(visited.insert(*it).second);
+  }
+  EXPECT_TRUE(visited == reference);
+}
+
+TEST(FlatHashSetTest, StringPieceLookup) {
+  FlatHashSet<std::string> set;
+  for (int i = 0; i < 100; ++i)
+    set.insert(IntToString(i));
+
+  EXPECT_EQ(1u, set.count(StringPiece("42")));
+  EXPECT_EQ(1u, set.count("99"));
+  EXPECT_EQ(0u, set.count(StringPiece("100")));
+  EXPECT_EQ("7", *set.find(StringPiece("7")));
+}
+
+}  // namespace base
@@ -0,0 +1,701 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Implementation details shared by base::FlatHashMap and base::FlatHashSet.
+// Include base/containers/flat_hash_map.h or base/containers/flat_hash_set.h
+// instead of this file.
+//
+// The table is an open-addressing hash table in the style of the "Swiss
+// table": elements live directly in one flat array of slots, and a parallel
+// array of one-byte control words records whether each slot is empty, deleted
+// or full. For full slots, the control byte holds 7 bits of the element's hash
+// (H2). The remaining bits (H1) select where probing starts. Lookups load a
+// whole group of control bytes at once (16 with SSE2, 8 otherwise) and compare
+// all of them against H2 in parallel, so that only slots whose H2 matches are
+// ever compared with the key.
+//
+// The control array has |capacity_| + Group::kWidth bytes: one per slot, a
+// sentinel byte that stops iteration, and a copy of the first
+// Group::kWidth - 1 control bytes so that a group can be loaded at any position
+// without wrapping around.
+
+#ifndef BASE_CONTAINERS_FLAT_HASH_TABLE_H_
+#define BASE_CONTAINERS_FLAT_HASH_TABLE_H_
+
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/logging.h"
+#include "base/strings/string_piece.h"
+#include "build/build_config.h"
+
+#if defined(__SSE2__) || (defined(COMPILER_MSVC) && defined(ARCH_CPU_X86_64))
+#define BASE_FLAT_HASH_TABLE_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+#endif
+
+namespace base {
+
+// Hash and equality functors for tables keyed by std::string that also accept
+// StringPiece (and const char*) for lookups, so that finding an element does
+// not require building a temporary std::string. They are the defaults for
+// FlatHashMap and FlatHashSet with std::string keys.
+struct StringPieceHash {
+  typedef void is_transparent;
+
+  size_t operator()(const StringPiece& s) const {
+    return BASE_HASH_NAMESPACE::hash<StringPiece>()(s);
+  }
+};
+
+struct StringPieceEqual {
+  typedef void is_transparent;
+
+  bool operator()(const StringPiece& a, const StringPiece& b) const {
+    return a == b;
+  }
+};
+
+namespace internal {
+
+// Default functors for a key type.
+template <typename Key>
+struct FlatHashDefaults {
+  typedef BASE_HASH_NAMESPACE::hash<Key> Hash;
+  typedef std::equal_to<Key> Equal;
+};
+
+template <>
+struct FlatHashDefaults<std::string> {
+  typedef StringPieceHash Hash;
+  typedef StringPieceEqual Equal;
+};
+
+// Lookup functions accept any key type K when both the hasher and the
+// equality functor declare |is_transparent|, and only the table's key type
+// otherwise. LookupKey<...>::template Type<K> collapses to K in the first case,
+// which keeps K deducible in
+//   template <typename K = key_type> iterator find(const KeyArg<K>& key);
+template <bool kTransparent>
+struct LookupKey {
+  template <typename K, typename Key>
+  using Type = Key;
+};
+
+template <>
+struct LookupKey<true> {
+  template <typename K, typename Key>
+  using Type = K;
+};
+
+template <typename T>
+class IsTransparent {
+  typedef char Yes;
+  typedef struct { char dummy[2]; } No;
+
+  template <typename U>
+  static Yes Test(typename U::is_transparent*);
+  template <typename U>
+  static No Test(...);
+
+ public:
+  static const bool value = sizeof(Test<T>(NULL)) == sizeof(Yes);
+};
+
+// Control byte values. Full slots hold the 7-bit H2 value, which is never
+// negative.
+typedef int8 ControlByte;
+const ControlByte kEmpty = -128;   // 0b10000000
+const ControlByte kDeleted = -2;   // 0b11111110
+const ControlByte kSentinel = -1;  // 0b11111111
+
+inline bool IsFull(ControlByte c) { return c >= 0; }
+inline bool IsEmptyOrDeleted(ControlByte c) { return c < kSentinel; }
+
+inline uint32 CountTrailingZeros(uint32 x) {
+  DCHECK_NE(0u, x);
+#if defined(COMPILER_MSVC)
+  unsigned long index;
+  _BitScanForward(&index, x);
+  return index;
+#else
+  return __builtin_ctz(x);
+#endif
+}
+
+inline uint32 CountLeadingZeros(uint32 x) {
+  DCHECK_NE(0u, x);
+#if defined(COMPILER_MSVC)
+  unsigned long index;
+  _BitScanReverse(&index, x);
+  return 31 - index;
+#else
+  return __builtin_clz(x);
+#endif
+}
+
+// A set of matching positions within a group: bit i is set when control byte
+// i of the group matched.
+class BitMask {
+ public:
+  explicit BitMask(uint32 mask) : mask_(mask) {}
+
+  bool HasMatch() const { return mask_ != 0; }
+  uint32 LowestBitSet() const { return CountTrailingZeros(mask_); }
+  void ClearLowestBit() { mask_ &= mask_ - 1; }
+  uint32 bits() const { return mask_; }
+
+ private:
+  uint32 mask_;
+};
+
+#if defined(BASE_FLAT_HASH_TABLE_USE_SSE2)
+
+// Sixteen control bytes, compared with single SSE2 instructions.
+class Group {
+ public:
+  static const size_t kWidth = 16;
+
+  explicit Group(const ControlByte* pos)
+      : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+
+  BitMask Match(ControlByte h2) const {
+    return BitMask(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_)));
+  }
+
+  BitMask MatchEmpty() const {
+    return BitMask(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(kEmpty), ctrl_)));
+  }
+
+  BitMask MatchEmptyOrDeleted() const {
+    return BitMask(
+        _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(kSentinel), ctrl_)));
+  }
+
+ private:
+  __m128i ctrl_;
+};
+
+#else  // defined(BASE_FLAT_HASH_TABLE_USE_SSE2)
+
+// Eight control bytes, compared one at a time.
+class Group {
+ public:
+  static const size_t kWidth = 8;
+
+  explicit Group(const ControlByte* pos) { memcpy(ctrl_, pos, kWidth); }
+
+  BitMask Match(ControlByte h2) const {
+    uint32 mask = 0;
+    for (size_t i = 0; i < kWidth; ++i)
+      mask |= static_cast<uint32>(ctrl_[i] == h2) << i;
+    return BitMask(mask);
+  }
+
+  BitMask MatchEmpty() const { return Match(kEmpty); }
+
+  BitMask MatchEmptyOrDeleted() const {
+    uint32 mask = 0;
+    for (size_t i = 0; i < kWidth; ++i)
+      mask |= static_cast<uint32>(IsEmptyOrDeleted(ctrl_[i])) << i;
+    return BitMask(mask);
+  }
+
+ private:
+  ControlByte ctrl_[kWidth];
+};
+
+#endif  // defined(BASE_FLAT_HASH_TABLE_USE_SSE2)
+
+// Returns the number of consecutive empty or deleted control bytes starting at
+// |pos|, which is at most Group::kWidth.
+inline size_t CountLeadingEmptyOrDeleted(const ControlByte* pos) {
+  uint32 not_empty_or_deleted = ~Group(pos).MatchEmptyOrDeleted().bits();
+  return CountTrailingZeros(not_empty_or_deleted);
+}
+
+// The hashers in hash_tables.h are the identity for integers, which leaves the
+// high and low bits used as H1 and H2 poorly distributed. Spread them before
+// use.
+inline size_t MixHash(size_t hash) {
+#if defined(ARCH_CPU_64_BITS)
+  uint64 mixed = static_cast<uint64>(hash) * GG_UINT64_C(0x9E3779B97F4A7C15);
+  return static_cast<size_t>(mixed ^ (mixed >> 32));
+#else
+  uint32 mixed = static_cast<uint32>(hash) * 0x9E3779B9u;
+  return static_cast<size_t>(mixed ^ (mixed >> 16));
+#endif
+}
+
+inline size_t H1(size_t hash) { return hash >> 7; }
+inline ControlByte H2(size_t hash) { return hash & 0x7f; }
+
+// Capacities are of the form 2^n - 1 so that they can double as a mask. They
+// are never smaller than a group, so every group load sees real control bytes.
+const size_t kMinCapacity = Group::kWidth - 1;
+
+// The table grows once it is 7/8 full. Rounding up the reserved fraction
+// keeps at least one empty slot, which terminates unsuccessful probes.
+inline size_t CapacityToGrowth(size_t capacity) {
+  return capacity - (capacity + 1) / 8;
+}
+
+inline size_t NormalizeCapacity(size_t n) {
+  size_t capacity = kMinCapacity;
+  while (capacity < n)
+    capacity = capacity * 2 + 1;
+  return capacity;
+}
+
+// The traits of a FlatHashTable that differ between maps and sets.
+template <typename K, typename V>
+struct FlatHashMapPolicy {
+  typedef K key_type;
+  typedef std::pair<const K, V> value_type;
+  typedef value_type& reference;
+  typedef value_type* pointer;
+
+  static const K& GetKey(const value_type& value) { return value.first; }
+};
+
+template <typename K>
+struct FlatHashSetPolicy {
+  typedef K key_type;
+  typedef K value_type;
+  // Elements of a set are immutable, since changing them would change their
+  // hash.
+  typedef const K& reference;
+  typedef const K* pointer;
+
+  static const K& GetKey(const value_type& value) { return value; }
+};
+
+template <typename Policy, typename Hash, typename Equal>
+class FlatHashTable {
+ public:
+  typedef typename Policy::key_type key_type;
+  typedef typename Policy::value_type value_type;
+  typedef Hash hasher;
+  typedef Equal key_equal;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <typename K>
+  using KeyArg = typename LookupKey<IsTransparent<Hash>::value &&
+                                    IsTransparent<Equal>::value>::
+      template Type<K, key_type>;
+
+  class const_iterator;
+
+  class iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename FlatHashTable::value_type value_type;
+    typedef typename Policy::reference reference;
+    typedef typename Policy::pointer pointer;
+    typedef typename FlatHashTable::difference_type difference_type;
+
+    iterator() : ctrl_(NULL), slot_(NULL) {}
+
+    reference operator*() const {
+      DCHECK(IsFull(*ctrl_));
+      return *slot_;
+    }
+    pointer operator->() const { return &operator*(); }
+
+    iterator& operator++() {
+      DCHECK(IsFull(*ctrl_));
+      ++ctrl_;
+      ++slot_;
+      SkipEmptyOrDeleted();
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator tmp(*this);
+      ++*this;
+      return tmp;
+    }
+
+    bool operator==(const iterator& other) const {
+      return ctrl_ == other.ctrl_;
+    }
+    bool operator!=(const iterator& other) const {
+      return ctrl_ != other.ctrl_;
+    }
+
+   private:
+    friend class FlatHashTable;
+    friend class const_iterator;
+
+    iterator(ControlByte* ctrl, value_type* slot) : ctrl_(ctrl), slot_(slot) {}
+
+    void SkipEmptyOrDeleted() {
+      while (IsEmptyOrDeleted(*ctrl_)) {
+        size_t shift = CountLeadingEmptyOrDeleted(ctrl_);
+        ctrl_ += shift;
+        slot_ += shift;
+      }
+      // Iteration ends on the sentinel.
+      if (*ctrl_ == kSentinel)
+        ctrl_ = NULL;
+    }
+
+    // NULL for end().
+    ControlByte* ctrl_;
+    value_type* slot_;
+  };
+
+  class const_iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename FlatHashTable::value_type value_type;
+    typedef const value_type& reference;
+    typedef const value_type* pointer;
+    typedef typename FlatHashTable::difference_type difference_type;
+
+    const_iterator() {}
+    // Implicit to allow iterator -> const_iterator conversions.
+    const_iterator(const iterator& it) : it_(it) {}
+
+    reference operator*() const { return *it_; }
+    pointer operator->() const { return it_.operator->(); }
+
+    const_iterator& operator++() {
+      ++it_;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator tmp(*this);
+      ++it_;
+      return tmp;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return it_ == other.it_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return it_ != other.it_;
+    }
+
+   private:
+    friend class FlatHashTable;
+
+    iterator it_;
+  };
+
+  FlatHashTable()
+      : ctrl_(NULL), slots_(NULL), size_(0), capacity_(0), growth_left_(0) {}
+
+  FlatHashTable(const FlatHashTable& other)
+      : ctrl_(NULL),
+        slots_(NULL),
+        size_(0),
+        capacity_(0),
+        growth_left_(0),
+        hash_(other.hash_),
+        eq_(other.eq_) {
+    reserve(other.size());
+    for (const_iterator it = other.begin(); it != other.end(); ++it)
+      InsertUnique(*it);
+  }
+
+  ~FlatHashTable() { DestroySlotsAndFree(); }
+
+  FlatHashTable& operator=(const FlatHashTable& other) {
+    if (this != &other) {
+      FlatHashTable tmp(other);
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  iterator begin() {
+    if (!size_)
+      return end();
+    iterator it(ctrl_, slots_);
+    it.SkipEmptyOrDeleted();
+    return it;
+  }
+  iterator end() { return iterator(); }
+  const_iterator begin() const {
+    return const_cast<FlatHashTable*>(this)->begin();
+  }
+  const_iterator end() const { return const_iterator(); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  bool empty() const { return !size_; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+
+  void clear() {
+    // Keep the allocation of a reasonably sized table, since it is likely to
+    // be refilled.
+    if (!capacity_)
+      return;
+    if (capacity_ > 127) {
+      DestroySlotsAndFree();
+      return;
+    }
+    for (size_t i = 0; i < capacity_; ++i) {
+      if (IsFull(ctrl_[i]))
+        slots_[i].~value_type();
+    }
+    ResetCtrl();
+    size_ = 0;
+  }
+
+  // Makes sure |count| elements can be held without rehashing.
+  void reserve(size_t count) {
+    if (count <= growth_left_ + size_)
+      return;
+    Resize(NormalizeCapacity(count + (count - 1) / 7));
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    const key_type& key = Policy::GetKey(value);
+    size_t hash = HashOf(key);
+    iterator it = FindWithHash(key, hash);
+    if (it != end())
+      return std::make_pair(it, false);
+    size_t i = PrepareInsert(hash);
+    new (slots_ + i) value_type(value);
+    return std::make_pair(iterator(ctrl_ + i, slots_ + i), true);
+  }
+
+  template <typename InputIterator>
+  void insert(InputIterator first, InputIterator last) {
+    for (; first != last; ++first)
+      insert(*first);
+  }
+
+  template <typename K = key_type>
+  iterator find(const KeyArg<K>& key) {
+    return FindWithHash(key, HashOf(key));
+  }
+
+  template <typename K = key_type>
+  const_iterator find(const KeyArg<K>& key) const {
+    return const_cast<FlatHashTable*>(this)->FindWithHash(key, HashOf(key));
+  }
+
+  template <typename K = key_type>
+  size_t count(const KeyArg<K>& key) const {
+    return find(key) != end() ? 1 : 0;
+  }
+
+  // Erasing does not invalidate iterators to other elements, so it is safe to
+  // erase while iterating with erase(it++).
+  void erase(iterator pos) {
+    DCHECK(pos != end());
+    pos.slot_->~value_type();
+    EraseMetaOnly(pos.ctrl_ - ctrl_);
+  }
+  void erase(const_iterator pos) { erase(pos.it_); }
+
+  template <typename K = key_type>
+  size_t erase(const KeyArg<K>& key) {
+    iterator it = find(key);
+    if (it == end())
+      return 0;
+    erase(it);
+    return 1;
+  }
+
+  void swap(FlatHashTable& other) {
+    std::swap(ctrl_, other.ctrl_);
+    std::swap(slots_, other.slots_);
+    std::swap(size_, other.size_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(growth_left_, other.growth_left_);
+    std::swap(hash_, other.hash_);
+    std::swap(eq_, other.eq_);
+  }
+
+  hasher hash_function() const { return hash_; }
+  key_equal key_eq() const { return eq_; }
+
+ protected:
+  // Returns the slot index of a new element with |hash| after checking that
+  // no element with an equal key exists. The caller constructs the element.
+  size_t PrepareInsert(size_t hash) {
+    size_t i = FindFirstNonFull(hash);
+    if (growth_left_ == 0 && (!capacity_ || ctrl_[i] != kDeleted)) {
+      RehashAndGrow();
+      i = FindFirstNonFull(hash);
+    }
+    ++size_;
+    if (ctrl_[i] == kEmpty)
+      --growth_left_;
+    SetCtrl(i, H2(hash));
+    return i;
+  }
+
+  value_type* slot(size_t i) { return slots_ + i; }
+
+  template <typename K>
+  size_t HashOf(const K& key) const {
+    return MixHash(hash_(key));
+  }
+
+  template <typename K>
+  iterator FindWithHash(const K& key, size_t hash) {
+    if (!capacity_)
+      return end();
+    size_t offset = H1(hash) & capacity_;
+    size_t index = 0;
+    while (true) {
+      Group g(ctrl_ + offset);
+      for (BitMask match = g.Match(H2(hash)); match.HasMatch();
+           match.ClearLowestBit()) {
+        size_t i = (offset + match.LowestBitSet()) & capacity_;
+        if (eq_(Policy::GetKey(slots_[i]), key))
+          return iterator(ctrl_ + i, slots_ + i);
+      }
+      if (g.MatchEmpty().HasMatch())
+        return end();
+      index += Group::kWidth;
+      offset = (offset + index) & capacity_;
+      DCHECK_LE(index, capacity_) << "Full table";
+    }
+  }
+
+ private:
+  // Inserts an element known not to be in the table.
+  void InsertUnique(const value_type& value) {
+    size_t i = PrepareInsert(HashOf(Policy::GetKey(value)));
+    new (slots_ + i) value_type(value);
+  }
+
+  // Returns the first empty or deleted slot in the probe sequence of |hash|,
+  // or an arbitrary slot if the table has no capacity yet.
+  size_t FindFirstNonFull(size_t hash) const {
+    if (!capacity_)
+      return 0;
+    size_t offset = H1(hash) & capacity_;
+    size_t index = 0;
+    while (true) {
+      BitMask mask = Group(ctrl_ + offset).MatchEmptyOrDeleted();
+      if (mask.HasMatch())
+        return (offset + mask.LowestBitSet()) & capacity_;
+      index += Group::kWidth;
+      offset = (offset + index) & capacity_;
+      DCHECK_LE(index, capacity_) << "Full table";
+    }
+  }
+
+  void EraseMetaOnly(size_t i) {
+    --size_;
+    // If no probe sequence ever saw this group full, nobody probed past this
+    // slot and it can go back to empty instead of becoming a tombstone.
+    size_t index_before = (i - Group::kWidth) & capacity_;
+    BitMask empty_after = Group(ctrl_ + i).MatchEmpty();
+    BitMask empty_before = Group(ctrl_ + index_before).MatchEmpty();
+    bool was_never_full =
+        empty_before.HasMatch() && empty_after.HasMatch() &&
+        empty_after.LowestBitSet() + CountLeadingZeros(empty_before.bits()) -
+                (32 - Group::kWidth) <
+            Group::kWidth;
+    SetCtrl(i, was_never_full ? kEmpty : kDeleted);
+    if (was_never_full)
+      ++growth_left_;
+  }
+
+  // Writes control byte |i| and its clone, if it has one.
+  void SetCtrl(size_t i, ControlByte h) {
+    DCHECK_LT(i, capacity_);
+    ctrl_[i] = h;
+    ctrl_[((i - (Group::kWidth - 1)) & capacity_) + Group::kWidth - 1] = h;
+  }
+
+  void ResetCtrl() {
+    memset(ctrl_, kEmpty, capacity_ + Group::kWidth);
+    ctrl_[capacity_] = kSentinel;
+    growth_left_ = CapacityToGrowth(capacity_);
+  }
+
+  void RehashAndGrow() {
+    // When the table is full mostly of tombstones, rehash it in place (into a
+    // new table of the same size) rather than growing it.
+    if (capacity_ && size_ <= CapacityToGrowth(capacity_) / 2)
+      Resize(capacity_);
+    else
+      Resize(capacity_ ? capacity_ * 2 + 1 : kMinCapacity);
+  }
+
+  void Resize(size_t new_capacity) {
+    DCHECK_EQ(0u, new_capacity & (new_capacity + 1));
+    DCHECK_GE(new_capacity, kMinCapacity);
+    const ControlByte* old_ctrl = ctrl_;
+    value_type* old_slots = slots_;
+    size_t old_capacity = capacity_;
+
+    capacity_ = new_capacity;
+    Allocate();
+    ResetCtrl();
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (!IsFull(old_ctrl[i]))
+        continue;
+      size_t hash = HashOf(Policy::GetKey(old_slots[i]));
+      size_t new_i = FindFirstNonFull(hash);
+      SetCtrl(new_i, H2(hash));
+      new (slots_ + new_i) value_type(old_slots[i]);
+      old_slots[i].~value_type();
+    }
+    growth_left_ -= size_;
+    ::operator delete(static_cast<void*>(old_slots));
+  }
+
+  // Control bytes and slots share one allocation, with the slots first so
+  // that they are aligned for |value_type|.
+  void Allocate() {
+    size_t slot_bytes = capacity_ * sizeof(value_type);
+    char* mem = static_cast<char*>(
+        ::operator new(slot_bytes + capacity_ + Group::kWidth));
+    slots_ = reinterpret_cast<value_type*>(mem);
+    ctrl_ = reinterpret_cast<ControlByte*>(mem + slot_bytes);
+  }
+
+  void DestroySlotsAndFree() {
+    if (!capacity_)
+      return;
+    for (size_t i = 0; i < capacity_; ++i) {
+      if (IsFull(ctrl_[i]))
+        slots_[i].~value_type();
+    }
+    ::operator delete(static_cast<void*>(slots_));
+    ctrl_ = NULL;
+    slots_ = NULL;
+    size_ = 0;
+    capacity_ = 0;
+    growth_left_ = 0;
+  }
+
+  ControlByte* ctrl_;
+  value_type* slots_;
+  size_t size_;
+  size_t capacity_;
+  size_t growth_left_;
+  Hash hash_;
+  Equal eq_;
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_FLAT_HASH_TABLE_H_
@@ -0,0 +1,390 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file contains IntrusiveMRUCache, a Most Recently Used cache with the
+// interface of base::MRUCache (see mru_cache.h) but a leaner layout.
+//
+// MRUCache keeps its items in a std::list and indexes them with a separate
+// map, so each insertion allocates twice, stores the key twice, and each
+// lookup chases pointers through both structures. IntrusiveMRUCache stores
+// each item in a single node that is linked both into the recency list and
+// into a hash bucket chain, so:
+//  - an insertion allocates at most one node, and none at all when the cache
+//    is full, since the node of the evicted item is reused;
+//  - the key is stored once;
+//  - a lookup walks one short chain of nodes.
+//
+// The cache can also be bounded by the total "weight" of its payloads instead
+// of their number, e.g. by their size in bytes, by giving it a Weigher
+// functor:
+//
+//   struct StringWeigher {
+//     size_t operator()(const std::string& payload) const {
+//       return payload.size();
+//     }
+//   };
+//   // Holds at most 1MB of strings.
+//   base::IntrusiveMRUCache<GURL, std::string, GURLHash, StringWeigher>
+//       cache(1024 * 1024);
+//
+// Like MRUCache, this class is not thread-safe. See sharded_mru_cache.h for a
+// thread-safe wrapper.
+
+#ifndef BASE_CONTAINERS_INTRUSIVE_MRU_CACHE_H_
+#define BASE_CONTAINERS_INTRUSIVE_MRU_CACHE_H_
+
+#include <stddef.h>
+
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/logging.h"
+#include "base/memory/manual_constructor.h"
+
+namespace base {
+
+// The default Weigher: every payload weighs 1, so the cache is bounded by its
+// number of items like MRUCache.
+template <class PayloadType>
+struct MRUCacheUnitWeigher {
+  size_t operator()(const PayloadType& payload) const { return 1; }
+};
+
+template <class KeyType,
+          class PayloadType,
+          class HashType = BASE_HASH_NAMESPACE::hash<KeyType>,
+          class WeigherType = MRUCacheUnitWeigher<PayloadType> >
+class IntrusiveMRUCache {
+ public:
+  // Same as MRUCache::value_type, so iterators expose |first| and |second|.
+  typedef std::pair<KeyType, PayloadType> value_type;
+  typedef size_t size_type;
+
+ private:
+  struct Node {
+    // Links in the circular recency list, most recent first.
+    Node* prev;
+    Node* next;
+    // Next node in the same hash bucket.
+    Node* bucket_next;
+    size_t hash;
+    size_t weight;
+    // Uninitialized in the list head and in the spare node.
+    ManualConstructor<value_type> value;
+  };
+
+  template <class ValueType, class NodeType>
+  class Iterator {
+   public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef ValueType value_type;
+    typedef ptrdiff_t difference_type;
+    typedef ValueType* pointer;
+    typedef ValueType& reference;
+
+    Iterator() : node_(NULL) {}
+    // Allows iterator -> const_iterator conversions.
+    template <class OtherValueType, class OtherNodeType>
+    Iterator(const Iterator<OtherValueType, OtherNodeType>& other)
+        : node_(other.node_) {}
+
+    reference operator*() const { return *node_->value; }
+    pointer operator->() const { return node_->value.get(); }
+
+    Iterator& operator++() {
+      node_ = node_->next;
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator tmp(*this);
+      node_ = node_->next;
+      return tmp;
+    }
+    Iterator& operator--() {
+      node_ = node_->prev;
+      return *this;
+    }
+    Iterator operator--(int) {
+      Iterator tmp(*this);
+      node_ = node_->prev;
+      return tmp;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return node_ == other.node_;
+    }
+    bool operator!=(const Iterator& other) const {
+      return node_ != other.node_;
+    }
+
+   private:
+    friend class IntrusiveMRUCache;
+    template <class, class> friend class Iterator;
+
+    explicit Iterator(NodeType* node) : node_(node) {}
+
+    NodeType* node_;
+  };
+
+ public:
+  typedef Iterator<value_type, Node> iterator;
+  typedef Iterator<const value_type, const Node> const_iterator;
+  typedef std::reverse_iterator<iterator> reverse_iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  enum { NO_AUTO_EVICT = 0 };
+
+  // |max_size| is the total weight the cache prunes its members to when a new
+  // item is inserted; with the default Weigher, that is the number of items.
+  // Pass NO_AUTO_EVICT to not restrict the cache size.
+  explicit IntrusiveMRUCache(size_type max_size)
+      : max_size_(max_size),
+        size_(0),
+        total_weight_(0),
+        bucket_bits_(0),
+        spare_(NULL) {
+    head_.prev = &head_;
+    head_.next = &head_;
+  }
+
+  IntrusiveMRUCache(size_type max_size,
+                    const HashType& hasher,
+                    const WeigherType& weigher)
+      : max_size_(max_size),
+        size_(0),
+        total_weight_(0),
+        hasher_(hasher),
+        weigher_(weigher),
+        bucket_bits_(0),
+        spare_(NULL) {
+    head_.prev = &head_;
+    head_.next = &head_;
+  }
+
+  ~IntrusiveMRUCache() {
+    Clear();
+    delete spare_;
+  }
+
+  size_type max_size() const { return max_size_; }
+
+  // Inserts a payload item with the given key. If an existing item has the
+  // same key, it is removed prior to insertion. An iterator indicating the
+  // inserted item will be returned (this will always be the front of the
+  // list). The payload will be copied.
+  //
+  // An item that weighs more than max_size() on its own evicts everything
+  // else and is kept anyway, so that the returned iterator is valid.
+  iterator Put(const KeyType& key, const PayloadType& payload) {
+    size_t hash = hasher_(key);
+    size_t weight = weigher_(payload);
+    Node* node = Find(key, hash);
+    if (node)
+      Erase(iterator(node));
+    if (max_size_ != NO_AUTO_EVICT)
+      ShrinkToSize(weight < max_size_ ? max_size_ - weight : 0);
+
+    if (spare_) {
+      node = spare_;
+      spare_ = NULL;
+    } else {
+      node = new Node;
+    }
+    node->value.Init(key, payload);
+    node->hash = hash;
+    node->weight = weight;
+    LinkIntoBucket(node);
+    LinkAtFront(node);
+    ++size_;
+    total_weight_ += weight;
+    return begin();
+  }
+
+  // Retrieves the contents of the given key, or end() if not found. This
+  // method has the side effect of moving the requested item to the front of
+  // the recency list.
+  iterator Get(const KeyType& key) {
+    Node* node = Find(key, hasher_(key));
+    if (!node)
+      return end();
+    Unlink(node);
+    LinkAtFront(node);
+    return begin();
+  }
+
+  // Retrieves the payload associated with a given key and returns it via
+  // result without affecting the ordering (unlike Get).
+  iterator Peek(const KeyType& key) {
+    Node* node = Find(key, hasher_(key));
+    return node ? iterator(node) : end();
+  }
+
+  const_iterator Peek(const KeyType& key) const {
+    Node* node = Find(key, hasher_(key));
+    return node ? const_iterator(node) : end();
+  }
+
+  // Erases the item referenced by the given iterator. An iterator to the item
+  // following it will be returned. The iterator must be valid.
+  iterator Erase(iterator pos) {
+    Node* node = pos.node_;
+    DCHECK_NE(&head_, node);
+    iterator next(node->next);
+    Unlink(node);
+    UnlinkFromBucket(node);
+    --size_;
+    total_weight_ -= node->weight;
+    node->value.Destroy();
+    // Keep one node around for the next insertion, which typically follows an
+    // eviction.
+    if (spare_)
+      delete node;
+    else
+      spare_ = node;
+    return next;
+  }
+
+  // MRUCache entries are often processed in reverse order, so we add this
+  // convenience function (not typically defined by STL containers).
+  reverse_iterator Erase(reverse_iterator pos) {
+    // We have to actually give it the incremented iterator to delete, since
+    // the forward iterator that base() returns is actually one past the item
+    // being iterated over.
+    return reverse_iterator(Erase((++pos).base()));
+  }
+
+  // Evicts the least recently used items until the total weight of the cache
+  // is at most |new_size|; with the default Weigher, that is until it only
+  // holds |new_size| items.
+  void ShrinkToSize(size_type new_size) {
+    while (total_weight_ > new_size)
+      Erase(rbegin());
+  }
+
+  // Deletes everything from the cache.
+  void Clear() {
+    iterator i = begin();
+    while (i != end())
+      i = Erase(i);
+    std::vector<Node*>().swap(buckets_);
+  }
+
+  // Returns the number of elements in the cache.
+  size_type size() const { return size_; }
+
+  // Returns the sum of the weights of all elements in the cache. With the
+  // default Weigher, this is the same as size().
+  size_type total_weight() const { return total_weight_; }
+
+  // Allows iteration over the list. Forward iteration starts with the most
+  // recent item and works backwards.
+  //
+  // Iterators stay valid as you insert or delete things (as long as you don't
+  // delete the one you are pointing to).
+  iterator begin() { return iterator(head_.next); }
+  const_iterator begin() const { return const_iterator(head_.next); }
+  iterator end() { return iterator(&head_); }
+  const_iterator end() const { return const_iterator(&head_); }
+
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  bool empty() const { return size_ == 0; }
+
+ private:
+  Node* Find(const KeyType& key, size_t hash) const {
+    if (buckets_.empty())
+      return NULL;
+    for (Node* node = buckets_[BucketIndex(hash)]; node;
+         node = node->bucket_next) {
+      if (node->hash == hash && node->value->first == key)
+        return node;
+    }
+    return NULL;
+  }
+
+  void LinkAtFront(Node* node) {
+    node->prev = &head_;
+    node->next = head_.next;
+    head_.next->prev = node;
+    head_.next = node;
+  }
+
+  void Unlink(Node* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+  }
+
+  // Multiplicative hashing spreads the identity hashes of integers over the
+  // buckets, and uses the high bits so a power-of-two table works.
+  size_t BucketIndex(size_t hash) const {
+#if defined(ARCH_CPU_64_BITS)
+    uint64 mixed = static_cast<uint64>(hash) * GG_UINT64_C(0x9E3779B97F4A7C15);
+    return static_cast<size_t>(mixed >> (64 - bucket_bits_));
+#else
+    uint32 mixed = static_cast<uint32>(hash) * 0x9E3779B9u;
+    return static_cast<size_t>(mixed >> (32 - bucket_bits_));
+#endif
+  }
+
+  // Must be called before |node| is linked into the recency list, which
+  // Rehash() walks.
+  void LinkIntoBucket(Node* node) {
+    // Keep at most one node per bucket on average.
+    if (size_ >= buckets_.size())
+      Rehash(buckets_.empty() ? 4 : bucket_bits_ + 1);
+    Node** bucket = &buckets_[BucketIndex(node->hash)];
+    node->bucket_next = *bucket;
+    *bucket = node;
+  }
+
+  void UnlinkFromBucket(Node* node) {
+    Node** link = &buckets_[BucketIndex(node->hash)];
+    while (*link != node)
+      link = &(*link)->bucket_next;
+    *link = node->bucket_next;
+  }
+
+  void Rehash(int bucket_bits) {
+    bucket_bits_ = bucket_bits;
+    std::vector<Node*>(static_cast<size_t>(1) << bucket_bits).swap(buckets_);
+    for (Node* node = head_.next; node != &head_; node = node->next) {
+      Node** bucket = &buckets_[BucketIndex(node->hash)];
+      node->bucket_next = *bucket;
+      *bucket = node;
+    }
+  }
+
+  size_type max_size_;
+  size_type size_;
+  size_type total_weight_;
+
+  HashType hasher_;
+  WeigherType weigher_;
+
+  // Sentinel of the circular recency list; it holds no value.
+  Node head_;
+
+  // Hash buckets, each the head of a chain of nodes linked by |bucket_next|.
+  std::vector<Node*> buckets_;
+  int bucket_bits_;
+
+  // A node whose value has been destroyed, kept for reuse by Put().
+  Node* spare_;
+
+  DISALLOW_COPY_AND_ASSIGN(IntrusiveMRUCache);
+};
+
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_INTRUSIVE_MRU_CACHE_H_
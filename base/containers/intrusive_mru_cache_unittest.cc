@@ -0,0 +1,237 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/containers/intrusive_mru_cache.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+int cached_item_live_count = 0;
+
+struct CachedItem {
+  CachedItem() : value(0) {
+    cached_item_live_count++;
+  }
+
+  explicit CachedItem(int new_value) : value(new_value) {
+    cached_item_live_count++;
+  }
+
+  CachedItem(const CachedItem& other) : value(other.value) {
+    cached_item_live_count++;
+  }
+
+  ~CachedItem() {
+    cached_item_live_count--;
+  }
+
+  int value;
+};
+
+// Weighs a string payload by its length.
+struct StringWeigher {
+  size_t operator()(const std::string& payload) const {
+    return payload.size();
+  }
+};
+
+}  // namespace
+
+TEST(IntrusiveMRUCacheTest, Basic) {
+  typedef base::IntrusiveMRUCache<int, CachedItem> Cache;
+  Cache cache(Cache::NO_AUTO_EVICT);
+
+  // Check failure conditions
+  EXPECT_TRUE(cache.Get(0) == cache.end());
+  EXPECT_TRUE(cache.Peek(0) == cache.end());
+  EXPECT_TRUE(cache.empty());
+
+  static const int kItem1Key = 5;
+  CachedItem item1(10);
+  Cache::iterator inserted_item = cache.Put(kItem1Key, item1);
+  EXPECT_EQ(1U, cache.size());
+  EXPECT_TRUE(inserted_item == cache.begin());
+  EXPECT_EQ(kItem1Key, inserted_item->first);
+  EXPECT_EQ(item1.value, inserted_item->second.value);
+
+  static const int kItem2Key = 7;
+  CachedItem item2(12);
+  cache.Put(kItem2Key, item2);
+  EXPECT_EQ(2U, cache.size());
+
+  // Check that item1 is the oldest since item2 was added afterwards.
+  {
+    Cache::reverse_iterator oldest = cache.rbegin();
+    ASSERT_TRUE(oldest != cache.rend());
+    EXPECT_EQ(kItem1Key, oldest->first);
+    EXPECT_EQ(item1.value, oldest->second.value);
+  }
+
+  // Check that retrieving item1 pushed item2 to oldest.
+  {
+    Cache::iterator test_item = cache.Get(kItem1Key);
+    ASSERT_TRUE(test_item != cache.end());
+    EXPECT_EQ(kItem1Key, test_item->first);
+
+    Cache::reverse_iterator oldest = cache.rbegin();
+    ASSERT_TRUE(oldest != cache.rend());
+    EXPECT_EQ(kItem2Key, oldest->first);
+    EXPECT_EQ(item2.value, oldest->second.value);
+  }
+
+  // Check that Peek doesn't change ordering.
+  {
+    Cache::iterator peeked = cache.Peek(kItem2Key);
+    ASSERT_TRUE(peeked != cache.end());
+    EXPECT_EQ(kItem2Key, cache.rbegin()->first);
+
+    const Cache& const_cache = cache;
+    Cache::const_iterator const_peeked = const_cache.Peek(kItem2Key);
+    EXPECT_TRUE(const_peeked == peeked);
+  }
+
+  // Remove the oldest item and check that item1 is now the only member.
+  {
+    Cache::reverse_iterator next = cache.Erase(cache.rbegin());
+
+    EXPECT_EQ(1U, cache.size());
+
+    EXPECT_TRUE(next == cache.rbegin());
+    EXPECT_EQ(kItem1Key, next->first);
+    EXPECT_EQ(item1.value, next->second.value);
+
+    cache.Erase(cache.begin());
+    EXPECT_EQ(0U, cache.size());
+    EXPECT_TRUE(cache.Peek(kItem1Key) == cache.end());
+  }
+
+  // Check that Clear() works properly.
+  cache.Put(kItem1Key, item1);
+  cache.Put(kItem2Key, item2);
+  EXPECT_EQ(2U, cache.size());
+  cache.Clear();
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_TRUE(cache.Get(kItem1Key) == cache.end());
+}
+
+TEST(IntrusiveMRUCacheTest, KeyReplacement) {
+  typedef base::IntrusiveMRUCache<int, CachedItem> Cache;
+  Cache cache(Cache::NO_AUTO_EVICT);
+
+  for (int i = 1; i <= 4; ++i)
+    cache.Put(i, CachedItem(i * 10));
+
+  CachedItem item5(50);
+  cache.Put(3, item5);
+  EXPECT_EQ(4U, cache.size());
+
+  // Make it so only the most important element is there.
+  cache.ShrinkToSize(1);
+
+  Cache::iterator iter = cache.begin();
+  EXPECT_EQ(3, iter->first);
+  EXPECT_EQ(item5.value, iter->second.value);
+}
+
+TEST(IntrusiveMRUCacheTest, AutoEvict) {
+  typedef base::IntrusiveMRUCache<int, CachedItem> Cache;
+  static const Cache::size_type kMaxSize = 3;
+
+  int initial_count = cached_item_live_count;
+
+  {
+    Cache cache(kMaxSize);
+    for (int i = 0; i < 100; ++i)
+      cache.Put(i, CachedItem(i));
+
+    // The cache should only have the kMaxSize most recent items in it even
+    // though we inserted more.
+    EXPECT_EQ(kMaxSize, cache.size());
+    EXPECT_EQ(initial_count + static_cast<int>(kMaxSize),
+              cached_item_live_count);
+    EXPECT_TRUE(cache.Peek(96) == cache.end());
+    for (int i = 97; i < 100; ++i)
+      EXPECT_EQ(i, cache.Peek(i)->second.value);
+  }
+
+  // There should be no objects leaked.
+  EXPECT_EQ(initial_count, cached_item_live_count);
+}
+
+TEST(IntrusiveMRUCacheTest, ManyKeys) {
+  typedef base::IntrusiveMRUCache<int, int> Cache;
+  Cache cache(Cache::NO_AUTO_EVICT);
+  for (int i = 0; i < 10000; ++i)
+    cache.Put(i, -i);
+  EXPECT_EQ(10000U, cache.size());
+  for (int i = 0; i < 10000; i += 2)
+    cache.Erase(cache.Peek(i));
+  for (int i = 0; i < 10000; ++i) {
+    if (i % 2)
+      EXPECT_EQ(-i, cache.Get(i)->second);
+    else
+      EXPECT_TRUE(cache.Get(i) == cache.end());
+  }
+
+  // Iteration goes from the most to the least recently used item.
+  int expected = 9999;
+  for (Cache::const_iterator it = cache.begin(); it != cache.end(); ++it) {
+    EXPECT_EQ(expected, it->first);
+    expected -= 2;
+  }
+  EXPECT_EQ(-1, expected);
+}
+
+TEST(IntrusiveMRUCacheTest, WeightedEviction) {
+  typedef base::IntrusiveMRUCache<int, std::string,
+                                  BASE_HASH_NAMESPACE::hash<int>,
+                                  StringWeigher> Cache;
+  Cache cache(10);
+
+  cache.Put(1, "aaaa");
+  cache.Put(2, "bbbb");
+  EXPECT_EQ(8U, cache.total_weight());
+
+  // Does not fit next to both items, so the oldest one goes.
+  cache.Put(3, "ccc");
+  EXPECT_EQ(2U, cache.size());
+  EXPECT_EQ(7U, cache.total_weight());
+  EXPECT_TRUE(cache.Peek(1) == cache.end());
+
+  // Replacing an item only counts the new payload.
+  cache.Put(2, "bbbbbbb");
+  EXPECT_EQ(10U, cache.total_weight());
+  EXPECT_EQ(2U, cache.size());
+
+  // An item heavier than the whole cache evicts everything else but is kept.
+  cache.Put(4, "dddddddddddd");
+  EXPECT_EQ(1U, cache.size());
+  EXPECT_EQ(12U, cache.total_weight());
+  EXPECT_EQ("dddddddddddd", cache.Get(4)->second);
+
+  cache.ShrinkToSize(0);
+  EXPECT_TRUE(cache.empty());
+  EXPECT_EQ(0U, cache.total_weight());
+}
+
+TEST(IntrusiveMRUCacheTest, StringKeys) {
+  typedef base::IntrusiveMRUCache<std::string, CachedItem> Cache;
+  Cache cache(Cache::NO_AUTO_EVICT);
+
+  CachedItem one(1);
+  cache.Put("First", one);
+
+  CachedItem two(2);
+  cache.Put("Second", two);
+
+  EXPECT_EQ(one.value, cache.Get("First")->second.value);
+  EXPECT_EQ(two.value, cache.Get("Second")->second.value);
+  cache.ShrinkToSize(1);
+  EXPECT_EQ(two.value, cache.Get("Second")->second.value);
+  EXPECT_TRUE(cache.Get("First") == cache.end());
+}
@@ -0,0 +1,77 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/intrusive_mru_cache.h"
+#include "base/containers/mru_cache.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_time_logger.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const size_t kCacheSize = 100000;
+const size_t kNumOperations = 2000000;
+
+// Returns |count| pseudo-random keys in [0, |range|).
+std::vector<int> MakeKeys(size_t count, int range) {
+  std::vector<int> keys;
+  keys.reserve(count);
+  uint64 state = 1;
+  for (size_t i = 0; i < count; ++i) {
+    state = state * GG_UINT64_C(6364136223846793005) +
+            GG_UINT64_C(1442695040888963407);
+    keys.push_back(static_cast<int>((state >> 33) % range));
+  }
+  return keys;
+}
+
+// Times filling a |Cache|, looking up its items, and a Get-or-Put workload
+// over twice as many keys as fit, so that half of the accesses evict.
+template <typename Cache>
+void RunCacheTest(const char* cache_name) {
+  Cache cache(kCacheSize);
+  {
+    PerfTimeLogger timer(StringPrintf("%s_Put", cache_name).c_str());
+    for (size_t i = 0; i < kCacheSize; ++i)
+      cache.Put(static_cast<int>(i), static_cast<int>(i));
+  }
+  ASSERT_EQ(kCacheSize, cache.size());
+
+  std::vector<int> hit_keys = MakeKeys(kNumOperations, kCacheSize);
+  int sum = 0;
+  {
+    PerfTimeLogger timer(StringPrintf("%s_GetHit", cache_name).c_str());
+    for (size_t i = 0; i < hit_keys.size(); ++i)
+      sum += cache.Get(hit_keys[i])->second;
+  }
+  EXPECT_NE(0, sum);
+
+  std::vector<int> churn_keys = MakeKeys(kNumOperations, 2 * kCacheSize);
+  size_t misses = 0;
+  {
+    PerfTimeLogger timer(StringPrintf("%s_Churn", cache_name).c_str());
+    for (size_t i = 0; i < churn_keys.size(); ++i) {
+      if (cache.Get(churn_keys[i]) == cache.end()) {
+        cache.Put(churn_keys[i], churn_keys[i]);
+        ++misses;
+      }
+    }
+  }
+  EXPECT_GT(misses, 0u);
+  EXPECT_EQ(kCacheSize, cache.size());
+}
+
+}  // namespace
+
+TEST(MRUCachePerfTest, IntKeys) {
+  RunCacheTest<HashingMRUCache<int, int> >("HashingMRUCache");
+  RunCacheTest<IntrusiveMRUCache<int, int> >("IntrusiveMRUCache");
+}
+
+}  // namespace base
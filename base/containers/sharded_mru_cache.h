@@ -0,0 +1,173 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// ShardedMRUCache is a thread-safe Most Recently Used cache. It splits its
+// items over |kNumShards| IntrusiveMRUCaches by key hash, each guarded by its
+// own lock, so that threads touching different keys rarely contend.
+//
+// Recency is tracked per shard: an eviction removes the least recently used
+// item of the shard the new item goes to, which approximates global LRU order
+// when keys are spread evenly. The size budget is split between the shards so
+// that their budgets add up to exactly the total; when it is smaller than
+// |kNumShards|, the shards without a share keep nothing.
+//
+// Since other threads may evict an item at any time, the interface copies
+// payloads out instead of returning iterators. Payloads should therefore be
+// cheap to copy, e.g. scoped_refptrs or small values.
+
+#ifndef BASE_CONTAINERS_SHARDED_MRU_CACHE_H_
+#define BASE_CONTAINERS_SHARDED_MRU_CACHE_H_
+
+#include <stddef.h>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/containers/intrusive_mru_cache.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+
+namespace base {
+
+template <class KeyType,
+          class PayloadType,
+          size_t kNumShards = 16,
+          class HashType = BASE_HASH_NAMESPACE::hash<KeyType>,
+          class WeigherType = MRUCacheUnitWeigher<PayloadType> >
+class ShardedMRUCache {
+ private:
+  typedef IntrusiveMRUCache<KeyType, PayloadType, HashType, WeigherType>
+      ShardCache;
+
+ public:
+  typedef typename ShardCache::size_type size_type;
+
+  enum { NO_AUTO_EVICT = ShardCache::NO_AUTO_EVICT };
+
+  // |max_size| is the total budget of all shards, in Weigher units. As for
+  // MRUCache, NO_AUTO_EVICT (0) does not restrict the size.
+  explicit ShardedMRUCache(size_type max_size)
+      : max_size_(max_size) {
+    COMPILE_ASSERT(kNumShards > 0, sharded_mru_cache_needs_a_shard);
+    for (size_t i = 0; i < kNumShards; ++i) {
+      size_type shard_size = ShardSize(max_size, i);
+      shards_[i].keeps_nothing =
+          max_size != NO_AUTO_EVICT && shard_size == 0;
+      shards_[i].cache.reset(new ShardCache(shard_size));
+    }
+  }
+
+  size_type max_size() const { return max_size_; }
+
+  // Inserts or replaces the payload for |key|, evicting the least recently
+  // used items of its shard if needed.
+  void Put(const KeyType& key, const PayloadType& payload) {
+    Shard& shard = ShardFor(key);
+    AutoLock lock(shard.lock);
+    if (shard.keeps_nothing) {
+      // A budget of zero would mean NO_AUTO_EVICT to the shard.
+      typename ShardCache::iterator it = shard.cache->Peek(key);
+      if (it != shard.cache->end())
+        shard.cache->Erase(it);
+      return;
+    }
+    shard.cache->Put(key, payload);
+  }
+
+  // Copies the payload for |key| to |payload| and marks it as most recently
+  // used. Returns false if |key| is not in the cache.
+  bool Get(const KeyType& key, PayloadType* payload) {
+    Shard& shard = ShardFor(key);
+    AutoLock lock(shard.lock);
+    typename ShardCache::iterator it = shard.cache->Get(key);
+    if (it == shard.cache->end())
+      return false;
+    *payload = it->second;
+    return true;
+  }
+
+  // Like Get(), without affecting the recency order.
+  bool Peek(const KeyType& key, PayloadType* payload) {
+    Shard& shard = ShardFor(key);
+    AutoLock lock(shard.lock);
+    typename ShardCache::iterator it = shard.cache->Peek(key);
+    if (it == shard.cache->end())
+      return false;
+    *payload = it->second;
+    return true;
+  }
+
+  // Removes |key| from the cache. Returns false if it was not there.
+  bool Erase(const KeyType& key) {
+    Shard& shard = ShardFor(key);
+    AutoLock lock(shard.lock);
+    typename ShardCache::iterator it = shard.cache->Peek(key);
+    if (it == shard.cache->end())
+      return false;
+    shard.cache->Erase(it);
+    return true;
+  }
+
+  // Shrinks every shard to its share of |new_size|, which is split the same
+  // way as the budget.
+  void ShrinkToSize(size_type new_size) {
+    for (size_t i = 0; i < kNumShards; ++i) {
+      AutoLock lock(shards_[i].lock);
+      shards_[i].cache->ShrinkToSize(ShardSize(new_size, i));
+    }
+  }
+
+  // Deletes everything from the cache.
+  void Clear() {
+    for (size_t i = 0; i < kNumShards; ++i) {
+      AutoLock lock(shards_[i].lock);
+      shards_[i].cache->Clear();
+    }
+  }
+
+  // Returns the number of items in the cache. Since other threads may modify
+  // the shards concurrently, this is only a snapshot.
+  size_type size() const {
+    size_type size = 0;
+    for (size_t i = 0; i < kNumShards; ++i) {
+      AutoLock lock(shards_[i].lock);
+      size += shards_[i].cache->size();
+    }
+    return size;
+  }
+
+ private:
+  struct Shard {
+    // Mutable so that size() can be const.
+    mutable Lock lock;
+    scoped_ptr<ShardCache> cache;
+    // True if the shard got no share of a limited budget.
+    bool keeps_nothing;
+  };
+
+  // Returns the share of |total| of shard |index|. The first
+  // |total % kNumShards| shards get one more than the others, so that the
+  // shares add up to |total|.
+  static size_type ShardSize(size_type total, size_t index) {
+    return total / kNumShards + (index < total % kNumShards ? 1 : 0);
+  }
+
+  Shard& ShardFor(const KeyType& key) {
+    // Spread identity hashes (of integers and aligned pointers) with the same
+    // multiplication as the shards do, but select the shard from middle bits:
+    // the shards index their buckets with the top bits, which would otherwise
+    // be the same for all keys of a shard.
+    uint32 mixed = static_cast<uint32>(hasher_(key)) * 0x9E3779B9u;
+    return shards_[(mixed >> 8) % kNumShards];
+  }
+
+  const size_type max_size_;
+  HashType hasher_;
+  Shard shards_[kNumShards];
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedMRUCache);
+};
+
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_SHARDED_MRU_CACHE_H_
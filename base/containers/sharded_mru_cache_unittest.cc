@@ -0,0 +1,124 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/containers/sharded_mru_cache.h"
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_vector.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+typedef ShardedMRUCache<int, int, 4> Cache;
+
+// Puts, gets and erases its own range of keys.
+class CacheUser : public DelegateSimpleThread::Delegate {
+ public:
+  CacheUser(Cache* cache, int first_key)
+      : cache_(cache), first_key_(first_key), hits_(0) {}
+
+  void Run() override {
+    for (int i = 0; i < 10000; ++i) {
+      int key = first_key_ + i % 100;
+      int payload = 0;
+      if (cache_->Get(key, &payload)) {
+        EXPECT_EQ(key * 2, payload);
+        ++hits_;
+      }
+      cache_->Put(key, key * 2);
+      if (i % 7 == 0)
+        cache_->Erase(key);
+    }
+  }
+
+  int hits() const { return hits_; }
+
+ private:
+  Cache* cache_;
+  const int first_key_;
+  int hits_;
+
+  DISALLOW_COPY_AND_ASSIGN(CacheUser);
+};
+
+}  // namespace
+
+TEST(ShardedMRUCacheTest, Basic) {
+  Cache cache(Cache::NO_AUTO_EVICT);
+  int payload = 0;
+  EXPECT_FALSE(cache.Get(1, &payload));
+  EXPECT_FALSE(cache.Peek(1, &payload));
+  EXPECT_FALSE(cache.Erase(1));
+
+  for (int i = 0; i < 100; ++i)
+    cache.Put(i, i + 1000);
+  EXPECT_EQ(100U, cache.size());
+
+  EXPECT_TRUE(cache.Get(42, &payload));
+  EXPECT_EQ(1042, payload);
+  EXPECT_TRUE(cache.Peek(43, &payload));
+  EXPECT_EQ(1043, payload);
+
+  cache.Put(42, 7);
+  EXPECT_TRUE(cache.Get(42, &payload));
+  EXPECT_EQ(7, payload);
+  EXPECT_EQ(100U, cache.size());
+
+  EXPECT_TRUE(cache.Erase(42));
+  EXPECT_FALSE(cache.Get(42, &payload));
+  EXPECT_EQ(99U, cache.size());
+
+  cache.Clear();
+  EXPECT_EQ(0U, cache.size());
+}
+
+TEST(ShardedMRUCacheTest, AutoEvict) {
+  Cache cache(40);
+  for (int i = 0; i < 1000; ++i)
+    cache.Put(i, i);
+  // Each shard holds at most 10 items.
+  EXPECT_LE(cache.size(), 40U);
+  int payload = 0;
+  EXPECT_FALSE(cache.Get(0, &payload));
+
+  cache.ShrinkToSize(0);
+  EXPECT_EQ(0U, cache.size());
+}
+
+// Checks that the shards never hold more than the budget, even when it does
+// not divide evenly between them.
+TEST(ShardedMRUCacheTest, UnevenBudget) {
+  for (size_t max_size = 1; max_size <= 9; ++max_size) {
+    Cache cache(max_size);
+    for (int i = 0; i < 1000; ++i)
+      cache.Put(i, i);
+    EXPECT_LE(cache.size(), max_size);
+    EXPECT_GT(cache.size(), 0U);
+
+    cache.ShrinkToSize(max_size - 1);
+    EXPECT_LE(cache.size(), max_size - 1);
+  }
+}
+
+TEST(ShardedMRUCacheTest, ConcurrentUse) {
+  Cache cache(1000);
+  ScopedVector<CacheUser> users;
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < 4; ++i) {
+    users.push_back(new CacheUser(&cache, i * 100));
+    threads.push_back(
+        new DelegateSimpleThread(users.back(), "ShardedMRUCacheTest"));
+    threads.back()->Start();
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->Join();
+    EXPECT_GT(users[i]->hits(), 0);
+  }
+  EXPECT_LE(cache.size(), 400U);
+}
+
+}  // namespace base
@@ -88,6 +88,11 @@ TEST(CPU, RunExtendedInstructions) {
     // Execute an SSE 4.2 instruction.
     __asm__ __volatile__("crc32 %%eax, %%eax\n" : : : "eax");
   }
+
+  if (cpu.has_pclmul()) {
+    // Execute a carry-less multiplication.
+    __asm__ __volatile__("pclmulqdq $0, %%xmm0, %%xmm0\n" : : : "xmm0");
+  }
 #endif
 #endif
 }
@@ -54,6 +54,21 @@ BASE_EXPORT std::string RandBytesAsString(size_t length);
 BASE_EXPORT int GetUrandomFD();
 #endif
 
+#if defined(OS_POSIX) && !defined(OS_NACL)
+namespace internal {
+
+// Writes |num_blocks| 64-byte blocks of the ChaCha20 key stream (RFC 7539)
+// for |key| and |nonce| to |output|, starting at block |counter|. This is the
+// generator behind RandBytes(), exposed for testing.
+BASE_EXPORT void ChaCha20KeyStream(const uint8 key[32],
+                                   const uint8 nonce[12],
+                                   uint32 counter,
+                                   uint8* output,
+                                   size_t num_blocks);
+
+}  // namespace internal
+#endif
+
 }  // namespace base
 
 #endif  // BASE_RAND_UTIL_H_
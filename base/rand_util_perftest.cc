@@ -0,0 +1,55 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/rand_util.h"
+
+#include "base/basictypes.h"
+#include "base/files/file_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_time_logger.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kNumCalls = 200000;
+
+}  // namespace
+
+// Times small RandBytes() requests, such as connection IDs and masking keys,
+// against reading the same amount from /dev/urandom, which is what
+// RandBytes() does on each call without its per-thread generator.
+TEST(RandUtilPerfTest, SmallRequests) {
+  const size_t kSizes[] = {4, 8, 16, 64};
+  char buffer[64];
+  for (size_t i = 0; i < arraysize(kSizes); ++i) {
+    {
+      PerfTimeLogger timer(
+          StringPrintf("RandBytes_%d", static_cast<int>(kSizes[i])).c_str());
+      for (int j = 0; j < kNumCalls; ++j)
+        RandBytes(buffer, kSizes[i]);
+    }
+#if defined(OS_POSIX)
+    {
+      PerfTimeLogger timer(
+          StringPrintf("Urandom_%d", static_cast<int>(kSizes[i])).c_str());
+      for (int j = 0; j < kNumCalls; ++j)
+        ASSERT_TRUE(ReadFromFD(GetUrandomFD(), buffer, kSizes[i]));
+    }
+#endif
+  }
+}
+
+TEST(RandUtilPerfTest, RandUint64) {
+  uint64 sum = 0;
+  {
+    PerfTimeLogger timer("RandUint64");
+    for (int i = 0; i < kNumCalls; ++i)
+      sum ^= RandUint64();
+  }
+  EXPECT_NE(0u, sum);
+}
+
+}  // namespace base
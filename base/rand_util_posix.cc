@@ -6,11 +6,17 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
+
+#include "base/atomicops.h"
 #include "base/files/file_util.h"
 #include "base/lazy_instance.h"
 #include "base/logging.h"
+#include "base/threading/thread_local_storage.h"
 
 namespace {
 
@@ -34,10 +40,176 @@ class URandomFd {
 
 base::LazyInstance<URandomFd>::Leaky g_urandom_fd = LAZY_INSTANCE_INITIALIZER;
 
+// RandBytes() serves requests from a per-thread ChaCha20 key stream, so that
+// the small requests that most callers make need neither a system call nor a
+// lock. The generator is keyed from /dev/urandom (the getrandom() system call
+// is not allowed by all sandbox policies), and:
+//  - it rekeys itself with the first 32 bytes of every batch of key stream
+//    it generates, and wipes the bytes it hands out, so that its state does
+//    not reveal earlier output ("fast key erasure");
+//  - it mixes in fresh bytes from /dev/urandom after every
+//    |kReseedInterval| bytes of output;
+//  - it reseeds after fork(), so that parent and child never share output.
+
+const size_t kChaChaBlockSize = 64;
+const size_t kKeySize = 32;
+// Key stream generated per refill, including the next key.
+const size_t kStreamBlocks = 8;
+const size_t kStreamSize = kStreamBlocks * kChaChaBlockSize;
+const size_t kReseedInterval = 1024 * 1024;
+
+struct ThreadRandState {
+  uint8 key[kKeySize];
+  // Key stream; the bytes before |used| have been handed out and wiped.
+  uint8 stream[kStreamSize];
+  size_t used;
+  size_t bytes_since_seed;
+  base::subtle::Atomic32 fork_generation;
+};
+
+// Incremented in the child after each fork().
+base::subtle::Atomic32 g_fork_generation = 0;
+
+void OnForkInChild() {
+  base::subtle::NoBarrier_AtomicIncrement(&g_fork_generation, 1);
+}
+
+void DeleteThreadRandState(void* value) {
+  ThreadRandState* state = static_cast<ThreadRandState*>(value);
+  memset(state, 0, sizeof(*state));
+  delete state;
+}
+
+// Owns the thread-local slot, and registers the fork handler along with it.
+class ThreadRandSlot {
+ public:
+  ThreadRandSlot() : slot_(&DeleteThreadRandState) {
+    pthread_atfork(NULL, NULL, &OnForkInChild);
+  }
+
+  ThreadRandState* Get() const {
+    return static_cast<ThreadRandState*>(slot_.Get());
+  }
+
+  void Set(ThreadRandState* state) { slot_.Set(state); }
+
+ private:
+  base::ThreadLocalStorage::Slot slot_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadRandSlot);
+};
+
+base::LazyInstance<ThreadRandSlot>::Leaky g_thread_rand_slot =
+    LAZY_INSTANCE_INITIALIZER;
+
+void Refill(ThreadRandState* state) {
+  static const uint8 kZeroNonce[12] = {0};
+  // A fresh key is used for every refill, so the counter starts from zero.
+  base::internal::ChaCha20KeyStream(state->key, kZeroNonce, 0, state->stream,
+                                    kStreamBlocks);
+  memcpy(state->key, state->stream, kKeySize);
+  memset(state->stream, 0, kKeySize);
+  state->used = kKeySize;
+}
+
+void Reseed(ThreadRandState* state) {
+  uint8 seed[kKeySize];
+  const bool success = base::ReadFromFD(g_urandom_fd.Pointer()->fd(),
+                                        reinterpret_cast<char*>(seed),
+                                        sizeof(seed));
+  CHECK(success);
+  for (size_t i = 0; i < kKeySize; ++i)
+    state->key[i] ^= seed[i];
+  memset(seed, 0, sizeof(seed));
+  state->bytes_since_seed = 0;
+  state->fork_generation = base::subtle::NoBarrier_Load(&g_fork_generation);
+  // Drop the key stream of the previous key.
+  Refill(state);
+}
+
+ThreadRandState* GetThreadRandState() {
+  ThreadRandSlot* slot = g_thread_rand_slot.Pointer();
+  ThreadRandState* state = slot->Get();
+  if (!state) {
+    state = new ThreadRandState;
+    memset(state, 0, sizeof(*state));
+    Reseed(state);
+    slot->Set(state);
+  } else if (state->fork_generation !=
+                 base::subtle::NoBarrier_Load(&g_fork_generation) ||
+             state->bytes_since_seed >= kReseedInterval) {
+    Reseed(state);
+  }
+  return state;
+}
+
+uint32 Load32(const uint8* bytes) {
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+         (static_cast<uint32>(bytes[3]) << 24);
+}
+
+void Store32(uint32 value, uint8* bytes) {
+  bytes[0] = value & 0xff;
+  bytes[1] = (value >> 8) & 0xff;
+  bytes[2] = (value >> 16) & 0xff;
+  bytes[3] = value >> 24;
+}
+
+inline uint32 Rotate(uint32 value, int bits) {
+  return (value << bits) | (value >> (32 - bits));
+}
+
+inline void QuarterRound(uint32* x, int a, int b, int c, int d) {
+  x[a] += x[b];
+  x[d] = Rotate(x[d] ^ x[a], 16);
+  x[c] += x[d];
+  x[b] = Rotate(x[b] ^ x[c], 12);
+  x[a] += x[b];
+  x[d] = Rotate(x[d] ^ x[a], 8);
+  x[c] += x[d];
+  x[b] = Rotate(x[b] ^ x[c], 7);
+}
+
 }  // namespace
 
 namespace base {
 
+namespace internal {
+
+void ChaCha20KeyStream(const uint8 key[32],
+                       const uint8 nonce[12],
+                       uint32 counter,
+                       uint8* output,
+                       size_t num_blocks) {
+  // "expand 32-byte k"
+  uint32 input[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+  for (int i = 0; i < 8; ++i)
+    input[4 + i] = Load32(key + 4 * i);
+  for (int i = 0; i < 3; ++i)
+    input[13 + i] = Load32(nonce + 4 * i);
+
+  for (size_t block = 0; block < num_blocks; ++block) {
+    input[12] = counter++;
+    uint32 x[16];
+    memcpy(x, input, sizeof(x));
+    for (int round = 0; round < 20; round += 2) {
+      QuarterRound(x, 0, 4, 8, 12);
+      QuarterRound(x, 1, 5, 9, 13);
+      QuarterRound(x, 2, 6, 10, 14);
+      QuarterRound(x, 3, 7, 11, 15);
+      QuarterRound(x, 0, 5, 10, 15);
+      QuarterRound(x, 1, 6, 11, 12);
+      QuarterRound(x, 2, 7, 8, 13);
+      QuarterRound(x, 3, 4, 9, 14);
+    }
+    for (int i = 0; i < 16; ++i)
+      Store32(x[i] + input[i], output + 4 * i);
+    output += kChaChaBlockSize;
+  }
+}
+
+}  // namespace internal
+
 // NOTE: This function must be cryptographically secure. http://crbug.com/140076
 uint64 RandUint64() {
   uint64 number;
@@ -46,10 +218,20 @@ uint64 RandUint64() {
 }
 
 void RandBytes(void* output, size_t output_length) {
-  const int urandom_fd = g_urandom_fd.Pointer()->fd();
-  const bool success =
-      ReadFromFD(urandom_fd, static_cast<char*>(output), output_length);
-  CHECK(success);
+  ThreadRandState* state = GetThreadRandState();
+  uint8* out = static_cast<uint8*>(output);
+  size_t remaining = output_length;
+  while (remaining > 0) {
+    if (state->used == kStreamSize)
+      Refill(state);
+    size_t n = std::min(remaining, kStreamSize - state->used);
+    memcpy(out, state->stream + state->used, n);
+    memset(state->stream + state->used, 0, n);
+    state->used += n;
+    out += n;
+    remaining -= n;
+  }
+  state->bytes_since_seed += output_length;
 }
 
 int GetUrandomFD(void) {
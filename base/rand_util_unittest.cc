@@ -12,6 +12,13 @@
 #include "base/time/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
+#if defined(OS_POSIX) && !defined(OS_NACL)
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "base/posix/eintr_wrapper.h"
+#endif
+
 namespace {
 
 const int kIntMin = std::numeric_limits<int>::min();
@@ -124,6 +131,78 @@ TEST(RandUtilTest, RandUint64ProducesBothValuesOfAllBits) {
   FAIL() << "Didn't achieve all bit values in maximum number of tries.";
 }
 
+TEST(RandUtilTest, LargeRandBytes) {
+  // Spans several batches of the generator's key stream.
+  const size_t kBufferSize = 100000;
+  scoped_ptr<uint8[]> first(new uint8[kBufferSize]);
+  scoped_ptr<uint8[]> second(new uint8[kBufferSize]);
+  base::RandBytes(first.get(), kBufferSize);
+  base::RandBytes(second.get(), kBufferSize);
+  EXPECT_NE(0, memcmp(first.get(), second.get(), kBufferSize));
+  EXPECT_NE(0, memcmp(first.get(), first.get() + kBufferSize / 2,
+                      kBufferSize / 2));
+}
+
+#if defined(OS_POSIX) && !defined(OS_NACL)
+
+// Test vector from section 2.3.2 of RFC 7539.
+TEST(RandUtilTest, ChaCha20KeyStream) {
+  uint8 key[32];
+  for (size_t i = 0; i < sizeof(key); ++i)
+    key[i] = static_cast<uint8>(i);
+  const uint8 kNonce[12] = {0, 0, 0, 0x09, 0, 0, 0, 0x4a, 0, 0, 0, 0};
+  const uint8 kExpected[64] = {
+    0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15,
+    0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+    0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03,
+    0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+    0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09,
+    0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+    0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9,
+    0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e,
+  };
+
+  uint8 output[128];
+  base::internal::ChaCha20KeyStream(key, kNonce, 0, output, 2);
+  EXPECT_EQ(0, memcmp(kExpected, output + 64, sizeof(kExpected)));
+
+  base::internal::ChaCha20KeyStream(key, kNonce, 1, output, 1);
+  EXPECT_EQ(0, memcmp(kExpected, output, sizeof(kExpected)));
+}
+
+// RandBytes() buffers per thread, so a forked child must not repeat the
+// output of its parent.
+TEST(RandUtilTest, ForkedChildGetsDifferentBytes) {
+  // Make sure the generator of this thread is set up before forking.
+  base::RandUint64();
+
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    uint64 child_value = base::RandUint64();
+    ssize_t written =
+        HANDLE_EINTR(write(fds[1], &child_value, sizeof(child_value)));
+    _exit(written == sizeof(child_value) ? 0 : 1);
+  }
+  close(fds[1]);
+
+  uint64 parent_value = base::RandUint64();
+  uint64 child_value = 0;
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(child_value)),
+            HANDLE_EINTR(read(fds[0], &child_value, sizeof(child_value))));
+  close(fds[0]);
+
+  int status = 0;
+  ASSERT_EQ(pid, HANDLE_EINTR(waitpid(pid, &status, 0)));
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  EXPECT_NE(parent_value, child_value);
+}
+
+#endif  // defined(OS_POSIX) && !defined(OS_NACL)
+
 // Benchmark test for RandBytes().  Disabled since it's intentionally slow and
 // does not test anything that isn't already tested by the existing RandBytes()
 // tests.
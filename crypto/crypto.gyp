@@ -17,6 +17,7 @@
       'dependencies': [
         '../base/base.gyp:base',
         '../base/third_party/dynamic_annotations/dynamic_annotations.gyp:dynamic_annotations',
+        'crypto_pclmul',
       ],
       'defines': [
         'CRYPTO_IMPLEMENTATION',
@@ -148,6 +149,37 @@
         '<@(crypto_sources)',
       ],
     },
+    {
+      # The PCLMULQDQ code for GaloisHash, built with the flags that enable
+      # the instruction. crypto only calls it after checking that the CPU
+      # supports it.
+      'target_name': 'crypto_pclmul',
+      'type': 'static_library',
+      'include_dirs': [
+        '..',
+      ],
+      'sources': [
+        'ghash_pclmul.cc',
+        'ghash_pclmul.h',
+      ],
+      'conditions': [
+        ['OS!="ios" and (target_arch=="ia32" or target_arch=="x64")', {
+          'cflags': ['-mpclmul', '-mssse3'],
+          'xcode_settings': {
+            'OTHER_CFLAGS': ['-mpclmul', '-mssse3'],
+          },
+          'conditions': [
+            ['OS=="win" and clang==1', {
+              'msvs_settings': {
+                'VCCLCompilerTool': {
+                  'AdditionalOptions': ['-mpclmul', '-mssse3'],
+                },
+              },
+            }],
+          ],
+        }],
+      ],
+    },
     {
       'target_name': 'crypto_unittests',
       'type': 'executable',
@@ -223,6 +255,27 @@
         }],
       ],
     },
+    {
+      'target_name': 'crypto_perftests',
+      'type': 'executable',
+      'sources': [
+        'ghash_perftest.cc',
+        'hmac_perftest.cc',
+        'sha2_perftest.cc',
+      ],
+      'dependencies': [
+        'crypto',
+        '../base/base.gyp:base',
+        '../base/base.gyp:test_support_perf',
+        '../testing/gtest.gyp:gtest',
+      ],
+      'conditions': [
+        [ 'OS == "win"', {
+          # TODO(jschuh): crbug.com/167187 fix size_t to int truncations.
+          'msvs_disabled_warnings': [4267, ],
+        }],
+      ],
+    },
   ],
   'conditions': [
     ['OS == "win" and target_arch=="ia32"', {
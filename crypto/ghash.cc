@@ -6,8 +6,11 @@
 
 #include <algorithm>
 
+#include "base/cpu.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/sys_byteorder.h"
+#include "crypto/ghash_pclmul.h"
 
 namespace crypto {
 
@@ -46,9 +49,28 @@ int Reverse(int i) {
   return i;
 }
 
+#if defined(CRYPTO_GHASH_USE_PCLMUL)
+// Checks the CPU once, since GaloisHash is created for every GCM operation.
+class PCLMULSupport {
+ public:
+  PCLMULSupport() {
+    base::CPU cpu;
+    supported_ = cpu.has_pclmul() && cpu.has_ssse3();
+  }
+
+  bool supported() const { return supported_; }
+
+ private:
+  bool supported_;
+};
+
+base::LazyInstance<PCLMULSupport>::Leaky g_pclmul_support =
+    LAZY_INSTANCE_INITIALIZER;
+#endif
+
 }  // namespace
 
-GaloisHash::GaloisHash(const uint8 key[16]) {
+GaloisHash::GaloisHash(const uint8 key[16]) : use_pclmul_(false) {
   Reset();
 
   // We precompute 16 multiples of |key|. However, when we do lookups into this
@@ -65,6 +87,20 @@ GaloisHash::GaloisHash(const uint8 key[16]) {
     product_table_[Reverse(i)] = Double(product_table_[Reverse(i/2)]);
     product_table_[Reverse(i+1)] = Add(product_table_[Reverse(i)], x);
   }
+
+#if defined(CRYPTO_GHASH_USE_PCLMUL)
+  COMPILE_ASSERT(arraysize(pclmul_powers_) == internal::kGHashPCLMULStride,
+                 pclmul_powers_size_mismatch);
+  if (g_pclmul_support.Get().supported()) {
+    use_pclmul_ = true;
+    const uint64 h[2] = {x.low, x.hi};
+    internal::GHashPowersPCLMUL(h, pclmul_powers_);
+  }
+#endif
+}
+
+void GaloisHash::DisablePCLMULForTesting() {
+  use_pclmul_ = false;
 }
 
 void GaloisHash::Reset() {
@@ -114,9 +150,10 @@ void GaloisHash::Finish(void* output, size_t len) {
 
   // The lengths of the additional data and ciphertext are included as the last
   // block. The lengths are the number of bits.
-  y_.low ^= additional_bytes_*8;
-  y_.hi ^= ciphertext_bytes_*8;
-  MulAfterPrecomputation(product_table_, &y_);
+  uint8 lengths[16];
+  Put64(lengths, additional_bytes_*8);
+  Put64(lengths + 8, ciphertext_bytes_*8);
+  UpdateBlocks(lengths, 1);
 
   uint8 *result, result_tmp[16];
   if (len >= 16) {
@@ -220,6 +257,16 @@ void GaloisHash::Mul16(FieldElement* x) {
 }
 
 void GaloisHash::UpdateBlocks(const uint8* bytes, size_t num_blocks) {
+#if defined(CRYPTO_GHASH_USE_PCLMUL)
+  if (use_pclmul_) {
+    uint64 y[2] = {y_.low, y_.hi};
+    internal::GHashBlocksPCLMUL(pclmul_powers_, y, bytes, num_blocks);
+    y_.low = y[0];
+    y_.hi = y[1];
+    return;
+  }
+#endif
+
   for (size_t i = 0; i < num_blocks; i++) {
     y_.low ^= Get64(bytes);
     bytes += 8;
@@ -25,6 +25,9 @@ namespace crypto {
 //
 // WARNING: this code is not constant time. However, in all likelihood, nor is
 // the implementation of AES that is used.
+//
+// On x86 CPUs with the PCLMULQDQ instruction, the hash is computed with
+// carry-less multiplications instead of the portable table-driven code.
 class CRYPTO_EXPORT_PRIVATE GaloisHash {
  public:
   explicit GaloisHash(const uint8 key[16]);
@@ -45,6 +48,10 @@ class CRYPTO_EXPORT_PRIVATE GaloisHash {
   // the result to |output|.
   void Finish(void* output, size_t len);
 
+  // Makes this instance use the portable implementation even when the CPU
+  // supports PCLMULQDQ, so that tests can compare the two.
+  void DisablePCLMULForTesting();
+
  private:
   enum State {
     kHashingAdditionalData,
@@ -81,6 +88,10 @@ class CRYPTO_EXPORT_PRIVATE GaloisHash {
   uint8 buf_[16];
   size_t buf_used_;
   FieldElement product_table_[16];
+  // Whether UpdateBlocks uses PCLMULQDQ, in which case |pclmul_powers_| holds
+  // the first powers of the key as {low, hi} pairs.
+  bool use_pclmul_;
+  uint64 pclmul_powers_[4][2];
 };
 
 }  // namespace crypto
@@ -0,0 +1,151 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crypto/ghash_pclmul.h"
+
+#if defined(CRYPTO_GHASH_USE_PCLMUL)
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+namespace crypto {
+namespace internal {
+
+// This follows "Intel Carry-Less Multiplication Instruction and its Usage for
+// Computing the GCM Mode" by Gueron and Kounavis. GHASH defines its field
+// elements with reflected bit order; byte-swapping a block leaves the bits of
+// each byte reflected, so multiplying two byte-swapped elements as ordinary
+// polynomials gives the reflected product shifted right by one bit. The
+// reduction shifts it back before reducing modulo x^128+x^7+x^2+x+1.
+//
+// Since the shift and the reduction are linear, the products of several
+// blocks with successive powers of the key can be summed unreduced and
+// reduced once ("aggregated reduction"):
+//   Y' = (Y+X1)*H^4 + X2*H^3 + X3*H^2 + X4*H
+
+namespace {
+
+// Loads a {low, hi} field element into the byte-swapped representation.
+__m128i LoadElement(const uint64 x[2]) {
+  // Swapping the 64-bit halves of {low, hi} byte-swaps the 16-byte block
+  // that Get64() read them from.
+  return _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(x)), 0x4e);
+}
+
+void StoreElement(__m128i v, uint64 x[2]) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(x), _mm_shuffle_epi32(v, 0x4e));
+}
+
+__m128i LoadBlock(const uint8* bytes, __m128i byte_swap_mask) {
+  return _mm_shuffle_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes)),
+      byte_swap_mask);
+}
+
+// Adds the unreduced 256-bit product |a|*|b| to |lo|, |mid| and |hi|.
+void MultiplyAccumulate(__m128i a,
+                        __m128i b,
+                        __m128i* lo,
+                        __m128i* mid,
+                        __m128i* hi) {
+  *lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+  *hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+  *mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(a, b, 0x10));
+  *mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(a, b, 0x01));
+}
+
+// Returns the field element for the 256-bit product lo + mid*x^64 + hi*x^128.
+__m128i Reduce(__m128i lo, __m128i mid, __m128i hi) {
+  lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+  hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+  // Shift the product left by one bit.
+  __m128i lo_carry = _mm_srli_epi32(lo, 31);
+  __m128i hi_carry = _mm_srli_epi32(hi, 31);
+  lo = _mm_slli_epi32(lo, 1);
+  hi = _mm_slli_epi32(hi, 1);
+  __m128i cross_carry = _mm_srli_si128(lo_carry, 12);
+  lo_carry = _mm_slli_si128(lo_carry, 4);
+  hi_carry = _mm_slli_si128(hi_carry, 4);
+  lo = _mm_or_si128(lo, lo_carry);
+  hi = _mm_or_si128(hi, hi_carry);
+  hi = _mm_or_si128(hi, cross_carry);
+
+  // Reduce the low half into the high half.
+  __m128i t = _mm_xor_si128(
+      _mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)),
+      _mm_slli_epi32(lo, 25));
+  __m128i t_high = _mm_srli_si128(t, 4);
+  lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+  __m128i u = _mm_xor_si128(
+      _mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)),
+      _mm_xor_si128(_mm_srli_epi32(lo, 7), t_high));
+  lo = _mm_xor_si128(lo, u);
+  return _mm_xor_si128(hi, lo);
+}
+
+__m128i Multiply(__m128i a, __m128i b) {
+  __m128i lo = _mm_setzero_si128();
+  __m128i mid = _mm_setzero_si128();
+  __m128i hi = _mm_setzero_si128();
+  MultiplyAccumulate(a, b, &lo, &mid, &hi);
+  return Reduce(lo, mid, hi);
+}
+
+}  // namespace
+
+void GHashPowersPCLMUL(const uint64 key[2],
+                       uint64 powers[kGHashPCLMULStride][2]) {
+  const __m128i h = LoadElement(key);
+  __m128i power = h;
+  StoreElement(power, powers[0]);
+  for (size_t i = 1; i < kGHashPCLMULStride; ++i) {
+    power = Multiply(power, h);
+    StoreElement(power, powers[i]);
+  }
+}
+
+void GHashBlocksPCLMUL(const uint64 powers[kGHashPCLMULStride][2],
+                       uint64 y[2],
+                       const uint8* bytes,
+                       size_t num_blocks) {
+  const __m128i byte_swap_mask =
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i h1 = LoadElement(powers[0]);
+  const __m128i h2 = LoadElement(powers[1]);
+  const __m128i h3 = LoadElement(powers[2]);
+  const __m128i h4 = LoadElement(powers[3]);
+  __m128i acc = LoadElement(y);
+
+  for (; num_blocks >= kGHashPCLMULStride; num_blocks -= kGHashPCLMULStride) {
+    __m128i lo = _mm_setzero_si128();
+    __m128i mid = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    MultiplyAccumulate(
+        _mm_xor_si128(acc, LoadBlock(bytes, byte_swap_mask)), h4,
+        &lo, &mid, &hi);
+    MultiplyAccumulate(LoadBlock(bytes + 16, byte_swap_mask), h3,
+                       &lo, &mid, &hi);
+    MultiplyAccumulate(LoadBlock(bytes + 32, byte_swap_mask), h2,
+                       &lo, &mid, &hi);
+    MultiplyAccumulate(LoadBlock(bytes + 48, byte_swap_mask), h1,
+                       &lo, &mid, &hi);
+    acc = Reduce(lo, mid, hi);
+    bytes += 16 * kGHashPCLMULStride;
+  }
+
+  for (; num_blocks > 0; --num_blocks) {
+    acc = Multiply(_mm_xor_si128(acc, LoadBlock(bytes, byte_swap_mask)), h1);
+    bytes += 16;
+  }
+
+  StoreElement(acc, y);
+}
+
+}  // namespace internal
+}  // namespace crypto
+
+#endif  // CRYPTO_GHASH_USE_PCLMUL
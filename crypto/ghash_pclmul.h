@@ -0,0 +1,46 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CRYPTO_GHASH_PCLMUL_H_
+#define CRYPTO_GHASH_PCLMUL_H_
+
+#include "base/basictypes.h"
+#include "build/build_config.h"
+
+// GHASH with the PCLMULQDQ carry-less multiplication instruction, used by
+// GaloisHash on CPUs that support it. This lives in its own file since it is
+// built with the compiler flags that enable the instruction.
+#if defined(ARCH_CPU_X86_FAMILY) && !defined(OS_IOS)
+#define CRYPTO_GHASH_USE_PCLMUL 1
+#endif
+
+#if defined(CRYPTO_GHASH_USE_PCLMUL)
+
+namespace crypto {
+namespace internal {
+
+// The number of blocks that GHashBlocksPCLMUL() folds into one reduction.
+const size_t kGHashPCLMULStride = 4;
+
+// Field elements are passed as {low, hi} pairs of 64-bit words, as in
+// GaloisHash::FieldElement.
+
+// Sets |powers|[i] to |key|^(i+1) for i = 0..kGHashPCLMULStride-1.
+void GHashPowersPCLMUL(const uint64 key[2],
+                       uint64 powers[kGHashPCLMULStride][2]);
+
+// Processes |num_blocks| 16-byte blocks from |bytes|, updating the hash state
+// |y|. |powers| must come from GHashPowersPCLMUL(). The caller must have
+// checked that the CPU supports PCLMULQDQ and SSSE3.
+void GHashBlocksPCLMUL(const uint64 powers[kGHashPCLMULStride][2],
+                       uint64 y[2],
+                       const uint8* bytes,
+                       size_t num_blocks);
+
+}  // namespace internal
+}  // namespace crypto
+
+#endif  // CRYPTO_GHASH_USE_PCLMUL
+
+#endif  // CRYPTO_GHASH_PCLMUL_H_
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <algorithm>
+#include <vector>
 
 #include "crypto/ghash.h"
 
@@ -143,6 +144,52 @@ TEST(GaloisHash, VaryLengths) {
   }
 }
 
+// Checks the portable implementation too, in case the CPU supports PCLMULQDQ.
+TEST(GaloisHash, PortableTestCases) {
+  uint8 out[16];
+
+  for (size_t i = 0; i < arraysize(kTestCases); ++i) {
+    const TestCase& test = kTestCases[i];
+
+    GaloisHash hash(test.key);
+    hash.DisablePCLMULForTesting();
+    if (test.additional_length)
+      hash.UpdateAdditional(test.additional, test.additional_length);
+    if (test.ciphertext_length)
+      hash.UpdateCiphertext(test.ciphertext, test.ciphertext_length);
+    hash.Finish(out, sizeof(out));
+    EXPECT_TRUE(0 == memcmp(out, test.expected, 16));
+  }
+}
+
+// Compares the default and the portable implementations on inputs of all
+// lengths up to several multiples of the blocks processed per reduction.
+TEST(GaloisHash, MatchesPortable) {
+  std::vector<uint8> data(200);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<uint8>(i * 37 + 11);
+
+  for (size_t length = 0; length < data.size(); ++length) {
+    GaloisHash hash(kKey3);
+    GaloisHash portable_hash(kKey3);
+    portable_hash.DisablePCLMULForTesting();
+
+    size_t additional_length = length / 3;
+    hash.UpdateAdditional(&data[0], additional_length);
+    hash.UpdateCiphertext(&data[0] + additional_length,
+                          length - additional_length);
+    portable_hash.UpdateAdditional(&data[0], additional_length);
+    portable_hash.UpdateCiphertext(&data[0] + additional_length,
+                                   length - additional_length);
+
+    uint8 out[16];
+    uint8 portable_out[16];
+    hash.Finish(out, sizeof(out));
+    portable_hash.Finish(portable_out, sizeof(portable_out));
+    EXPECT_TRUE(0 == memcmp(out, portable_out, 16)) << length;
+  }
+}
+
 }  // namespace
 
 }  // namespace crypto
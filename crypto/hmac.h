@@ -65,6 +65,16 @@ class CRYPTO_EXPORT HMAC {
   bool Sign(const base::StringPiece& data, unsigned char* digest,
             size_t digest_length) const WARN_UNUSED_RESULT;
 
+  // Calculates the HMACs of the |num_messages| messages in |data|, as if by
+  // calling Sign() on each of them, and stores them one after the other in
+  // |digests|, which has |num_messages| * |digest_length| bytes of storage
+  // available. The keyed hash state is only set up once for the whole batch,
+  // which makes this notably cheaper than Sign() for many short messages.
+  bool SignBatch(const base::StringPiece* data,
+                 size_t num_messages,
+                 unsigned char* digests,
+                 size_t digest_length) const WARN_UNUSED_RESULT;
+
   // Verifies that the HMAC for the message in |data| equals the HMAC provided
   // in |digest|, using the algorithm supplied to the constructor and the key
   // supplied to the Init method. Use of this method is strongly recommended
@@ -114,4 +114,41 @@ bool HMAC::Sign(const base::StringPiece& data,
   return true;
 }
 
+bool HMAC::SignBatch(const base::StringPiece* data,
+                     size_t num_messages,
+                     unsigned char* digests,
+                     size_t digest_length) const {
+  if (!plat_->sym_key_.get()) {
+    // Init has not been called before SignBatch.
+    NOTREACHED();
+    return false;
+  }
+
+  // A single context is restarted with PK11_DigestBegin() for every message.
+  SECItem param = { siBuffer, NULL, 0 };
+  ScopedPK11Context context(PK11_CreateContextBySymKey(plat_->mechanism_,
+                                                       CKA_SIGN,
+                                                       plat_->sym_key_.get(),
+                                                       &param));
+  if (!context.get()) {
+    NOTREACHED();
+    return false;
+  }
+
+  for (size_t i = 0; i < num_messages; ++i) {
+    unsigned int len = 0;
+    if (PK11_DigestBegin(context.get()) != SECSuccess ||
+        PK11_DigestOp(context.get(),
+                      reinterpret_cast<const unsigned char*>(data[i].data()),
+                      data[i].length()) != SECSuccess ||
+        PK11_DigestFinal(context.get(), digests + i * digest_length, &len,
+                         digest_length) != SECSuccess) {
+      NOTREACHED();
+      return false;
+    }
+  }
+
+  return true;
+}
+
 }  // namespace crypto
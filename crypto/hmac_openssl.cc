@@ -61,4 +61,29 @@ bool HMAC::Sign(const base::StringPiece& data,
                 result.safe_buffer(), NULL);
 }
 
+bool HMAC::SignBatch(const base::StringPiece* data,
+                     size_t num_messages,
+                     unsigned char* digests,
+                     size_t digest_length) const {
+  DCHECK(!plat_->key.empty());  // Init must be called before SignBatch.
+
+  // The first HMAC_Init_ex() computes the padded key states; the later ones
+  // only copy them back into the context.
+  HMAC_CTX ctx;
+  HMAC_CTX_init(&ctx);
+  bool ok = !!HMAC_Init_ex(&ctx, &plat_->key[0], plat_->key.size(),
+                           hash_alg_ == SHA1 ? EVP_sha1() : EVP_sha256(),
+                           NULL);
+  for (size_t i = 0; ok && i < num_messages; ++i) {
+    ScopedOpenSSLSafeSizeBuffer<EVP_MAX_MD_SIZE> result(
+        digests + i * digest_length, digest_length);
+    ok = (i == 0 || HMAC_Init_ex(&ctx, NULL, 0, NULL, NULL)) &&
+         HMAC_Update(&ctx, reinterpret_cast<const uint8_t*>(data[i].data()),
+                     data[i].size()) &&
+         HMAC_Final(&ctx, result.safe_buffer(), NULL);
+  }
+  HMAC_CTX_cleanup(&ctx);
+  return ok;
+}
+
 }  // namespace crypto
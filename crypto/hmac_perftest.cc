@@ -0,0 +1,56 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "crypto/hmac.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace crypto {
+
+namespace {
+
+const size_t kNumMessages = 10000;
+const size_t kSHA256DigestSize = 32;
+
+}  // namespace
+
+// Compares SignBatch() against one Sign() per message, for several message
+// sizes.
+TEST(HMACPerfTest, SignBatch) {
+  const std::string key(64, '\xaa');
+  HMAC hmac(HMAC::SHA256);
+  ASSERT_TRUE(hmac.Init(key));
+
+  for (size_t size = 64; size <= 4096; size *= 4) {
+    std::string message(size, 'x');
+    std::vector<base::StringPiece> data(kNumMessages, message);
+    std::vector<unsigned char> digests(kNumMessages * kSHA256DigestSize);
+
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    for (size_t i = 0; i < kNumMessages; ++i) {
+      ASSERT_TRUE(hmac.Sign(data[i], &digests[i * kSHA256DigestSize],
+                            kSHA256DigestSize));
+    }
+    const base::TimeDelta single = base::TimeTicks::HighResNow() - start;
+
+    start = base::TimeTicks::HighResNow();
+    ASSERT_TRUE(hmac.SignBatch(&data[0], kNumMessages, &digests[0],
+                               kSHA256DigestSize));
+    const base::TimeDelta batch = base::TimeTicks::HighResNow() - start;
+
+    const std::string name = "HMAC_SHA256_" + base::SizeTToString(size);
+    base::LogPerfResult((name + "_Sign").c_str(),
+                        single.InMicroseconds() * 1000.0 / kNumMessages, "ns");
+    base::LogPerfResult((name + "_SignBatch").c_str(),
+                        batch.InMicroseconds() * 1000.0 / kNumMessages, "ns");
+  }
+}
+
+}  // namespace crypto
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <string>
+#include <vector>
 
 #include "crypto/hmac.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -293,3 +294,37 @@ TEST(HMACTest, EmptyKey) {
   EXPECT_TRUE(hmac.Verify(
       data, base::StringPiece(kExpectedDigest, kSHA1DigestSize)));
 }
+
+TEST(HMACTest, SignBatch) {
+  std::vector<std::string> messages;
+  for (size_t size = 0; size < 300; size += 37)
+    messages.push_back(std::string(size, static_cast<char>('a' + size % 26)));
+  std::vector<base::StringPiece> data(messages.begin(), messages.end());
+
+  crypto::HMAC hmac(crypto::HMAC::SHA256);
+  ASSERT_TRUE(hmac.Init(reinterpret_cast<const unsigned char*>(kSimpleKey),
+                        kSimpleKeyLength));
+
+  std::vector<unsigned char> digests(data.size() * kSHA256DigestSize);
+  EXPECT_TRUE(hmac.SignBatch(&data[0], data.size(), &digests[0],
+                             kSHA256DigestSize));
+  for (size_t i = 0; i < data.size(); ++i) {
+    EXPECT_TRUE(hmac.Verify(
+        data[i],
+        base::StringPiece(
+            reinterpret_cast<const char*>(&digests[i * kSHA256DigestSize]),
+            kSHA256DigestSize)));
+  }
+
+  // Truncated digests are stored back to back.
+  const size_t kTruncatedSize = 12;
+  std::vector<unsigned char> truncated(data.size() * kTruncatedSize);
+  EXPECT_TRUE(hmac.SignBatch(&data[0], data.size(), &truncated[0],
+                             kTruncatedSize));
+  for (size_t i = 0; i < data.size(); ++i) {
+    EXPECT_EQ(0, memcmp(&digests[i * kSHA256DigestSize],
+                        &truncated[i * kTruncatedSize], kTruncatedSize));
+  }
+
+  EXPECT_TRUE(hmac.SignBatch(NULL, 0, NULL, kSHA256DigestSize));
+}
@@ -206,4 +206,17 @@ bool HMAC::Sign(const base::StringPiece& data,
   return !!CryptGetHashParam(hash, HP_HASHVAL, digest, &sha1_size, 0);
 }
 
+bool HMAC::SignBatch(const base::StringPiece* data,
+                     size_t num_messages,
+                     unsigned char* digests,
+                     size_t digest_length) const {
+  // CryptoAPI hash objects cannot be restarted, so there is nothing to share
+  // between the messages.
+  for (size_t i = 0; i < num_messages; ++i) {
+    if (!Sign(data[i], digests + i * digest_length, digest_length))
+      return false;
+  }
+  return true;
+}
+
 }  // namespace crypto
@@ -27,6 +27,11 @@ class CRYPTO_EXPORT SecureHash {
   virtual void Update(const void* input, size_t len) = 0;
   virtual void Finish(void* output, size_t len) = 0;
 
+  // Discards any input so far, so that the context can compute a new hash
+  // without being recreated. Must be called after Finish() before the next
+  // Update().
+  virtual void Reset() = 0;
+
   // Serialize the context, so it can be restored at a later time.
   // |pickle| will contain the serialized data.
   // Returns whether or not |pickle| was filled.
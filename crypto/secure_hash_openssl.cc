@@ -40,6 +40,10 @@ class SecureHashSHA256OpenSSL : public SecureHash {
     SHA256_Final(result.safe_buffer(), &ctx_);
   }
 
+  virtual void Reset() override {
+    SHA256_Init(&ctx_);
+  }
+
   virtual bool Serialize(Pickle* pickle) override;
   virtual bool Deserialize(PickleIterator* data_iterator) override;
 
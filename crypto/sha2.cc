@@ -22,4 +22,20 @@ std::string SHA256HashString(const base::StringPiece& str) {
   return output;
 }
 
+void SHA256HashBatch(const base::StringPiece* inputs,
+                     size_t num_inputs,
+                     void* output) {
+  if (num_inputs == 0)
+    return;
+  scoped_ptr<SecureHash> ctx(SecureHash::Create(SecureHash::SHA256));
+  uint8* digest = static_cast<uint8*>(output);
+  for (size_t i = 0; i < num_inputs; ++i) {
+    if (i > 0)
+      ctx->Reset();
+    ctx->Update(inputs[i].data(), inputs[i].length());
+    ctx->Finish(digest, kSHA256Length);
+    digest += kSHA256Length;
+  }
+}
+
 }  // namespace crypto
@@ -28,6 +28,15 @@ CRYPTO_EXPORT void SHA256HashString(const base::StringPiece& str,
 // string.
 CRYPTO_EXPORT std::string SHA256HashString(const base::StringPiece& str);
 
+// Computes the SHA-256 hashes of the |num_inputs| strings in |inputs| and
+// stores them one after the other in |output|, which must have room for
+// |num_inputs| * kSHA256Length bytes. This is cheaper than hashing the inputs
+// one at a time with SHA256HashString() when they are short, since a single
+// hash context is set up for the whole batch.
+CRYPTO_EXPORT void SHA256HashBatch(const base::StringPiece* inputs,
+                                   size_t num_inputs,
+                                   void* output);
+
 }  // namespace crypto
 
 #endif  // CRYPTO_SHA2_H_
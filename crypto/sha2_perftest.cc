@@ -0,0 +1,51 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crypto/sha2.h"
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace crypto {
+
+namespace {
+
+const size_t kNumInputs = 10000;
+
+}  // namespace
+
+// Compares SHA256HashBatch() against one SHA256HashString() per input, for
+// several input sizes.
+TEST(Sha256PerfTest, Batch) {
+  for (size_t size = 64; size <= 4096; size *= 4) {
+    std::string input(size, 'x');
+    std::vector<base::StringPiece> inputs(kNumInputs, input);
+    std::vector<uint8> output(kNumInputs * kSHA256Length);
+
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    for (size_t i = 0; i < kNumInputs; ++i) {
+      SHA256HashString(inputs[i], &output[i * kSHA256Length], kSHA256Length);
+    }
+    const base::TimeDelta single = base::TimeTicks::HighResNow() - start;
+
+    start = base::TimeTicks::HighResNow();
+    SHA256HashBatch(&inputs[0], kNumInputs, &output[0]);
+    const base::TimeDelta batch = base::TimeTicks::HighResNow() - start;
+
+    const std::string name = "SHA256_" + base::SizeTToString(size);
+    base::LogPerfResult((name + "_HashString").c_str(),
+                        single.InMicroseconds() * 1000.0 / kNumInputs, "ns");
+    base::LogPerfResult((name + "_HashBatch").c_str(),
+                        batch.InMicroseconds() * 1000.0 / kNumInputs, "ns");
+  }
+}
+
+}  // namespace crypto
@@ -4,6 +4,9 @@
 
 #include "crypto/sha2.h"
 
+#include <string>
+#include <vector>
+
 #include "base/basictypes.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -98,3 +101,23 @@ TEST(Sha256Test, Test3) {
   for (size_t i = 0; i < sizeof(output_truncated3); i++)
     EXPECT_EQ(expected3[i], static_cast<int>(output_truncated3[i]));
 }
+
+TEST(Sha256Test, Batch) {
+  std::vector<std::string> inputs;
+  inputs.push_back("abc");
+  inputs.push_back("");
+  inputs.push_back(std::string(1000, 'a'));
+  inputs.push_back("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq");
+  std::vector<base::StringPiece> pieces(inputs.begin(), inputs.end());
+
+  std::vector<uint8> output(inputs.size() * crypto::kSHA256Length);
+  crypto::SHA256HashBatch(&pieces[0], pieces.size(), &output[0]);
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    EXPECT_EQ(crypto::SHA256HashString(inputs[i]),
+              std::string(reinterpret_cast<const char*>(
+                              &output[i * crypto::kSHA256Length]),
+                          crypto::kSHA256Length));
+  }
+
+  crypto::SHA256HashBatch(NULL, 0, NULL);
+}
@@ -185,6 +185,11 @@ CertVerifyProc::CertVerifyProc() {}
 
 CertVerifyProc::~CertVerifyProc() {}
 
+bool CertVerifyProc::GetRootStoreFingerprint(
+    SHA1HashValue* fingerprint) const {
+  return false;
+}
+
 int CertVerifyProc::Verify(X509Certificate* cert,
                            const std::string& hostname,
                            int flags,
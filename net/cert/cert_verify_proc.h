@@ -66,6 +66,13 @@ class NET_EXPORT CertVerifyProc
   // passed to Verify() is ignored when this returns false.
   virtual bool SupportsAdditionalTrustAnchors() const = 0;
 
+  // Sets |*fingerprint| to a hash that changes when the set of root
+  // certificates the implementation trusts does, so that results verified
+  // against another set of roots can be told apart. Returns false if the
+  // implementation can't tell, which is the default. This may block, and
+  // must not be called on a thread that disallows I/O.
+  virtual bool GetRootStoreFingerprint(SHA1HashValue* fingerprint) const;
+
  protected:
   CertVerifyProc();
   virtual ~CertVerifyProc();
@@ -9,8 +9,10 @@
 #include <string>
 #include <vector>
 
+#include "base/files/file_util.h"
 #include "base/logging.h"
 #include "base/sha1.h"
+#include "base/strings/string_number_conversions.h"
 #include "crypto/openssl_util.h"
 #include "crypto/scoped_openssl_types.h"
 #include "crypto/sha2.h"
@@ -190,6 +192,32 @@ bool CertVerifyProcOpenSSL::SupportsAdditionalTrustAnchors() const {
   return false;
 }
 
+bool CertVerifyProcOpenSSL::GetRootStoreFingerprint(
+    SHA1HashValue* fingerprint) const {
+  // The store loads the roots lazily from the default file and directory, so
+  // it can't be enumerated. Adding or removing a root changes the size or the
+  // modification time of one of them.
+  std::string state;
+  const char* paths[] = { X509_get_default_cert_file(),
+                          X509_get_default_cert_dir() };
+  for (size_t i = 0; i < arraysize(paths); ++i) {
+    base::File::Info info;
+    state.append(paths[i]);
+    state.push_back('\0');
+    if (!base::GetFileInfo(base::FilePath(paths[i]), &info))
+      continue;
+    state.append(base::Int64ToString(info.size));
+    state.push_back(':');
+    state.append(base::Int64ToString(info.last_modified.ToInternalValue()));
+    state.push_back('\0');
+  }
+  if (TestRootCerts::HasInstance() && !TestRootCerts::GetInstance()->IsEmpty())
+    state.append("test roots");
+  base::SHA1HashBytes(reinterpret_cast<const unsigned char*>(state.data()),
+                      state.size(), fingerprint->data);
+  return true;
+}
+
 int CertVerifyProcOpenSSL::VerifyInternal(
     X509Certificate* cert,
     const std::string& hostname,
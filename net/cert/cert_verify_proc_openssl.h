@@ -15,6 +15,8 @@ class CertVerifyProcOpenSSL : public CertVerifyProc {
   CertVerifyProcOpenSSL();
 
   virtual bool SupportsAdditionalTrustAnchors() const override;
+  virtual bool GetRootStoreFingerprint(
+      SHA1HashValue* fingerprint) const override;
 
  protected:
   virtual ~CertVerifyProcOpenSSL();
@@ -0,0 +1,96 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/cert/cert_verify_result_persister.h"
+
+#include "base/bind.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "base/sequenced_task_runner.h"
+#include "base/task_runner_util.h"
+#include "net/cert/cert_verify_proc.h"
+
+namespace net {
+
+struct CertVerifyResultPersister::LoadedResults {
+  LoadedResults() : has_root_store_fingerprint(false) {}
+
+  std::string data;
+  bool has_root_store_fingerprint;
+  SHA1HashValue root_store_fingerprint;
+};
+
+namespace {
+
+// Reads the file, and gets the fingerprint of the root certificates from
+// |verify_proc|, which may block too.
+CertVerifyResultPersister::LoadedResults LoadResults(
+    const scoped_refptr<CertVerifyProc>& verify_proc,
+    const base::FilePath& path) {
+  CertVerifyResultPersister::LoadedResults results;
+  results.has_root_store_fingerprint =
+      verify_proc->GetRootStoreFingerprint(&results.root_store_fingerprint);
+  if (!base::ReadFileToString(path, &results.data))
+    results.data.clear();
+  return results;
+}
+
+}  // namespace
+
+CertVerifyResultPersister::CertVerifyResultPersister(
+    MultiThreadedCertVerifier* verifier,
+    const base::FilePath& path,
+    const scoped_refptr<base::SequencedTaskRunner>& background_runner)
+    : verifier_(verifier),
+      writer_(path, background_runner),
+      weak_ptr_factory_(this) {
+  verifier_->SetCacheObserver(this);
+
+  base::PostTaskAndReplyWithResult(
+      background_runner.get(),
+      FROM_HERE,
+      base::Bind(&LoadResults,
+                 make_scoped_refptr(verifier_->verify_proc()), path),
+      base::Bind(&CertVerifyResultPersister::CompleteLoad,
+                 weak_ptr_factory_.GetWeakPtr()));
+}
+
+CertVerifyResultPersister::~CertVerifyResultPersister() {
+  DCHECK(CalledOnValidThread());
+
+  if (writer_.HasPendingWrite())
+    writer_.DoScheduledWrite();
+
+  verifier_->SetCacheObserver(NULL);
+}
+
+void CertVerifyResultPersister::OnCacheChanged() {
+  DCHECK(CalledOnValidThread());
+  writer_.ScheduleWrite(this);
+}
+
+bool CertVerifyResultPersister::SerializeData(std::string* data) {
+  DCHECK(CalledOnValidThread());
+
+  Pickle pickle;
+  verifier_->SerializeCache(&pickle);
+  data->assign(reinterpret_cast<const char*>(pickle.data()), pickle.size());
+  return true;
+}
+
+void CertVerifyResultPersister::CompleteLoad(const LoadedResults& results) {
+  DCHECK(CalledOnValidThread());
+
+  if (results.has_root_store_fingerprint)
+    verifier_->SetRootStoreFingerprint(results.root_store_fingerprint);
+  if (results.data.empty())
+    return;
+
+  Pickle pickle(results.data.data(), static_cast<int>(results.data.size()));
+  if (!verifier_->ImportCache(pickle))
+    LOG(ERROR) << "Failed to deserialize certificate verification results";
+}
+
+}  // namespace net
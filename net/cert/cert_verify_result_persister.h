@@ -0,0 +1,75 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_CERT_CERT_VERIFY_RESULT_PERSISTER_H_
+#define NET_CERT_CERT_VERIFY_RESULT_PERSISTER_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/files/important_file_writer.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/threading/non_thread_safe.h"
+#include "net/base/net_export.h"
+#include "net/cert/multi_threaded_cert_verifier.h"
+
+namespace base {
+class SequencedTaskRunner;
+}
+
+namespace net {
+
+// Keeps the results cached by a MultiThreadedCertVerifier in a file, so that
+// connections made soon after a restart don't have to verify certificates
+// again. The file is read on |background_runner| at construction, and its
+// results are imported once loaded. Changes to the cache are then written
+// back in batches.
+//
+// Only successful results which haven't expired are written, along with a
+// fingerprint of the root certificates and additional trust anchors they were
+// verified against. Results verified against another CRLSet than the current
+// one are dropped on import, the whole file is discarded if the fingerprint
+// doesn't match, and nothing is written if the verifier's CertVerifyProc can't
+// fingerprint its root certificates. The file is cleared whenever the
+// verifier's cache is, e.g. when a CA certificate changes.
+//
+// Clients of this class should create, destroy, and call into it from the
+// verifier's thread, and destroy it before the verifier.
+class NET_EXPORT_PRIVATE CertVerifyResultPersister
+    : public MultiThreadedCertVerifier::CacheObserver,
+      public base::ImportantFileWriter::DataSerializer,
+      NON_EXPORTED_BASE(public base::NonThreadSafe) {
+ public:
+  CertVerifyResultPersister(
+      MultiThreadedCertVerifier* verifier,
+      const base::FilePath& path,
+      const scoped_refptr<base::SequencedTaskRunner>& background_runner);
+  ~CertVerifyResultPersister() override;
+
+  // MultiThreadedCertVerifier::CacheObserver implementation.
+  void OnCacheChanged() override;
+
+  // ImportantFileWriter::DataSerializer implementation.
+  bool SerializeData(std::string* data) override;
+
+  // What is read on the background runner.
+  struct LoadedResults;
+
+ private:
+  void CompleteLoad(const LoadedResults& results);
+
+  MultiThreadedCertVerifier* const verifier_;
+
+  base::ImportantFileWriter writer_;
+
+  base::WeakPtrFactory<CertVerifyResultPersister> weak_ptr_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(CertVerifyResultPersister);
+};
+
+}  // namespace net
+
+#endif  // NET_CERT_CERT_VERIFY_RESULT_PERSISTER_H_
@@ -9,15 +9,52 @@
 
 namespace net {
 
+namespace {
+
+// kSPKIHashLength is the length of the SPKI hashes in a compact CRLSet.
+const size_t kSPKIHashLength = sizeof(SHA256HashValue);
+
+uint16 ReadUint16(const uint8* p) {
+  uint16 value;
+  memcpy(&value, p, sizeof(value));  // assumes little-endian.
+  return value;
+}
+
+uint32 ReadUint32(const uint8* p) {
+  uint32 value;
+  memcpy(&value, p, sizeof(value));  // assumes little-endian.
+  return value;
+}
+
+}  // namespace
+
+CRLSet::CompactTable::CompactTable()
+    : num_keys(0),
+      keys(NULL),
+      num_buckets(0),
+      displacements(NULL),
+      num_slots(0),
+      slots(NULL) {
+}
+
 CRLSet::CRLSet()
     : sequence_(0),
-      not_after_(0) {
+      not_after_(0),
+      compact_crl_offsets_(NULL),
+      compact_serials_(NULL),
+      compact_serials_len_(0) {
 }
 
 CRLSet::~CRLSet() {
 }
 
 CRLSet::Result CRLSet::CheckSPKI(const base::StringPiece& spki_hash) const {
+  if (compact_data_.get()) {
+    uint32 index;
+    return FindInCompactTable(compact_blocked_spkis_, spki_hash, &index) ?
+        REVOKED : GOOD;
+  }
+
   for (std::vector<std::string>::const_iterator i = blocked_spkis_.begin();
        i != blocked_spkis_.end(); ++i) {
     if (spki_hash.size() == i->size() &&
@@ -44,6 +81,13 @@ CRLSet::Result CRLSet::CheckSerial(
   while (serial.size() > 1 && serial[0] == 0x00)
     serial.remove_prefix(1);
 
+  if (compact_data_.get()) {
+    uint32 crl_index;
+    if (!FindInCompactTable(compact_issuers_, issuer_spki_hash, &crl_index))
+      return UNKNOWN;
+    return CompactCRLHasSerial(crl_index, serial) ? REVOKED : GOOD;
+  }
+
   base::hash_map<std::string, size_t>::const_iterator i =
       crls_index_by_issuer_.find(issuer_spki_hash.as_string());
   if (i == crls_index_by_issuer_.end())
@@ -75,6 +119,129 @@ const CRLSet::CRLList& CRLSet::crls() const {
   return crls_;
 }
 
+// static
+uint32 CRLSet::CompactBucket(const uint8* key, uint32 num_buckets) {
+  // The keys are SHA-256 hashes, so their bytes are already well mixed.
+  return ReadUint32(key) % num_buckets;
+}
+
+// static
+uint32 CRLSet::CompactSlot(const uint8* key,
+                           uint16 displacement,
+                           uint32 num_slots) {
+  uint32 h = ReadUint32(key + 4) ^ (displacement * 0x9e3779b9u);
+  // The finalizer of MurmurHash3, so that each displacement gives an
+  // unrelated slot.
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h % num_slots;
+}
+
+// static
+bool CRLSet::FindInCompactTable(const CompactTable& table,
+                                const base::StringPiece& key,
+                                uint32* index) {
+  if (table.num_slots == 0 || key.size() != kSPKIHashLength)
+    return false;
+
+  const uint8* key_bytes = reinterpret_cast<const uint8*>(key.data());
+  const uint16 displacement = ReadUint16(
+      table.displacements + 2 * CompactBucket(key_bytes, table.num_buckets));
+  const uint32 i = ReadUint32(
+      table.slots + 4 * CompactSlot(key_bytes, displacement, table.num_slots));
+  // Empty slots hold 0xffffffff.
+  if (i >= table.num_keys ||
+      memcmp(table.keys + kSPKIHashLength * i, key_bytes,
+             kSPKIHashLength) != 0) {
+    return false;
+  }
+
+  *index = i;
+  return true;
+}
+
+bool CRLSet::CompactCRLHasSerial(uint32 crl_index,
+                                 const base::StringPiece& serial) const {
+  // CRLSetStorage::ParseCompact checked the structure of the serials, but
+  // the offsets are still checked against their bounds here because the
+  // data may be a file mapped in memory.
+  const uint32 begin = ReadUint32(compact_crl_offsets_ + 4 * crl_index);
+  const uint32 end = ReadUint32(compact_crl_offsets_ + 4 * (crl_index + 1));
+  if (begin > end || end > compact_serials_len_ || end - begin < 8)
+    return false;
+
+  const uint8* const crl = compact_serials_ + begin;
+  const uint32 num_serials = ReadUint32(crl);
+  const bool has_order = ReadUint32(crl + 4) != 0;
+  const uint32 num_restarts = num_serials / kCompactRestartInterval +
+      (num_serials % kCompactRestartInterval != 0);
+  const uint8* const restarts = crl + 8;
+  const uint64 header_len =
+      8 + 4 * static_cast<uint64>(num_restarts) +
+      (has_order ? 4 * static_cast<uint64>(num_serials) : 0);
+  if (header_len > end - begin)
+    return false;
+  const uint8* const entries = crl + header_len;
+  const size_t entries_len = end - begin - header_len;
+
+  // Find the first restart point after |serial|. Restart points are stored
+  // in full: each is a zero-length prefix followed by the serial.
+  uint32 lo = 0;
+  uint32 hi = num_restarts;
+  while (lo < hi) {
+    const uint32 mid = lo + (hi - lo) / 2;
+    const size_t offset = ReadUint32(restarts + 4 * mid);
+    if (offset + 2 > entries_len ||
+        entries[offset + 1] > entries_len - offset - 2) {
+      return false;
+    }
+    const int cmp = base::StringPiece(
+        reinterpret_cast<const char*>(entries + offset + 2),
+        entries[offset + 1]).compare(serial);
+    if (cmp == 0)
+      return true;
+    if (cmp < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0)
+    return false;
+
+  // Scan the block that starts with the last restart point before |serial|.
+  size_t offset = ReadUint32(restarts + 4 * (lo - 1));
+  const size_t block_end =
+      lo < num_restarts ? ReadUint32(restarts + 4 * lo) : entries_len;
+  if (block_end > entries_len)
+    return false;
+  char key[255];
+  size_t key_len = 0;
+  while (offset + 2 <= block_end) {
+    const uint8 shared = entries[offset];
+    const uint8 suffix_len = entries[offset + 1];
+    offset += 2;
+    if (shared > key_len || suffix_len > block_end - offset ||
+        shared + suffix_len > static_cast<int>(sizeof(key))) {
+      return false;
+    }
+    memcpy(key + shared, entries + offset, suffix_len);
+    key_len = shared + suffix_len;
+    offset += suffix_len;
+
+    const int cmp = base::StringPiece(key, key_len).compare(serial);
+    if (cmp == 0)
+      return true;
+    if (cmp > 0)
+      return false;
+  }
+
+  return false;
+}
+
 // static
 CRLSet* CRLSet::EmptyCRLSetForTesting() {
   return ForTesting(false, NULL, "");
@@ -11,6 +11,7 @@
 
 #include "base/containers/hash_tables.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/strings/string_piece.h"
 #include "net/base/net_export.h"
 #include "net/cert/x509_cert_types.h"
@@ -57,7 +58,7 @@ class NET_EXPORT CRLSet : public base::RefCountedThreadSafe<CRLSet> {
       CRLList;
 
   // crls returns the internal state of this CRLSet. It should only be used in
-  // testing.
+  // testing, and is empty for CRLSets parsed by CRLSetStorage::ParseCompact.
   const CRLList& crls() const;
 
   // EmptyCRLSetForTesting returns a valid, but empty, CRLSet for unit tests.
@@ -82,6 +83,44 @@ class NET_EXPORT CRLSet : public base::RefCountedThreadSafe<CRLSet> {
   friend class base::RefCountedThreadSafe<CRLSet>;
   friend class CRLSetStorage;
 
+  // kCompactRestartInterval is the number of serials between two restart
+  // points, which are stored in full, in the serials of a compact CRL.
+  static const uint32 kCompactRestartInterval = 16;
+
+  // CompactTable is a view of a perfect hash table of SHA-256 hashes in the
+  // data of a compact CRLSet. See crl_set_storage.cc for the format.
+  struct CompactTable {
+    CompactTable();
+
+    uint32 num_keys;
+    // keys points to |num_keys| 32-byte hashes.
+    const uint8* keys;
+    uint32 num_buckets;
+    // displacements points to |num_buckets| uint16le values.
+    const uint8* displacements;
+    uint32 num_slots;
+    // slots points to |num_slots| uint32le indexes into |keys|.
+    const uint8* slots;
+  };
+
+  // CompactBucket and CompactSlot are the two hash functions of the perfect
+  // hash tables of compact CRLSets. |key| is a 32-byte hash.
+  static uint32 CompactBucket(const uint8* key, uint32 num_buckets);
+  static uint32 CompactSlot(const uint8* key,
+                            uint16 displacement,
+                            uint32 num_slots);
+
+  // FindInCompactTable sets |*index| to the index of |key| in the keys of
+  // |table| and returns true, or returns false if |key| is not in |table|.
+  static bool FindInCompactTable(const CompactTable& table,
+                                 const base::StringPiece& key,
+                                 uint32* index);
+
+  // CompactCRLHasSerial returns true iff |serial| is listed by the
+  // |crl_index|th CRL of a compact CRLSet.
+  bool CompactCRLHasSerial(uint32 crl_index,
+                           const base::StringPiece& serial) const;
+
   uint32 sequence_;
   CRLList crls_;
   // not_after_ contains the time, in UNIX epoch seconds, after which the
@@ -95,6 +134,19 @@ class NET_EXPORT CRLSet : public base::RefCountedThreadSafe<CRLSet> {
   // blocked_spkis_ contains the SHA256 hashes of SPKIs which are to be blocked
   // no matter where in a certificate chain they might appear.
   std::vector<std::string> blocked_spkis_;
+
+  // compact_data_ holds the bytes of a CRLSet parsed by
+  // CRLSetStorage::ParseCompact. When it is set, |crls_|,
+  // |crls_index_by_issuer_| and |blocked_spkis_| are empty, and lookups use
+  // the views below, which point into it.
+  scoped_refptr<base::RefCountedMemory> compact_data_;
+  CompactTable compact_issuers_;
+  CompactTable compact_blocked_spkis_;
+  // compact_crl_offsets_ points to the |compact_issuers_.num_keys| + 1
+  // uint32le offsets of the serials of each CRL in |compact_serials_|.
+  const uint8* compact_crl_offsets_;
+  const uint8* compact_serials_;
+  size_t compact_serials_len_;
 };
 
 }  // namespace net
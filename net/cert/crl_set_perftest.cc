@@ -0,0 +1,187 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/base64.h"
+#include "base/basictypes.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/test/perf_log.h"
+#include "base/test/perf_time_logger.h"
+#include "crypto/sha2.h"
+#include "net/cert/crl_set.h"
+#include "net/cert/crl_set_storage.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// The size of the CRLSet, which is close to the ones published.
+const size_t kNumCRLs = 400;
+const size_t kSerialsPerCRL = 500;
+const size_t kNumBlockedSPKIs = 30;
+
+const int kParseIterations = 10;
+const int kLookupIterations = 10;
+
+std::string MakeIssuer(size_t i) {
+  return crypto::SHA256HashString("issuer " + base::SizeTToString(i));
+}
+
+// Serials are 16 positive bytes, as many CAs now use.
+std::string MakeSerial(size_t issuer, size_t i) {
+  std::string serial = crypto::SHA256HashString(
+      base::SizeTToString(issuer) + "/" + base::SizeTToString(i)).substr(0, 16);
+  serial[0] = (serial[0] & 0x7f) | 0x01;
+  return serial;
+}
+
+std::string MakeBlockedSPKI(size_t i) {
+  return crypto::SHA256HashString("blocked " + base::SizeTToString(i));
+}
+
+// Returns the CRLSet in the format CRLSetStorage::Parse reads, with sorted
+// serials.
+std::string MakeCRLSetBytes() {
+  std::string header =
+      "{\"Version\":0,\"ContentType\":\"CRLSet\",\"Sequence\":1,"
+      "\"DeltaFrom\":0,\"NumParents\":" + base::SizeTToString(kNumCRLs) +
+      ",\"BlockedSPKIs\":[";
+  for (size_t i = 0; i < kNumBlockedSPKIs; ++i) {
+    std::string spki_base64;
+    base::Base64Encode(MakeBlockedSPKI(i), &spki_base64);
+    if (i > 0)
+      header += ",";
+    header += "\"" + spki_base64 + "\"";
+  }
+  header += "]}";
+
+  std::string bytes;
+  bytes.push_back(static_cast<char>(header.size()));
+  bytes.push_back(static_cast<char>(header.size() >> 8));
+  bytes += header;
+
+  for (size_t i = 0; i < kNumCRLs; ++i) {
+    bytes += MakeIssuer(i);
+    std::vector<std::string> serials;
+    for (size_t j = 0; j < kSerialsPerCRL; ++j)
+      serials.push_back(MakeSerial(i, j));
+    std::sort(serials.begin(), serials.end());
+
+    const uint32 num_serials = serials.size();
+    bytes.append(reinterpret_cast<const char*>(&num_serials),
+                 sizeof(num_serials));
+    for (size_t j = 0; j < serials.size(); ++j) {
+      bytes.push_back(static_cast<char>(serials[j].size()));
+      bytes += serials[j];
+    }
+  }
+  return bytes;
+}
+
+class CRLSetPerfTest : public testing::Test {
+ public:
+  void SetUp() override {
+    bytes_ = MakeCRLSetBytes();
+    ASSERT_TRUE(CRLSetStorage::Parse(bytes_, &crl_set_));
+    ASSERT_TRUE(CRLSetStorage::SerializeCompact(crl_set_.get(), &compact_));
+    std::string compact(compact_);
+    ASSERT_TRUE(CRLSetStorage::ParseCompact(
+        base::RefCountedString::TakeString(&compact), &compact_crl_set_));
+  }
+
+ protected:
+  // Looks up every tenth serial of every CRL, and as many serials that are
+  // not listed.
+  void CheckSerials(const CRLSet* crl_set, const char* name) {
+    std::vector<std::pair<std::string, std::string> > lookups;
+    for (size_t i = 0; i < kNumCRLs; ++i) {
+      for (size_t j = 0; j < kSerialsPerCRL; j += 10) {
+        lookups.push_back(std::make_pair(MakeSerial(i, j), MakeIssuer(i)));
+        lookups.push_back(
+            std::make_pair(MakeSerial(i, j + kSerialsPerCRL), MakeIssuer(i)));
+      }
+    }
+
+    size_t revoked = 0;
+    base::PerfTimeLogger timer(name);
+    for (int i = 0; i < kLookupIterations; ++i) {
+      for (size_t j = 0; j < lookups.size(); ++j) {
+        if (crl_set->CheckSerial(lookups[j].first, lookups[j].second) ==
+            CRLSet::REVOKED) {
+          revoked++;
+        }
+      }
+    }
+    timer.Done();
+    EXPECT_EQ(lookups.size() / 2 * kLookupIterations, revoked);
+  }
+
+  void CheckSPKIs(const CRLSet* crl_set, const char* name) {
+    std::vector<std::string> spkis;
+    for (size_t i = 0; i < kNumCRLs; ++i)
+      spkis.push_back(MakeIssuer(i));
+    for (size_t i = 0; i < kNumBlockedSPKIs; ++i)
+      spkis.push_back(MakeBlockedSPKI(i));
+
+    size_t revoked = 0;
+    base::PerfTimeLogger timer(name);
+    for (int i = 0; i < kLookupIterations * 100; ++i) {
+      for (size_t j = 0; j < spkis.size(); ++j) {
+        if (crl_set->CheckSPKI(spkis[j]) == CRLSet::REVOKED)
+          revoked++;
+      }
+    }
+    timer.Done();
+    EXPECT_EQ(kNumBlockedSPKIs * kLookupIterations * 100, revoked);
+  }
+
+  std::string bytes_;
+  std::string compact_;
+  scoped_refptr<CRLSet> crl_set_;
+  scoped_refptr<CRLSet> compact_crl_set_;
+};
+
+}  // namespace
+
+TEST_F(CRLSetPerfTest, Parse) {
+  base::LogPerfResult("CRLSet_size", static_cast<double>(bytes_.size()),
+                      "bytes");
+  base::LogPerfResult("CRLSet_compact_size",
+                      static_cast<double>(compact_.size()), "bytes");
+
+  {
+    base::PerfTimeLogger timer("Parse CRLSet");
+    for (int i = 0; i < kParseIterations; ++i) {
+      scoped_refptr<CRLSet> crl_set;
+      ASSERT_TRUE(CRLSetStorage::Parse(bytes_, &crl_set));
+    }
+    timer.Done();
+  }
+
+  scoped_refptr<base::RefCountedString> compact(new base::RefCountedString);
+  compact->data() = compact_;
+  base::PerfTimeLogger timer("Parse compact CRLSet");
+  for (int i = 0; i < kParseIterations; ++i) {
+    scoped_refptr<CRLSet> crl_set;
+    ASSERT_TRUE(CRLSetStorage::ParseCompact(compact, &crl_set));
+  }
+  timer.Done();
+}
+
+TEST_F(CRLSetPerfTest, CheckSerial) {
+  CheckSerials(crl_set_.get(), "CheckSerial");
+  CheckSerials(compact_crl_set_.get(), "CheckSerial compact");
+}
+
+TEST_F(CRLSetPerfTest, CheckSPKI) {
+  CheckSPKIs(crl_set_.get(), "CheckSPKI");
+  CheckSPKIs(compact_crl_set_.get(), "CheckSPKI compact");
+}
+
+}  // namespace net
@@ -4,10 +4,16 @@
 
 #include "net/cert/crl_set_storage.h"
 
+#include <algorithm>
+#include <functional>
+#include <map>
+
 #include "base/base64.h"
 #include "base/debug/trace_event.h"
+#include "base/files/memory_mapped_file.h"
 #include "base/format_macros.h"
 #include "base/json/json_reader.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/strings/stringprintf.h"
 #include "base/values.h"
 #include "crypto/sha2.h"
@@ -107,6 +113,162 @@ static bool DecompressZlib(uint8* out, int out_len, base::StringPiece in) {
 // except there is no delta update of a serial number: they are either
 // inserted, deleted or left the same.
 
+// Compact CRLSet format, as written by SerializeCompact. It holds the same
+// information as the format above, laid out so that it can be used in place,
+// for instance from a file mapped in memory. Integers are little-endian and
+// nothing is aligned.
+//
+// byte[4] magic: "CRLc"
+// uint32le version: currently 1
+// uint32le sequence
+// uint64le not_after: the NotAfter header value, or 0
+// uint32le num_blocked_spkis
+// byte[num_blocked_spkis][32] blocked_spki_sha256s
+// CompactTable blocked_spkis_table
+// uint32le num_crls
+// byte[num_crls][32] parent_spki_sha256s
+// CompactTable parents_table
+// uint32le crl_offsets[num_crls + 1]
+// byte[crl_offsets[num_crls]] serials
+//
+// A CompactTable is a perfect hash table of the SHA-256 hashes just before it:
+//
+// struct CompactTable {
+//   uint32le num_buckets
+//   uint32le num_slots
+//   uint16le displacements[num_buckets]
+//   uint32le slots[num_slots]
+// }
+//
+// The index of a hash is in the slot given by
+// CRLSet::CompactSlot(hash, displacements[b], num_slots) where b is
+// CRLSet::CompactBucket(hash, num_buckets). Other slots hold 0xffffffff. A
+// lookup is two hash functions and one comparison.
+//
+// The serials of the CRL with index i are at crl_offsets[i] in |serials|, and
+// end at crl_offsets[i + 1]:
+//
+// uint32le num_serials
+// uint32le has_order: 0 or 1
+// uint32le restarts[ceil(num_serials / 16)]
+// uint32le order[num_serials]: only present if has_order is 1
+// [num_serials] {
+//   uint8 shared_length
+//   uint8 suffix_length
+//   byte[suffix_length] suffix
+// }
+//
+// The serials are sorted. Each is stored as the length of the prefix it
+// shares with the previous serial, followed by the rest of its bytes. Every
+// 16th serial is a restart point, which shares nothing, and |restarts| holds
+// their offsets from the first serial. A lookup searches the restart points
+// and then decodes at most 16 serials. If the serials of the CRL were not
+// sorted, order[i] is the original position of the ith sorted serial so that
+// the CRL can be rebuilt, and delta updates applied to it.
+
+static const char kCompactMagic[4] = {'C', 'R', 'L', 'c'};
+
+// kCompactFileVersion is the version of the compact CRLSet format that we
+// currently implement.
+static const uint32 kCompactFileVersion = 1;
+
+// kCompactEmptySlot marks the free slots of a CompactTable.
+static const uint32 kCompactEmptySlot = 0xffffffff;
+
+// kCompactKeysPerBucket is the average number of hashes in a bucket of a
+// CompactTable. kCompactSlotsPerKey is the initial ratio of slots to hashes.
+// There is more room in the table, and building it is quicker, with more
+// slots.
+static const uint32 kCompactKeysPerBucket = 4;
+static const double kCompactSlotsPerKey = 1.25;
+
+static uint32 GetUint32(const uint8* p) {
+  uint32 value;
+  memcpy(&value, p, sizeof(value));  // assumes little endian.
+  return value;
+}
+
+static bool ReadUint32(base::StringPiece* data, uint32* out) {
+  if (data->size() < sizeof(uint32))
+    return false;
+  memcpy(out, data->data(), sizeof(uint32));  // assumes little endian.
+  data->remove_prefix(sizeof(uint32));
+  return true;
+}
+
+static bool ReadUint64(base::StringPiece* data, uint64* out) {
+  if (data->size() < sizeof(uint64))
+    return false;
+  memcpy(out, data->data(), sizeof(uint64));  // assumes little endian.
+  data->remove_prefix(sizeof(uint64));
+  return true;
+}
+
+// ReadArray points |*out| to the |count| elements of |element_size| bytes at
+// the start of |data|, and removes them from |data|.
+static bool ReadArray(base::StringPiece* data,
+                      uint32 count,
+                      size_t element_size,
+                      const uint8** out) {
+  if (count > data->size() / element_size)
+    return false;
+  *out = reinterpret_cast<const uint8*>(data->data());
+  data->remove_prefix(count * element_size);
+  return true;
+}
+
+static void WriteUint16(uint16 value, std::string* out) {
+  // assumes little endian.
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void WriteUint32(uint32 value, std::string* out) {
+  // assumes little endian.
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void WriteUint64(uint64 value, std::string* out) {
+  // assumes little endian.
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// SerialIndexLess orders indexes into a list of serials by the serials they
+// refer to.
+class SerialIndexLess {
+ public:
+  explicit SerialIndexLess(const std::vector<std::string>& serials)
+      : serials_(&serials) {}
+
+  bool operator()(uint32 a, uint32 b) const {
+    return (*serials_)[a] < (*serials_)[b];
+  }
+
+ private:
+  const std::vector<std::string>* serials_;
+};
+
+// MappedCRLSetFile is a compact CRLSet file mapped in memory, which stays
+// mapped for as long as the CRLSet parsed from it.
+class MappedCRLSetFile : public base::RefCountedMemory {
+ public:
+  MappedCRLSetFile() {}
+
+  bool Initialize(const base::FilePath& path) {
+    return file_.Initialize(path);
+  }
+
+  // base::RefCountedMemory implementation.
+  const unsigned char* front() const override { return file_.data(); }
+  size_t size() const override { return file_.length(); }
+
+ private:
+  ~MappedCRLSetFile() override {}
+
+  base::MemoryMappedFile file_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedCRLSetFile);
+};
+
 // ReadHeader reads the header (including length prefix) from |data| and
 // updates |data| to remove the header on return. Caller takes ownership of the
 // returned pointer.
@@ -361,6 +523,14 @@ bool CRLSetStorage::Parse(base::StringPiece data,
 bool CRLSetStorage::ApplyDelta(const CRLSet* in_crl_set,
                                const base::StringPiece& delta_bytes,
                                scoped_refptr<CRLSet>* out_crl_set) {
+  scoped_refptr<CRLSet> expanded_crl_set;
+  if (in_crl_set->compact_data_.get()) {
+    expanded_crl_set = ExpandCompact(in_crl_set);
+    if (!expanded_crl_set.get())
+      return false;
+    in_crl_set = expanded_crl_set.get();
+  }
+
   base::StringPiece data(delta_bytes);
   scoped_ptr<base::DictionaryValue> header_dict(ReadHeader(&data));
   if (!header_dict.get())
@@ -479,6 +649,14 @@ bool CRLSetStorage::GetIsDeltaUpdate(const base::StringPiece& bytes,
 
 // static
 std::string CRLSetStorage::Serialize(const CRLSet* crl_set) {
+  scoped_refptr<CRLSet> expanded_crl_set;
+  if (crl_set->compact_data_.get()) {
+    expanded_crl_set = ExpandCompact(crl_set);
+    if (!expanded_crl_set.get())
+      return std::string();
+    crl_set = expanded_crl_set.get();
+  }
+
   std::string header = base::StringPrintf(
       "{"
       "\"Version\":0,"
@@ -544,4 +722,431 @@ std::string CRLSetStorage::Serialize(const CRLSet* crl_set) {
   return ret;
 }
 
+// static
+bool CRLSetStorage::SerializeCompact(const CRLSet* crl_set, std::string* out) {
+  if (crl_set->compact_data_.get()) {
+    out->assign(crl_set->compact_data_->front_as<char>(),
+                crl_set->compact_data_->size());
+    return true;
+  }
+
+  std::string result(kCompactMagic, sizeof(kCompactMagic));
+  WriteUint32(kCompactFileVersion, &result);
+  WriteUint32(crl_set->sequence_, &result);
+  WriteUint64(crl_set->not_after_, &result);
+
+  WriteUint32(crl_set->blocked_spkis_.size(), &result);
+  for (std::vector<std::string>::const_iterator i =
+           crl_set->blocked_spkis_.begin();
+       i != crl_set->blocked_spkis_.end(); ++i) {
+    if (i->size() != crypto::kSHA256Length)
+      return false;
+    result += *i;
+  }
+  WriteCompactTable(crl_set->blocked_spkis_, &result);
+
+  std::vector<std::string> parent_spki_hashes;
+  parent_spki_hashes.reserve(crl_set->crls_.size());
+  WriteUint32(crl_set->crls_.size(), &result);
+  for (CRLSet::CRLList::const_iterator i = crl_set->crls_.begin();
+       i != crl_set->crls_.end(); ++i) {
+    if (i->first.size() != crypto::kSHA256Length)
+      return false;
+    result += i->first;
+    parent_spki_hashes.push_back(i->first);
+  }
+  WriteCompactTable(parent_spki_hashes, &result);
+
+  std::string serials;
+  for (CRLSet::CRLList::const_iterator i = crl_set->crls_.begin();
+       i != crl_set->crls_.end(); ++i) {
+    WriteUint32(serials.size(), &result);
+    if (!WriteCompactCRL(i->second, &serials))
+      return false;
+  }
+  WriteUint32(serials.size(), &result);
+  result += serials;
+
+  out->swap(result);
+  return true;
+}
+
+// static
+bool CRLSetStorage::ParseCompact(
+    const scoped_refptr<base::RefCountedMemory>& bytes,
+    scoped_refptr<CRLSet>* out_crl_set) {
+  TRACE_EVENT0("CRLSet", "ParseCompact");
+  base::StringPiece data(bytes->front_as<char>(), bytes->size());
+  if (data.size() < sizeof(kCompactMagic) ||
+      memcmp(data.data(), kCompactMagic, sizeof(kCompactMagic)) != 0) {
+    return false;
+  }
+  data.remove_prefix(sizeof(kCompactMagic));
+
+  uint32 version, sequence;
+  uint64 not_after;
+  if (!ReadUint32(&data, &version) || version != kCompactFileVersion ||
+      !ReadUint32(&data, &sequence) || !ReadUint64(&data, &not_after)) {
+    return false;
+  }
+
+  scoped_refptr<CRLSet> crl_set(new CRLSet);
+  crl_set->sequence_ = sequence;
+  crl_set->not_after_ = not_after;
+  crl_set->compact_data_ = bytes;
+
+  uint32 num_blocked_spkis;
+  const uint8* blocked_spkis;
+  if (!ReadUint32(&data, &num_blocked_spkis) ||
+      !ReadArray(&data, num_blocked_spkis, crypto::kSHA256Length,
+                 &blocked_spkis) ||
+      !ReadCompactTable(&data, num_blocked_spkis, blocked_spkis,
+                        &crl_set->compact_blocked_spkis_)) {
+    return false;
+  }
+
+  uint32 num_crls;
+  const uint8* parent_spkis;
+  if (!ReadUint32(&data, &num_crls) ||
+      !ReadArray(&data, num_crls, crypto::kSHA256Length, &parent_spkis) ||
+      !ReadCompactTable(&data, num_crls, parent_spkis,
+                        &crl_set->compact_issuers_)) {
+    return false;
+  }
+
+  // |num_crls| + 1 cannot overflow since each CRL took 32 bytes of |data|.
+  const uint8* crl_offsets;
+  if (!ReadArray(&data, num_crls + 1, sizeof(uint32), &crl_offsets))
+    return false;
+  // The serials are the rest of |data|.
+  if (GetUint32(crl_offsets) != 0 ||
+      GetUint32(crl_offsets + sizeof(uint32) * num_crls) != data.size()) {
+    return false;
+  }
+  for (uint32 i = 0; i < num_crls; ++i) {
+    const uint32 begin = GetUint32(crl_offsets + sizeof(uint32) * i);
+    const uint32 end = GetUint32(crl_offsets + sizeof(uint32) * (i + 1));
+    if (end < begin || end > data.size() ||
+        !DecodeCompactCRL(data.substr(begin, end - begin), NULL)) {
+      return false;
+    }
+  }
+
+  crl_set->compact_crl_offsets_ = crl_offsets;
+  crl_set->compact_serials_ = reinterpret_cast<const uint8*>(data.data());
+  crl_set->compact_serials_len_ = data.size();
+
+  *out_crl_set = crl_set;
+  return true;
+}
+
+// static
+bool CRLSetStorage::ParseCompactFile(const base::FilePath& path,
+                                     scoped_refptr<CRLSet>* out_crl_set) {
+  scoped_refptr<MappedCRLSetFile> file(new MappedCRLSetFile);
+  if (!file->Initialize(path))
+    return false;
+  return ParseCompact(file, out_crl_set);
+}
+
+// static
+scoped_refptr<CRLSet> CRLSetStorage::ExpandCompact(const CRLSet* compact) {
+  scoped_refptr<CRLSet> crl_set(new CRLSet);
+  crl_set->sequence_ = compact->sequence_;
+  crl_set->not_after_ = compact->not_after_;
+
+  const CRLSet::CompactTable& blocked_spkis = compact->compact_blocked_spkis_;
+  for (uint32 i = 0; i < blocked_spkis.num_keys; ++i) {
+    crl_set->blocked_spkis_.push_back(std::string(
+        reinterpret_cast<const char*>(blocked_spkis.keys) +
+            crypto::kSHA256Length * i,
+        crypto::kSHA256Length));
+  }
+
+  const CRLSet::CompactTable& issuers = compact->compact_issuers_;
+  crl_set->crls_.resize(issuers.num_keys);
+  for (uint32 i = 0; i < issuers.num_keys; ++i) {
+    std::pair<std::string, std::vector<std::string> >* const crl =
+        &crl_set->crls_[i];
+    crl->first.assign(
+        reinterpret_cast<const char*>(issuers.keys) + crypto::kSHA256Length * i,
+        crypto::kSHA256Length);
+
+    const uint32 begin =
+        GetUint32(compact->compact_crl_offsets_ + sizeof(uint32) * i);
+    const uint32 end =
+        GetUint32(compact->compact_crl_offsets_ + sizeof(uint32) * (i + 1));
+    // ParseCompact checked the offsets and serials, but a mapped file may
+    // have changed since.
+    if (end < begin || end > compact->compact_serials_len_)
+      return NULL;
+    const base::StringPiece serials(
+        reinterpret_cast<const char*>(compact->compact_serials_) + begin,
+        end - begin);
+    if (!DecodeCompactCRL(serials, &crl->second))
+      return NULL;
+
+    crl_set->crls_index_by_issuer_[crl->first] = i;
+  }
+
+  return crl_set;
+}
+
+// static
+bool CRLSetStorage::DecodeCompactCRL(base::StringPiece data,
+                                     std::vector<std::string>* out_serials) {
+  const uint32 kInterval = CRLSet::kCompactRestartInterval;
+
+  uint32 num_serials, has_order;
+  if (!ReadUint32(&data, &num_serials) || !ReadUint32(&data, &has_order) ||
+      has_order > 1) {
+    return false;
+  }
+  const uint32 num_restarts =
+      num_serials / kInterval + (num_serials % kInterval != 0);
+  const uint8* restarts;
+  const uint8* order = NULL;
+  if (!ReadArray(&data, num_restarts, sizeof(uint32), &restarts) ||
+      (has_order && !ReadArray(&data, num_serials, sizeof(uint32), &order))) {
+    return false;
+  }
+  // Each serial takes at least two bytes.
+  if (num_serials > data.size() / 2)
+    return false;
+
+  std::vector<bool> placed(order ? num_serials : 0);
+  if (out_serials) {
+    out_serials->clear();
+    out_serials->resize(num_serials);
+  }
+
+  const uint8* const entries = reinterpret_cast<const uint8*>(data.data());
+  char serial[255];
+  size_t serial_len = 0;
+  size_t offset = 0;
+  for (uint32 i = 0; i < num_serials; ++i) {
+    const bool is_restart = i % kInterval == 0;
+    if (is_restart &&
+        GetUint32(restarts + sizeof(uint32) * (i / kInterval)) != offset) {
+      return false;
+    }
+
+    if (data.size() - offset < 2)
+      return false;
+    const uint8 shared = entries[offset];
+    const uint8 suffix_len = entries[offset + 1];
+    offset += 2;
+    if (shared > serial_len || (is_restart && shared != 0) ||
+        suffix_len > data.size() - offset ||
+        static_cast<size_t>(shared) + suffix_len > sizeof(serial)) {
+      return false;
+    }
+
+    // The serials must be sorted for lookups to find them.
+    const base::StringPiece suffix(
+        reinterpret_cast<const char*>(entries + offset), suffix_len);
+    if (i > 0 &&
+        suffix < base::StringPiece(serial + shared, serial_len - shared)) {
+      return false;
+    }
+    memcpy(serial + shared, suffix.data(), suffix_len);
+    serial_len = shared + suffix_len;
+    offset += suffix_len;
+
+    uint32 position = i;
+    if (order) {
+      position = GetUint32(order + sizeof(uint32) * i);
+      if (position >= num_serials || placed[position])
+        return false;
+      placed[position] = true;
+    }
+    if (out_serials)
+      (*out_serials)[position].assign(serial, serial_len);
+  }
+
+  return offset == data.size();
+}
+
+// static
+bool CRLSetStorage::WriteCompactCRL(const std::vector<std::string>& serials,
+                                    std::string* out) {
+  const uint32 kInterval = CRLSet::kCompactRestartInterval;
+  const uint32 num_serials = serials.size();
+
+  std::vector<uint32> order(num_serials);
+  for (uint32 i = 0; i < num_serials; ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), SerialIndexLess(serials));
+  bool has_order = false;
+  for (uint32 i = 0; i < num_serials && !has_order; ++i)
+    has_order = order[i] != i;
+
+  WriteUint32(num_serials, out);
+  WriteUint32(has_order ? 1 : 0, out);
+  const size_t restarts_offset = out->size();
+  const uint32 num_restarts =
+      num_serials / kInterval + (num_serials % kInterval != 0);
+  out->append(sizeof(uint32) * num_restarts, '\0');
+  if (has_order) {
+    for (uint32 i = 0; i < num_serials; ++i)
+      WriteUint32(order[i], out);
+  }
+
+  const size_t entries_offset = out->size();
+  const std::string* previous = NULL;
+  for (uint32 i = 0; i < num_serials; ++i) {
+    const std::string& serial = serials[order[i]];
+    if (serial.size() > 255)
+      return false;
+
+    size_t shared = 0;
+    if (i % kInterval == 0) {
+      const uint32 restart = out->size() - entries_offset;
+      memcpy(&(*out)[restarts_offset + sizeof(uint32) * (i / kInterval)],
+             &restart, sizeof(restart));
+    } else {
+      while (shared < previous->size() && shared < serial.size() &&
+             (*previous)[shared] == serial[shared]) {
+        shared++;
+      }
+    }
+
+    out->push_back(static_cast<char>(shared));
+    out->push_back(static_cast<char>(serial.size() - shared));
+    out->append(serial, shared, std::string::npos);
+    previous = &serial;
+  }
+
+  return true;
+}
+
+// static
+bool CRLSetStorage::ReadCompactTable(base::StringPiece* data,
+                                     uint32 num_keys,
+                                     const uint8* keys,
+                                     CRLSet::CompactTable* table) {
+  uint32 num_buckets, num_slots;
+  if (!ReadUint32(data, &num_buckets) || !ReadUint32(data, &num_slots))
+    return false;
+  // Lookups need a bucket as soon as there are slots, and every key needs a
+  // slot.
+  if ((num_buckets == 0) != (num_slots == 0) || num_slots < num_keys)
+    return false;
+
+  table->num_keys = num_keys;
+  table->keys = keys;
+  table->num_buckets = num_buckets;
+  table->num_slots = num_slots;
+  if (!ReadArray(data, num_buckets, sizeof(uint16), &table->displacements) ||
+      !ReadArray(data, num_slots, sizeof(uint32), &table->slots)) {
+    return false;
+  }
+
+  // Each key must be in the slot where lookups look for it.
+  for (uint32 slot = 0; slot < num_slots; ++slot) {
+    const uint32 index = GetUint32(table->slots + sizeof(uint32) * slot);
+    if (index == kCompactEmptySlot)
+      continue;
+    if (index >= num_keys)
+      return false;
+    const uint8* key = keys + crypto::kSHA256Length * index;
+    uint16 displacement;
+    memcpy(&displacement,
+           table->displacements +
+               sizeof(uint16) * CRLSet::CompactBucket(key, num_buckets),
+           sizeof(displacement));
+    if (CRLSet::CompactSlot(key, displacement, num_slots) != slot)
+      return false;
+  }
+
+  return true;
+}
+
+// static
+void CRLSetStorage::WriteCompactTable(const std::vector<std::string>& keys,
+                                      std::string* out) {
+  // Only the last of identical keys is indexed, as in
+  // CRLSet::crls_index_by_issuer_.
+  std::map<std::string, uint32> indexes;
+  for (size_t i = 0; i < keys.size(); ++i)
+    indexes[keys[i]] = i;
+
+  if (indexes.empty()) {
+    WriteUint32(0, out);  // num_buckets
+    WriteUint32(0, out);  // num_slots
+    return;
+  }
+
+  const uint32 num_keys = indexes.size();
+  const uint32 num_buckets =
+      (num_keys + kCompactKeysPerBucket - 1) / kCompactKeysPerBucket;
+  std::vector<std::vector<uint32> > buckets(num_buckets);
+  for (std::map<std::string, uint32>::const_iterator i = indexes.begin();
+       i != indexes.end(); ++i) {
+    const uint8* key = reinterpret_cast<const uint8*>(i->first.data());
+    buckets[CRLSet::CompactBucket(key, num_buckets)].push_back(i->second);
+  }
+
+  // Place the largest buckets first, while most slots are free.
+  std::vector<std::pair<size_t, uint32> > bucket_order;
+  for (uint32 i = 0; i < num_buckets; ++i)
+    bucket_order.push_back(std::make_pair(buckets[i].size(), i));
+  std::sort(bucket_order.begin(), bucket_order.end(),
+            std::greater<std::pair<size_t, uint32> >());
+
+  uint32 num_slots = static_cast<uint32>(num_keys * kCompactSlotsPerKey);
+  std::vector<uint16> displacements;
+  std::vector<uint32> slots;
+  std::vector<uint32> bucket_slots;
+  for (;;) {
+    displacements.assign(num_buckets, 0);
+    slots.assign(num_slots, kCompactEmptySlot);
+
+    bool placed_all = true;
+    for (size_t i = 0; i < bucket_order.size() && placed_all; ++i) {
+      const uint32 bucket = bucket_order[i].second;
+      const std::vector<uint32>& bucket_keys = buckets[bucket];
+      if (bucket_keys.empty())
+        break;
+
+      // Find a displacement that puts every key of the bucket in a free slot.
+      placed_all = false;
+      for (uint32 displacement = 0;
+           displacement <= kuint16max && !placed_all; ++displacement) {
+        bucket_slots.clear();
+        for (size_t j = 0; j < bucket_keys.size(); ++j) {
+          const uint8* key =
+              reinterpret_cast<const uint8*>(keys[bucket_keys[j]].data());
+          const uint32 slot = CRLSet::CompactSlot(key, displacement, num_slots);
+          if (slots[slot] != kCompactEmptySlot ||
+              std::find(bucket_slots.begin(), bucket_slots.end(), slot) !=
+                  bucket_slots.end()) {
+            break;
+          }
+          bucket_slots.push_back(slot);
+        }
+        if (bucket_slots.size() != bucket_keys.size())
+          continue;
+
+        for (size_t j = 0; j < bucket_keys.size(); ++j)
+          slots[bucket_slots[j]] = bucket_keys[j];
+        displacements[bucket] = displacement;
+        placed_all = true;
+      }
+    }
+
+    if (placed_all)
+      break;
+    // Retry with more room.
+    num_slots += num_slots / 8 + 1;
+  }
+
+  WriteUint32(num_buckets, out);
+  WriteUint32(num_slots, out);
+  for (size_t i = 0; i < displacements.size(); ++i)
+    WriteUint16(displacements[i], out);
+  for (size_t i = 0; i < slots.size(); ++i)
+    WriteUint32(slots[i], out);
+}
+
 }  // namespace net
@@ -9,12 +9,15 @@
 #include <utility>
 #include <vector>
 
+#include "base/memory/ref_counted.h"
 #include "base/strings/string_piece.h"
 #include "net/base/net_export.h"
 #include "net/cert/crl_set.h"
 
 namespace base {
 class DictionaryValue;
+class FilePath;
+class RefCountedMemory;
 }
 
 namespace net {
@@ -43,7 +46,53 @@ class NET_EXPORT CRLSetStorage {
   // will be equal.
   static std::string Serialize(const CRLSet* crl_set);
 
+  // SerializeCompact sets |*out| to |crl_set| in the compact format, which
+  // ParseCompact reads, and returns true. It returns false if |crl_set| has a
+  // blocked SPKI hash that is not a SHA-256 hash, or a serial that is longer
+  // than 255 bytes.
+  static bool SerializeCompact(const CRLSet* crl_set, std::string* out);
+
+  // ParseCompact parses the compact CRLSet in |data| and, on success, puts a
+  // new CRLSet in |out_crl_set| and returns true. Nothing is copied out of
+  // |data|: the CRLSet keeps a reference to it and looks up serials and SPKI
+  // hashes in place.
+  static bool ParseCompact(const scoped_refptr<base::RefCountedMemory>& data,
+                           scoped_refptr<CRLSet>* out_crl_set);
+
+  // ParseCompactFile is like ParseCompact, for a compact CRLSet in the file at
+  // |path|, which is mapped in memory. The file must not be modified while the
+  // CRLSet is in use; updates should write a new file and rename it. This
+  // does blocking file IO.
+  static bool ParseCompactFile(const base::FilePath& path,
+                               scoped_refptr<CRLSet>* out_crl_set);
+
  private:
+  // ExpandCompact returns a CRLSet equal to the compact |crl_set| that does
+  // not use the compact format, so that delta updates can be applied to it.
+  static scoped_refptr<CRLSet> ExpandCompact(const CRLSet* crl_set);
+
+  // DecodeCompactCRL checks the serials of a compact CRL in |data| and, if
+  // |out_serials| is not NULL, puts them in it in their original order.
+  static bool DecodeCompactCRL(base::StringPiece data,
+                               std::vector<std::string>* out_serials);
+
+  // WriteCompactCRL appends the compact form of |serials| to |out|. It
+  // returns false if a serial is longer than 255 bytes.
+  static bool WriteCompactCRL(const std::vector<std::string>& serials,
+                              std::string* out);
+
+  // ReadCompactTable reads a perfect hash table for the |num_keys| hashes at
+  // |keys| from |data| into |*table|, and checks that it is consistent.
+  static bool ReadCompactTable(base::StringPiece* data,
+                               uint32 num_keys,
+                               const uint8* keys,
+                               CRLSet::CompactTable* table);
+
+  // WriteCompactTable appends a perfect hash table of |keys|, which must be
+  // SHA-256 hashes, to |out|.
+  static void WriteCompactTable(const std::vector<std::string>& keys,
+                                std::string* out);
+
   // CopyBlockedSPKIsFromHeader sets |blocked_spkis_| to the list of values
   // from "BlockedSPKIs" in |header_dict|.
   static bool CopyBlockedSPKIsFromHeader(CRLSet* crl_set,
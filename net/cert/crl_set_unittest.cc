@@ -3,6 +3,10 @@
 // found in the LICENSE file.
 
 #include "net/cert/crl_set.h"
+
+#include "base/memory/ref_counted_memory.h"
+#include "base/strings/string_number_conversions.h"
+#include "crypto/sha2.h"
 #include "net/cert/crl_set_storage.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -326,3 +330,161 @@ TEST(CRLSetTest, Expired) {
 
   EXPECT_TRUE(set->IsExpired());
 }
+
+// ParseCompactCopy parses a copy of the compact CRLSet in |data|.
+static bool ParseCompactCopy(const std::string& data,
+                             scoped_refptr<net::CRLSet>* out_crl_set) {
+  std::string copy(data);
+  return net::CRLSetStorage::ParseCompact(
+      base::RefCountedString::TakeString(&copy), out_crl_set);
+}
+
+// MakeCRLSetBytes returns a CRLSet, in the format of kGIACRLSet, with
+// |num_crls| CRLs of up to 100 serials each. The serials of every other CRL
+// are not sorted.
+static std::string MakeCRLSetBytes(size_t num_crls) {
+  std::string crls;
+  for (size_t i = 0; i < num_crls; ++i) {
+    crls += crypto::SHA256HashString("issuer " + base::SizeTToString(i));
+    const uint32 num_serials = i % 100;
+    crls.append(reinterpret_cast<const char*>(&num_serials),
+                sizeof(num_serials));
+    for (uint32 j = 0; j < num_serials; ++j) {
+      const uint32 n = i % 2 ? num_serials - j : j;
+      // Serials which share their first bytes, as sequential serials do.
+      const char serial[] = {0x12, 0x34, static_cast<char>(n >> 8),
+                             static_cast<char>(n)};
+      crls.push_back(sizeof(serial));
+      crls.append(serial, sizeof(serial));
+    }
+  }
+
+  const std::string header =
+      "{\"Version\":0,\"ContentType\":\"CRLSet\",\"Sequence\":3,"
+      "\"DeltaFrom\":0,\"NumParents\":" + base::SizeTToString(num_crls) +
+      ",\"BlockedSPKIs\":[]}";
+  std::string bytes;
+  bytes.push_back(static_cast<char>(header.size()));
+  bytes.push_back(static_cast<char>(header.size() >> 8));
+  return bytes + header + crls;
+}
+
+TEST(CRLSetTest, ParseCompact) {
+  base::StringPiece s(reinterpret_cast<const char*>(kGIACRLSet),
+                      sizeof(kGIACRLSet));
+  scoped_refptr<net::CRLSet> set;
+  ASSERT_TRUE(net::CRLSetStorage::Parse(s, &set));
+
+  std::string compact;
+  ASSERT_TRUE(net::CRLSetStorage::SerializeCompact(set.get(), &compact));
+  scoped_refptr<net::CRLSet> compact_set;
+  ASSERT_TRUE(ParseCompactCopy(compact, &compact_set));
+  EXPECT_TRUE(compact_set->crls().empty());
+
+  const std::string gia_spki_hash(
+      reinterpret_cast<const char*>(kGIASPKISHA256),
+      sizeof(kGIASPKISHA256));
+  EXPECT_EQ(net::CRLSet::REVOKED, compact_set->CheckSerial(
+      std::string("\x16\x7D\x75\x9D\x00\x03\x00\x00\x14\x55", 10),
+      gia_spki_hash));
+  EXPECT_EQ(net::CRLSet::REVOKED, compact_set->CheckSerial(
+      std::string("\x00\x64\x63\x49\xD2\x00\x03\x00\x00\x1D\x77", 11),
+      gia_spki_hash));
+  EXPECT_EQ(net::CRLSet::GOOD, compact_set->CheckSerial(
+      std::string("\x47\x54\x3E\x79\x00\x03\x00\x00\x14\xF5", 10),
+      gia_spki_hash));
+  EXPECT_EQ(net::CRLSet::UNKNOWN, compact_set->CheckSerial(
+      std::string("\x16\x7D\x75\x9D\x00\x03\x00\x00\x14\x55", 10),
+      std::string(32, 'a')));
+  EXPECT_EQ(net::CRLSet::GOOD, compact_set->CheckSPKI(gia_spki_hash));
+  EXPECT_FALSE(compact_set->IsExpired());
+  EXPECT_EQ(set->sequence(), compact_set->sequence());
+
+  // The compact format keeps everything the original one has.
+  EXPECT_EQ(s.as_string(),
+            net::CRLSetStorage::Serialize(compact_set.get()));
+  std::string compact2;
+  ASSERT_TRUE(
+      net::CRLSetStorage::SerializeCompact(compact_set.get(), &compact2));
+  EXPECT_EQ(compact, compact2);
+}
+
+TEST(CRLSetTest, CompactManyCRLs) {
+  const std::string bytes = MakeCRLSetBytes(300);
+  scoped_refptr<net::CRLSet> set;
+  ASSERT_TRUE(net::CRLSetStorage::Parse(bytes, &set));
+  std::string compact;
+  ASSERT_TRUE(net::CRLSetStorage::SerializeCompact(set.get(), &compact));
+  scoped_refptr<net::CRLSet> compact_set;
+  ASSERT_TRUE(ParseCompactCopy(compact, &compact_set));
+
+  for (size_t i = 0; i < set->crls().size(); ++i) {
+    const std::string& issuer = set->crls()[i].first;
+    const std::vector<std::string>& serials = set->crls()[i].second;
+    for (size_t j = 0; j < serials.size(); ++j) {
+      EXPECT_EQ(net::CRLSet::REVOKED,
+                compact_set->CheckSerial(serials[j], issuer));
+    }
+    EXPECT_EQ(net::CRLSet::GOOD,
+              compact_set->CheckSerial(std::string("\x12\x34\x01", 3),
+                                       issuer));
+    EXPECT_EQ(net::CRLSet::GOOD,
+              compact_set->CheckSerial(std::string("\x12\x34\x7f\x00", 4),
+                                       issuer));
+  }
+
+  EXPECT_EQ(bytes, net::CRLSetStorage::Serialize(compact_set.get()));
+}
+
+TEST(CRLSetTest, CompactBlockedSPKIs) {
+  base::StringPiece s(reinterpret_cast<const char*>(kBlockedSPKICRLSet),
+                      sizeof(kBlockedSPKICRLSet));
+  scoped_refptr<net::CRLSet> set;
+  ASSERT_TRUE(net::CRLSetStorage::Parse(s, &set));
+  std::string compact;
+  ASSERT_TRUE(net::CRLSetStorage::SerializeCompact(set.get(), &compact));
+  scoped_refptr<net::CRLSet> compact_set;
+  ASSERT_TRUE(ParseCompactCopy(compact, &compact_set));
+
+  const uint8 spki_hash[] = {
+    227, 176, 196, 66, 152, 252, 28, 20, 154, 251, 244, 200, 153, 111, 185, 36,
+    39, 174, 65, 228, 100, 155, 147, 76, 164, 149, 153, 27, 120, 82, 184, 85,
+  };
+
+  EXPECT_EQ(net::CRLSet::GOOD, compact_set->CheckSPKI(""));
+  EXPECT_EQ(net::CRLSet::REVOKED, compact_set->CheckSPKI(base::StringPiece(
+      reinterpret_cast<const char*>(spki_hash), sizeof(spki_hash))));
+}
+
+TEST(CRLSetTest, CompactDeltaUpdate) {
+  base::StringPiece s(reinterpret_cast<const char*>(kGIACRLSet),
+                      sizeof(kGIACRLSet));
+  scoped_refptr<net::CRLSet> set;
+  ASSERT_TRUE(net::CRLSetStorage::Parse(s, &set));
+  std::string compact;
+  ASSERT_TRUE(net::CRLSetStorage::SerializeCompact(set.get(), &compact));
+  scoped_refptr<net::CRLSet> compact_set;
+  ASSERT_TRUE(ParseCompactCopy(compact, &compact_set));
+
+  base::StringPiece delta(reinterpret_cast<const char*>(kUpdateSerialsDelta),
+                          sizeof(kUpdateSerialsDelta));
+  scoped_refptr<net::CRLSet> delta_set;
+  ASSERT_TRUE(net::CRLSetStorage::ApplyDelta(set.get(), delta, &delta_set));
+  scoped_refptr<net::CRLSet> compact_delta_set;
+  ASSERT_TRUE(net::CRLSetStorage::ApplyDelta(compact_set.get(), delta,
+                                             &compact_delta_set));
+  EXPECT_EQ(net::CRLSetStorage::Serialize(delta_set.get()),
+            net::CRLSetStorage::Serialize(compact_delta_set.get()));
+}
+
+TEST(CRLSetTest, CompactTruncated) {
+  scoped_refptr<net::CRLSet> set;
+  ASSERT_TRUE(net::CRLSetStorage::Parse(MakeCRLSetBytes(20), &set));
+  std::string compact;
+  ASSERT_TRUE(net::CRLSetStorage::SerializeCompact(set.get(), &compact));
+
+  for (size_t i = 0; i < compact.size(); ++i) {
+    scoped_refptr<net::CRLSet> compact_set;
+    EXPECT_FALSE(ParseCompactCopy(compact.substr(0, i), &compact_set)) << i;
+  }
+}
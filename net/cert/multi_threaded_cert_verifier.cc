@@ -11,6 +11,8 @@
 #include "base/compiler_specific.h"
 #include "base/message_loop/message_loop.h"
 #include "base/metrics/histogram.h"
+#include "base/pickle.h"
+#include "base/sha1.h"
 #include "base/stl_util.h"
 #include "base/synchronization/lock.h"
 #include "base/threading/worker_pool.h"
@@ -80,6 +82,78 @@ const unsigned kMaxCacheEntries = 256;
 // The number of seconds for which we'll cache a cache entry.
 const unsigned kTTLSecs = 1800;  // 30 minutes.
 
+// Version of the format written by SerializeCache().
+const int kSerializedCacheVersion = 2;
+
+// How a Verify() request was served. These values are used in a histogram,
+// so new values must be added at the end.
+enum CacheLookup {
+  CACHE_LOOKUP_MISS = 0,
+  CACHE_LOOKUP_HIT = 1,
+  // A hit on a result imported from an earlier run.
+  CACHE_LOOKUP_HIT_IMPORTED = 2,
+  // A miss that joined a verification already in flight.
+  CACHE_LOOKUP_INFLIGHT_JOIN = 3,
+  CACHE_LOOKUP_MAX
+};
+
+void RecordCacheLookup(CacheLookup lookup) {
+  UMA_HISTOGRAM_ENUMERATION("Net.CertVerifier_CacheLookup", lookup,
+                            CACHE_LOOKUP_MAX);
+}
+
+void PersistCertVerifyResult(const CertVerifyResult& result, Pickle* pickle) {
+  pickle->WriteBool(result.verified_cert.get() != NULL);
+  if (result.verified_cert.get())
+    result.verified_cert->Persist(pickle);
+  pickle->WriteUInt32(result.cert_status);
+  pickle->WriteBool(result.has_md2);
+  pickle->WriteBool(result.has_md4);
+  pickle->WriteBool(result.has_md5);
+  pickle->WriteBool(result.has_sha1);
+  pickle->WriteBool(result.is_issued_by_known_root);
+  pickle->WriteBool(result.is_issued_by_additional_trust_anchor);
+  pickle->WriteBool(result.common_name_fallback_used);
+  pickle->WriteInt(static_cast<int>(result.public_key_hashes.size()));
+  for (size_t i = 0; i < result.public_key_hashes.size(); ++i)
+    pickle->WriteString(result.public_key_hashes[i].ToString());
+}
+
+bool ReadCertVerifyResult(const Pickle& pickle,
+                          PickleIterator* iter,
+                          CertVerifyResult* result) {
+  bool has_verified_cert;
+  if (!iter->ReadBool(&has_verified_cert))
+    return false;
+  if (has_verified_cert) {
+    result->verified_cert = X509Certificate::CreateFromPickle(
+        pickle, iter, X509Certificate::PICKLETYPE_CERTIFICATE_CHAIN_V3);
+    if (!result->verified_cert.get())
+      return false;
+  }
+
+  int num_hashes;
+  if (!iter->ReadUInt32(&result->cert_status) ||
+      !iter->ReadBool(&result->has_md2) ||
+      !iter->ReadBool(&result->has_md4) ||
+      !iter->ReadBool(&result->has_md5) ||
+      !iter->ReadBool(&result->has_sha1) ||
+      !iter->ReadBool(&result->is_issued_by_known_root) ||
+      !iter->ReadBool(&result->is_issued_by_additional_trust_anchor) ||
+      !iter->ReadBool(&result->common_name_fallback_used) ||
+      !iter->ReadInt(&num_hashes) || num_hashes < 0) {
+    return false;
+  }
+  for (int i = 0; i < num_hashes; ++i) {
+    std::string hash_string;
+    HashValue hash;
+    if (!iter->ReadString(&hash_string) || !hash.FromString(hash_string))
+      return false;
+    result->public_key_hashes.push_back(hash);
+  }
+  return true;
+}
+
 base::Value* CertVerifyResultCallback(const CertVerifyResult& verify_result,
                                       NetLog::LogLevel log_level) {
   base::DictionaryValue* results = new base::DictionaryValue();
@@ -111,7 +185,8 @@ base::Value* CertVerifyResultCallback(const CertVerifyResult& verify_result,
 
 }  // namespace
 
-MultiThreadedCertVerifier::CachedResult::CachedResult() : error(ERR_FAILED) {}
+MultiThreadedCertVerifier::CachedResult::CachedResult()
+    : error(ERR_FAILED), imported(false) {}
 
 MultiThreadedCertVerifier::CachedResult::~CachedResult() {}
 
@@ -438,7 +513,12 @@ MultiThreadedCertVerifier::MultiThreadedCertVerifier(
       cache_hits_(0),
       inflight_joins_(0),
       verify_proc_(verify_proc),
-      trust_anchor_provider_(NULL) {
+      trust_anchor_provider_(NULL),
+      cache_observer_(NULL),
+      crl_set_sequence_(0),
+      has_root_store_fingerprint_(false) {
+  memset(root_store_fingerprint_.data, 0,
+         sizeof(root_store_fingerprint_.data));
   CertDatabase::GetInstance()->AddObserver(this);
 }
 
@@ -453,6 +533,138 @@ void MultiThreadedCertVerifier::SetCertTrustAnchorProvider(
   trust_anchor_provider_ = trust_anchor_provider;
 }
 
+void MultiThreadedCertVerifier::SetCacheObserver(CacheObserver* observer) {
+  DCHECK(CalledOnValidThread());
+  cache_observer_ = observer;
+}
+
+void MultiThreadedCertVerifier::SetRootStoreFingerprint(
+    const SHA1HashValue& fingerprint) {
+  DCHECK(CalledOnValidThread());
+  has_root_store_fingerprint_ = true;
+  root_store_fingerprint_ = fingerprint;
+}
+
+void MultiThreadedCertVerifier::SerializeCache(Pickle* pickle) {
+  DCHECK(CalledOnValidThread());
+
+  // Results that can't be matched to a trust store later aren't kept.
+  SHA1HashValue fingerprint;
+  bool has_fingerprint = GetTrustStoreFingerprint(&fingerprint);
+  if (!has_fingerprint)
+    memset(fingerprint.data, 0, sizeof(fingerprint.data));
+
+  // Failures are cheap to verify again, and shouldn't outlive a clock or
+  // configuration fix, so only successful results are kept.
+  CacheValidityPeriod now(base::Time::Now());
+  int num_results = 0;
+  for (CertVerifierCache::Iterator it(cache_);
+       has_fingerprint && it.HasNext(); it.Advance()) {
+    if (it.value().error == OK &&
+        CacheExpirationFunctor()(now, it.expiration())) {
+      ++num_results;
+    }
+  }
+
+  pickle->WriteInt(kSerializedCacheVersion);
+  pickle->WriteUInt32(crl_set_sequence_);
+  pickle->WriteBytes(fingerprint.data, sizeof(fingerprint.data));
+  pickle->WriteInt(num_results);
+  for (CertVerifierCache::Iterator it(cache_);
+       has_fingerprint && it.HasNext(); it.Advance()) {
+    if (it.value().error != OK ||
+        !CacheExpirationFunctor()(now, it.expiration())) {
+      continue;
+    }
+    const RequestParams& key = it.key();
+    pickle->WriteString(key.hostname);
+    pickle->WriteInt(key.flags);
+    pickle->WriteInt(static_cast<int>(key.hash_values.size()));
+    for (size_t i = 0; i < key.hash_values.size(); ++i) {
+      pickle->WriteBytes(key.hash_values[i].data,
+                         sizeof(key.hash_values[i].data));
+    }
+    pickle->WriteInt64(it.expiration().verification_time.ToInternalValue());
+    pickle->WriteInt64(it.expiration().expiration_time.ToInternalValue());
+    PersistCertVerifyResult(it.value().result, pickle);
+  }
+}
+
+bool MultiThreadedCertVerifier::ImportCache(const Pickle& pickle) {
+  DCHECK(CalledOnValidThread());
+
+  PickleIterator iter(pickle);
+  int version;
+  uint32 crl_set_sequence;
+  const char* fingerprint_data;
+  int num_results;
+  if (!iter.ReadInt(&version) || version != kSerializedCacheVersion ||
+      !iter.ReadUInt32(&crl_set_sequence) ||
+      !iter.ReadBytes(&fingerprint_data, sizeof(SHA1HashValue().data)) ||
+      !iter.ReadInt(&num_results) || num_results < 0) {
+    return false;
+  }
+
+  // Results verified against other root certificates or trust anchors may be
+  // trusted when they no longer should be. They are all dropped, and the
+  // observer is told so that it doesn't keep them either.
+  SHA1HashValue fingerprint;
+  if (!GetTrustStoreFingerprint(&fingerprint) ||
+      memcmp(fingerprint.data, fingerprint_data, sizeof(fingerprint.data))) {
+    if (num_results > 0 && cache_observer_)
+      cache_observer_->OnCacheChanged();
+    return true;
+  }
+
+  // Results verified against another CRLSet may miss revocations.
+  bool stale = crl_set_sequence_ != 0 && crl_set_sequence != crl_set_sequence_;
+  if (crl_set_sequence_ == 0)
+    crl_set_sequence_ = crl_set_sequence;
+
+  const base::Time now = base::Time::Now();
+  for (int i = 0; i < num_results; ++i) {
+    std::string hostname;
+    int flags;
+    int num_hash_values;
+    if (!iter.ReadString(&hostname) || !iter.ReadInt(&flags) ||
+        !iter.ReadInt(&num_hash_values) || num_hash_values < 2) {
+      return false;
+    }
+    std::vector<SHA1HashValue> hash_values(num_hash_values);
+    for (int j = 0; j < num_hash_values; ++j) {
+      const char* data;
+      if (!iter.ReadBytes(&data, sizeof(hash_values[j].data)))
+        return false;
+      memcpy(hash_values[j].data, data, sizeof(hash_values[j].data));
+    }
+
+    int64 verification_time;
+    int64 expiration_time;
+    CachedResult cached_result;
+    if (!iter.ReadInt64(&verification_time) ||
+        !iter.ReadInt64(&expiration_time) ||
+        !ReadCertVerifyResult(pickle, &iter, &cached_result.result)) {
+      return false;
+    }
+    cached_result.error = OK;
+    cached_result.imported = true;
+
+    RequestParams key(hash_values[0], hash_values[1], hostname, flags,
+                      CertificateList());
+    key.hash_values.swap(hash_values);
+    CacheValidityPeriod validity(
+        base::Time::FromInternalValue(verification_time),
+        base::Time::FromInternalValue(expiration_time));
+    if (stale || !CacheExpirationFunctor()(CacheValidityPeriod(now), validity))
+      continue;
+    // Results of this run are more recent.
+    if (cache_.Get(key, CacheValidityPeriod(now)))
+      continue;
+    cache_.Put(key, cached_result, CacheValidityPeriod(now), validity);
+  }
+  return true;
+}
+
 int MultiThreadedCertVerifier::Verify(X509Certificate* cert,
                                       const std::string& hostname,
                                       int flags,
@@ -477,10 +689,19 @@ int MultiThreadedCertVerifier::Verify(X509Certificate* cert,
 
   const RequestParams key(cert->fingerprint(), cert->ca_fingerprint(),
                           hostname, flags, additional_trust_anchors);
+  // Results verified against another CRLSet may miss revocations.
+  if (crl_set && crl_set->sequence() != crl_set_sequence_) {
+    if (cache_.size() > 0)
+      InvalidateCache();
+    crl_set_sequence_ = crl_set->sequence();
+  }
+
   const CertVerifierCache::value_type* cached_entry =
       cache_.Get(key, CacheValidityPeriod(base::Time::Now()));
   if (cached_entry) {
     ++cache_hits_;
+    RecordCacheLookup(cached_entry->imported ? CACHE_LOOKUP_HIT_IMPORTED
+                                             : CACHE_LOOKUP_HIT);
     *out_req = NULL;
     *verify_result = cached_entry->result;
     return cached_entry->error;
@@ -494,8 +715,10 @@ int MultiThreadedCertVerifier::Verify(X509Certificate* cert,
     // An identical request is in flight already. We'll just attach our
     // callback.
     inflight_joins_++;
+    RecordCacheLookup(CACHE_LOOKUP_INFLIGHT_JOIN);
     job = j->second;
   } else {
+    RecordCacheLookup(CACHE_LOOKUP_MISS);
     // Need to make a new request.
     CertVerifierWorker* worker =
         new CertVerifierWorker(verify_proc_.get(),
@@ -589,6 +812,8 @@ void MultiThreadedCertVerifier::HandleResult(
   cache_.Put(
       key, cached_result, CacheValidityPeriod(now),
       CacheValidityPeriod(now, now + base::TimeDelta::FromSeconds(kTTLSecs)));
+  if (error == OK && cache_observer_)
+    cache_observer_->OnCacheChanged();
 
   std::map<RequestParams, CertVerifierJob*>::iterator j;
   j = inflight_.find(key);
@@ -612,7 +837,34 @@ void MultiThreadedCertVerifier::OnCACertChanged(
     const X509Certificate* cert) {
   DCHECK(CalledOnValidThread());
 
+  InvalidateCache();
+}
+
+void MultiThreadedCertVerifier::InvalidateCache() {
   ClearCache();
+  if (cache_observer_)
+    cache_observer_->OnCacheChanged();
+}
+
+bool MultiThreadedCertVerifier::GetTrustStoreFingerprint(
+    SHA1HashValue* fingerprint) const {
+  if (!has_root_store_fingerprint_)
+    return false;
+
+  std::string data(reinterpret_cast<const char*>(root_store_fingerprint_.data),
+                   sizeof(root_store_fingerprint_.data));
+  if (trust_anchor_provider_) {
+    const CertificateList& additional_trust_anchors =
+        trust_anchor_provider_->GetAdditionalTrustAnchors();
+    for (size_t i = 0; i < additional_trust_anchors.size(); ++i) {
+      const SHA1HashValue& anchor = additional_trust_anchors[i]->fingerprint();
+      data.append(reinterpret_cast<const char*>(anchor.data),
+                  sizeof(anchor.data));
+    }
+  }
+  base::SHA1HashBytes(reinterpret_cast<const unsigned char*>(data.data()),
+                      data.size(), fingerprint->data);
+  return true;
 }
 
 }  // namespace net
@@ -22,6 +22,8 @@
 #include "net/cert/cert_verify_result.h"
 #include "net/cert/x509_cert_types.h"
 
+class Pickle;
+
 namespace net {
 
 class CertTrustAnchorProvider;
@@ -37,6 +39,17 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
       NON_EXPORTED_BASE(public base::NonThreadSafe),
       public CertDatabase::Observer {
  public:
+  // Observes changes to the verifier's cache of results.
+  class NET_EXPORT_PRIVATE CacheObserver {
+   public:
+    // Called after a successful result was added to the cache, or after the
+    // cache was cleared.
+    virtual void OnCacheChanged() = 0;
+
+   protected:
+    virtual ~CacheObserver() {}
+  };
+
   explicit MultiThreadedCertVerifier(CertVerifyProc* verify_proc);
 
   // When the verifier is destroyed, all certificate verifications requests are
@@ -53,6 +66,30 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
   void SetCertTrustAnchorProvider(
       CertTrustAnchorProvider* trust_anchor_provider);
 
+  // Sets the observer of the cache, which may be NULL. The observer is only
+  // accessed on the thread Verify() is called on.
+  void SetCacheObserver(CacheObserver* observer);
+
+  // Returns the CertVerifyProc the results are verified with.
+  CertVerifyProc* verify_proc() const { return verify_proc_.get(); }
+
+  // Sets the fingerprint of the root certificates the results are verified
+  // against, as returned by CertVerifyProc::GetRootStoreFingerprint(). The
+  // cache is neither serialized nor imported until it is set.
+  void SetRootStoreFingerprint(const SHA1HashValue& fingerprint);
+
+  // Appends the successful results of the cache that haven't expired to
+  // |pickle|, so that a later run can import them with ImportCache(), along
+  // with the fingerprint of the trust store they were verified against.
+  void SerializeCache(Pickle* pickle);
+
+  // Adds the results serialized by SerializeCache() to the cache. Results
+  // that have expired, or were verified against another CRLSet than the
+  // current one, are skipped. All the results are dropped if they were
+  // verified against another trust store, and the cache observer is told so
+  // that it discards them too. Returns false if |pickle| is corrupt.
+  bool ImportCache(const Pickle& pickle);
+
   // CertVerifier implementation
   int Verify(X509Certificate* cert,
              const std::string& hostname,
@@ -78,6 +115,10 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
                            RequestParamsComparators);
   FRIEND_TEST_ALL_PREFIXES(MultiThreadedCertVerifierTest,
                            CertTrustAnchorProvider);
+  FRIEND_TEST_ALL_PREFIXES(MultiThreadedCertVerifierTest, CRLSetChange);
+  FRIEND_TEST_ALL_PREFIXES(MultiThreadedCertVerifierTest, SerializeCache);
+  FRIEND_TEST_ALL_PREFIXES(MultiThreadedCertVerifierTest,
+                           SerializeCacheTrustStore);
 
   // Input parameters of a certificate verification request.
   struct NET_EXPORT_PRIVATE RequestParams {
@@ -102,6 +143,7 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
 
     int error;  // The return value of CertVerifier::Verify.
     CertVerifyResult result;  // The output of CertVerifier::Verify.
+    bool imported;  // True if the result was added by ImportCache().
   };
 
   // Rather than having a single validity point along a monotonically increasing
@@ -139,6 +181,14 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
   // CertDatabase::Observer methods:
   void OnCACertChanged(const X509Certificate* cert) override;
 
+  // Clears the cache, and tells |cache_observer_|.
+  void InvalidateCache();
+
+  // Sets |*fingerprint| to a hash of the root certificates and of the
+  // additional trust anchors the results are verified against. Returns false
+  // if the root certificates are unknown.
+  bool GetTrustStoreFingerprint(SHA1HashValue* fingerprint) const;
+
   // For unit testing.
   void ClearCache() { cache_.Clear(); }
   size_t GetCacheSize() const { return cache_.size(); }
@@ -164,6 +214,16 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
 
   CertTrustAnchorProvider* trust_anchor_provider_;
 
+  CacheObserver* cache_observer_;
+
+  // The sequence number of the CRLSet that the cached results were verified
+  // against, or 0 if none was seen yet.
+  uint32 crl_set_sequence_;
+
+  // Set by SetRootStoreFingerprint().
+  bool has_root_store_fingerprint_;
+  SHA1HashValue root_store_fingerprint_;
+
   DISALLOW_COPY_AND_ASSIGN(MultiThreadedCertVerifier);
 };
 
@@ -7,6 +7,7 @@
 #include "base/bind.h"
 #include "base/files/file_path.h"
 #include "base/format_macros.h"
+#include "base/pickle.h"
 #include "base/strings/stringprintf.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_log.h"
@@ -15,6 +16,7 @@
 #include "net/cert/cert_trust_anchor_provider.h"
 #include "net/cert/cert_verify_proc.h"
 #include "net/cert/cert_verify_result.h"
+#include "net/cert/crl_set.h"
 #include "net/cert/x509_certificate.h"
 #include "net/test/cert_test_util.h"
 #include "testing/gmock/include/gmock/gmock.h"
@@ -480,4 +482,175 @@ TEST_F(MultiThreadedCertVerifierTest, CertTrustAnchorProvider) {
   ASSERT_EQ(1u, verifier_.cache_hits());
 }
 
+// Tests that cached results are dropped when the CRLSet changes.
+TEST_F(MultiThreadedCertVerifierTest, CRLSetChange) {
+  base::FilePath certs_dir = GetTestCertsDirectory();
+  scoped_refptr<X509Certificate> test_cert(
+      ImportCertFromFile(certs_dir, "ok_cert.pem"));
+  ASSERT_NE(static_cast<X509Certificate*>(NULL), test_cert.get());
+  scoped_refptr<CRLSet> crl_set(CRLSet::EmptyCRLSetForTesting());
+
+  int error;
+  CertVerifyResult verify_result;
+  TestCompletionCallback callback;
+  CertVerifier::RequestHandle request_handle;
+
+  error = verifier_.Verify(test_cert.get(), "www.example.com", 0,
+                           crl_set.get(), &verify_result, callback.callback(),
+                           &request_handle, BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  error = callback.WaitForResult();
+  ASSERT_EQ(1u, verifier_.GetCacheSize());
+
+  // Pretend the results were verified against another CRLSet.
+  verifier_.crl_set_sequence_ = crl_set->sequence() + 1;
+  error = verifier_.Verify(test_cert.get(), "www.example.com", 0,
+                           crl_set.get(), &verify_result, callback.callback(),
+                           &request_handle, BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  error = callback.WaitForResult();
+  EXPECT_EQ(0u, verifier_.cache_hits());
+  EXPECT_EQ(crl_set->sequence(), verifier_.crl_set_sequence_);
+}
+
+// Tests that successful results are kept by SerializeCache() and
+// ImportCache().
+TEST_F(MultiThreadedCertVerifierTest, SerializeCache) {
+  base::FilePath certs_dir = GetTestCertsDirectory();
+  scoped_refptr<X509Certificate> test_cert(
+      ImportCertFromFile(certs_dir, "ok_cert.pem"));
+  ASSERT_NE(static_cast<X509Certificate*>(NULL), test_cert.get());
+
+  // MockCertVerifyProc only fails, which isn't serialized, so add a
+  // successful result to the cache directly.
+  int error;
+  CertVerifyResult verify_result;
+  TestCompletionCallback callback;
+  CertVerifier::RequestHandle request_handle;
+  error = verifier_.Verify(test_cert.get(), "www.failure.com", 0, NULL,
+                           &verify_result, callback.callback(),
+                           &request_handle, BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  error = callback.WaitForResult();
+
+  MultiThreadedCertVerifier::CachedResult cached_result;
+  cached_result.error = OK;
+  cached_result.result.verified_cert = test_cert;
+  cached_result.result.is_issued_by_known_root = true;
+  base::Time now = base::Time::Now();
+  verifier_.cache_.Put(
+      MultiThreadedCertVerifier::RequestParams(
+          test_cert->fingerprint(), test_cert->ca_fingerprint(),
+          "www.example.com", 0, CertificateList()),
+      cached_result, MultiThreadedCertVerifier::CacheValidityPeriod(now),
+      MultiThreadedCertVerifier::CacheValidityPeriod(
+          now, now + base::TimeDelta::FromMinutes(30)));
+  ASSERT_EQ(2u, verifier_.GetCacheSize());
+
+  // Nothing is kept until the root certificates are known.
+  Pickle empty_pickle;
+  verifier_.SerializeCache(&empty_pickle);
+  MultiThreadedCertVerifier verifier1(new MockCertVerifyProc());
+  ASSERT_TRUE(verifier1.ImportCache(empty_pickle));
+  EXPECT_EQ(0u, verifier1.GetCacheSize());
+
+  SHA1HashValue root_store_fingerprint;
+  memset(root_store_fingerprint.data, 1, sizeof(root_store_fingerprint.data));
+  verifier_.SetRootStoreFingerprint(root_store_fingerprint);
+  Pickle pickle;
+  verifier_.SerializeCache(&pickle);
+
+  MultiThreadedCertVerifier verifier2(new MockCertVerifyProc());
+  verifier2.SetRootStoreFingerprint(root_store_fingerprint);
+  ASSERT_TRUE(verifier2.ImportCache(pickle));
+  EXPECT_EQ(1u, verifier2.GetCacheSize());
+  error = verifier2.Verify(test_cert.get(), "www.example.com", 0, NULL,
+                           &verify_result, callback.callback(),
+                           &request_handle, BoundNetLog());
+  EXPECT_EQ(OK, error);
+  EXPECT_EQ(1u, verifier2.cache_hits());
+  EXPECT_TRUE(verify_result.is_issued_by_known_root);
+  ASSERT_TRUE(verify_result.verified_cert.get());
+  EXPECT_TRUE(verify_result.verified_cert->Equals(test_cert.get()));
+
+  // Results verified against another CRLSet are skipped.
+  MultiThreadedCertVerifier verifier3(new MockCertVerifyProc());
+  verifier3.SetRootStoreFingerprint(root_store_fingerprint);
+  verifier3.crl_set_sequence_ = verifier_.crl_set_sequence_ + 1;
+  ASSERT_TRUE(verifier3.ImportCache(pickle));
+  EXPECT_EQ(0u, verifier3.GetCacheSize());
+}
+
+class TestCacheObserver : public MultiThreadedCertVerifier::CacheObserver {
+ public:
+  TestCacheObserver() : changes_(0) {}
+
+  void OnCacheChanged() override { ++changes_; }
+
+  int changes() const { return changes_; }
+
+ private:
+  int changes_;
+};
+
+// Tests that results verified against another trust store are discarded.
+TEST_F(MultiThreadedCertVerifierTest, SerializeCacheTrustStore) {
+  base::FilePath certs_dir = GetTestCertsDirectory();
+  scoped_refptr<X509Certificate> test_cert(
+      ImportCertFromFile(certs_dir, "ok_cert.pem"));
+  ASSERT_NE(static_cast<X509Certificate*>(NULL), test_cert.get());
+
+  MultiThreadedCertVerifier::CachedResult cached_result;
+  cached_result.error = OK;
+  cached_result.result.verified_cert = test_cert;
+  base::Time now = base::Time::Now();
+  verifier_.cache_.Put(
+      MultiThreadedCertVerifier::RequestParams(
+          test_cert->fingerprint(), test_cert->ca_fingerprint(),
+          "www.example.com", 0, CertificateList()),
+      cached_result, MultiThreadedCertVerifier::CacheValidityPeriod(now),
+      MultiThreadedCertVerifier::CacheValidityPeriod(
+          now, now + base::TimeDelta::FromMinutes(30)));
+
+  SHA1HashValue root_store_fingerprint;
+  memset(root_store_fingerprint.data, 1, sizeof(root_store_fingerprint.data));
+  verifier_.SetRootStoreFingerprint(root_store_fingerprint);
+  Pickle pickle;
+  verifier_.SerializeCache(&pickle);
+
+  // Other root certificates.
+  SHA1HashValue other_fingerprint = root_store_fingerprint;
+  other_fingerprint.data[0] = 2;
+  MultiThreadedCertVerifier verifier2(new MockCertVerifyProc());
+  TestCacheObserver observer2;
+  verifier2.SetCacheObserver(&observer2);
+  verifier2.SetRootStoreFingerprint(other_fingerprint);
+  ASSERT_TRUE(verifier2.ImportCache(pickle));
+  EXPECT_EQ(0u, verifier2.GetCacheSize());
+  EXPECT_EQ(1, observer2.changes());
+
+  // Unknown root certificates.
+  MultiThreadedCertVerifier verifier3(new MockCertVerifyProc());
+  ASSERT_TRUE(verifier3.ImportCache(pickle));
+  EXPECT_EQ(0u, verifier3.GetCacheSize());
+
+  // Another additional trust anchor.
+  CertificateList anchors;
+  anchors.push_back(test_cert);
+  MockCertTrustAnchorProvider trust_provider;
+  EXPECT_CALL(trust_provider, GetAdditionalTrustAnchors())
+      .WillRepeatedly(ReturnRef(anchors));
+  MultiThreadedCertVerifier verifier4(new MockCertVerifyProc());
+  verifier4.SetCertTrustAnchorProvider(&trust_provider);
+  verifier4.SetRootStoreFingerprint(root_store_fingerprint);
+  ASSERT_TRUE(verifier4.ImportCache(pickle));
+  EXPECT_EQ(0u, verifier4.GetCacheSize());
+
+  // The same trust store.
+  MultiThreadedCertVerifier verifier5(new MockCertVerifyProc());
+  verifier5.SetRootStoreFingerprint(root_store_fingerprint);
+  ASSERT_TRUE(verifier5.ImportCache(pickle));
+  EXPECT_EQ(1u, verifier5.GetCacheSize());
+}
+
 }  // namespace net
@@ -3,14 +3,17 @@
 // found in the LICENSE file.
 
 #include "base/basictypes.h"
+#include "base/bind.h"
 #include "base/files/file_util.h"
 #include "base/metrics/field_trial.h"
 #include "base/port.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/third_party/dynamic_annotations/dynamic_annotations.h"
 #include "base/thread_task_runner_handle.h"
 #include "base/threading/platform_thread.h"
+#include "base/threading/thread.h"
 #include "base/threading/thread_restrictions.h"
 #include "net/base/cache_type.h"
 #include "net/base/io_buffer.h"
@@ -64,6 +67,16 @@ scoped_ptr<disk_cache::BackendImpl> CreateExistingEntryCache(
   return cache.Pass();
 }
 
+// Lets the simple cache backends complete the operations in flight, and the
+// dooms of any eviction they start.
+void FlushSimpleCacheOperations() {
+  for (int i = 0; i < 2; ++i) {
+    base::MessageLoop::current()->RunUntilIdle();
+    disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+    base::MessageLoop::current()->RunUntilIdle();
+  }
+}
+
 }  // namespace
 
 // Tests that can run with different types of caches.
@@ -826,6 +839,118 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyLoad) {
   BackendLoad();
 }
 
+// Tests that the memory-only cache evicts the least recently used entries of
+// all its shards first.
+TEST_F(DiskCacheBackendTest, MemoryOnlyTrimAcrossShards) {
+  const int kMaxSize = 3 * 1024 * 1024;
+  const int kBufferSize = 100 * 1024;
+  const int kNumEntries = 40;
+  SetMaxSize(kMaxSize);
+  SetMemoryOnlyMode();
+  InitCache();
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kBufferSize));
+  CacheTestFillBuffer(buffer->data(), kBufferSize, false);
+  for (int i = 0; i < kNumEntries; ++i) {
+    disk_cache::Entry* entry;
+    ASSERT_EQ(net::OK, CreateEntry(base::IntToString(i), &entry));
+    EXPECT_EQ(kBufferSize,
+              WriteData(entry, 1, 0, buffer.get(), kBufferSize, false));
+    entry->Close();
+    AddDelay();
+
+    // Keep the first entry recently used.
+    if (i == kNumEntries / 2) {
+      ASSERT_EQ(net::OK, OpenEntry("0", &entry));
+      EXPECT_EQ(kBufferSize,
+                ReadData(entry, 1, 0, buffer.get(), kBufferSize));
+      entry->Close();
+      AddDelay();
+    }
+  }
+  EXPECT_GT(kNumEntries, cache_->GetEntryCount());
+
+  // The entries that are left are the most recent ones, whatever their shard.
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, OpenEntry("0", &entry));
+  entry->Close();
+  bool found_previous = false;
+  for (int i = 1; i < kNumEntries; ++i) {
+    const bool found =
+        OpenEntry(base::IntToString(i), &entry) == net::OK;
+    if (found)
+      entry->Close();
+    EXPECT_TRUE(found || !found_previous) << i;
+    found_previous = found;
+  }
+  EXPECT_TRUE(found_previous);
+}
+
+namespace {
+
+// Opens or creates the entries of |cache|, writes to them, reads them back and
+// dooms some of them. Several threads run this at the same time, on the same
+// keys. The memory-only cache completes every operation synchronously.
+void UseMemoryOnlyCache(disk_cache::Backend* cache) {
+  const int kSize = 10 * 1024;
+  const int kSparseSize = 4 * 1024;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  net::CompletionCallback callback;
+
+  for (int i = 0; i < 500; ++i) {
+    const std::string key = base::IntToString(i % 50);
+    disk_cache::Entry* entry;
+    while (cache->OpenEntry(key, &entry, callback) != net::OK &&
+           cache->CreateEntry(key, &entry, callback) != net::OK) {
+    }
+
+    // All the threads write the same data.
+    EXPECT_EQ(kSize,
+              entry->WriteData(0, 0, buffer.get(), kSize, callback, true));
+    EXPECT_EQ(kSize, entry->ReadData(0, 0, read_buffer.get(), kSize, callback));
+    EXPECT_EQ(0, memcmp(buffer->data(), read_buffer->data(), kSize));
+
+    // The children of a sparse entry can be evicted while it is open, so
+    // there is no telling how much is read back.
+    const int64 offset = (i % 4) * kSparseSize;
+    EXPECT_EQ(kSparseSize, entry->WriteSparseData(offset, buffer.get(),
+                                                  kSparseSize, callback));
+    EXPECT_LE(0, entry->ReadSparseData(offset, read_buffer.get(), kSparseSize,
+                                       callback));
+
+    if (i % 7 == 0)
+      entry->Doom();
+    entry->Close();
+  }
+}
+
+}  // namespace
+
+// Tests that the memory-only cache can be used from several threads at once.
+TEST_F(DiskCacheBackendTest, MemoryOnlyConcurrentAccess) {
+  SetMaxSize(200 * 1024);
+  SetMemoryOnlyMode();
+  InitCache();
+
+  base::Thread thread1("MemoryCache1");
+  base::Thread thread2("MemoryCache2");
+  ASSERT_TRUE(thread1.Start());
+  ASSERT_TRUE(thread2.Start());
+  thread1.task_runner()->PostTask(
+      FROM_HERE, base::Bind(&UseMemoryOnlyCache, cache_.get()));
+  thread2.task_runner()->PostTask(
+      FROM_HERE, base::Bind(&UseMemoryOnlyCache, cache_.get()));
+  UseMemoryOnlyCache(cache_.get());
+  thread1.Stop();
+  thread2.Stop();
+
+  EXPECT_GE(50, cache_->GetEntryCount());
+  EXPECT_EQ(net::OK, DoomAllEntries());
+  EXPECT_EQ(0, cache_->GetEntryCount());
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheLoad) {
   SetCacheType(net::APP_CACHE);
   // Work with a tiny index table (16 entries)
@@ -3204,6 +3329,263 @@ TEST_F(DiskCacheBackendTest, SIMPLE_MAYBE_MACOS(SimpleCacheAppCacheLoad)) {
   BackendLoad();
 }
 
+// Selects the I/O engine of the simple cache backends created in its scope.
+class ScopedSimpleIOEngine {
+ public:
+  explicit ScopedSimpleIOEngine(
+      disk_cache::SimpleBackendImpl::IOEngineType type) {
+    disk_cache::SimpleBackendImpl::SetIOEngineForTesting(type);
+  }
+  ~ScopedSimpleIOEngine() {
+    disk_cache::SimpleBackendImpl::SetIOEngineForTesting(
+        disk_cache::SimpleBackendImpl::IO_ENGINE_DEFAULT);
+  }
+};
+
+TEST_F(DiskCacheBackendTest, SimpleCacheBatchedIOEngineBasics) {
+  ScopedSimpleIOEngine engine(
+      disk_cache::SimpleBackendImpl::IO_ENGINE_BATCHED);
+  SetSimpleCacheMode();
+  BackendBasics();
+}
+
+TEST_F(DiskCacheBackendTest,
+       SIMPLE_MAYBE_MACOS(SimpleCacheBatchedIOEngineLoad)) {
+  ScopedSimpleIOEngine engine(
+      disk_cache::SimpleBackendImpl::IO_ENGINE_BATCHED);
+  SetMaxSize(0x100000);
+  SetSimpleCacheMode();
+  BackendLoad();
+}
+
+// Enables an experiment in the simple cache backends created in its scope.
+class ScopedSimpleCacheExperiment {
+ public:
+  explicit ScopedSimpleCacheExperiment(
+      disk_cache::SimpleBackendImpl::Experiment experiment)
+      : experiment_(experiment) {
+    disk_cache::SimpleBackendImpl::SetExperimentEnabledForTesting(experiment_,
+                                                                  true);
+  }
+  ~ScopedSimpleCacheExperiment() {
+    disk_cache::SimpleBackendImpl::SetExperimentEnabledForTesting(experiment_,
+                                                                  false);
+  }
+
+ private:
+  const disk_cache::SimpleBackendImpl::Experiment experiment_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedSimpleCacheExperiment);
+};
+
+TEST_F(DiskCacheBackendTest, SimpleCacheSmallEntryStoreBasics) {
+  ScopedSimpleCacheExperiment store(
+      disk_cache::SimpleBackendImpl::EXPERIMENT_SMALL_ENTRY_STORE);
+  SetSimpleCacheMode();
+  BackendBasics();
+}
+
+TEST_F(DiskCacheBackendTest,
+       SIMPLE_MAYBE_MACOS(SimpleCacheSmallEntryStoreLoad)) {
+  ScopedSimpleCacheExperiment store(
+      disk_cache::SimpleBackendImpl::EXPERIMENT_SMALL_ENTRY_STORE);
+  SetMaxSize(0x100000);
+  SetSimpleCacheMode();
+  BackendLoad();
+}
+
+TEST_F(DiskCacheBackendTest, SimpleCacheSmallEntryStoreDoomAll) {
+  ScopedSimpleCacheExperiment store(
+      disk_cache::SimpleBackendImpl::EXPERIMENT_SMALL_ENTRY_STORE);
+  SetSimpleCacheMode();
+  BackendDoomAll();
+}
+
+// Tests that small entries are packed, that entries growing out of the store
+// get their own files, and that both survive a restart.
+TEST_F(DiskCacheBackendTest, SimpleCacheSmallEntryStoreUnpack) {
+  ScopedSimpleCacheExperiment store(
+      disk_cache::SimpleBackendImpl::EXPERIMENT_SMALL_ENTRY_STORE);
+  SetSimpleCacheMode();
+  InitCache();
+
+  const int kSmallSize = 100;
+  const int kLargeSize = 20000;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kLargeSize));
+  CacheTestFillBuffer(buffer->data(), kLargeSize, false);
+
+  const char* const kKeys[] = { "small", "large", "grown", "stream 2" };
+  for (size_t i = 0; i < arraysize(kKeys); ++i) {
+    disk_cache::Entry* entry;
+    ASSERT_EQ(net::OK, CreateEntry(kKeys[i], &entry));
+    EXPECT_EQ(kSmallSize,
+              WriteData(entry, 0, 0, buffer.get(), kSmallSize, false));
+    const int size = i == 1 ? kLargeSize : kSmallSize;
+    EXPECT_EQ(size, WriteData(entry, 1, 0, buffer.get(), size, false));
+    entry->Close();
+  }
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, OpenEntry("grown", &entry));
+  scoped_refptr<net::IOBuffer> tail(
+      new net::WrappedIOBuffer(buffer->data() + kSmallSize));
+  EXPECT_EQ(kLargeSize - kSmallSize,
+            WriteData(entry, 1, kSmallSize, tail.get(),
+                      kLargeSize - kSmallSize, false));
+  entry->Close();
+  ASSERT_EQ(net::OK, OpenEntry("stream 2", &entry));
+  EXPECT_EQ(kSmallSize,
+            WriteData(entry, 2, 0, buffer.get(), kSmallSize, false));
+  entry->Close();
+
+  // Opening the entries waits for their pending closes.
+  for (size_t i = 0; i < arraysize(kKeys); ++i) {
+    ASSERT_EQ(net::OK, OpenEntry(kKeys[i], &entry));
+    entry->Close();
+    const base::FilePath file0_path = cache_path_.AppendASCII(
+        disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(kKeys[i], 0));
+    EXPECT_EQ(i != 0, base::PathExists(file0_path)) << kKeys[i];
+  }
+
+  cache_.reset();
+  DisableFirstCleanup();
+  InitCache();
+  EXPECT_EQ(4, cache_->GetEntryCount());
+
+  scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kLargeSize));
+  for (size_t i = 0; i < arraysize(kKeys); ++i) {
+    ASSERT_EQ(net::OK, OpenEntry(kKeys[i], &entry)) << kKeys[i];
+    EXPECT_EQ(kSmallSize,
+              ReadData(entry, 0, 0, read_buffer.get(), kLargeSize));
+    EXPECT_EQ(0, memcmp(buffer->data(), read_buffer->data(), kSmallSize));
+    const int size = i == 0 || i == 3 ? kSmallSize : kLargeSize;
+    EXPECT_EQ(size, ReadData(entry, 1, 0, read_buffer.get(), kLargeSize));
+    EXPECT_EQ(0, memcmp(buffer->data(), read_buffer->data(), size));
+    EXPECT_EQ(i == 3 ? kSmallSize : 0, entry->GetDataSize(2));
+    entry->Close();
+  }
+}
+
+TEST_F(DiskCacheBackendTest, SimpleCacheIndexTableBasics) {
+  ScopedSimpleCacheExperiment table(
+      disk_cache::SimpleBackendImpl::EXPERIMENT_INDEX_TABLE);
+  SetSimpleCacheMode();
+  BackendBasics();
+}
+
+// Tests that entries created and doomed after the index table was written
+// are found in it after a restart.
+TEST_F(DiskCacheBackendTest, SimpleCacheIndexTableUpdate) {
+  ScopedSimpleCacheExperiment table(
+      disk_cache::SimpleBackendImpl::EXPERIMENT_INDEX_TABLE);
+  SetSimpleCacheMode();
+  InitCache();
+
+  const int kNumEntries = 20;
+  for (int i = 0; i < kNumEntries; ++i) {
+    disk_cache::Entry* entry;
+    ASSERT_EQ(net::OK, CreateEntry(base::IntToString(i), &entry));
+    entry->Close();
+  }
+  cache_.reset();
+  DisableFirstCleanup();
+  InitCache();
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+  for (int i = 0; i < kNumEntries; i += 2)
+    EXPECT_EQ(net::OK, DoomEntry(base::IntToString(i)));
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry("new entry", &entry));
+  entry->Close();
+  cache_.reset();
+  InitCache();
+  EXPECT_EQ(kNumEntries / 2 + 1, cache_->GetEntryCount());
+  ASSERT_EQ(net::OK, OpenEntry("new entry", &entry));
+  entry->Close();
+  EXPECT_NE(net::OK, OpenEntry("0", &entry));
+  ASSERT_EQ(net::OK, OpenEntry("1", &entry));
+  entry->Close();
+}
+
+TEST_F(DiskCacheBackendTest, SimpleCacheTinyLFUBasics) {
+  ScopedSimpleCacheExperiment tiny_lfu(
+      disk_cache::SimpleBackendImpl::EXPERIMENT_TINY_LFU);
+  SetSimpleCacheMode();
+  BackendBasics();
+}
+
+// Tests that with the TinyLFU policy, entries that keep getting used survive a
+// scan of entries used once that fills the cache twice over, which would
+// evict them under LRU.
+TEST_F(DiskCacheBackendTest, SimpleCacheTinyLFUEviction) {
+  ScopedSimpleCacheExperiment tiny_lfu(
+      disk_cache::SimpleBackendImpl::EXPERIMENT_TINY_LFU);
+  const int kSize = 8 * 1024;
+  const int kMaxEntries = 40;
+  const int kNumHotEntries = 4;
+  SetMaxSize(kMaxEntries * kSize);
+  SetSimpleCacheMode();
+  InitCache();
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  disk_cache::Entry* entry;
+
+  // Fills the cache past its limit, so that the main cache of the policy
+  // holds entries when the hot entries are created.
+  for (int i = 0; i < kMaxEntries + 5; ++i) {
+    ASSERT_EQ(net::OK, CreateEntry(base::StringPrintf("fill %d", i), &entry));
+    EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+    entry->Close();
+    FlushSimpleCacheOperations();
+  }
+  EXPECT_GT(kMaxEntries, cache_->GetEntryCount());
+
+  for (int i = 0; i < kNumHotEntries; ++i) {
+    const std::string key = base::StringPrintf("hot %d", i);
+    ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+    EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+    entry->Close();
+    FlushSimpleCacheOperations();
+    for (int j = 0; j < 3; ++j) {
+      ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+      EXPECT_EQ(kSize, ReadData(entry, 1, 0, buffer.get(), kSize));
+      entry->Close();
+    }
+    FlushSimpleCacheOperations();
+  }
+
+  // Once the hot entries have left the window, another use of each protects
+  // them.
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_EQ(net::OK,
+              CreateEntry(base::StringPrintf("more fill %d", i), &entry));
+    EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+    entry->Close();
+    FlushSimpleCacheOperations();
+  }
+  for (int i = 0; i < kNumHotEntries; ++i) {
+    ASSERT_EQ(net::OK, OpenEntry(base::StringPrintf("hot %d", i), &entry));
+    EXPECT_EQ(kSize, ReadData(entry, 1, 0, buffer.get(), kSize));
+    entry->Close();
+  }
+  FlushSimpleCacheOperations();
+
+  for (int i = 0; i < 2 * kMaxEntries; ++i) {
+    ASSERT_EQ(net::OK, CreateEntry(base::StringPrintf("scan %d", i), &entry));
+    EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+    entry->Close();
+    FlushSimpleCacheOperations();
+  }
+
+  EXPECT_GT(kMaxEntries, cache_->GetEntryCount());
+  for (int i = 0; i < kNumHotEntries; ++i) {
+    ASSERT_EQ(net::OK, OpenEntry(base::StringPrintf("hot %d", i), &entry));
+    entry->Close();
+  }
+  // The least recently used entry of the main cache went first.
+  EXPECT_NE(net::OK, OpenEntry("fill 0", &entry));
+}
+
 TEST_F(DiskCacheBackendTest, SimpleDoomRecent) {
   SetSimpleCacheMode();
   BackendDoomRecent();
@@ -52,6 +52,10 @@ const int kBaseTableLen = 64 * 1024;
 // Avoid trimming the cache for the first 5 minutes (10 timer ticks).
 const int kTrimDelay = 10;
 
+// Sparse operations that span more than this number of 1 MB children wait for
+// the first ones to complete before moving on.
+const int kDefaultSparseIODepth = 4;
+
 int DesiredIndexTableLen(int32 storage_size) {
   if (storage_size <= k64kEntriesStore)
     return kBaseTableLen;
@@ -123,6 +127,8 @@ BackendImpl::BackendImpl(
       cache_type_(net::DISK_CACHE),
       uma_report_(0),
       user_flags_(0),
+      sparse_io_depth_(kDefaultSparseIODepth),
+      removal_count_(0),
       init_(false),
       restarted_(false),
       unit_test_(false),
@@ -150,6 +156,8 @@ BackendImpl::BackendImpl(
       cache_type_(net::DISK_CACHE),
       uma_report_(0),
       user_flags_(kMask),
+      sparse_io_depth_(kDefaultSparseIODepth),
+      removal_count_(0),
       init_(false),
       restarted_(false),
       unit_test_(false),
@@ -695,6 +703,11 @@ void BackendImpl::SetType(net::CacheType type) {
   cache_type_ = type;
 }
 
+void BackendImpl::SetSparseIODepth(int depth) {
+  DCHECK_GT(depth, 0);
+  sparse_io_depth_ = depth;
+}
+
 base::FilePath BackendImpl::GetFileName(Addr address) const {
   if (!address.is_separate_file() || !address.is_initialized()) {
     NOTREACHED();
@@ -798,6 +811,7 @@ void BackendImpl::InternalDoomEntry(EntryImpl* entry) {
 
   Trace("Doom entry 0x%p", entry);
 
+  removal_count_++;
   if (!entry->doomed()) {
     // We may have doomed this entry from within MatchEntry.
     eviction_.OnDoomEntry(entry);
@@ -895,6 +909,14 @@ int32 BackendImpl::GetCurrentEntryId() const {
   return data_->header.this_id;
 }
 
+uint32 BackendImpl::GetRemovalCount() const {
+  return removal_count_;
+}
+
+void BackendImpl::OnEntryEvicted() {
+  removal_count_++;
+}
+
 int BackendImpl::MaxFileSize() const {
   return cache_type() == net::PNACL_CACHE ? max_size_ : max_size_ / 8;
 }
@@ -1503,6 +1525,7 @@ void BackendImpl::PrepareForRestart() {
   rankings_.Reset();
   init_ = false;
   restarted_ = true;
+  removal_count_++;
 }
 
 int BackendImpl::NewEntry(Addr address, EntryImpl** entry) {
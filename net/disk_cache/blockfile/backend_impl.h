@@ -89,6 +89,11 @@ class NET_EXPORT_PRIVATE BackendImpl : public Backend {
   // Sets the cache type for this backend.
   void SetType(net::CacheType type);
 
+  // Sets the number of child entries that a single sparse operation can have
+  // IO in flight with at the same time.
+  void SetSparseIODepth(int depth);
+  int sparse_io_depth() const { return sparse_io_depth_; }
+
   // Returns the full name for an external storage file.
   base::FilePath GetFileName(Addr address) const;
 
@@ -150,6 +155,15 @@ class NET_EXPORT_PRIVATE BackendImpl : public Backend {
   // Returns the id being used on this run of the cache.
   int32 GetCurrentEntryId() const;
 
+  // Returns a count that changes every time an entry is doomed or evicted, so
+  // that what is known about an entry that is not open holds only while the
+  // count stays the same.
+  uint32 GetRemovalCount() const;
+
+  // This method must be called when the data of an entry is evicted without
+  // dooming the entry.
+  void OnEntryEvicted();
+
   // Returns the maximum size for a file to reside on the cache.
   int MaxFileSize() const;
 
@@ -383,6 +397,8 @@ class NET_EXPORT_PRIVATE BackendImpl : public Backend {
   net::CacheType cache_type_;
   int uma_report_;  // Controls transmission of UMA data.
   uint32 user_flags_;  // Flags set by the user.
+  int sparse_io_depth_;  // Children with IO in flight per sparse operation.
+  uint32 removal_count_;  // Entries doomed or evicted so far.
   bool init_;  // controls the initialization of the system.
   bool restarted_;
   bool unit_test_;
@@ -17,10 +17,14 @@
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/sys_info.h"
+#include "base/task_runner_util.h"
+#include "base/thread_task_runner_handle.h"
 #include "base/threading/thread_restrictions.h"
 #include "base/time/time.h"
 #include "base/timer/timer.h"
+#include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
+#include "net/disk_cache/blockfile/backend_worker_v3.h"
 #include "net/disk_cache/blockfile/disk_format_v3.h"
 #include "net/disk_cache/blockfile/entry_impl_v3.h"
 #include "net/disk_cache/blockfile/errors.h"
@@ -28,6 +32,7 @@
 #include "net/disk_cache/blockfile/file.h"
 #include "net/disk_cache/blockfile/histogram_macros_v3.h"
 #include "net/disk_cache/blockfile/index_table_v3.h"
+#include "net/disk_cache/blockfile/mapped_file.h"
 #include "net/disk_cache/blockfile/storage_block-inl.h"
 #include "net/disk_cache/cache_util.h"
 
@@ -57,7 +62,8 @@ BackendImplV3::BackendImplV3(
     const base::FilePath& path,
     const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread,
     net::NetLog* net_log)
-    : index_(NULL),
+    : index_(this),
+      growing_index_(false),
       path_(path),
       block_files_(),
       max_size_(0),
@@ -73,6 +79,7 @@ BackendImplV3::BackendImplV3(
       first_timer_(true),
       user_load_(false),
       net_log_(net_log),
+      cache_thread_(cache_thread),
       ptr_factory_(this) {
 }
 
@@ -85,6 +92,15 @@ int BackendImplV3::Init(const CompletionCallback& callback) {
   if (init_)
     return net::ERR_FAILED;
 
+  // The worker opens the index files on the cache thread, and the tables are
+  // used from this thread through the memory mapped files.
+  worker_ = new Worker(path_, base::ThreadTaskRunnerHandle::Get());
+  InitResult* result = new InitResult;
+  base::PostTaskAndReplyWithResult(
+      cache_thread_.get(), FROM_HERE,
+      base::Bind(&Worker::Init, worker_, max_size_, result),
+      base::Bind(&BackendImplV3::OnInitComplete, GetWeakPtr(), callback,
+                 base::Owned(result)));
   return net::ERR_IO_PENDING;
 }
 
@@ -113,6 +129,10 @@ void BackendImplV3::SetType(net::CacheType type) {
   cache_type_ = type;
 }
 
+void BackendImplV3::SetFlags(uint32 flags) {
+  user_flags_ |= flags;
+}
+
 bool BackendImplV3::CreateBlock(FileType block_type, int block_count,
                                 Addr* block_address) {
   return block_files_.CreateBlock(block_type, block_count, block_address);
@@ -367,15 +387,6 @@ void BackendImplV3::SetNewEviction() {
   lru_eviction_ = false;
 }
 
-void BackendImplV3::SetFlags(uint32 flags) {
-  user_flags_ |= flags;
-}
-
-int BackendImplV3::FlushQueueForTest(const CompletionCallback& callback) {
-  background_queue_.FlushQueue(callback);
-  return net::ERR_IO_PENDING;
-}
-
 void BackendImplV3::TrimForTest(bool empty) {
   eviction_.SetTestMode();
   eviction_.TrimCache(empty);
@@ -426,7 +437,7 @@ int32 BackendImplV3::GetEntryCount() const {
 int BackendImplV3::OpenEntry(const std::string& key, Entry** entry,
                              const CompletionCallback& callback) {
   if (disabled_)
-    return NULL;
+    return net::ERR_FAILED;
 
   TimeTicks start = TimeTicks::Now();
   uint32 hash = base::Hash(key);
@@ -451,7 +462,7 @@ int BackendImplV3::OpenEntry(const std::string& key, Entry** entry,
     CACHE_UMA(HOURS, "AllOpenByTotalHours.Miss", 0, total_hours);
     CACHE_UMA(HOURS, "AllOpenByUseHours.Miss", 0, use_hours);
     stats_.OnEvent(Stats::OPEN_MISS);
-    return NULL;
+    return net::ERR_FAILED;
   }
 
   eviction_.OnOpenEntry(cache_entry);
@@ -465,15 +476,17 @@ int BackendImplV3::OpenEntry(const std::string& key, Entry** entry,
   CACHE_UMA(HOURS, "AllOpenByUseHours.Hit", 0, use_hours);
   stats_.OnEvent(Stats::OPEN_HIT);
   SIMPLE_STATS_COUNTER("disk_cache.hit");
-  return cache_entry;
+  *entry = cache_entry;
+  return net::OK;
 }
 
 int BackendImplV3::CreateEntry(const std::string& key, Entry** entry,
                                const CompletionCallback& callback) {
   if (disabled_ || key.empty())
-    return NULL;
+    return net::ERR_FAILED;
 
   TimeTicks start = TimeTicks::Now();
+  uint32 hash = base::Hash(key);
   Trace("Create hash 0x%x", hash);
 
   scoped_refptr<EntryImpl> parent;
@@ -483,8 +496,10 @@ int BackendImplV3::CreateEntry(const std::string& key, Entry** entry,
     // a hash conflict.
     bool error;
     EntryImpl* old_entry = MatchEntry(key, hash, false, Addr(), &error);
-    if (old_entry)
-      return ResurrectEntry(old_entry);
+    if (old_entry) {
+      *entry = ResurrectEntry(old_entry);
+      return *entry ? net::OK : net::ERR_FAILED;
+    }
 
     EntryImpl* parent_entry = MatchEntry(key, hash, true, Addr(), &error);
     DCHECK(!error);
@@ -493,7 +508,7 @@ int BackendImplV3::CreateEntry(const std::string& key, Entry** entry,
     } else if (data_->table[hash & mask_]) {
       // We should have corrected the problem.
       NOTREACHED();
-      return NULL;
+      return net::ERR_FAILED;
     }
   }
 
@@ -514,7 +529,7 @@ int BackendImplV3::CreateEntry(const std::string& key, Entry** entry,
   if (!block_files_.CreateBlock(BLOCK_256, num_blocks, &entry_address)) {
     LOG(ERROR) << "Create entry failed " << key.c_str();
     stats_.OnEvent(Stats::CREATE_ERROR);
-    return NULL;
+    return net::ERR_FAILED;
   }
 
   Addr node_address(0);
@@ -522,7 +537,7 @@ int BackendImplV3::CreateEntry(const std::string& key, Entry** entry,
     block_files_.DeleteBlock(entry_address, false);
     LOG(ERROR) << "Create entry failed " << key.c_str();
     stats_.OnEvent(Stats::CREATE_ERROR);
-    return NULL;
+    return net::ERR_FAILED;
   }
 
   scoped_refptr<EntryImpl> cache_entry(
@@ -534,7 +549,7 @@ int BackendImplV3::CreateEntry(const std::string& key, Entry** entry,
     block_files_.DeleteBlock(node_address, false);
     LOG(ERROR) << "Create entry failed " << key.c_str();
     stats_.OnEvent(Stats::CREATE_ERROR);
-    return NULL;
+    return net::ERR_FAILED;
   }
 
   cache_entry->BeginLogging(net_log_, true);
@@ -564,7 +579,8 @@ int BackendImplV3::CreateEntry(const std::string& key, Entry** entry,
   Trace("create entry hit ");
   FlushIndex();
   cache_entry->AddRef();
-  return cache_entry.get();
+  *entry = cache_entry.get();
+  return net::OK;
 }
 
 int BackendImplV3::DoomEntry(const std::string& key,
@@ -1469,12 +1485,20 @@ bool BackendImplV3::IsAllocAllowed(int current_size, int new_size) {
   return false;
 }
 
+int BackendImplV3::FlushQueueForTest(const CompletionCallback& callback) {
+  cache_thread_->PostTaskAndReply(FROM_HERE, base::Bind(&base::DoNothing),
+                                  base::Bind(callback, net::OK));
+  return net::ERR_IO_PENDING;
+}
+
 net::CacheType BackendImplV3::GetCacheType() const {
   return cache_type_;
 }
 
 int32 BackendImplV3::GetEntryCount() const {
-  return 0;
+  if (!init_)
+    return 0;
+  return index_.header()->num_entries;
 }
 
 int BackendImplV3::OpenEntry(const std::string& key, Entry** entry,
@@ -1528,7 +1552,98 @@ void BackendImplV3::OnExternalCacheHit(const std::string& key) {
   NOTIMPLEMENTED();
 }
 
+void BackendImplV3::GrowIndex() {
+  if (growing_index_ || !init_)
+    return;
+
+  // The tables have some room left, so the index keeps working until the
+  // worker is done.
+  growing_index_ = true;
+  InitResult* result = new InitResult;
+  base::PostTaskAndReplyWithResult(
+      cache_thread_.get(), FROM_HERE,
+      base::Bind(&Worker::GrowIndex, worker_, index_.header()->table_len,
+                 result),
+      base::Bind(&BackendImplV3::OnGrowIndexComplete, GetWeakPtr(),
+                 base::Owned(result)));
+}
+
+void BackendImplV3::SaveIndex(net::IOBuffer* buffer, int buffer_len) {
+  cache_thread_->PostTask(
+      FROM_HERE, base::Bind(&Worker::SaveIndex, worker_,
+                            scoped_refptr<net::IOBuffer>(buffer), buffer_len));
+}
+
+void BackendImplV3::DeleteCell(EntryCell cell) {
+  // The entry was being deleted when the cache went down.
+  index_.SetSate(cell.hash(), cell.GetAddress(), ENTRY_FREE);
+}
+
+void BackendImplV3::FixCell(EntryCell cell) {
+  // There is no entry layer yet to verify the record of the entry, so the
+  // entry is discarded, as the v2 backend does with dirty entries.
+  index_.SetSate(cell.hash(), cell.GetAddress(), ENTRY_FREE);
+}
+
 void BackendImplV3::CleanupCache() {
+  timer_.reset();
+  if (init_ && !(user_flags_ & NO_CLEAN_ON_EXIT)) {
+    index_.header()->crash = 0;
+    index_.OnBackupTimer();
+  }
+  index_.Shutdown();
+  index_file_ = NULL;
+  main_table_file_ = NULL;
+  extra_table_file_ = NULL;
+  ptr_factory_.InvalidateWeakPtrs();
+}
+
+void BackendImplV3::OnInitComplete(const CompletionCallback& callback,
+                                   InitResult* result,
+                                   int rv) {
+  if (rv == net::OK) {
+    IndexHeaderV3* header = &result->index_data.index_bitmap->header;
+    if (header->crash) {
+      // The cells modified after the last backup are verified as they are
+      // found by the index.
+      LOG(WARNING) << "The cache was not closed properly";
+    }
+    header->crash = 1;
+
+    index_file_.swap(result->index_file);
+    main_table_file_.swap(result->main_table_file);
+    extra_table_file_.swap(result->extra_table_file);
+    index_.Init(&result->index_data);
+    init_ = true;
+
+    int timer_delay = (user_flags_ & UNIT_TEST_MODE) ? 1000 : 30000;
+    timer_.reset(new base::RepeatingTimer<BackendImplV3>());
+    timer_->Start(FROM_HERE, TimeDelta::FromMilliseconds(timer_delay), this,
+                  &BackendImplV3::OnBackupTimer);
+  }
+  callback.Run(rv);
+}
+
+void BackendImplV3::OnGrowIndexComplete(InitResult* result, int rv) {
+  if (rv != net::OK) {
+    // Don't try again: the index keeps working with the current tables.
+    LOG(ERROR) << "Unable to grow the index";
+    return;
+  }
+
+  result->index_data.index_bitmap->header.table_len *= 2;
+  index_.Init(&result->index_data);
+
+  // The old mappings go away with |result|, now that the index is not using
+  // them anymore.
+  index_file_.swap(result->index_file);
+  main_table_file_.swap(result->main_table_file);
+  extra_table_file_.swap(result->extra_table_file);
+  growing_index_ = false;
+}
+
+void BackendImplV3::OnBackupTimer() {
+  index_.OnBackupTimer();
 }
 
 }  // namespace disk_cache
@@ -31,10 +31,13 @@ class NetLog;
 namespace disk_cache {
 
 class EntryImplV3;
+class MappedFile;
+struct InitResult;
 
 // This class implements the Backend interface. An object of this
 // class handles the operations of the cache for a particular profile.
-class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
+class NET_EXPORT_PRIVATE BackendImplV3 : public Backend,
+                                         public IndexTableBackend {
  public:
   enum BackendFlags {
     MAX_SIZE = 1 << 1,            // A maximum size was provided.
@@ -159,6 +162,9 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
   // Sends a dummy operation through the operation queue, for unit tests.
   int FlushQueueForTest(const CompletionCallback& callback);
 
+  // Returns the index of the cache, for tests.
+  IndexTable* GetIndexForTest() { return &index_; }
+
   // Trims an entry (all if |empty| is true) from the list of deleted
   // entries. This method should be called directly on the cache thread.
   void TrimForTest(bool empty);
@@ -192,6 +198,12 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
   void GetStats(StatsItems* stats) override;
   void OnExternalCacheHit(const std::string& key) override;
 
+  // IndexTableBackend implementation.
+  void GrowIndex() override;
+  void SaveIndex(net::IOBuffer* buffer, int buffer_len) override;
+  void DeleteCell(EntryCell cell) override;
+  void FixCell(EntryCell cell) override;
+
  private:
   friend class EvictionV3;
   typedef base::hash_map<CacheAddr, EntryImplV3*> EntriesMap;
@@ -210,6 +222,14 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
   // Performs final cleanup.
   void CleanupCache();
 
+  // Completes the work of the worker, for Init() and GrowIndex().
+  void OnInitComplete(const CompletionCallback& callback, InitResult* result,
+                      int rv);
+  void OnGrowIndexComplete(InitResult* result, int rv);
+
+  // Timer callback to save the backup of the index.
+  void OnBackupTimer();
+
   // Creates a new entry object. Returns zero on success, or a disk_cache error
   // on failure.
   int NewEntry(Addr address, EntryImplV3** entry);
@@ -246,6 +266,11 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
   int MaxBuffersSize();
 
   IndexTable index_;
+  // The memory mapped files that back |index_|.
+  scoped_refptr<MappedFile> index_file_;
+  scoped_refptr<MappedFile> main_table_file_;
+  scoped_refptr<MappedFile> extra_table_file_;
+  bool growing_index_;  // The worker is growing the index files.
   base::FilePath path_;  // Path to the folder used as backing storage.
   BlockBitmaps block_files_;
   int32 max_size_;  // Maximum data size for this instance.
@@ -270,6 +295,8 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
 
   net::NetLog* net_log_;
 
+  scoped_refptr<base::SingleThreadTaskRunner> cache_thread_;
+  scoped_refptr<Worker> worker_;  // Performs the file IO, on |cache_thread_|.
   Stats stats_;  // Usage statistics.
   scoped_ptr<base::RepeatingTimer<BackendImplV3> > timer_;  // Usage timer.
   scoped_refptr<TraceObject> trace_object_;  // Initializes internal tracing.
@@ -0,0 +1,196 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/basictypes.h"
+#include "base/files/file_util.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/threading/thread.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/blockfile/addr.h"
+#include "net/disk_cache/blockfile/backend_impl_v3.h"
+#include "net/disk_cache/blockfile/disk_format_v3.h"
+#include "net/disk_cache/blockfile/index_table_v3.h"
+#include "net/disk_cache/disk_cache_test_base.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+class BackendImplV3Test : public DiskCacheTest {
+ protected:
+  BackendImplV3Test() : cache_thread_("CacheThread") {}
+
+  void SetUp() override {
+    DiskCacheTest::SetUp();
+    ASSERT_TRUE(cache_thread_.StartWithOptions(
+        base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+    ASSERT_TRUE(CleanupCacheDir());
+  }
+
+  // Opens the cache at |cache_path_|, with room for |max_size| bytes.
+  void InitCache(int max_size, uint32 flags) {
+    cache_.reset(new BackendImplV3(cache_path_,
+                                   cache_thread_.task_runner(), NULL));
+    cache_->SetFlags(flags | BackendImplV3::UNIT_TEST_MODE);
+    ASSERT_TRUE(cache_->SetMaxSize(max_size));
+    net::TestCompletionCallback cb;
+    ASSERT_EQ(net::OK, cb.GetResult(cache_->Init(cb.callback())));
+  }
+
+  // Waits for the work posted to the cache thread.
+  void FlushQueue() {
+    net::TestCompletionCallback cb;
+    EXPECT_EQ(net::OK, cb.GetResult(cache_->FlushQueueForTest(cb.callback())));
+  }
+
+  IndexTable* index() { return cache_->GetIndexForTest(); }
+
+  // Adds |count| cells to the index, starting with |first_id|, and marks them
+  // as used.
+  void AddCells(int first_id, int count) {
+    for (int i = first_id; i < first_id + count; i++) {
+      SCOPED_TRACE(i);
+      EntryCell cell = index()->CreateEntryCell(GetHash(i), GetAddress(i));
+      ASSERT_TRUE(cell.IsValid());
+      index()->SetSate(GetHash(i), GetAddress(i), ENTRY_USED);
+    }
+  }
+
+  // Returns the state of the cell for |id|, or ENTRY_FREE if it's not there.
+  EntryState GetCellState(int id) {
+    // The lookup verifies the state of the cell.
+    index()->LookupEntries(GetHash(id));
+    EntryCell cell = index()->FindEntryCell(GetHash(id), GetAddress(id));
+    return cell.IsValid() ? cell.GetState() : ENTRY_FREE;
+  }
+
+  uint32 GetHash(int id) { return id * 0x9E3779B1 + 7; }
+
+  Addr GetAddress(int id) {
+    return Addr(BLOCK_ENTRIES, 1, 5 + id / 0xfff0, id % 0xfff0 + 1);
+  }
+
+  base::Thread cache_thread_;
+  scoped_ptr<BackendImplV3> cache_;
+};
+
+}  // namespace
+
+TEST_F(BackendImplV3Test, CreateAndReopen) {
+  InitCache(1024 * 1024, 0);
+  EXPECT_TRUE(base::PathExists(cache_path_.AppendASCII("index")));
+  EXPECT_TRUE(base::PathExists(cache_path_.AppendASCII("index_tb1")));
+  EXPECT_TRUE(base::PathExists(cache_path_.AppendASCII("index_tb2")));
+  EXPECT_EQ(0, cache_->GetEntryCount());
+  EXPECT_EQ(1536, index()->header()->table_len);
+  EXPECT_EQ(1, index()->header()->crash);
+
+  AddCells(0, 500);
+  cache_.reset();
+
+  // A different max size doesn't change the existing index.
+  InitCache(100 * 1024 * 1024, 0);
+  EXPECT_EQ(1536, index()->header()->table_len);
+  EXPECT_EQ(500, index()->header()->used_cells);
+  for (int i = 0; i < 500; i++)
+    EXPECT_EQ(ENTRY_USED, GetCellState(i));
+  EXPECT_EQ(ENTRY_FREE, GetCellState(500));
+}
+
+// The size of a new index follows the size of the cache.
+TEST_F(BackendImplV3Test, TableSize) {
+  InitCache(256 * 1024 * 1024, 0);
+  EXPECT_EQ(64 * 1024 * 3 / 2, index()->header()->table_len);
+  EXPECT_FALSE(index()->header()->flags & SMALL_CACHE);
+}
+
+TEST_F(BackendImplV3Test, InvalidIndex) {
+  ASSERT_TRUE(base::CreateDirectory(cache_path_));
+  const char kGarbage[] = "Not an index";
+  ASSERT_EQ(static_cast<int>(sizeof(kGarbage)),
+            base::WriteFile(cache_path_.AppendASCII("index"), kGarbage,
+                            sizeof(kGarbage)));
+
+  // The files are discarded and created again.
+  InitCache(1024 * 1024, 0);
+  EXPECT_EQ(kIndexMagicV3, index()->header()->magic);
+  EXPECT_EQ(1536, index()->header()->table_len);
+}
+
+// Tests that the files of a v2 cache are not discarded.
+TEST_F(BackendImplV3Test, V2Index) {
+  ASSERT_TRUE(base::CreateDirectory(cache_path_));
+  const base::FilePath name = cache_path_.AppendASCII("index");
+  const uint32 kV2Header[] = { kIndexMagicV3, 0x20001, 0, 0 };
+  ASSERT_EQ(static_cast<int>(sizeof(kV2Header)),
+            base::WriteFile(name, reinterpret_cast<const char*>(kV2Header),
+                            sizeof(kV2Header)));
+
+  cache_.reset(new BackendImplV3(cache_path_,
+                                 cache_thread_.task_runner(), NULL));
+  cache_->SetFlags(BackendImplV3::UNIT_TEST_MODE);
+  net::TestCompletionCallback cb;
+  EXPECT_EQ(net::ERR_FAILED, cb.GetResult(cache_->Init(cb.callback())));
+  cache_.reset();
+
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(name, &contents));
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(kV2Header),
+                        sizeof(kV2Header)),
+            contents);
+  EXPECT_FALSE(base::PathExists(cache_path_.AppendASCII("index_tb1")));
+}
+
+// Tests that the worker grows the index files when the tables fill up.
+TEST_F(BackendImplV3Test, GrowIndex) {
+  InitCache(1024 * 1024, 0);
+
+  const int kNumCells = 4000;
+  for (int i = 0; i < kNumCells; i += 100) {
+    AddCells(i, 100);
+    FlushQueue();
+  }
+  EXPECT_LT(1536, index()->header()->table_len);
+  EXPECT_EQ(kNumCells, index()->header()->used_cells);
+  for (int i = 0; i < kNumCells; i++)
+    EXPECT_EQ(ENTRY_USED, GetCellState(i));
+
+  int table_len = index()->header()->table_len;
+  cache_.reset();
+
+  InitCache(1024 * 1024, 0);
+  EXPECT_EQ(table_len, index()->header()->table_len);
+  for (int i = 0; i < kNumCells; i++)
+    EXPECT_EQ(ENTRY_USED, GetCellState(i));
+}
+
+// Tests that the cells modified after the last backup are discarded after a
+// crash, as there is no entry record to verify them against.
+TEST_F(BackendImplV3Test, CrashRecovery) {
+  InitCache(1024 * 1024, 0);
+  AddCells(0, 100);
+  cache_.reset();
+
+  InitCache(1024 * 1024, BackendImplV3::NO_CLEAN_ON_EXIT);
+  AddCells(100, 100);
+  cache_.reset();
+
+  InitCache(1024 * 1024, 0);
+  EXPECT_EQ(200, index()->header()->used_cells);
+  for (int i = 0; i < 100; i++)
+    EXPECT_EQ(ENTRY_USED, GetCellState(i));
+  for (int i = 100; i < 200; i++)
+    EXPECT_EQ(ENTRY_FREE, GetCellState(i));
+  EXPECT_EQ(100, index()->header()->used_cells);
+
+  // The cells that are left are saved on the next backup.
+  cache_.reset();
+  InitCache(1024 * 1024, 0);
+  EXPECT_EQ(100, index()->header()->used_cells);
+}
+
+}  // namespace disk_cache
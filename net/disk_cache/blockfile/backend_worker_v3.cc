@@ -4,8 +4,11 @@
 
 #include "net/disk_cache/blockfile/backend_worker_v3.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/bind_helpers.h"
+#include "base/files/file.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/message_loop/message_loop.h"
@@ -13,10 +16,13 @@
 #include "base/strings/stringprintf.h"
 #include "base/time/time.h"
 #include "base/timer/timer.h"
+#include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
+#include "net/disk_cache/blockfile/disk_format_v3.h"
 #include "net/disk_cache/blockfile/errors.h"
 #include "net/disk_cache/blockfile/experiments.h"
 #include "net/disk_cache/blockfile/file.h"
+#include "net/disk_cache/cache_util.h"
 
 using base::Time;
 using base::TimeDelta;
@@ -24,41 +30,113 @@ using base::TimeTicks;
 
 namespace {
 
-#if defined(V3_NOT_JUST_YET_READY)
-
-const char* kIndexName = "index";
+const char kIndexName[] = "index";
+const char kMainTableName[] = "index_tb1";
+const char kExtraTableName[] = "index_tb2";
+const char kBackupName[] = "index_bak";
 
-// Seems like ~240 MB correspond to less than 50k entries for 99% of the people.
-// Note that the actual target is to keep the index table load factor under 55%
-// for most users.
-const int k64kEntriesStore = 240 * 1000 * 1000;
-const int kBaseTableLen = 64 * 1024;
+// A new index gets one cell of the main table per 4 KB of storage, and the
+// tables grow when they fill up. The largest main table has 2M cells.
+const int kStoragePerCell = 4 * 1024;
+const int kMaxMainTableLen = disk_cache::kBaseTableLen << 11;
 const int kDefaultCacheSize = 80 * 1024 * 1024;
 
-// Avoid trimming the cache for the first 5 minutes (10 timer ticks).
-const int kTrimDelay = 10;
+// The extra table is half the size of the main table, so the index stores
+// table_len = main_len * 3 / 2 cells.
+int MainTableLen(int table_len) {
+  return table_len / 3 * 2;
+}
+
+int DesiredIndexTableLen(int max_size) {
+  if (!max_size)
+    max_size = kDefaultCacheSize;
+  int main_len = disk_cache::kBaseTableLen;
+  while (main_len < max_size / kStoragePerCell && main_len < kMaxMainTableLen)
+    main_len *= 2;
+  return main_len + main_len / 2;
+}
 
-int DesiredIndexTableLen(int32 storage_size) {
-  if (storage_size <= k64kEntriesStore)
-    return kBaseTableLen;
-  if (storage_size <= k64kEntriesStore * 2)
-    return kBaseTableLen * 2;
-  if (storage_size <= k64kEntriesStore * 4)
-    return kBaseTableLen * 4;
-  if (storage_size <= k64kEntriesStore * 8)
-    return kBaseTableLen * 8;
+// Returns whether |name| is the index of a v2 cache. Both indexes have the
+// same name and magic number, but a different major version.
+bool IsV2Index(const base::FilePath& name) {
+  base::File file(name, base::File::FLAG_OPEN | base::File::FLAG_READ);
+  if (!file.IsValid())
+    return false;
 
-  // The biggest storage_size for int32 requires a 4 MB table.
-  return kBaseTableLen * 16;
+  uint32 header[2];
+  if (file.Read(0, reinterpret_cast<char*>(header), sizeof(header)) !=
+      static_cast<int>(sizeof(header))) {
+    return false;
+  }
+  return header[0] == disk_cache::kIndexMagicV3 && header[1] >> 16 == 2;
 }
 
-int MaxStorageSizeForTable(int table_len) {
-  return table_len * (k64kEntriesStore / kBaseTableLen);
+bool IsValidTableLen(int table_len) {
+  const int kMinTableLen =
+      disk_cache::kBaseTableLen + disk_cache::kBaseTableLen / 2;
+  if (table_len < kMinTableLen || table_len % kMinTableLen)
+    return false;
+  int multiple = table_len / kMinTableLen;
+  return !(multiple & (multiple - 1)) &&
+         MainTableLen(table_len) <= kMaxMainTableLen;
 }
 
+// The index file holds the header and a bitmap with a bit per cell, and grows
+// in page increments.
 size_t GetIndexSize(int table_len) {
-  size_t table_size = sizeof(disk_cache::CacheAddr) * table_len;
-  return sizeof(disk_cache::IndexHeader) + table_size;
+  const size_t kPageSize = 4096;
+  size_t size = sizeof(disk_cache::IndexHeaderV3) +
+                (table_len + 31) / 32 * sizeof(uint32);
+  size = (size + kPageSize - 1) / kPageSize * kPageSize;
+  return std::max(size, sizeof(disk_cache::IndexBitmap));
+}
+
+size_t GetMainTableSize(int table_len) {
+  return MainTableLen(table_len) / disk_cache::kCellsPerBucket *
+         sizeof(disk_cache::IndexBucket);
+}
+
+size_t GetExtraTableSize(int table_len) {
+  return (table_len - MainTableLen(table_len)) / disk_cache::kCellsPerBucket *
+         sizeof(disk_cache::IndexBucket);
+}
+
+// Creates |name| with |size| bytes, starting with |header_len| bytes of
+// |header|.
+bool CreateIndexFile(const base::FilePath& name, const void* header,
+                     int header_len, size_t size) {
+  base::File file(name, base::File::FLAG_CREATE_ALWAYS |
+                        base::File::FLAG_WRITE);
+  if (!file.IsValid())
+    return false;
+  if (header_len &&
+      file.Write(0, static_cast<const char*>(header), header_len) !=
+          header_len) {
+    return false;
+  }
+  return file.SetLength(size);
+}
+
+// Extends |name| to |size| bytes. The new part of the file reads as zeros.
+bool ExtendIndexFile(const base::FilePath& name, size_t size) {
+  base::File file(name, base::File::FLAG_OPEN | base::File::FLAG_WRITE);
+  if (!file.IsValid())
+    return false;
+  if (file.GetLength() >= static_cast<int64>(size))
+    return true;
+  return file.SetLength(size);
+}
+
+#if defined(V3_NOT_JUST_YET_READY)
+
+// Seems like ~240 MB correspond to less than 50k entries for 99% of the people.
+const int k64kEntriesStore = 240 * 1000 * 1000;
+
+// Avoid trimming the cache for the first 5 minutes (10 timer ticks).
+const int kTrimDelay = 10;
+
+int MaxStorageSizeForTable(int table_len) {
+  return table_len * (k64kEntriesStore / kBaseTableLen);
 }
 
 // ------------------------------------------------------------------------
@@ -457,11 +535,206 @@ bool BackendImpl::InitStats() {
 
 #endif  // defined(V3_NOT_JUST_YET_READY).
 
-int BackendImplV3::Worker::Init(const CompletionCallback& callback) {
-  return net::ERR_FAILED;
+InitResult::InitResult() {
+}
+
+InitResult::~InitResult() {
+}
+
+int BackendImplV3::Worker::Init(int max_size, InitResult* result) {
+  DCHECK(!init_);
+  if (init_ || !base::CreateDirectory(path_))
+    return net::ERR_FAILED;
+
+  bool created = false;
+  if (!base::PathExists(path_.AppendASCII(kIndexName))) {
+    if (!CreateBackingStore(DesiredIndexTableLen(max_size)))
+      return net::ERR_FAILED;
+    created = true;
+  } else if (IsV2Index(path_.AppendASCII(kIndexName))) {
+    // The entries of a v2 cache cannot be migrated, so its files are left
+    // alone for the v2 backend.
+    LOG(ERROR) << "The directory holds a v2 cache";
+    return net::ERR_FAILED;
+  }
+
+  if (!InitBackingStore(result)) {
+    if (created)
+      return net::ERR_FAILED;
+
+    // Start again with a new set of files.
+    LOG(ERROR) << "Discarding the index files";
+    result->index_data.index_bitmap = NULL;
+    result->index_file = NULL;
+    result->main_table_file = NULL;
+    result->extra_table_file = NULL;
+    DeleteCache(path_, false);
+    if (!CreateBackingStore(DesiredIndexTableLen(max_size)) ||
+        !InitBackingStore(result)) {
+      return net::ERR_FAILED;
+    }
+  }
+
+  LoadBackup(result);
+  init_ = true;
+  return net::OK;
+}
+
+int BackendImplV3::Worker::GrowIndex(int table_len, InitResult* result) {
+  DCHECK(init_);
+  int new_len = table_len * 2;
+  if (!IsValidTableLen(new_len))
+    return net::ERR_FAILED;
+
+  if (!ExtendIndexFile(path_.AppendASCII(kIndexName), GetIndexSize(new_len)) ||
+      !ExtendIndexFile(path_.AppendASCII(kMainTableName),
+                       GetMainTableSize(new_len)) ||
+      !ExtendIndexFile(path_.AppendASCII(kExtraTableName),
+                       GetExtraTableSize(new_len))) {
+    return net::ERR_FAILED;
+  }
+
+  // The new mappings share their pages with the ones in use by the backend,
+  // which keeps working with the old ones until it sees the new tables.
+  result->index_file = new MappedFile();
+  result->index_data.index_bitmap = static_cast<IndexBitmap*>(
+      result->index_file->Init(path_.AppendASCII(kIndexName), 0));
+  if (!result->index_data.index_bitmap)
+    return net::ERR_FAILED;
+
+  return MapIndexFiles(new_len, result) ? net::OK : net::ERR_FAILED;
+}
+
+void BackendImplV3::Worker::SaveIndex(
+    const scoped_refptr<net::IOBuffer>& buffer,
+    int buffer_len) {
+  DCHECK(init_);
+  if (!CreateIndexFile(path_.AppendASCII(kBackupName), buffer->data(),
+                       buffer_len, buffer_len)) {
+    LOG(ERROR) << "Unable to save the index backup";
+  }
 }
 
 BackendImplV3::Worker::~Worker() {
 }
 
+bool BackendImplV3::Worker::CreateBackingStore(int table_len) {
+  IndexHeaderV3 header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kIndexMagicV3;
+  header.version = kVersion3;
+  header.table_len = table_len;
+  header.max_bucket = MainTableLen(table_len) / kCellsPerBucket - 1;
+  if (MainTableLen(table_len) < 64 * 1024)
+    header.flags = SMALL_CACHE;
+  header.create_time = Time::Now().ToInternalValue();
+  header.base_time = header.create_time;
+
+  // Any backup left behind belongs to a previous set of files.
+  base::DeleteFile(path_.AppendASCII(kBackupName), false);
+
+  return CreateIndexFile(path_.AppendASCII(kMainTableName), NULL, 0,
+                         GetMainTableSize(table_len)) &&
+         CreateIndexFile(path_.AppendASCII(kExtraTableName), NULL, 0,
+                         GetExtraTableSize(table_len)) &&
+         CreateIndexFile(path_.AppendASCII(kIndexName), &header,
+                         sizeof(header), GetIndexSize(table_len));
+}
+
+bool BackendImplV3::Worker::InitBackingStore(InitResult* result) {
+  result->index_file = new MappedFile();
+  result->index_data.index_bitmap = static_cast<IndexBitmap*>(
+      result->index_file->Init(path_.AppendASCII(kIndexName), 0));
+  if (!result->index_data.index_bitmap) {
+    LOG(ERROR) << "Unable to map Index file";
+    return false;
+  }
+
+  if (!CheckIndex(*result))
+    return false;
+
+  return MapIndexFiles(result->index_data.index_bitmap->header.table_len,
+                       result);
+}
+
+bool BackendImplV3::Worker::MapIndexFiles(int table_len, InitResult* result) {
+  result->main_table_file = new MappedFile();
+  result->index_data.main_table = static_cast<IndexBucket*>(
+      result->main_table_file->Init(path_.AppendASCII(kMainTableName),
+                                    GetMainTableSize(table_len)));
+
+  result->extra_table_file = new MappedFile();
+  result->index_data.extra_table = static_cast<IndexBucket*>(
+      result->extra_table_file->Init(path_.AppendASCII(kExtraTableName),
+                                     GetExtraTableSize(table_len)));
+
+  if (!result->index_data.main_table || !result->index_data.extra_table) {
+    LOG(ERROR) << "Unable to map the index tables";
+    return false;
+  }
+  return true;
+}
+
+bool BackendImplV3::Worker::CheckIndex(const InitResult& result) {
+  if (result.index_file->GetLength() < sizeof(IndexBitmap)) {
+    LOG(ERROR) << "Corrupt Index file";
+    return false;
+  }
+
+  const IndexHeaderV3& header = result.index_data.index_bitmap->header;
+  if (header.magic != kIndexMagicV3 || header.version != kVersion3) {
+    LOG(ERROR) << "Invalid file version or magic";
+    return false;
+  }
+
+  if (!IsValidTableLen(header.table_len)) {
+    LOG(ERROR) << "Invalid table size";
+    return false;
+  }
+
+  int main_buckets = MainTableLen(header.table_len) / kCellsPerBucket;
+  if (result.index_file->GetLength() < GetIndexSize(header.table_len) ||
+      header.max_bucket < main_buckets - 1 ||
+      header.max_bucket >= header.table_len / kCellsPerBucket ||
+      (main_buckets * kCellsPerBucket < 64 * 1024) !=
+          ((header.flags & SMALL_CACHE) != 0)) {
+    LOG(ERROR) << "Corrupt Index file";
+    return false;
+  }
+
+  if (header.num_entries < 0 || header.used_cells < 0) {
+    LOG(ERROR) << "Invalid number of entries";
+    return false;
+  }
+  return true;
+}
+
+void BackendImplV3::Worker::LoadBackup(InitResult* result) {
+  const IndexBitmap* index = result->index_data.index_bitmap;
+  int num_words = (index->header.table_len + 31) / 32;
+  int bitmap_len = num_words * static_cast<int>(sizeof(uint32));
+  int header_len = static_cast<int>(sizeof(IndexHeaderV3));
+  result->index_data.backup_header.reset(new IndexHeaderV3);
+  result->index_data.backup_bitmap.reset(new uint32[num_words]);
+  IndexHeaderV3* backup_header = result->index_data.backup_header.get();
+  char* backup_bitmap =
+      reinterpret_cast<char*>(result->index_data.backup_bitmap.get());
+
+  base::File file(path_.AppendASCII(kBackupName),
+                  base::File::FLAG_OPEN | base::File::FLAG_READ);
+  if (file.IsValid() && file.GetLength() == header_len + bitmap_len &&
+      file.Read(0, reinterpret_cast<char*>(backup_header), header_len) ==
+          header_len &&
+      file.Read(header_len, backup_bitmap, bitmap_len) == bitmap_len &&
+      backup_header->magic == kIndexMagicV3 &&
+      backup_header->version == kVersion3 &&
+      backup_header->table_len == index->header.table_len) {
+    return;
+  }
+
+  // Without a valid backup, the index is assumed to be up to date.
+  memcpy(backup_header, &index->header, header_len);
+  memcpy(backup_bitmap, index->bitmap, bitmap_len);
+}
+
 }  // namespace disk_cache
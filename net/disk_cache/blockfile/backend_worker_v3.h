@@ -13,36 +13,71 @@
 #include "net/disk_cache/blockfile/addr.h"
 #include "net/disk_cache/blockfile/backend_impl_v3.h"
 #include "net/disk_cache/blockfile/block_files.h"
+#include "net/disk_cache/blockfile/index_table_v3.h"
+#include "net/disk_cache/blockfile/mapped_file.h"
 
 namespace base {
 class SingleThreadTaskRunner;
 }  // namespace base
 
+namespace net {
+class IOBuffer;
+}  // namespace net
+
 namespace disk_cache {
 
+// The index files opened (or grown) by the worker, handed to the backend. The
+// mapped files keep the tables referenced by |index_data| alive.
+struct InitResult {
+  InitResult();
+  ~InitResult();
+
+  IndexTableInitData index_data;
+  scoped_refptr<MappedFile> index_file;
+  scoped_refptr<MappedFile> main_table_file;
+  scoped_refptr<MappedFile> extra_table_file;
+};
+
+// Performs the file IO of the backend, on the cache thread.
 class BackendImplV3::Worker : public base::RefCountedThreadSafe<Worker> {
  public:
   Worker(const base::FilePath& path,
          const scoped_refptr<base::SingleThreadTaskRunner>& main_thread);
 
-  // Performs general initialization for this current instance of the cache.
-  int Init(const CompletionCallback& callback);
+  // Performs general initialization for this current instance of the cache:
+  // opens the index files, creating them with a table sized for |max_size|
+  // bytes if needed, and returns in |result| what the IndexTable needs.
+  int Init(int max_size, InitResult* result);
+
+  // Doubles the size of the index files, which currently store |table_len|
+  // cells, and maps them again on |result|. The tables are not initialized.
+  int GrowIndex(int table_len, InitResult* result);
+
+  // Writes the backup of the index: a copy of the header followed by the
+  // backup bitmap.
+  void SaveIndex(const scoped_refptr<net::IOBuffer>& buffer, int buffer_len);
 
  private:
   friend class base::RefCountedThreadSafe<Worker>;
 
   ~Worker();
-  void CleanupCache();
 
   // Returns the full name for an external storage file.
   base::FilePath GetFileName(Addr address) const;
 
-  // Creates a new backing file for the cache index.
-  bool CreateBackingStore(disk_cache::File* file);
-  bool InitBackingStore(bool* file_created);
+  // Creates a new set of index files, for |table_len| cells.
+  bool CreateBackingStore(int table_len);
+  bool InitBackingStore(InitResult* result);
+
+  // Maps the index files on |result|, for |table_len| cells.
+  bool MapIndexFiles(int table_len, InitResult* result);
+
+  // Performs basic checks on the index files. Returns false on failure.
+  bool CheckIndex(const InitResult& result);
 
-  // Performs basic checks on the index file. Returns false on failure.
-  bool CheckIndex();
+  // Reads the backup of the index, or makes one from the current index if
+  // there is no valid backup.
+  void LoadBackup(InitResult* result);
 
   base::FilePath path_;  // Path to the folder used as backing storage.
   BlockFiles block_files_;  // Set of files used to store all data.
@@ -2,15 +2,22 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+#include <cmath>
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/bind.h"
 #include "base/bind_helpers.h"
+#include "base/files/file.h"
 #include "base/hash.h"
+#include "base/rand_util.h"
 #include "base/strings/string_util.h"
+#include "base/test/perf_log.h"
 #include "base/test/perf_time_logger.h"
 #include "base/test/test_file_util.h"
+#include "base/thread_task_runner_handle.h"
 #include "base/threading/thread.h"
 #include "net/base/cache_type.h"
 #include "net/base/io_buffer.h"
@@ -18,9 +25,15 @@
 #include "net/base/test_completion_callback.h"
 #include "net/disk_cache/blockfile/backend_impl.h"
 #include "net/disk_cache/blockfile/block_files.h"
+#include "net/disk_cache/blockfile/disk_format.h"
+#include "net/disk_cache/blockfile/entry_impl.h"
+#include "net/disk_cache/blockfile/mapped_file.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/simple/simple_eviction_policy.h"
+#include "net/disk_cache/simple/simple_index.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
@@ -143,6 +156,132 @@ int BlockSize() {
   return (rand() & 0x3) + 1;
 }
 
+// Returns the entry hashes of a trace of |length| accesses to |num_keys| keys,
+// where the keys are chosen following a Zipf distribution, and every tenth of
+// the trace ends with a scan of |scan_length| keys that are only accessed once.
+std::vector<uint64> MakeEvictionTrace(int length, int num_keys,
+                                      int scan_length) {
+  std::vector<double> cumulative(num_keys);
+  double sum = 0;
+  for (int i = 0; i < num_keys; ++i) {
+    sum += 1 / std::pow(i + 1.0, 0.9);
+    cumulative[i] = sum;
+  }
+
+  std::vector<uint64> trace;
+  uint64 next_scan_key = num_keys;
+  while (static_cast<int>(trace.size()) < length) {
+    for (int i = 0; i < length / 10 - scan_length; ++i) {
+      const double point = base::RandDouble() * sum;
+      const uint64 key = std::upper_bound(cumulative.begin(),
+                                          cumulative.end(), point) -
+                         cumulative.begin();
+      trace.push_back((key + 1) * GG_UINT64_C(0x9e3779b97f4a7c15));
+    }
+    for (int i = 0; i < scan_length; ++i)
+      trace.push_back(++next_scan_key * GG_UINT64_C(0x9e3779b97f4a7c15));
+  }
+  return trace;
+}
+
+// Replays |trace| on an index of at most |capacity| entries of one byte
+// evicted by |policy| the way SimpleIndex does it, and returns the hit rate.
+double ReplayEvictionTrace(const std::vector<uint64>& trace,
+                           size_t capacity,
+                           disk_cache::SimpleEvictionPolicy* policy) {
+  const size_t low_watermark = capacity - capacity / 20;
+  disk_cache::SimpleIndex::EntrySet entries;
+  base::Time now = base::Time::UnixEpoch();
+  std::vector<uint64> evicted;
+  int hits = 0;
+  for (size_t i = 0; i < trace.size(); ++i) {
+    // The index keeps last used times in seconds.
+    now += base::TimeDelta::FromSeconds(1);
+    const uint64 entry_hash = trace[i];
+    disk_cache::SimpleIndex::EntrySet::iterator it = entries.find(entry_hash);
+    if (it != entries.end()) {
+      ++hits;
+      it->second.SetLastUsedTime(now);
+      policy->OnUse(entry_hash);
+      continue;
+    }
+    entries[entry_hash] = disk_cache::EntryMetadata(now, 1);
+    policy->OnInsert(entry_hash);
+    if (entries.size() <= capacity)
+      continue;
+    evicted.clear();
+    policy->SelectEntriesToEvict(entries, entries.size() - low_watermark,
+                                 &evicted);
+    for (size_t j = 0; j < evicted.size(); ++j) {
+      entries.erase(evicted[j]);
+      policy->OnRemove(evicted[j]);
+    }
+  }
+  return 100.0 * hits / trace.size();
+}
+
+// Sets the crash flag of the v2 index on |path|, as if the cache had not been
+// closed properly.
+bool MarkIndexAsCrashed(const base::FilePath& path) {
+  base::File file(path.AppendASCII("index"),
+                  base::File::FLAG_OPEN | base::File::FLAG_WRITE);
+  int32 crash = 1;
+  int offset = static_cast<int>(offsetof(disk_cache::IndexHeader, crash));
+  return file.IsValid() &&
+         file.Write(offset, reinterpret_cast<char*>(&crash), sizeof(crash)) ==
+             sizeof(crash);
+}
+
+// Looks up hashes on the index of the v2 cache on |path|, the way
+// BackendImpl::MatchEntry walks it, but without building the entries. The v2
+// index doesn't keep the hashes, so the records of the entries of a bucket
+// are read to compare them. This is the v2 counterpart of
+// IndexTable::LookupEntries.
+class V2IndexReader {
+ public:
+  explicit V2IndexReader(const base::FilePath& path)
+      : path_(path), block_files_(path), data_(NULL), mask_(0) {}
+
+  bool Init() {
+    index_ = new disk_cache::MappedFile();
+    data_ = static_cast<disk_cache::Index*>(
+        index_->Init(path_.AppendASCII("index"), 0));
+    if (!data_ || !block_files_.Init(false))
+      return false;
+    mask_ = (data_->header.table_len ? data_->header.table_len
+                                     : disk_cache::kIndexTablesize) - 1;
+    return true;
+  }
+
+  // Returns the number of entries stored with |hash|.
+  int CountEntries(uint32 hash) {
+    int count = 0;
+    disk_cache::Addr address(data_->table[hash & mask_]);
+    while (address.is_initialized()) {
+      disk_cache::EntryStore store;
+      disk_cache::MappedFile* file = address.SanityCheckForEntryV2() ?
+          block_files_.GetFile(address) : NULL;
+      size_t offset = address.start_block() * address.BlockSize() +
+                      disk_cache::kBlockHeaderSize;
+      if (!file || !file->Read(&store, sizeof(store), offset))
+        break;
+      if (store.hash == hash)
+        count++;
+      address.set_value(store.next);
+    }
+    return count;
+  }
+
+ private:
+  base::FilePath path_;
+  scoped_refptr<disk_cache::MappedFile> index_;
+  disk_cache::BlockFiles block_files_;
+  disk_cache::Index* data_;
+  uint32 mask_;
+
+  DISALLOW_COPY_AND_ASSIGN(V2IndexReader);
+};
+
 }  // namespace
 
 TEST_F(DiskCacheTest, Hash) {
@@ -217,6 +356,150 @@ TEST_F(DiskCacheTest, CacheBackendPerformance) {
   base::MessageLoop::current()->RunUntilIdle();
 }
 
+// Compares the I/O engines of the simple cache by writing and reading back
+// the same entries with each of them.
+TEST_F(DiskCacheTest, SimpleCacheIOEnginePerformance) {
+  const struct {
+    disk_cache::SimpleBackendImpl::IOEngineType type;
+    const char* name;
+  } kEngines[] = {
+    { disk_cache::SimpleBackendImpl::IO_ENGINE_WORKER_POOL,
+      "Simple cache with worker pool" },
+    { disk_cache::SimpleBackendImpl::IO_ENGINE_BATCHED,
+      "Simple cache with batched I/O engine" },
+  };
+
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  for (size_t i = 0; i < arraysize(kEngines); ++i) {
+    disk_cache::SimpleBackendImpl::SetIOEngineForTesting(kEngines[i].type);
+    ASSERT_TRUE(CleanupCacheDir());
+    net::TestCompletionCallback cb;
+    scoped_ptr<disk_cache::Backend> cache;
+    int rv = disk_cache::CreateCacheBackend(net::DISK_CACHE,
+                                            net::CACHE_BACKEND_SIMPLE,
+                                            cache_path_,
+                                            0,
+                                            false,
+                                            cache_thread.task_runner(),
+                                            NULL,
+                                            &cache,
+                                            cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+    // Use the same entries for every engine.
+    srand(seed);
+    TestEntries entries;
+    int num_entries = 1000;
+
+    base::PerfTimeLogger timer(kEngines[i].name);
+    EXPECT_TRUE(TimeWrite(num_entries, cache.get(), &entries));
+    EXPECT_TRUE(TimeRead(num_entries, cache.get(), entries, false));
+    timer.Done();
+
+    cache.reset();
+    disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+    base::MessageLoop::current()->RunUntilIdle();
+  }
+  disk_cache::SimpleBackendImpl::SetIOEngineForTesting(
+      disk_cache::SimpleBackendImpl::IO_ENGINE_DEFAULT);
+}
+
+// Replays a synthetic trace, mixing a skewed distribution of hot keys with
+// scans, against the eviction policies of the simple cache, and reports their
+// hit rates and the time they take.
+TEST_F(DiskCacheTest, SimpleCacheEvictionPolicyPerformance) {
+  const struct {
+    disk_cache::SimpleEvictionPolicy::Type type;
+    const char* name;
+    const char* hit_rate_name;
+  } kPolicies[] = {
+    { disk_cache::SimpleEvictionPolicy::LRU, "LRU eviction",
+      "LRU eviction hit rate" },
+    { disk_cache::SimpleEvictionPolicy::TINY_LFU, "TinyLFU eviction",
+      "TinyLFU eviction hit rate" },
+  };
+
+  const std::vector<uint64> trace = MakeEvictionTrace(1000000, 100000, 20000);
+  for (size_t i = 0; i < arraysize(kPolicies); ++i) {
+    scoped_ptr<disk_cache::SimpleEvictionPolicy> policy =
+        disk_cache::SimpleEvictionPolicy::Create(kPolicies[i].type);
+    base::PerfTimeLogger timer(kPolicies[i].name);
+    const double hit_rate = ReplayEvictionTrace(trace, 10000, policy.get());
+    timer.Done();
+    base::LogPerfResult(kPolicies[i].hit_rate_name, hit_rate, "%");
+  }
+}
+
+// Measures the time to open a v2 cache, to look up keys that are not stored on
+// its index, and to open it after a crash and look up every key. This is the
+// baseline for BlockfileIndexV3Performance: the lookups go through the index
+// alone, and read the records of the entries only to compare their hashes.
+TEST_F(DiskCacheTest, BlockfileIndexPerformance) {
+  const int kNumEntries = 5000;
+  const int kNumLookups = 100000;
+  std::vector<std::string> keys;
+  for (int i = 0; i < kNumEntries; i++)
+    keys.push_back(GenerateKey(true));
+  std::vector<std::string> missing_keys;
+  for (int i = 0; i < kNumLookups; i++)
+    missing_keys.push_back(GenerateKey(true));
+
+  // The v2 backend runs on this thread, so that the entries are written out
+  // by the time it is gone.
+  ASSERT_TRUE(CleanupCacheDir());
+  {
+    disk_cache::BackendImpl cache(cache_path_,
+                                  base::ThreadTaskRunnerHandle::Get(), NULL);
+    cache.SetFlags(disk_cache::kNoRandom);
+    ASSERT_EQ(net::OK, cache.SyncInit());
+    for (int i = 0; i < kNumEntries; i++) {
+      disk_cache::EntryImpl* entry = cache.CreateEntryImpl(keys[i]);
+      ASSERT_TRUE(entry);
+      entry->Release();
+    }
+  }
+
+  {
+    ASSERT_TRUE(MarkIndexAsCrashed(cache_path_));
+    base::PerfTimeLogger timer("Open v2 index after a crash and look up keys");
+    disk_cache::BackendImpl cache(cache_path_,
+                                  base::ThreadTaskRunnerHandle::Get(), NULL);
+    cache.SetFlags(disk_cache::kNoRandom);
+    ASSERT_EQ(net::OK, cache.SyncInit());
+    V2IndexReader index(cache_path_);
+    ASSERT_TRUE(index.Init());
+    int found = 0;
+    for (int i = 0; i < kNumEntries; i++) {
+      if (index.CountEntries(base::Hash(keys[i])))
+        found++;
+    }
+    timer.Done();
+    EXPECT_EQ(kNumEntries, found);
+  }
+
+  ASSERT_TRUE(base::EvictFileFromSystemCache(
+                  cache_path_.AppendASCII("index")));
+  base::PerfTimeLogger timer("Open v2 index");
+  disk_cache::BackendImpl cache(cache_path_,
+                                base::ThreadTaskRunnerHandle::Get(), NULL);
+  cache.SetFlags(disk_cache::kNoRandom);
+  ASSERT_EQ(net::OK, cache.SyncInit());
+  timer.Done();
+
+  V2IndexReader index(cache_path_);
+  ASSERT_TRUE(index.Init());
+  int candidates = 0;
+  base::PerfTimeLogger timer2("Look up missing keys on v2 index");
+  for (int i = 0; i < kNumLookups; i++)
+    candidates += index.CountEntries(base::Hash(missing_keys[i]));
+  timer2.Done();
+  EXPECT_LT(candidates, kNumLookups / 100);
+}
+
 // Creating and deleting "entries" on a block-file is something quite frequent
 // (after all, almost everything is stored on block files). The operation is
 // almost free when the file is empty, but can be expensive if the file gets
@@ -0,0 +1,131 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// The v3 index lives on its own file because the formats of the v2 and v3
+// blockfile caches cannot be mixed on a single translation unit.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/hash.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/test/perf_time_logger.h"
+#include "base/test/test_file_util.h"
+#include "base/threading/thread.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/blockfile/addr.h"
+#include "net/disk_cache/blockfile/backend_impl_v3.h"
+#include "net/disk_cache/blockfile/index_table_v3.h"
+#include "net/disk_cache/disk_cache_test_base.h"
+#include "net/disk_cache/disk_cache_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Opens the v3 backend on |path|, with |flags|.
+scoped_ptr<disk_cache::BackendImplV3> OpenCache(const base::FilePath& path,
+                                                base::Thread* cache_thread,
+                                                uint32 flags) {
+  scoped_ptr<disk_cache::BackendImplV3> cache(
+      new disk_cache::BackendImplV3(path, cache_thread->task_runner(), NULL));
+  cache->SetFlags(flags);
+  net::TestCompletionCallback cb;
+  if (cb.GetResult(cache->Init(cb.callback())) != net::OK)
+    cache.reset();
+  return cache.Pass();
+}
+
+// Adds cells for keys [begin, end) to the index of |cache|. Only the index of
+// the v3 backend works for now, so a cell stands for an entry.
+void AddCells(const std::vector<std::string>& keys,
+              int begin,
+              int end,
+              disk_cache::BackendImplV3* cache) {
+  disk_cache::IndexTable* index = cache->GetIndexForTest();
+  for (int i = begin; i < end; i++) {
+    uint32 hash = base::Hash(keys[i]);
+    disk_cache::Addr address(disk_cache::BLOCK_ENTRIES, 1, 5, i + 1);
+    EXPECT_TRUE(index->CreateEntryCell(hash, address).IsValid());
+    index->SetSate(hash, address, disk_cache::ENTRY_USED);
+  }
+}
+
+}  // namespace
+
+// Measures the time to open the v3 index, to look up keys that are not
+// stored, and to open the index after a crash and look up every key. See
+// BlockfileIndexPerformance in disk_cache_perftest.cc for the same work on the
+// v2 index.
+TEST_F(DiskCacheTest, BlockfileIndexV3Performance) {
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+
+  const int kNumEntries = 5000;
+  const int kNumLookups = 100000;
+  std::vector<std::string> keys;
+  for (int i = 0; i < kNumEntries; i++)
+    keys.push_back(GenerateKey(true));
+  std::vector<std::string> missing_keys;
+  for (int i = 0; i < kNumLookups; i++)
+    missing_keys.push_back(GenerateKey(true));
+
+  // Half of the cells are added after the last backup of the index, and are
+  // discarded after the crash.
+  ASSERT_TRUE(CleanupCacheDir());
+  scoped_ptr<disk_cache::BackendImplV3> cache =
+      OpenCache(cache_path_, &cache_thread, 0);
+  ASSERT_TRUE(cache);
+  AddCells(keys, 0, kNumEntries / 2, cache.get());
+  cache.reset();
+
+  cache = OpenCache(cache_path_, &cache_thread,
+                    disk_cache::BackendImplV3::NO_CLEAN_ON_EXIT);
+  ASSERT_TRUE(cache);
+  AddCells(keys, kNumEntries / 2, kNumEntries, cache.get());
+  cache.reset();
+
+  {
+    base::PerfTimeLogger timer("Open v3 index after a crash and look up keys");
+    cache = OpenCache(cache_path_, &cache_thread, 0);
+    ASSERT_TRUE(cache);
+    disk_cache::IndexTable* index = cache->GetIndexForTest();
+    int found = 0;
+    for (int i = 0; i < kNumEntries; i++) {
+      if (!index->LookupEntries(base::Hash(keys[i])).cells.empty())
+        found++;
+    }
+    timer.Done();
+    EXPECT_LE(kNumEntries / 2, found);
+    cache.reset();
+  }
+
+  ASSERT_TRUE(base::EvictFileFromSystemCache(
+                  cache_path_.AppendASCII("index")));
+  ASSERT_TRUE(base::EvictFileFromSystemCache(
+                  cache_path_.AppendASCII("index_tb1")));
+  ASSERT_TRUE(base::EvictFileFromSystemCache(
+                  cache_path_.AppendASCII("index_tb2")));
+  base::PerfTimeLogger timer("Open v3 index");
+  cache = OpenCache(cache_path_, &cache_thread, 0);
+  ASSERT_TRUE(cache);
+  timer.Done();
+
+  // The cells keep only part of the hash, so a few lookups find candidates
+  // that the entries would have to discard.
+  disk_cache::IndexTable* index = cache->GetIndexForTest();
+  size_t candidates = 0;
+  base::PerfTimeLogger timer2("Look up missing keys on v3 index");
+  for (int i = 0; i < kNumLookups; i++) {
+    uint32 hash = base::Hash(missing_keys[i]);
+    candidates += index->LookupEntries(hash).cells.size();
+  }
+  timer2.Done();
+  EXPECT_LT(candidates, static_cast<size_t>(kNumLookups / 100));
+  cache.reset();
+  base::MessageLoop::current()->RunUntilIdle();
+}
@@ -297,6 +297,7 @@ bool Eviction::EvictEntry(CacheRankingsBlock* node, bool empty,
     entry->DoomImpl();
   } else {
     entry->DeleteEntryData(false);
+    backend_->OnEntryEvicted();
     EntryStore* info = entry->entry()->Data();
     DCHECK_EQ(ENTRY_NORMAL, info->state);
 
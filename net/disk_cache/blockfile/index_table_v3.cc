@@ -464,7 +464,8 @@ void IndexTable::Init(IndexTableInitData* params) {
       // This is doubling the size of main table.
       DCHECK_EQ(base::bits::Log2Floor(header_->table_len),
                 base::bits::Log2Floor(backup_header_->table_len) + 1);
-      int extra_size = (header()->max_bucket - mask_) * kCellsPerBucket;
+      // The number of buckets in use on the old extra table.
+      int extra_size = header()->max_bucket - mask_;
       DCHECK_GE(extra_size, 0);
 
       // Doubling the size implies deleting the extra table and moving as many
@@ -598,6 +599,9 @@ EntrySet IndexTable::LookupEntries(uint32 hash) {
       } else if (IsHashMatch(*current_cell, hash)) {
         EntryCell entry_cell(cell_num, hash, *current_cell, small_table_);
         CheckState(entry_cell);
+        // The backend may have dropped the cell.
+        if (!GetLocation(*current_cell))
+          continue;
         if (entry_cell.GetState() != ENTRY_DELETED) {
           entries.cells.push_back(entry_cell);
           if (entry_cell.GetGroup() == ENTRY_EVICTED)
@@ -689,7 +693,7 @@ void IndexTable::SetSate(uint32 hash, Addr address, EntryState state) {
   EntryState old_state = cell.GetState();
   switch (state) {
     case ENTRY_FREE:
-      DCHECK_EQ(old_state, ENTRY_DELETED);
+      DCHECK(old_state == ENTRY_DELETED || old_state == ENTRY_FIXING);
       break;
     case ENTRY_NEW:
       DCHECK_EQ(old_state, ENTRY_FREE);
@@ -717,6 +721,8 @@ void IndexTable::SetSate(uint32 hash, Addr address, EntryState state) {
     bitmap_->Set(cell.cell_num(), false);
     backup_bitmap_->Set(cell.cell_num(), false);
   } else if (state == ENTRY_FREE) {
+    bitmap_->Set(cell.cell_num(), false);
+    backup_bitmap_->Set(cell.cell_num(), false);
     cell.Clear();
     Write(cell);
     header()->used_cells--;
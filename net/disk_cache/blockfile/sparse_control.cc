@@ -4,6 +4,8 @@
 
 #include "net/disk_cache/blockfile/sparse_control.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/format_macros.h"
 #include "base/logging.h"
@@ -37,6 +39,10 @@ const int kMaxEntrySize = 0x100000;
 // The size of each data block (tracked by the child allocation bitmap).
 const int kBlockSize = 1024;
 
+// The maximum number of children remembered for GetAvailableRange(), which
+// covers 1 GB of sparse data.
+const size_t kMaxChildSummaries = 1024;
+
 // Returns the name of a child entry given the base_name and signature of the
 // parent and the child_id.
 // If the entry is called entry_name, child entries will be named something
@@ -48,6 +54,18 @@ std::string GenerateChildName(const std::string& base_name, int64 signature,
                             signature, child_id);
 }
 
+// Saves the allocation bitmap of |child|, before closing it.
+void SaveChildData(disk_cache::EntryImpl* child,
+                   disk_cache::SparseData* child_data) {
+  scoped_refptr<net::WrappedIOBuffer> buf(
+      new net::WrappedIOBuffer(reinterpret_cast<char*>(child_data)));
+
+  int rv = child->WriteData(kSparseIndex, 0, buf.get(), sizeof(*child_data),
+                            net::CompletionCallback(), false);
+  if (rv != sizeof(*child_data))
+    DLOG(ERROR) << "Failed to save child data";
+}
+
 // This class deletes the children of a sparse entry.
 class ChildrenDeleter
     : public base::RefCounted<ChildrenDeleter>,
@@ -198,7 +216,9 @@ SparseControl::SparseControl(EntryImpl* entry)
       buf_len_(0),
       child_offset_(0),
       child_len_(0),
-      result_(0) {
+      result_(0),
+      child_io_in_flight_(0),
+      max_child_io_(1) {
   memset(&sparse_header_, 0, sizeof(sparse_header_));
   memset(&child_data_, 0, sizeof(child_data_));
 }
@@ -275,6 +295,11 @@ int SparseControl::StartIO(SparseOperation op, int64 offset, net::IOBuffer* buf,
   finished_ = false;
   abort_ = false;
 
+  DCHECK(child_io_.empty());
+  max_child_io_ = 1;
+  if (entry_->backend_.get())
+    max_child_io_ = std::max(entry_->backend_->sparse_io_depth(), 1);
+
   if (entry_->net_log().IsLogging()) {
     entry_->net_log().BeginEvent(
         GetSparseEventType(operation_),
@@ -459,6 +484,18 @@ bool SparseControl::OpenChild() {
   if (!entry_->backend_.get())
     return false;
 
+  // There is no need to open the child if we already know what it stores, as
+  // long as no entry was removed since then. Otherwise the child may be gone,
+  // and what we know is refreshed (or dropped) below.
+  ChildSummaries::iterator it =
+      child_summaries_.find(static_cast<int>(offset_ >> 20));
+  if (it != child_summaries_.end()) {
+    if (it->second.removal_count != entry_->backend_->GetRemovalCount())
+      child_summaries_.erase(it);
+    else if (kGetRangeOperation == operation_)
+      return true;
+  }
+
   child_ = entry_->backend_->OpenEntryImpl(key);
   if (!child_)
     return ContinueWithoutChild(key);
@@ -489,18 +526,12 @@ bool SparseControl::OpenChild() {
     child_data_.header.last_block = -1;
   }
 
+  UpdateChildSummary(static_cast<int>(offset_ >> 20), child_data_, child_);
   return true;
 }
 
 void SparseControl::CloseChild() {
-  scoped_refptr<net::WrappedIOBuffer> buf(
-      new net::WrappedIOBuffer(reinterpret_cast<char*>(&child_data_)));
-
-  // Save the allocation bitmap before closing the child entry.
-  int rv = child_->WriteData(kSparseIndex, 0, buf.get(), sizeof(child_data_),
-                             CompletionCallback(), false);
-  if (rv != sizeof(child_data_))
-    DLOG(ERROR) << "Failed to save child data";
+  SaveChildData(child_, &child_data_);
   child_->Release();
   child_ = NULL;
 }
@@ -560,6 +591,8 @@ void SparseControl::SetChildBit(bool value) {
     children_map_.Resize(Bitmap::RequiredArraySize(child_bit + 1) * 32, true);
 
   children_map_.Set(child_bit, value);
+  if (!value)
+    child_summaries_.erase(child_bit);
 }
 
 void SparseControl::WriteSparseData() {
@@ -591,7 +624,8 @@ bool SparseControl::VerifyRange() {
     // Something is not here.
     DCHECK_GE(child_data_.header.last_block_len, 0);
     DCHECK_LT(child_data_.header.last_block_len, kMaxEntrySize);
-    int partial_block_len = PartialBlockLength(start);
+    int partial_block_len =
+        PartialBlockLength(start, child_->GetDataSize(kSparseData));
     if (start == child_offset_ >> 10) {
       // It looks like we don't have anything.
       if (partial_block_len <= (child_offset_ & (kBlockSize - 1)))
@@ -610,24 +644,25 @@ bool SparseControl::VerifyRange() {
   return true;
 }
 
-void SparseControl::UpdateRange(int result) {
+void SparseControl::UpdateRange(SparseData* child_data, int child_offset,
+                                int result) {
   if (result <= 0 || operation_ != kWriteOperation)
     return;
 
-  DCHECK_GE(child_data_.header.last_block_len, 0);
-  DCHECK_LT(child_data_.header.last_block_len, kMaxEntrySize);
+  DCHECK_GE(child_data->header.last_block_len, 0);
+  DCHECK_LT(child_data->header.last_block_len, kMaxEntrySize);
 
   // Write the bitmap.
-  int first_bit = child_offset_ >> 10;
-  int block_offset = child_offset_ & (kBlockSize - 1);
-  if (block_offset && (child_data_.header.last_block != first_bit ||
-                       child_data_.header.last_block_len < block_offset)) {
+  int first_bit = child_offset >> 10;
+  int block_offset = child_offset & (kBlockSize - 1);
+  if (block_offset && (child_data->header.last_block != first_bit ||
+                       child_data->header.last_block_len < block_offset)) {
     // The first block is not completely filled; ignore it.
     first_bit++;
   }
 
-  int last_bit = (child_offset_ + result) >> 10;
-  block_offset = (child_offset_ + result) & (kBlockSize - 1);
+  int last_bit = (child_offset + result) >> 10;
+  block_offset = (child_offset + result) & (kBlockSize - 1);
 
   // This condition will hit with the following criteria:
   // 1. The first byte doesn't follow the last write.
@@ -636,30 +671,46 @@ void SparseControl::UpdateRange(int result) {
   if (first_bit > last_bit)
     return;
 
-  if (block_offset && !child_map_.Get(last_bit)) {
+  Bitmap child_map(child_data->bitmap, kNumSparseBits, kNumSparseBits / 32);
+  if (block_offset && !child_map.Get(last_bit)) {
     // The last block is not completely filled; save it for later.
-    child_data_.header.last_block = last_bit;
-    child_data_.header.last_block_len = block_offset;
+    child_data->header.last_block = last_bit;
+    child_data->header.last_block_len = block_offset;
   } else {
-    child_data_.header.last_block = -1;
+    child_data->header.last_block = -1;
   }
 
-  child_map_.SetRange(first_bit, last_bit, true);
+  child_map.SetRange(first_bit, last_bit, true);
 }
 
-int SparseControl::PartialBlockLength(int block_index) const {
+int SparseControl::PartialBlockLength(int block_index, int data_size) const {
   if (block_index == child_data_.header.last_block)
     return child_data_.header.last_block_len;
 
   // This may be the last stored index.
-  int entry_len = child_->GetDataSize(kSparseData);
-  if (block_index == entry_len >> 10)
-    return entry_len & (kBlockSize - 1);
+  if (block_index == data_size >> 10)
+    return data_size & (kBlockSize - 1);
 
   // This is really empty.
   return 0;
 }
 
+void SparseControl::UpdateChildSummary(int child_id,
+                                       const SparseData& child_data,
+                                       EntryImpl* child) {
+  ChildSummaries::iterator it = child_summaries_.find(child_id);
+  if (it == child_summaries_.end()) {
+    if (child_summaries_.size() >= kMaxChildSummaries)
+      return;
+    it = child_summaries_.insert(std::make_pair(child_id, ChildSummary()))
+             .first;
+  }
+  it->second.child_data = child_data;
+  it->second.data_size = child->GetDataSize(kSparseData);
+  it->second.removal_count =
+      entry_->backend_.get() ? entry_->backend_->GetRemovalCount() : 0;
+}
+
 void SparseControl::InitChildData() {
   // We know the real type of child_.
   EntryImpl* child = static_cast<EntryImpl*>(child_);
@@ -676,6 +727,7 @@ void SparseControl::InitChildData() {
   if (rv != sizeof(child_data_))
     DLOG(ERROR) << "Failed to save child data";
   SetChildBit(true);
+  UpdateChildSummary(static_cast<int>(offset_ >> 20), child_data_, child_);
 }
 
 void SparseControl::DoChildrenIO() {
@@ -690,6 +742,13 @@ void SparseControl::DoChildrenIO() {
         CreateNetLogGetAvailableRangeResultCallback(offset_, result_));
   }
   if (finished_) {
+    // There is nothing else to start, but we may have to wait for the IO that
+    // is still in flight.
+    buf_len_ = 0;
+    if (child_io_in_flight_)
+      return;
+
+    MergeChildIOResults();
     if (kGetRangeOperation != operation_ &&
         entry_->net_log().IsLogging()) {
       entry_->net_log().EndEvent(GetSparseEventType(operation_));
@@ -704,6 +763,12 @@ bool SparseControl::DoChildIO() {
   if (!buf_len_ || result_ < 0)
     return false;
 
+  // Wait for a child to finish before moving on to another one.
+  if (child_io_in_flight_ >= max_child_io_) {
+    finished_ = false;
+    return false;
+  }
+
   if (!OpenChild())
     return false;
 
@@ -712,41 +777,79 @@ bool SparseControl::DoChildIO() {
 
   // We have more work to do. Let's not trigger a callback to the caller.
   finished_ = false;
+
+  if (kGetRangeOperation == operation_) {
+    int rv = DoGetAvailableRange();
+    if (!rv)
+      return false;
+
+    result_ += rv;
+    offset_ += rv;
+    buf_len_ -= rv;
+    return true;
+  }
+
+  StartChildIO();
+  return true;
+}
+
+void SparseControl::StartChildIO() {
+  ChildIO* io = new ChildIO;
+  io->child = child_;
+  io->child_id = static_cast<int>(offset_ >> 20);
+  io->child_data = child_data_;
+  io->child_offset = child_offset_;
+  io->child_len = child_len_;
+  io->result = net::ERR_IO_PENDING;
+  child_io_.push_back(io);
+  child_io_in_flight_++;
+
+  // The reference to the child belongs to |io| now.
+  child_ = NULL;
+
   CompletionCallback callback;
   if (!user_callback_.is_null()) {
-    callback =
-        base::Bind(&SparseControl::OnChildIOCompleted, base::Unretained(this));
+    callback = base::Bind(&SparseControl::OnChildIOCompleted,
+                          base::Unretained(this), io);
   }
 
+  // Each child works on its own piece of the user buffer.
+  scoped_refptr<net::IOBuffer> buf(
+      new net::DrainableIOBuffer(user_buf_.get(), io->child_len));
+
   int rv = 0;
   switch (operation_) {
     case kReadOperation:
       if (entry_->net_log().IsLogging()) {
         entry_->net_log().BeginEvent(
             net::NetLog::TYPE_SPARSE_READ_CHILD_DATA,
-            CreateNetLogSparseReadWriteCallback(child_->net_log().source(),
-                                                child_len_));
+            CreateNetLogSparseReadWriteCallback(io->child->net_log().source(),
+                                                io->child_len));
       }
-      rv = child_->ReadDataImpl(kSparseData, child_offset_, user_buf_.get(),
-                                child_len_, callback);
+      rv = io->child->ReadDataImpl(kSparseData, io->child_offset, buf.get(),
+                                   io->child_len, callback);
       break;
     case kWriteOperation:
       if (entry_->net_log().IsLogging()) {
         entry_->net_log().BeginEvent(
             net::NetLog::TYPE_SPARSE_WRITE_CHILD_DATA,
-            CreateNetLogSparseReadWriteCallback(child_->net_log().source(),
-                                                child_len_));
+            CreateNetLogSparseReadWriteCallback(io->child->net_log().source(),
+                                                io->child_len));
       }
-      rv = child_->WriteDataImpl(kSparseData, child_offset_, user_buf_.get(),
-                                 child_len_, callback, false);
-      break;
-    case kGetRangeOperation:
-      rv = DoGetAvailableRange();
+      rv = io->child->WriteDataImpl(kSparseData, io->child_offset, buf.get(),
+                                    io->child_len, callback, false);
       break;
     default:
       NOTREACHED();
   }
 
+  // Move on as if this piece will be completed; the results are merged in
+  // order when all the IO is done.
+  offset_ += io->child_len;
+  buf_len_ -= io->child_len;
+  if (buf_len_)
+    user_buf_->DidConsume(io->child_len);
+
   if (rv == net::ERR_IO_PENDING) {
     if (!pending_) {
       pending_ = true;
@@ -756,23 +859,31 @@ bool SparseControl::DoChildIO() {
       // finished doing sparse stuff.
       entry_->AddRef();  // Balanced in DoUserCallback.
     }
-    return false;
+    return;
   }
-  if (!rv)
-    return false;
 
-  DoChildIOCompleted(rv);
-  return true;
+  DoChildIOCompleted(io, rv);
 }
 
 int SparseControl::DoGetAvailableRange() {
-  if (!child_)
-    return child_len_;  // Move on to the next child.
+  int data_size;
+  if (child_) {
+    data_size = child_->GetDataSize(kSparseData);
+  } else {
+    ChildSummaries::const_iterator it =
+        child_summaries_.find(static_cast<int>(offset_ >> 20));
+    if (it == child_summaries_.end())
+      return child_len_;  // Move on to the next child.
+
+    // |child_map_| works on |child_data_|.
+    child_data_ = it->second.child_data;
+    data_size = it->second.data_size;
+  }
 
   // Check that there are no holes in this range.
   int last_bit = (child_offset_ + child_len_ + 1023) >> 10;
   int start = child_offset_ >> 10;
-  int partial_start_bytes = PartialBlockLength(start);
+  int partial_start_bytes = PartialBlockLength(start, data_size);
   int found = start;
   int bits_found = child_map_.FindBits(&found, last_bit, true);
 
@@ -788,7 +899,7 @@ int SparseControl::DoGetAvailableRange() {
   int empty_start = std::max((found << 10) - child_offset_, 0);
 
   int bytes_found = bits_found << 10;
-  bytes_found += PartialBlockLength(found + bits_found);
+  bytes_found += PartialBlockLength(found + bits_found, data_size);
 
   if (start == found)
     bytes_found -= block_offset;
@@ -812,33 +923,47 @@ int SparseControl::DoGetAvailableRange() {
   return 0;
 }
 
-void SparseControl::DoChildIOCompleted(int result) {
+void SparseControl::DoChildIOCompleted(ChildIO* io, int result) {
   LogChildOperationEnd(entry_->net_log(), operation_, result);
-  if (result < 0) {
-    // We fail the whole operation if we encounter an error.
-    result_ = result;
-    return;
-  }
+  io->result = result;
+  child_io_in_flight_--;
 
-  UpdateRange(result);
+  if (kWriteOperation == operation_ && result > 0) {
+    UpdateRange(&io->child_data, io->child_offset, result);
+    UpdateChildSummary(io->child_id, io->child_data, io->child);
+  }
 
-  result_ += result;
-  offset_ += result;
-  buf_len_ -= result;
+  if (!child_ && io == child_io_.back()) {
+    // Keep using the last child, which is where the next operation is likely
+    // to go.
+    child_ = io->child;
+    child_data_ = io->child_data;
+  } else {
+    SaveChildData(io->child, &io->child_data);
+    io->child->Release();
+  }
+  io->child = NULL;
 
-  // We'll be reusing the user provided buffer for the next chunk.
-  if (buf_len_ && user_buf_.get())
-    user_buf_->DidConsume(result);
+  // The operation stops at the first error or short read, so there is no
+  // point in starting more IO.
+  if (result < io->child_len)
+    buf_len_ = 0;
 }
 
-void SparseControl::OnChildIOCompleted(int result) {
+void SparseControl::OnChildIOCompleted(ChildIO* io, int result) {
   DCHECK_NE(net::ERR_IO_PENDING, result);
-  DoChildIOCompleted(result);
+  DoChildIOCompleted(io, result);
 
   if (abort_) {
     // We'll return the current result of the operation, which may be less than
-    // the bytes to read or write, but the user cancelled the operation.
+    // the bytes to read or write, but the user cancelled the operation. The
+    // IO that is already in flight has to complete first.
+    buf_len_ = 0;
+    if (child_io_in_flight_)
+      return;
+
     abort_ = false;
+    MergeChildIOResults();
     if (entry_->net_log().IsLogging()) {
       entry_->net_log().AddEvent(net::NetLog::TYPE_CANCELLED);
       entry_->net_log().EndEvent(GetSparseEventType(operation_));
@@ -858,6 +983,22 @@ void SparseControl::OnChildIOCompleted(int result) {
   DoChildrenIO();
 }
 
+void SparseControl::MergeChildIOResults() {
+  DCHECK(!child_io_in_flight_);
+  for (size_t i = 0; i < child_io_.size() && result_ >= 0; i++) {
+    const ChildIO* io = child_io_[i];
+    if (io->result < 0) {
+      // We fail the whole operation if we encounter an error.
+      result_ = io->result;
+      break;
+    }
+    result_ += io->result;
+    if (io->result < io->child_len)
+      break;
+  }
+  child_io_.clear();
+}
+
 void SparseControl::DoUserCallback() {
   DCHECK(!user_callback_.is_null());
   CompletionCallback cb = user_callback_;
@@ -5,11 +5,13 @@
 #ifndef NET_DISK_CACHE_BLOCKFILE_SPARSE_CONTROL_H_
 #define NET_DISK_CACHE_BLOCKFILE_SPARSE_CONTROL_H_
 
+#include <map>
 #include <string>
 #include <vector>
 
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
+#include "base/memory/scoped_vector.h"
 #include "net/base/completion_callback.h"
 #include "net/disk_cache/blockfile/bitmap.h"
 #include "net/disk_cache/blockfile/disk_format.h"
@@ -29,6 +31,11 @@ class EntryImpl;
 // the operation into multiple small pieces, sending each one to the
 // appropriate entry. An instance of this class is asociated with each entry
 // used directly for sparse operations (the entry passed in to the constructor).
+//
+// The pieces of an operation that go to different child entries are issued
+// without waiting for each other, up to the depth set on the backend (see
+// BackendImpl::SetSparseIODepth()), and their results are merged in order
+// when all of them complete.
 class SparseControl {
  public:
   typedef net::CompletionCallback CompletionCallback;
@@ -77,6 +84,26 @@ class SparseControl {
   static void DeleteChildren(EntryImpl* entry);
 
  private:
+  // An IO operation issued to a child entry. The operation owns a reference to
+  // the child until it completes.
+  struct ChildIO {
+    EntryImpl* child;
+    int child_id;
+    SparseData child_data;  // Parent and allocation map of |child|.
+    int child_offset;
+    int child_len;
+    int result;
+  };
+
+  // What GetAvailableRange() needs to know about a child entry, so that it
+  // doesn't have to open the child again.
+  struct ChildSummary {
+    SparseData child_data;
+    int data_size;
+    uint32 removal_count;  // BackendImpl::GetRemovalCount() when recorded.
+  };
+  typedef std::map<int, ChildSummary> ChildSummaries;
+
   // Creates a new sparse entry or opens an aready created entry from disk.
   // These methods just read / write the required info from disk for the current
   // entry, and verify that everything is correct. The return value is a net
@@ -114,13 +141,19 @@ class SparseControl {
   // the child).
   bool VerifyRange();
 
-  // Updates the contents bitmap for the current range, based on the result of
-  // the current operation.
-  void UpdateRange(int result);
+  // Updates the contents bitmap of a child, |child_data|, for the range that
+  // starts at |child_offset|, based on the result of the operation.
+  void UpdateRange(SparseData* child_data, int child_offset, int result);
 
-  // Returns the number of bytes stored at |block_index|, if its allocation-bit
-  // is off (because it is not completely filled).
-  int PartialBlockLength(int block_index) const;
+  // Returns the number of bytes stored at |block_index| of the current child,
+  // if its allocation-bit is off (because it is not completely filled).
+  // |data_size| is the size of the data stored by the child.
+  int PartialBlockLength(int block_index, int data_size) const;
+
+  // Records what the child |child_id| stores, for GetAvailableRange().
+  void UpdateChildSummary(int child_id,
+                          const SparseData& child_data,
+                          EntryImpl* child);
 
   // Initializes the sparse info for the current child.
   void InitChildData();
@@ -133,14 +166,21 @@ class SparseControl {
   // work.
   bool DoChildIO();
 
+  // Starts the read or write for the current child, and moves on to the next
+  // child without waiting for it.
+  void StartChildIO();
+
   // Performs the required work for GetAvailableRange for one child.
   int DoGetAvailableRange();
 
   // Performs the required work after a single IO operations finishes.
-  void DoChildIOCompleted(int result);
+  void DoChildIOCompleted(ChildIO* io, int result);
 
   // Invoked by the callback of asynchronous operations.
-  void OnChildIOCompleted(int result);
+  void OnChildIOCompleted(ChildIO* io, int result);
+
+  // Adds up the results of the child IO operations, in order, to |result_|.
+  void MergeChildIOResults();
 
   // Reports to the user that we are done.
   void DoUserCallback();
@@ -169,6 +209,11 @@ class SparseControl {
   int child_len_;  // Bytes to read or write for this child.
   int result_;
 
+  ScopedVector<ChildIO> child_io_;  // The IO issued by this operation.
+  int child_io_in_flight_;
+  int max_child_io_;  // The number of children that can have IO in flight.
+  ChildSummaries child_summaries_;
+
   DISALLOW_COPY_AND_ASSIGN(SparseControl);
 };
 
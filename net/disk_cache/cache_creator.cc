@@ -11,12 +11,19 @@
 #include "net/base/net_errors.h"
 #include "net/disk_cache/blockfile/backend_impl.h"
 #include "net/disk_cache/cache_util.h"
+#include "net/disk_cache/compression/compressing_cache_backend.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
 
 namespace {
 
+// Returns whether the bodies newly stored by the HTTP cache are compressed.
+bool ShouldCompressNewStreams() {
+  return base::FieldTrialList::FindFullName("DiskCacheCompression") ==
+         "Enabled";
+}
+
 // Builds an instance of the backend depending on platform, type, experiments
 // etc. Takes care of the retry state. This object will self-destroy when
 // finished.
@@ -124,7 +131,15 @@ void CacheCreator::DoCallback(int result) {
   DCHECK_NE(net::ERR_IO_PENDING, result);
   if (result == net::OK) {
 #ifndef USE_TRACING_CACHE_BACKEND
-    *backend_ = created_cache_.Pass();
+    // Only the HTTP cache holds bodies that may compress well. The entries
+    // written while the trial is on no longer parse once it is off, and are
+    // then doomed by the HTTP cache.
+    if (type_ == net::DISK_CACHE && ShouldCompressNewStreams()) {
+      backend_->reset(
+          new disk_cache::CompressingCacheBackend(created_cache_.Pass()));
+    } else {
+      *backend_ = created_cache_.Pass();
+    }
 #else
     *backend_.reset(
         new disk_cache::TracingCacheBackend(created_cache_.Pass()));
@@ -0,0 +1,126 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/compression/compressed_stream.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "third_party/zlib/zlib.h"
+
+namespace disk_cache {
+
+namespace {
+
+// The probe deflates up to this many bytes of the first write of a stream.
+const int kProbeSize = 4 * 1024;
+
+// Streams that start with less data than this are not worth the framing.
+const int kMinProbeSize = 512;
+
+// A stream is compressed if its probe shrinks by at least an eighth.
+const int kMinSavingsRatio = 8;
+
+// Favor speed: the cache compresses on the IO path.
+const int kCompressionLevel = Z_BEST_SPEED;
+
+}  // namespace
+
+CompressedEntryPrefix::CompressedEntryPrefix()
+    : magic(kCompressedEntryPrefixMagicNumber), flags(0) {
+}
+
+CompressedStreamHeader::CompressedStreamHeader()
+    : magic(kCompressedStreamMagicNumber),
+      version(kCompressedStreamVersion),
+      frame_count(0),
+      data_size(0),
+      index_offset(0) {
+}
+
+CompressedFrame::CompressedFrame() : compressed_size(0), data_size(0) {
+}
+
+CompressedFrame::CompressedFrame(int32 compressed_size, int32 data_size)
+    : compressed_size(compressed_size), data_size(data_size) {
+}
+
+bool ProbeCompressibility(const char* data, int len) {
+  if (len < kMinProbeSize)
+    return false;
+  len = std::min(len, kProbeSize);
+  std::string compressed;
+  if (!CompressFrame(data, len, &compressed))
+    return false;
+  return static_cast<int>(compressed.size()) <= len - len / kMinSavingsRatio;
+}
+
+bool CompressFrame(const char* data, int len, std::string* output) {
+  DCHECK_GE(len, 0);
+  uLongf output_len = compressBound(len);
+  output->resize(output_len);
+  if (compress2(reinterpret_cast<Bytef*>(&(*output)[0]), &output_len,
+                reinterpret_cast<const Bytef*>(data), len,
+                kCompressionLevel) != Z_OK) {
+    return false;
+  }
+  output->resize(output_len);
+  return true;
+}
+
+bool DecompressFrame(const char* data, int len, char* output, int output_len) {
+  uLongf decompressed_len = output_len;
+  if (uncompress(reinterpret_cast<Bytef*>(output), &decompressed_len,
+                 reinterpret_cast<const Bytef*>(data), len) != Z_OK) {
+    return false;
+  }
+  return decompressed_len == static_cast<uLongf>(output_len);
+}
+
+void SerializeFrameIndex(const std::vector<CompressedFrame>& frames,
+                         std::string* output) {
+  Pickle pickle;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    pickle.WriteInt(frames[i].compressed_size);
+    pickle.WriteInt(frames[i].data_size);
+  }
+  output->assign(static_cast<const char*>(pickle.data()), pickle.size());
+}
+
+bool DeserializeFrameIndex(const CompressedStreamHeader& header,
+                           const char* data,
+                           int len,
+                           std::vector<CompressedFrame>* frames) {
+  Pickle pickle(data, len);
+  if (!pickle.data() || pickle.size() != static_cast<size_t>(len))
+    return false;
+  // Each frame takes two ints in the index, so that bounds |frame_count|.
+  if (header.frame_count > static_cast<uint32>(len) / (2 * sizeof(int)))
+    return false;
+
+  PickleIterator it(pickle);
+  frames->resize(header.frame_count);
+  int64 compressed_end = kCompressedStreamHeaderSize;
+  int64 data_size = 0;
+  for (size_t i = 0; i < frames->size(); ++i) {
+    CompressedFrame* frame = &(*frames)[i];
+    if (!it.ReadInt(&frame->compressed_size) ||
+        !it.ReadInt(&frame->data_size) || frame->compressed_size <= 0 ||
+        frame->data_size <= 0 || frame->data_size > kCompressedFrameSize) {
+      frames->clear();
+      return false;
+    }
+    compressed_end += frame->compressed_size;
+    data_size += frame->data_size;
+  }
+  if (compressed_end != header.index_offset ||
+      data_size != header.data_size) {
+    frames->clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,99 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_COMPRESSION_COMPRESSED_STREAM_H_
+#define NET_DISK_CACHE_COMPRESSION_COMPRESSED_STREAM_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+
+// The layout of a stream compressed by CompressingCacheBackend, in the stream
+// of the underlying entry:
+//
+//   | CompressedStreamHeader | frame 0 | frame 1 | ... | frame index |
+//
+// Each frame holds up to kCompressedFrameSize bytes of the stream, deflated
+// with zlib, so that a range can be read without inflating what precedes it.
+// The frame index lists the sizes of the frames, and is written when the
+// entry is closed; |index_offset| is zero while the stream is being written.
+// Only the streams flagged in the CompressedEntryPrefix of their entry are
+// compressed; the others are stored as is, whatever their first bytes.
+struct NET_EXPORT_PRIVATE CompressedStreamHeader {
+  CompressedStreamHeader();
+
+  uint64 magic;
+  uint32 version;
+  uint32 frame_count;
+  // The size of the uncompressed stream.
+  int32 data_size;
+  int32 index_offset;
+};
+
+struct NET_EXPORT_PRIVATE CompressedFrame {
+  CompressedFrame();
+  CompressedFrame(int32 compressed_size, int32 data_size);
+
+  int32 compressed_size;
+  int32 data_size;
+};
+
+// The prefix of stream 0 of the entries written by CompressingCacheBackend,
+// which records how stream 1 is stored. Stream 0 holds a Pickle for the HTTP
+// cache, and a DER certificate for the certificate cache: the magic number is
+// larger than any Pickle payload size, and does not start with the DER
+// SEQUENCE tag, so it cannot be mistaken for either.
+struct NET_EXPORT_PRIVATE CompressedEntryPrefix {
+  CompressedEntryPrefix();
+
+  uint32 magic;
+  uint32 flags;
+};
+
+const uint32 kCompressedEntryPrefixMagicNumber = 0xc5e1d0a7;
+// Set in |flags| if stream 1 is compressed.
+const uint32 kCompressedEntryFlagStream1 = 1 << 0;
+const int kCompressedEntryPrefixSize = sizeof(CompressedEntryPrefix);
+
+const uint64 kCompressedStreamMagicNumber = GG_UINT64_C(0xf26e1f8c0a5d3b71);
+const uint32 kCompressedStreamVersion = 1;
+const int kCompressedStreamHeaderSize = sizeof(CompressedStreamHeader);
+const int kCompressedFrameSize = 32 * 1024;
+
+// Returns whether the stream that starts with |data| is worth compressing,
+// judging from how well its first bytes deflate.
+NET_EXPORT_PRIVATE bool ProbeCompressibility(const char* data, int len);
+
+// Deflates |len| bytes of |data| into |output|.
+NET_EXPORT_PRIVATE bool CompressFrame(const char* data,
+                                      int len,
+                                      std::string* output);
+
+// Inflates the frame |data| into the |output_len| bytes at |output|. Fails
+// unless the frame holds exactly |output_len| bytes.
+NET_EXPORT_PRIVATE bool DecompressFrame(const char* data,
+                                        int len,
+                                        char* output,
+                                        int output_len);
+
+// Serializes the frame index of a stream.
+NET_EXPORT_PRIVATE void SerializeFrameIndex(
+    const std::vector<CompressedFrame>& frames,
+    std::string* output);
+
+// Parses the frame index |data| of a stream whose header is |header|, and
+// checks that the frames fit in front of it.
+NET_EXPORT_PRIVATE bool DeserializeFrameIndex(
+    const CompressedStreamHeader& header,
+    const char* data,
+    int len,
+    std::vector<CompressedFrame>* frames);
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_COMPRESSION_COMPRESSED_STREAM_H_
@@ -0,0 +1,1041 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/compression/compressing_cache_backend.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/memory/ref_counted.h"
+#include "base/metrics/histogram.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/compression/compressed_stream.h"
+
+namespace disk_cache {
+
+namespace {
+
+// The stream that starts with the CompressedEntryPrefix.
+const int kPrefixedStreamIndex = 0;
+
+// The stream that is compressed: the body, for the HTTP cache.
+const int kCompressedStreamIndex = 1;
+
+}  // namespace
+
+// The entry returned by CompressingCacheBackend. Stream 1 is either not yet
+// written, stored as is by the wrapped entry, or compressed. A compressed
+// stream keeps its frame index in memory while the entry is open, along with
+// the data that does not fill a frame yet; both are written out on the last
+// Close(). Stream 0 of the wrapped entry starts with the prefix that flags a
+// compressed stream 1, unless the entry was written without this backend.
+class CompressingEntry : public Entry {
+ public:
+  CompressingEntry(const base::WeakPtr<CompressingCacheBackend>& backend,
+                   Entry* inner_entry);
+
+  Entry* inner_entry() const { return inner_entry_; }
+
+  // Reads the prefix of stream 0, and what is needed of stream 1 to serve it,
+  // then returns the entry. Returns ERR_IO_PENDING if that takes IO, and runs
+  // |callback| when done. If the prefix cannot be read, the wrapped entry is
+  // doomed and the open fails.
+  int Load(Entry** entry, const CompletionCallback& callback);
+
+  // Returns the entry again, for one more open of the wrapped entry.
+  int Open(Entry** entry, const CompletionCallback& callback);
+
+  // Entry:
+  void Doom() override;
+  void Close() override;
+  std::string GetKey() const override;
+  base::Time GetLastUsed() const override;
+  base::Time GetLastModified() const override;
+  int32 GetDataSize(int index) const override;
+  int ReadData(int index,
+               int offset,
+               IOBuffer* buf,
+               int buf_len,
+               const CompletionCallback& callback) override;
+  int WriteData(int index,
+                int offset,
+                IOBuffer* buf,
+                int buf_len,
+                const CompletionCallback& callback,
+                bool truncate) override;
+  int ReadSparseData(int64 offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback) override;
+  int WriteSparseData(int64 offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback) override;
+  int GetAvailableRange(int64 offset,
+                        int len,
+                        int64* start,
+                        const CompletionCallback& callback) override;
+  bool CouldBeSparse() const override;
+  void CancelSparseIO() override;
+  int ReadyForSparseIO(const CompletionCallback& callback) override;
+
+ private:
+  enum Mode {
+    // Stream 1 is empty, and the next write decides how to store it.
+    MODE_UNDECIDED,
+    MODE_PASSTHROUGH,
+    MODE_COMPRESSED,
+  };
+
+  // A read of the compressed stream, which may span several frames.
+  struct ReadState : public base::RefCounted<ReadState> {
+    ReadState(int offset,
+              IOBuffer* buf,
+              int buf_len,
+              const CompletionCallback& callback,
+              int generation);
+
+    const int offset;
+    scoped_refptr<net::DrainableIOBuffer> buf;
+    const CompletionCallback callback;
+    // The stream this read applies to; see |generation_|.
+    const int generation;
+
+   private:
+    friend class base::RefCounted<ReadState>;
+    ~ReadState();
+  };
+
+  // A write to the wrapped entry.
+  struct InnerWrite {
+    InnerWrite(int index, int offset, const std::string& data, bool truncate);
+
+    int index;
+    int offset;
+    std::string data;
+    bool truncate;
+  };
+
+  ~CompressingEntry() override;
+
+  CompressingCacheBackend::Stats* stats() {
+    return backend_ ? &backend_->stats_ : NULL;
+  }
+
+  // Loading of the prefix of stream 0, then of the header and frame index of
+  // stream 1.
+  void OnPrefixRead(scoped_refptr<IOBuffer> buffer, int result);
+  void OnHeaderRead(scoped_refptr<IOBuffer> buffer, int result);
+  void OnIndexRead(const CompressedStreamHeader& header,
+                   scoped_refptr<IOBuffer> buffer,
+                   int result);
+  // Completes the pending opens with |result|.
+  void FinishLoading(int result);
+
+  // The offset of the data of stream |index| in the wrapped entry.
+  int InnerOffset(int index) const {
+    return index == kPrefixedStreamIndex && has_prefix_
+               ? kCompressedEntryPrefixSize
+               : 0;
+  }
+
+  int WritePrefixedStream(int offset,
+                          IOBuffer* buf,
+                          int buf_len,
+                          const CompletionCallback& callback,
+                          bool truncate);
+
+  // Makes stream 1 empty and undecided again.
+  void ResetStream();
+
+  // Decides how to store stream 1, given its first write.
+  void DecideMode(int offset, IOBuffer* buf, int buf_len);
+
+  int ReadCompressed(int offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback);
+  int DoRead(const scoped_refptr<ReadState>& state);
+  void OnFrameRead(const scoped_refptr<ReadState>& state,
+                   int frame,
+                   scoped_refptr<IOBuffer> buffer,
+                   int result);
+  // Inflates |frame|, read in |buffer| with |result|, into |cached_frame_|.
+  bool CacheFrame(int frame, IOBuffer* buffer, int result);
+  // Returns the frame that holds the byte at |offset| of the stream.
+  int FindFrame(int offset) const;
+
+  int WriteCompressed(int offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback,
+                      bool truncate);
+  // Compresses the first |len| bytes of |pending_data_| into a new frame, and
+  // adds its write to |writes|.
+  bool AddFrame(int len, std::vector<InnerWrite>* writes);
+  // Adds the write of the header to |writes|.
+  void AddHeaderWrite(int32 index_offset, std::vector<InnerWrite>* writes);
+  // Adds the write of the prefix of stream 0, as of |compressed_flag_|, to
+  // |writes|.
+  void AddPrefixWrite(std::vector<InnerWrite>* writes);
+  // Issues |writes| in order. |callback| is run with |result| when the last
+  // one completes, unless they all complete synchronously; this returns the
+  // result then.
+  int IssueWrites(const std::vector<InnerWrite>& writes,
+                  const CompletionCallback& callback,
+                  int result);
+  void OnInnerWriteComplete(int expected,
+                            const CompletionCallback& callback,
+                            int result_on_success,
+                            int result);
+
+  // Completes stream 1 when the entry is closed.
+  void FlushCompressedStream();
+
+  base::WeakPtr<CompressingCacheBackend> backend_;
+  Entry* const inner_entry_;
+  // The number of times the wrapped entry is open.
+  int open_count_;
+  bool loading_;
+  // The result of the loading, for the opens that did not wait for it.
+  int load_result_;
+  std::vector<std::pair<Entry**, CompletionCallback> > pending_opens_;
+
+  // Whether stream 0 of the wrapped entry starts with the prefix, and whether
+  // the prefix flags stream 1 as compressed.
+  bool has_prefix_;
+  bool compressed_flag_;
+
+  Mode mode_;
+  // Whether the compressed stream could not be loaded, or is incomplete
+  // because it was not closed properly.
+  bool broken_;
+  // Whether the compressed stream changed since it was opened.
+  bool dirty_;
+  // Incremented whenever stream 1 is reset, so that pending reads notice.
+  int generation_;
+  int write_error_;
+
+  // The uncompressed size of the stream, and of the part of it in frames.
+  int32 data_size_;
+  int32 framed_size_;
+  int32 compressed_end_;
+  std::vector<CompressedFrame> frames_;
+  // The offsets of the frames, in the stream and in the wrapped stream.
+  std::vector<int32> frame_starts_;
+  std::vector<int32> frame_offsets_;
+  // The data past |framed_size_|.
+  std::string pending_data_;
+
+  // The last frame inflated.
+  int cached_frame_;
+  std::vector<char> cached_frame_data_;
+
+  base::TimeDelta compression_time_;
+
+  base::WeakPtrFactory<CompressingEntry> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompressingEntry);
+};
+
+CompressingEntry::ReadState::ReadState(int offset,
+                                       IOBuffer* buf,
+                                       int buf_len,
+                                       const CompletionCallback& callback,
+                                       int generation)
+    : offset(offset),
+      buf(new net::DrainableIOBuffer(buf, buf_len)),
+      callback(callback),
+      generation(generation) {
+}
+
+CompressingEntry::ReadState::~ReadState() {
+}
+
+CompressingEntry::InnerWrite::InnerWrite(int index,
+                                         int offset,
+                                         const std::string& data,
+                                         bool truncate)
+    : index(index), offset(offset), data(data), truncate(truncate) {
+}
+
+CompressingEntry::CompressingEntry(
+    const base::WeakPtr<CompressingCacheBackend>& backend,
+    Entry* inner_entry)
+    : backend_(backend),
+      inner_entry_(inner_entry),
+      open_count_(0),
+      loading_(false),
+      load_result_(net::OK),
+      has_prefix_(false),
+      compressed_flag_(false),
+      mode_(MODE_UNDECIDED),
+      broken_(false),
+      dirty_(false),
+      generation_(0),
+      write_error_(net::OK),
+      data_size_(0),
+      framed_size_(0),
+      compressed_end_(kCompressedStreamHeaderSize),
+      cached_frame_(-1),
+      weak_factory_(this) {
+}
+
+CompressingEntry::~CompressingEntry() {
+}
+
+int CompressingEntry::Load(Entry** entry, const CompletionCallback& callback) {
+  DCHECK(!open_count_);
+  if (inner_entry_->GetDataSize(kPrefixedStreamIndex) <
+      kCompressedEntryPrefixSize) {
+    // A new entry, or one written without this backend.
+    if (inner_entry_->GetDataSize(kCompressedStreamIndex) > 0)
+      mode_ = MODE_PASSTHROUGH;
+    return Open(entry, callback);
+  }
+
+  loading_ = true;
+  scoped_refptr<IOBuffer> buffer(new IOBuffer(kCompressedEntryPrefixSize));
+  const int rv = inner_entry_->ReadData(
+      kPrefixedStreamIndex, 0, buffer.get(), kCompressedEntryPrefixSize,
+      base::Bind(&CompressingEntry::OnPrefixRead, weak_factory_.GetWeakPtr(),
+                 buffer));
+  if (rv != net::ERR_IO_PENDING)
+    OnPrefixRead(buffer, rv);
+  // This waits for the loading if it did not complete synchronously.
+  return Open(entry, callback);
+}
+
+int CompressingEntry::Open(Entry** entry, const CompletionCallback& callback) {
+  ++open_count_;
+  if (loading_) {
+    pending_opens_.push_back(std::make_pair(entry, callback));
+    return net::ERR_IO_PENDING;
+  }
+  if (load_result_ != net::OK) {
+    const int result = load_result_;
+    // This may delete the entry.
+    Close();
+    return result;
+  }
+  *entry = this;
+  return net::OK;
+}
+
+void CompressingEntry::OnPrefixRead(scoped_refptr<IOBuffer> buffer,
+                                    int result) {
+  if (result != kCompressedEntryPrefixSize) {
+    // Without the prefix, stream 1 cannot be told apart from a compressed one.
+    return FinishLoading(result < 0 ? result : net::ERR_CACHE_READ_FAILURE);
+  }
+  CompressedEntryPrefix prefix;
+  memcpy(&prefix, buffer->data(), sizeof(prefix));
+  has_prefix_ = prefix.magic == kCompressedEntryPrefixMagicNumber;
+  compressed_flag_ =
+      has_prefix_ && (prefix.flags & kCompressedEntryFlagStream1) != 0;
+
+  const int32 size = inner_entry_->GetDataSize(kCompressedStreamIndex);
+  if (!size)
+    return FinishLoading(net::OK);
+  if (!compressed_flag_) {
+    mode_ = MODE_PASSTHROUGH;
+    return FinishLoading(net::OK);
+  }
+
+  mode_ = MODE_COMPRESSED;
+  if (size < kCompressedStreamHeaderSize) {
+    broken_ = true;
+    return FinishLoading(net::OK);
+  }
+  scoped_refptr<IOBuffer> header_buffer(
+      new IOBuffer(kCompressedStreamHeaderSize));
+  const int rv = inner_entry_->ReadData(
+      kCompressedStreamIndex, 0, header_buffer.get(),
+      kCompressedStreamHeaderSize,
+      base::Bind(&CompressingEntry::OnHeaderRead, weak_factory_.GetWeakPtr(),
+                 header_buffer));
+  if (rv != net::ERR_IO_PENDING)
+    OnHeaderRead(header_buffer, rv);
+}
+
+void CompressingEntry::OnHeaderRead(scoped_refptr<IOBuffer> buffer,
+                                    int result) {
+  DCHECK_EQ(MODE_COMPRESSED, mode_);
+  // The prefix says the stream is compressed, so anything unexpected means it
+  // is damaged.
+  CompressedStreamHeader header;
+  if (result == kCompressedStreamHeaderSize)
+    memcpy(&header, buffer->data(), sizeof(header));
+  if (result != kCompressedStreamHeaderSize ||
+      header.magic != kCompressedStreamMagicNumber ||
+      header.version != kCompressedStreamVersion || header.data_size < 0) {
+    broken_ = true;
+    return FinishLoading(net::OK);
+  }
+
+  data_size_ = header.data_size;
+  const int32 size = inner_entry_->GetDataSize(kCompressedStreamIndex);
+  if (header.index_offset < kCompressedStreamHeaderSize ||
+      header.index_offset >= size) {
+    broken_ = true;
+    return FinishLoading(net::OK);
+  }
+
+  const int index_size = size - header.index_offset;
+  scoped_refptr<IOBuffer> index_buffer(new IOBuffer(index_size));
+  const int rv = inner_entry_->ReadData(
+      kCompressedStreamIndex, header.index_offset, index_buffer.get(),
+      index_size, base::Bind(&CompressingEntry::OnIndexRead,
+                             weak_factory_.GetWeakPtr(), header,
+                             index_buffer));
+  if (rv != net::ERR_IO_PENDING)
+    OnIndexRead(header, index_buffer, rv);
+}
+
+void CompressingEntry::OnIndexRead(const CompressedStreamHeader& header,
+                                   scoped_refptr<IOBuffer> buffer,
+                                   int result) {
+  if (result <= 0 ||
+      !DeserializeFrameIndex(header, buffer->data(), result, &frames_)) {
+    broken_ = true;
+    return FinishLoading(net::OK);
+  }
+  int32 start = 0;
+  int32 offset = kCompressedStreamHeaderSize;
+  for (size_t i = 0; i < frames_.size(); ++i) {
+    frame_starts_.push_back(start);
+    frame_offsets_.push_back(offset);
+    start += frames_[i].data_size;
+    offset += frames_[i].compressed_size;
+  }
+  framed_size_ = data_size_;
+  compressed_end_ = header.index_offset;
+  FinishLoading(net::OK);
+}
+
+void CompressingEntry::FinishLoading(int result) {
+  DCHECK(loading_);
+  loading_ = false;
+  load_result_ = result;
+  std::vector<std::pair<Entry**, CompletionCallback> > pending_opens;
+  pending_opens.swap(pending_opens_);
+  if (result != net::OK) {
+    inner_entry_->Doom();
+    // The last Close() deletes this entry, so the callbacks run after.
+    for (size_t i = 0; i < pending_opens.size(); ++i)
+      Close();
+    for (size_t i = 0; i < pending_opens.size(); ++i)
+      pending_opens[i].second.Run(result);
+    return;
+  }
+  for (size_t i = 0; i < pending_opens.size(); ++i) {
+    *pending_opens[i].first = this;
+    // Every open is accounted for in |open_count_|, so the callbacks cannot
+    // delete this entry before the last one runs.
+    pending_opens[i].second.Run(net::OK);
+  }
+}
+
+void CompressingEntry::Doom() {
+  inner_entry_->Doom();
+}
+
+void CompressingEntry::Close() {
+  DCHECK_GT(open_count_, 0);
+  if (--open_count_) {
+    inner_entry_->Close();
+    return;
+  }
+  if (mode_ == MODE_COMPRESSED && dirty_)
+    FlushCompressedStream();
+  if (backend_)
+    backend_->OnEntryClosed(this);
+  inner_entry_->Close();
+  delete this;
+}
+
+std::string CompressingEntry::GetKey() const {
+  return inner_entry_->GetKey();
+}
+
+base::Time CompressingEntry::GetLastUsed() const {
+  return inner_entry_->GetLastUsed();
+}
+
+base::Time CompressingEntry::GetLastModified() const {
+  return inner_entry_->GetLastModified();
+}
+
+int32 CompressingEntry::GetDataSize(int index) const {
+  if (index == kCompressedStreamIndex && mode_ == MODE_COMPRESSED)
+    return data_size_;
+  return inner_entry_->GetDataSize(index) - InnerOffset(index);
+}
+
+int CompressingEntry::ReadData(int index,
+                               int offset,
+                               IOBuffer* buf,
+                               int buf_len,
+                               const CompletionCallback& callback) {
+  if (index == kCompressedStreamIndex && mode_ == MODE_COMPRESSED)
+    return ReadCompressed(offset, buf, buf_len, callback);
+  if (offset < 0)
+    return net::ERR_INVALID_ARGUMENT;
+  return inner_entry_->ReadData(index, offset + InnerOffset(index), buf,
+                                buf_len, callback);
+}
+
+int CompressingEntry::WriteData(int index,
+                                int offset,
+                                IOBuffer* buf,
+                                int buf_len,
+                                const CompletionCallback& callback,
+                                bool truncate) {
+  if (index == kPrefixedStreamIndex)
+    return WritePrefixedStream(offset, buf, buf_len, callback, truncate);
+  if (index != kCompressedStreamIndex) {
+    return inner_entry_->WriteData(index, offset, buf, buf_len, callback,
+                                   truncate);
+  }
+  if (offset == 0 && truncate && mode_ != MODE_UNDECIDED)
+    ResetStream();
+  if (mode_ == MODE_UNDECIDED)
+    DecideMode(offset, buf, buf_len);
+  if (mode_ == MODE_COMPRESSED)
+    return WriteCompressed(offset, buf, buf_len, callback, truncate);
+  if (!compressed_flag_) {
+    return inner_entry_->WriteData(index, offset, buf, buf_len, callback,
+                                   truncate);
+  }
+
+  // The stream was compressed before it was truncated; the flag must be
+  // cleared before the new data can be stored as is.
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+  compressed_flag_ = false;
+  std::vector<InnerWrite> writes;
+  AddPrefixWrite(&writes);
+  writes.push_back(InnerWrite(
+      index, offset,
+      buf_len ? std::string(buf->data(), buf_len) : std::string(), truncate));
+  return IssueWrites(writes, callback, buf_len);
+}
+
+int CompressingEntry::WritePrefixedStream(int offset,
+                                          IOBuffer* buf,
+                                          int buf_len,
+                                          const CompletionCallback& callback,
+                                          bool truncate) {
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+  if (has_prefix_ || inner_entry_->GetDataSize(kPrefixedStreamIndex)) {
+    // The stream has its prefix, or was written without this backend.
+    return inner_entry_->WriteData(kPrefixedStreamIndex,
+                                   offset + InnerOffset(kPrefixedStreamIndex),
+                                   buf, buf_len, callback, truncate);
+  }
+
+  // The first write of the stream puts the prefix in front of it.
+  std::vector<InnerWrite> writes;
+  AddPrefixWrite(&writes);
+  writes.push_back(InnerWrite(
+      kPrefixedStreamIndex, offset + kCompressedEntryPrefixSize,
+      buf_len ? std::string(buf->data(), buf_len) : std::string(), truncate));
+  return IssueWrites(writes, callback, buf_len);
+}
+
+int CompressingEntry::ReadSparseData(int64 offset,
+                                     IOBuffer* buf,
+                                     int buf_len,
+                                     const CompletionCallback& callback) {
+  return inner_entry_->ReadSparseData(offset, buf, buf_len, callback);
+}
+
+int CompressingEntry::WriteSparseData(int64 offset,
+                                      IOBuffer* buf,
+                                      int buf_len,
+                                      const CompletionCallback& callback) {
+  return inner_entry_->WriteSparseData(offset, buf, buf_len, callback);
+}
+
+int CompressingEntry::GetAvailableRange(int64 offset,
+                                        int len,
+                                        int64* start,
+                                        const CompletionCallback& callback) {
+  return inner_entry_->GetAvailableRange(offset, len, start, callback);
+}
+
+bool CompressingEntry::CouldBeSparse() const {
+  return inner_entry_->CouldBeSparse();
+}
+
+void CompressingEntry::CancelSparseIO() {
+  inner_entry_->CancelSparseIO();
+}
+
+int CompressingEntry::ReadyForSparseIO(const CompletionCallback& callback) {
+  return inner_entry_->ReadyForSparseIO(callback);
+}
+
+void CompressingEntry::ResetStream() {
+  mode_ = MODE_UNDECIDED;
+  broken_ = false;
+  dirty_ = false;
+  ++generation_;
+  write_error_ = net::OK;
+  data_size_ = 0;
+  framed_size_ = 0;
+  compressed_end_ = kCompressedStreamHeaderSize;
+  frames_.clear();
+  frame_starts_.clear();
+  frame_offsets_.clear();
+  pending_data_.clear();
+  cached_frame_ = -1;
+  cached_frame_data_.clear();
+}
+
+void CompressingEntry::DecideMode(int offset, IOBuffer* buf, int buf_len) {
+  DCHECK_EQ(MODE_UNDECIDED, mode_);
+  // Zero-length writes, such as truncations, leave the stream empty.
+  if (buf_len <= 0 && offset == 0)
+    return;
+
+  // An entry written without this backend has no room for the prefix, so its
+  // stream is stored as is.
+  if (!has_prefix_ && inner_entry_->GetDataSize(kPrefixedStreamIndex)) {
+    mode_ = MODE_PASSTHROUGH;
+    return;
+  }
+
+  CompressingCacheBackend::Stats* counters = stats();
+  if (offset == 0 && ProbeCompressibility(buf->data(), buf_len)) {
+    mode_ = MODE_COMPRESSED;
+    if (counters)
+      ++counters->compressed_streams;
+  } else {
+    mode_ = MODE_PASSTHROUGH;
+    if (counters)
+      ++counters->incompressible_streams;
+  }
+}
+
+int CompressingEntry::ReadCompressed(int offset,
+                                     IOBuffer* buf,
+                                     int buf_len,
+                                     const CompletionCallback& callback) {
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+  if (broken_)
+    return net::ERR_CACHE_READ_FAILURE;
+  if (offset >= data_size_ || !buf_len)
+    return 0;
+  buf_len = std::min(buf_len, data_size_ - offset);
+  scoped_refptr<ReadState> state(
+      new ReadState(offset, buf, buf_len, callback, generation_));
+  return DoRead(state);
+}
+
+int CompressingEntry::DoRead(const scoped_refptr<ReadState>& state) {
+  if (state->generation != generation_)
+    return net::ERR_CACHE_READ_FAILURE;
+
+  while (state->buf->BytesRemaining()) {
+    const int position = state->offset + state->buf->BytesConsumed();
+    if (position >= data_size_)
+      break;
+
+    if (position >= framed_size_) {
+      const int len = std::min(state->buf->BytesRemaining(),
+                               data_size_ - position);
+      memcpy(state->buf->data(), pending_data_.data() + position - framed_size_,
+             len);
+      state->buf->DidConsume(len);
+      continue;
+    }
+
+    const int frame = FindFrame(position);
+    if (frame != cached_frame_) {
+      scoped_refptr<IOBuffer> buffer(
+          new IOBuffer(frames_[frame].compressed_size));
+      const int rv = inner_entry_->ReadData(
+          kCompressedStreamIndex, frame_offsets_[frame], buffer.get(),
+          frames_[frame].compressed_size,
+          base::Bind(&CompressingEntry::OnFrameRead,
+                     weak_factory_.GetWeakPtr(), state, frame, buffer));
+      if (rv == net::ERR_IO_PENDING)
+        return rv;
+      if (!CacheFrame(frame, buffer.get(), rv))
+        return net::ERR_CACHE_READ_FAILURE;
+    }
+
+    const int frame_offset = position - frame_starts_[frame];
+    const int len = std::min(state->buf->BytesRemaining(),
+                             frames_[frame].data_size - frame_offset);
+    memcpy(state->buf->data(), &cached_frame_data_[frame_offset], len);
+    state->buf->DidConsume(len);
+  }
+  return state->buf->BytesConsumed();
+}
+
+void CompressingEntry::OnFrameRead(const scoped_refptr<ReadState>& state,
+                                   int frame,
+                                   scoped_refptr<IOBuffer> buffer,
+                                   int result) {
+  int rv = net::ERR_CACHE_READ_FAILURE;
+  if (state->generation == generation_ &&
+      CacheFrame(frame, buffer.get(), result)) {
+    rv = DoRead(state);
+    if (rv == net::ERR_IO_PENDING)
+      return;
+  }
+  state->callback.Run(rv);
+}
+
+bool CompressingEntry::CacheFrame(int frame, IOBuffer* buffer, int result) {
+  if (result != frames_[frame].compressed_size)
+    return false;
+  const base::TimeTicks start = base::TimeTicks::Now();
+  cached_frame_data_.resize(frames_[frame].data_size);
+  const bool decompressed =
+      DecompressFrame(buffer->data(), result, &cached_frame_data_[0],
+                      frames_[frame].data_size);
+  CompressingCacheBackend::Stats* counters = stats();
+  if (counters)
+    counters->decompression_time += base::TimeTicks::Now() - start;
+  cached_frame_ = decompressed ? frame : -1;
+  return decompressed;
+}
+
+int CompressingEntry::FindFrame(int offset) const {
+  DCHECK_LT(offset, framed_size_);
+  return static_cast<int>(std::upper_bound(frame_starts_.begin(),
+                                           frame_starts_.end(), offset) -
+                          frame_starts_.begin()) - 1;
+}
+
+int CompressingEntry::WriteCompressed(int offset,
+                                      IOBuffer* buf,
+                                      int buf_len,
+                                      const CompletionCallback& callback,
+                                      bool truncate) {
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+  if (broken_)
+    return net::ERR_CACHE_WRITE_FAILURE;
+  if (write_error_ != net::OK)
+    return write_error_;
+  if (offset != data_size_) {
+    // Only appending is supported, as the frames cannot be rewritten in place.
+    if (!buf_len && !truncate && offset < data_size_)
+      return 0;
+    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+  }
+  if (!buf_len)
+    return 0;
+
+  std::vector<InnerWrite> writes;
+  if (!compressed_flag_) {
+    // Flag the stream before any of it is written.
+    compressed_flag_ = true;
+    AddPrefixWrite(&writes);
+  }
+  if (!dirty_) {
+    // Mark the stream as incomplete until it is closed, so that it cannot be
+    // read with a stale index if the entry is never closed properly.
+    dirty_ = true;
+    AddHeaderWrite(0, &writes);
+    // A new stream has nothing past its header.
+    if (!data_size_)
+      writes.back().truncate = true;
+  }
+
+  pending_data_.append(buf->data(), buf_len);
+  data_size_ += buf_len;
+  while (static_cast<int>(pending_data_.size()) >= kCompressedFrameSize) {
+    if (!AddFrame(kCompressedFrameSize, &writes)) {
+      write_error_ = net::ERR_CACHE_WRITE_FAILURE;
+      return write_error_;
+    }
+  }
+  return IssueWrites(writes, callback, buf_len);
+}
+
+bool CompressingEntry::AddFrame(int len, std::vector<InnerWrite>* writes) {
+  DCHECK_LE(len, static_cast<int>(pending_data_.size()));
+  const base::TimeTicks start = base::TimeTicks::Now();
+  std::string compressed;
+  if (!CompressFrame(pending_data_.data(), len, &compressed))
+    return false;
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  compression_time_ += elapsed;
+  CompressingCacheBackend::Stats* counters = stats();
+  if (counters) {
+    counters->bytes_in += len;
+    counters->bytes_out += compressed.size();
+    counters->compression_time += elapsed;
+  }
+
+  const int32 compressed_size = static_cast<int32>(compressed.size());
+  frames_.push_back(CompressedFrame(compressed_size, len));
+  frame_starts_.push_back(framed_size_);
+  frame_offsets_.push_back(compressed_end_);
+  writes->push_back(
+      InnerWrite(kCompressedStreamIndex, compressed_end_, compressed, true));
+  framed_size_ += len;
+  compressed_end_ += compressed_size;
+  pending_data_.erase(0, len);
+  return true;
+}
+
+void CompressingEntry::AddHeaderWrite(int32 index_offset,
+                                      std::vector<InnerWrite>* writes) {
+  CompressedStreamHeader header;
+  header.frame_count = static_cast<uint32>(frames_.size());
+  header.data_size = data_size_;
+  header.index_offset = index_offset;
+  writes->push_back(InnerWrite(
+      kCompressedStreamIndex, 0,
+      std::string(reinterpret_cast<const char*>(&header), sizeof(header)),
+      false));
+}
+
+void CompressingEntry::AddPrefixWrite(std::vector<InnerWrite>* writes) {
+  CompressedEntryPrefix prefix;
+  if (compressed_flag_)
+    prefix.flags |= kCompressedEntryFlagStream1;
+  writes->push_back(InnerWrite(
+      kPrefixedStreamIndex, 0,
+      std::string(reinterpret_cast<const char*>(&prefix), sizeof(prefix)),
+      false));
+  has_prefix_ = true;
+}
+
+int CompressingEntry::IssueWrites(const std::vector<InnerWrite>& writes,
+                                  const CompletionCallback& callback,
+                                  int result) {
+  for (size_t i = 0; i < writes.size(); ++i) {
+    const bool last = i + 1 == writes.size();
+    const int len = static_cast<int>(writes[i].data.size());
+    scoped_refptr<net::StringIOBuffer> buffer(
+        new net::StringIOBuffer(writes[i].data));
+    const int rv = inner_entry_->WriteData(
+        writes[i].index, writes[i].offset, buffer.get(), len,
+        base::Bind(&CompressingEntry::OnInnerWriteComplete,
+                   weak_factory_.GetWeakPtr(), len,
+                   last ? callback : CompletionCallback(), result),
+        writes[i].truncate);
+    if (rv == net::ERR_IO_PENDING) {
+      if (last)
+        return rv;
+      continue;
+    }
+    if (rv != len) {
+      write_error_ = rv < 0 ? rv : net::ERR_CACHE_WRITE_FAILURE;
+      return write_error_;
+    }
+  }
+  return result;
+}
+
+void CompressingEntry::OnInnerWriteComplete(int expected,
+                                            const CompletionCallback& callback,
+                                            int result_on_success,
+                                            int result) {
+  if (result != expected && write_error_ == net::OK)
+    write_error_ = result < 0 ? result : net::ERR_CACHE_WRITE_FAILURE;
+  if (!callback.is_null())
+    callback.Run(write_error_ == net::OK ? result_on_success : write_error_);
+}
+
+void CompressingEntry::FlushCompressedStream() {
+  if (write_error_ != net::OK)
+    return;
+  std::vector<InnerWrite> writes;
+  if (!pending_data_.empty() &&
+      !AddFrame(static_cast<int>(pending_data_.size()), &writes)) {
+    return;
+  }
+  std::string index;
+  SerializeFrameIndex(frames_, &index);
+  writes.push_back(
+      InnerWrite(kCompressedStreamIndex, compressed_end_, index, true));
+  AddHeaderWrite(compressed_end_, &writes);
+  // The writes complete after this entry is gone; the wrapped entry is closed
+  // after them.
+  IssueWrites(writes, CompletionCallback(), net::OK);
+
+  const int32 stored_size = compressed_end_ + static_cast<int32>(index.size());
+  UMA_HISTOGRAM_PERCENTAGE(
+      "Net.DiskCache.Compression.StoredPercentage",
+      data_size_ ? static_cast<int>(std::min<int64>(
+                       100, 100LL * stored_size / data_size_))
+                 : 100);
+  UMA_HISTOGRAM_COUNTS("Net.DiskCache.Compression.KBSaved",
+                       std::max(0, data_size_ - stored_size) / 1024);
+  UMA_HISTOGRAM_TIMES("Net.DiskCache.Compression.CompressionTime",
+                      compression_time_);
+}
+
+CompressingCacheBackend::Stats::Stats()
+    : compressed_streams(0),
+      incompressible_streams(0),
+      bytes_in(0),
+      bytes_out(0) {
+}
+
+class CompressingCacheBackend::CompressingIterator : public Backend::Iterator {
+ public:
+  CompressingIterator(const base::WeakPtr<CompressingCacheBackend>& backend,
+                      scoped_ptr<Backend::Iterator> inner_iterator)
+      : backend_(backend), inner_iterator_(inner_iterator.Pass()) {}
+
+  int OpenNextEntry(Entry** next_entry,
+                    const CompletionCallback& callback) override {
+    if (!backend_)
+      return net::ERR_FAILED;
+    Entry** inner_entry = new Entry*(NULL);
+    const CompletionCallback on_complete =
+        base::Bind(&CompressingCacheBackend::OnInnerEntryOpened, backend_,
+                   base::Owned(inner_entry), next_entry, callback);
+    const int rv = inner_iterator_->OpenNextEntry(inner_entry, on_complete);
+    if (rv != net::OK)
+      return rv;
+    return backend_->WrapOpenedEntry(*inner_entry, next_entry, callback);
+  }
+
+ private:
+  base::WeakPtr<CompressingCacheBackend> backend_;
+  scoped_ptr<Backend::Iterator> inner_iterator_;
+};
+
+CompressingCacheBackend::CompressingCacheBackend(scoped_ptr<Backend> backend)
+    : backend_(backend.Pass()), weak_factory_(this) {
+}
+
+CompressingCacheBackend::~CompressingCacheBackend() {
+}
+
+net::CacheType CompressingCacheBackend::GetCacheType() const {
+  return backend_->GetCacheType();
+}
+
+int32 CompressingCacheBackend::GetEntryCount() const {
+  return backend_->GetEntryCount();
+}
+
+int CompressingCacheBackend::OpenEntry(const std::string& key,
+                                       Entry** entry,
+                                       const CompletionCallback& callback) {
+  Entry** inner_entry = new Entry*(NULL);
+  const CompletionCallback on_complete =
+      base::Bind(&CompressingCacheBackend::OnInnerEntryOpened,
+                 weak_factory_.GetWeakPtr(), base::Owned(inner_entry), entry,
+                 callback);
+  const int rv = backend_->OpenEntry(key, inner_entry, on_complete);
+  if (rv != net::OK)
+    return rv;
+  return WrapOpenedEntry(*inner_entry, entry, callback);
+}
+
+int CompressingCacheBackend::CreateEntry(const std::string& key,
+                                         Entry** entry,
+                                         const CompletionCallback& callback) {
+  Entry** inner_entry = new Entry*(NULL);
+  const CompletionCallback on_complete =
+      base::Bind(&CompressingCacheBackend::OnInnerEntryOpened,
+                 weak_factory_.GetWeakPtr(), base::Owned(inner_entry), entry,
+                 callback);
+  const int rv = backend_->CreateEntry(key, inner_entry, on_complete);
+  if (rv != net::OK)
+    return rv;
+  return WrapOpenedEntry(*inner_entry, entry, callback);
+}
+
+int CompressingCacheBackend::DoomEntry(const std::string& key,
+                                       const CompletionCallback& callback) {
+  return backend_->DoomEntry(key, callback);
+}
+
+int CompressingCacheBackend::DoomAllEntries(
+    const CompletionCallback& callback) {
+  return backend_->DoomAllEntries(callback);
+}
+
+int CompressingCacheBackend::DoomEntriesBetween(
+    base::Time initial_time,
+    base::Time end_time,
+    const CompletionCallback& callback) {
+  return backend_->DoomEntriesBetween(initial_time, end_time, callback);
+}
+
+int CompressingCacheBackend::DoomEntriesSince(
+    base::Time initial_time,
+    const CompletionCallback& callback) {
+  return backend_->DoomEntriesSince(initial_time, callback);
+}
+
+scoped_ptr<Backend::Iterator> CompressingCacheBackend::CreateIterator() {
+  return scoped_ptr<Backend::Iterator>(new CompressingIterator(
+      weak_factory_.GetWeakPtr(), backend_->CreateIterator()));
+}
+
+void CompressingCacheBackend::GetStats(
+    std::vector<std::pair<std::string, std::string> >* stats) {
+  backend_->GetStats(stats);
+  stats->push_back(std::make_pair(
+      "Compressed streams", base::IntToString(stats_.compressed_streams)));
+  stats->push_back(
+      std::make_pair("Incompressible streams",
+                     base::IntToString(stats_.incompressible_streams)));
+  stats->push_back(std::make_pair("Compressor bytes in",
+                                  base::Int64ToString(stats_.bytes_in)));
+  stats->push_back(std::make_pair("Compressor bytes out",
+                                  base::Int64ToString(stats_.bytes_out)));
+  stats->push_back(std::make_pair(
+      "Compression time (us)",
+      base::Int64ToString(stats_.compression_time.InMicroseconds())));
+  stats->push_back(std::make_pair(
+      "Decompression time (us)",
+      base::Int64ToString(stats_.decompression_time.InMicroseconds())));
+}
+
+void CompressingCacheBackend::OnExternalCacheHit(const std::string& key) {
+  backend_->OnExternalCacheHit(key);
+}
+
+int CompressingCacheBackend::WrapOpenedEntry(
+    Entry* inner_entry,
+    Entry** entry,
+    const CompletionCallback& callback) {
+  std::map<Entry*, CompressingEntry*>::iterator it =
+      open_entries_.find(inner_entry);
+  if (it != open_entries_.end())
+    return it->second->Open(entry, callback);
+
+  CompressingEntry* compressing_entry =
+      new CompressingEntry(weak_factory_.GetWeakPtr(), inner_entry);
+  open_entries_[inner_entry] = compressing_entry;
+  return compressing_entry->Load(entry, callback);
+}
+
+void CompressingCacheBackend::OnInnerEntryOpened(
+    Entry** inner_entry,
+    Entry** entry,
+    const CompletionCallback& callback,
+    int result) {
+  if (result == net::OK)
+    result = WrapOpenedEntry(*inner_entry, entry, callback);
+  if (result != net::ERR_IO_PENDING)
+    callback.Run(result);
+}
+
+void CompressingCacheBackend::OnEntryClosed(CompressingEntry* entry) {
+  open_entries_.erase(entry->inner_entry());
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,112 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_COMPRESSION_COMPRESSING_CACHE_BACKEND_H_
+#define NET_DISK_CACHE_COMPRESSION_COMPRESSING_CACHE_BACKEND_H_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace disk_cache {
+
+class CompressingEntry;
+
+// A Backend that forwards all operations to another Backend, and
+// transparently compresses stream 1 of the entries it returns, which holds
+// the bodies of the HTTP cache. See compressed_stream.h for the format.
+//
+// Whether a stream is compressed is decided by probing its first write; the
+// streams that do not compress well, and those of the entries written before
+// the backend was in place, are stored as is. Which way stream 1 is stored is
+// recorded in a prefix that this backend adds to stream 0 of the entries it
+// writes, and hides from its users. A compressed stream can be read at any
+// offset, but can only be written by appending to it, or by truncating it to
+// zero first; other writes fail with ERR_CACHE_OPERATION_NOT_SUPPORTED.
+//
+// The entries written through this backend can only be read through it: once
+// it is taken away, their stream 0 no longer parses, and the HTTP cache dooms
+// them.
+class NET_EXPORT_PRIVATE CompressingCacheBackend : public Backend {
+ public:
+  // Counters for the work done by the backend, reported by GetStats().
+  struct Stats {
+    Stats();
+
+    int compressed_streams;
+    int incompressible_streams;
+    // The bytes given to, and produced by, the compressor.
+    int64 bytes_in;
+    int64 bytes_out;
+    base::TimeDelta compression_time;
+    base::TimeDelta decompression_time;
+  };
+
+  explicit CompressingCacheBackend(scoped_ptr<Backend> backend);
+  ~CompressingCacheBackend() override;
+
+  const Stats& stats() const { return stats_; }
+
+  // Backend:
+  net::CacheType GetCacheType() const override;
+  int32 GetEntryCount() const override;
+  int OpenEntry(const std::string& key,
+                Entry** entry,
+                const CompletionCallback& callback) override;
+  int CreateEntry(const std::string& key,
+                  Entry** entry,
+                  const CompletionCallback& callback) override;
+  int DoomEntry(const std::string& key,
+                const CompletionCallback& callback) override;
+  int DoomAllEntries(const CompletionCallback& callback) override;
+  int DoomEntriesBetween(base::Time initial_time,
+                         base::Time end_time,
+                         const CompletionCallback& callback) override;
+  int DoomEntriesSince(base::Time initial_time,
+                       const CompletionCallback& callback) override;
+  scoped_ptr<Iterator> CreateIterator() override;
+  void GetStats(
+      std::vector<std::pair<std::string, std::string> >* stats) override;
+  void OnExternalCacheHit(const std::string& key) override;
+
+ private:
+  friend class CompressingEntry;
+  class CompressingIterator;
+
+  // Wraps the entry |inner_entry|, which was just opened, into |*entry|. The
+  // backends return the same object when an entry is opened more than once,
+  // and so does this one. Returns ERR_IO_PENDING if the streams of the entry
+  // must be read first, and runs |callback| when done.
+  int WrapOpenedEntry(Entry* inner_entry,
+                      Entry** entry,
+                      const CompletionCallback& callback);
+
+  void OnInnerEntryOpened(Entry** inner_entry,
+                          Entry** entry,
+                          const CompletionCallback& callback,
+                          int result);
+
+  // Called by the last Close() of |entry|.
+  void OnEntryClosed(CompressingEntry* entry);
+
+  scoped_ptr<Backend> backend_;
+  // The open entries, by the entries of |backend_| they wrap.
+  std::map<Entry*, CompressingEntry*> open_entries_;
+  Stats stats_;
+
+  base::WeakPtrFactory<CompressingCacheBackend> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompressingCacheBackend);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_COMPRESSION_COMPRESSING_CACHE_BACKEND_H_
@@ -0,0 +1,488 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/compression/compressing_cache_backend.h"
+
+#include <cstring>
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/thread.h"
+#include "net/base/cache_type.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/compression/compressed_stream.h"
+#include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+// Returns |len| bytes of text, which compresses well.
+std::string MakeCompressibleData(int len) {
+  std::string data;
+  for (int i = 0; static_cast<int>(data.size()) < len; ++i)
+    data += base::StringPrintf("Line %d of a cached response body. ", i);
+  data.resize(len);
+  return data;
+}
+
+// Returns |len| random bytes, which do not compress.
+std::string MakeIncompressibleData(int len) {
+  std::string data(len, 0);
+  CacheTestFillBuffer(&data[0], len, false);
+  return data;
+}
+
+class CompressingCacheBackendTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    scoped_ptr<Backend> inner_backend;
+    net::TestCompletionCallback cb;
+    int rv = CreateCacheBackend(net::MEMORY_CACHE, net::CACHE_BACKEND_DEFAULT,
+                                base::FilePath(), 0, false, NULL, NULL,
+                                &inner_backend, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+    inner_backend_ = inner_backend.get();
+    backend_.reset(new CompressingCacheBackend(inner_backend.Pass()));
+  }
+
+  void TearDown() override {
+    backend_.reset();
+  }
+
+  Entry* CreateEntry(Backend* backend, const std::string& key) {
+    net::TestCompletionCallback cb;
+    Entry* entry = NULL;
+    EXPECT_EQ(net::OK,
+              cb.GetResult(backend->CreateEntry(key, &entry, cb.callback())));
+    return entry;
+  }
+
+  Entry* OpenEntry(Backend* backend, const std::string& key) {
+    net::TestCompletionCallback cb;
+    Entry* entry = NULL;
+    EXPECT_EQ(net::OK,
+              cb.GetResult(backend->OpenEntry(key, &entry, cb.callback())));
+    return entry;
+  }
+
+  int WriteStream(Entry* entry,
+                  int index,
+                  int offset,
+                  const std::string& data,
+                  bool truncate) {
+    scoped_refptr<net::StringIOBuffer> buffer(new net::StringIOBuffer(data));
+    net::TestCompletionCallback cb;
+    return cb.GetResult(entry->WriteData(index, offset, buffer.get(),
+                                         static_cast<int>(data.size()),
+                                         cb.callback(), truncate));
+  }
+
+  int Write(Entry* entry, int offset, const std::string& data, bool truncate) {
+    return WriteStream(entry, 1, offset, data, truncate);
+  }
+
+  // Writes |data| to stream 1 of |entry| in pieces of |piece_size| bytes.
+  void WriteInPieces(Entry* entry, const std::string& data, int piece_size) {
+    for (size_t offset = 0; offset < data.size(); offset += piece_size) {
+      const std::string piece = data.substr(offset, piece_size);
+      EXPECT_EQ(static_cast<int>(piece.size()),
+                Write(entry, static_cast<int>(offset), piece, false));
+    }
+  }
+
+  // Reads |len| bytes at |offset| of stream |index| of |entry| into |data|,
+  // and returns the result of the read.
+  int ReadStream(Entry* entry,
+                 int index,
+                 int offset,
+                 int len,
+                 std::string* data) {
+    scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(len));
+    net::TestCompletionCallback cb;
+    const int rv = cb.GetResult(
+        entry->ReadData(index, offset, buffer.get(), len, cb.callback()));
+    if (rv > 0)
+      data->assign(buffer->data(), rv);
+    return rv;
+  }
+
+  int Read(Entry* entry, int offset, int len, std::string* data) {
+    return ReadStream(entry, 1, offset, len, data);
+  }
+
+  std::string ReadAllStream(Entry* entry, int index) {
+    std::string data;
+    const int size = entry->GetDataSize(index);
+    EXPECT_EQ(size, ReadStream(entry, index, 0, size, &data));
+    return data;
+  }
+
+  std::string ReadAll(Entry* entry) { return ReadAllStream(entry, 1); }
+
+  Backend* inner_backend_;
+  scoped_ptr<CompressingCacheBackend> backend_;
+};
+
+}  // namespace
+
+TEST(CompressedStreamTest, Probe) {
+  const std::string text = MakeCompressibleData(8192);
+  const std::string random = MakeIncompressibleData(8192);
+  EXPECT_TRUE(ProbeCompressibility(text.data(), 8192));
+  EXPECT_FALSE(ProbeCompressibility(random.data(), 8192));
+  // Too little data to be worth it.
+  EXPECT_FALSE(ProbeCompressibility(text.data(), 100));
+}
+
+TEST(CompressedStreamTest, FrameIndex) {
+  std::vector<CompressedFrame> frames;
+  frames.push_back(CompressedFrame(100, kCompressedFrameSize));
+  frames.push_back(CompressedFrame(50, 10));
+  CompressedStreamHeader header;
+  header.frame_count = 2;
+  header.data_size = kCompressedFrameSize + 10;
+  header.index_offset = kCompressedStreamHeaderSize + 150;
+
+  std::string index;
+  SerializeFrameIndex(frames, &index);
+  std::vector<CompressedFrame> read_frames;
+  ASSERT_TRUE(DeserializeFrameIndex(header, index.data(),
+                                    static_cast<int>(index.size()),
+                                    &read_frames));
+  ASSERT_EQ(2U, read_frames.size());
+  EXPECT_EQ(50, read_frames[1].compressed_size);
+  EXPECT_EQ(10, read_frames[1].data_size);
+
+  // The frames must add up to the header.
+  header.data_size++;
+  EXPECT_FALSE(DeserializeFrameIndex(header, index.data(),
+                                     static_cast<int>(index.size()),
+                                     &read_frames));
+  header.data_size--;
+  header.frame_count = 1000;
+  EXPECT_FALSE(DeserializeFrameIndex(header, index.data(),
+                                     static_cast<int>(index.size()),
+                                     &read_frames));
+  header.frame_count = 2;
+  EXPECT_FALSE(DeserializeFrameIndex(header, index.data(),
+                                     static_cast<int>(index.size()) - 1,
+                                     &read_frames));
+}
+
+TEST_F(CompressingCacheBackendTest, CompressibleStream) {
+  const int kSize = 3 * kCompressedFrameSize + 1000;
+  const std::string data = MakeCompressibleData(kSize);
+  Entry* entry = CreateEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  WriteInPieces(entry, data, 10000);
+  EXPECT_EQ(kSize, entry->GetDataSize(1));
+  // The data that is not written out yet can be read already.
+  EXPECT_EQ(data, ReadAll(entry));
+  entry->Close();
+
+  Entry* inner_entry = OpenEntry(inner_backend_, "key");
+  ASSERT_TRUE(inner_entry);
+  EXPECT_LT(inner_entry->GetDataSize(1), kSize / 4);
+  inner_entry->Close();
+
+  entry = OpenEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(kSize, entry->GetDataSize(1));
+  EXPECT_EQ(data, ReadAll(entry));
+
+  // Reads across frames, and past the end.
+  std::string range;
+  EXPECT_EQ(300, Read(entry, kCompressedFrameSize - 100, 300, &range));
+  EXPECT_EQ(data.substr(kCompressedFrameSize - 100, 300), range);
+  EXPECT_EQ(500, Read(entry, kSize - 500, 1000, &range));
+  EXPECT_EQ(data.substr(kSize - 500), range);
+  EXPECT_EQ(0, Read(entry, kSize, 10, &range));
+  entry->Close();
+
+  EXPECT_EQ(1, backend_->stats().compressed_streams);
+  EXPECT_EQ(kSize, backend_->stats().bytes_in);
+  EXPECT_GT(backend_->stats().bytes_in, 4 * backend_->stats().bytes_out);
+}
+
+TEST_F(CompressingCacheBackendTest, IncompressibleStream) {
+  const int kSize = 50000;
+  const std::string data = MakeIncompressibleData(kSize);
+  Entry* entry = CreateEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  WriteInPieces(entry, data, 10000);
+  // Writes in the middle of the stream are fine.
+  EXPECT_EQ(10, Write(entry, 100, data.substr(100, 10), false));
+  entry->Close();
+
+  // The data is stored as is.
+  Entry* inner_entry = OpenEntry(inner_backend_, "key");
+  ASSERT_TRUE(inner_entry);
+  EXPECT_EQ(data, ReadAll(inner_entry));
+  inner_entry->Close();
+
+  entry = OpenEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(data, ReadAll(entry));
+  entry->Close();
+  EXPECT_EQ(1, backend_->stats().incompressible_streams);
+}
+
+// Tests that an entry that was written before compression was in place is
+// read as is.
+TEST_F(CompressingCacheBackendTest, UncompressedEntry) {
+  const std::string data = MakeCompressibleData(5000);
+  Entry* inner_entry = CreateEntry(inner_backend_, "key");
+  ASSERT_TRUE(inner_entry);
+  EXPECT_EQ(5000, Write(inner_entry, 0, data, false));
+  inner_entry->Close();
+
+  Entry* entry = OpenEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(5000, entry->GetDataSize(1));
+  EXPECT_EQ(data, ReadAll(entry));
+  entry->Close();
+}
+
+TEST_F(CompressingCacheBackendTest, AppendAfterReopen) {
+  const int kSize = 5 * kCompressedFrameSize / 2;
+  const std::string data = MakeCompressibleData(2 * kSize);
+  Entry* entry = CreateEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(kSize, Write(entry, 0, data.substr(0, kSize), false));
+  entry->Close();
+
+  entry = OpenEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(kSize, Write(entry, kSize, data.substr(kSize), false));
+  EXPECT_EQ(data, ReadAll(entry));
+  entry->Close();
+
+  entry = OpenEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(2 * kSize, entry->GetDataSize(1));
+  EXPECT_EQ(data, ReadAll(entry));
+  entry->Close();
+}
+
+TEST_F(CompressingCacheBackendTest, RewriteCompressedStream) {
+  const std::string data = MakeCompressibleData(50000);
+  Entry* entry = CreateEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(50000, Write(entry, 0, data, false));
+  EXPECT_EQ(net::ERR_CACHE_OPERATION_NOT_SUPPORTED,
+            Write(entry, 100, data.substr(0, 10), false));
+
+  // Truncating the stream starts it over, possibly uncompressed.
+  const std::string random = MakeIncompressibleData(20000);
+  EXPECT_EQ(20000, Write(entry, 0, random, true));
+  EXPECT_EQ(20000, entry->GetDataSize(1));
+  EXPECT_EQ(random, ReadAll(entry));
+  entry->Close();
+
+  entry = OpenEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(random, ReadAll(entry));
+  EXPECT_EQ(0, Write(entry, 0, std::string(), true));
+  EXPECT_EQ(0, entry->GetDataSize(1));
+  EXPECT_EQ(50000, Write(entry, 0, data, false));
+  entry->Close();
+
+  entry = OpenEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(data, ReadAll(entry));
+  entry->Close();
+}
+
+// Tests that a compressed stream that was not completed cannot be read.
+TEST_F(CompressingCacheBackendTest, CorruptStream) {
+  const std::string data = MakeCompressibleData(50000);
+  Entry* entry = CreateEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(50000, Write(entry, 0, data, false));
+  entry->Close();
+
+  Entry* inner_entry = OpenEntry(inner_backend_, "key");
+  ASSERT_TRUE(inner_entry);
+  const int size = inner_entry->GetDataSize(1);
+  EXPECT_EQ(0, Write(inner_entry, size - 1, std::string(), true));
+  inner_entry->Close();
+
+  entry = OpenEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(50000, entry->GetDataSize(1));
+  std::string read;
+  EXPECT_EQ(net::ERR_CACHE_READ_FAILURE, Read(entry, 0, 100, &read));
+  entry->Close();
+}
+
+// Tests that opening an entry twice returns the same object, which sees the
+// data not written out yet.
+TEST_F(CompressingCacheBackendTest, OpenTwice) {
+  const std::string data = MakeCompressibleData(40000);
+  Entry* entry1 = CreateEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry1);
+  EXPECT_EQ(40000, Write(entry1, 0, data, false));
+  Entry* entry2 = OpenEntry(backend_.get(), "key");
+  EXPECT_EQ(entry1, entry2);
+  entry1->Close();
+  EXPECT_EQ(data, ReadAll(entry2));
+  entry2->Close();
+}
+
+// Tests that stream 0 is read back as written, and that the prefix that flags
+// stream 1 is kept in front of it.
+TEST_F(CompressingCacheBackendTest, PrefixedStream) {
+  const std::string info = "response info";
+  const std::string data = MakeCompressibleData(50000);
+  Entry* entry = CreateEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(50000, Write(entry, 0, data, false));
+  EXPECT_EQ(static_cast<int>(info.size()),
+            WriteStream(entry, 0, 0, info, true));
+  EXPECT_EQ(info, ReadAllStream(entry, 0));
+  entry->Close();
+
+  Entry* inner_entry = OpenEntry(inner_backend_, "key");
+  ASSERT_TRUE(inner_entry);
+  EXPECT_EQ(kCompressedEntryPrefixSize + static_cast<int>(info.size()),
+            inner_entry->GetDataSize(0));
+  std::string prefix;
+  EXPECT_EQ(kCompressedEntryPrefixSize,
+            ReadStream(inner_entry, 0, 0, kCompressedEntryPrefixSize, &prefix));
+  CompressedEntryPrefix expected;
+  expected.flags = kCompressedEntryFlagStream1;
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(&expected),
+                        sizeof(expected)),
+            prefix);
+  inner_entry->Close();
+
+  // Rewriting stream 0 keeps the prefix.
+  entry = OpenEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(static_cast<int>(info.size()), entry->GetDataSize(0));
+  EXPECT_EQ(4, WriteStream(entry, 0, 0, "info", true));
+  EXPECT_EQ("info", ReadAllStream(entry, 0));
+  EXPECT_EQ(data, ReadAll(entry));
+  entry->Close();
+}
+
+// Tests that a stream is only read as compressed if its entry says so, even if
+// it starts with a valid header.
+TEST_F(CompressingCacheBackendTest, StreamThatLooksCompressed) {
+  CompressedStreamHeader header;
+  header.index_offset = kCompressedStreamHeaderSize;
+  const std::string data =
+      std::string(reinterpret_cast<const char*>(&header), sizeof(header)) +
+      MakeIncompressibleData(5000);
+  const int size = static_cast<int>(data.size());
+
+  Entry* inner_entry = CreateEntry(inner_backend_, "old key");
+  ASSERT_TRUE(inner_entry);
+  EXPECT_EQ(size, Write(inner_entry, 0, data, false));
+  inner_entry->Close();
+  Entry* entry = CreateEntry(backend_.get(), "new key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(4, WriteStream(entry, 0, 0, "info", true));
+  EXPECT_EQ(size, Write(entry, 0, data, false));
+  entry->Close();
+
+  entry = OpenEntry(backend_.get(), "old key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(data, ReadAll(entry));
+  entry->Close();
+  entry = OpenEntry(backend_.get(), "new key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(data, ReadAll(entry));
+  entry->Close();
+}
+
+// Tests that a stream compressed earlier is unflagged when it is rewritten as
+// is, so that it is not read as compressed once the entry is reopened.
+TEST_F(CompressingCacheBackendTest, UnflagRewrittenStream) {
+  const std::string data = MakeCompressibleData(50000);
+  Entry* entry = CreateEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(4, WriteStream(entry, 0, 0, "info", true));
+  EXPECT_EQ(50000, Write(entry, 0, data, false));
+  entry->Close();
+
+  entry = OpenEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  const std::string random = MakeIncompressibleData(20000);
+  EXPECT_EQ(20000, Write(entry, 0, random, true));
+  entry->Close();
+
+  Entry* inner_entry = OpenEntry(inner_backend_, "key");
+  ASSERT_TRUE(inner_entry);
+  EXPECT_EQ(random, ReadAll(inner_entry));
+  inner_entry->Close();
+
+  entry = OpenEntry(backend_.get(), "key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ("info", ReadAllStream(entry, 0));
+  EXPECT_EQ(random, ReadAll(entry));
+  entry->Close();
+}
+
+// Tests that the compressed streams are read back by a new backend, and that
+// the entries are not mistaken for those of the HTTP cache without it.
+TEST_F(CompressingCacheBackendTest, SimpleBackend) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+      base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+
+  const std::string info = "response info";
+  const std::string data = MakeCompressibleData(3 * kCompressedFrameSize);
+  for (int i = 0; i < 2; ++i) {
+    scoped_ptr<SimpleBackendImpl> simple_backend(new SimpleBackendImpl(
+        cache_dir.path(), 0, net::DISK_CACHE, cache_thread.task_runner(),
+        NULL));
+    net::TestCompletionCallback cb;
+    ASSERT_EQ(net::OK, cb.GetResult(simple_backend->Init(cb.callback())));
+    Backend* inner_backend = simple_backend.get();
+    CompressingCacheBackend backend(simple_backend.Pass());
+
+    Entry* entry =
+        i ? OpenEntry(&backend, "key") : CreateEntry(&backend, "key");
+    ASSERT_TRUE(entry);
+    if (!i) {
+      EXPECT_EQ(static_cast<int>(info.size()),
+                WriteStream(entry, 0, 0, info, true));
+      WriteInPieces(entry, data, 16384);
+    }
+    EXPECT_EQ(info, ReadAllStream(entry, 0));
+    EXPECT_EQ(data, ReadAll(entry));
+    entry->Close();
+
+    if (i) {
+      // Stream 0 does not start with a Pickle header: its first word is
+      // larger than any payload size.
+      Entry* inner_entry = OpenEntry(inner_backend, "key");
+      ASSERT_TRUE(inner_entry);
+      std::string prefix;
+      EXPECT_EQ(kCompressedEntryPrefixSize,
+                ReadStream(inner_entry, 0, 0, kCompressedEntryPrefixSize,
+                           &prefix));
+      uint32 first_word = 0;
+      memcpy(&first_word, prefix.data(), sizeof(first_word));
+      EXPECT_GT(first_word, static_cast<uint32>(kint32max));
+      inner_entry->Close();
+    }
+    base::MessageLoop::current()->RunUntilIdle();
+    SimpleBackendImpl::FlushWorkerPoolForTesting();
+    base::MessageLoop::current()->RunUntilIdle();
+  }
+}
+
+}  // namespace disk_cache
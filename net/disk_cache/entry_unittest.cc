@@ -1733,6 +1733,118 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyHugeSparseIO) {
   HugeSparseIO();
 }
 
+// Tests sparse IO that is issued to several children at the same time.
+TEST_F(DiskCacheEntryTest, ParallelSparseIO) {
+  InitCache();
+  cache_impl_->SetSparseIODepth(3);
+  std::string key("the first key");
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+
+  // Cover 6 children, with partial ones at both ends.
+  const int k1Meg = 1024 * 1024;
+  const int kSize = 5 * k1Meg;
+  scoped_refptr<net::IOBuffer> buf_1(new net::IOBuffer(kSize));
+  scoped_refptr<net::IOBuffer> buf_2(new net::IOBuffer(kSize + 2 * k1Meg));
+  CacheTestFillBuffer(buf_1->data(), kSize, false);
+
+  VerifySparseIO(entry, k1Meg - 4096, buf_1.get(), kSize, buf_2.get());
+  entry->Close();
+
+  ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+  VerifyContentSparseIO(entry, k1Meg - 4096, buf_1->data(), kSize);
+
+  // Fill the last child and write past the next one. A read stops at the
+  // first missing child, even if the data after it is there.
+  EXPECT_EQ(4096, WriteSparseData(entry, 6 * k1Meg - 4096, buf_1.get(), 4096));
+  EXPECT_EQ(k1Meg, WriteSparseData(entry, 7 * k1Meg, buf_1.get(), k1Meg));
+  EXPECT_EQ(kSize + 4096, ReadSparseData(entry, k1Meg - 4096, buf_2.get(),
+                                         kSize + 2 * k1Meg));
+  EXPECT_EQ(0, memcmp(buf_2->data(), buf_1->data(), kSize));
+  entry->Close();
+}
+
+// Tests that GetAvailableRange works the same way with and without what the
+// parent knows about its children.
+TEST_F(DiskCacheEntryTest, SparseRangeAcrossChildren) {
+  InitCache();
+  std::string key("the first key");
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+
+  const int k1Meg = 1024 * 1024;
+  const int kSize = 8 * 1024;
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buf->data(), kSize, false);
+
+  EXPECT_EQ(kSize, WriteSparseData(entry, k1Meg + 1024, buf.get(), kSize));
+  EXPECT_EQ(kSize, WriteSparseData(entry, 3 * k1Meg - 1024, buf.get(), kSize));
+
+  for (int i = 0; i < 3; i++) {
+    // The first pass uses the children written above, the second one opens
+    // them again and the last one works from what the second one learned.
+    if (i == 1) {
+      entry->Close();
+      ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+    }
+    int64 start;
+    net::TestCompletionCallback cb;
+    int rv = entry->GetAvailableRange(0, 4 * k1Meg, &start, cb.callback());
+    EXPECT_EQ(kSize, cb.GetResult(rv));
+    EXPECT_EQ(k1Meg + 1024, start);
+
+    // The range found doesn't go past the end of the child.
+    rv = entry->GetAvailableRange(2 * k1Meg, 2 * k1Meg, &start, cb.callback());
+    EXPECT_EQ(1024, cb.GetResult(rv));
+    EXPECT_EQ(3 * k1Meg - 1024, start);
+
+    rv = entry->GetAvailableRange(k1Meg + 2048, kSize, &start, cb.callback());
+    EXPECT_EQ(kSize - 1024, cb.GetResult(rv));
+    EXPECT_EQ(k1Meg + 2048, start);
+  }
+  entry->Close();
+}
+
+// Tests that GetAvailableRange doesn't report the data of children that are
+// gone, even if the parent knew about them.
+TEST_F(DiskCacheEntryTest, SparseRangeOfRemovedChildren) {
+  InitCache();
+  std::string key("the first key");
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+
+  const int k1Meg = 1024 * 1024;
+  const int kSize = 8 * 1024;
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buf->data(), kSize, false);
+
+  EXPECT_EQ(kSize, WriteSparseData(entry, k1Meg + 1024, buf.get(), kSize));
+  EXPECT_EQ(kSize, WriteSparseData(entry, 3 * k1Meg - 1024, buf.get(), kSize));
+  int64 start;
+  net::TestCompletionCallback cb;
+  int rv = entry->GetAvailableRange(0, 4 * k1Meg, &start, cb.callback());
+  EXPECT_EQ(kSize, cb.GetResult(rv));
+  EXPECT_EQ(k1Meg + 1024, start);
+
+  // Remove the children while the parent is still open, as eviction would.
+  std::vector<std::string> child_keys;
+  scoped_ptr<TestIterator> iter = CreateIterator();
+  disk_cache::Entry* child;
+  while (iter->OpenNextEntry(&child) == net::OK) {
+    if (child->GetKey() != key)
+      child_keys.push_back(child->GetKey());
+    child->Close();
+  }
+  iter.reset();
+  ASSERT_EQ(2U, child_keys.size());
+  for (size_t i = 0; i < child_keys.size(); i++)
+    EXPECT_EQ(net::OK, DoomEntry(child_keys[i]));
+
+  rv = entry->GetAvailableRange(0, 4 * k1Meg, &start, cb.callback());
+  EXPECT_EQ(0, cb.GetResult(rv));
+  entry->Close();
+}
+
 void DiskCacheEntryTest::GetAvailableRange() {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -4,6 +4,7 @@
 
 #include "net/disk_cache/memory/mem_backend_impl.h"
 
+#include "base/hash.h"
 #include "base/logging.h"
 #include "base/sys_info.h"
 #include "net/base/net_errors.h"
@@ -28,15 +29,25 @@ int LowWaterAdjust(int high_water) {
 
 namespace disk_cache {
 
+MemBackendImpl::Shard::Shard() {
+}
+
+MemBackendImpl::Shard::~Shard() {
+}
+
 MemBackendImpl::MemBackendImpl(net::NetLog* net_log)
     : max_size_(0), current_size_(0), net_log_(net_log), weak_factory_(this) {
 }
 
 MemBackendImpl::~MemBackendImpl() {
-  EntryMap::iterator it = entries_.begin();
-  while (it != entries_.end()) {
-    it->second->Doom();
-    it = entries_.begin();
+  for (int i = 0; i < kNumShards; ++i) {
+    base::AutoLock lock(shards_[i].lock);
+    EntryMap& entries = shards_[i].entries;
+    EntryMap::iterator it = entries.begin();
+    while (it != entries.end()) {
+      it->second->DoomLocked();
+      it = entries.begin();
+    }
   }
   DCHECK(!current_size_);
 }
@@ -92,10 +103,12 @@ void MemBackendImpl::InternalDoomEntry(MemEntryImpl* entry) {
   // Only parent entries can be passed into this method.
   DCHECK(entry->type() == MemEntryImpl::kParentEntry);
 
-  rankings_.Remove(entry);
-  EntryMap::iterator it = entries_.find(entry->GetKey());
-  if (it != entries_.end())
-    entries_.erase(it);
+  Shard* shard = entry->shard();
+  shard->lock.AssertAcquired();
+  shard->rankings.Remove(entry);
+  EntryMap::iterator it = shard->entries.find(entry->GetKey());
+  if (it != shard->entries.end())
+    shard->entries.erase(it);
   else
     NOTREACHED();
 
@@ -103,7 +116,8 @@ void MemBackendImpl::InternalDoomEntry(MemEntryImpl* entry) {
 }
 
 void MemBackendImpl::UpdateRank(MemEntryImpl* node) {
-  rankings_.UpdateRank(node);
+  node->shard()->lock.AssertAcquired();
+  node->shard()->rankings.UpdateRank(node);
 }
 
 void MemBackendImpl::ModifyStorageSize(int32 old_size, int32 new_size) {
@@ -113,16 +127,23 @@ void MemBackendImpl::ModifyStorageSize(int32 old_size, int32 new_size) {
     AddStorageSize(new_size - old_size);
 }
 
+void MemBackendImpl::TrimCacheIfNeeded() {
+  if (base::subtle::NoBarrier_Load(&current_size_) > max_size_)
+    TrimCache(false);
+}
+
 int MemBackendImpl::MaxFileSize() const {
   return max_size_ / 8;
 }
 
 void MemBackendImpl::InsertIntoRankingList(MemEntryImpl* entry) {
-  rankings_.Insert(entry);
+  entry->shard()->lock.AssertAcquired();
+  entry->shard()->rankings.Insert(entry);
 }
 
 void MemBackendImpl::RemoveFromRankingList(MemEntryImpl* entry) {
-  rankings_.Remove(entry);
+  entry->shard()->lock.AssertAcquired();
+  entry->shard()->rankings.Remove(entry);
 }
 
 net::CacheType MemBackendImpl::GetCacheType() const {
@@ -130,7 +151,12 @@ net::CacheType MemBackendImpl::GetCacheType() const {
 }
 
 int32 MemBackendImpl::GetEntryCount() const {
-  return static_cast<int32>(entries_.size());
+  size_t count = 0;
+  for (int i = 0; i < kNumShards; ++i) {
+    base::AutoLock lock(shards_[i].lock);
+    count += shards_[i].entries.size();
+  }
+  return static_cast<int32>(count);
 }
 
 int MemBackendImpl::OpenEntry(const std::string& key, Entry** entry,
@@ -184,7 +210,7 @@ int MemBackendImpl::DoomEntriesSince(const base::Time initial_time,
 class MemBackendImpl::MemIterator : public Backend::Iterator {
  public:
   explicit MemIterator(base::WeakPtr<MemBackendImpl> backend)
-      : backend_(backend), current_(NULL) {
+      : backend_(backend), shard_index_(0), current_(NULL) {
   }
 
   int OpenNextEntry(Entry** next_entry,
@@ -192,23 +218,31 @@ class MemBackendImpl::MemIterator : public Backend::Iterator {
     if (!backend_)
       return net::ERR_FAILED;
 
-    MemEntryImpl* node = backend_->rankings_.GetNext(current_);
-    // We should never return a child entry so iterate until we hit a parent
-    // entry.
-    while (node && node->type() != MemEntryImpl::kParentEntry)
-      node = backend_->rankings_.GetNext(node);
-    *next_entry = node;
-    current_ = node;
-
-    if (node) {
-      node->Open();
-      return net::OK;
+    // The shards are enumerated one after the other, each of them from its
+    // most recently used entry.
+    for (; shard_index_ < kNumShards; ++shard_index_) {
+      Shard* shard = &backend_->shards_[shard_index_];
+      base::AutoLock lock(shard->lock);
+      MemEntryImpl* node = shard->rankings.GetNext(current_);
+      // We should never return a child entry so iterate until we hit a parent
+      // entry.
+      while (node && node->type() != MemEntryImpl::kParentEntry)
+        node = shard->rankings.GetNext(node);
+      current_ = node;
+
+      if (node) {
+        node->Open();
+        *next_entry = node;
+        return net::OK;
+      }
     }
+    *next_entry = NULL;
     return net::ERR_FAILED;
   }
 
  private:
   base::WeakPtr<MemBackendImpl> backend_;
+  int shard_index_;
   MemEntryImpl* current_;
 };
 
@@ -218,15 +252,23 @@ scoped_ptr<Backend::Iterator> MemBackendImpl::CreateIterator() {
 }
 
 void MemBackendImpl::OnExternalCacheHit(const std::string& key) {
-  EntryMap::iterator it = entries_.find(key);
-  if (it != entries_.end()) {
+  Shard* shard = GetShard(key);
+  base::AutoLock lock(shard->lock);
+  EntryMap::iterator it = shard->entries.find(key);
+  if (it != shard->entries.end()) {
     UpdateRank(it->second);
   }
 }
 
+MemBackendImpl::Shard* MemBackendImpl::GetShard(const std::string& key) {
+  return &shards_[base::Hash(key) % kNumShards];
+}
+
 bool MemBackendImpl::OpenEntry(const std::string& key, Entry** entry) {
-  EntryMap::iterator it = entries_.find(key);
-  if (it == entries_.end())
+  Shard* shard = GetShard(key);
+  base::AutoLock lock(shard->lock);
+  EntryMap::iterator it = shard->entries.find(key);
+  if (it == shard->entries.end())
     return false;
 
   it->second->Open();
@@ -236,30 +278,36 @@ bool MemBackendImpl::OpenEntry(const std::string& key, Entry** entry) {
 }
 
 bool MemBackendImpl::CreateEntry(const std::string& key, Entry** entry) {
-  EntryMap::iterator it = entries_.find(key);
-  if (it != entries_.end())
-    return false;
-
-  MemEntryImpl* cache_entry = new MemEntryImpl(this);
-  if (!cache_entry->CreateEntry(key, net_log_)) {
-    delete entry;
-    return false;
-  }
+  Shard* shard = GetShard(key);
+  {
+    base::AutoLock lock(shard->lock);
+    EntryMap::iterator it = shard->entries.find(key);
+    if (it != shard->entries.end())
+      return false;
+
+    MemEntryImpl* cache_entry = new MemEntryImpl(this, shard);
+    if (!cache_entry->CreateEntry(key, net_log_)) {
+      delete entry;
+      return false;
+    }
 
-  rankings_.Insert(cache_entry);
-  entries_[key] = cache_entry;
+    shard->rankings.Insert(cache_entry);
+    shard->entries[key] = cache_entry;
 
-  *entry = cache_entry;
+    *entry = cache_entry;
+  }
+  TrimCacheIfNeeded();
   return true;
 }
 
 bool MemBackendImpl::DoomEntry(const std::string& key) {
-  Entry* entry;
-  if (!OpenEntry(key, &entry))
+  Shard* shard = GetShard(key);
+  base::AutoLock lock(shard->lock);
+  EntryMap::iterator it = shard->entries.find(key);
+  if (it == shard->entries.end())
     return false;
 
-  entry->Doom();
-  entry->Close();
+  it->second->DoomLocked();
   return true;
 }
 
@@ -270,12 +318,57 @@ bool MemBackendImpl::DoomAllEntries() {
 
 bool MemBackendImpl::DoomEntriesBetween(const Time initial_time,
                                         const Time end_time) {
-  if (end_time.is_null())
-    return DoomEntriesSince(initial_time);
+  DCHECK(end_time.is_null() || end_time >= initial_time);
+
+  for (int i = 0; i < kNumShards; ++i)
+    DoomShardEntriesBetween(&shards_[i], initial_time, end_time);
+  return true;
+}
+
+bool MemBackendImpl::DoomEntriesSince(const Time initial_time) {
+  return DoomEntriesBetween(initial_time, Time());
+}
 
-  DCHECK(end_time >= initial_time);
+void MemBackendImpl::TrimCache(bool empty) {
+  if (empty) {
+    for (int i = 0; i < kNumShards; ++i) {
+      base::AutoLock lock(shards_[i].lock);
+      while (MemEntryImpl* node = shards_[i].rankings.GetPrev(NULL))
+        node->DoomLocked();
+    }
+    return;
+  }
+
+  int target_size = LowWaterAdjust(max_size_);
+  while (base::subtle::NoBarrier_Load(&current_size_) > target_size) {
+    // Look for the shard with the least recently used entry. The shards are
+    // locked one at a time, so the choice may be stale by the time the entry
+    // is evicted, which only makes the eviction order approximate.
+    Shard* oldest_shard = NULL;
+    Time oldest_time;
+    for (int i = 0; i < kNumShards; ++i) {
+      base::AutoLock lock(shards_[i].lock);
+      MemEntryImpl* node = GetEvictionCandidate(&shards_[i]);
+      if (node && (!oldest_shard || node->last_used() < oldest_time)) {
+        oldest_shard = &shards_[i];
+        oldest_time = node->last_used();
+      }
+    }
+    if (!oldest_shard)
+      return;
 
-  MemEntryImpl* node = rankings_.GetNext(NULL);
+    base::AutoLock lock(oldest_shard->lock);
+    MemEntryImpl* node = GetEvictionCandidate(oldest_shard);
+    if (node)
+      node->DoomLocked();
+  }
+}
+
+void MemBackendImpl::DoomShardEntriesBetween(Shard* shard,
+                                             const Time initial_time,
+                                             const Time end_time) {
+  base::AutoLock lock(shard->lock);
+  MemEntryImpl* node = shard->rankings.GetNext(NULL);
   // Last valid entry before |node|.
   // Note, that entries after |node| may become invalid during |node| doom in
   // case when they are child entries of it. It is guaranteed that
@@ -283,63 +376,39 @@ bool MemBackendImpl::DoomEntriesBetween(const Time initial_time,
   // InternalReadSparseData and InternalWriteSparseData).
   MemEntryImpl* last_valid = NULL;
 
-  // rankings_ is ordered by last used, this will descend through the cache
+  // The rankings are ordered by last used, this will descend through the shard
   // and start dooming items before the end_time, and will stop once it reaches
   // an item used before the initial time.
   while (node) {
-    if (node->GetLastUsed() < initial_time)
+    if (node->last_used() < initial_time)
       break;
 
-    if (node->GetLastUsed() < end_time)
-      node->Doom();
+    if (end_time.is_null() || node->last_used() < end_time)
+      node->DoomLocked();
     else
       last_valid = node;
-    node = rankings_.GetNext(last_valid);
+    node = shard->rankings.GetNext(last_valid);
   }
-
-  return true;
 }
 
-bool MemBackendImpl::DoomEntriesSince(const Time initial_time) {
-  for (;;) {
-    // Get the entry in the front.
-    Entry* entry = rankings_.GetNext(NULL);
-
-    // Break the loop when there are no more entries or the entry is too old.
-    if (!entry || entry->GetLastUsed() < initial_time)
-      return true;
-    entry->Doom();
-  }
-}
-
-void MemBackendImpl::TrimCache(bool empty) {
-  MemEntryImpl* next = rankings_.GetPrev(NULL);
-  if (!next)
-    return;
-
-  int target_size = empty ? 0 : LowWaterAdjust(max_size_);
-  while (current_size_ > target_size && next) {
-    MemEntryImpl* node = next;
-    next = rankings_.GetPrev(next);
-    if (!node->InUse() || empty) {
-      node->Doom();
-    }
-  }
-
-  return;
+MemEntryImpl* MemBackendImpl::GetEvictionCandidate(Shard* shard) {
+  shard->lock.AssertAcquired();
+  MemEntryImpl* node = shard->rankings.GetPrev(NULL);
+  while (node && node->InUse())
+    node = shard->rankings.GetPrev(node);
+  return node;
 }
 
 void MemBackendImpl::AddStorageSize(int32 bytes) {
-  current_size_ += bytes;
-  DCHECK_GE(current_size_, 0);
-
-  if (current_size_ > max_size_)
-    TrimCache(false);
+  base::subtle::Atomic32 size =
+      base::subtle::NoBarrier_AtomicIncrement(&current_size_, bytes);
+  DCHECK_GE(size, 0);
 }
 
 void MemBackendImpl::SubstractStorageSize(int32 bytes) {
-  current_size_ -= bytes;
-  DCHECK_GE(current_size_, 0);
+  base::subtle::Atomic32 size =
+      base::subtle::NoBarrier_AtomicIncrement(&current_size_, -bytes);
+  DCHECK_GE(size, 0);
 }
 
 }  // namespace disk_cache
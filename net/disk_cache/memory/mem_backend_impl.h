@@ -7,11 +7,14 @@
 #ifndef NET_DISK_CACHE_MEMORY_MEM_BACKEND_IMPL_H_
 #define NET_DISK_CACHE_MEMORY_MEM_BACKEND_IMPL_H_
 
+#include "base/atomicops.h"
 #include "base/compiler_specific.h"
 #include "base/containers/hash_tables.h"
 #include "base/memory/weak_ptr.h"
+#include "base/synchronization/lock.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/memory/mem_rankings.h"
+#include "net/disk_cache/memory/mem_slab_allocator.h"
 
 namespace net {
 class NetLog;
@@ -23,8 +26,30 @@ class MemEntryImpl;
 
 // This class implements the Backend interface. An object of this class handles
 // the operations of the cache without writing to disk.
+//
+// The entries are spread over kNumShards shards by the hash of their key, and
+// each shard has its own lock, so the backend and its entries can be used from
+// several threads at the same time. The size limit applies to the whole cache:
+// the least recently used entries of all the shards are evicted first. An
+// iterator must stay on the thread that created it.
 class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
  public:
+  // A slice of the cache. The children of a sparse entry go to the shard of
+  // their parent. |lock| protects everything in the shard, including the data
+  // of its entries, which is allocated from |allocator|.
+  struct Shard {
+    Shard();
+    ~Shard();
+
+    mutable base::Lock lock;
+    base::hash_map<std::string, MemEntryImpl*> entries;
+    MemRankings rankings;  // Rankings to be able to trim the cache.
+    MemSlabAllocator allocator;
+
+   private:
+    DISALLOW_COPY_AND_ASSIGN(Shard);
+  };
+
   explicit MemBackendImpl(net::NetLog* net_log);
   ~MemBackendImpl() override;
 
@@ -41,25 +66,33 @@ class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
   // Sets the maximum size for the total amount of data stored by this instance.
   bool SetMaxSize(int max_bytes);
 
-  // Permanently deletes an entry.
+  // Permanently deletes an entry. The lock of the entry's shard must be held.
   void InternalDoomEntry(MemEntryImpl* entry);
 
-  // Updates the ranking information for an entry.
+  // Updates the ranking information for an entry. The lock of the entry's
+  // shard must be held.
   void UpdateRank(MemEntryImpl* node);
 
-  // A user data block is being created, extended or truncated.
+  // A user data block is being created, extended or truncated. This does not
+  // evict anything, see TrimCacheIfNeeded().
   void ModifyStorageSize(int32 old_size, int32 new_size);
 
+  // Evicts entries if the cache has grown over its size limit. Must be called
+  // without holding the lock of any shard.
+  void TrimCacheIfNeeded();
+
   // Returns the maximum size for a file to reside on the cache.
   int MaxFileSize() const;
 
   // Insert an MemEntryImpl into the ranking list. This method is only called
   // from MemEntryImpl to insert child entries. The reference can be removed
-  // by calling RemoveFromRankingList(|entry|).
+  // by calling RemoveFromRankingList(|entry|). The lock of the entry's shard
+  // must be held.
   void InsertIntoRankingList(MemEntryImpl* entry);
 
   // Remove |entry| from ranking list. This method is only called from
-  // MemEntryImpl to remove a child entry from the ranking list.
+  // MemEntryImpl to remove a child entry from the ranking list. The lock of
+  // the entry's shard must be held.
   void RemoveFromRankingList(MemEntryImpl* entry);
 
   // Backend interface.
@@ -90,6 +123,13 @@ class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
 
   typedef base::hash_map<std::string, MemEntryImpl*> EntryMap;
 
+  enum {
+    kNumShards = 16
+  };
+
+  // Returns the shard that holds the entry for |key|.
+  Shard* GetShard(const std::string& key);
+
   // Old Backend interface.
   bool OpenEntry(const std::string& key, Entry** entry);
   bool CreateEntry(const std::string& key, Entry** entry);
@@ -104,14 +144,26 @@ class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
   // use.
   void TrimCache(bool empty);
 
+  // Dooms the entries of |shard| that were last used in
+  // [|initial_time|, |end_time|). A null |end_time| means no upper bound.
+  void DoomShardEntriesBetween(Shard* shard,
+                               const base::Time initial_time,
+                               const base::Time end_time);
+
+  // Returns the least recently used entry of |shard| that is not in use, or
+  // NULL. The lock of |shard| must be held.
+  MemEntryImpl* GetEvictionCandidate(Shard* shard);
+
   // Handles the used storage count.
   void AddStorageSize(int32 bytes);
   void SubstractStorageSize(int32 bytes);
 
-  EntryMap entries_;
-  MemRankings rankings_;  // Rankings to be able to trim the cache.
+  Shard shards_[kNumShards];
   int32 max_size_;        // Maximum data size for this instance.
-  int32 current_size_;
+
+  // The key sizes plus the memory of the chunks that hold the data of the
+  // entries, across all the shards.
+  base::subtle::Atomic32 current_size_;
 
   net::NetLog* net_log_;
 
@@ -59,17 +59,21 @@ base::Value* NetLogChildEntryCreationCallback(
 
 namespace disk_cache {
 
-MemEntryImpl::MemEntryImpl(MemBackendImpl* backend) {
+MemEntryImpl::MemEntryImpl(MemBackendImpl* backend,
+                           MemBackendImpl::Shard* shard) {
   doomed_ = false;
   backend_ = backend;
+  shard_ = shard;
   ref_count_ = 0;
   parent_ = NULL;
   child_id_ = 0;
   child_first_pos_ = 0;
   next_ = NULL;
   prev_ = NULL;
-  for (int i = 0; i < NUM_STREAMS; i++)
+  for (int i = 0; i < NUM_STREAMS; i++) {
+    data_[i].Init(&shard->allocator);
     data_size_[i] = 0;
+  }
 }
 
 // ------------------------------------------------------------------------
@@ -106,7 +110,7 @@ void MemEntryImpl::InternalDoom() {
           // Since a pointer to this object is also saved in the map, avoid
           // dooming it.
           if (i->second != this)
-            i->second->Doom();
+            i->second->DoomLocked();
         }
         DCHECK(children_->empty());
       }
@@ -141,7 +145,8 @@ bool MemEntryImpl::InUse() {
 
 // ------------------------------------------------------------------------
 
-void MemEntryImpl::Doom() {
+void MemEntryImpl::DoomLocked() {
+  shard_->lock.AssertAcquired();
   if (doomed_)
     return;
   if (type() == kParentEntry) {
@@ -154,9 +159,16 @@ void MemEntryImpl::Doom() {
   }
 }
 
+void MemEntryImpl::Doom() {
+  base::AutoLock lock(shard_->lock);
+  DoomLocked();
+}
+
 void MemEntryImpl::Close() {
   // Only a parent entry can be closed.
   DCHECK(type() == kParentEntry);
+  // This may delete the entry, but not the shard.
+  base::AutoLock lock(shard_->lock);
   ref_count_--;
   DCHECK_GE(ref_count_, 0);
   if (!ref_count_ && doomed_)
@@ -170,57 +182,40 @@ std::string MemEntryImpl::GetKey() const {
 }
 
 Time MemEntryImpl::GetLastUsed() const {
+  base::AutoLock lock(shard_->lock);
   return last_used_;
 }
 
 Time MemEntryImpl::GetLastModified() const {
+  base::AutoLock lock(shard_->lock);
   return last_modified_;
 }
 
 int32 MemEntryImpl::GetDataSize(int index) const {
-  if (index < 0 || index >= NUM_STREAMS)
-    return 0;
-  return data_size_[index];
+  base::AutoLock lock(shard_->lock);
+  return GetDataSizeLocked(index);
 }
 
 int MemEntryImpl::ReadData(int index, int offset, IOBuffer* buf, int buf_len,
                            const CompletionCallback& callback) {
-  if (net_log_.IsLogging()) {
-    net_log_.BeginEvent(
-        net::NetLog::TYPE_ENTRY_READ_DATA,
-        CreateNetLogReadWriteDataCallback(index, offset, buf_len, false));
-  }
-
-  int result = InternalReadData(index, offset, buf, buf_len);
-
-  if (net_log_.IsLogging()) {
-    net_log_.EndEvent(
-        net::NetLog::TYPE_ENTRY_READ_DATA,
-        CreateNetLogReadWriteCompleteCallback(result));
-  }
-  return result;
+  base::AutoLock lock(shard_->lock);
+  return ReadDataLocked(index, offset, buf, buf_len);
 }
 
 int MemEntryImpl::WriteData(int index, int offset, IOBuffer* buf, int buf_len,
                             const CompletionCallback& callback, bool truncate) {
-  if (net_log_.IsLogging()) {
-    net_log_.BeginEvent(
-        net::NetLog::TYPE_ENTRY_WRITE_DATA,
-        CreateNetLogReadWriteDataCallback(index, offset, buf_len, truncate));
-  }
-
-  int result = InternalWriteData(index, offset, buf, buf_len, truncate);
-
-  if (net_log_.IsLogging()) {
-    net_log_.EndEvent(
-        net::NetLog::TYPE_ENTRY_WRITE_DATA,
-        CreateNetLogReadWriteCompleteCallback(result));
+  int result;
+  {
+    base::AutoLock lock(shard_->lock);
+    result = WriteDataLocked(index, offset, buf, buf_len, truncate);
   }
+  backend_->TrimCacheIfNeeded();
   return result;
 }
 
 int MemEntryImpl::ReadSparseData(int64 offset, IOBuffer* buf, int buf_len,
                                  const CompletionCallback& callback) {
+  base::AutoLock lock(shard_->lock);
   if (net_log_.IsLogging()) {
     net_log_.BeginEvent(
         net::NetLog::TYPE_SPARSE_READ,
@@ -234,19 +229,25 @@ int MemEntryImpl::ReadSparseData(int64 offset, IOBuffer* buf, int buf_len,
 
 int MemEntryImpl::WriteSparseData(int64 offset, IOBuffer* buf, int buf_len,
                                   const CompletionCallback& callback) {
-  if (net_log_.IsLogging()) {
-    net_log_.BeginEvent(
-        net::NetLog::TYPE_SPARSE_WRITE,
-        CreateNetLogSparseOperationCallback(offset, buf_len));
+  int result;
+  {
+    base::AutoLock lock(shard_->lock);
+    if (net_log_.IsLogging()) {
+      net_log_.BeginEvent(
+          net::NetLog::TYPE_SPARSE_WRITE,
+          CreateNetLogSparseOperationCallback(offset, buf_len));
+    }
+    result = InternalWriteSparseData(offset, buf, buf_len);
+    if (net_log_.IsLogging())
+      net_log_.EndEvent(net::NetLog::TYPE_SPARSE_WRITE);
   }
-  int result = InternalWriteSparseData(offset, buf, buf_len);
-  if (net_log_.IsLogging())
-    net_log_.EndEvent(net::NetLog::TYPE_SPARSE_WRITE);
+  backend_->TrimCacheIfNeeded();
   return result;
 }
 
 int MemEntryImpl::GetAvailableRange(int64 offset, int len, int64* start,
                                     const CompletionCallback& callback) {
+  base::AutoLock lock(shard_->lock);
   if (net_log_.IsLogging()) {
     net_log_.BeginEvent(
         net::NetLog::TYPE_SPARSE_GET_RANGE,
@@ -263,6 +264,7 @@ int MemEntryImpl::GetAvailableRange(int64 offset, int len, int64* start,
 
 bool MemEntryImpl::CouldBeSparse() const {
   DCHECK_EQ(kParentEntry, type());
+  base::AutoLock lock(shard_->lock);
   return (children_.get() != NULL);
 }
 
@@ -274,11 +276,53 @@ int MemEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
 
 MemEntryImpl::~MemEntryImpl() {
   for (int i = 0; i < NUM_STREAMS; i++)
-    backend_->ModifyStorageSize(data_size_[i], 0);
+    backend_->ModifyStorageSize(data_[i].capacity(), 0);
   backend_->ModifyStorageSize(static_cast<int32>(key_.size()), 0);
   net_log_.EndEvent(net::NetLog::TYPE_DISK_CACHE_MEM_ENTRY_IMPL);
 }
 
+int MemEntryImpl::ReadDataLocked(int index, int offset, IOBuffer* buf,
+                                 int buf_len) {
+  if (net_log_.IsLogging()) {
+    net_log_.BeginEvent(
+        net::NetLog::TYPE_ENTRY_READ_DATA,
+        CreateNetLogReadWriteDataCallback(index, offset, buf_len, false));
+  }
+
+  int result = InternalReadData(index, offset, buf, buf_len);
+
+  if (net_log_.IsLogging()) {
+    net_log_.EndEvent(
+        net::NetLog::TYPE_ENTRY_READ_DATA,
+        CreateNetLogReadWriteCompleteCallback(result));
+  }
+  return result;
+}
+
+int MemEntryImpl::WriteDataLocked(int index, int offset, IOBuffer* buf,
+                                  int buf_len, bool truncate) {
+  if (net_log_.IsLogging()) {
+    net_log_.BeginEvent(
+        net::NetLog::TYPE_ENTRY_WRITE_DATA,
+        CreateNetLogReadWriteDataCallback(index, offset, buf_len, truncate));
+  }
+
+  int result = InternalWriteData(index, offset, buf, buf_len, truncate);
+
+  if (net_log_.IsLogging()) {
+    net_log_.EndEvent(
+        net::NetLog::TYPE_ENTRY_WRITE_DATA,
+        CreateNetLogReadWriteCompleteCallback(result));
+  }
+  return result;
+}
+
+int32 MemEntryImpl::GetDataSizeLocked(int index) const {
+  if (index < 0 || index >= NUM_STREAMS)
+    return 0;
+  return data_size_[index];
+}
+
 int MemEntryImpl::InternalReadData(int index, int offset, IOBuffer* buf,
                                    int buf_len) {
   DCHECK(type() == kParentEntry || index == kSparseData);
@@ -286,7 +330,7 @@ int MemEntryImpl::InternalReadData(int index, int offset, IOBuffer* buf,
   if (index < 0 || index >= NUM_STREAMS)
     return net::ERR_INVALID_ARGUMENT;
 
-  int entry_size = GetDataSize(index);
+  int entry_size = GetDataSizeLocked(index);
   if (offset >= entry_size || offset < 0 || !buf_len)
     return 0;
 
@@ -298,7 +342,7 @@ int MemEntryImpl::InternalReadData(int index, int offset, IOBuffer* buf,
 
   UpdateRank(false);
 
-  memcpy(buf->data(), &(data_[index])[offset], buf_len);
+  data_[index].Read(offset, buf->data(), buf_len);
   return buf_len;
 }
 
@@ -321,26 +365,30 @@ int MemEntryImpl::InternalWriteData(int index, int offset, IOBuffer* buf,
   }
 
   // Read the size at this point.
-  int entry_size = GetDataSize(index);
+  int entry_size = GetDataSizeLocked(index);
+  int old_capacity = data_[index].capacity();
 
   PrepareTarget(index, offset, buf_len);
 
   if (entry_size < offset + buf_len) {
-    backend_->ModifyStorageSize(entry_size, offset + buf_len);
     data_size_[index] = offset + buf_len;
   } else if (truncate) {
     if (entry_size > offset + buf_len) {
-      backend_->ModifyStorageSize(entry_size, offset + buf_len);
       data_size_[index] = offset + buf_len;
+      data_[index].Resize(offset + buf_len);
     }
   }
 
+  // The cache is charged for the chunks that hold the stream, including the
+  // unused end of the last one.
+  backend_->ModifyStorageSize(old_capacity, data_[index].capacity());
+
   UpdateRank(true);
 
   if (!buf_len)
     return 0;
 
-  memcpy(&(data_[index])[offset], buf->data(), buf_len);
+  data_[index].Write(offset, buf->data(), buf_len);
   return buf_len;
 }
 
@@ -379,8 +427,8 @@ int MemEntryImpl::InternalReadSparseData(int64 offset, IOBuffer* buf,
           CreateNetLogSparseReadWriteCallback(child->net_log().source(),
                                               io_buf->BytesRemaining()));
     }
-    int ret = child->ReadData(kSparseData, child_offset, io_buf.get(),
-                              io_buf->BytesRemaining(), CompletionCallback());
+    int ret = child->ReadDataLocked(kSparseData, child_offset, io_buf.get(),
+                                    io_buf->BytesRemaining());
     if (net_log_.IsLogging()) {
       net_log_.EndEventWithNetErrorCode(
           net::NetLog::TYPE_SPARSE_READ_CHILD_DATA, ret);
@@ -428,7 +476,7 @@ int MemEntryImpl::InternalWriteSparseData(int64 offset, IOBuffer* buf,
                              kMaxSparseEntrySize - child_offset);
 
     // Keep a record of the last byte position (exclusive) in the child.
-    int data_size = child->GetDataSize(kSparseData);
+    int data_size = child->GetDataSizeLocked(kSparseData);
 
     if (net_log_.IsLogging()) {
       net_log_.BeginEvent(
@@ -441,8 +489,8 @@ int MemEntryImpl::InternalWriteSparseData(int64 offset, IOBuffer* buf,
     // previously written.
     // TODO(hclam): if there is data in the entry and this write is not
     // continuous we may want to discard this write.
-    int ret = child->WriteData(kSparseData, child_offset, io_buf.get(),
-                               write_len, CompletionCallback(), true);
+    int ret = child->WriteDataLocked(kSparseData, child_offset, io_buf.get(),
+                                     write_len, true);
     if (net_log_.IsLogging()) {
       net_log_.EndEventWithNetErrorCode(
           net::NetLog::TYPE_SPARSE_WRITE_CHILD_DATA, ret);
@@ -491,7 +539,7 @@ int MemEntryImpl::GetAvailableRange(int64 offset, int len, int64* start) {
     // This loop scan for continuous bytes.
     while (len && current_child) {
       // Number of bytes available in this child.
-      int data_size = current_child->GetDataSize(kSparseData) -
+      int data_size = current_child->GetDataSizeLocked(kSparseData) -
                       ToChildOffset(*start + continuous);
       if (data_size > len)
         data_size = len;
@@ -512,20 +560,20 @@ int MemEntryImpl::GetAvailableRange(int64 offset, int len, int64* start) {
 }
 
 void MemEntryImpl::PrepareTarget(int index, int offset, int buf_len) {
-  int entry_size = GetDataSize(index);
+  int entry_size = GetDataSizeLocked(index);
 
   if (entry_size >= offset + buf_len)
     return;  // Not growing the stored data.
 
-  if (static_cast<int>(data_[index].size()) < offset + buf_len)
-    data_[index].resize(offset + buf_len);
+  if (data_[index].capacity() < offset + buf_len)
+    data_[index].Resize(offset + buf_len);
 
   if (offset <= entry_size)
     return;  // There is no "hole" on the stored data.
 
   // Cleanup the hole not written by the user. The point is to avoid returning
   // random stuff later on.
-  memset(&(data_[index])[entry_size], 0, offset - entry_size);
+  data_[index].Zero(entry_size, offset - entry_size);
 }
 
 void MemEntryImpl::UpdateRank(bool modified) {
@@ -545,7 +593,7 @@ bool MemEntryImpl::InitSparseInfo() {
   if (!children_.get()) {
     // If we already have some data in sparse stream but we are being
     // initialized as a sparse entry, we should fail.
-    if (GetDataSize(kSparseData))
+    if (GetDataSizeLocked(kSparseData))
       return false;
     children_.reset(new EntryMap());
 
@@ -584,7 +632,7 @@ MemEntryImpl* MemEntryImpl::OpenChild(int64 offset, bool create) {
   if (i != children_->end()) {
     return i->second;
   } else if (create) {
-    MemEntryImpl* child = new MemEntryImpl(backend_);
+    MemEntryImpl* child = new MemEntryImpl(backend_, shard_);
     child->InitChildEntry(this, index, net_log_.net_log());
     (*children_)[index] = child;
     return child;
@@ -611,7 +659,7 @@ int MemEntryImpl::FindNextChild(int64 offset, int len, MemEntryImpl** child) {
 
       // If the first byte position we should read from doesn't exceed the
       // filled region, we have found the first child.
-      if (first_pos < current_child->GetDataSize(kSparseData)) {
+      if (first_pos < current_child->GetDataSizeLocked(kSparseData)) {
          *child = current_child;
 
          // We need to advance the scanned length.
@@ -10,11 +10,11 @@
 #include "base/memory/scoped_ptr.h"
 #include "net/base/net_log.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
+#include "net/disk_cache/memory/mem_slab_allocator.h"
 
 namespace disk_cache {
 
-class MemBackendImpl;
-
 // This class implements the Entry interface for the memory-only cache. An
 // object of this class represents a single entry on the cache. We use two
 // types of entries, parent and child to support sparse caching.
@@ -42,6 +42,11 @@ class MemBackendImpl;
 // region, and the unfilled region (if there is one) is always before the filled
 // region. The book keeping for filled region in a sparse entry is done by using
 // the variable |child_first_pos_| (inclusive).
+//
+// An entry belongs to a shard of the backend, and all its state, including its
+// stream data, is protected by the lock of that shard. The methods of the Entry
+// interface take the lock; the methods used by the backend and by the
+// rankings expect it to be held already.
 
 class MemEntryImpl : public Entry {
  public:
@@ -50,7 +55,7 @@ class MemEntryImpl : public Entry {
     kChildEntry,
   };
 
-  explicit MemEntryImpl(MemBackendImpl* backend);
+  MemEntryImpl(MemBackendImpl* backend, MemBackendImpl::Shard* shard);
 
   // Performs the initialization of a EntryImpl that will be added to the
   // cache.
@@ -59,9 +64,20 @@ class MemEntryImpl : public Entry {
   // Permanently destroys this entry.
   void InternalDoom();
 
+  // Same as Doom(), for callers that hold the lock of the shard.
+  void DoomLocked();
+
   void Open();
   bool InUse();
 
+  MemBackendImpl::Shard* shard() const {
+    return shard_;
+  }
+
+  base::Time last_used() const {
+    return last_used_;
+  }
+
   MemEntryImpl* next() const {
     return next_;
   }
@@ -129,6 +145,14 @@ class MemEntryImpl : public Entry {
 
   ~MemEntryImpl() override;
 
+  // Same as ReadData() and WriteData(), for callers that hold the lock of the
+  // shard.
+  int ReadDataLocked(int index, int offset, IOBuffer* buf, int buf_len);
+  int WriteDataLocked(int index, int offset, IOBuffer* buf, int buf_len,
+                      bool truncate);
+
+  int32 GetDataSizeLocked(int index) const;
+
   // Do all the work for corresponding public functions.  Implemented as
   // separate functions to make logging of results simpler.
   int InternalReadData(int index, int offset, IOBuffer* buf, int buf_len);
@@ -170,7 +194,7 @@ class MemEntryImpl : public Entry {
   void DetachChild(int child_id);
 
   std::string key_;
-  std::vector<char> data_[NUM_STREAMS];  // User data.
+  MemSlabBuffer data_[NUM_STREAMS];  // User data.
   int32 data_size_[NUM_STREAMS];
   int ref_count_;
 
@@ -185,6 +209,7 @@ class MemEntryImpl : public Entry {
   base::Time last_modified_;  // LRU information.
   base::Time last_used_;
   MemBackendImpl* backend_;   // Back pointer to the cache.
+  MemBackendImpl::Shard* shard_;
   bool doomed_;               // True if this entry was removed from the cache.
 
   net::BoundNetLog net_log_;
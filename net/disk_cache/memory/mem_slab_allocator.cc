@@ -0,0 +1,227 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory/mem_slab_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+
+namespace disk_cache {
+
+struct MemSlabAllocator::Slab {
+  Slab() : memory(new char[kSlabSize]), free_count(kChunksPerSlab) {
+    for (int i = 0; i < kChunksPerSlab; ++i) {
+      owners[i] = NULL;
+      indices[i] = 0;
+      // Hand out the chunks in address order.
+      free_chunks[i] = kChunksPerSlab - 1 - i;
+    }
+  }
+
+  int used_chunks() const { return kChunksPerSlab - free_count; }
+
+  scoped_ptr<char[]> memory;
+
+  // The buffer that owns each chunk, and the position of the chunk in that
+  // buffer. |owners| is NULL for the free chunks.
+  MemSlabBuffer* owners[kChunksPerSlab];
+  int indices[kChunksPerSlab];
+
+  // The first |free_count| elements are the numbers of the free chunks.
+  int free_chunks[kChunksPerSlab];
+  int free_count;
+};
+
+namespace {
+
+// Compaction starts once the free chunks add up to this many. It takes a full
+// slab's worth for the live chunks of the least used slab to be guaranteed to
+// fit in the others; the extra half slab avoids releasing a slab only to
+// allocate a new one right away when the cache size hovers around a boundary.
+const int kCompactionThreshold =
+    MemSlabAllocator::kChunksPerSlab + MemSlabAllocator::kChunksPerSlab / 2;
+
+}  // namespace
+
+MemSlabAllocator::MemSlabAllocator() : allocated_chunks_(0) {
+}
+
+MemSlabAllocator::~MemSlabAllocator() {
+  DCHECK_EQ(0, allocated_chunks_);
+  while (!slabs_.empty())
+    ReleaseSlab(slabs_.back());
+}
+
+MemSlabAllocator::Chunk MemSlabAllocator::Allocate(MemSlabBuffer* owner,
+                                                   int index) {
+  return AllocateFrom(GetSlabForAllocation(NULL), owner, index);
+}
+
+void MemSlabAllocator::Free(const Chunk& chunk) {
+  Slab* slab = chunk.slab;
+  DCHECK(slab);
+  const int number =
+      static_cast<int>(chunk.data - slab->memory.get()) / kChunkSize;
+  DCHECK_GE(number, 0);
+  DCHECK_LT(number, kChunksPerSlab);
+  DCHECK(slab->owners[number]);
+  slab->owners[number] = NULL;
+  slab->free_chunks[slab->free_count++] = number;
+  --allocated_chunks_;
+
+  const int free_chunks = slab_count() * kChunksPerSlab - allocated_chunks_;
+  if (free_chunks >= kCompactionThreshold)
+    Compact();
+}
+
+MemSlabAllocator::Slab* MemSlabAllocator::GetSlabForAllocation(
+    const Slab* exclude) {
+  Slab* best = NULL;
+  for (size_t i = 0; i < slabs_.size(); ++i) {
+    Slab* slab = slabs_[i];
+    if (slab == exclude || !slab->free_count)
+      continue;
+    if (!best || slab->free_count < best->free_count)
+      best = slab;
+  }
+  if (!best) {
+    best = new Slab;
+    slabs_.push_back(best);
+  }
+  return best;
+}
+
+MemSlabAllocator::Chunk MemSlabAllocator::AllocateFrom(Slab* slab,
+                                                       MemSlabBuffer* owner,
+                                                       int index) {
+  DCHECK(owner);
+  DCHECK_GT(slab->free_count, 0);
+  const int number = slab->free_chunks[--slab->free_count];
+  DCHECK(!slab->owners[number]);
+  slab->owners[number] = owner;
+  slab->indices[number] = index;
+  ++allocated_chunks_;
+
+  Chunk chunk;
+  chunk.data = slab->memory.get() + number * kChunkSize;
+  chunk.slab = slab;
+  return chunk;
+}
+
+void MemSlabAllocator::Compact() {
+  Slab* victim = NULL;
+  for (size_t i = 0; i < slabs_.size(); ++i) {
+    if (!victim || slabs_[i]->free_count > victim->free_count)
+      victim = slabs_[i];
+  }
+  DCHECK(victim);
+
+  const size_t slab_count = slabs_.size();
+  for (int number = 0; number < kChunksPerSlab; ++number) {
+    MemSlabBuffer* owner = victim->owners[number];
+    if (!owner)
+      continue;
+    const int index = victim->indices[number];
+    Chunk chunk = AllocateFrom(GetSlabForAllocation(victim), owner, index);
+    DCHECK_EQ(victim->memory.get() + number * kChunkSize,
+              owner->chunks_[index].data);
+    memcpy(chunk.data, owner->chunks_[index].data, kChunkSize);
+    owner->chunks_[index] = chunk;
+    victim->owners[number] = NULL;
+    --allocated_chunks_;
+  }
+  // The other slabs had room for all the chunks.
+  DCHECK_EQ(slab_count, slabs_.size());
+  ReleaseSlab(victim);
+}
+
+void MemSlabAllocator::ReleaseSlab(Slab* slab) {
+  std::vector<Slab*>::iterator it =
+      std::find(slabs_.begin(), slabs_.end(), slab);
+  DCHECK(it != slabs_.end());
+  slabs_.erase(it);
+  delete slab;
+}
+
+MemSlabBuffer::MemSlabBuffer() : allocator_(NULL) {
+}
+
+MemSlabBuffer::~MemSlabBuffer() {
+  if (allocator_)
+    Resize(0);
+}
+
+void MemSlabBuffer::Init(MemSlabAllocator* allocator) {
+  DCHECK(!allocator_);
+  allocator_ = allocator;
+}
+
+void MemSlabBuffer::Resize(int size) {
+  DCHECK(allocator_);
+  DCHECK_GE(size, 0);
+  const size_t chunk_count =
+      (size + MemSlabAllocator::kChunkSize - 1) / MemSlabAllocator::kChunkSize;
+  while (chunks_.size() > chunk_count) {
+    // Free() may move the chunks that are left, so the chunk must be out of
+    // |chunks_| before it is freed.
+    MemSlabAllocator::Chunk chunk = chunks_.back();
+    chunks_.pop_back();
+    allocator_->Free(chunk);
+  }
+  chunks_.reserve(chunk_count);
+  while (chunks_.size() < chunk_count) {
+    chunks_.push_back(
+        allocator_->Allocate(this, static_cast<int>(chunks_.size())));
+  }
+}
+
+void MemSlabBuffer::Read(int offset, char* dest, int len) const {
+  DCHECK_GE(offset, 0);
+  DCHECK_LE(offset + len, capacity());
+  while (len > 0) {
+    const int chunk_offset = offset % MemSlabAllocator::kChunkSize;
+    const int bytes =
+        std::min(len, MemSlabAllocator::kChunkSize - chunk_offset);
+    memcpy(dest,
+           chunks_[offset / MemSlabAllocator::kChunkSize].data + chunk_offset,
+           bytes);
+    dest += bytes;
+    offset += bytes;
+    len -= bytes;
+  }
+}
+
+void MemSlabBuffer::Write(int offset, const char* src, int len) {
+  DCHECK_GE(offset, 0);
+  DCHECK_LE(offset + len, capacity());
+  while (len > 0) {
+    const int chunk_offset = offset % MemSlabAllocator::kChunkSize;
+    const int bytes =
+        std::min(len, MemSlabAllocator::kChunkSize - chunk_offset);
+    memcpy(chunks_[offset / MemSlabAllocator::kChunkSize].data + chunk_offset,
+           src, bytes);
+    src += bytes;
+    offset += bytes;
+    len -= bytes;
+  }
+}
+
+void MemSlabBuffer::Zero(int offset, int len) {
+  DCHECK_GE(offset, 0);
+  DCHECK_LE(offset + len, capacity());
+  while (len > 0) {
+    const int chunk_offset = offset % MemSlabAllocator::kChunkSize;
+    const int bytes =
+        std::min(len, MemSlabAllocator::kChunkSize - chunk_offset);
+    memset(chunks_[offset / MemSlabAllocator::kChunkSize].data + chunk_offset,
+           0, bytes);
+    offset += bytes;
+    len -= bytes;
+  }
+}
+
+}  // namespace disk_cache
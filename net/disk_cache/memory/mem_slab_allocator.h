@@ -0,0 +1,118 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_MEMORY_MEM_SLAB_ALLOCATOR_H_
+#define NET_DISK_CACHE_MEMORY_MEM_SLAB_ALLOCATOR_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+
+class MemSlabBuffer;
+
+// Hands out the fixed size chunks that hold the stream data of the
+// memory-only cache. The chunks are carved out of slabs of kChunksPerSlab
+// chunks, and new chunks come from the fullest slab that has room, so that
+// the free chunks gather in as few slabs as possible.
+//
+// The allocator never keeps more than a slab's worth of free chunks: when
+// that happens, the live chunks of the least used slab are moved to the other
+// slabs and the slab is returned to the heap. A few long lived chunks can
+// therefore not pin a slab. Moving a chunk updates the MemSlabBuffer that owns
+// it, so the allocator and all its buffers must be used under the same lock.
+class NET_EXPORT_PRIVATE MemSlabAllocator {
+ public:
+  enum {
+    kChunkSize = 512,
+    kChunksPerSlab = 64,
+    kSlabSize = kChunkSize * kChunksPerSlab,
+  };
+
+  struct Slab;
+
+  // A chunk of kChunkSize bytes and the slab it comes from.
+  struct Chunk {
+    Chunk() : data(NULL), slab(NULL) {}
+
+    char* data;
+    Slab* slab;
+  };
+
+  MemSlabAllocator();
+  ~MemSlabAllocator();
+
+  // Returns a chunk with undefined contents, to be stored at |index| in the
+  // chunks of |owner|.
+  Chunk Allocate(MemSlabBuffer* owner, int index);
+
+  // Returns |chunk|, obtained from Allocate(), to the allocator. This may move
+  // the chunks of any buffer of this allocator.
+  void Free(const Chunk& chunk);
+
+  int allocated_chunks() const { return allocated_chunks_; }
+  int slab_count() const { return static_cast<int>(slabs_.size()); }
+
+ private:
+  // Returns the fullest slab with a free chunk, other than |exclude|, or a new
+  // slab if there is none.
+  Slab* GetSlabForAllocation(const Slab* exclude);
+
+  Chunk AllocateFrom(Slab* slab, MemSlabBuffer* owner, int index);
+
+  // Moves the live chunks of the least used slab to the other slabs, and
+  // releases it.
+  void Compact();
+
+  void ReleaseSlab(Slab* slab);
+
+  std::vector<Slab*> slabs_;
+  int allocated_chunks_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemSlabAllocator);
+};
+
+// A growable byte buffer made of MemSlabAllocator chunks, used for the streams
+// of the memory-only cache entries. Unlike a std::vector<char>, growing it
+// never copies the data already stored, and shrinking it gives the chunks back.
+class NET_EXPORT_PRIVATE MemSlabBuffer {
+ public:
+  MemSlabBuffer();
+  ~MemSlabBuffer();
+
+  // Must be called once before using the buffer.
+  void Init(MemSlabAllocator* allocator);
+
+  // Returns the number of bytes the buffer holds memory for.
+  int capacity() const {
+    return static_cast<int>(chunks_.size()) * MemSlabAllocator::kChunkSize;
+  }
+
+  // Makes the buffer hold at least |size| bytes, releasing the chunks that are
+  // not needed for that. The contents up to |size| are preserved.
+  void Resize(int size);
+
+  // Copies |len| bytes at |offset| to |dest|.
+  void Read(int offset, char* dest, int len) const;
+
+  // Copies |len| bytes from |src| to |offset|.
+  void Write(int offset, const char* src, int len);
+
+  // Sets |len| bytes at |offset| to zero.
+  void Zero(int offset, int len);
+
+ private:
+  friend class MemSlabAllocator;
+
+  MemSlabAllocator* allocator_;
+  std::vector<MemSlabAllocator::Chunk> chunks_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemSlabBuffer);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_MEMORY_MEM_SLAB_ALLOCATOR_H_
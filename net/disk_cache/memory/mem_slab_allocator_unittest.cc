@@ -0,0 +1,127 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory/mem_slab_allocator.h"
+
+#include <cstring>
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const int kChunkSize = MemSlabAllocator::kChunkSize;
+const int kChunksPerSlab = MemSlabAllocator::kChunksPerSlab;
+
+void FillBuffer(MemSlabBuffer* buffer, int size, char seed) {
+  std::vector<char> data(size);
+  for (int i = 0; i < size; ++i)
+    data[i] = static_cast<char>(seed + i * 7);
+  buffer->Resize(size);
+  buffer->Write(0, &data[0], size);
+}
+
+bool CheckBuffer(const MemSlabBuffer& buffer, int size, char seed) {
+  std::vector<char> data(size);
+  buffer.Read(0, &data[0], size);
+  for (int i = 0; i < size; ++i) {
+    if (data[i] != static_cast<char>(seed + i * 7))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(MemSlabAllocatorTest, Buffer) {
+  MemSlabAllocator allocator;
+  const int kSize = 5 * kChunkSize / 2;
+  std::vector<char> data(kSize);
+  for (int i = 0; i < kSize; ++i)
+    data[i] = static_cast<char>(i * 7);
+
+  {
+    MemSlabBuffer buffer;
+    buffer.Init(&allocator);
+    EXPECT_EQ(0, buffer.capacity());
+    buffer.Resize(kSize);
+    EXPECT_EQ(3 * kChunkSize, buffer.capacity());
+    EXPECT_EQ(3, allocator.allocated_chunks());
+    EXPECT_EQ(1, allocator.slab_count());
+
+    // Writes and reads cross the chunk boundaries.
+    buffer.Write(0, &data[0], kSize);
+    std::vector<char> read(kSize);
+    buffer.Read(0, &read[0], kSize);
+    EXPECT_TRUE(data == read);
+    buffer.Read(100, &read[0], kChunkSize);
+    EXPECT_EQ(0, memcmp(&data[100], &read[0], kChunkSize));
+
+    buffer.Zero(10, 2 * kChunkSize);
+    buffer.Read(0, &read[0], kSize);
+    for (int i = 0; i < kSize; ++i) {
+      const bool zeroed = i >= 10 && i < 10 + 2 * kChunkSize;
+      EXPECT_EQ(zeroed ? 0 : data[i], read[i]) << i;
+    }
+
+    // Shrinking keeps the data that still fits.
+    buffer.Resize(kChunkSize / 2);
+    EXPECT_EQ(kChunkSize, buffer.capacity());
+    EXPECT_EQ(1, allocator.allocated_chunks());
+    buffer.Read(0, &read[0], 10);
+    EXPECT_EQ(0, memcmp(&data[0], &read[0], 10));
+  }
+  EXPECT_EQ(0, allocator.allocated_chunks());
+}
+
+// Tests that a few live chunks do not keep their slabs alive.
+TEST(MemSlabAllocatorTest, Compaction) {
+  MemSlabAllocator allocator;
+  const int kNumBuffers = 4 * kChunksPerSlab;
+  scoped_ptr<MemSlabBuffer[]> buffers(new MemSlabBuffer[kNumBuffers]);
+  for (int i = 0; i < kNumBuffers; ++i) {
+    buffers[i].Init(&allocator);
+    FillBuffer(&buffers[i], kChunkSize, static_cast<char>(i));
+  }
+  EXPECT_EQ(kNumBuffers, allocator.allocated_chunks());
+  EXPECT_EQ(4, allocator.slab_count());
+
+  // Keep one chunk in every slab.
+  for (int i = 0; i < kNumBuffers; ++i) {
+    if (i % kChunksPerSlab)
+      buffers[i].Resize(0);
+  }
+  EXPECT_EQ(4, allocator.allocated_chunks());
+  EXPECT_EQ(1, allocator.slab_count());
+  for (int i = 0; i < kNumBuffers; i += kChunksPerSlab)
+    EXPECT_TRUE(CheckBuffer(buffers[i], kChunkSize, static_cast<char>(i)));
+
+  // The slack never reaches the compaction threshold.
+  for (int i = 1; i < kNumBuffers; ++i) {
+    if (i % kChunksPerSlab)
+      FillBuffer(&buffers[i], 3 * kChunkSize, static_cast<char>(i));
+    const int free_chunks =
+        allocator.slab_count() * kChunksPerSlab - allocator.allocated_chunks();
+    EXPECT_LT(free_chunks, kChunksPerSlab + kChunksPerSlab / 2);
+  }
+  for (int i = 0; i < kNumBuffers; i += 2)
+    buffers[i].Resize(0);
+  for (int i = 1; i < kNumBuffers; i += 2) {
+    const int size = i % kChunksPerSlab ? 3 * kChunkSize : kChunkSize;
+    EXPECT_TRUE(CheckBuffer(buffers[i], size, static_cast<char>(i))) << i;
+  }
+  const int free_chunks =
+      allocator.slab_count() * kChunksPerSlab - allocator.allocated_chunks();
+  EXPECT_LT(free_chunks, kChunksPerSlab + kChunksPerSlab / 2);
+
+  // The last slab is kept, as its free chunks are under the threshold.
+  buffers.reset();
+  EXPECT_EQ(0, allocator.allocated_chunks());
+  EXPECT_EQ(1, allocator.slab_count());
+}
+
+}  // namespace disk_cache
@@ -29,9 +29,12 @@
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_entry_impl.h"
+#include "net/disk_cache/simple/simple_eviction_policy.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index.h"
 #include "net/disk_cache/simple/simple_index_file.h"
+#include "net/disk_cache/simple/simple_io_engine.h"
+#include "net/disk_cache/simple/simple_small_entry_store.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "net/disk_cache/simple/simple_version_upgrade.h"
@@ -52,6 +55,10 @@ namespace {
 // on concurrent IO (as we use one thread per IO request).
 const int kDefaultMaxWorkerThreads = 50;
 
+// Number of threads of the SimpleIOEngine, which runs batches of operations
+// on each of them instead of one operation per thread.
+const int kDefaultIOEngineThreads = 4;
+
 const char kThreadNamePrefix[] = "SimpleCache";
 
 // Maximum fraction of the cache that one entry can consume.
@@ -60,21 +67,77 @@ const int kMaxFileRatio = 8;
 // A global sequenced worker pool to use for launching all tasks.
 SequencedWorkerPool* g_sequenced_worker_pool = NULL;
 
+// A global I/O engine, used instead of |g_sequenced_worker_pool| when the
+// "SimpleCacheIOEngine" field trial selects it.
+SimpleIOEngine* g_io_engine = NULL;
+
+SimpleBackendImpl::IOEngineType g_io_engine_type_for_testing =
+    SimpleBackendImpl::IO_ENGINE_DEFAULT;
+
+// The field trial groups that enable each SimpleBackendImpl::Experiment.
+const struct {
+  const char* trial_name;
+  const char* group_name;
+} kExperimentTrialGroups[] = {
+  { "SimpleCacheSmallEntryStore", "Enabled" },
+  { "SimpleCacheIndexFormat", "Table" },
+  { "SimpleCacheEvictionPolicy", "TinyLFU" },
+};
+COMPILE_ASSERT(arraysize(kExperimentTrialGroups) ==
+                   SimpleBackendImpl::EXPERIMENT_MAX,
+               experiment_trial_groups_size_mismatch);
+
+bool g_experiments_enabled_for_testing[SimpleBackendImpl::EXPERIMENT_MAX] = {
+  false
+};
+
+int GetMaxWorkerThreads(int default_max_worker_threads) {
+  const std::string thread_count_field_trial =
+      base::FieldTrialList::FindFullName("SimpleCacheMaxThreads");
+  if (thread_count_field_trial.empty())
+    return default_max_worker_threads;
+  return std::max(1, std::atoi(thread_count_field_trial.c_str()));
+}
+
 void MaybeCreateSequencedWorkerPool() {
   if (!g_sequenced_worker_pool) {
-    int max_worker_threads = kDefaultMaxWorkerThreads;
+    g_sequenced_worker_pool = new SequencedWorkerPool(
+        GetMaxWorkerThreads(kDefaultMaxWorkerThreads), kThreadNamePrefix);
+    g_sequenced_worker_pool->AddRef();  // Leak it.
+  }
+}
 
-    const std::string thread_count_field_trial =
-        base::FieldTrialList::FindFullName("SimpleCacheMaxThreads");
-    if (!thread_count_field_trial.empty()) {
-      max_worker_threads =
-          std::max(1, std::atoi(thread_count_field_trial.c_str()));
-    }
+void MaybeCreateIOEngine() {
+  if (!g_io_engine) {
+    g_io_engine = new SimpleIOEngine(
+        GetMaxWorkerThreads(kDefaultIOEngineThreads), kThreadNamePrefix);
+    g_io_engine->AddRef();  // Leak it.
+  }
+}
 
-    g_sequenced_worker_pool = new SequencedWorkerPool(max_worker_threads,
-                                                      kThreadNamePrefix);
-    g_sequenced_worker_pool->AddRef();  // Leak it.
+scoped_refptr<base::TaskRunner> GetWorkerTaskRunner() {
+  SimpleBackendImpl::IOEngineType type = g_io_engine_type_for_testing;
+  if (type == SimpleBackendImpl::IO_ENGINE_DEFAULT) {
+    type = base::FieldTrialList::FindFullName("SimpleCacheIOEngine") ==
+                   "Batched"
+               ? SimpleBackendImpl::IO_ENGINE_BATCHED
+               : SimpleBackendImpl::IO_ENGINE_WORKER_POOL;
   }
+
+  if (type == SimpleBackendImpl::IO_ENGINE_BATCHED) {
+    MaybeCreateIOEngine();
+    return g_io_engine;
+  }
+  MaybeCreateSequencedWorkerPool();
+  return g_sequenced_worker_pool->GetTaskRunnerWithShutdownBehavior(
+      SequencedWorkerPool::CONTINUE_ON_SHUTDOWN);
+}
+
+bool IsExperimentEnabled(SimpleBackendImpl::Experiment experiment) {
+  return g_experiments_enabled_for_testing[experiment] ||
+         base::FieldTrialList::FindFullName(
+             kExperimentTrialGroups[experiment].trial_name) ==
+             kExperimentTrialGroups[experiment].group_name;
 }
 
 bool g_fd_limit_histogram_has_been_populated = false;
@@ -245,25 +308,33 @@ SimpleBackendImpl::~SimpleBackendImpl() {
 }
 
 int SimpleBackendImpl::Init(const CompletionCallback& completion_callback) {
-  MaybeCreateSequencedWorkerPool();
-
-  worker_pool_ = g_sequenced_worker_pool->GetTaskRunnerWithShutdownBehavior(
-      SequencedWorkerPool::CONTINUE_ON_SHUTDOWN);
-
+  worker_pool_ = GetWorkerTaskRunner();
+  if (IsExperimentEnabled(EXPERIMENT_SMALL_ENTRY_STORE))
+    small_entry_store_ = new SimpleSmallEntryStore(path_, worker_pool_);
+
+  const SimpleIndexFile::IndexFormat index_format =
+      IsExperimentEnabled(EXPERIMENT_INDEX_TABLE)
+          ? SimpleIndexFile::INDEX_FORMAT_TABLE
+          : SimpleIndexFile::INDEX_FORMAT_PICKLE;
   index_.reset(new SimpleIndex(
       base::ThreadTaskRunnerHandle::Get(),
       this,
       cache_type_,
-      make_scoped_ptr(new SimpleIndexFile(
-          cache_thread_, worker_pool_.get(), cache_type_, path_))));
+      make_scoped_ptr(new SimpleIndexFile(cache_thread_, worker_pool_.get(),
+                                          cache_type_, path_,
+                                          small_entry_store_.get(),
+                                          index_format))));
+  index_->SetEvictionPolicy(SimpleEvictionPolicy::Create(
+      IsExperimentEnabled(EXPERIMENT_TINY_LFU) ? SimpleEvictionPolicy::TINY_LFU
+                                               : SimpleEvictionPolicy::LRU));
   index_->ExecuteWhenReady(
       base::Bind(&RecordIndexLoad, cache_type_, base::TimeTicks::Now()));
 
   PostTaskAndReplyWithResult(
       cache_thread_.get(),
       FROM_HERE,
-      base::Bind(
-          &SimpleBackendImpl::InitCacheStructureOnDisk, path_, orig_max_size_),
+      base::Bind(&SimpleBackendImpl::InitCacheStructureOnDisk,
+                 path_, orig_max_size_, small_entry_store_),
       base::Bind(&SimpleBackendImpl::InitializeIndex,
                  AsWeakPtr(),
                  completion_callback));
@@ -351,7 +422,8 @@ void SimpleBackendImpl::DoomEntries(std::vector<uint64>* entry_hashes,
                              FROM_HERE,
                              base::Bind(&SimpleSynchronousEntry::DoomEntrySet,
                                         mass_doom_entry_hashes_ptr,
-                                        path_),
+                                        path_,
+                                        small_entry_store_),
                              base::Bind(&SimpleBackendImpl::DoomEntriesComplete,
                                         AsWeakPtr(),
                                         base::Passed(&mass_doom_entry_hashes),
@@ -564,7 +636,8 @@ void SimpleBackendImpl::InitializeIndex(const CompletionCallback& callback,
 
 SimpleBackendImpl::DiskStatResult SimpleBackendImpl::InitCacheStructureOnDisk(
     const base::FilePath& path,
-    uint64 suggested_max_size) {
+    uint64 suggested_max_size,
+    SimpleSmallEntryStore* small_entry_store) {
   DiskStatResult result;
   result.max_size = suggested_max_size;
   result.net_error = net::OK;
@@ -581,6 +654,15 @@ SimpleBackendImpl::DiskStatResult SimpleBackendImpl::InitCacheStructureOnDisk(
       result.max_size = disk_cache::PreferredCacheSize(available);
     }
     DCHECK(result.max_size);
+    // Without a loaded store, entries are simply kept in their own files.
+    if (small_entry_store && !small_entry_store->Load())
+      LOG(WARNING) << "Could not load the small entry store.";
+    // Appending packed entries does not touch the cache directory; an index
+    // saved before the last append is stale.
+    if (small_entry_store) {
+      result.cache_dir_mtime = std::max(result.cache_dir_mtime,
+                                        small_entry_store->last_modified());
+    }
   }
   return result;
 }
@@ -730,9 +812,23 @@ void SimpleBackendImpl::DoomEntriesComplete(
   callback.Run(result);
 }
 
+// static
+void SimpleBackendImpl::SetIOEngineForTesting(IOEngineType type) {
+  g_io_engine_type_for_testing = type;
+}
+
+// static
+void SimpleBackendImpl::SetExperimentEnabledForTesting(Experiment experiment,
+                                                       bool enabled) {
+  DCHECK_LT(experiment, EXPERIMENT_MAX);
+  g_experiments_enabled_for_testing[experiment] = enabled;
+}
+
 void SimpleBackendImpl::FlushWorkerPoolForTesting() {
   if (g_sequenced_worker_pool)
     g_sequenced_worker_pool->FlushForTesting();
+  if (g_io_engine)
+    g_io_engine->FlushForTesting();
 }
 
 }  // namespace disk_cache
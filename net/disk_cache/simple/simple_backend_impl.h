@@ -44,11 +44,33 @@ namespace disk_cache {
 
 class SimpleEntryImpl;
 class SimpleIndex;
+class SimpleSmallEntryStore;
 
 class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
     public SimpleIndexDelegate,
     public base::SupportsWeakPtr<SimpleBackendImpl> {
  public:
+  // How the blocking file operations of entries are run.
+  enum IOEngineType {
+    // As selected by the "SimpleCacheIOEngine" field trial.
+    IO_ENGINE_DEFAULT,
+    // On a SequencedWorkerPool, one thread per concurrent operation.
+    IO_ENGINE_WORKER_POOL,
+    // On a SimpleIOEngine, in batches on a few threads.
+    IO_ENGINE_BATCHED,
+  };
+
+  // Features under evaluation, each enabled by a field trial group.
+  enum Experiment {
+    // Packs small entries in a SimpleSmallEntryStore.
+    EXPERIMENT_SMALL_ENTRY_STORE,
+    // Keeps the index in a SimpleIndexTable.
+    EXPERIMENT_INDEX_TABLE,
+    // Evicts entries with the TinyLFU policy.
+    EXPERIMENT_TINY_LFU,
+    EXPERIMENT_MAX,
+  };
+
   SimpleBackendImpl(
       const base::FilePath& path,
       int max_bytes,
@@ -63,6 +85,12 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
 
   base::TaskRunner* worker_pool() { return worker_pool_.get(); }
 
+  // NULL unless small entries are packed into shared files, as selected by
+  // the "SimpleCacheSmallEntryStore" field trial.
+  SimpleSmallEntryStore* small_entry_store() {
+    return small_entry_store_.get();
+  }
+
   int Init(const CompletionCallback& completion_callback);
 
   // Sets the maximum size for the total amount of data stored by this instance.
@@ -71,7 +99,15 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   // Returns the maximum file size permitted in this backend.
   int GetMaxFileSize() const;
 
-  // Flush our SequencedWorkerPool.
+  // Selects the I/O engine of the backends initialized afterwards.
+  static void SetIOEngineForTesting(IOEngineType type);
+
+  // Enables |experiment| in the backends initialized afterwards, regardless
+  // of its field trial.
+  static void SetExperimentEnabledForTesting(Experiment experiment,
+                                             bool enabled);
+
+  // Flush our SequencedWorkerPool and SimpleIOEngine.
   static void FlushWorkerPoolForTesting();
 
   // The entry for |entry_hash| is being doomed; the backend will not attempt
@@ -139,10 +175,12 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
                          const CompletionCallback& callback,
                          int result);
 
-  // Try to create the directory if it doesn't exist. This must run on the IO
-  // thread.
-  static DiskStatResult InitCacheStructureOnDisk(const base::FilePath& path,
-                                                 uint64 suggested_max_size);
+  // Try to create the directory if it doesn't exist, and load
+  // |small_entry_store| if it is not NULL. This must run on the IO thread.
+  static DiskStatResult InitCacheStructureOnDisk(
+      const base::FilePath& path,
+      uint64 suggested_max_size,
+      SimpleSmallEntryStore* small_entry_store);
 
   // Searches |active_entries_| for the entry corresponding to |key|. If found,
   // returns the found entry. Otherwise, creates a new entry and returns that.
@@ -192,6 +230,7 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   scoped_ptr<SimpleIndex> index_;
   const scoped_refptr<base::SingleThreadTaskRunner> cache_thread_;
   scoped_refptr<base::TaskRunner> worker_pool_;
+  scoped_refptr<SimpleSmallEntryStore> small_entry_store_;
 
   int orig_max_size_;
   const SimpleEntryImpl::OperationsMode entry_operations_mode_;
@@ -172,6 +172,7 @@ SimpleEntryImpl::SimpleEntryImpl(net::CacheType cache_type,
     : backend_(backend->AsWeakPtr()),
       cache_type_(cache_type),
       worker_pool_(backend->worker_pool()),
+      small_entry_store_(backend->small_entry_store()),
       path_(path),
       entry_hash_(entry_hash),
       use_optimistic_operations_(operations_mode == OPTIMISTIC_OPERATIONS),
@@ -251,6 +252,7 @@ int SimpleEntryImpl::CreateEntry(Entry** out_entry,
   net_log_.AddEvent(net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_CREATE_CALL);
 
   bool have_index = backend_->index()->initialized();
+  const bool index_has_entry = backend_->index()->Has(entry_hash_);
   int ret_value = net::ERR_FAILED;
   if (use_optimistic_operations_ &&
       state_ == STATE_UNINITIALIZED && pending_operations_.size() == 0) {
@@ -258,11 +260,12 @@ int SimpleEntryImpl::CreateEntry(Entry** out_entry,
 
     ReturnEntryToCaller(out_entry);
     pending_operations_.push(SimpleEntryOperation::CreateOperation(
-        this, have_index, CompletionCallback(), static_cast<Entry**>(NULL)));
+        this, have_index, index_has_entry, CompletionCallback(),
+        static_cast<Entry**>(NULL)));
     ret_value = net::OK;
   } else {
     pending_operations_.push(SimpleEntryOperation::CreateOperation(
-        this, have_index, callback, out_entry));
+        this, have_index, index_has_entry, callback, out_entry));
     ret_value = net::ERR_IO_PENDING;
   }
 
@@ -600,6 +603,7 @@ void SimpleEntryImpl::RunNextOperationIfNeeded() {
         break;
       case SimpleEntryOperation::TYPE_CREATE:
         CreateEntryInternal(operation->have_index(),
+                            operation->index_has_entry(),
                             operation->callback(),
                             operation->out_entry());
         break;
@@ -689,6 +693,7 @@ void SimpleEntryImpl::OpenEntryInternal(bool have_index,
   Closure task = base::Bind(&SimpleSynchronousEntry::OpenEntry,
                             cache_type_,
                             path_,
+                            small_entry_store_,
                             entry_hash_,
                             have_index,
                             results.get());
@@ -703,6 +708,7 @@ void SimpleEntryImpl::OpenEntryInternal(bool have_index,
 }
 
 void SimpleEntryImpl::CreateEntryInternal(bool have_index,
+                                          bool index_has_entry,
                                           const CompletionCallback& callback,
                                           Entry** out_entry) {
   ScopedOperationRunner operation_runner(this);
@@ -738,9 +744,10 @@ void SimpleEntryImpl::CreateEntryInternal(bool have_index,
   Closure task = base::Bind(&SimpleSynchronousEntry::CreateEntry,
                             cache_type_,
                             path_,
+                            small_entry_store_,
                             key_,
-                            entry_hash_,
                             have_index,
+                            index_has_entry,
                             results.get());
   Closure reply = base::Bind(&SimpleEntryImpl::CreationOperationComplete,
                              this,
@@ -1081,7 +1088,8 @@ void SimpleEntryImpl::DoomEntryInternal(const CompletionCallback& callback) {
   PostTaskAndReplyWithResult(
       worker_pool_.get(),
       FROM_HERE,
-      base::Bind(&SimpleSynchronousEntry::DoomEntry, path_, entry_hash_),
+      base::Bind(&SimpleSynchronousEntry::DoomEntry, path_,
+                 small_entry_store_, entry_hash_),
       base::Bind(
           &SimpleEntryImpl::DoomOperationComplete, this, callback, state_));
   state_ = STATE_IO_PENDING;
@@ -31,6 +31,7 @@ class IOBuffer;
 namespace disk_cache {
 
 class SimpleBackendImpl;
+class SimpleSmallEntryStore;
 class SimpleSynchronousEntry;
 class SimpleEntryStat;
 struct SimpleEntryCreationResults;
@@ -175,6 +176,7 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
                          Entry** out_entry);
 
   void CreateEntryInternal(bool have_index,
+                           bool index_has_entry,
                            const CompletionCallback& callback,
                            Entry** out_entry);
 
@@ -311,6 +313,8 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
   const base::WeakPtr<SimpleBackendImpl> backend_;
   const net::CacheType cache_type_;
   const scoped_refptr<base::TaskRunner> worker_pool_;
+  // NULL unless the backend packs small entries.
+  const scoped_refptr<SimpleSmallEntryStore> small_entry_store_;
   const base::FilePath path_;
   const uint64 entry_hash_;
   const bool use_optimistic_operations_;
@@ -43,6 +43,7 @@ SimpleEntryOperation::SimpleEntryOperation(const SimpleEntryOperation& other)
       out_start_(other.out_start_),
       type_(other.type_),
       have_index_(other.have_index_),
+      index_has_entry_(other.index_has_entry_),
       index_(other.index_),
       truncate_(other.truncate_),
       optimistic_(other.optimistic_),
@@ -67,6 +68,7 @@ SimpleEntryOperation SimpleEntryOperation::OpenOperation(
                               NULL,
                               TYPE_OPEN,
                               have_index,
+                              false,
                               0,
                               false,
                               false,
@@ -77,6 +79,7 @@ SimpleEntryOperation SimpleEntryOperation::OpenOperation(
 SimpleEntryOperation SimpleEntryOperation::CreateOperation(
     SimpleEntryImpl* entry,
     bool have_index,
+    bool index_has_entry,
     const CompletionCallback& callback,
     Entry** out_entry) {
   return SimpleEntryOperation(entry,
@@ -89,6 +92,7 @@ SimpleEntryOperation SimpleEntryOperation::CreateOperation(
                               NULL,
                               TYPE_CREATE,
                               have_index,
+                              index_has_entry,
                               0,
                               false,
                               false,
@@ -108,6 +112,7 @@ SimpleEntryOperation SimpleEntryOperation::CloseOperation(
                               NULL,
                               TYPE_CLOSE,
                               false,
+                              false,
                               0,
                               false,
                               false,
@@ -133,6 +138,7 @@ SimpleEntryOperation SimpleEntryOperation::ReadOperation(
                               NULL,
                               TYPE_READ,
                               false,
+                              false,
                               index,
                               false,
                               false,
@@ -159,6 +165,7 @@ SimpleEntryOperation SimpleEntryOperation::WriteOperation(
                               NULL,
                               TYPE_WRITE,
                               false,
+                              false,
                               index,
                               truncate,
                               optimistic,
@@ -182,6 +189,7 @@ SimpleEntryOperation SimpleEntryOperation::ReadSparseOperation(
                               NULL,
                               TYPE_READ_SPARSE,
                               false,
+                              false,
                               0,
                               false,
                               false,
@@ -205,6 +213,7 @@ SimpleEntryOperation SimpleEntryOperation::WriteSparseOperation(
                               NULL,
                               TYPE_WRITE_SPARSE,
                               false,
+                              false,
                               0,
                               false,
                               false,
@@ -228,6 +237,7 @@ SimpleEntryOperation SimpleEntryOperation::GetAvailableRangeOperation(
                               out_start,
                               TYPE_GET_AVAILABLE_RANGE,
                               false,
+                              false,
                               0,
                               false,
                               false,
@@ -259,6 +269,7 @@ SimpleEntryOperation SimpleEntryOperation::DoomOperation(
                               out_start,
                               TYPE_DOOM,
                               have_index,
+                              false,
                               index,
                               truncate,
                               optimistic,
@@ -317,6 +328,7 @@ SimpleEntryOperation::SimpleEntryOperation(SimpleEntryImpl* entry,
                                            int64* out_start,
                                            EntryOperationType type,
                                            bool have_index,
+                                           bool index_has_entry,
                                            int index,
                                            bool truncate,
                                            bool optimistic,
@@ -331,6 +343,7 @@ SimpleEntryOperation::SimpleEntryOperation(SimpleEntryImpl* entry,
       out_start_(out_start),
       type_(type),
       have_index_(have_index),
+      index_has_entry_(index_has_entry),
       index_(index),
       truncate_(truncate),
       optimistic_(optimistic),
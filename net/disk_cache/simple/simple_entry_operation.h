@@ -44,9 +44,12 @@ class SimpleEntryOperation {
                                             bool have_index,
                                             const CompletionCallback& callback,
                                             Entry** out_entry);
+  // |index_has_entry| is whether the index listed the entry before the
+  // create; see SimpleSynchronousEntry::CreateEntry().
   static SimpleEntryOperation CreateOperation(
       SimpleEntryImpl* entry,
       bool have_index,
+      bool index_has_entry,
       const CompletionCallback& callback,
       Entry** out_entry);
   static SimpleEntryOperation CloseOperation(SimpleEntryImpl* entry);
@@ -99,6 +102,7 @@ class SimpleEntryOperation {
   const CompletionCallback& callback() const { return callback_; }
   Entry** out_entry() { return out_entry_; }
   bool have_index() const { return have_index_; }
+  bool index_has_entry() const { return index_has_entry_; }
   int index() const { return index_; }
   int offset() const { return offset_; }
   int64 sparse_offset() const { return sparse_offset_; }
@@ -120,6 +124,7 @@ class SimpleEntryOperation {
                        int64* out_start,
                        EntryOperationType type,
                        bool have_index,
+                       bool index_has_entry,
                        int index,
                        bool truncate,
                        bool optimistic,
@@ -144,6 +149,8 @@ class SimpleEntryOperation {
   const EntryOperationType type_;
   // Used in open and create operations.
   const bool have_index_;
+  // Used only in create operations.
+  const bool index_has_entry_;
   // Used in write and read operations.
   const unsigned int index_;
   // Used only in write operations.
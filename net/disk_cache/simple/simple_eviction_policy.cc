@@ -0,0 +1,295 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_eviction_policy.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "base/logging.h"
+#include "base/time/time.h"
+
+namespace disk_cache {
+
+namespace {
+
+// The window holds 1% of the entries, and the protected segment at most 80%
+// of the main cache.
+const size_t kWindowDivisor = 100;
+const size_t kProbationDivisor = 5;
+
+// Counters per entry, shared by all the rows of the sketch: eight bytes.
+const size_t kSketchCountersPerEntry = 16;
+const size_t kSketchMinCounters = 64;
+// Counted events per entry before the counters are halved.
+const size_t kSketchSampleSizePerEntry = 10;
+
+const uint64 kSketchSeeds[] = {
+  GG_UINT64_C(0xc3a5c85c97cb3127), GG_UINT64_C(0xb492b66fbe98f273),
+  GG_UINT64_C(0x9ae16a3b2f90404f), GG_UINT64_C(0xcbf29ce484222325),
+};
+
+struct LRUCandidate {
+  bool operator>(const LRUCandidate& other) const {
+    if (last_used_time != other.last_used_time)
+      return last_used_time > other.last_used_time;
+    return entry_hash > other.entry_hash;
+  }
+
+  base::Time last_used_time;
+  uint64 entry_hash;
+  int entry_size;
+};
+
+}  // namespace
+
+// static
+scoped_ptr<SimpleEvictionPolicy> SimpleEvictionPolicy::Create(Type type) {
+  switch (type) {
+    case LRU:
+      return make_scoped_ptr(new SimpleLRUEvictionPolicy);
+    case TINY_LFU:
+      return make_scoped_ptr(new SimpleTinyLFUEvictionPolicy);
+  }
+  NOTREACHED();
+  return scoped_ptr<SimpleEvictionPolicy>();
+}
+
+SimpleLRUEvictionPolicy::SimpleLRUEvictionPolicy() {
+}
+
+SimpleLRUEvictionPolicy::~SimpleLRUEvictionPolicy() {
+}
+
+void SimpleLRUEvictionPolicy::SelectEntriesToEvict(
+    const SimpleIndex::EntrySet& entries,
+    uint64 bytes_to_evict,
+    std::vector<uint64>* entry_hashes) {
+  std::vector<LRUCandidate> heap;
+  heap.reserve(entries.size());
+  for (SimpleIndex::EntrySet::const_iterator it = entries.begin();
+       it != entries.end(); ++it) {
+    LRUCandidate candidate = {
+      it->second.GetLastUsedTime(), it->first, it->second.GetEntrySize()
+    };
+    heap.push_back(candidate);
+  }
+  std::greater<LRUCandidate> oldest_first;
+  std::make_heap(heap.begin(), heap.end(), oldest_first);
+
+  uint64 evicted_size = 0;
+  while (evicted_size < bytes_to_evict && !heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), oldest_first);
+    entry_hashes->push_back(heap.back().entry_hash);
+    evicted_size += heap.back().entry_size;
+    heap.pop_back();
+  }
+}
+
+SimpleFrequencySketch::SimpleFrequencySketch()
+    : counter_mask_(0), increments_(0), sample_size_(0) {
+  EnsureCapacity(0);
+}
+
+SimpleFrequencySketch::~SimpleFrequencySketch() {
+}
+
+void SimpleFrequencySketch::EnsureCapacity(size_t entry_count) {
+  size_t counters = kSketchMinCounters;
+  while (counters < entry_count * kSketchCountersPerEntry)
+    counters *= 2;
+  if (counters <= table_.size() * 16)
+    return;
+  table_.assign(counters / 16, 0);
+  counter_mask_ = counters - 1;
+  increments_ = 0;
+  sample_size_ =
+      counters / kSketchCountersPerEntry * kSketchSampleSizePerEntry;
+}
+
+void SimpleFrequencySketch::Increment(uint64 entry_hash) {
+  bool incremented = false;
+  for (int row = 0; row < kDepth; ++row) {
+    const size_t index = CounterIndex(entry_hash, row);
+    const int shift = (index & 15) * 4;
+    uint64& word = table_[index / 16];
+    if (((word >> shift) & 0xf) < 0xf) {
+      word += GG_UINT64_C(1) << shift;
+      incremented = true;
+    }
+  }
+  if (incremented && ++increments_ >= sample_size_)
+    Halve();
+}
+
+int SimpleFrequencySketch::Estimate(uint64 entry_hash) const {
+  int estimate = 0xf;
+  for (int row = 0; row < kDepth; ++row) {
+    const size_t index = CounterIndex(entry_hash, row);
+    const int count = (table_[index / 16] >> ((index & 15) * 4)) & 0xf;
+    estimate = std::min(estimate, count);
+  }
+  return estimate;
+}
+
+size_t SimpleFrequencySketch::CounterIndex(uint64 entry_hash, int row) const {
+  COMPILE_ASSERT(arraysize(kSketchSeeds) == kDepth, one_seed_per_row);
+  uint64 hash = (entry_hash + kSketchSeeds[row]) * kSketchSeeds[row];
+  hash ^= hash >> 32;
+  return static_cast<size_t>(hash) & counter_mask_;
+}
+
+void SimpleFrequencySketch::Halve() {
+  for (size_t i = 0; i < table_.size(); ++i)
+    table_[i] = (table_[i] >> 1) & GG_UINT64_C(0x7777777777777777);
+  increments_ /= 2;
+}
+
+SimpleTinyLFUEvictionPolicy::SimpleTinyLFUEvictionPolicy() {
+  std::fill(sizes_, sizes_ + SEGMENT_COUNT, 0);
+}
+
+SimpleTinyLFUEvictionPolicy::~SimpleTinyLFUEvictionPolicy() {
+  for (NodeMap::iterator it = nodes_.begin(); it != nodes_.end(); ++it)
+    delete it->second;
+}
+
+void SimpleTinyLFUEvictionPolicy::OnInsert(uint64 entry_hash) {
+  NodeMap::iterator it = nodes_.find(entry_hash);
+  if (it != nodes_.end()) {
+    OnUse(entry_hash);
+    return;
+  }
+  Node* node = new Node(entry_hash, WINDOW);
+  nodes_.insert(std::make_pair(entry_hash, node));
+  lists_[WINDOW].Append(node);
+  ++sizes_[WINDOW];
+  sketch_.EnsureCapacity(nodes_.size());
+  sketch_.Increment(entry_hash);
+}
+
+void SimpleTinyLFUEvictionPolicy::OnUse(uint64 entry_hash) {
+  sketch_.Increment(entry_hash);
+  NodeMap::iterator it = nodes_.find(entry_hash);
+  if (it == nodes_.end())
+    return;
+  Node* node = it->second;
+  if (node->segment() == PROBATION) {
+    MakeMostRecentlyUsed(node, PROTECTED);
+    ShrinkProtected();
+  } else {
+    MakeMostRecentlyUsed(node, node->segment());
+  }
+}
+
+void SimpleTinyLFUEvictionPolicy::OnRemove(uint64 entry_hash) {
+  NodeMap::iterator it = nodes_.find(entry_hash);
+  if (it == nodes_.end())
+    return;
+  Node* node = it->second;
+  node->RemoveFromList();
+  --sizes_[node->segment()];
+  nodes_.erase(it);
+  delete node;
+}
+
+void SimpleTinyLFUEvictionPolicy::OnLoad(const SimpleIndex::EntrySet& entries) {
+  // The entries loaded from the index have no history in the sketch, so they
+  // start in probation, in the order of their last used times.
+  std::vector<std::pair<base::Time, uint64> > loaded;
+  for (SimpleIndex::EntrySet::const_iterator it = entries.begin();
+       it != entries.end(); ++it) {
+    if (nodes_.find(it->first) == nodes_.end())
+      loaded.push_back(std::make_pair(it->second.GetLastUsedTime(), it->first));
+  }
+  std::sort(loaded.begin(), loaded.end());
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    Node* node = new Node(loaded[i].second, PROBATION);
+    nodes_.insert(std::make_pair(loaded[i].second, node));
+    lists_[PROBATION].Append(node);
+    ++sizes_[PROBATION];
+  }
+  sketch_.EnsureCapacity(nodes_.size());
+}
+
+void SimpleTinyLFUEvictionPolicy::SelectEntriesToEvict(
+    const SimpleIndex::EntrySet& entries,
+    uint64 bytes_to_evict,
+    std::vector<uint64>* entry_hashes) {
+  // On the first eviction of a cache that was not loaded from an index, the
+  // main cache is empty, and all the entries but the window's share of them
+  // are admitted to it without competing.
+  if (!sizes_[PROBATION] && !sizes_[PROTECTED]) {
+    while (sizes_[WINDOW] > MaxWindowSize())
+      MakeMostRecentlyUsed(LeastRecentlyUsed(WINDOW), PROBATION);
+  }
+
+  uint64 evicted_size = 0;
+  while (evicted_size < bytes_to_evict && !nodes_.empty()) {
+    Node* candidate =
+        sizes_[WINDOW] > MaxWindowSize() ? LeastRecentlyUsed(WINDOW) : NULL;
+    Node* victim = LeastRecentlyUsed(PROBATION);
+    if (!victim)
+      victim = LeastRecentlyUsed(PROTECTED);
+    if (!victim) {
+      // Only the window has entries.
+      victim = LeastRecentlyUsed(WINDOW);
+      candidate = NULL;
+    }
+    if (candidate) {
+      // The candidate leaving the window is only admitted to the main cache
+      // if it is used more often than the entry it displaces.
+      if (sketch_.Estimate(candidate->entry_hash()) >
+          sketch_.Estimate(victim->entry_hash())) {
+        MakeMostRecentlyUsed(candidate, PROBATION);
+      } else {
+        victim = candidate;
+      }
+    }
+    evicted_size += Evict(victim, entries, entry_hashes);
+  }
+}
+
+size_t SimpleTinyLFUEvictionPolicy::MaxWindowSize() const {
+  return std::max<size_t>(1, nodes_.size() / kWindowDivisor);
+}
+
+void SimpleTinyLFUEvictionPolicy::MakeMostRecentlyUsed(Node* node,
+                                                       Segment segment) {
+  node->RemoveFromList();
+  --sizes_[node->segment()];
+  lists_[segment].Append(node);
+  ++sizes_[segment];
+  node->set_segment(segment);
+}
+
+void SimpleTinyLFUEvictionPolicy::ShrinkProtected() {
+  const size_t main_size = sizes_[PROBATION] + sizes_[PROTECTED];
+  const size_t max_protected_size = main_size - main_size / kProbationDivisor;
+  while (sizes_[PROTECTED] > max_protected_size)
+    MakeMostRecentlyUsed(LeastRecentlyUsed(PROTECTED), PROBATION);
+}
+
+SimpleTinyLFUEvictionPolicy::Node*
+SimpleTinyLFUEvictionPolicy::LeastRecentlyUsed(Segment segment) const {
+  if (lists_[segment].empty())
+    return NULL;
+  return lists_[segment].head()->value();
+}
+
+uint64 SimpleTinyLFUEvictionPolicy::Evict(
+    Node* node,
+    const SimpleIndex::EntrySet& entries,
+    std::vector<uint64>* entry_hashes) {
+  const uint64 entry_hash = node->entry_hash();
+  OnRemove(entry_hash);
+  SimpleIndex::EntrySet::const_iterator it = entries.find(entry_hash);
+  if (it == entries.end())
+    return 0;
+  entry_hashes->push_back(entry_hash);
+  return it->second.GetEntrySize();
+}
+
+}  // namespace disk_cache
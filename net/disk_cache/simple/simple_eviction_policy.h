@@ -0,0 +1,188 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_EVICTION_POLICY_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_EVICTION_POLICY_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/flat_hash_map.h"
+#include "base/containers/linked_list.h"
+#include "base/memory/scoped_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_index.h"
+
+namespace disk_cache {
+
+// SimpleEvictionPolicy chooses the entries SimpleIndex evicts when the cache
+// grows over its high watermark. The index tells the policy about the entries
+// it inserts, uses and removes, and the policy keeps whatever state it needs
+// to rank them. All methods must be called on the IO thread.
+class NET_EXPORT_PRIVATE SimpleEvictionPolicy {
+ public:
+  enum Type {
+    // Evicts the least recently used entries first.
+    LRU,
+    // Window TinyLFU: new entries go through a small LRU window, and then only
+    // displace the entries of the main cache that are used less frequently,
+    // so that one-off scans do not flush the entries that keep getting hit.
+    TINY_LFU,
+  };
+
+  static scoped_ptr<SimpleEvictionPolicy> Create(Type type);
+
+  virtual ~SimpleEvictionPolicy() {}
+
+  virtual void OnInsert(uint64 entry_hash) = 0;
+  virtual void OnUse(uint64 entry_hash) = 0;
+  virtual void OnRemove(uint64 entry_hash) = 0;
+
+  // Called once the index is loaded, with all its |entries|. The policy may
+  // not have been told about most of them.
+  virtual void OnLoad(const SimpleIndex::EntrySet& entries) = 0;
+
+  // Appends to |entry_hashes|, in eviction order, entries of |entries| whose
+  // sizes add up to at least |bytes_to_evict|, or all of them. The entries
+  // stay in the index until they are doomed, but the policy forgets them.
+  virtual void SelectEntriesToEvict(const SimpleIndex::EntrySet& entries,
+                                    uint64 bytes_to_evict,
+                                    std::vector<uint64>* entry_hashes) = 0;
+};
+
+// Evicts the entries with the oldest last used times. Rather than sorting the
+// whole index, builds a heap of it in linear time, and only pops the entries
+// it evicts.
+class NET_EXPORT_PRIVATE SimpleLRUEvictionPolicy : public SimpleEvictionPolicy {
+ public:
+  SimpleLRUEvictionPolicy();
+  ~SimpleLRUEvictionPolicy() override;
+
+  // SimpleEvictionPolicy:
+  void OnInsert(uint64 entry_hash) override {}
+  void OnUse(uint64 entry_hash) override {}
+  void OnRemove(uint64 entry_hash) override {}
+  void OnLoad(const SimpleIndex::EntrySet& entries) override {}
+  void SelectEntriesToEvict(const SimpleIndex::EntrySet& entries,
+                            uint64 bytes_to_evict,
+                            std::vector<uint64>* entry_hashes) override;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SimpleLRUEvictionPolicy);
+};
+
+// A count-min sketch of 4-bit counters estimating how often each entry hash
+// was seen. Once it has counted ten events per entry it is sized for, all
+// counters are halved, so that the estimates favor recent history.
+class NET_EXPORT_PRIVATE SimpleFrequencySketch {
+ public:
+  SimpleFrequencySketch();
+  ~SimpleFrequencySketch();
+
+  // Sizes the sketch for about |entry_count| distinct entries. Growing the
+  // sketch forgets all counts.
+  void EnsureCapacity(size_t entry_count);
+
+  void Increment(uint64 entry_hash);
+
+  // Returns the estimated count of |entry_hash|, between 0 and 15.
+  int Estimate(uint64 entry_hash) const;
+
+ private:
+  static const int kDepth = 4;
+
+  // Returns the index of the counter of |entry_hash| in row |row|.
+  size_t CounterIndex(uint64 entry_hash, int row) const;
+
+  void Halve();
+
+  // Sixteen 4-bit counters per word.
+  std::vector<uint64> table_;
+  size_t counter_mask_;
+  size_t increments_;
+  size_t sample_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleFrequencySketch);
+};
+
+// The TINY_LFU policy. Entries are kept in three LRU lists: the window, which
+// takes new entries, and the probation and protected segments of the main
+// cache. An entry used while in probation is promoted to the protected
+// segment, which holds at most 80% of the main cache.
+//
+// Eviction takes the least recently used ends of the lists, so its cost is
+// bounded by the number of entries evicted rather than by the size of the
+// index. While the window holds more than 1% of the entries, its least
+// recently used entry competes with the victim of the main cache, and the one
+// that |sketch_| estimates to be less frequently used is evicted; the other
+// one stays in, or is admitted to, the main cache.
+class NET_EXPORT_PRIVATE SimpleTinyLFUEvictionPolicy
+    : public SimpleEvictionPolicy {
+ public:
+  SimpleTinyLFUEvictionPolicy();
+  ~SimpleTinyLFUEvictionPolicy() override;
+
+  // SimpleEvictionPolicy:
+  void OnInsert(uint64 entry_hash) override;
+  void OnUse(uint64 entry_hash) override;
+  void OnRemove(uint64 entry_hash) override;
+  void OnLoad(const SimpleIndex::EntrySet& entries) override;
+  void SelectEntriesToEvict(const SimpleIndex::EntrySet& entries,
+                            uint64 bytes_to_evict,
+                            std::vector<uint64>* entry_hashes) override;
+
+ private:
+  enum Segment {
+    WINDOW,
+    PROBATION,
+    PROTECTED,
+    SEGMENT_COUNT,
+  };
+
+  class Node : public base::LinkNode<Node> {
+   public:
+    Node(uint64 entry_hash, Segment segment)
+        : entry_hash_(entry_hash), segment_(segment) {}
+
+    uint64 entry_hash() const { return entry_hash_; }
+    Segment segment() const { return segment_; }
+    void set_segment(Segment segment) { segment_ = segment; }
+
+   private:
+    const uint64 entry_hash_;
+    Segment segment_;
+  };
+
+  size_t MaxWindowSize() const;
+
+  // Moves |node| to the most recently used end of |segment|.
+  void MakeMostRecentlyUsed(Node* node, Segment segment);
+
+  // Demotes the least recently used protected entries to probation while the
+  // protected segment is over its share of the main cache.
+  void ShrinkProtected();
+
+  // Returns the least recently used entry of |segment|, or NULL.
+  Node* LeastRecentlyUsed(Segment segment) const;
+
+  // Forgets |node|, and adds its entry to |entry_hashes| if |entries| holds
+  // it. Returns the size of the entry.
+  uint64 Evict(Node* node,
+               const SimpleIndex::EntrySet& entries,
+               std::vector<uint64>* entry_hashes);
+
+  typedef base::FlatHashMap<uint64, Node*> NodeMap;
+  NodeMap nodes_;
+  // The least recently used entry of each segment is at the head of its list.
+  base::LinkedList<Node> lists_[SEGMENT_COUNT];
+  size_t sizes_[SEGMENT_COUNT];
+
+  SimpleFrequencySketch sketch_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleTinyLFUEvictionPolicy);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_EVICTION_POLICY_H_
@@ -0,0 +1,206 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_eviction_policy.h"
+
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const base::Time kStartTime =
+    base::Time::UnixEpoch() + base::TimeDelta::FromDays(1000);
+
+// Returns well-spread hashes, as the hashes of keys are.
+uint64 HashAt(int i) {
+  return (i + 1) * GG_UINT64_C(0x9e3779b97f4a7c15);
+}
+
+// Drives a policy the way SimpleIndex does, keeping the entries in an
+// EntrySet whose last used times advance by a second on each access.
+class SimpleEvictionPolicyTest : public testing::Test {
+ protected:
+  SimpleEvictionPolicyTest() : now_(kStartTime) {}
+
+  void CreatePolicy(SimpleEvictionPolicy::Type type) {
+    policy_ = SimpleEvictionPolicy::Create(type);
+  }
+
+  void Insert(uint64 entry_hash, int entry_size) {
+    entries_[entry_hash] = EntryMetadata(Tick(), entry_size);
+    policy_->OnInsert(entry_hash);
+  }
+
+  void Use(uint64 entry_hash) {
+    SimpleIndex::EntrySet::iterator it = entries_.find(entry_hash);
+    ASSERT_TRUE(it != entries_.end());
+    it->second.SetLastUsedTime(Tick());
+    policy_->OnUse(entry_hash);
+  }
+
+  // Removes and returns the entries the policy selects to free
+  // |bytes_to_evict|.
+  std::vector<uint64> Evict(uint64 bytes_to_evict) {
+    std::vector<uint64> entry_hashes;
+    policy_->SelectEntriesToEvict(entries_, bytes_to_evict, &entry_hashes);
+    for (size_t i = 0; i < entry_hashes.size(); ++i) {
+      EXPECT_EQ(1U, entries_.erase(entry_hashes[i]));
+      policy_->OnRemove(entry_hashes[i]);
+    }
+    return entry_hashes;
+  }
+
+  // Inserts |entry_hash|, then evicts entries until at most |capacity| are
+  // left.
+  void InsertAndTrim(uint64 entry_hash, size_t capacity) {
+    Insert(entry_hash, 1);
+    if (entries_.size() > capacity)
+      EXPECT_EQ(1U, Evict(1).size());
+  }
+
+  // Loads |count| entries of size 1 the policy was not told about, the
+  // first ones used least recently.
+  void LoadEntries(size_t count) {
+    for (size_t i = 0; i < count; ++i)
+      entries_[HashAt(i)] = EntryMetadata(Tick(), 1);
+    policy_->OnLoad(entries_);
+  }
+
+  bool Contains(uint64 entry_hash) const {
+    return entries_.find(entry_hash) != entries_.end();
+  }
+
+  base::Time Tick() {
+    now_ += base::TimeDelta::FromSeconds(1);
+    return now_;
+  }
+
+  SimpleIndex::EntrySet entries_;
+  scoped_ptr<SimpleEvictionPolicy> policy_;
+  base::Time now_;
+};
+
+}  // namespace
+
+TEST(SimpleFrequencySketchTest, CountsAndAges) {
+  SimpleFrequencySketch sketch;
+  sketch.EnsureCapacity(64);
+  EXPECT_EQ(0, sketch.Estimate(HashAt(0)));
+  for (int i = 0; i < 5; ++i)
+    sketch.Increment(HashAt(0));
+  EXPECT_EQ(5, sketch.Estimate(HashAt(0)));
+
+  // The counters saturate.
+  for (int i = 0; i < 20; ++i)
+    sketch.Increment(HashAt(0));
+  EXPECT_EQ(15, sketch.Estimate(HashAt(0)));
+
+  // Once enough other entries are counted, the old counts are halved.
+  for (int i = 1; i < 700; ++i)
+    sketch.Increment(HashAt(i));
+  EXPECT_LT(sketch.Estimate(HashAt(0)), 15);
+  EXPECT_GE(sketch.Estimate(HashAt(0)), 7);
+
+  // Growing the sketch forgets the counts.
+  sketch.EnsureCapacity(1000);
+  EXPECT_EQ(0, sketch.Estimate(HashAt(0)));
+}
+
+TEST_F(SimpleEvictionPolicyTest, LRUEvictsOldestFirst) {
+  CreatePolicy(SimpleEvictionPolicy::LRU);
+  for (int i = 0; i < 10; ++i)
+    Insert(HashAt(i), 10);
+  Use(HashAt(0));
+  Use(HashAt(1));
+
+  std::vector<uint64> evicted = Evict(25);
+  ASSERT_EQ(3U, evicted.size());
+  EXPECT_EQ(HashAt(2), evicted[0]);
+  EXPECT_EQ(HashAt(3), evicted[1]);
+  EXPECT_EQ(HashAt(4), evicted[2]);
+
+  // Asking for more than the entries hold selects all of them.
+  evicted = Evict(1000);
+  ASSERT_EQ(7U, evicted.size());
+  EXPECT_EQ(HashAt(0), evicted[5]);
+  EXPECT_EQ(HashAt(1), evicted[6]);
+  EXPECT_TRUE(entries_.empty());
+}
+
+TEST_F(SimpleEvictionPolicyTest, TinyLFUResistsScans) {
+  CreatePolicy(SimpleEvictionPolicy::TINY_LFU);
+  const size_t kCapacity = 100;
+  LoadEntries(kCapacity);
+
+  // The hot entries are used a few times each once inserted, and then a scan
+  // goes through entries that are only used once.
+  const int kHotEntries = 20;
+  for (int i = 0; i < kHotEntries; ++i)
+    InsertAndTrim(HashAt(kCapacity + i), kCapacity);
+  for (int round = 0; round < 5; ++round) {
+    for (int i = 0; i < kHotEntries; ++i)
+      Use(HashAt(kCapacity + i));
+  }
+  for (int i = 0; i < 1000; ++i)
+    InsertAndTrim(HashAt(kCapacity + kHotEntries + i), kCapacity);
+
+  EXPECT_EQ(kCapacity, entries_.size());
+  for (int i = 0; i < kHotEntries; ++i)
+    EXPECT_TRUE(Contains(HashAt(kCapacity + i))) << i;
+}
+
+TEST_F(SimpleEvictionPolicyTest, TinyLFUAdmitsFrequentEntries) {
+  CreatePolicy(SimpleEvictionPolicy::TINY_LFU);
+  // The sketch is sized for the loaded entries, and does not need to grow,
+  // and forget its counts, as new entries come in.
+  LoadEntries(20);
+  for (int i = 20; i < 30; ++i) {
+    Insert(HashAt(i), 1);
+    Use(HashAt(i));
+  }
+
+  // The newer entries leaving the window are used more than the loaded ones,
+  // so they displace them, oldest first.
+  std::vector<uint64> evicted = Evict(5);
+  ASSERT_EQ(5U, evicted.size());
+  for (size_t i = 0; i < evicted.size(); ++i)
+    EXPECT_EQ(HashAt(i), evicted[i]);
+  for (int i = 20; i < 30; ++i)
+    EXPECT_TRUE(Contains(HashAt(i))) << i;
+}
+
+TEST_F(SimpleEvictionPolicyTest, TinyLFUOnlyWindow) {
+  CreatePolicy(SimpleEvictionPolicy::TINY_LFU);
+  for (int i = 0; i < 3; ++i)
+    Insert(HashAt(i), 10);
+  std::vector<uint64> evicted = Evict(15);
+  ASSERT_EQ(2U, evicted.size());
+  EXPECT_EQ(HashAt(0), evicted[0]);
+  EXPECT_EQ(HashAt(1), evicted[1]);
+}
+
+TEST_F(SimpleEvictionPolicyTest, TinyLFUOnLoad) {
+  CreatePolicy(SimpleEvictionPolicy::TINY_LFU);
+  LoadEntries(10);
+
+  // The loaded entries are evicted in the order of their last used times.
+  std::vector<uint64> evicted = Evict(2);
+  ASSERT_EQ(2U, evicted.size());
+  EXPECT_EQ(HashAt(0), evicted[0]);
+  EXPECT_EQ(HashAt(1), evicted[1]);
+
+  // Removed entries are never selected.
+  policy_->OnRemove(HashAt(2));
+  entries_.erase(HashAt(2));
+  evicted = Evict(1);
+  ASSERT_EQ(1U, evicted.size());
+  EXPECT_EQ(HashAt(3), evicted[0]);
+}
+
+}  // namespace disk_cache
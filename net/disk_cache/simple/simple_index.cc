@@ -25,6 +25,7 @@
 #include "base/time/time.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
+#include "net/disk_cache/simple/simple_eviction_policy.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index_delegate.h"
 #include "net/disk_cache/simple/simple_index_file.h"
@@ -49,30 +50,6 @@ const uint32 kEvictionMarginDivisor = 20;
 
 const uint32 kBytesInKb = 1024;
 
-// Utility class used for timestamp comparisons in entry metadata while sorting.
-class CompareHashesForTimestamp {
-  typedef disk_cache::SimpleIndex SimpleIndex;
-  typedef disk_cache::SimpleIndex::EntrySet EntrySet;
- public:
-  explicit CompareHashesForTimestamp(const EntrySet& set);
-
-  bool operator()(uint64 hash1, uint64 hash2);
- private:
-  const EntrySet& entry_set_;
-};
-
-CompareHashesForTimestamp::CompareHashesForTimestamp(const EntrySet& set)
-  : entry_set_(set) {
-}
-
-bool CompareHashesForTimestamp::operator()(uint64 hash1, uint64 hash2) {
-  EntrySet::const_iterator it1 = entry_set_.find(hash1);
-  DCHECK(it1 != entry_set_.end());
-  EntrySet::const_iterator it2 = entry_set_.find(hash2);
-  DCHECK(it2 != entry_set_.end());
-  return it1->second.GetLastUsedTime() < it2->second.GetLastUsedTime();
-}
-
 }  // namespace
 
 namespace disk_cache {
@@ -141,6 +118,8 @@ SimpleIndex::SimpleIndex(
       high_watermark_(0),
       low_watermark_(0),
       eviction_in_progress_(false),
+      eviction_policy_(
+          SimpleEvictionPolicy::Create(SimpleEvictionPolicy::LRU)),
       initialized_(false),
       index_file_(index_file.Pass()),
       io_thread_(io_thread),
@@ -179,6 +158,13 @@ void SimpleIndex::Initialize(base::Time cache_mtime) {
   index_file_->LoadIndexEntries(cache_mtime, reply, load_result);
 }
 
+void SimpleIndex::SetEvictionPolicy(
+    scoped_ptr<SimpleEvictionPolicy> eviction_policy) {
+  DCHECK(!initialized_);
+  DCHECK(entries_set_.empty());
+  eviction_policy_ = eviction_policy.Pass();
+}
+
 bool SimpleIndex::SetMaxSize(int max_bytes) {
   if (max_bytes < 0)
     return false;
@@ -242,8 +228,10 @@ void SimpleIndex::Insert(uint64 entry_hash) {
   // creating the new entry, and then UpdateEntrySize will be called.
   InsertInEntrySet(
       entry_hash, EntryMetadata(base::Time::Now(), 0), &entries_set_);
+  eviction_policy_->OnInsert(entry_hash);
   if (!initialized_)
     removed_entries_.erase(entry_hash);
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
 }
 
@@ -254,9 +242,11 @@ void SimpleIndex::Remove(uint64 entry_hash) {
     UpdateEntryIteratorSize(&it, 0);
     entries_set_.erase(it);
   }
+  eviction_policy_->OnRemove(entry_hash);
 
   if (!initialized_)
     removed_entries_.insert(entry_hash);
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
 }
 
@@ -275,6 +265,8 @@ bool SimpleIndex::UseIfExists(uint64 entry_hash) {
     // If not initialized, always return true, forcing it to go to the disk.
     return !initialized_;
   it->second.SetLastUsedTime(base::Time::Now());
+  eviction_policy_->OnUse(entry_hash);
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
   return true;
 }
@@ -283,7 +275,6 @@ void SimpleIndex::StartEvictionIfNeeded() {
   DCHECK(io_thread_checker_.CalledOnValidThread());
   if (eviction_in_progress_ || cache_size_ <= high_watermark_)
     return;
-  // Take all live key hashes from the index and sort them by time.
   eviction_in_progress_ = true;
   eviction_start_time_ = base::TimeTicks::Now();
   SIMPLE_CACHE_UMA(MEMORY_KB,
@@ -292,29 +283,16 @@ void SimpleIndex::StartEvictionIfNeeded() {
   SIMPLE_CACHE_UMA(MEMORY_KB,
                    "Eviction.MaxCacheSizeOnStart2", cache_type_,
                    max_size_ / kBytesInKb);
-  std::vector<uint64> entry_hashes;
-  entry_hashes.reserve(entries_set_.size());
-  for (EntrySet::const_iterator it = entries_set_.begin(),
-       end = entries_set_.end(); it != end; ++it) {
-    entry_hashes.push_back(it->first);
-  }
-  std::sort(entry_hashes.begin(), entry_hashes.end(),
-            CompareHashesForTimestamp(entries_set_));
-
   // Remove as many entries from the index to get below |low_watermark_|.
-  std::vector<uint64>::iterator it = entry_hashes.begin();
+  std::vector<uint64> entry_hashes;
+  eviction_policy_->SelectEntriesToEvict(
+      entries_set_, cache_size_ - low_watermark_, &entry_hashes);
   uint64 evicted_so_far_size = 0;
-  while (evicted_so_far_size < cache_size_ - low_watermark_) {
-    DCHECK(it != entry_hashes.end());
-    EntrySet::iterator found_meta = entries_set_.find(*it);
+  for (size_t i = 0; i < entry_hashes.size(); ++i) {
+    EntrySet::const_iterator found_meta = entries_set_.find(entry_hashes[i]);
     DCHECK(found_meta != entries_set_.end());
-    uint64 to_evict_size = found_meta->second.GetEntrySize();
-    evicted_so_far_size += to_evict_size;
-    ++it;
+    evicted_so_far_size += found_meta->second.GetEntrySize();
   }
-
-  // Take out the rest of hashes from the eviction list.
-  entry_hashes.erase(it, entry_hashes.end());
   SIMPLE_CACHE_UMA(COUNTS,
                    "Eviction.EntryCount", cache_type_, entry_hashes.size());
   SIMPLE_CACHE_UMA(TIMES,
@@ -335,6 +313,7 @@ bool SimpleIndex::UpdateEntrySize(uint64 entry_hash, int entry_size) {
     return false;
 
   UpdateEntryIteratorSize(&it, entry_size);
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
   StartEvictionIfNeeded();
   return true;
@@ -390,7 +369,7 @@ void SimpleIndex::MergeInitializingSet(
 
   EntrySet* index_file_entries = &load_result->entries;
 
-  for (base::hash_set<uint64>::const_iterator it = removed_entries_.begin();
+  for (base::FlatHashSet<uint64>::const_iterator it = removed_entries_.begin();
        it != removed_entries_.end(); ++it) {
     index_file_entries->erase(*it);
   }
@@ -414,6 +393,7 @@ void SimpleIndex::MergeInitializingSet(
 
   entries_set_.swap(*index_file_entries);
   cache_size_ = merged_cache_size;
+  eviction_policy_->OnLoad(entries_set_);
   initialized_ = true;
 
   // The actual IO is asynchronous, so calling WriteToDisk() shouldn't slow the
@@ -469,8 +449,9 @@ void SimpleIndex::WriteToDisk() {
   }
   last_write_to_disk_ = start;
 
-  index_file_->WriteToDisk(entries_set_, cache_size_,
+  index_file_->WriteToDisk(entries_set_, changed_entries_, cache_size_,
                            start, app_on_background_, base::Closure());
+  changed_entries_.clear();
 }
 
 }  // namespace disk_cache
@@ -10,7 +10,8 @@
 
 #include "base/basictypes.h"
 #include "base/callback.h"
-#include "base/containers/hash_tables.h"
+#include "base/containers/flat_hash_map.h"
+#include "base/containers/flat_hash_set.h"
 #include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
@@ -33,6 +34,7 @@ class PickleIterator;
 
 namespace disk_cache {
 
+class SimpleEvictionPolicy;
 class SimpleIndexDelegate;
 class SimpleIndexFile;
 struct SimpleIndexLoadResult;
@@ -86,6 +88,10 @@ class NET_EXPORT_PRIVATE SimpleIndex
 
   void Initialize(base::Time cache_mtime);
 
+  // Replaces the default LRU eviction policy. Must be called before
+  // Initialize().
+  void SetEvictionPolicy(scoped_ptr<SimpleEvictionPolicy> eviction_policy);
+
   bool SetMaxSize(int max_bytes);
   int max_size() const { return max_size_; }
 
@@ -106,7 +112,9 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // entry.
   bool UpdateEntrySize(uint64 entry_hash, int entry_size);
 
-  typedef base::hash_map<uint64, EntryMetadata> EntrySet;
+  // There can be millions of entries, so keep them inline in a flat table
+  // rather than in a node per entry.
+  typedef base::FlatHashMap<uint64, EntryMetadata> EntrySet;
 
   static void InsertInEntrySet(uint64 entry_hash,
                                const EntryMetadata& entry_metadata,
@@ -166,12 +174,17 @@ class NET_EXPORT_PRIVATE SimpleIndex
   uint64 low_watermark_;
   bool eviction_in_progress_;
   base::TimeTicks eviction_start_time_;
+  scoped_ptr<SimpleEvictionPolicy> eviction_policy_;
 
   // This stores all the entry_hash of entries that are removed during
   // initialization.
-  base::hash_set<uint64> removed_entries_;
+  base::FlatHashSet<uint64> removed_entries_;
   bool initialized_;
 
+  // The entry_hash of the entries inserted, updated or removed since the index
+  // was last written to disk.
+  base::FlatHashSet<uint64> changed_entries_;
+
   scoped_ptr<SimpleIndexFile> index_file_;
 
   scoped_refptr<base::SingleThreadTaskRunner> io_thread_;
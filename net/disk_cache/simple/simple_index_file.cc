@@ -4,6 +4,8 @@
 
 #include "net/disk_cache/simple/simple_index_file.h"
 
+#include <algorithm>
+
 #include <vector>
 
 #include "base/files/file.h"
@@ -19,6 +21,7 @@
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_small_entry_store.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "third_party/zlib/zlib.h"
@@ -48,6 +51,20 @@ enum IndexFileState {
   INDEX_STATE_MAX = 4,
 };
 
+void UmaRecordIndexWriteTime(net::CacheType cache_type,
+                             const base::TimeTicks& start_time,
+                             bool app_on_background) {
+  if (app_on_background) {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexWriteToDiskTime.Background", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  } else {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexWriteToDiskTime.Foreground", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  }
+}
+
 void UmaRecordIndexFileState(IndexFileState state, net::CacheType cache_type) {
   SIMPLE_CACHE_UMA(ENUMERATION,
                    "IndexFileStateOnLoad", cache_type, state, INDEX_STATE_MAX);
@@ -131,6 +148,21 @@ void ProcessEntryFile(SimpleIndex::EntrySet* entries,
   }
 }
 
+// Returns in |out_mtime| the time of the last change to the cache whose index
+// is |index_file_path|. Packed entries are appended to segment files, which
+// leaves the mtime of the cache directory unchanged.
+bool GetCacheModificationTime(const base::FilePath& index_file_path,
+                              SimpleSmallEntryStore* small_entry_store,
+                              base::Time* out_mtime) {
+  // The index lives in kIndexDirectory, in the cache directory.
+  const base::FilePath cache_directory = index_file_path.DirName().DirName();
+  if (!simple_util::GetMTime(cache_directory, out_mtime))
+    return false;
+  if (small_entry_store)
+    *out_mtime = std::max(*out_mtime, small_entry_store->last_modified());
+  return true;
+}
+
 }  // namespace
 
 SimpleIndexLoadResult::SimpleIndexLoadResult() : did_load(false),
@@ -149,6 +181,8 @@ void SimpleIndexLoadResult::Reset() {
 // static
 const char SimpleIndexFile::kIndexFileName[] = "the-real-index";
 // static
+const char SimpleIndexFile::kIndexTableFileName[] = "the-index-table";
+// static
 const char SimpleIndexFile::kIndexDirectory[] = "index-dir";
 // static
 const char SimpleIndexFile::kTempIndexFileName[] = "temp-index";
@@ -193,7 +227,7 @@ bool SimpleIndexFile::IndexMetadata::Deserialize(PickleIterator* it) {
 }
 
 void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
-                                      const base::FilePath& cache_directory,
+                                      SimpleSmallEntryStore* small_entry_store,
                                       const base::FilePath& index_filename,
                                       const base::FilePath& temp_index_filename,
                                       scoped_ptr<Pickle> pickle,
@@ -214,7 +248,8 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
   // flush delay. This simple approach will be reconsidered if it does not allow
   // for maintaining freshness.
   base::Time cache_dir_mtime;
-  if (!simple_util::GetMTime(cache_directory, &cache_dir_mtime)) {
+  if (!GetCacheModificationTime(index_filename, small_entry_store,
+                                &cache_dir_mtime)) {
     LOG(ERROR) << "Could obtain information about cache age";
     return;
   }
@@ -231,15 +266,67 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
   if (!base::ReplaceFile(temp_index_filename, index_filename, NULL))
     return;
 
-  if (app_on_background) {
-    SIMPLE_CACHE_UMA(TIMES,
-                     "IndexWriteToDiskTime.Background", cache_type,
-                     (base::TimeTicks::Now() - start_time));
-  } else {
-    SIMPLE_CACHE_UMA(TIMES,
-                     "IndexWriteToDiskTime.Foreground", cache_type,
-                     (base::TimeTicks::Now() - start_time));
+  UmaRecordIndexWriteTime(cache_type, start_time, app_on_background);
+}
+
+// static
+bool SimpleIndexFile::SyncWriteTable(
+    net::CacheType cache_type,
+    SimpleSmallEntryStore* small_entry_store,
+    const base::FilePath& table_filename,
+    scoped_ptr<std::vector<SimpleIndexTable::Record> > records,
+    uint64 cache_size,
+    const base::TimeTicks& start_time,
+    bool app_on_background) {
+  base::FilePath index_file_directory = table_filename.DirName();
+  if (!base::DirectoryExists(index_file_directory) &&
+      !base::CreateDirectory(index_file_directory)) {
+    LOG(ERROR) << "Could not create a directory to hold the index file";
+    return false;
+  }
+
+  // See SyncWriteToDisk() about the freshness of the index.
+  base::Time cache_dir_mtime;
+  if (!GetCacheModificationTime(table_filename, small_entry_store,
+                                &cache_dir_mtime)) {
+    LOG(ERROR) << "Could obtain information about cache age";
+    simple_util::SimpleCacheDeleteFile(table_filename);
+    return false;
+  }
+  const base::FilePath temp_table_filename =
+      index_file_directory.AppendASCII(kTempIndexFileName);
+  if (!SimpleIndexTable::Write(table_filename, temp_table_filename, *records,
+                               cache_size, cache_dir_mtime)) {
+    return false;
   }
+
+  UmaRecordIndexWriteTime(cache_type, start_time, app_on_background);
+  return true;
+}
+
+// static
+bool SimpleIndexFile::SyncUpdateTable(
+    net::CacheType cache_type,
+    SimpleSmallEntryStore* small_entry_store,
+    const base::FilePath& table_filename,
+    scoped_ptr<SimpleIndexTable::Changes> changes,
+    uint64 cache_size,
+    const base::TimeTicks& start_time,
+    bool app_on_background) {
+  base::Time cache_dir_mtime;
+  if (!GetCacheModificationTime(table_filename, small_entry_store,
+                                &cache_dir_mtime)) {
+    LOG(ERROR) << "Could obtain information about cache age";
+    simple_util::SimpleCacheDeleteFile(table_filename);
+    return false;
+  }
+  if (!SimpleIndexTable::Update(table_filename, *changes, cache_size,
+                                cache_dir_mtime)) {
+    return false;
+  }
+
+  UmaRecordIndexWriteTime(cache_type, start_time, app_on_background);
+  return true;
 }
 
 bool SimpleIndexFile::IndexMetadata::CheckIndexMetadata() {
@@ -252,15 +339,23 @@ SimpleIndexFile::SimpleIndexFile(
     const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread,
     const scoped_refptr<base::TaskRunner>& worker_pool,
     net::CacheType cache_type,
-    const base::FilePath& cache_directory)
+    const base::FilePath& cache_directory,
+    SimpleSmallEntryStore* small_entry_store,
+    IndexFormat format)
     : cache_thread_(cache_thread),
       worker_pool_(worker_pool),
       cache_type_(cache_type),
       cache_directory_(cache_directory),
+      small_entry_store_(small_entry_store),
       index_file_(cache_directory_.AppendASCII(kIndexDirectory)
-                      .AppendASCII(kIndexFileName)),
+                      .AppendASCII(format == INDEX_FORMAT_TABLE
+                                       ? kIndexTableFileName
+                                       : kIndexFileName)),
       temp_index_file_(cache_directory_.AppendASCII(kIndexDirectory)
-                           .AppendASCII(kTempIndexFileName)) {
+                           .AppendASCII(kTempIndexFileName)),
+      format_(format),
+      table_in_sync_(false),
+      weak_ptr_factory_(this) {
 }
 
 SimpleIndexFile::~SimpleIndexFile() {}
@@ -269,39 +364,115 @@ void SimpleIndexFile::LoadIndexEntries(base::Time cache_last_modified,
                                        const base::Closure& callback,
                                        SimpleIndexLoadResult* out_result) {
   base::Closure task = base::Bind(&SimpleIndexFile::SyncLoadIndexEntries,
-                                  cache_type_,
+                                  cache_type_, format_,
                                   cache_last_modified, cache_directory_,
-                                  index_file_, out_result);
-  worker_pool_->PostTaskAndReply(FROM_HERE, task, callback);
+                                  index_file_, small_entry_store_,
+                                  out_result);
+  worker_pool_->PostTaskAndReply(
+      FROM_HERE, task,
+      base::Bind(&SimpleIndexFile::OnIndexLoaded,
+                 weak_ptr_factory_.GetWeakPtr(), callback, out_result));
 }
 
-void SimpleIndexFile::WriteToDisk(const SimpleIndex::EntrySet& entry_set,
-                                  uint64 cache_size,
-                                  const base::TimeTicks& start,
-                                  bool app_on_background,
-                                  const base::Closure& callback) {
+void SimpleIndexFile::WriteToDisk(
+    const SimpleIndex::EntrySet& entry_set,
+    const base::FlatHashSet<uint64>& changed_entries,
+    uint64 cache_size,
+    const base::TimeTicks& start,
+    bool app_on_background,
+    const base::Closure& callback) {
+  if (format_ == INDEX_FORMAT_TABLE) {
+    base::Callback<bool(void)> task;
+    if (table_in_sync_) {
+      scoped_ptr<SimpleIndexTable::Changes> changes(
+          new SimpleIndexTable::Changes);
+      for (base::FlatHashSet<uint64>::const_iterator it =
+               changed_entries.begin();
+           it != changed_entries.end(); ++it) {
+        SimpleIndex::EntrySet::const_iterator found = entry_set.find(*it);
+        if (found == entry_set.end()) {
+          changes->removed.push_back(*it);
+        } else {
+          SimpleIndexTable::Record record = { found->first, found->second };
+          changes->updated.push_back(record);
+        }
+      }
+      task = base::Bind(&SimpleIndexFile::SyncUpdateTable,
+                        cache_type_, small_entry_store_, index_file_,
+                        base::Passed(&changes), cache_size, start,
+                        app_on_background);
+    } else {
+      scoped_ptr<std::vector<SimpleIndexTable::Record> > records(
+          new std::vector<SimpleIndexTable::Record>);
+      records->reserve(entry_set.size());
+      for (SimpleIndex::EntrySet::const_iterator it = entry_set.begin();
+           it != entry_set.end(); ++it) {
+        SimpleIndexTable::Record record = { it->first, it->second };
+        records->push_back(record);
+      }
+      task = base::Bind(&SimpleIndexFile::SyncWriteTable,
+                        cache_type_, small_entry_store_, index_file_,
+                        base::Passed(&records), cache_size, start,
+                        app_on_background);
+      // Writes are run in order on the cache thread, so the following ones
+      // can update the table this one writes; if it fails, so do they.
+      table_in_sync_ = true;
+    }
+    base::PostTaskAndReplyWithResult(
+        cache_thread_.get(), FROM_HERE, task,
+        base::Bind(&SimpleIndexFile::OnTableWritten,
+                   weak_ptr_factory_.GetWeakPtr(), callback));
+    return;
+  }
+
   IndexMetadata index_metadata(entry_set.size(), cache_size);
   scoped_ptr<Pickle> pickle = Serialize(index_metadata, entry_set);
   base::Closure task =
       base::Bind(&SimpleIndexFile::SyncWriteToDisk,
-                 cache_type_, cache_directory_, index_file_, temp_index_file_,
-                 base::Passed(&pickle), start, app_on_background);
+                 cache_type_, small_entry_store_, index_file_,
+                 temp_index_file_, base::Passed(&pickle), start,
+                 app_on_background);
   if (callback.is_null())
     cache_thread_->PostTask(FROM_HERE, task);
   else
     cache_thread_->PostTaskAndReply(FROM_HERE, task, callback);
 }
 
+void SimpleIndexFile::OnIndexLoaded(const base::Closure& callback,
+                                    SimpleIndexLoadResult* result) {
+  // A restored index is flushed right away, and in full.
+  table_in_sync_ = result->did_load && !result->flush_required;
+  callback.Run();
+}
+
+void SimpleIndexFile::OnTableWritten(const base::Closure& callback,
+                                     bool succeeded) {
+  if (!succeeded)
+    table_in_sync_ = false;
+  if (!callback.is_null())
+    callback.Run();
+}
+
 // static
 void SimpleIndexFile::SyncLoadIndexEntries(
     net::CacheType cache_type,
+    IndexFormat format,
     base::Time cache_last_modified,
     const base::FilePath& cache_directory,
     const base::FilePath& index_file_path,
+    SimpleSmallEntryStore* small_entry_store,
     SimpleIndexLoadResult* out_result) {
+  // The index file of the other format, if any, was left behind when the
+  // format changed, and would be stale were the format to change back.
+  simple_util::SimpleCacheDeleteFile(index_file_path.DirName().AppendASCII(
+      format == INDEX_FORMAT_TABLE ? kIndexFileName : kIndexTableFileName));
+
   // Load the index and find its age.
   base::Time last_cache_seen_by_index;
-  SyncLoadFromDisk(index_file_path, &last_cache_seen_by_index, out_result);
+  if (format == INDEX_FORMAT_TABLE)
+    SyncLoadFromTable(index_file_path, &last_cache_seen_by_index, out_result);
+  else
+    SyncLoadFromDisk(index_file_path, &last_cache_seen_by_index, out_result);
 
   // Consider the index loaded if it is fresh.
   const bool index_file_existed = base::PathExists(index_file_path);
@@ -311,7 +482,8 @@ void SimpleIndexFile::SyncLoadIndexEntries(
   } else {
     if (cache_last_modified <= last_cache_seen_by_index) {
       base::Time latest_dir_mtime;
-      simple_util::GetMTime(cache_directory, &latest_dir_mtime);
+      GetCacheModificationTime(index_file_path, small_entry_store,
+                               &latest_dir_mtime);
       if (LegacyIsIndexFileStale(latest_dir_mtime, index_file_path)) {
         UmaRecordIndexFileState(INDEX_STATE_FRESH_CONCURRENT_UPDATES,
                                 cache_type);
@@ -326,7 +498,8 @@ void SimpleIndexFile::SyncLoadIndexEntries(
 
   // Reconstruct the index by scanning the disk for entries.
   const base::TimeTicks start = base::TimeTicks::Now();
-  SyncRestoreFromDisk(cache_directory, index_file_path, out_result);
+  SyncRestoreFromDisk(cache_directory, index_file_path, small_entry_store,
+                      out_result);
   SIMPLE_CACHE_UMA(MEDIUM_TIMES, "IndexRestoreTime", cache_type,
                    base::TimeTicks::Now() - start);
   SIMPLE_CACHE_UMA(COUNTS, "IndexEntriesRestored", cache_type,
@@ -368,6 +541,24 @@ void SimpleIndexFile::SyncLoadFromDisk(const base::FilePath& index_filename,
     simple_util::SimpleCacheDeleteFile(index_filename);
 }
 
+// static
+void SimpleIndexFile::SyncLoadFromTable(
+    const base::FilePath& table_filename,
+    base::Time* out_last_cache_seen_by_index,
+    SimpleIndexLoadResult* out_result) {
+  out_result->Reset();
+  if (!base::PathExists(table_filename))
+    return;
+
+  if (!SimpleIndexTable::Load(table_filename, &out_result->entries,
+                              out_last_cache_seen_by_index)) {
+    simple_util::SimpleCacheDeleteFile(table_filename);
+    return;
+  }
+  out_result->entries.reserve(out_result->entries.size() + kExtraSizeForMerge);
+  out_result->did_load = true;
+}
+
 // static
 scoped_ptr<Pickle> SimpleIndexFile::Serialize(
     const SimpleIndexFile::IndexMetadata& index_metadata,
@@ -420,10 +611,7 @@ void SimpleIndexFile::Deserialize(const char* data, int data_len,
     return;
   }
 
-#if !defined(OS_WIN)
-  // TODO(gavinp): Consider using std::unordered_map.
-  entries->resize(index_metadata.GetNumberOfEntries() + kExtraSizeForMerge);
-#endif
+  entries->reserve(index_metadata.GetNumberOfEntries() + kExtraSizeForMerge);
   while (entries->size() < index_metadata.GetNumberOfEntries()) {
     uint64 hash_key;
     EntryMetadata entry_metadata;
@@ -451,6 +639,7 @@ void SimpleIndexFile::Deserialize(const char* data, int data_len,
 void SimpleIndexFile::SyncRestoreFromDisk(
     const base::FilePath& cache_directory,
     const base::FilePath& index_file_path,
+    SimpleSmallEntryStore* small_entry_store,
     SimpleIndexLoadResult* out_result) {
   VLOG(1) << "Simple Cache Index is being restored from disk.";
   simple_util::SimpleCacheDeleteFile(index_file_path);
@@ -463,6 +652,17 @@ void SimpleIndexFile::SyncRestoreFromDisk(
     LOG(ERROR) << "Could not reconstruct index from disk";
     return;
   }
+  // Packed entries have no files of their own.
+  if (small_entry_store) {
+    std::vector<SimpleSmallEntryStore::EntryInfo> packed_entries;
+    small_entry_store->GetEntries(&packed_entries);
+    for (std::vector<SimpleSmallEntryStore::EntryInfo>::const_iterator it =
+             packed_entries.begin();
+         it != packed_entries.end(); ++it) {
+      SimpleIndex::InsertInEntrySet(
+          it->entry_hash, EntryMetadata(it->last_modified, it->size), entries);
+    }
+  }
   out_result->did_load = true;
   // When we restore from disk we write the merged index file to disk right
   // away, this might save us from having to restore again next time.
@@ -9,16 +9,20 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/containers/flat_hash_set.h"
 #include "base/containers/hash_tables.h"
 #include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
 #include "base/pickle.h"
 #include "base/port.h"
 #include "net/base/cache_type.h"
 #include "net/base/net_export.h"
 #include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_index_table.h"
 
 namespace base {
 class SingleThreadTaskRunner;
@@ -27,6 +31,8 @@ class TaskRunner;
 
 namespace disk_cache {
 
+class SimpleSmallEntryStore;
+
 const uint64 kSimpleIndexMagicNumber = GG_UINT64_C(0x656e74657220796f);
 
 struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
@@ -46,6 +52,10 @@ struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
 // see SimpleIndexFile::Serialize() and SeeSimpleIndexFile::LoadFromDisk()
 // methods.
 //
+// With INDEX_FORMAT_TABLE, the index is kept in a SimpleIndexTable instead,
+// and after it has been written or loaded once, writes only update the
+// entries changed in the meantime.
+//
 // The non-static methods must run on the IO thread. All the real
 // work is done in the static methods, which are run on the cache thread
 // or in worker threads. Synchronization between methods is the
@@ -74,11 +84,20 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
     uint64 cache_size_;  // Total cache storage size in bytes.
   };
 
+  enum IndexFormat {
+    INDEX_FORMAT_PICKLE,
+    INDEX_FORMAT_TABLE,
+  };
+
+  // |small_entry_store| is NULL, or holds the packed entries of the cache,
+  // which are added to the index when it is restored from disk.
   SimpleIndexFile(
       const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread,
       const scoped_refptr<base::TaskRunner>& worker_pool,
       net::CacheType cache_type,
-      const base::FilePath& cache_directory);
+      const base::FilePath& cache_directory,
+      SimpleSmallEntryStore* small_entry_store,
+      IndexFormat format);
   virtual ~SimpleIndexFile();
 
   // Get index entries based on current disk context.
@@ -86,8 +105,11 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
                                 const base::Closure& callback,
                                 SimpleIndexLoadResult* out_result);
 
-  // Write the specified set of entries to disk.
+  // Write the specified set of entries to disk. |changed_entries| holds the
+  // hashes of the entries inserted, updated or removed since the previous
+  // call, which is all an index table needs to rewrite.
   virtual void WriteToDisk(const SimpleIndex::EntrySet& entry_set,
+                           const base::FlatHashSet<uint64>& changed_entries,
                            uint64 cache_size,
                            const base::TimeTicks& start,
                            bool app_on_background,
@@ -99,15 +121,18 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   // Used for cache directory traversal.
   typedef base::Callback<void (const base::FilePath&)> EntryFileCallback;
 
-  // When loading the entries from disk, add this many extra hash buckets to
-  // prevent reallocation on the IO thread when merging in new live entries.
+  // When loading the entries from disk, reserve room for this many extra
+  // entries to prevent rehashing on the IO thread when merging in new live
+  // entries.
   static const int kExtraSizeForMerge = 512;
 
   // Synchronous (IO performing) implementation of LoadIndexEntries.
   static void SyncLoadIndexEntries(net::CacheType cache_type,
+                                   IndexFormat format,
                                    base::Time cache_last_modified,
                                    const base::FilePath& cache_directory,
                                    const base::FilePath& index_file_path,
+                                   SimpleSmallEntryStore* small_entry_store,
                                    SimpleIndexLoadResult* out_result);
 
   // Load the index file from disk returning an EntrySet.
@@ -115,6 +140,11 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
                                base::Time* out_last_cache_seen_by_index,
                                SimpleIndexLoadResult* out_result);
 
+  // Load the index table from disk returning an EntrySet.
+  static void SyncLoadFromTable(const base::FilePath& table_filename,
+                                base::Time* out_last_cache_seen_by_index,
+                                SimpleIndexLoadResult* out_result);
+
   // Returns a scoped_ptr for a newly allocated Pickle containing the serialized
   // data to be written to a file. Note: the pickle is not in a consistent state
   // immediately after calling this menthod, one needs to call
@@ -144,19 +174,42 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
       const base::FilePath& cache_path,
       const EntryFileCallback& entry_file_callback);
 
-  // Writes the index file to disk atomically.
+  // Writes the index file to disk atomically. The index written by this and
+  // the following methods records when the cache, including
+  // |small_entry_store| if not NULL, was last changed, to find whether it is
+  // stale when loaded.
   static void SyncWriteToDisk(net::CacheType cache_type,
-                              const base::FilePath& cache_directory,
+                              SimpleSmallEntryStore* small_entry_store,
                               const base::FilePath& index_filename,
                               const base::FilePath& temp_index_filename,
                               scoped_ptr<Pickle> pickle,
                               const base::TimeTicks& start_time,
                               bool app_on_background);
 
+  // Writes the whole index table to disk atomically.
+  static bool SyncWriteTable(
+      net::CacheType cache_type,
+      SimpleSmallEntryStore* small_entry_store,
+      const base::FilePath& table_filename,
+      scoped_ptr<std::vector<SimpleIndexTable::Record> > records,
+      uint64 cache_size,
+      const base::TimeTicks& start_time,
+      bool app_on_background);
+
+  // Writes |changes| to the index table in place.
+  static bool SyncUpdateTable(net::CacheType cache_type,
+                              SimpleSmallEntryStore* small_entry_store,
+                              const base::FilePath& table_filename,
+                              scoped_ptr<SimpleIndexTable::Changes> changes,
+                              uint64 cache_size,
+                              const base::TimeTicks& start_time,
+                              bool app_on_background);
+
   // Scan the index directory for entries, returning an EntrySet of all entries
   // found.
   static void SyncRestoreFromDisk(const base::FilePath& cache_directory,
                                   const base::FilePath& index_file_path,
+                                  SimpleSmallEntryStore* small_entry_store,
                                   SimpleIndexLoadResult* out_result);
 
   // Determines if an index file is stale relative to the time of last
@@ -170,15 +223,28 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
     uint32 crc;
   };
 
+  void OnIndexLoaded(const base::Closure& callback,
+                     SimpleIndexLoadResult* result);
+  void OnTableWritten(const base::Closure& callback, bool succeeded);
+
   const scoped_refptr<base::SingleThreadTaskRunner> cache_thread_;
   const scoped_refptr<base::TaskRunner> worker_pool_;
   const net::CacheType cache_type_;
   const base::FilePath cache_directory_;
+  const scoped_refptr<SimpleSmallEntryStore> small_entry_store_;
   const base::FilePath index_file_;
   const base::FilePath temp_index_file_;
+  const IndexFormat format_;
+
+  // Whether the index table on disk, once the writes posted so far are done,
+  // holds all the entries but those changed since the last write.
+  bool table_in_sync_;
+
+  base::WeakPtrFactory<SimpleIndexFile> weak_ptr_factory_;
 
   static const char kIndexDirectory[];
   static const char kIndexFileName[];
+  static const char kIndexTableFileName[];
   static const char kTempIndexFileName[];
 
   DISALLOW_COPY_AND_ASSIGN(SimpleIndexFile);
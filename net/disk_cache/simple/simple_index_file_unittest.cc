@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+
 #include "base/files/file.h"
 #include "base/files/file_util.h"
 #include "base/files/scoped_temp_dir.h"
@@ -22,6 +24,7 @@
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_index.h"
 #include "net/disk_cache/simple/simple_index_file.h"
+#include "net/disk_cache/simple/simple_small_entry_store.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "net/disk_cache/simple/simple_version_upgrade.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -78,7 +81,9 @@ class WrappedSimpleIndexFile : public SimpleIndexFile {
       : SimpleIndexFile(base::ThreadTaskRunnerHandle::Get(),
                         base::ThreadTaskRunnerHandle::Get(),
                         net::DISK_CACHE,
-                        index_file_directory) {}
+                        index_file_directory,
+                        NULL,
+                        INDEX_FORMAT_PICKLE) {}
   ~WrappedSimpleIndexFile() override {}
 
   const base::FilePath& GetIndexFilePath() const {
@@ -188,8 +193,9 @@ TEST_F(SimpleIndexFileTest, WriteThenLoadIndex) {
   net::TestClosure closure;
   {
     WrappedSimpleIndexFile simple_index_file(cache_dir.path());
-    simple_index_file.WriteToDisk(entries, kCacheSize, base::TimeTicks(),
-                                  false, closure.closure());
+    simple_index_file.WriteToDisk(entries, base::FlatHashSet<uint64>(),
+                                  kCacheSize, base::TimeTicks(), false,
+                                  closure.closure());
     closure.WaitForResult();
     EXPECT_TRUE(base::PathExists(simple_index_file.GetIndexFilePath()));
   }
@@ -238,6 +244,132 @@ TEST_F(SimpleIndexFileTest, LoadCorruptIndex) {
   EXPECT_TRUE(load_index_result.flush_required);
 }
 
+// Tests that restoring the index from disk finds the packed entries.
+TEST_F(SimpleIndexFileTest, RestoreFindsPackedEntries) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  scoped_refptr<SimpleSmallEntryStore> store(new SimpleSmallEntryStore(
+      cache_dir.path(), base::ThreadTaskRunnerHandle::Get()));
+  ASSERT_TRUE(store->Load());
+  const uint64 kHash = 11;
+  SimpleSmallEntryStore::Claim claim;
+  ASSERT_TRUE(store->CreateEntry(kHash, &claim));
+  ASSERT_TRUE(store->WriteAndCloseEntry(kHash, claim, std::string(100, 'x'),
+                                        base::Time::Now()));
+
+  SimpleIndexFile simple_index_file(base::ThreadTaskRunnerHandle::Get(),
+                                    base::ThreadTaskRunnerHandle::Get(),
+                                    net::DISK_CACHE, cache_dir.path(),
+                                    store.get(),
+                                    SimpleIndexFile::INDEX_FORMAT_PICKLE);
+  SimpleIndexLoadResult load_index_result;
+  net::TestClosure closure;
+  simple_index_file.LoadIndexEntries(base::Time::Now(), closure.closure(),
+                                     &load_index_result);
+  closure.WaitForResult();
+
+  EXPECT_TRUE(load_index_result.did_load);
+  ASSERT_EQ(1u, load_index_result.entries.size());
+  EXPECT_EQ(100, load_index_result.entries[kHash].GetEntrySize());
+}
+
+// Tests that an index saved before an entry was packed is stale, although
+// packing the entry did not touch the cache directory.
+TEST_F(SimpleIndexFileTest, PackedEntryMakesIndexStale) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  scoped_refptr<SimpleSmallEntryStore> store(new SimpleSmallEntryStore(
+      cache_dir.path(), base::ThreadTaskRunnerHandle::Get()));
+  ASSERT_TRUE(store->Load());
+
+  SimpleIndexFile simple_index_file(base::ThreadTaskRunnerHandle::Get(),
+                                    base::ThreadTaskRunnerHandle::Get(),
+                                    net::DISK_CACHE, cache_dir.path(),
+                                    store.get(),
+                                    SimpleIndexFile::INDEX_FORMAT_PICKLE);
+  net::TestClosure closure;
+  simple_index_file.WriteToDisk(SimpleIndex::EntrySet(),
+                                base::FlatHashSet<uint64>(), 0,
+                                base::TimeTicks(), false, closure.closure());
+  closure.WaitForResult();
+
+  const uint64 kHash = 11;
+  SimpleSmallEntryStore::Claim claim;
+  ASSERT_TRUE(store->CreateEntry(kHash, &claim));
+  ASSERT_TRUE(store->WriteAndCloseEntry(kHash, claim, std::string(100, 'x'),
+                                        base::Time::Now()));
+
+  // As computed by SimpleBackendImpl::InitCacheStructureOnDisk().
+  base::Time cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_dir.path(), &cache_mtime));
+  cache_mtime = std::max(cache_mtime, store->last_modified());
+  SimpleIndexLoadResult load_index_result;
+  simple_index_file.LoadIndexEntries(cache_mtime, closure.closure(),
+                                     &load_index_result);
+  closure.WaitForResult();
+
+  EXPECT_TRUE(load_index_result.did_load);
+  ASSERT_EQ(1u, load_index_result.entries.size());
+  EXPECT_EQ(100, load_index_result.entries[kHash].GetEntrySize());
+}
+
+// Tests that the index table is written in full first, then only updated with
+// the changed entries.
+TEST_F(SimpleIndexFileTest, WriteThenUpdateIndexTable) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  const base::FilePath index_dir = cache_dir.path().AppendASCII("index-dir");
+
+  SimpleIndex::EntrySet entries;
+  SimpleIndex::InsertInEntrySet(11, EntryMetadata(Time(), 11), &entries);
+  SimpleIndex::InsertInEntrySet(22, EntryMetadata(Time(), 22), &entries);
+  SimpleIndex::InsertInEntrySet(33, EntryMetadata(Time(), 33), &entries);
+
+  net::TestClosure closure;
+  {
+    SimpleIndexFile simple_index_file(base::ThreadTaskRunnerHandle::Get(),
+                                      base::ThreadTaskRunnerHandle::Get(),
+                                      net::DISK_CACHE, cache_dir.path(), NULL,
+                                      SimpleIndexFile::INDEX_FORMAT_TABLE);
+    simple_index_file.WriteToDisk(entries, base::FlatHashSet<uint64>(), 66,
+                                  base::TimeTicks(), false,
+                                  closure.closure());
+    closure.WaitForResult();
+    EXPECT_TRUE(base::PathExists(index_dir.AppendASCII("the-index-table")));
+    EXPECT_FALSE(base::PathExists(index_dir.AppendASCII("the-real-index")));
+
+    base::FlatHashSet<uint64> changed_entries;
+    entries.find(22)->second.SetEntrySize(2222);
+    changed_entries.insert(22);
+    entries.erase(33);
+    changed_entries.insert(33);
+    SimpleIndex::InsertInEntrySet(44, EntryMetadata(Time(), 44), &entries);
+    changed_entries.insert(44);
+    simple_index_file.WriteToDisk(entries, changed_entries, 2277,
+                                  base::TimeTicks(), false,
+                                  closure.closure());
+    closure.WaitForResult();
+  }
+
+  SimpleIndexFile simple_index_file(base::ThreadTaskRunnerHandle::Get(),
+                                    base::ThreadTaskRunnerHandle::Get(),
+                                    net::DISK_CACHE, cache_dir.path(), NULL,
+                                    SimpleIndexFile::INDEX_FORMAT_TABLE);
+  base::Time fake_cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_dir.path(), &fake_cache_mtime));
+  SimpleIndexLoadResult load_index_result;
+  simple_index_file.LoadIndexEntries(fake_cache_mtime, closure.closure(),
+                                     &load_index_result);
+  closure.WaitForResult();
+
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_FALSE(load_index_result.flush_required);
+  ASSERT_EQ(3u, load_index_result.entries.size());
+  EXPECT_EQ(11, load_index_result.entries[11].GetEntrySize());
+  EXPECT_EQ(2222, load_index_result.entries[22].GetEntrySize());
+  EXPECT_EQ(44, load_index_result.entries[44].GetEntrySize());
+}
+
 // Tests that after an upgrade the backend has the index file put in place.
 TEST_F(SimpleIndexFileTest, SimpleCacheUpgrade) {
   base::ScopedTempDir cache_dir;
@@ -0,0 +1,435 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_index_table.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "net/disk_cache/simple/simple_backend_version.h"
+#include "net/disk_cache/simple/simple_util.h"
+#include "third_party/zlib/zlib.h"
+
+using base::File;
+
+namespace disk_cache {
+
+namespace {
+
+const uint64 kTableMagicNumber = GG_UINT64_C(0x3b6e11d0c7a2f594);
+
+// Pages are filled to about half of their capacity when the table is written,
+// so that they rarely run out of room before the table is written again.
+const size_t kRecordsPerPageOnWrite = SimpleIndexTable::kRecordsPerPage / 2;
+
+// Tables claiming more pages than this are considered corrupt.
+const uint32 kMaxPageCount = 1024 * 1024;
+
+// Fills the first page of the file.
+struct TableHeader {
+  uint64 magic_number;
+  uint32 version;
+  uint32 page_count;
+  uint64 entry_count;
+  uint64 cache_size;
+  int64 cache_last_modified;
+  // CRC of the header, with this field set to 0.
+  uint32 crc32;
+  // XOR of the CRCs of all the pages, so that pages and header written by
+  // different updates, e.g. because one was cut short by a crash, do not
+  // match.
+  uint32 pages_checksum;
+};
+COMPILE_ASSERT(sizeof(TableHeader) == 48, table_header_has_padding);
+
+struct PageRecord {
+  uint64 entry_hash;
+  uint32 last_used_seconds_since_epoch;
+  int32 entry_size;
+};
+COMPILE_ASSERT(sizeof(PageRecord) == 16, page_record_has_padding);
+
+struct TablePage {
+  // CRC of the rest of the page.
+  uint32 crc32;
+  uint32 record_count;
+  uint64 unused;
+  // Records past |record_count| are zeroed.
+  PageRecord records[SimpleIndexTable::kRecordsPerPage];
+};
+COMPILE_ASSERT(sizeof(TablePage) == SimpleIndexTable::kPageSize,
+               table_page_must_fill_a_page);
+
+uint32 HeaderCRC(const TableHeader& header) {
+  TableHeader header_without_crc = header;
+  header_without_crc.crc32 = 0;
+  return crc32(crc32(0, Z_NULL, 0),
+               reinterpret_cast<const Bytef*>(&header_without_crc),
+               sizeof(header_without_crc));
+}
+
+uint32 PageCRC(const TablePage& page) {
+  return crc32(crc32(0, Z_NULL, 0),
+               reinterpret_cast<const Bytef*>(&page.record_count),
+               sizeof(page) - offsetof(TablePage, record_count));
+}
+
+bool CheckHeader(const TableHeader& header, int64 file_length) {
+  return header.magic_number == kTableMagicNumber &&
+         header.version == kSimpleVersion &&
+         header.crc32 == HeaderCRC(header) &&
+         header.page_count > 0 && header.page_count <= kMaxPageCount &&
+         file_length ==
+             (1 + static_cast<int64>(header.page_count)) *
+                 SimpleIndexTable::kPageSize;
+}
+
+bool CheckPage(const TablePage& page) {
+  return page.record_count <= SimpleIndexTable::kRecordsPerPage &&
+         page.crc32 == PageCRC(page);
+}
+
+int64 PageOffset(uint32 page_index) {
+  return (1 + static_cast<int64>(page_index)) * SimpleIndexTable::kPageSize;
+}
+
+uint32 PageForHash(uint64 entry_hash, uint32 page_count) {
+  return static_cast<uint32>(entry_hash % page_count);
+}
+
+// The checks run on each page when the table is loaded, which do not hash the
+// whole page; its CRC is verified when an update rewrites it.
+bool QuickCheckPage(const TablePage& page,
+                    uint32 page_index,
+                    uint32 page_count) {
+  if (page.record_count > SimpleIndexTable::kRecordsPerPage)
+    return false;
+  for (uint32 i = 0; i < page.record_count; ++i) {
+    if (PageForHash(page.records[i].entry_hash, page_count) != page_index)
+      return false;
+  }
+  return true;
+}
+
+PageRecord ToPageRecord(const SimpleIndexTable::Record& record) {
+  PageRecord page_record;
+  page_record.entry_hash = record.entry_hash;
+  const base::Time last_used = record.metadata.GetLastUsedTime();
+  page_record.last_used_seconds_since_epoch =
+      last_used.is_null()
+          ? 0
+          : static_cast<uint32>((last_used - base::Time::UnixEpoch())
+                                    .InSeconds());
+  page_record.entry_size = record.metadata.GetEntrySize();
+  return page_record;
+}
+
+EntryMetadata ToEntryMetadata(const PageRecord& page_record) {
+  base::Time last_used;
+  if (page_record.last_used_seconds_since_epoch != 0) {
+    last_used = base::Time::UnixEpoch() +
+                base::TimeDelta::FromSeconds(
+                    page_record.last_used_seconds_since_epoch);
+  }
+  return EntryMetadata(last_used, page_record.entry_size);
+}
+
+class CompareRecordPages {
+ public:
+  explicit CompareRecordPages(uint32 page_count) : page_count_(page_count) {}
+
+  bool operator()(const SimpleIndexTable::Record& a,
+                  const SimpleIndexTable::Record& b) const {
+    return PageForHash(a.entry_hash, page_count_) <
+           PageForHash(b.entry_hash, page_count_);
+  }
+
+ private:
+  uint32 page_count_;
+};
+
+// Sorts |records| by page, and returns false if a page would overflow.
+bool SortRecordsByPage(uint32 page_count,
+                       std::vector<SimpleIndexTable::Record>* records) {
+  std::sort(records->begin(), records->end(), CompareRecordPages(page_count));
+  size_t run_start = 0;
+  for (size_t i = 1; i <= records->size(); ++i) {
+    if (i == records->size() ||
+        PageForHash((*records)[i].entry_hash, page_count) !=
+            PageForHash((*records)[run_start].entry_hash, page_count)) {
+      if (i - run_start > SimpleIndexTable::kRecordsPerPage)
+        return false;
+      run_start = i;
+    }
+  }
+  return true;
+}
+
+// A change to the record of |entry_hash|, which is removed if |metadata| is
+// NULL.
+struct PageChange {
+  uint32 page_index;
+  uint64 entry_hash;
+  const EntryMetadata* metadata;
+
+  bool operator<(const PageChange& other) const {
+    return page_index < other.page_index;
+  }
+};
+
+// Applies |change| to |page|, keeping its records packed at the front.
+// Returns false if |page| has no room for a new record. |entry_count| is
+// adjusted by the number of records added or removed.
+bool ApplyToPage(const PageChange& change,
+                 TablePage* page,
+                 uint64* entry_count) {
+  uint32 i = 0;
+  while (i < page->record_count &&
+         page->records[i].entry_hash != change.entry_hash) {
+    ++i;
+  }
+  const bool found = i < page->record_count;
+
+  if (!change.metadata) {
+    if (found) {
+      --page->record_count;
+      page->records[i] = page->records[page->record_count];
+      memset(&page->records[page->record_count], 0, sizeof(PageRecord));
+      --*entry_count;
+    }
+    return true;
+  }
+
+  if (!found) {
+    if (page->record_count == SimpleIndexTable::kRecordsPerPage)
+      return false;
+    ++page->record_count;
+    ++*entry_count;
+  }
+  SimpleIndexTable::Record record = { change.entry_hash, *change.metadata };
+  page->records[i] = ToPageRecord(record);
+  return true;
+}
+
+bool WriteTableFile(const base::FilePath& path,
+                    const std::vector<SimpleIndexTable::Record>& records,
+                    uint32 page_count,
+                    uint64 cache_size,
+                    base::Time cache_last_modified) {
+  File file(path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE);
+  if (!file.IsValid())
+    return false;
+
+  TableHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic_number = kTableMagicNumber;
+  header.version = kSimpleVersion;
+  header.page_count = page_count;
+  header.entry_count = records.size();
+  header.cache_size = cache_size;
+  header.cache_last_modified = cache_last_modified.ToInternalValue();
+
+  // |records| are sorted by page.
+  std::vector<SimpleIndexTable::Record>::const_iterator it = records.begin();
+  TablePage page;
+  for (uint32 page_index = 0; page_index < page_count; ++page_index) {
+    memset(&page, 0, sizeof(page));
+    while (it != records.end() &&
+           PageForHash(it->entry_hash, page_count) == page_index) {
+      DCHECK_LT(page.record_count,
+                static_cast<uint32>(SimpleIndexTable::kRecordsPerPage));
+      page.records[page.record_count++] = ToPageRecord(*it);
+      ++it;
+    }
+    page.crc32 = PageCRC(page);
+    header.pages_checksum ^= page.crc32;
+    if (file.Write(PageOffset(page_index), reinterpret_cast<char*>(&page),
+                   sizeof(page)) != sizeof(page)) {
+      return false;
+    }
+  }
+  DCHECK(it == records.end());
+
+  char header_page[SimpleIndexTable::kPageSize];
+  memset(header_page, 0, sizeof(header_page));
+  header.crc32 = HeaderCRC(header);
+  memcpy(header_page, &header, sizeof(header));
+  return file.Write(0, header_page, sizeof(header_page)) ==
+         sizeof(header_page);
+}
+
+}  // namespace
+
+const int SimpleIndexTable::kPageSize;
+const int SimpleIndexTable::kRecordsPerPage;
+
+SimpleIndexTable::Changes::Changes() {
+}
+
+SimpleIndexTable::Changes::~Changes() {
+}
+
+// static
+bool SimpleIndexTable::Write(const base::FilePath& path,
+                             const base::FilePath& temp_path,
+                             const std::vector<Record>& records,
+                             uint64 cache_size,
+                             base::Time cache_last_modified) {
+  std::vector<Record> sorted_records(records);
+  uint32 page_count = std::max<uint32>(
+      1, (records.size() + kRecordsPerPageOnWrite - 1) /
+             kRecordsPerPageOnWrite);
+  while (!SortRecordsByPage(page_count, &sorted_records))
+    page_count *= 2;
+
+  if (!WriteTableFile(temp_path, sorted_records, page_count, cache_size,
+                      cache_last_modified)) {
+    LOG(ERROR) << "Failed to write the temporary index table";
+    simple_util::SimpleCacheDeleteFile(temp_path);
+    simple_util::SimpleCacheDeleteFile(path);
+    return false;
+  }
+  if (!base::ReplaceFile(temp_path, path, NULL)) {
+    simple_util::SimpleCacheDeleteFile(path);
+    return false;
+  }
+  return true;
+}
+
+// static
+bool SimpleIndexTable::Update(const base::FilePath& path,
+                              const Changes& changes,
+                              uint64 cache_size,
+                              base::Time cache_last_modified) {
+  File file(path, File::FLAG_OPEN | File::FLAG_READ | File::FLAG_WRITE);
+  if (!file.IsValid())
+    return false;
+
+  TableHeader header;
+  if (file.Read(0, reinterpret_cast<char*>(&header), sizeof(header)) !=
+          sizeof(header) ||
+      !CheckHeader(header, file.GetLength())) {
+    LOG(WARNING) << "Corrupt Simple Index table.";
+    file.Close();
+    simple_util::SimpleCacheDeleteFile(path);
+    return false;
+  }
+
+  std::vector<PageChange> page_changes;
+  page_changes.reserve(changes.updated.size() + changes.removed.size());
+  for (std::vector<Record>::const_iterator it = changes.updated.begin();
+       it != changes.updated.end(); ++it) {
+    PageChange change = { PageForHash(it->entry_hash, header.page_count),
+                          it->entry_hash, &it->metadata };
+    page_changes.push_back(change);
+  }
+  for (std::vector<uint64>::const_iterator it = changes.removed.begin();
+       it != changes.removed.end(); ++it) {
+    PageChange change = { PageForHash(*it, header.page_count), *it, NULL };
+    page_changes.push_back(change);
+  }
+  std::sort(page_changes.begin(), page_changes.end());
+
+  // Rewrite each page that changed once, after applying all its changes.
+  bool succeeded = true;
+  TablePage page;
+  for (std::vector<PageChange>::const_iterator it = page_changes.begin();
+       succeeded && it != page_changes.end();) {
+    const uint32 page_index = it->page_index;
+    const int64 offset = PageOffset(page_index);
+    if (file.Read(offset, reinterpret_cast<char*>(&page), sizeof(page)) !=
+            sizeof(page) ||
+        !CheckPage(page)) {
+      LOG(WARNING) << "Corrupt page in Simple Index table.";
+      succeeded = false;
+      break;
+    }
+    for (; it != page_changes.end() && it->page_index == page_index; ++it) {
+      if (!ApplyToPage(*it, &page, &header.entry_count)) {
+        succeeded = false;
+        break;
+      }
+    }
+    if (!succeeded)
+      break;
+    header.pages_checksum ^= page.crc32;
+    page.crc32 = PageCRC(page);
+    header.pages_checksum ^= page.crc32;
+    succeeded = file.Write(offset, reinterpret_cast<char*>(&page),
+                           sizeof(page)) == sizeof(page);
+  }
+
+  // The header is written last: until it is, the checksum of the pages does
+  // not match, and loading the table fails.
+  if (succeeded) {
+    header.cache_size = cache_size;
+    header.cache_last_modified = cache_last_modified.ToInternalValue();
+    header.crc32 = HeaderCRC(header);
+    succeeded = file.Write(0, reinterpret_cast<char*>(&header),
+                           sizeof(header)) == sizeof(header);
+  }
+  if (!succeeded) {
+    file.Close();
+    simple_util::SimpleCacheDeleteFile(path);
+  }
+  return succeeded;
+}
+
+// static
+bool SimpleIndexTable::Load(const base::FilePath& path,
+                            SimpleIndex::EntrySet* entries,
+                            base::Time* out_cache_last_modified) {
+  DCHECK(entries->empty());
+  File file(path, File::FLAG_OPEN | File::FLAG_READ | File::FLAG_SHARE_DELETE);
+  if (!file.IsValid())
+    return false;
+
+  base::MemoryMappedFile table_map;
+  if (!table_map.Initialize(file.Pass()) || table_map.length() < kPageSize)
+    return false;
+
+  const TableHeader* header =
+      reinterpret_cast<const TableHeader*>(table_map.data());
+  if (!CheckHeader(*header, table_map.length())) {
+    LOG(WARNING) << "Corrupt Simple Index table.";
+    return false;
+  }
+
+  entries->reserve(std::min<uint64>(
+      header->entry_count,
+      static_cast<uint64>(header->page_count) * kRecordsPerPage));
+  uint32 pages_checksum = 0;
+  for (uint32 page_index = 0; page_index < header->page_count; ++page_index) {
+    const TablePage* page = reinterpret_cast<const TablePage*>(
+        table_map.data() + PageOffset(page_index));
+    if (!QuickCheckPage(*page, page_index, header->page_count)) {
+      LOG(WARNING) << "Corrupt page in Simple Index table.";
+      entries->clear();
+      return false;
+    }
+    pages_checksum ^= page->crc32;
+    for (uint32 i = 0; i < page->record_count; ++i) {
+      const PageRecord& record = page->records[i];
+      SimpleIndex::InsertInEntrySet(record.entry_hash,
+                                    ToEntryMetadata(record), entries);
+    }
+  }
+  if (pages_checksum != header->pages_checksum) {
+    LOG(WARNING) << "Simple Index table torn by an interrupted update.";
+    entries->clear();
+    return false;
+  }
+
+  *out_cache_last_modified =
+      base::Time::FromInternalValue(header->cache_last_modified);
+  return true;
+}
+
+}  // namespace disk_cache
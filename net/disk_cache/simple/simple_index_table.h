@@ -0,0 +1,86 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_index.h"
+
+namespace base {
+class FilePath;
+}
+
+namespace disk_cache {
+
+// SimpleIndexTable is an index file format that, unlike the pickle written by
+// SimpleIndexFile, can be updated in place. The file is a header page followed
+// by |page_count| pages of fixed-size records, and each entry is kept in the
+// page selected by its hash. Writing the entries changed since the last write
+// therefore only rewrites the pages that hold them, and the header.
+//
+// Every page carries a CRC of its records, and the header a checksum of the
+// CRCs of all the pages, which is written after the pages. A table torn by an
+// interrupted update therefore fails to load, and the index is restored from
+// the entry files instead. Loading the table validates the header and that
+// checksum, and only sanity checks the records of each page as they are read
+// out of the memory-mapped file; the CRC of a page is verified when an update
+// next rewrites it.
+//
+// All the functions block on file I/O, and must run on the cache thread or in
+// worker threads.
+class NET_EXPORT_PRIVATE SimpleIndexTable {
+ public:
+  struct Record {
+    uint64 entry_hash;
+    EntryMetadata metadata;
+  };
+
+  // The entries changed since the table was last written.
+  struct NET_EXPORT_PRIVATE Changes {
+    Changes();
+    ~Changes();
+
+    std::vector<Record> updated;
+    std::vector<uint64> removed;
+  };
+
+  static const int kPageSize = 4096;
+  static const int kRecordsPerPage = 255;
+
+  // Writes a table of |records| to |temp_path| and renames it to |path|.
+  // |cache_last_modified| is the modification time of the cache directory
+  // the records reflect. On failure, deletes |path| and returns false.
+  static bool Write(const base::FilePath& path,
+                    const base::FilePath& temp_path,
+                    const std::vector<Record>& records,
+                    uint64 cache_size,
+                    base::Time cache_last_modified);
+
+  // Applies |changes| to the table at |path|, rewriting only the pages they
+  // fall in, then the header. Fails if the table is missing or corrupt, or if
+  // a page has no room left for a new record; the table is then deleted, so
+  // that it has to be written in full again.
+  static bool Update(const base::FilePath& path,
+                     const Changes& changes,
+                     uint64 cache_size,
+                     base::Time cache_last_modified);
+
+  // Reads the table at |path| into |entries|. Returns false, leaving
+  // |entries| empty, if the table is missing or corrupt.
+  static bool Load(const base::FilePath& path,
+                   SimpleIndex::EntrySet* entries,
+                   base::Time* out_cache_last_modified);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(SimpleIndexTable);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
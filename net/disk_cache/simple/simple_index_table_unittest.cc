@@ -0,0 +1,226 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_index_table.h"
+
+#include <string>
+#include <vector>
+
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const base::Time kCacheTime =
+    base::Time::UnixEpoch() + base::TimeDelta::FromDays(1000);
+
+SimpleIndexTable::Record MakeRecord(uint64 entry_hash, int entry_size) {
+  base::Time last_used;
+  // Some entries have a null last used time.
+  if (entry_hash % 7) {
+    last_used =
+        kCacheTime - base::TimeDelta::FromSeconds(entry_hash % 100000);
+  }
+  SimpleIndexTable::Record record = {
+    entry_hash, EntryMetadata(last_used, entry_size)
+  };
+  return record;
+}
+
+// Returns well-spread hashes, as the hashes of keys are.
+uint64 HashAt(int i) {
+  return (i + 1) * GG_UINT64_C(0x9e3779b97f4a7c15);
+}
+
+class SimpleIndexTableTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("table");
+    temp_path_ = temp_dir_.path().AppendASCII("temp");
+  }
+
+  bool Write(const std::vector<SimpleIndexTable::Record>& records) {
+    return SimpleIndexTable::Write(path_, temp_path_, records, 1234,
+                                   kCacheTime);
+  }
+
+  // Checks that the table at |path_| holds exactly |records|.
+  void ExpectTableHolds(const std::vector<SimpleIndexTable::Record>& records) {
+    SimpleIndex::EntrySet entries;
+    base::Time cache_last_modified;
+    ASSERT_TRUE(SimpleIndexTable::Load(path_, &entries, &cache_last_modified));
+    EXPECT_EQ(kCacheTime, cache_last_modified);
+    EXPECT_EQ(records.size(), entries.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+      SimpleIndex::EntrySet::const_iterator it =
+          entries.find(records[i].entry_hash);
+      ASSERT_TRUE(it != entries.end());
+      EXPECT_EQ(records[i].metadata.GetLastUsedTime(),
+                it->second.GetLastUsedTime());
+      EXPECT_EQ(records[i].metadata.GetEntrySize(),
+                it->second.GetEntrySize());
+    }
+  }
+
+  void CorruptByteAt(int64 offset) {
+    base::File file(path_, base::File::FLAG_OPEN | base::File::FLAG_READ |
+                               base::File::FLAG_WRITE);
+    ASSERT_TRUE(file.IsValid());
+    char byte;
+    ASSERT_EQ(1, file.Read(offset, &byte, 1));
+    byte ^= 0x55;
+    ASSERT_EQ(1, file.Write(offset, &byte, 1));
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath path_;
+  base::FilePath temp_path_;
+};
+
+}  // namespace
+
+TEST_F(SimpleIndexTableTest, WriteThenLoad) {
+  std::vector<SimpleIndexTable::Record> records;
+  ASSERT_TRUE(Write(records));
+  ExpectTableHolds(records);
+
+  for (int i = 0; i < 1000; ++i)
+    records.push_back(MakeRecord(HashAt(i), i));
+  ASSERT_TRUE(Write(records));
+  EXPECT_FALSE(base::PathExists(temp_path_));
+  ExpectTableHolds(records);
+}
+
+TEST_F(SimpleIndexTableTest, UpdateInPlace) {
+  std::vector<SimpleIndexTable::Record> records;
+  for (int i = 0; i < 1000; ++i)
+    records.push_back(MakeRecord(HashAt(i), i));
+  ASSERT_TRUE(Write(records));
+  int64 size;
+  ASSERT_TRUE(base::GetFileSize(path_, &size));
+
+  SimpleIndexTable::Changes changes;
+  std::vector<SimpleIndexTable::Record> expected;
+  for (int i = 0; i < 1000; ++i) {
+    if (i % 3 == 0) {
+      changes.removed.push_back(HashAt(i));
+    } else if (i % 3 == 1) {
+      changes.updated.push_back(MakeRecord(HashAt(i), i * 10));
+      expected.push_back(changes.updated.back());
+    } else {
+      expected.push_back(records[i]);
+    }
+  }
+  for (int i = 1000; i < 1100; ++i) {
+    changes.updated.push_back(MakeRecord(HashAt(i), i));
+    expected.push_back(changes.updated.back());
+  }
+  // Removing an entry the table does not hold is not an error.
+  changes.removed.push_back(HashAt(5000));
+
+  ASSERT_TRUE(SimpleIndexTable::Update(path_, changes, 4321, kCacheTime));
+  int64 updated_size;
+  ASSERT_TRUE(base::GetFileSize(path_, &updated_size));
+  EXPECT_EQ(size, updated_size);
+  ExpectTableHolds(expected);
+}
+
+TEST_F(SimpleIndexTableTest, UpdateOverflowDeletesTable) {
+  std::vector<SimpleIndexTable::Record> records;
+  records.push_back(MakeRecord(HashAt(0), 0));
+  ASSERT_TRUE(Write(records));
+
+  // A one-entry table has a single page, which cannot take as many entries.
+  SimpleIndexTable::Changes changes;
+  for (int i = 1; i <= SimpleIndexTable::kRecordsPerPage; ++i)
+    changes.updated.push_back(MakeRecord(HashAt(i), i));
+  EXPECT_FALSE(SimpleIndexTable::Update(path_, changes, 0, kCacheTime));
+  EXPECT_FALSE(base::PathExists(path_));
+  EXPECT_FALSE(SimpleIndexTable::Update(path_, changes, 0, kCacheTime));
+
+  // Written in full, the table gets enough pages.
+  records.insert(records.end(), changes.updated.begin(),
+                 changes.updated.end());
+  ASSERT_TRUE(Write(records));
+  ExpectTableHolds(records);
+}
+
+TEST_F(SimpleIndexTableTest, CorruptPage) {
+  std::vector<SimpleIndexTable::Record> records;
+  for (int i = 0; i < 1000; ++i)
+    records.push_back(MakeRecord(HashAt(i), i));
+  ASSERT_TRUE(Write(records));
+
+  // A record whose hash does not belong in its page is noticed on load.
+  const int64 kFirstRecordOfSecondPage = 2 * SimpleIndexTable::kPageSize + 16;
+  CorruptByteAt(kFirstRecordOfSecondPage);
+  SimpleIndex::EntrySet entries;
+  base::Time cache_last_modified;
+  EXPECT_FALSE(SimpleIndexTable::Load(path_, &entries, &cache_last_modified));
+  EXPECT_TRUE(entries.empty());
+
+  // Other damage to the records of a page is only found when the page is next
+  // updated; the update then fails, and deletes the table.
+  CorruptByteAt(kFirstRecordOfSecondPage);
+  CorruptByteAt(kFirstRecordOfSecondPage + 12);
+  SimpleIndexTable::Changes changes;
+  for (int i = 0; i < 1000; ++i)
+    changes.removed.push_back(HashAt(i));
+  EXPECT_FALSE(SimpleIndexTable::Update(path_, changes, 0, kCacheTime));
+  EXPECT_FALSE(base::PathExists(path_));
+}
+
+// Tests that a table whose pages and header were written by different updates,
+// as when an update is cut short, fails to load.
+TEST_F(SimpleIndexTableTest, TornUpdate) {
+  std::vector<SimpleIndexTable::Record> records;
+  for (int i = 0; i < 1000; ++i)
+    records.push_back(MakeRecord(HashAt(i), i));
+  ASSERT_TRUE(Write(records));
+  std::string old_table;
+  ASSERT_TRUE(base::ReadFileToString(path_, &old_table));
+
+  SimpleIndexTable::Changes changes;
+  changes.updated.push_back(MakeRecord(HashAt(1), 1000000));
+  ASSERT_TRUE(SimpleIndexTable::Update(path_, changes, 4321, kCacheTime));
+
+  // Put back the header from before the update.
+  {
+    base::File file(path_, base::File::FLAG_OPEN | base::File::FLAG_WRITE);
+    ASSERT_TRUE(file.IsValid());
+    ASSERT_EQ(SimpleIndexTable::kPageSize,
+              file.Write(0, old_table.data(), SimpleIndexTable::kPageSize));
+  }
+  SimpleIndex::EntrySet entries;
+  base::Time cache_last_modified;
+  EXPECT_FALSE(SimpleIndexTable::Load(path_, &entries, &cache_last_modified));
+  EXPECT_TRUE(entries.empty());
+}
+
+TEST_F(SimpleIndexTableTest, CorruptHeader) {
+  std::vector<SimpleIndexTable::Record> records;
+  records.push_back(MakeRecord(HashAt(0), 0));
+  ASSERT_TRUE(Write(records));
+  CorruptByteAt(20);
+
+  SimpleIndex::EntrySet entries;
+  base::Time cache_last_modified;
+  EXPECT_FALSE(SimpleIndexTable::Load(path_, &entries, &cache_last_modified));
+
+  ASSERT_TRUE(Write(records));
+  {
+    base::File file(path_, base::File::FLAG_OPEN | base::File::FLAG_WRITE);
+    ASSERT_TRUE(file.SetLength(SimpleIndexTable::kPageSize));
+  }
+  EXPECT_FALSE(SimpleIndexTable::Load(path_, &entries, &cache_last_modified));
+}
+
+}  // namespace disk_cache
@@ -52,7 +52,8 @@ class MockSimpleIndexFile : public SimpleIndexFile,
                             public base::SupportsWeakPtr<MockSimpleIndexFile> {
  public:
   MockSimpleIndexFile()
-      : SimpleIndexFile(NULL, NULL, net::DISK_CACHE, base::FilePath()),
+      : SimpleIndexFile(NULL, NULL, net::DISK_CACHE, base::FilePath(), NULL,
+                        INDEX_FORMAT_PICKLE),
         load_result_(NULL),
         load_index_entries_calls_(0),
         disk_writes_(0) {}
@@ -66,18 +67,24 @@ class MockSimpleIndexFile : public SimpleIndexFile,
   }
 
   void WriteToDisk(const SimpleIndex::EntrySet& entry_set,
+                   const base::FlatHashSet<uint64>& changed_entries,
                    uint64 cache_size,
                    const base::TimeTicks& start,
                    bool app_on_background,
                    const base::Closure& callback) override {
     disk_writes_++;
     disk_write_entry_set_ = entry_set;
+    disk_write_changed_entries_ = changed_entries;
   }
 
   void GetAndResetDiskWriteEntrySet(SimpleIndex::EntrySet* entry_set) {
     entry_set->swap(disk_write_entry_set_);
   }
 
+  const base::FlatHashSet<uint64>& disk_write_changed_entries() const {
+    return disk_write_changed_entries_;
+  }
+
   const base::Closure& load_callback() const { return load_callback_; }
   SimpleIndexLoadResult* load_result() const { return load_result_; }
   int load_index_entries_calls() const { return load_index_entries_calls_; }
@@ -89,6 +96,7 @@ class MockSimpleIndexFile : public SimpleIndexFile,
   int load_index_entries_calls_;
   int disk_writes_;
   SimpleIndex::EntrySet disk_write_entry_set_;
+  base::FlatHashSet<uint64> disk_write_changed_entries_;
 };
 
 class SimpleIndexTest  : public testing::Test, public SimpleIndexDelegate {
@@ -625,4 +633,33 @@ TEST_F(SimpleIndexTest, DiskWritePostponed) {
   index()->write_to_disk_timer_.Stop();
 }
 
+// Each write is told about the entries changed since the previous one,
+// including the changes made before the index was loaded.
+TEST_F(SimpleIndexTest, DiskWriteChangedEntries) {
+  index()->SetMaxSize(1000);
+  index()->Insert(hashes_.at<1>());
+  InsertIntoIndexFileReturn(hashes_.at<2>(), base::Time::Now(), 10);
+  InsertIntoIndexFileReturn(hashes_.at<3>(), base::Time::Now(), 10);
+  InsertIntoIndexFileReturn(hashes_.at<4>(), base::Time::Now(), 10);
+  ReturnIndexFile();
+
+  index()->UseIfExists(hashes_.at<2>());
+  index()->Remove(hashes_.at<3>());
+  index()->WriteToDisk();
+  EXPECT_EQ(1, index_file_->disk_writes());
+  const base::FlatHashSet<uint64>& changed_entries =
+      index_file_->disk_write_changed_entries();
+  EXPECT_EQ(3u, changed_entries.size());
+  EXPECT_EQ(1u, changed_entries.count(hashes_.at<1>()));
+  EXPECT_EQ(1u, changed_entries.count(hashes_.at<2>()));
+  EXPECT_EQ(1u, changed_entries.count(hashes_.at<3>()));
+
+  index()->UpdateEntrySize(hashes_.at<4>(), 20);
+  index()->WriteToDisk();
+  EXPECT_EQ(2, index_file_->disk_writes());
+  EXPECT_EQ(1u, index_file_->disk_write_changed_entries().size());
+  EXPECT_EQ(1u,
+            index_file_->disk_write_changed_entries().count(hashes_.at<4>()));
+}
+
 }  // namespace disk_cache
@@ -0,0 +1,141 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_io_engine.h"
+
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/thread_restrictions.h"
+
+namespace disk_cache {
+
+class SimpleIOEngine::Worker : public base::DelegateSimpleThread::Delegate {
+ public:
+  explicit Worker(SimpleIOEngine* engine) : engine_(engine) {}
+
+  // base::DelegateSimpleThread::Delegate:
+  void Run() override { engine_->RunWorker(); }
+
+ private:
+  SimpleIOEngine* const engine_;
+
+  DISALLOW_COPY_AND_ASSIGN(Worker);
+};
+
+SimpleIOEngine::SimpleIOEngine(int num_threads,
+                               const std::string& thread_name_prefix)
+    : work_available_(&lock_),
+      idle_(&lock_),
+      idle_workers_(0),
+      pending_wakeups_(0),
+      running_tasks_(0),
+      shutting_down_(false) {
+  DCHECK_GT(num_threads, 0);
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.push_back(new Worker(this));
+    threads_.push_back(new base::DelegateSimpleThread(
+        workers_.back(), thread_name_prefix + base::IntToString(i)));
+    threads_.back()->Start();
+  }
+}
+
+SimpleIOEngine::~SimpleIOEngine() {
+  DCHECK(threads_.empty());
+}
+
+void SimpleIOEngine::Shutdown() {
+  {
+    base::AutoLock auto_lock(lock_);
+    DCHECK(!shutting_down_);
+    shutting_down_ = true;
+    work_available_.Broadcast();
+  }
+  for (size_t i = 0; i < threads_.size(); ++i)
+    threads_[i]->Join();
+  threads_.clear();
+  workers_.clear();
+}
+
+void SimpleIOEngine::FlushForTesting() {
+  base::AutoLock auto_lock(lock_);
+  while (!queue_.empty() || running_tasks_ > 0)
+    idle_.Wait();
+}
+
+bool SimpleIOEngine::PostDelayedTask(const tracked_objects::Location& from_here,
+                                     const base::Closure& task,
+                                     base::TimeDelta delay) {
+  // Entries never delay their file operations.
+  if (delay > base::TimeDelta()) {
+    NOTREACHED();
+    return false;
+  }
+
+  base::AutoLock auto_lock(lock_);
+  if (shutting_down_)
+    return false;
+  queue_.push_back(task);
+  MaybeWakeWorker();
+  return true;
+}
+
+bool SimpleIOEngine::RunsTasksOnCurrentThread() const {
+  const base::PlatformThreadId current_thread =
+      base::PlatformThread::CurrentId();
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    if (threads_[i]->tid() == current_thread)
+      return true;
+  }
+  return false;
+}
+
+void SimpleIOEngine::RunWorker() {
+  // Entry operations block on file I/O by design.
+  base::ThreadRestrictions::SetIOAllowed(true);
+
+  bool ran_task = false;
+  while (true) {
+    base::Closure task;
+    {
+      base::AutoLock auto_lock(lock_);
+      if (ran_task) {
+        --running_tasks_;
+        if (running_tasks_ == 0 && queue_.empty())
+          idle_.Broadcast();
+      }
+
+      while (queue_.empty() && !shutting_down_) {
+        ++idle_workers_;
+        work_available_.Wait();
+        --idle_workers_;
+        if (pending_wakeups_ > 0)
+          --pending_wakeups_;
+      }
+      if (queue_.empty())
+        return;
+
+      task = queue_.front();
+      queue_.pop_front();
+      ++running_tasks_;
+      if (!queue_.empty())
+        MaybeWakeWorker();
+    }
+
+    task.Run();
+    // Destroy the task outside of |lock_|, since that may post new ones.
+    task.Reset();
+    ran_task = true;
+  }
+}
+
+void SimpleIOEngine::MaybeWakeWorker() {
+  lock_.AssertAcquired();
+  if (pending_wakeups_ > 0 || idle_workers_ == 0)
+    return;
+  ++pending_wakeups_;
+  work_available_.Signal();
+}
+
+}  // namespace disk_cache
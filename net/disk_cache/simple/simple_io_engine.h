@@ -0,0 +1,86 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_IO_ENGINE_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_IO_ENGINE_H_
+
+#include <deque>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/memory/scoped_vector.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/task_runner.h"
+#include "base/threading/simple_thread.h"
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+
+// SimpleIOEngine runs the blocking file operations of simple cache entries on
+// a small, fixed number of threads. It is an alternative to the
+// SequencedWorkerPool the backend uses by default, which may grow to dozens
+// of threads and wakes one of them for every operation.
+//
+// A thread of the engine keeps taking queued operations until the queue is
+// empty, and only then sleeps. At most one sleeping thread is being woken up
+// at any time: it wakes the next one if operations are still queued once it
+// has taken one. A burst of small operations served from the page cache,
+// which is the common case, is therefore drained by the threads that are
+// already running instead of costing a wakeup each, while operations that
+// block on the disk still leave the other threads to make progress.
+//
+// Entries never have more than one operation in flight, so running their
+// operations on any thread, in any order, keeps their semantics.
+class NET_EXPORT_PRIVATE SimpleIOEngine : public base::TaskRunner {
+ public:
+  SimpleIOEngine(int num_threads, const std::string& thread_name_prefix);
+
+  // Runs the tasks that are already queued, then stops and joins the threads.
+  // Later tasks are dropped. The engine must be shut down before its last
+  // reference is released, unless it is leaked.
+  void Shutdown();
+
+  // Blocks until all the tasks posted so far have run.
+  void FlushForTesting();
+
+  // base::TaskRunner:
+  bool PostDelayedTask(const tracked_objects::Location& from_here,
+                       const base::Closure& task,
+                       base::TimeDelta delay) override;
+  bool RunsTasksOnCurrentThread() const override;
+
+ private:
+  class Worker;
+
+  ~SimpleIOEngine() override;
+
+  // Runs tasks until the engine shuts down.
+  void RunWorker();
+
+  // Wakes up a sleeping thread, unless one is being woken up already.
+  void MaybeWakeWorker();
+
+  base::Lock lock_;
+  // Signaled when tasks are queued, and on shutdown.
+  base::ConditionVariable work_available_;
+  // Signaled when the queue empties and no task runs.
+  base::ConditionVariable idle_;
+  std::deque<base::Closure> queue_;
+  int idle_workers_;
+  // Number of signals of |work_available_| not yet received by a worker.
+  int pending_wakeups_;
+  int running_tasks_;
+  bool shutting_down_;
+
+  ScopedVector<Worker> workers_;
+  ScopedVector<base::DelegateSimpleThread> threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleIOEngine);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_IO_ENGINE_H_
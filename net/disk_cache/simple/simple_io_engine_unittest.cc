@@ -0,0 +1,125 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_io_engine.h"
+
+#include "base/atomicops.h"
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/memory/ref_counted.h"
+#include "base/run_loop.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+void Increment(base::subtle::Atomic32* count) {
+  base::subtle::NoBarrier_AtomicIncrement(count, 1);
+}
+
+void CheckRunsOnEngine(scoped_refptr<SimpleIOEngine> engine, bool* result) {
+  *result = engine->RunsTasksOnCurrentThread();
+}
+
+void SetTrue(bool* flag) {
+  *flag = true;
+}
+
+void Reply(bool* replied, base::RunLoop* run_loop) {
+  *replied = true;
+  run_loop->Quit();
+}
+
+void WaitFor(base::WaitableEvent* event) {
+  event->Wait();
+}
+
+void PostFromTask(scoped_refptr<SimpleIOEngine> engine,
+                  base::subtle::Atomic32* count) {
+  engine->PostTask(FROM_HERE, base::Bind(&Increment, count));
+}
+
+class SimpleIOEngineTest : public testing::Test {
+ protected:
+  SimpleIOEngineTest() : engine_(new SimpleIOEngine(3, "SimpleIOEngineTest")) {}
+  ~SimpleIOEngineTest() override {
+    if (engine_.get())
+      engine_->Shutdown();
+  }
+
+  scoped_refptr<SimpleIOEngine> engine_;
+};
+
+}  // namespace
+
+TEST_F(SimpleIOEngineTest, RunsAllTasks) {
+  base::subtle::Atomic32 count = 0;
+  const int kNumTasks = 1000;
+  for (int i = 0; i < kNumTasks; ++i)
+    EXPECT_TRUE(engine_->PostTask(FROM_HERE, base::Bind(&Increment, &count)));
+  engine_->FlushForTesting();
+  EXPECT_EQ(kNumTasks, base::subtle::NoBarrier_Load(&count));
+}
+
+TEST_F(SimpleIOEngineTest, FlushWaitsForTasksPostedByTasks) {
+  base::subtle::Atomic32 count = 0;
+  for (int i = 0; i < 100; ++i) {
+    engine_->PostTask(FROM_HERE,
+                      base::Bind(&PostFromTask, engine_, &count));
+  }
+  engine_->FlushForTesting();
+  EXPECT_EQ(100, base::subtle::NoBarrier_Load(&count));
+}
+
+TEST_F(SimpleIOEngineTest, RunsTasksOnCurrentThread) {
+  EXPECT_FALSE(engine_->RunsTasksOnCurrentThread());
+  bool on_engine = false;
+  engine_->PostTask(FROM_HERE,
+                    base::Bind(&CheckRunsOnEngine, engine_, &on_engine));
+  engine_->FlushForTesting();
+  EXPECT_TRUE(on_engine);
+}
+
+TEST_F(SimpleIOEngineTest, PostTaskAndReply) {
+  bool ran = false;
+  bool replied = false;
+  base::RunLoop run_loop;
+  EXPECT_TRUE(engine_->PostTaskAndReply(
+      FROM_HERE, base::Bind(&SetTrue, &ran),
+      base::Bind(&Reply, &replied, &run_loop)));
+  run_loop.Run();
+  EXPECT_TRUE(ran);
+  EXPECT_TRUE(replied);
+}
+
+// A task that blocks one thread must not hold up the tasks queued after it.
+TEST_F(SimpleIOEngineTest, BlockedTaskDoesNotStallOthers) {
+  base::WaitableEvent event(true, false);
+  base::subtle::Atomic32 count = 0;
+  engine_->PostTask(FROM_HERE, base::Bind(&WaitFor, &event));
+  for (int i = 0; i < 100; ++i)
+    engine_->PostTask(FROM_HERE, base::Bind(&Increment, &count));
+
+  while (base::subtle::NoBarrier_Load(&count) < 100)
+    base::PlatformThread::YieldCurrentThread();
+  event.Signal();
+  engine_->FlushForTesting();
+}
+
+TEST_F(SimpleIOEngineTest, ShutdownRunsQueuedTasks) {
+  base::subtle::Atomic32 count = 0;
+  for (int i = 0; i < 100; ++i)
+    engine_->PostTask(FROM_HERE, base::Bind(&Increment, &count));
+  engine_->Shutdown();
+  EXPECT_EQ(100, base::subtle::NoBarrier_Load(&count));
+
+  EXPECT_FALSE(engine_->PostTask(FROM_HERE, base::Bind(&Increment, &count)));
+  EXPECT_EQ(100, base::subtle::NoBarrier_Load(&count));
+  engine_ = NULL;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,808 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_small_entry_store.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/bind.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/task_runner.h"
+#include "net/disk_cache/simple/simple_util.h"
+#include "third_party/zlib/zlib.h"
+
+namespace disk_cache {
+
+namespace {
+
+const uint32 kRecordMagicNumber = 0x5e9c4a17;
+const uint64 kHintFileMagicNumber = GG_UINT64_C(0x8d4f3bd2e16a07c5);
+const uint32 kHintFileVersion = 1;
+
+const char kSegmentFilePrefix[] = "segment_";
+const char kHintFilePrefix[] = "hint_";
+
+// Precedes the data of each record in a segment file.
+struct RecordHeader {
+  uint32 magic_number;
+  // Size of the data following the header; 0 for a removal record.
+  uint32 size;
+  uint64 entry_hash;
+  int64 last_modified;
+  // CRC of the header, with this field set to 0, and of the data.
+  uint32 crc32;
+  uint32 unused;
+};
+COMPILE_ASSERT(sizeof(RecordHeader) == 32, record_header_has_padding);
+
+struct HintFileHeader {
+  uint64 magic_number;
+  uint32 version;
+  uint32 record_count;
+  // Size of the segment when it was sealed.
+  int64 segment_size;
+  // CRC of the records following the header.
+  uint32 crc32;
+  uint32 unused;
+};
+COMPILE_ASSERT(sizeof(HintFileHeader) == 32, hint_file_header_has_padding);
+
+uint32 RecordCRC(const RecordHeader& header, const char* data, int size) {
+  RecordHeader header_without_crc = header;
+  header_without_crc.crc32 = 0;
+  uint32 crc = crc32(0, Z_NULL, 0);
+  crc = crc32(crc, reinterpret_cast<const Bytef*>(&header_without_crc),
+              sizeof(header_without_crc));
+  if (size > 0)
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(data), size);
+  return crc;
+}
+
+int64 RecordBytes(uint32 size) {
+  return sizeof(RecordHeader) + static_cast<int64>(size);
+}
+
+// Without its hint file, a segment is scanned by the next Load().
+void WriteHintFile(const base::FilePath& path, const std::string& hint) {
+  if (base::WriteFile(path, hint.data(), hint.size()) !=
+      static_cast<int>(hint.size())) {
+    DLOG(WARNING) << "Could not write small entry hint file.";
+  }
+}
+
+}  // namespace
+
+const int SimpleSmallEntryStore::kMaxFileSize;
+const int64 SimpleSmallEntryStore::kMaxSegmentSize;
+const char SimpleSmallEntryStore::kSegmentDirectoryName[] = "small-entries";
+
+SimpleSmallEntryStore::Segment::Segment()
+    : size(0), live_bytes(0), pending_writes(0), sealed(false) {}
+
+SimpleSmallEntryStore::Segment::~Segment() {}
+
+SimpleSmallEntryStore::PendingRecord::PendingRecord() : segment_id(0) {}
+
+SimpleSmallEntryStore::PendingRecord::~PendingRecord() {}
+
+SimpleSmallEntryStore::SimpleSmallEntryStore(
+    const base::FilePath& cache_directory,
+    const scoped_refptr<base::TaskRunner>& worker_pool)
+    : directory_(cache_directory.AppendASCII(kSegmentDirectoryName)),
+      worker_pool_(worker_pool),
+      max_segment_size_(kMaxSegmentSize),
+      loaded_(false),
+      next_claim_(1),
+      total_bytes_(0),
+      live_bytes_(0),
+      compaction_pending_(false) {}
+
+SimpleSmallEntryStore::~SimpleSmallEntryStore() {}
+
+bool SimpleSmallEntryStore::Load() {
+  // Nothing else uses the store until it is loaded, so the segments are read
+  // with |lock_| held.
+  base::AutoLock auto_lock(lock_);
+  DCHECK(!loaded_);
+  if (!base::CreateDirectory(directory_)) {
+    LOG(ERROR) << "Could not create small entry directory.";
+    return false;
+  }
+
+  std::vector<uint32> segment_ids;
+  base::FileEnumerator enumerator(directory_, false /* recursive */,
+                                  base::FileEnumerator::FILES);
+  for (base::FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    const std::string name = path.BaseName().MaybeAsASCII();
+    uint32 segment_id;
+    if (StartsWithASCII(name, kSegmentFilePrefix, true) &&
+        base::StringToUint(name.substr(arraysize(kSegmentFilePrefix) - 1),
+                           &segment_id)) {
+      segment_ids.push_back(segment_id);
+    }
+  }
+  std::sort(segment_ids.begin(), segment_ids.end());
+
+  for (size_t i = 0; i < segment_ids.size(); ++i) {
+    const uint32 segment_id = segment_ids[i];
+    scoped_refptr<Segment> segment(new Segment);
+    segment->file.Initialize(GetSegmentPath(segment_id),
+                             base::File::FLAG_OPEN | base::File::FLAG_READ |
+                                 base::File::FLAG_WRITE |
+                                 base::File::FLAG_SHARE_DELETE);
+    if (!segment->file.IsValid()) {
+      LOG(WARNING) << "Could not open small entry segment " << segment_id;
+      continue;
+    }
+    segment->size = segment->file.GetLength();
+    base::File::Info info;
+    if (segment->file.GetInfo(&info))
+      last_modified_ = std::max(last_modified_, info.last_modified);
+
+    std::vector<HintRecord> records;
+    if (ReadHintFile(segment_id, *segment.get(), &records)) {
+      segment->sealed = true;
+    } else if (!ScanSegment(segment.get(), &records)) {
+      LOG(WARNING) << "Could not read small entry segment " << segment_id;
+      continue;
+    }
+    segments_[segment_id] = segment;
+    for (size_t j = 0; j < records.size(); ++j)
+      ApplyRecord(segment_id, records[j]);
+    segment->records.swap(records);
+  }
+
+  // Only the last segment may be appended to; one left unsealed by a crash
+  // before the next segment was started gets its hint file now.
+  for (SegmentMap::iterator it = segments_.begin(); it != segments_.end();
+       ++it) {
+    if (!it->second->sealed && it->first != segments_.rbegin()->first) {
+      base::FilePath hint_path;
+      std::string hint;
+      SealSegmentLocked(it->first, it->second.get(), &hint_path, &hint);
+      WriteHintFile(hint_path, hint);
+    }
+  }
+
+  loaded_ = true;
+  MaybeScheduleCompaction();
+  return true;
+}
+
+bool SimpleSmallEntryStore::loaded() const {
+  base::AutoLock auto_lock(lock_);
+  return loaded_;
+}
+
+void SimpleSmallEntryStore::GetEntries(std::vector<EntryInfo>* entries) const {
+  base::AutoLock auto_lock(lock_);
+  entries->reserve(entries->size() + locations_.size());
+  for (base::FlatHashMap<uint64, Location>::const_iterator it =
+           locations_.begin();
+       it != locations_.end(); ++it) {
+    EntryInfo info;
+    info.entry_hash = it->first;
+    info.last_modified =
+        base::Time::FromInternalValue(it->second.last_modified);
+    info.size = it->second.size;
+    entries->push_back(info);
+  }
+}
+
+bool SimpleSmallEntryStore::OpenEntry(uint64 entry_hash,
+                                      std::string* file_data,
+                                      base::Time* out_last_modified,
+                                      Claim* out_claim) {
+  while (true) {
+    Location location;
+    scoped_refptr<Segment> segment;
+    {
+      base::AutoLock auto_lock(lock_);
+      base::FlatHashMap<uint64, Location>::const_iterator it =
+          locations_.find(entry_hash);
+      if (it == locations_.end())
+        return false;
+      location = it->second;
+      segment = segments_[location.segment_id];
+    }
+
+    // Read the header and the data in one go.
+    std::string record(RecordBytes(location.size), '\0');
+    RecordHeader header;
+    bool valid = segment->file.Read(location.offset, &record[0],
+                                    record.size()) ==
+                 static_cast<int>(record.size());
+    const char* data = record.data() + sizeof(header);
+    if (valid) {
+      memcpy(&header, record.data(), sizeof(header));
+      valid = header.magic_number == kRecordMagicNumber &&
+              header.entry_hash == entry_hash &&
+              header.size == location.size &&
+              header.crc32 == RecordCRC(header, data, header.size);
+    }
+
+    PendingRecord removal;
+    {
+      base::AutoLock auto_lock(lock_);
+      base::FlatHashMap<uint64, Location>::const_iterator it =
+          locations_.find(entry_hash);
+      if (it == locations_.end())
+        return false;
+      // The entry was written again or moved by a compaction while it was
+      // being read.
+      if (it->second.segment_id != location.segment_id ||
+          it->second.offset != location.offset) {
+        continue;
+      }
+
+      if (valid) {
+        file_data->assign(data, header.size);
+        *out_last_modified =
+            base::Time::FromInternalValue(header.last_modified);
+
+        base::FlatHashMap<uint64, ClaimState>::iterator claim_it =
+            claims_.find(entry_hash);
+        if (claim_it == claims_.end()) {
+          ClaimState state;
+          state.claim = next_claim_++;
+          state.open_count = 0;
+          state.pending_writes = 0;
+          claim_it = claims_.insert(std::make_pair(entry_hash, state)).first;
+        }
+        ++claim_it->second.open_count;
+        *out_claim = claim_it->second.claim;
+        return true;
+      }
+
+      DLOG(WARNING) << "Corrupt small entry record.";
+      RemoveEntryLocked(entry_hash, &removal);
+    }
+    WriteRemoval(&removal);
+    return false;
+  }
+}
+
+bool SimpleSmallEntryStore::CreateEntry(uint64 entry_hash, Claim* out_claim) {
+  base::AutoLock auto_lock(lock_);
+  if (!loaded_ || locations_.count(entry_hash) || claims_.count(entry_hash))
+    return false;
+  ClaimNewEntryLocked(entry_hash, out_claim);
+  return true;
+}
+
+bool SimpleSmallEntryStore::ReplaceEntry(uint64 entry_hash, Claim* out_claim) {
+  PendingRecord removal;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (!loaded_ || claims_.count(entry_hash))
+      return false;
+    RemoveEntryLocked(entry_hash, &removal);
+    ClaimNewEntryLocked(entry_hash, out_claim);
+  }
+  WriteRemoval(&removal);
+  return true;
+}
+
+bool SimpleSmallEntryStore::WriteAndCloseEntry(uint64 entry_hash,
+                                               Claim claim,
+                                               const std::string& file_data,
+                                               base::Time last_modified) {
+  DCHECK(!file_data.empty());
+  DCHECK_LE(file_data.size(), static_cast<size_t>(kMaxFileSize));
+  PendingRecord pending;
+  PendingRecord removal;
+  {
+    base::AutoLock auto_lock(lock_);
+    base::FlatHashMap<uint64, ClaimState>::iterator it =
+        claims_.find(entry_hash);
+    if (it == claims_.end() || it->second.claim != claim)
+      return false;
+    if (ReserveRecordLocked(entry_hash, file_data.data(), file_data.size(),
+                            last_modified, &pending)) {
+      ++it->second.pending_writes;
+    } else {
+      CloseEntryLocked(entry_hash, claim);
+      // Do not leave the previous version of the entry behind.
+      RemoveEntryLocked(entry_hash, &removal);
+    }
+  }
+  if (pending.is_empty()) {
+    WriteRemoval(&removal);
+    return false;
+  }
+
+  bool written = WritePendingRecord(&pending);
+  {
+    base::AutoLock auto_lock(lock_);
+    base::FlatHashMap<uint64, ClaimState>::iterator it =
+        claims_.find(entry_hash);
+    if (it != claims_.end() && it->second.claim == claim)
+      --it->second.pending_writes;
+    if (!CloseEntryLocked(entry_hash, claim)) {
+      // The entry was removed while its record was written. Unless the entry
+      // has been written again since, which placed a newer record after this
+      // one, the removal must follow this record in the log.
+      if (!locations_.count(entry_hash))
+        ReserveRemovalLocked(entry_hash, &removal);
+      written = false;
+    } else if (written) {
+      AddLocationLocked(pending.segment_id, pending.record);
+      MaybeScheduleCompaction();
+    } else {
+      // Do not leave the previous version of the entry behind.
+      ReserveRemovalLocked(entry_hash, &removal);
+    }
+  }
+  WriteRemoval(&removal);
+  return written;
+}
+
+bool SimpleSmallEntryStore::CloseEntry(uint64 entry_hash, Claim claim) {
+  base::AutoLock auto_lock(lock_);
+  return CloseEntryLocked(entry_hash, claim);
+}
+
+bool SimpleSmallEntryStore::RemoveAndCloseEntry(uint64 entry_hash,
+                                                Claim claim) {
+  PendingRecord removal;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (!CloseEntryLocked(entry_hash, claim))
+      return false;
+    RemoveEntryLocked(entry_hash, &removal);
+  }
+  WriteRemoval(&removal);
+  return true;
+}
+
+bool SimpleSmallEntryStore::RemoveEntry(uint64 entry_hash) {
+  PendingRecord removal;
+  bool removed;
+  {
+    base::AutoLock auto_lock(lock_);
+    claims_.erase(entry_hash);
+    removed = RemoveEntryLocked(entry_hash, &removal);
+  }
+  WriteRemoval(&removal);
+  return removed;
+}
+
+base::Time SimpleSmallEntryStore::last_modified() const {
+  base::AutoLock auto_lock(lock_);
+  return last_modified_;
+}
+
+size_t SimpleSmallEntryStore::segment_count() const {
+  base::AutoLock auto_lock(lock_);
+  return segments_.size();
+}
+
+int64 SimpleSmallEntryStore::total_bytes() const {
+  base::AutoLock auto_lock(lock_);
+  return total_bytes_;
+}
+
+int64 SimpleSmallEntryStore::live_bytes() const {
+  base::AutoLock auto_lock(lock_);
+  return live_bytes_;
+}
+
+base::FilePath SimpleSmallEntryStore::GetSegmentPath(uint32 segment_id) const {
+  return directory_.AppendASCII(
+      base::StringPrintf("%s%u", kSegmentFilePrefix, segment_id));
+}
+
+base::FilePath SimpleSmallEntryStore::GetHintPath(uint32 segment_id) const {
+  return directory_.AppendASCII(
+      base::StringPrintf("%s%u", kHintFilePrefix, segment_id));
+}
+
+bool SimpleSmallEntryStore::ReadHintFile(
+    uint32 segment_id,
+    const Segment& segment,
+    std::vector<HintRecord>* records) const {
+  std::string contents;
+  if (!base::ReadFileToString(GetHintPath(segment_id), &contents) ||
+      contents.size() < sizeof(HintFileHeader)) {
+    return false;
+  }
+  HintFileHeader header;
+  memcpy(&header, contents.data(), sizeof(header));
+  const size_t records_size = contents.size() - sizeof(header);
+  if (header.magic_number != kHintFileMagicNumber ||
+      header.version != kHintFileVersion ||
+      header.segment_size != segment.size ||
+      records_size != header.record_count * sizeof(HintRecord)) {
+    return false;
+  }
+  const char* records_data = contents.data() + sizeof(header);
+  if (header.crc32 != crc32(crc32(0, Z_NULL, 0),
+                            reinterpret_cast<const Bytef*>(records_data),
+                            records_size)) {
+    return false;
+  }
+  records->resize(header.record_count);
+  if (!records->empty())
+    memcpy(&(*records)[0], records_data, records_size);
+  return true;
+}
+
+bool SimpleSmallEntryStore::ScanSegment(
+    Segment* segment,
+    std::vector<HintRecord>* records) {
+  std::string contents(segment->size, '\0');
+  if (segment->size > 0 &&
+      segment->file.Read(0, &contents[0], contents.size()) !=
+          static_cast<int>(contents.size())) {
+    return false;
+  }
+
+  size_t offset = 0;
+  while (contents.size() - offset >= sizeof(RecordHeader)) {
+    RecordHeader header;
+    memcpy(&header, contents.data() + offset, sizeof(header));
+    if (header.magic_number != kRecordMagicNumber ||
+        header.size > static_cast<uint32>(kMaxFileSize) ||
+        contents.size() - offset - sizeof(header) < header.size) {
+      break;
+    }
+    const char* data = contents.data() + offset + sizeof(header);
+    if (header.crc32 != RecordCRC(header, data, header.size))
+      break;
+    HintRecord record;
+    record.entry_hash = header.entry_hash;
+    record.offset = offset;
+    record.size = header.size;
+    record.last_modified = header.last_modified;
+    records->push_back(record);
+    offset += RecordBytes(header.size);
+  }
+
+  // Drop a record torn by a crash, so that appends continue from a valid
+  // record boundary.
+  if (offset != contents.size()) {
+    DLOG(WARNING) << "Truncating small entry segment at " << offset;
+    if (!segment->file.SetLength(offset))
+      return false;
+    segment->size = offset;
+  }
+  return true;
+}
+
+void SimpleSmallEntryStore::ApplyRecord(uint32 segment_id,
+                                        const HintRecord& record) {
+  total_bytes_ += RecordBytes(record.size);
+  if (record.size == 0)
+    EraseLocationLocked(record.entry_hash);
+  else
+    AddLocationLocked(segment_id, record);
+}
+
+void SimpleSmallEntryStore::AddLocationLocked(uint32 segment_id,
+                                              const HintRecord& record) {
+  lock_.AssertAcquired();
+  DCHECK_GT(record.size, 0u);
+  EraseLocationLocked(record.entry_hash);
+
+  Location location;
+  location.segment_id = segment_id;
+  location.offset = record.offset;
+  location.size = record.size;
+  location.last_modified = record.last_modified;
+  locations_[record.entry_hash] = location;
+  const int64 record_bytes = RecordBytes(record.size);
+  segments_[segment_id]->live_bytes += record_bytes;
+  live_bytes_ += record_bytes;
+}
+
+void SimpleSmallEntryStore::EraseLocationLocked(uint64 entry_hash) {
+  lock_.AssertAcquired();
+  base::FlatHashMap<uint64, Location>::iterator it =
+      locations_.find(entry_hash);
+  if (it == locations_.end())
+    return;
+  const int64 stale_bytes = RecordBytes(it->second.size);
+  segments_[it->second.segment_id]->live_bytes -= stale_bytes;
+  live_bytes_ -= stale_bytes;
+  locations_.erase(it);
+}
+
+bool SimpleSmallEntryStore::IsAtLocationLocked(
+    uint32 segment_id,
+    const HintRecord& record) const {
+  lock_.AssertAcquired();
+  base::FlatHashMap<uint64, Location>::const_iterator it =
+      locations_.find(record.entry_hash);
+  return it != locations_.end() && it->second.segment_id == segment_id &&
+         it->second.offset == record.offset;
+}
+
+bool SimpleSmallEntryStore::ReserveRecordLocked(uint64 entry_hash,
+                                                const char* data,
+                                                int size,
+                                                base::Time last_modified,
+                                                PendingRecord* pending) {
+  lock_.AssertAcquired();
+  DCHECK(pending->is_empty());
+  const int64 record_bytes = RecordBytes(size);
+
+  uint32 segment_id = segments_.empty() ? 0 : segments_.rbegin()->first;
+  Segment* segment =
+      segments_.empty() ? NULL : segments_.rbegin()->second.get();
+  if (segment && !segment->sealed && segment->size > 0 &&
+      segment->size + record_bytes > max_segment_size_) {
+    SealSegmentLocked(segment_id, segment, &pending->hint_path,
+                      &pending->hint);
+  }
+  if (!segment || segment->sealed) {
+    if (segment)
+      ++segment_id;
+    // This only happens once per segment, so the file is created with
+    // |lock_| held.
+    scoped_refptr<Segment> new_segment(new Segment);
+    new_segment->file.Initialize(
+        GetSegmentPath(segment_id),
+        base::File::FLAG_CREATE_ALWAYS | base::File::FLAG_READ |
+            base::File::FLAG_WRITE | base::File::FLAG_SHARE_DELETE);
+    if (!new_segment->file.IsValid()) {
+      DLOG(WARNING) << "Could not create small entry segment.";
+      return false;
+    }
+    segment = new_segment.get();
+    segments_[segment_id] = new_segment;
+  }
+
+  RecordHeader header;
+  header.magic_number = kRecordMagicNumber;
+  header.size = size;
+  header.entry_hash = entry_hash;
+  header.last_modified = last_modified.ToInternalValue();
+  header.unused = 0;
+  header.crc32 = RecordCRC(header, data, size);
+
+  pending->segment = segment;
+  pending->segment_id = segment_id;
+  pending->bytes.assign(reinterpret_cast<const char*>(&header),
+                        sizeof(header));
+  pending->bytes.append(data, size);
+  pending->record.entry_hash = entry_hash;
+  pending->record.offset = segment->size;
+  pending->record.size = size;
+  pending->record.last_modified = header.last_modified;
+
+  segment->records.push_back(pending->record);
+  segment->size += record_bytes;
+  ++segment->pending_writes;
+  total_bytes_ += record_bytes;
+  return true;
+}
+
+bool SimpleSmallEntryStore::WritePendingRecord(PendingRecord* pending) {
+  DCHECK(!pending->is_empty());
+  if (!pending->hint.empty())
+    WriteHintFile(pending->hint_path, pending->hint);
+
+  const bool written =
+      pending->segment->file.Write(pending->record.offset,
+                                   pending->bytes.data(),
+                                   pending->bytes.size()) ==
+      static_cast<int>(pending->bytes.size());
+
+  base::FilePath hint_path;
+  std::string hint;
+  {
+    base::AutoLock auto_lock(lock_);
+    --pending->segment->pending_writes;
+    if (written) {
+      // Taken after the write, so it is no earlier than the mtime of the
+      // file.
+      last_modified_ = std::max(last_modified_, base::Time::Now());
+    } else {
+      DLOG(WARNING) << "Could not write small entry record.";
+      // Scanning the segment would stop at this record, and drop the ones
+      // placed after it.
+      if (!pending->segment->sealed) {
+        SealSegmentLocked(pending->segment_id, pending->segment.get(),
+                          &hint_path, &hint);
+      }
+    }
+  }
+  if (!hint.empty())
+    WriteHintFile(hint_path, hint);
+  return written;
+}
+
+void SimpleSmallEntryStore::SealSegmentLocked(uint32 segment_id,
+                                              Segment* segment,
+                                              base::FilePath* hint_path,
+                                              std::string* hint) {
+  lock_.AssertAcquired();
+  DCHECK(!segment->sealed);
+  segment->sealed = true;
+
+  const std::vector<HintRecord>& records = segment->records;
+  HintFileHeader header;
+  header.magic_number = kHintFileMagicNumber;
+  header.version = kHintFileVersion;
+  header.record_count = records.size();
+  header.segment_size = segment->size;
+  const size_t records_size = records.size() * sizeof(HintRecord);
+  const char* records_data =
+      records.empty() ? NULL : reinterpret_cast<const char*>(&records[0]);
+  header.crc32 = crc32(crc32(0, Z_NULL, 0),
+                       reinterpret_cast<const Bytef*>(records_data),
+                       records_size);
+  header.unused = 0;
+
+  *hint_path = GetHintPath(segment_id);
+  hint->assign(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (records_size)
+    hint->append(records_data, records_size);
+}
+
+void SimpleSmallEntryStore::ReserveRemovalLocked(uint64 entry_hash,
+                                                 PendingRecord* pending) {
+  lock_.AssertAcquired();
+  // If the removal record cannot be placed, the entry is at least not served
+  // anymore in this session.
+  EraseLocationLocked(entry_hash);
+  ReserveRecordLocked(entry_hash, NULL, 0, base::Time(), pending);
+  MaybeScheduleCompaction();
+}
+
+bool SimpleSmallEntryStore::RemoveEntryLocked(uint64 entry_hash,
+                                              PendingRecord* pending) {
+  lock_.AssertAcquired();
+  if (!locations_.count(entry_hash))
+    return false;
+  ReserveRemovalLocked(entry_hash, pending);
+  return true;
+}
+
+void SimpleSmallEntryStore::ClaimNewEntryLocked(uint64 entry_hash,
+                                                Claim* out_claim) {
+  lock_.AssertAcquired();
+  DCHECK(!claims_.count(entry_hash));
+  ClaimState state;
+  state.claim = next_claim_++;
+  state.open_count = 1;
+  state.pending_writes = 0;
+  claims_.insert(std::make_pair(entry_hash, state));
+  *out_claim = state.claim;
+}
+
+bool SimpleSmallEntryStore::CloseEntryLocked(uint64 entry_hash, Claim claim) {
+  lock_.AssertAcquired();
+  base::FlatHashMap<uint64, ClaimState>::iterator it =
+      claims_.find(entry_hash);
+  if (it == claims_.end() || it->second.claim != claim)
+    return false;
+  if (--it->second.open_count == 0)
+    claims_.erase(it);
+  return true;
+}
+
+bool SimpleSmallEntryStore::IsBeingWrittenLocked(uint64 entry_hash) const {
+  lock_.AssertAcquired();
+  base::FlatHashMap<uint64, ClaimState>::const_iterator it =
+      claims_.find(entry_hash);
+  return it != claims_.end() && it->second.pending_writes > 0;
+}
+
+bool SimpleSmallEntryStore::NeedsCompaction() const {
+  lock_.AssertAcquired();
+  if (segments_.size() < 2 || !segments_.begin()->second->sealed)
+    return false;
+  const int64 stale_bytes = total_bytes_ - live_bytes_;
+  return stale_bytes > std::max(max_segment_size_, live_bytes_);
+}
+
+void SimpleSmallEntryStore::MaybeScheduleCompaction() {
+  lock_.AssertAcquired();
+  if (compaction_pending_ || !worker_pool_.get() || !NeedsCompaction())
+    return;
+  compaction_pending_ = true;
+  worker_pool_->PostTask(FROM_HERE,
+                         base::Bind(&SimpleSmallEntryStore::Compact, this));
+}
+
+void SimpleSmallEntryStore::Compact() {
+  uint32 segment_id;
+  scoped_refptr<Segment> segment;
+  int64 segment_size;
+  std::vector<HintRecord> live_records;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (!NeedsCompaction()) {
+      compaction_pending_ = false;
+      return;
+    }
+    segment_id = segments_.begin()->first;
+    segment = segments_.begin()->second;
+    segment_size = segment->size;
+    for (size_t i = 0; i < segment->records.size(); ++i) {
+      if (segment->records[i].size > 0 &&
+          IsAtLocationLocked(segment_id, segment->records[i])) {
+        live_records.push_back(segment->records[i]);
+      }
+    }
+  }
+
+  // The live records of the segment have been written, and no new record is
+  // placed in a sealed segment.
+  std::string contents(segment_size, '\0');
+  if (segment_size > 0 &&
+      segment->file.Read(0, &contents[0], contents.size()) !=
+          static_cast<int>(contents.size())) {
+    DLOG(WARNING) << "Could not read small entry segment for compaction.";
+    base::AutoLock auto_lock(lock_);
+    compaction_pending_ = false;
+    return;
+  }
+
+  // Entries being written are left alone: their new record may be placed
+  // before the copy, which would then shadow it. The segment is compacted
+  // again once they are done.
+  std::vector<HintRecord> copied_records;
+  std::vector<PendingRecord> copies;
+  {
+    base::AutoLock auto_lock(lock_);
+    for (size_t i = 0; i < live_records.size(); ++i) {
+      const HintRecord& record = live_records[i];
+      if (!IsAtLocationLocked(segment_id, record) ||
+          IsBeingWrittenLocked(record.entry_hash)) {
+        continue;
+      }
+      copies.push_back(PendingRecord());
+      if (!ReserveRecordLocked(
+              record.entry_hash,
+              contents.data() + record.offset + sizeof(RecordHeader),
+              record.size,
+              base::Time::FromInternalValue(record.last_modified),
+              &copies.back())) {
+        copies.pop_back();
+        break;
+      }
+      copied_records.push_back(record);
+    }
+  }
+
+  std::vector<bool> written(copies.size());
+  for (size_t i = 0; i < copies.size(); ++i)
+    written[i] = WritePendingRecord(&copies[i]);
+
+  {
+    base::AutoLock auto_lock(lock_);
+    compaction_pending_ = false;
+    for (size_t i = 0; i < copies.size(); ++i) {
+      if (written[i] && IsAtLocationLocked(segment_id, copied_records[i]))
+        AddLocationLocked(copies[i].segment_id, copies[i].record);
+    }
+    if (segment->live_bytes > 0 || segment->pending_writes > 0)
+      return;
+    total_bytes_ -= segment->size;
+    segments_.erase(segment_id);
+    MaybeScheduleCompaction();
+  }
+
+  // Reads of the segment that are still running hold their own reference to
+  // it.
+  base::DeleteFile(GetHintPath(segment_id), false /* recursive */);
+  base::DeleteFile(GetSegmentPath(segment_id), false /* recursive */);
+}
+
+void SimpleSmallEntryStore::WriteRemoval(PendingRecord* pending) {
+  if (!pending->is_empty())
+    WritePendingRecord(pending);
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,303 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_SMALL_ENTRY_STORE_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_SMALL_ENTRY_STORE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/flat_hash_map.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+
+namespace base {
+class TaskRunner;
+}
+
+namespace disk_cache {
+
+// SimpleSmallEntryStore keeps the stream 0 and 1 file (see
+// simple_entry_format.h) of small simple cache entries inside shared,
+// append-only segment files instead of one file per entry, saving an inode, a
+// directory entry and the open and close syscalls for each of them.
+//
+// The store is a log: writing an entry appends a record with the new file
+// contents, and removing it appends a removal record. An in-memory map, built
+// by Load(), points at the latest record of each entry. Once a segment grows
+// to kMaxSegmentSize, it is sealed and a hint file listing its records is
+// written next to it, so that Load() reads the hint files and only has to
+// scan the segment that was being appended to.
+//
+// When more than half of the bytes in the segments are stale, the oldest
+// segment is compacted on the worker pool: its live records are copied to
+// the end of the log and the segment is deleted. Always compacting the oldest
+// segment lets its removal records be dropped, since no older record can be
+// left for them to shadow.
+//
+// A SimpleSynchronousEntry that opens or creates a packed entry holds a claim
+// on it until it closes. Removing the entry revokes the claim, so that an
+// entry that was doomed while open is not written back when it closes.
+//
+// |lock_| only guards the in-memory state. A record gets its place at the end
+// of the log while the lock is held, so the order of the records matches the
+// order of the changes, and is then written without it. Reads and
+// compactions also run unlocked, holding a reference to their segment, and
+// only use what they read if the entry was not moved or changed meanwhile.
+//
+// All methods may be called from any thread, and may block on file I/O.
+class NET_EXPORT_PRIVATE SimpleSmallEntryStore
+    : public base::RefCountedThreadSafe<SimpleSmallEntryStore> {
+ public:
+  typedef uint64 Claim;
+
+  struct EntryInfo {
+    uint64 entry_hash;
+    base::Time last_modified;
+    int size;
+  };
+
+  // Entries whose stream 0 and 1 file is larger than this are not packed.
+  static const int kMaxFileSize = 4096;
+
+  // The default size at which a segment file is sealed.
+  static const int64 kMaxSegmentSize = 4 * 1024 * 1024;
+
+  // Name of the directory of the segment files, in the cache directory.
+  static const char kSegmentDirectoryName[];
+
+  // Compactions are posted to |worker_pool|.
+  SimpleSmallEntryStore(const base::FilePath& cache_directory,
+                        const scoped_refptr<base::TaskRunner>& worker_pool);
+
+  // Reads the segment files. Until Load() succeeds, the store holds no
+  // entries and refuses new ones. Returns false if the segment directory is
+  // not usable.
+  bool Load();
+
+  bool loaded() const;
+
+  // Lists the packed entries, e.g. to rebuild the index.
+  void GetEntries(std::vector<EntryInfo>* entries) const;
+
+  // Reads the file of |entry_hash| into |file_data| and claims the entry.
+  // Returns false if the store does not hold the entry, or if its record is
+  // corrupt, in which case the entry is removed.
+  bool OpenEntry(uint64 entry_hash,
+                 std::string* file_data,
+                 base::Time* out_last_modified,
+                 Claim* out_claim);
+
+  // Claims |entry_hash| for a new entry. Returns false if the store holds the
+  // entry already or it is claimed.
+  bool CreateEntry(uint64 entry_hash, Claim* out_claim);
+
+  // Like CreateEntry(), but removes the entry first if the store holds it and
+  // it is not claimed. Used for entries the index does not know about, e.g.
+  // because they were written after the index was last saved.
+  bool ReplaceEntry(uint64 entry_hash, Claim* out_claim);
+
+  // Stores |file_data| as the file of |entry_hash| and ends |claim|. Returns
+  // false, without storing anything, if |claim| was revoked.
+  bool WriteAndCloseEntry(uint64 entry_hash,
+                          Claim claim,
+                          const std::string& file_data,
+                          base::Time last_modified);
+
+  // Ends |claim| without changing the entry. Returns false if |claim| was
+  // revoked.
+  bool CloseEntry(uint64 entry_hash, Claim claim);
+
+  // Removes the entry and ends |claim|, e.g. because the entry outgrew the
+  // store. Returns false if |claim| was revoked.
+  bool RemoveAndCloseEntry(uint64 entry_hash, Claim claim);
+
+  // Removes the entry, if the store holds it, and revokes all claims on it.
+  // Returns true if the store held the entry.
+  bool RemoveEntry(uint64 entry_hash);
+
+  // The time of the last change to the segments. Appending to a segment does
+  // not change the mtime of the cache directory, so the index compares this
+  // as well to tell whether it is stale.
+  base::Time last_modified() const;
+
+  size_t segment_count() const;
+  // Size of all the segments, and of their records that are not stale.
+  int64 total_bytes() const;
+  int64 live_bytes() const;
+
+  void set_max_segment_size_for_testing(int64 max_segment_size) {
+    max_segment_size_ = max_segment_size;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<SimpleSmallEntryStore>;
+
+  struct Location {
+    uint32 segment_id;
+    uint32 offset;
+    uint32 size;
+    int64 last_modified;
+  };
+
+  // A record as listed in hint files. |size| is 0 for removal records.
+  struct HintRecord {
+    uint64 entry_hash;
+    uint32 offset;
+    uint32 size;
+    int64 last_modified;
+  };
+
+  struct ClaimState {
+    Claim claim;
+    int open_count;
+    // Records of the entry being written under this claim.
+    int pending_writes;
+  };
+
+  // Only |file| may be used without holding |lock_|.
+  struct Segment : public base::RefCountedThreadSafe<Segment> {
+    Segment();
+
+    base::File file;
+    // The end of the last record placed in the segment, which may not have
+    // been written yet.
+    int64 size;
+    int64 live_bytes;
+    // Records placed in the segment that are still being written. The
+    // segment is not deleted until they are done.
+    int pending_writes;
+    bool sealed;
+    // The records of the segment, for its hint file and for compactions.
+    std::vector<HintRecord> records;
+
+   private:
+    friend class base::RefCountedThreadSafe<Segment>;
+    ~Segment();
+  };
+
+  typedef std::map<uint32, scoped_refptr<Segment> > SegmentMap;
+
+  // A record placed at the end of the log, to be written by
+  // WritePendingRecord() without holding |lock_|.
+  struct PendingRecord {
+    PendingRecord();
+    ~PendingRecord();
+
+    bool is_empty() const { return !segment.get(); }
+
+    scoped_refptr<Segment> segment;
+    uint32 segment_id;
+    HintRecord record;
+    // The header and data of the record.
+    std::string bytes;
+    // The hint file of the segment sealed to make room for the record, if
+    // any.
+    base::FilePath hint_path;
+    std::string hint;
+  };
+
+  ~SimpleSmallEntryStore();
+
+  base::FilePath GetSegmentPath(uint32 segment_id) const;
+  base::FilePath GetHintPath(uint32 segment_id) const;
+
+  // Fills |records| from the hint file of |segment|. Returns false if the
+  // hint file is missing or does not match the segment.
+  bool ReadHintFile(uint32 segment_id,
+                    const Segment& segment,
+                    std::vector<HintRecord>* records) const;
+  // Scans the records of |segment|, and truncates it after the last valid
+  // one.
+  bool ScanSegment(Segment* segment, std::vector<HintRecord>* records);
+
+  // Updates the map and the byte counts for a record read from |segment_id|
+  // by Load().
+  void ApplyRecord(uint32 segment_id, const HintRecord& record);
+
+  // Makes |record|, of |segment_id|, the location of its entry.
+  void AddLocationLocked(uint32 segment_id, const HintRecord& record);
+  void EraseLocationLocked(uint64 entry_hash);
+
+  // Returns true if the entry of |record| is still at |record| in
+  // |segment_id|.
+  bool IsAtLocationLocked(uint32 segment_id, const HintRecord& record) const;
+
+  // Places a record at the end of the log, to be written by
+  // WritePendingRecord(). |size| is 0 for a removal record. Returns false if
+  // no segment could be created.
+  bool ReserveRecordLocked(uint64 entry_hash,
+                           const char* data,
+                           int size,
+                           base::Time last_modified,
+                           PendingRecord* pending);
+
+  // Writes |pending|, once |lock_| is released. If the write fails, the
+  // segment is sealed, so that the next Load() reads the records placed
+  // after |pending| from its hint file instead of dropping them.
+  bool WritePendingRecord(PendingRecord* pending);
+
+  // Stops appending to |segment| and builds its hint file, to be written
+  // without holding |lock_|.
+  void SealSegmentLocked(uint32 segment_id,
+                         Segment* segment,
+                         base::FilePath* hint_path,
+                         std::string* hint);
+
+  // Removes the entry from the map, and places a removal record for it in
+  // |pending|, whether the store held it or not.
+  void ReserveRemovalLocked(uint64 entry_hash, PendingRecord* pending);
+
+  // Removes the entry if the store holds it. The removal record placed in
+  // |pending| must be written once |lock_| is released.
+  bool RemoveEntryLocked(uint64 entry_hash, PendingRecord* pending);
+
+  // Claims |entry_hash|, which must not be claimed already.
+  void ClaimNewEntryLocked(uint64 entry_hash, Claim* out_claim);
+
+  // Returns true if |claim| is the current claim on |entry_hash|, and ends
+  // it.
+  bool CloseEntryLocked(uint64 entry_hash, Claim claim);
+
+  // Returns true if a record of |entry_hash| is being written under its
+  // current claim.
+  bool IsBeingWrittenLocked(uint64 entry_hash) const;
+
+  bool NeedsCompaction() const;
+  void MaybeScheduleCompaction();
+
+  // Copies the live records of the oldest segment to the end of the log and
+  // deletes it.
+  void Compact();
+
+  // Writes |pending|, if a removal record could be placed in it.
+  void WriteRemoval(PendingRecord* pending);
+
+  const base::FilePath directory_;
+  const scoped_refptr<base::TaskRunner> worker_pool_;
+  int64 max_segment_size_;
+
+  mutable base::Lock lock_;
+  bool loaded_;
+  base::FlatHashMap<uint64, Location> locations_;
+  base::FlatHashMap<uint64, ClaimState> claims_;
+  Claim next_claim_;
+  SegmentMap segments_;
+  int64 total_bytes_;
+  int64 live_bytes_;
+  base::Time last_modified_;
+  bool compaction_pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleSmallEntryStore);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_SMALL_ENTRY_STORE_H_
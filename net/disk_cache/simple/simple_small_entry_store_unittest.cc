@@ -0,0 +1,254 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_small_entry_store.h"
+
+#include <string>
+#include <vector>
+
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/ref_counted.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/test/test_simple_task_runner.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const base::Time kTime = base::Time::FromInternalValue(GG_INT64_C(1234567));
+
+std::string MakeFile(int i, size_t size) {
+  std::string file = "file" + base::IntToString(i);
+  file.resize(size, 'a' + i % 26);
+  return file;
+}
+
+class SimpleSmallEntryStoreTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    task_runner_ = new base::TestSimpleTaskRunner;
+    Reload();
+  }
+
+  // Replaces |store_| with a new store loaded from the same directory.
+  void Reload() {
+    store_ = new SimpleSmallEntryStore(temp_dir_.path(), task_runner_);
+    ASSERT_TRUE(store_->Load());
+  }
+
+  bool Write(uint64 entry_hash, const std::string& file) {
+    SimpleSmallEntryStore::Claim claim;
+    if (!store_->CreateEntry(entry_hash, &claim)) {
+      std::string old_file;
+      base::Time last_modified;
+      if (!store_->OpenEntry(entry_hash, &old_file, &last_modified, &claim))
+        return false;
+    }
+    return store_->WriteAndCloseEntry(entry_hash, claim, file, kTime);
+  }
+
+  // Returns the file of |entry_hash|, or "" if the store does not hold it.
+  std::string Read(uint64 entry_hash) {
+    std::string file;
+    base::Time last_modified;
+    SimpleSmallEntryStore::Claim claim;
+    if (!store_->OpenEntry(entry_hash, &file, &last_modified, &claim))
+      return std::string();
+    EXPECT_EQ(kTime, last_modified);
+    EXPECT_TRUE(store_->CloseEntry(entry_hash, claim));
+    return file;
+  }
+
+  base::ScopedTempDir temp_dir_;
+  scoped_refptr<base::TestSimpleTaskRunner> task_runner_;
+  scoped_refptr<SimpleSmallEntryStore> store_;
+};
+
+}  // namespace
+
+TEST_F(SimpleSmallEntryStoreTest, WriteReadRemove) {
+  EXPECT_EQ("", Read(1));
+  EXPECT_TRUE(Write(1, "first"));
+  EXPECT_TRUE(Write(2, "second"));
+  EXPECT_EQ("first", Read(1));
+  EXPECT_EQ("second", Read(2));
+
+  EXPECT_TRUE(Write(1, "first, again"));
+  EXPECT_EQ("first, again", Read(1));
+
+  EXPECT_TRUE(store_->RemoveEntry(2));
+  EXPECT_FALSE(store_->RemoveEntry(2));
+  EXPECT_EQ("", Read(2));
+
+  std::vector<SimpleSmallEntryStore::EntryInfo> entries;
+  store_->GetEntries(&entries);
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ(1u, entries[0].entry_hash);
+  EXPECT_EQ(12, entries[0].size);
+  EXPECT_EQ(kTime, entries[0].last_modified);
+}
+
+TEST_F(SimpleSmallEntryStoreTest, Claims) {
+  SimpleSmallEntryStore::Claim claim;
+  ASSERT_TRUE(store_->CreateEntry(1, &claim));
+  SimpleSmallEntryStore::Claim other_claim;
+  EXPECT_FALSE(store_->CreateEntry(1, &other_claim));
+  ASSERT_TRUE(store_->WriteAndCloseEntry(1, claim, "data", kTime));
+  EXPECT_FALSE(store_->CreateEntry(1, &other_claim));
+
+  // Removing an open entry revokes its claim, so closing it does not bring
+  // the entry back.
+  std::string file;
+  base::Time last_modified;
+  ASSERT_TRUE(store_->OpenEntry(1, &file, &last_modified, &claim));
+  EXPECT_TRUE(store_->RemoveEntry(1));
+  ASSERT_TRUE(store_->CreateEntry(1, &other_claim));
+  EXPECT_FALSE(store_->WriteAndCloseEntry(1, claim, "stale", kTime));
+  EXPECT_TRUE(store_->WriteAndCloseEntry(1, other_claim, "fresh", kTime));
+  EXPECT_EQ("fresh", Read(1));
+
+  ASSERT_TRUE(store_->OpenEntry(1, &file, &last_modified, &claim));
+  EXPECT_TRUE(store_->RemoveAndCloseEntry(1, claim));
+  EXPECT_EQ("", Read(1));
+  EXPECT_FALSE(store_->CloseEntry(1, claim));
+}
+
+TEST_F(SimpleSmallEntryStoreTest, ReplaceEntry) {
+  ASSERT_TRUE(Write(1, "old"));
+  SimpleSmallEntryStore::Claim claim;
+  ASSERT_TRUE(store_->ReplaceEntry(1, &claim));
+  EXPECT_EQ("", Read(1));
+  SimpleSmallEntryStore::Claim other_claim;
+  EXPECT_FALSE(store_->ReplaceEntry(1, &other_claim));
+  ASSERT_TRUE(store_->WriteAndCloseEntry(1, claim, "new", kTime));
+
+  Reload();
+  EXPECT_EQ("new", Read(1));
+}
+
+// Appending leaves the cache directory alone, so the index relies on the
+// store to learn that the cache changed.
+TEST_F(SimpleSmallEntryStoreTest, LastModified) {
+  EXPECT_TRUE(store_->last_modified().is_null());
+  const base::Time before_write = base::Time::Now();
+  ASSERT_TRUE(Write(1, "data"));
+  const base::Time last_modified = store_->last_modified();
+  EXPECT_LE(before_write, last_modified);
+
+  Reload();
+  EXPECT_FALSE(store_->last_modified().is_null());
+  EXPECT_GE(last_modified, store_->last_modified());
+  ASSERT_TRUE(store_->RemoveEntry(1));
+  EXPECT_LE(last_modified, store_->last_modified());
+}
+
+TEST_F(SimpleSmallEntryStoreTest, Reload) {
+  store_->set_max_segment_size_for_testing(1024);
+  for (int i = 0; i < 100; ++i)
+    ASSERT_TRUE(Write(i, MakeFile(i, 100)));
+  for (int i = 0; i < 100; i += 3)
+    ASSERT_TRUE(store_->RemoveEntry(i));
+  EXPECT_LT(1u, store_->segment_count());
+  const int64 live_bytes = store_->live_bytes();
+
+  Reload();
+  EXPECT_EQ(live_bytes, store_->live_bytes());
+  for (int i = 0; i < 100; ++i) {
+    if (i % 3)
+      EXPECT_EQ(MakeFile(i, 100), Read(i));
+    else
+      EXPECT_EQ("", Read(i));
+  }
+
+  // Without the hint files, the segments are scanned.
+  base::DeleteFile(
+      temp_dir_.path().AppendASCII(SimpleSmallEntryStore::kSegmentDirectoryName)
+          .AppendASCII("hint_0"),
+      false);
+  Reload();
+  EXPECT_EQ(live_bytes, store_->live_bytes());
+  EXPECT_EQ(MakeFile(1, 100), Read(1));
+}
+
+TEST_F(SimpleSmallEntryStoreTest, TornRecordIsDropped) {
+  ASSERT_TRUE(Write(1, "first"));
+  ASSERT_TRUE(Write(2, "second"));
+  store_ = NULL;
+
+  base::FilePath segment_path =
+      temp_dir_.path()
+          .AppendASCII(SimpleSmallEntryStore::kSegmentDirectoryName)
+          .AppendASCII("segment_0");
+  int64 size;
+  ASSERT_TRUE(base::GetFileSize(segment_path, &size));
+  {
+    base::File segment(segment_path,
+                       base::File::FLAG_OPEN | base::File::FLAG_WRITE);
+    ASSERT_TRUE(segment.SetLength(size - 1));
+  }
+
+  Reload();
+  EXPECT_EQ("first", Read(1));
+  EXPECT_EQ("", Read(2));
+  EXPECT_TRUE(Write(3, "third"));
+  Reload();
+  EXPECT_EQ("third", Read(3));
+}
+
+TEST_F(SimpleSmallEntryStoreTest, Compaction) {
+  store_->set_max_segment_size_for_testing(4096);
+  const size_t kFileSize = 200;
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 50; ++i)
+      ASSERT_TRUE(Write(i, MakeFile(i + round, kFileSize)));
+  }
+  EXPECT_TRUE(task_runner_->HasPendingTask());
+  while (task_runner_->HasPendingTask())
+    task_runner_->RunPendingTasks();
+
+  // Compaction keeps the stale bytes below the larger of the live bytes and
+  // the segment size.
+  EXPECT_LE(store_->total_bytes() - store_->live_bytes(),
+            std::max<int64>(4096, store_->live_bytes()));
+  for (int i = 0; i < 50; ++i)
+    EXPECT_EQ(MakeFile(i + 9, kFileSize), Read(i));
+
+  Reload();
+  for (int i = 0; i < 50; ++i)
+    EXPECT_EQ(MakeFile(i + 9, kFileSize), Read(i));
+}
+
+// Entries are read and written while compactions run on another thread, and
+// move the records being read.
+TEST_F(SimpleSmallEntryStoreTest, ReadWhileCompacting) {
+  base::Thread compaction_thread("SimpleSmallEntryStoreCompaction");
+  ASSERT_TRUE(compaction_thread.Start());
+  store_ = new SimpleSmallEntryStore(temp_dir_.path(),
+                                     compaction_thread.task_runner());
+  ASSERT_TRUE(store_->Load());
+  store_->set_max_segment_size_for_testing(4096);
+
+  const size_t kFileSize = 200;
+  for (int round = 0; round < 20; ++round) {
+    for (int i = 0; i < 50; ++i)
+      ASSERT_TRUE(Write(i, MakeFile(i + round, kFileSize)));
+    for (int i = 0; i < 50; ++i)
+      EXPECT_EQ(MakeFile(i + round, kFileSize), Read(i));
+  }
+  compaction_thread.Stop();
+
+  for (int i = 0; i < 50; ++i)
+    EXPECT_EQ(MakeFile(i + 19, kFileSize), Read(i));
+  Reload();
+  for (int i = 0; i < 50; ++i)
+    EXPECT_EQ(MakeFile(i + 19, kFileSize), Read(i));
+}
+
+}  // namespace disk_cache
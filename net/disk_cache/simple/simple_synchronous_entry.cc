@@ -6,7 +6,6 @@
 
 #include <algorithm>
 #include <cstring>
-#include <functional>
 #include <limits>
 
 #include "base/basictypes.h"
@@ -212,11 +211,12 @@ SimpleSynchronousEntry::EntryOperationData::EntryOperationData(
 void SimpleSynchronousEntry::OpenEntry(
     net::CacheType cache_type,
     const FilePath& path,
+    SimpleSmallEntryStore* small_entry_store,
     const uint64 entry_hash,
     bool had_index,
     SimpleEntryCreationResults *out_results) {
-  SimpleSynchronousEntry* sync_entry =
-      new SimpleSynchronousEntry(cache_type, path, "", entry_hash);
+  SimpleSynchronousEntry* sync_entry = new SimpleSynchronousEntry(
+      cache_type, path, small_entry_store, "", entry_hash);
   out_results->result =
       sync_entry->InitializeForOpen(had_index,
                                     &out_results->entry_stat,
@@ -236,15 +236,15 @@ void SimpleSynchronousEntry::OpenEntry(
 void SimpleSynchronousEntry::CreateEntry(
     net::CacheType cache_type,
     const FilePath& path,
+    SimpleSmallEntryStore* small_entry_store,
     const std::string& key,
-    const uint64 entry_hash,
     bool had_index,
+    bool index_has_entry,
     SimpleEntryCreationResults *out_results) {
-  DCHECK_EQ(entry_hash, GetEntryHashKey(key));
-  SimpleSynchronousEntry* sync_entry =
-      new SimpleSynchronousEntry(cache_type, path, key, entry_hash);
+  SimpleSynchronousEntry* sync_entry = new SimpleSynchronousEntry(
+      cache_type, path, small_entry_store, key, GetEntryHashKey(key));
   out_results->result = sync_entry->InitializeForCreate(
-      had_index, &out_results->entry_stat);
+      had_index, index_has_entry, &out_results->entry_stat);
   if (out_results->result != net::OK) {
     if (out_results->result != net::ERR_FILE_EXISTS)
       sync_entry->Doom();
@@ -258,7 +258,11 @@ void SimpleSynchronousEntry::CreateEntry(
 // static
 int SimpleSynchronousEntry::DoomEntry(
     const FilePath& path,
+    SimpleSmallEntryStore* small_entry_store,
     uint64 entry_hash) {
+  // A packed entry has no files to delete.
+  if (small_entry_store && small_entry_store->RemoveEntry(entry_hash))
+    return net::OK;
   const bool deleted_well = DeleteFilesForEntryHash(path, entry_hash);
   return deleted_well ? net::OK : net::ERR_FAILED;
 }
@@ -266,10 +270,14 @@ int SimpleSynchronousEntry::DoomEntry(
 // static
 int SimpleSynchronousEntry::DoomEntrySet(
     const std::vector<uint64>* key_hashes,
-    const FilePath& path) {
-  const size_t did_delete_count = std::count_if(
-      key_hashes->begin(), key_hashes->end(), std::bind1st(
-          std::ptr_fun(SimpleSynchronousEntry::DeleteFilesForEntryHash), path));
+    const FilePath& path,
+    SimpleSmallEntryStore* small_entry_store) {
+  size_t did_delete_count = 0;
+  for (std::vector<uint64>::const_iterator it = key_hashes->begin();
+       it != key_hashes->end(); ++it) {
+    if (DoomEntry(path, small_entry_store, *it) == net::OK)
+      ++did_delete_count;
+  }
   return (did_delete_count == key_hashes->size()) ? net::OK : net::ERR_FAILED;
 }
 
@@ -287,9 +295,8 @@ void SimpleSynchronousEntry::ReadData(const EntryOperationData& in_entry_op,
   // be handled in the SimpleEntryImpl.
   DCHECK_GT(in_entry_op.buf_len, 0);
   DCHECK(!empty_file_omitted_[file_index]);
-  File* file = const_cast<File*>(&files_[file_index]);
-  int bytes_read =
-      file->Read(file_offset, out_buf->data(), in_entry_op.buf_len);
+  int bytes_read = ReadFromFile(
+      file_index, file_offset, out_buf->data(), in_entry_op.buf_len);
   if (bytes_read > 0) {
     entry_stat->set_last_used(Time::Now());
     *out_crc32 = crc32(crc32(0L, Z_NULL, 0),
@@ -320,6 +327,18 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
       key_, in_entry_op.offset, in_entry_op.index);
   bool extending_by_write = offset + buf_len > out_entry_stat->data_size(index);
 
+  // Stream 2 is never packed, and stream 1 only while it is small.
+  if (packed_ && !packed_claim_revoked_ &&
+      (file_index != 0 ||
+       file_offset + buf_len + implicit_cast<int64>(sizeof(SimpleFileEOF)) >
+           SimpleSmallEntryStore::kMaxFileSize) &&
+      !UnpackFile()) {
+    RecordWriteResult(cache_type_, WRITE_RESULT_WRITE_FAILURE);
+    Doom();
+    *out_result = net::ERR_CACHE_WRITE_FAILURE;
+    return;
+  }
+
   if (empty_file_omitted_[file_index]) {
     // Don't create a new file if the entry has been doomed, to avoid it being
     // mixed up with a newly-created entry with the same key.
@@ -351,7 +370,7 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
     // The EOF record and the eventual stream afterward need to be zeroed out.
     const int64 file_eof_offset =
         out_entry_stat->GetEOFOffsetInFile(key_, index);
-    if (!files_[file_index].SetLength(file_eof_offset)) {
+    if (!SetFileLength(file_index, file_eof_offset)) {
       RecordWriteResult(cache_type_, WRITE_RESULT_PRETRUNCATE_FAILURE);
       Doom();
       *out_result = net::ERR_CACHE_WRITE_FAILURE;
@@ -359,8 +378,7 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
     }
   }
   if (buf_len > 0) {
-    if (files_[file_index].Write(file_offset, in_buf->data(), buf_len) !=
-        buf_len) {
+    if (!WriteToFile(file_index, file_offset, in_buf->data(), buf_len)) {
       RecordWriteResult(cache_type_, WRITE_RESULT_WRITE_FAILURE);
       Doom();
       *out_result = net::ERR_CACHE_WRITE_FAILURE;
@@ -373,7 +391,7 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
   } else {
     out_entry_stat->set_data_size(index, offset + buf_len);
     int file_eof_offset = out_entry_stat->GetLastEOFOffsetInFile(key_, index);
-    if (!files_[file_index].SetLength(file_eof_offset)) {
+    if (!SetFileLength(file_index, file_eof_offset)) {
       RecordWriteResult(cache_type_, WRITE_RESULT_TRUNCATE_FAILURE);
       Doom();
       *out_result = net::ERR_CACHE_WRITE_FAILURE;
@@ -462,6 +480,13 @@ void SimpleSynchronousEntry::WriteSparseData(
   int written_so_far = 0;
   int appended_so_far = 0;
 
+  // Sparse data is kept in its own file, which packed entries do not have. A
+  // doomed packed entry stays packed, and cannot get one.
+  if (packed_ && (!UnpackFile() || packed_)) {
+    *out_result = net::ERR_CACHE_WRITE_FAILURE;
+    return;
+  }
+
   if (!sparse_file_open() && !CreateSparseFile()) {
     *out_result = net::ERR_CACHE_WRITE_FAILURE;
     return;
@@ -621,9 +646,8 @@ void SimpleSynchronousEntry::Close(
   DCHECK(stream_0_data);
   // Write stream 0 data.
   int stream_0_offset = entry_stat.GetOffsetInFile(key_, 0, 0);
-  if (files_[0].Write(stream_0_offset, stream_0_data->data(),
-                      entry_stat.data_size(0)) !=
-      entry_stat.data_size(0)) {
+  if (!WriteToFile(0, stream_0_offset, stream_0_data->data(),
+                   entry_stat.data_size(0))) {
     RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
     DVLOG(1) << "Could not write stream 0 data.";
     Doom();
@@ -647,25 +671,43 @@ void SimpleSynchronousEntry::Close(
     // If stream 0 changed size, the file needs to be resized, otherwise the
     // next open will yield wrong stream sizes. On stream 1 and stream 2 proper
     // resizing of the file is handled in SimpleSynchronousEntry::WriteData().
-    if (stream_index == 0 &&
-        !files_[file_index].SetLength(eof_offset)) {
+    if (stream_index == 0 && !SetFileLength(file_index, eof_offset)) {
       RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
       DVLOG(1) << "Could not truncate stream 0 file.";
       Doom();
       break;
     }
-    if (files_[file_index].Write(eof_offset,
-                                 reinterpret_cast<const char*>(&eof_record),
-                                 sizeof(eof_record)) !=
-        sizeof(eof_record)) {
+    if (!WriteToFile(file_index, eof_offset,
+                     reinterpret_cast<const char*>(&eof_record),
+                     sizeof(eof_record))) {
       RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
       DVLOG(1) << "Could not write eof record.";
       Doom();
       break;
     }
   }
+
+  if (packed_ && !packed_claim_revoked_ &&
+      packed_file_.size() > implicit_cast<size_t>(
+                                SimpleSmallEntryStore::kMaxFileSize) &&
+      !UnpackFile()) {
+    RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
+    DVLOG(1) << "Could not unpack entry.";
+    Doom();
+  }
+  if (packed_) {
+    if (packed_file_dirty_ && !packed_claim_revoked_) {
+      small_entry_store_->WriteAndCloseEntry(
+          entry_hash_, packed_claim_, packed_file_, entry_stat.last_modified());
+    } else {
+      small_entry_store_->CloseEntry(entry_hash_, packed_claim_);
+    }
+    packed_ = false;
+    packed_file_.clear();
+  }
+
   for (int i = 0; i < kSimpleEntryFileCount; ++i) {
-    if (empty_file_omitted_[i])
+    if (empty_file_omitted_[i] || !files_[i].IsValid())
       continue;
 
     files_[i].Close();
@@ -693,16 +735,23 @@ void SimpleSynchronousEntry::Close(
   delete this;
 }
 
-SimpleSynchronousEntry::SimpleSynchronousEntry(net::CacheType cache_type,
-                                               const FilePath& path,
-                                               const std::string& key,
-                                               const uint64 entry_hash)
+SimpleSynchronousEntry::SimpleSynchronousEntry(
+    net::CacheType cache_type,
+    const FilePath& path,
+    SimpleSmallEntryStore* small_entry_store,
+    const std::string& key,
+    const uint64 entry_hash)
     : cache_type_(cache_type),
       path_(path),
       entry_hash_(entry_hash),
+      small_entry_store_(small_entry_store),
       key_(key),
       have_open_files_(false),
-      initialized_(false) {
+      initialized_(false),
+      packed_(false),
+      packed_file_dirty_(false),
+      packed_claim_(0),
+      packed_claim_revoked_(false) {
   for (int i = 0; i < kSimpleEntryFileCount; ++i)
     empty_file_omitted_[i] = false;
 }
@@ -835,6 +884,127 @@ bool SimpleSynchronousEntry::OpenFiles(
   return true;
 }
 
+bool SimpleSynchronousEntry::OpenPackedFile(SimpleEntryStat* out_entry_stat) {
+  if (!small_entry_store_.get())
+    return false;
+  base::Time last_modified;
+  if (!small_entry_store_->OpenEntry(
+          entry_hash_, &packed_file_, &last_modified, &packed_claim_)) {
+    return false;
+  }
+  packed_ = true;
+  packed_file_dirty_ = false;
+  have_open_files_ = true;
+  empty_file_omitted_[GetFileIndexFromStreamIndex(2)] = true;
+
+  // As in OpenFiles(), |data_size(1)| temporarily holds the size of file 0.
+  out_entry_stat->set_last_used(Time::Now());
+  out_entry_stat->set_last_modified(last_modified);
+  out_entry_stat->set_data_size(1, packed_file_.size());
+  out_entry_stat->set_data_size(2, 0);
+  files_created_ = false;
+  return true;
+}
+
+bool SimpleSynchronousEntry::CreatePackedFile(
+    bool replace_existing,
+    SimpleEntryStat* out_entry_stat) {
+  DCHECK(small_entry_store_->loaded());
+  // The entry may have been created before the store was, or outgrown it.
+  if (base::PathExists(GetFilenameFromFileIndex(0)))
+    return false;
+  const bool claimed =
+      replace_existing
+          ? small_entry_store_->ReplaceEntry(entry_hash_, &packed_claim_)
+          : small_entry_store_->CreateEntry(entry_hash_, &packed_claim_);
+  if (!claimed)
+    return false;
+  packed_ = true;
+  packed_file_dirty_ = true;
+  have_open_files_ = true;
+  empty_file_omitted_[GetFileIndexFromStreamIndex(2)] = true;
+
+  base::Time creation_time = Time::Now();
+  out_entry_stat->set_last_modified(creation_time);
+  out_entry_stat->set_last_used(creation_time);
+  for (int i = 0; i < kSimpleEntryStreamCount; ++i)
+    out_entry_stat->set_data_size(i, 0);
+  files_created_ = true;
+  return true;
+}
+
+bool SimpleSynchronousEntry::UnpackFile() {
+  DCHECK(packed_);
+  if (!small_entry_store_->RemoveAndCloseEntry(entry_hash_, packed_claim_)) {
+    // The entry was doomed; creating its file would resurrect it.
+    packed_claim_revoked_ = true;
+    return true;
+  }
+  packed_ = false;
+
+  int flags = File::FLAG_CREATE_ALWAYS | File::FLAG_READ | File::FLAG_WRITE |
+              File::FLAG_SHARE_DELETE;
+  files_[0].Initialize(GetFilenameFromFileIndex(0), flags);
+  if (!files_[0].IsValid())
+    return false;
+  const int size = packed_file_.size();
+  if (files_[0].Write(0, packed_file_.data(), size) != size)
+    return false;
+  packed_file_.clear();
+  return true;
+}
+
+int SimpleSynchronousEntry::ReadFromFile(int file_index,
+                                         int64 offset,
+                                         char* data,
+                                         int size) const {
+  if (file_index == 0 && packed_) {
+    if (offset < 0 || offset > implicit_cast<int64>(packed_file_.size()))
+      return -1;
+    const int available = packed_file_.size() - offset;
+    const int bytes_read = std::min(size, available);
+    memcpy(data, packed_file_.data() + offset, bytes_read);
+    return bytes_read;
+  }
+  File* file = const_cast<File*>(&files_[file_index]);
+  return file->Read(offset, data, size);
+}
+
+bool SimpleSynchronousEntry::WriteToFile(int file_index,
+                                         int64 offset,
+                                         const char* data,
+                                         int size) {
+  if (file_index == 0 && packed_) {
+    if (offset < 0 || offset > kint32max - size)
+      return false;
+    if (offset + size > implicit_cast<int64>(packed_file_.size())) {
+      packed_file_.resize(offset + size);
+      packed_file_dirty_ = true;
+    }
+    // Close() rewrites stream 0 and the EOF records; only actual changes need
+    // to be written back to the store.
+    if (memcmp(&packed_file_[offset], data, size) != 0) {
+      memcpy(&packed_file_[offset], data, size);
+      packed_file_dirty_ = true;
+    }
+    return true;
+  }
+  return files_[file_index].Write(offset, data, size) == size;
+}
+
+bool SimpleSynchronousEntry::SetFileLength(int file_index, int64 length) {
+  if (file_index == 0 && packed_) {
+    if (length < 0 || length > kint32max)
+      return false;
+    if (length != implicit_cast<int64>(packed_file_.size())) {
+      packed_file_.resize(length);
+      packed_file_dirty_ = true;
+    }
+    return true;
+  }
+  return files_[file_index].SetLength(length);
+}
+
 bool SimpleSynchronousEntry::CreateFiles(
     bool had_index,
     SimpleEntryStat* out_entry_stat) {
@@ -879,6 +1049,10 @@ bool SimpleSynchronousEntry::CreateFiles(
 void SimpleSynchronousEntry::CloseFile(int index) {
   if (empty_file_omitted_[index]) {
     empty_file_omitted_[index] = false;
+  } else if (index == 0 && packed_) {
+    small_entry_store_->CloseEntry(entry_hash_, packed_claim_);
+    packed_ = false;
+    packed_file_.clear();
   } else {
     DCHECK(files_[index].IsValid());
     files_[index].Close();
@@ -899,7 +1073,8 @@ int SimpleSynchronousEntry::InitializeForOpen(
     scoped_refptr<net::GrowableIOBuffer>* stream_0_data,
     uint32* out_stream_0_crc32) {
   DCHECK(!initialized_);
-  if (!OpenFiles(had_index, out_entry_stat)) {
+  if (!OpenPackedFile(out_entry_stat) &&
+      !OpenFiles(had_index, out_entry_stat)) {
     DLOG(WARNING) << "Could not open platform files for entry.";
     return net::ERR_FAILED;
   }
@@ -909,7 +1084,7 @@ int SimpleSynchronousEntry::InitializeForOpen(
 
     SimpleFileHeader header;
     int header_read_result =
-        files_[i].Read(0, reinterpret_cast<char*>(&header), sizeof(header));
+        ReadFromFile(i, 0, reinterpret_cast<char*>(&header), sizeof(header));
     if (header_read_result != sizeof(header)) {
       DLOG(WARNING) << "Cannot read header from entry.";
       RecordSyncOpenResult(cache_type_, OPEN_ENTRY_CANT_READ_HEADER, had_index);
@@ -932,8 +1107,8 @@ int SimpleSynchronousEntry::InitializeForOpen(
     }
 
     scoped_ptr<char[]> key(new char[header.key_length]);
-    int key_read_result = files_[i].Read(sizeof(header), key.get(),
-                                         header.key_length);
+    int key_read_result = ReadFromFile(i, sizeof(header), key.get(),
+                                       header.key_length);
     if (key_read_result != implicit_cast<int>(header.key_length)) {
       DLOG(WARNING) << "Cannot read key from entry.";
       RecordSyncOpenResult(cache_type_, OPEN_ENTRY_CANT_READ_KEY, had_index);
@@ -967,7 +1142,7 @@ int SimpleSynchronousEntry::InitializeForOpen(
   }
 
   int32 sparse_data_size = 0;
-  if (!OpenSparseFileIfExists(&sparse_data_size)) {
+  if (!packed_ && !OpenSparseFileIfExists(&sparse_data_size)) {
     RecordSyncOpenResult(
         cache_type_, OPEN_ENTRY_SPARSE_OPEN_FAILED, had_index);
     return net::ERR_FAILED;
@@ -1004,16 +1179,13 @@ bool SimpleSynchronousEntry::InitializeCreatedFile(
   header.key_length = key_.size();
   header.key_hash = base::Hash(key_);
 
-  int bytes_written = files_[file_index].Write(
-      0, reinterpret_cast<char*>(&header), sizeof(header));
-  if (bytes_written != sizeof(header)) {
+  if (!WriteToFile(file_index, 0, reinterpret_cast<char*>(&header),
+                   sizeof(header))) {
     *out_result = CREATE_ENTRY_CANT_WRITE_HEADER;
     return false;
   }
 
-  bytes_written = files_[file_index].Write(sizeof(header), key_.data(),
-                                           key_.size());
-  if (bytes_written != implicit_cast<int>(key_.size())) {
+  if (!WriteToFile(file_index, sizeof(header), key_.data(), key_.size())) {
     *out_result = CREATE_ENTRY_CANT_WRITE_KEY;
     return false;
   }
@@ -1023,9 +1195,15 @@ bool SimpleSynchronousEntry::InitializeCreatedFile(
 
 int SimpleSynchronousEntry::InitializeForCreate(
     bool had_index,
+    bool index_has_entry,
     SimpleEntryStat* out_entry_stat) {
   DCHECK(!initialized_);
-  if (!CreateFiles(had_index, out_entry_stat)) {
+  if (small_entry_store_.get() && small_entry_store_->loaded()) {
+    // A packed entry the index does not list cannot be opened, evicted or
+    // doomed through the backend, so it must not block the create.
+    if (!CreatePackedFile(had_index && !index_has_entry, out_entry_stat))
+      return net::ERR_FILE_EXISTS;
+  } else if (!CreateFiles(had_index, out_entry_stat)) {
     DLOG(WARNING) << "Could not create platform files.";
     return net::ERR_FILE_EXISTS;
   }
@@ -1074,9 +1252,8 @@ int SimpleSynchronousEntry::ReadAndValidateStream0(
   *stream_0_data = new net::GrowableIOBuffer();
   (*stream_0_data)->SetCapacity(stream_0_size);
   int file_offset = out_entry_stat->GetOffsetInFile(key_, 0, 0);
-  File* file = const_cast<File*>(&files_[0]);
   int bytes_read =
-      file->Read(file_offset, (*stream_0_data)->data(), stream_0_size);
+      ReadFromFile(0, file_offset, (*stream_0_data)->data(), stream_0_size);
   if (bytes_read != stream_0_size)
     return net::ERR_FAILED;
 
@@ -1105,10 +1282,9 @@ int SimpleSynchronousEntry::GetEOFRecordData(int index,
   SimpleFileEOF eof_record;
   int file_offset = entry_stat.GetEOFOffsetInFile(key_, index);
   int file_index = GetFileIndexFromStreamIndex(index);
-  File* file = const_cast<File*>(&files_[file_index]);
-  if (file->Read(file_offset, reinterpret_cast<char*>(&eof_record),
-                 sizeof(eof_record)) !=
-      sizeof(eof_record)) {
+  if (ReadFromFile(file_index, file_offset,
+                   reinterpret_cast<char*>(&eof_record),
+                   sizeof(eof_record)) != sizeof(eof_record)) {
     RecordCheckEOFResult(cache_type_, CHECK_EOF_RESULT_READ_FAILURE);
     return net::ERR_CACHE_CHECKSUM_READ_FAILURE;
   }
@@ -1128,7 +1304,7 @@ int SimpleSynchronousEntry::GetEOFRecordData(int index,
 }
 
 void SimpleSynchronousEntry::Doom() const {
-  DeleteFilesForEntryHash(path_, entry_hash_);
+  DoomEntry(path_, small_entry_store_.get(), entry_hash_);
 }
 
 // static
@@ -19,6 +19,7 @@
 #include "net/base/cache_type.h"
 #include "net/base/net_export.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
+#include "net/disk_cache/simple/simple_small_entry_store.h"
 
 namespace net {
 class GrowableIOBuffer;
@@ -112,30 +113,39 @@ class SimpleSynchronousEntry {
     bool doomed;
   };
 
+  // |small_entry_store| may be NULL; otherwise, small entries are kept in it
+  // instead of in their own files.
   static void OpenEntry(net::CacheType cache_type,
                         const base::FilePath& path,
+                        SimpleSmallEntryStore* small_entry_store,
                         uint64 entry_hash,
                         bool had_index,
                         SimpleEntryCreationResults* out_results);
 
+  // |index_has_entry| is whether the index listed the entry. A packed entry
+  // the index did not list, e.g. one appended after the index was last saved,
+  // is replaced rather than failing the create forever.
   static void CreateEntry(net::CacheType cache_type,
                           const base::FilePath& path,
+                          SimpleSmallEntryStore* small_entry_store,
                           const std::string& key,
-                          uint64 entry_hash,
                           bool had_index,
+                          bool index_has_entry,
                           SimpleEntryCreationResults* out_results);
 
   // Deletes an entry from the file system without affecting the state of the
   // corresponding instance, if any (allowing operations to continue to be
   // executed through that instance). Returns a net error code.
   static int DoomEntry(const base::FilePath& path,
+                       SimpleSmallEntryStore* small_entry_store,
                        uint64 entry_hash);
 
   // Like |DoomEntry()| above. Deletes all entries corresponding to the
   // |key_hashes|. Succeeds only when all entries are deleted. Returns a net
   // error code.
   static int DoomEntrySet(const std::vector<uint64>* key_hashes,
-                          const base::FilePath& path);
+                          const base::FilePath& path,
+                          SimpleSmallEntryStore* small_entry_store);
 
   // N.B. ReadData(), WriteData(), CheckEOFRecord() and Close() may block on IO.
   void ReadData(const EntryOperationData& in_entry_op,
@@ -202,6 +212,7 @@ class SimpleSynchronousEntry {
   SimpleSynchronousEntry(
       net::CacheType cache_type,
       const base::FilePath& path,
+      SimpleSmallEntryStore* small_entry_store,
       const std::string& key,
       uint64 entry_hash);
 
@@ -224,6 +235,24 @@ class SimpleSynchronousEntry {
                  SimpleEntryStat* out_entry_stat);
   bool CreateFiles(bool had_index,
                    SimpleEntryStat* out_entry_stat);
+
+  // Like OpenFiles() and CreateFiles(), for an entry whose file 0 is kept in
+  // |small_entry_store_|. Return false if the store does not hold the entry,
+  // or cannot take it. CreatePackedFile() replaces a packed entry of the same
+  // hash if |replace_existing|.
+  bool OpenPackedFile(SimpleEntryStat* out_entry_stat);
+  bool CreatePackedFile(bool replace_existing,
+                        SimpleEntryStat* out_entry_stat);
+
+  // Moves file 0 of a packed entry out of |small_entry_store_| to its own
+  // file, before it grows too large for the store or gets a stream 2 or
+  // sparse data. Returns false on failure.
+  bool UnpackFile();
+
+  // Access file |file_index|, or the image of file 0 of a packed entry.
+  int ReadFromFile(int file_index, int64 offset, char* data, int size) const;
+  bool WriteToFile(int file_index, int64 offset, const char* data, int size);
+  bool SetFileLength(int file_index, int64 length);
   void CloseFile(int index);
   void CloseFiles();
 
@@ -243,8 +272,10 @@ class SimpleSynchronousEntry {
   // Returns a net error, including net::OK on success and net::FILE_EXISTS
   // when the entry already exists. |had_index| is passed from the main entry
   // for metrics purposes, and is true if the index was initialized when the
-  // create operation began.
-  int InitializeForCreate(bool had_index, SimpleEntryStat* out_entry_stat);
+  // create operation began. |index_has_entry| is as in CreateEntry().
+  int InitializeForCreate(bool had_index,
+                          bool index_has_entry,
+                          SimpleEntryStat* out_entry_stat);
 
   // Allocates and fills a buffer with stream 0 data in |stream_0_data|, then
   // checks its crc32.
@@ -311,6 +342,7 @@ class SimpleSynchronousEntry {
   const net::CacheType cache_type_;
   const base::FilePath path_;
   const uint64 entry_hash_;
+  const scoped_refptr<SimpleSmallEntryStore> small_entry_store_;
   std::string key_;
 
   bool have_open_files_;
@@ -333,6 +365,17 @@ class SimpleSynchronousEntry {
   // True if the entry was created, or false if it was opened. Used to log
   // SimpleCache.*.EntryCreatedWithStream2Omitted only for created entries.
   bool files_created_;
+
+  // True if file 0 is kept in |small_entry_store_|, in which case
+  // |packed_file_| holds its contents instead of |files_[0]|, and is written
+  // back to the store on Close() if |packed_file_dirty_|.
+  bool packed_;
+  std::string packed_file_;
+  bool packed_file_dirty_;
+  SimpleSmallEntryStore::Claim packed_claim_;
+  // True if the entry was doomed while packed. It then stays in memory, like
+  // the open files of a doomed entry, until it is closed.
+  bool packed_claim_revoked_;
 };
 
 }  // namespace disk_cache
@@ -0,0 +1,176 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tracing/cache_trace.h"
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "net/base/net_errors.h"
+
+namespace disk_cache {
+
+namespace {
+
+const uint64 kCacheTraceMagicNumber = GG_UINT64_C(0x6361636865747263);
+const uint32 kCacheTraceVersion = 1;
+
+// Traces are read whole, so make sure a corrupt count cannot make us allocate
+// much more than the file holds.
+const size_t kMinSerializedRecordSize = 40;
+
+void SerializeRecord(const CacheTraceRecord& record, Pickle* pickle) {
+  pickle->WriteInt(record.operation);
+  pickle->WriteUInt64(record.key_hash);
+  pickle->WriteUInt32(record.entry_id);
+  pickle->WriteInt(record.index);
+  pickle->WriteInt64(record.offset);
+  pickle->WriteInt(record.length);
+  pickle->WriteBool(record.truncate);
+  pickle->WriteInt(record.result);
+  pickle->WriteInt64(record.start_time.ToInternalValue());
+  pickle->WriteInt64(record.latency.ToInternalValue());
+}
+
+bool DeserializeRecord(PickleIterator* it, CacheTraceRecord* record) {
+  int operation;
+  int64 start_time;
+  int64 latency;
+  if (!it->ReadInt(&operation) || !it->ReadUInt64(&record->key_hash) ||
+      !it->ReadUInt32(&record->entry_id) || !it->ReadInt(&record->index) ||
+      !it->ReadInt64(&record->offset) || !it->ReadInt(&record->length) ||
+      !it->ReadBool(&record->truncate) || !it->ReadInt(&record->result) ||
+      !it->ReadInt64(&start_time) || !it->ReadInt64(&latency)) {
+    return false;
+  }
+  if (operation < 0 || operation >= CacheTraceRecord::OPERATION_COUNT ||
+      record->offset < 0 || record->length < 0) {
+    return false;
+  }
+  record->operation = static_cast<CacheTraceRecord::Operation>(operation);
+  record->start_time = base::TimeDelta::FromInternalValue(start_time);
+  record->latency = base::TimeDelta::FromInternalValue(latency);
+  return true;
+}
+
+}  // namespace
+
+CacheTraceRecord::CacheTraceRecord()
+    : operation(OPEN),
+      key_hash(0),
+      entry_id(0),
+      index(0),
+      offset(0),
+      length(0),
+      truncate(false),
+      result(net::ERR_IO_PENDING) {
+}
+
+// static
+const size_t CacheTraceRecorder::kNotRecorded = static_cast<size_t>(-1);
+
+CacheTraceRecorder::CacheTraceRecorder()
+    : start_ticks_(base::TimeTicks::Now()),
+      max_records_(kDefaultMaxRecords),
+      dropped_records_(0),
+      last_entry_id_(0) {
+}
+
+CacheTraceRecorder::CacheTraceRecorder(size_t max_records)
+    : start_ticks_(base::TimeTicks::Now()),
+      max_records_(max_records),
+      dropped_records_(0),
+      last_entry_id_(0) {
+}
+
+CacheTraceRecorder::~CacheTraceRecorder() {
+}
+
+size_t CacheTraceRecorder::Begin(const CacheTraceRecord& record) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  if (records_.size() >= max_records_) {
+    ++dropped_records_;
+    return kNotRecorded;
+  }
+  records_.push_back(record);
+  records_.back().start_time = base::TimeTicks::Now() - start_ticks_;
+  return records_.size() - 1;
+}
+
+int CacheTraceRecorder::End(size_t index, int rv) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  if (rv == net::ERR_IO_PENDING || index == kNotRecorded)
+    return rv;
+  CacheTraceRecord* record = &records_[index];
+  record->result = rv;
+  record->latency =
+      base::TimeTicks::Now() - start_ticks_ - record->start_time;
+  return rv;
+}
+
+net::CompletionCallback CacheTraceRecorder::WrapCallback(
+    size_t index,
+    const net::CompletionCallback& callback) {
+  return base::Bind(&CacheTraceRecorder::OnComplete, this, index, callback);
+}
+
+void CacheTraceRecorder::OnComplete(size_t index,
+                                    const net::CompletionCallback& callback,
+                                    int result) {
+  End(index, result);
+  if (!callback.is_null())
+    callback.Run(result);
+}
+
+bool WriteCacheTrace(const base::FilePath& path,
+                     const std::vector<CacheTraceRecord>& records) {
+  Pickle pickle;
+  pickle.WriteUInt64(kCacheTraceMagicNumber);
+  pickle.WriteUInt32(kCacheTraceVersion);
+  pickle.WriteUInt64(records.size());
+  for (size_t i = 0; i < records.size(); ++i)
+    SerializeRecord(records[i], &pickle);
+  const int size = static_cast<int>(pickle.size());
+  return base::WriteFile(path, static_cast<const char*>(pickle.data()),
+                         size) == size;
+}
+
+bool ReadCacheTrace(const base::FilePath& path,
+                    std::vector<CacheTraceRecord>* records) {
+  records->clear();
+  std::string contents;
+  if (!base::ReadFileToString(path, &contents))
+    return false;
+  Pickle pickle(contents.data(), static_cast<int>(contents.size()));
+  if (!pickle.data())
+    return false;
+
+  PickleIterator it(pickle);
+  uint64 magic_number;
+  uint32 version;
+  uint64 count;
+  if (!it.ReadUInt64(&magic_number) || !it.ReadUInt32(&version) ||
+      !it.ReadUInt64(&count)) {
+    return false;
+  }
+  if (magic_number != kCacheTraceMagicNumber ||
+      version != kCacheTraceVersion ||
+      count > contents.size() / kMinSerializedRecordSize) {
+    return false;
+  }
+  records->resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    if (!DeserializeRecord(&it, &(*records)[i])) {
+      records->clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace disk_cache
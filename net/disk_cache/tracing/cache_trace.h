@@ -0,0 +1,130 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_TRACING_CACHE_TRACE_H_
+#define NET_DISK_CACHE_TRACING_CACHE_TRACE_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+#include "net/base/completion_callback.h"
+#include "net/base/net_export.h"
+
+namespace base {
+class FilePath;
+}
+
+namespace disk_cache {
+
+// One operation on a disk_cache::Backend, or on one of its entries. Keys are
+// only recorded as their hashes, and data as its length.
+struct NET_EXPORT_PRIVATE CacheTraceRecord {
+  enum Operation {
+    OPEN,
+    CREATE,
+    DOOM,
+    DOOM_ALL,
+    // The operations below are on the entry |entry_id|.
+    CLOSE,
+    DOOM_ENTRY,
+    READ,
+    WRITE,
+    READ_SPARSE,
+    WRITE_SPARSE,
+    OPERATION_COUNT,
+  };
+
+  CacheTraceRecord();
+
+  Operation operation;
+  uint64 key_hash;
+  // Set by the successful OPEN and CREATE operations to identify the entry
+  // they return, and by the operations on that entry.
+  uint32 entry_id;
+  // The stream of READ and WRITE.
+  int index;
+  int64 offset;
+  int length;
+  bool truncate;
+  // The net error code, or number of bytes, the operation completed with.
+  int result;
+  // When the operation started, since the recorder was created, and how long
+  // it took to complete.
+  base::TimeDelta start_time;
+  base::TimeDelta latency;
+};
+
+// Collects the records of a trace. Shared by a TracingCacheBackend and the
+// entries it returns, which may outlive it. Once it holds |max_records|
+// records, the operations that follow are only counted.
+class NET_EXPORT_PRIVATE CacheTraceRecorder
+    : public base::RefCounted<CacheTraceRecorder> {
+ public:
+  // The index of the operations that were not recorded.
+  static const size_t kNotRecorded;
+
+  // About 6 MB of records.
+  static const size_t kDefaultMaxRecords = 100000;
+
+  CacheTraceRecorder();
+  explicit CacheTraceRecorder(size_t max_records);
+
+  // Starts a record of |record|, whose start time is now. Returns its index,
+  // or kNotRecorded if the recorder is full.
+  size_t Begin(const CacheTraceRecord& record);
+
+  // Completes the record |index| if |rv| is not ERR_IO_PENDING, and returns
+  // |rv|.
+  int End(size_t index, int rv);
+
+  // Returns a callback that completes the record |index| with its result
+  // before running |callback|.
+  net::CompletionCallback WrapCallback(size_t index,
+                                       const net::CompletionCallback& callback);
+
+  uint32 NewEntryId() { return ++last_entry_id_; }
+
+  // Returns NULL for kNotRecorded.
+  CacheTraceRecord* record(size_t index) {
+    return index == kNotRecorded ? NULL : &records_[index];
+  }
+  const std::vector<CacheTraceRecord>& records() const { return records_; }
+
+  // The number of operations not recorded because the recorder was full.
+  size_t dropped_records() const { return dropped_records_; }
+
+ private:
+  friend class base::RefCounted<CacheTraceRecorder>;
+  ~CacheTraceRecorder();
+
+  void OnComplete(size_t index,
+                  const net::CompletionCallback& callback,
+                  int result);
+
+  const base::TimeTicks start_ticks_;
+  const size_t max_records_;
+  std::vector<CacheTraceRecord> records_;
+  size_t dropped_records_;
+  uint32 last_entry_id_;
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(CacheTraceRecorder);
+};
+
+// Writes |records| to the file at |path|. Returns false on failure.
+NET_EXPORT_PRIVATE bool WriteCacheTrace(
+    const base::FilePath& path,
+    const std::vector<CacheTraceRecord>& records);
+
+// Reads the trace at |path| into |records|. Returns false if the file cannot
+// be read or is not a valid trace.
+NET_EXPORT_PRIVATE bool ReadCacheTrace(const base::FilePath& path,
+                                       std::vector<CacheTraceRecord>* records);
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_TRACING_CACHE_TRACE_H_
@@ -0,0 +1,174 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tracing/cache_trace_replayer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace disk_cache {
+
+CacheTraceReplayer::Results::Results()
+    : lookups(0), hits(0), bytes_written(0), skipped_operations(0) {
+}
+
+CacheTraceReplayer::Results::~Results() {
+}
+
+base::TimeDelta CacheTraceReplayer::Results::GetLatencyPercentile(
+    CacheTraceRecord::Operation operation,
+    int percentile) const {
+  DCHECK_GE(percentile, 0);
+  DCHECK_LE(percentile, 100);
+  std::vector<base::TimeDelta> sorted = latencies[operation];
+  if (sorted.empty())
+    return base::TimeDelta();
+  std::vector<base::TimeDelta>::iterator nth =
+      sorted.begin() + (sorted.size() - 1) * percentile / 100;
+  std::nth_element(sorted.begin(), nth, sorted.end());
+  return *nth;
+}
+
+double CacheTraceReplayer::Results::GetHitRate() const {
+  return lookups ? 100.0 * hits / lookups : 0;
+}
+
+CacheTraceReplayer::CacheTraceReplayer(Backend* backend)
+    : backend_(backend), buffer_length_(0) {
+}
+
+CacheTraceReplayer::~CacheTraceReplayer() {
+  for (std::map<uint32, Entry*>::iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    it->second->Close();
+  }
+}
+
+void CacheTraceReplayer::Replay(const std::vector<CacheTraceRecord>& trace,
+                                Results* results) {
+  for (size_t i = 0; i < trace.size(); ++i) {
+    const base::TimeTicks start = base::TimeTicks::Now();
+    if (ReplayRecord(trace[i], results)) {
+      results->latencies[trace[i].operation].push_back(
+          base::TimeTicks::Now() - start);
+    } else {
+      ++results->skipped_operations;
+    }
+  }
+}
+
+// static
+std::string CacheTraceReplayer::GetKeyForHash(uint64 key_hash) {
+  return "cache-trace-" + base::Uint64ToString(key_hash);
+}
+
+bool CacheTraceReplayer::ReplayRecord(const CacheTraceRecord& record,
+                                      Results* results) {
+  net::TestCompletionCallback cb;
+  const std::string key = GetKeyForHash(record.key_hash);
+  switch (record.operation) {
+    case CacheTraceRecord::OPEN:
+    case CacheTraceRecord::CREATE: {
+      Entry* entry = NULL;
+      int rv;
+      if (record.operation == CacheTraceRecord::OPEN) {
+        ++results->lookups;
+        rv = cb.GetResult(backend_->OpenEntry(key, &entry, cb.callback()));
+        if (rv == net::OK)
+          ++results->hits;
+        else if (record.entry_id)
+          rv = cb.GetResult(backend_->CreateEntry(key, &entry, cb.callback()));
+      } else {
+        rv = cb.GetResult(backend_->CreateEntry(key, &entry, cb.callback()));
+        if (rv != net::OK && record.entry_id)
+          rv = cb.GetResult(backend_->OpenEntry(key, &entry, cb.callback()));
+      }
+      if (rv != net::OK)
+        return !record.entry_id;
+      if (!record.entry_id || entries_.count(record.entry_id)) {
+        // The trace did not get this entry, so nothing uses it.
+        entry->Close();
+        return true;
+      }
+      entries_[record.entry_id] = entry;
+      return true;
+    }
+    case CacheTraceRecord::DOOM:
+      cb.GetResult(backend_->DoomEntry(key, cb.callback()));
+      return true;
+    case CacheTraceRecord::DOOM_ALL:
+      cb.GetResult(backend_->DoomAllEntries(cb.callback()));
+      return true;
+    default:
+      break;
+  }
+
+  Entry* entry = FindEntry(record);
+  if (!entry)
+    return false;
+  switch (record.operation) {
+    case CacheTraceRecord::CLOSE:
+      entry->Close();
+      entries_.erase(record.entry_id);
+      return true;
+    case CacheTraceRecord::DOOM_ENTRY:
+      entry->Doom();
+      return true;
+    case CacheTraceRecord::READ:
+      cb.GetResult(entry->ReadData(record.index,
+                                   static_cast<int>(record.offset),
+                                   GetBuffer(record.length), record.length,
+                                   cb.callback()));
+      return true;
+    case CacheTraceRecord::WRITE: {
+      const int rv = cb.GetResult(entry->WriteData(
+          record.index, static_cast<int>(record.offset),
+          GetBuffer(record.length), record.length, cb.callback(),
+          record.truncate));
+      if (rv > 0)
+        results->bytes_written += rv;
+      return true;
+    }
+    case CacheTraceRecord::READ_SPARSE:
+      cb.GetResult(entry->ReadSparseData(record.offset,
+                                         GetBuffer(record.length),
+                                         record.length, cb.callback()));
+      return true;
+    case CacheTraceRecord::WRITE_SPARSE: {
+      const int rv = cb.GetResult(entry->WriteSparseData(
+          record.offset, GetBuffer(record.length), record.length,
+          cb.callback()));
+      if (rv > 0)
+        results->bytes_written += rv;
+      return true;
+    }
+    default:
+      NOTREACHED();
+      return false;
+  }
+}
+
+Entry* CacheTraceReplayer::FindEntry(const CacheTraceRecord& record) const {
+  std::map<uint32, Entry*>::const_iterator it =
+      entries_.find(record.entry_id);
+  return it == entries_.end() ? NULL : it->second;
+}
+
+net::IOBuffer* CacheTraceReplayer::GetBuffer(int length) {
+  if (length > buffer_length_) {
+    buffer_length_ = length;
+    buffer_ = new net::IOBuffer(buffer_length_);
+    memset(buffer_->data(), 0, buffer_length_);
+  }
+  return buffer_.get();
+}
+
+}  // namespace disk_cache
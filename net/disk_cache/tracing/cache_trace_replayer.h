@@ -0,0 +1,85 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_TRACING_CACHE_TRACE_REPLAYER_H_
+#define NET_DISK_CACHE_TRACING_CACHE_TRACE_REPLAYER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/time/time.h"
+#include "net/disk_cache/tracing/cache_trace.h"
+
+namespace net {
+class IOBuffer;
+}
+
+namespace disk_cache {
+
+class Backend;
+class Entry;
+
+// Replays a trace recorded by TracingCacheBackend against a backend, one
+// operation at a time, and measures how the backend performs. The entries are
+// named after the key hashes of the trace, and hold zeros.
+//
+// The backend may not hold the entries the trace found: the lookups then
+// count as misses, and the entries are created so that the writes that
+// follow still take place. Operations on entries that could not be opened or
+// created are skipped.
+class CacheTraceReplayer {
+ public:
+  struct Results {
+    Results();
+    ~Results();
+
+    // Returns the |percentile|th percentile of the latencies of |operation|,
+    // or zero if none was replayed.
+    base::TimeDelta GetLatencyPercentile(CacheTraceRecord::Operation operation,
+                                         int percentile) const;
+
+    // Returns the percentage of lookups that found their entry.
+    double GetHitRate() const;
+
+    std::vector<base::TimeDelta> latencies[CacheTraceRecord::OPERATION_COUNT];
+    int lookups;
+    int hits;
+    int64 bytes_written;
+    int skipped_operations;
+  };
+
+  explicit CacheTraceReplayer(Backend* backend);
+  ~CacheTraceReplayer();
+
+  // Replays |trace|, adding to |results|. Must be called on a thread with a
+  // message loop, which is run until each operation completes.
+  void Replay(const std::vector<CacheTraceRecord>& trace, Results* results);
+
+  static std::string GetKeyForHash(uint64 key_hash);
+
+ private:
+  // Replays |record|, and returns whether it could be.
+  bool ReplayRecord(const CacheTraceRecord& record, Results* results);
+
+  // Returns the entry the operations of |record| apply to, or NULL.
+  Entry* FindEntry(const CacheTraceRecord& record) const;
+
+  // Returns a buffer of at least |length| bytes.
+  net::IOBuffer* GetBuffer(int length);
+
+  Backend* const backend_;
+  // The entries opened by the replay, by the ids they have in the trace.
+  std::map<uint32, Entry*> entries_;
+  scoped_refptr<net::IOBuffer> buffer_;
+  int buffer_length_;
+
+  DISALLOW_COPY_AND_ASSIGN(CacheTraceReplayer);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_TRACING_CACHE_TRACE_REPLAYER_H_
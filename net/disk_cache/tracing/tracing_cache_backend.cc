@@ -0,0 +1,285 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tracing/tracing_cache_backend.h"
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/simple/simple_util.h"
+
+namespace disk_cache {
+
+namespace {
+
+class TracingEntry : public Entry {
+ public:
+  TracingEntry(Entry* entry,
+               const scoped_refptr<CacheTraceRecorder>& recorder,
+               uint32 entry_id,
+               uint64 key_hash)
+      : entry_(entry),
+        recorder_(recorder),
+        entry_id_(entry_id),
+        key_hash_(key_hash) {}
+
+  // Entry:
+  void Doom() override {
+    const size_t record = Begin(CacheTraceRecord::DOOM_ENTRY);
+    entry_->Doom();
+    recorder_->End(record, net::OK);
+  }
+
+  void Close() override {
+    const size_t record = Begin(CacheTraceRecord::CLOSE);
+    entry_->Close();
+    recorder_->End(record, net::OK);
+    delete this;
+  }
+
+  std::string GetKey() const override { return entry_->GetKey(); }
+
+  base::Time GetLastUsed() const override { return entry_->GetLastUsed(); }
+
+  base::Time GetLastModified() const override {
+    return entry_->GetLastModified();
+  }
+
+  int32 GetDataSize(int index) const override {
+    return entry_->GetDataSize(index);
+  }
+
+  int ReadData(int index,
+               int offset,
+               IOBuffer* buf,
+               int buf_len,
+               const CompletionCallback& callback) override {
+    const size_t record =
+        Begin(CacheTraceRecord::READ, index, offset, buf_len, false);
+    return recorder_->End(
+        record, entry_->ReadData(index, offset, buf, buf_len,
+                                 recorder_->WrapCallback(record, callback)));
+  }
+
+  int WriteData(int index,
+                int offset,
+                IOBuffer* buf,
+                int buf_len,
+                const CompletionCallback& callback,
+                bool truncate) override {
+    const size_t record =
+        Begin(CacheTraceRecord::WRITE, index, offset, buf_len, truncate);
+    return recorder_->End(
+        record,
+        entry_->WriteData(index, offset, buf, buf_len,
+                          recorder_->WrapCallback(record, callback),
+                          truncate));
+  }
+
+  int ReadSparseData(int64 offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback) override {
+    const size_t record =
+        Begin(CacheTraceRecord::READ_SPARSE, 0, offset, buf_len, false);
+    return recorder_->End(
+        record, entry_->ReadSparseData(
+                    offset, buf, buf_len,
+                    recorder_->WrapCallback(record, callback)));
+  }
+
+  int WriteSparseData(int64 offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback) override {
+    const size_t record =
+        Begin(CacheTraceRecord::WRITE_SPARSE, 0, offset, buf_len, false);
+    return recorder_->End(
+        record, entry_->WriteSparseData(
+                    offset, buf, buf_len,
+                    recorder_->WrapCallback(record, callback)));
+  }
+
+  int GetAvailableRange(int64 offset,
+                        int len,
+                        int64* start,
+                        const CompletionCallback& callback) override {
+    return entry_->GetAvailableRange(offset, len, start, callback);
+  }
+
+  bool CouldBeSparse() const override { return entry_->CouldBeSparse(); }
+
+  void CancelSparseIO() override { entry_->CancelSparseIO(); }
+
+  int ReadyForSparseIO(const CompletionCallback& callback) override {
+    return entry_->ReadyForSparseIO(callback);
+  }
+
+ private:
+  ~TracingEntry() override {}
+
+  size_t Begin(CacheTraceRecord::Operation operation) {
+    return Begin(operation, 0, 0, 0, false);
+  }
+
+  size_t Begin(CacheTraceRecord::Operation operation,
+               int index,
+               int64 offset,
+               int length,
+               bool truncate) {
+    CacheTraceRecord record;
+    record.operation = operation;
+    record.key_hash = key_hash_;
+    record.entry_id = entry_id_;
+    record.index = index;
+    record.offset = offset;
+    record.length = length;
+    record.truncate = truncate;
+    return recorder_->Begin(record);
+  }
+
+  Entry* const entry_;
+  scoped_refptr<CacheTraceRecorder> recorder_;
+  const uint32 entry_id_;
+  const uint64 key_hash_;
+
+  DISALLOW_COPY_AND_ASSIGN(TracingEntry);
+};
+
+// Completes the record |index| of an OPEN or CREATE operation, and wraps the
+// entry it returned, if any.
+void CompleteOpenOrCreate(const scoped_refptr<CacheTraceRecorder>& recorder,
+                          size_t index,
+                          Entry* inner_entry,
+                          Entry** entry,
+                          int result) {
+  if (result == net::OK) {
+    CacheTraceRecord* record = recorder->record(index);
+    if (record) {
+      record->entry_id = recorder->NewEntryId();
+      *entry = new TracingEntry(inner_entry, recorder, record->entry_id,
+                                record->key_hash);
+    } else {
+      // The recorder is full, so the operations on the entry would not be
+      // recorded either.
+      *entry = inner_entry;
+    }
+  }
+  recorder->End(index, result);
+}
+
+void OnOpenOrCreateComplete(const scoped_refptr<CacheTraceRecorder>& recorder,
+                            size_t index,
+                            Entry** inner_entry,
+                            Entry** entry,
+                            const net::CompletionCallback& callback,
+                            int result) {
+  CompleteOpenOrCreate(recorder, index, *inner_entry, entry, result);
+  callback.Run(result);
+}
+
+}  // namespace
+
+TracingCacheBackend::TracingCacheBackend(
+    scoped_ptr<Backend> backend,
+    const scoped_refptr<CacheTraceRecorder>& recorder)
+    : backend_(backend.Pass()), recorder_(recorder) {
+}
+
+TracingCacheBackend::~TracingCacheBackend() {
+}
+
+net::CacheType TracingCacheBackend::GetCacheType() const {
+  return backend_->GetCacheType();
+}
+
+int32 TracingCacheBackend::GetEntryCount() const {
+  return backend_->GetEntryCount();
+}
+
+int TracingCacheBackend::OpenEntry(const std::string& key,
+                                   Entry** entry,
+                                   const CompletionCallback& callback) {
+  return OpenOrCreateEntry(CacheTraceRecord::OPEN, key, entry, callback);
+}
+
+int TracingCacheBackend::CreateEntry(const std::string& key,
+                                     Entry** entry,
+                                     const CompletionCallback& callback) {
+  return OpenOrCreateEntry(CacheTraceRecord::CREATE, key, entry, callback);
+}
+
+int TracingCacheBackend::DoomEntry(const std::string& key,
+                                   const CompletionCallback& callback) {
+  CacheTraceRecord record;
+  record.operation = CacheTraceRecord::DOOM;
+  record.key_hash = simple_util::GetEntryHashKey(key);
+  const size_t index = recorder_->Begin(record);
+  return recorder_->End(
+      index,
+      backend_->DoomEntry(key, recorder_->WrapCallback(index, callback)));
+}
+
+int TracingCacheBackend::DoomAllEntries(const CompletionCallback& callback) {
+  CacheTraceRecord record;
+  record.operation = CacheTraceRecord::DOOM_ALL;
+  const size_t index = recorder_->Begin(record);
+  return recorder_->End(
+      index,
+      backend_->DoomAllEntries(recorder_->WrapCallback(index, callback)));
+}
+
+int TracingCacheBackend::DoomEntriesBetween(
+    base::Time initial_time,
+    base::Time end_time,
+    const CompletionCallback& callback) {
+  return backend_->DoomEntriesBetween(initial_time, end_time, callback);
+}
+
+int TracingCacheBackend::DoomEntriesSince(base::Time initial_time,
+                                          const CompletionCallback& callback) {
+  return backend_->DoomEntriesSince(initial_time, callback);
+}
+
+scoped_ptr<Backend::Iterator> TracingCacheBackend::CreateIterator() {
+  return backend_->CreateIterator();
+}
+
+void TracingCacheBackend::GetStats(
+    std::vector<std::pair<std::string, std::string> >* stats) {
+  backend_->GetStats(stats);
+}
+
+void TracingCacheBackend::OnExternalCacheHit(const std::string& key) {
+  backend_->OnExternalCacheHit(key);
+}
+
+int TracingCacheBackend::OpenOrCreateEntry(
+    CacheTraceRecord::Operation operation,
+    const std::string& key,
+    Entry** entry,
+    const CompletionCallback& callback) {
+  DCHECK(operation == CacheTraceRecord::OPEN ||
+         operation == CacheTraceRecord::CREATE);
+  CacheTraceRecord record;
+  record.operation = operation;
+  record.key_hash = simple_util::GetEntryHashKey(key);
+  const size_t index = recorder_->Begin(record);
+
+  // The inner entry is only known when the operation completes, and is then
+  // wrapped into |entry|.
+  Entry** inner_entry = new Entry*(NULL);
+  const CompletionCallback on_complete =
+      base::Bind(&OnOpenOrCreateComplete, recorder_, index,
+                 base::Owned(inner_entry), entry, callback);
+  const int rv =
+      operation == CacheTraceRecord::OPEN
+          ? backend_->OpenEntry(key, inner_entry, on_complete)
+          : backend_->CreateEntry(key, inner_entry, on_complete);
+  if (rv != net::ERR_IO_PENDING)
+    CompleteOpenOrCreate(recorder_, index, *inner_entry, entry, rv);
+  return rv;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,228 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tracing/tracing_cache_backend.h"
+
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/single_thread_task_runner.h"
+#include "net/base/cache_type.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/simple/simple_util.h"
+#include "net/disk_cache/tracing/cache_trace.h"
+#include "net/disk_cache/tracing/cache_trace_replayer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+scoped_ptr<Backend> CreateMemoryBackend() {
+  net::TestCompletionCallback cb;
+  scoped_ptr<Backend> backend;
+  int rv = CreateCacheBackend(net::MEMORY_CACHE, net::CACHE_BACKEND_DEFAULT,
+                              base::FilePath(), 0, false, NULL, NULL,
+                              &backend, cb.callback());
+  EXPECT_EQ(net::OK, cb.GetResult(rv));
+  return backend.Pass();
+}
+
+CacheTraceRecord MakeRecord(CacheTraceRecord::Operation operation,
+                            uint64 key_hash,
+                            uint32 entry_id) {
+  CacheTraceRecord record;
+  record.operation = operation;
+  record.key_hash = key_hash;
+  record.entry_id = entry_id;
+  record.result = net::OK;
+  return record;
+}
+
+class TracingCacheBackendTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    recorder_ = new CacheTraceRecorder;
+    backend_.reset(new TracingCacheBackend(CreateMemoryBackend(), recorder_));
+  }
+
+  // Runs the operations traced by RecordAndReplay.
+  void RunOperations() {
+    const int kSize = 100;
+    scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+    memset(buffer->data(), 'x', kSize);
+    net::TestCompletionCallback cb;
+    Entry* entry = NULL;
+    ASSERT_EQ(net::OK,
+              cb.GetResult(backend_->CreateEntry("a", &entry, cb.callback())));
+    EXPECT_EQ(kSize, cb.GetResult(entry->WriteData(
+                         1, 0, buffer.get(), kSize, cb.callback(), false)));
+    entry->Close();
+
+    ASSERT_EQ(net::OK,
+              cb.GetResult(backend_->OpenEntry("a", &entry, cb.callback())));
+    EXPECT_EQ("a", entry->GetKey());
+    EXPECT_EQ(kSize, cb.GetResult(entry->ReadData(1, 0, buffer.get(), kSize,
+                                                  cb.callback())));
+    entry->Close();
+
+    EXPECT_NE(net::OK,
+              cb.GetResult(backend_->OpenEntry("b", &entry, cb.callback())));
+    EXPECT_EQ(net::OK, cb.GetResult(backend_->DoomEntry("a", cb.callback())));
+  }
+
+  scoped_refptr<CacheTraceRecorder> recorder_;
+  scoped_ptr<Backend> backend_;
+};
+
+}  // namespace
+
+TEST_F(TracingCacheBackendTest, RecordAndReplay) {
+  RunOperations();
+
+  const uint64 kHashA = simple_util::GetEntryHashKey("a");
+  const struct {
+    CacheTraceRecord::Operation operation;
+    uint64 key_hash;
+    uint32 entry_id;
+    int length;
+    int result;
+  } kExpected[] = {
+    { CacheTraceRecord::CREATE, kHashA, 1, 0, net::OK },
+    { CacheTraceRecord::WRITE, kHashA, 1, 100, 100 },
+    { CacheTraceRecord::CLOSE, kHashA, 1, 0, net::OK },
+    { CacheTraceRecord::OPEN, kHashA, 2, 0, net::OK },
+    { CacheTraceRecord::READ, kHashA, 2, 100, 100 },
+    { CacheTraceRecord::CLOSE, kHashA, 2, 0, net::OK },
+    { CacheTraceRecord::OPEN, simple_util::GetEntryHashKey("b"), 0, 0,
+      net::ERR_FAILED },
+    { CacheTraceRecord::DOOM, kHashA, 0, 0, net::OK },
+  };
+  const std::vector<CacheTraceRecord>& records = recorder_->records();
+  ASSERT_EQ(arraysize(kExpected), records.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(kExpected[i].operation, records[i].operation) << i;
+    EXPECT_EQ(kExpected[i].key_hash, records[i].key_hash) << i;
+    EXPECT_EQ(kExpected[i].entry_id, records[i].entry_id) << i;
+    EXPECT_EQ(kExpected[i].length, records[i].length) << i;
+    EXPECT_EQ(kExpected[i].result, records[i].result) << i;
+    if (i > 0)
+      EXPECT_LE(records[i - 1].start_time, records[i].start_time) << i;
+  }
+  EXPECT_EQ(1, records[1].index);
+
+  // The trace survives a round trip through a file.
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const base::FilePath path = temp_dir.path().AppendASCII("trace");
+  ASSERT_TRUE(WriteCacheTrace(path, records));
+  std::vector<CacheTraceRecord> trace;
+  ASSERT_TRUE(ReadCacheTrace(path, &trace));
+  ASSERT_EQ(records.size(), trace.size());
+  for (size_t i = 0; i < trace.size(); ++i) {
+    EXPECT_EQ(records[i].operation, trace[i].operation) << i;
+    EXPECT_EQ(records[i].key_hash, trace[i].key_hash) << i;
+    EXPECT_EQ(records[i].entry_id, trace[i].entry_id) << i;
+    EXPECT_EQ(records[i].index, trace[i].index) << i;
+    EXPECT_EQ(records[i].length, trace[i].length) << i;
+    EXPECT_EQ(records[i].result, trace[i].result) << i;
+    EXPECT_EQ(records[i].start_time, trace[i].start_time) << i;
+    EXPECT_EQ(records[i].latency, trace[i].latency) << i;
+  }
+
+  scoped_ptr<Backend> replay_backend = CreateMemoryBackend();
+  CacheTraceReplayer::Results results;
+  {
+    CacheTraceReplayer replayer(replay_backend.get());
+    replayer.Replay(trace, &results);
+  }
+  EXPECT_EQ(2, results.lookups);
+  EXPECT_EQ(1, results.hits);
+  EXPECT_EQ(50.0, results.GetHitRate());
+  EXPECT_EQ(100, results.bytes_written);
+  EXPECT_EQ(0, results.skipped_operations);
+  EXPECT_EQ(2U, results.latencies[CacheTraceRecord::OPEN].size());
+  EXPECT_EQ(2U, results.latencies[CacheTraceRecord::CLOSE].size());
+  EXPECT_EQ(0, replay_backend->GetEntryCount());
+}
+
+// Tests that the entries the replayed backend does not hold are created, and
+// that operations on entries the replay never got are skipped.
+TEST_F(TracingCacheBackendTest, ReplayMissingEntries) {
+  std::vector<CacheTraceRecord> trace;
+  trace.push_back(MakeRecord(CacheTraceRecord::OPEN, 1, 1));
+  trace.push_back(MakeRecord(CacheTraceRecord::WRITE, 1, 1));
+  trace.back().length = 10;
+  trace.push_back(MakeRecord(CacheTraceRecord::READ, 2, 2));
+  trace.push_back(MakeRecord(CacheTraceRecord::CLOSE, 1, 1));
+
+  scoped_ptr<Backend> replay_backend = CreateMemoryBackend();
+  CacheTraceReplayer::Results results;
+  CacheTraceReplayer replayer(replay_backend.get());
+  replayer.Replay(trace, &results);
+  EXPECT_EQ(1, results.lookups);
+  EXPECT_EQ(0, results.hits);
+  EXPECT_EQ(10, results.bytes_written);
+  EXPECT_EQ(1, results.skipped_operations);
+  EXPECT_EQ(1, replay_backend->GetEntryCount());
+}
+
+// Tests that a full recorder counts the operations it does not record, and
+// that the cache works as usual.
+TEST_F(TracingCacheBackendTest, RecorderFull) {
+  recorder_ = new CacheTraceRecorder(4);
+  backend_.reset(new TracingCacheBackend(CreateMemoryBackend(), recorder_));
+  RunOperations();
+
+  const std::vector<CacheTraceRecord>& records = recorder_->records();
+  ASSERT_EQ(4U, records.size());
+  EXPECT_EQ(CacheTraceRecord::CREATE, records[0].operation);
+  EXPECT_EQ(CacheTraceRecord::OPEN, records[3].operation);
+  EXPECT_EQ(net::OK, records[3].result);
+  EXPECT_EQ(4U, recorder_->dropped_records());
+}
+
+TEST_F(TracingCacheBackendTest, LatencyPercentiles) {
+  CacheTraceReplayer::Results results;
+  EXPECT_EQ(base::TimeDelta(),
+            results.GetLatencyPercentile(CacheTraceRecord::READ, 50));
+  for (int i = 100; i > 0; --i) {
+    results.latencies[CacheTraceRecord::READ].push_back(
+        base::TimeDelta::FromMilliseconds(i));
+  }
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(50),
+            results.GetLatencyPercentile(CacheTraceRecord::READ, 50));
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(99),
+            results.GetLatencyPercentile(CacheTraceRecord::READ, 99));
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(100),
+            results.GetLatencyPercentile(CacheTraceRecord::READ, 100));
+}
+
+TEST_F(TracingCacheBackendTest, ReadCorruptTrace) {
+  RunOperations();
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const base::FilePath path = temp_dir.path().AppendASCII("trace");
+  std::vector<CacheTraceRecord> trace;
+  EXPECT_FALSE(ReadCacheTrace(path, &trace));
+
+  ASSERT_TRUE(WriteCacheTrace(path, recorder_->records()));
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(path, &contents));
+  const int truncated_size = static_cast<int>(contents.size()) - 8;
+  ASSERT_EQ(truncated_size,
+            base::WriteFile(path, contents.data(), truncated_size));
+  EXPECT_FALSE(ReadCacheTrace(path, &trace));
+  EXPECT_TRUE(trace.empty());
+
+  ASSERT_EQ(7, base::WriteFile(path, "garbage", 7));
+  EXPECT_FALSE(ReadCacheTrace(path, &trace));
+}
+
+}  // namespace disk_cache
@@ -5,6 +5,7 @@
 #include "net/http/http_cache.h"
 
 #include <algorithm>
+#include <vector>
 
 #include "base/compiler_specific.h"
 
@@ -37,6 +38,8 @@
 #include "net/base/network_delegate.h"
 #include "net/base/upload_data_stream.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/tracing/cache_trace.h"
+#include "net/disk_cache/tracing/tracing_cache_backend.h"
 #include "net/http/disk_based_cert_cache.h"
 #include "net/http/disk_cache_based_quic_server_info.h"
 #include "net/http/http_cache_transaction.h"
@@ -55,6 +58,18 @@ bool UseCertCache() {
          "ExperimentGroup";
 }
 
+void OnTracedBackendCreated(
+    const scoped_refptr<disk_cache::CacheTraceRecorder>& recorder,
+    scoped_ptr<disk_cache::Backend>* backend,
+    const net::CompletionCallback& callback,
+    int result) {
+  if (result == net::OK) {
+    backend->reset(new disk_cache::TracingCacheBackend(backend->Pass(),
+                                                       recorder));
+  }
+  callback.Run(result);
+}
+
 // Adaptor to delete a file on a worker thread.
 void DeletePath(base::FilePath path) {
   base::DeleteFile(path, false);
@@ -85,19 +100,34 @@ HttpCache::BackendFactory* HttpCache::DefaultBackend::InMemory(int max_bytes) {
                             base::FilePath(), max_bytes, NULL);
 }
 
+void HttpCache::DefaultBackend::set_trace_recorder(
+    const scoped_refptr<disk_cache::CacheTraceRecorder>& recorder) {
+  trace_recorder_ = recorder;
+}
+
 int HttpCache::DefaultBackend::CreateBackend(
     NetLog* net_log, scoped_ptr<disk_cache::Backend>* backend,
     const CompletionCallback& callback) {
   DCHECK_GE(max_bytes_, 0);
-  return disk_cache::CreateCacheBackend(type_,
-                                        backend_type_,
-                                        path_,
-                                        max_bytes_,
-                                        true,
-                                        thread_,
-                                        net_log,
-                                        backend,
-                                        callback);
+  if (!trace_recorder_.get()) {
+    return disk_cache::CreateCacheBackend(type_,
+                                          backend_type_,
+                                          path_,
+                                          max_bytes_,
+                                          true,
+                                          thread_,
+                                          net_log,
+                                          backend,
+                                          callback);
+  }
+  int rv = disk_cache::CreateCacheBackend(
+      type_, backend_type_, path_, max_bytes_, true, thread_, net_log, backend,
+      base::Bind(&OnTracedBackendCreated, trace_recorder_, backend, callback));
+  if (rv == OK) {
+    backend->reset(new disk_cache::TracingCacheBackend(backend->Pass(),
+                                                       trace_recorder_));
+  }
+  return rv;
 }
 
 //-----------------------------------------------------------------------------
@@ -106,7 +136,8 @@ HttpCache::ActiveEntry::ActiveEntry(disk_cache::Entry* entry)
     : disk_entry(entry),
       writer(NULL),
       will_process_pending_queue(false),
-      doomed(false) {
+      doomed(false),
+      shareable(false) {
 }
 
 HttpCache::ActiveEntry::~ActiveEntry() {
@@ -507,6 +538,7 @@ HttpCache::~HttpCache() {
     entry->will_process_pending_queue = false;
     entry->pending_queue.clear();
     entry->readers.clear();
+    entry->shared_readers.clear();
     entry->writer = NULL;
     DeactivateEntry(entry);
   }
@@ -993,6 +1025,16 @@ int HttpCache::AddTransactionToEntry(ActiveEntry* entry, Transaction* trans) {
   //
   // NOTE: If the transaction can only write, then the entry should not be in
   // use (since any existing entry should have already been doomed).
+  //
+  // Once the writer has stored the response headers, transactions that only
+  // need the stored response don't have to wait: they read the body as it is
+  // written, instead of being serialized behind the network transaction of
+  // the writer.
+
+  if (entry->writer && entry->shareable && trans->CanReadWhileWriting()) {
+    entry->shared_readers.push_back(trans);
+    return OK;
+  }
 
   if (entry->writer || entry->will_process_pending_queue) {
     entry->pending_queue.push_back(trans);
@@ -1028,8 +1070,10 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
   if (entry->will_process_pending_queue && entry->readers.empty())
     return;
 
-  if (entry->writer) {
-    DCHECK(trans == entry->writer);
+  if (entry->writer == trans) {
+    // Another transaction may be able to finish storing the response.
+    if (cancel && HandOffWriting(entry, trans))
+      return;
 
     // Assume there was a failure.
     bool success = false;
@@ -1041,6 +1085,9 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
       // The previous operation may have deleted the entry.
       if (!trans->entry())
         return;
+      // The entry is kept, but the rest of the response will never arrive.
+      if (trans->truncated())
+        FailSharedReaders(entry);
     }
     DoneWritingToEntry(entry, success);
   } else {
@@ -1051,7 +1098,15 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
 void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
   DCHECK(entry->readers.empty());
 
+  // The transactions that were reading the response as it arrived keep going
+  // as regular readers.
+  if (!success)
+    FailSharedReaders(entry);
+  NotifySharedReaders(entry);
+  entry->readers.swap(entry->shared_readers);
+
   entry->writer = NULL;
+  entry->shareable = false;
 
   if (success) {
     ProcessPendingQueue(entry);
@@ -1062,8 +1117,14 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
     TransactionList pending_queue;
     pending_queue.swap(entry->pending_queue);
 
-    entry->disk_entry->Doom();
-    DestroyEntry(entry);
+    if (entry->readers.empty()) {
+      entry->disk_entry->Doom();
+      DestroyEntry(entry);
+    } else if (!entry->doomed) {
+      // Keep the entry for the readers of the partial response, but don't let
+      // anybody else find it.
+      DoomEntry(entry->disk_entry->GetKey(), NULL);
+    }
 
     // We need to do something about these pending entries, which now need to
     // be added to a new entry.
@@ -1076,7 +1137,15 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
 }
 
 void HttpCache::DoneReadingFromEntry(ActiveEntry* entry, Transaction* trans) {
-  DCHECK(!entry->writer);
+  if (entry->writer) {
+    // |trans| was reading the response while it is being written.
+    TransactionList::iterator it = std::find(entry->shared_readers.begin(),
+                                             entry->shared_readers.end(),
+                                             trans);
+    DCHECK(it != entry->shared_readers.end());
+    entry->shared_readers.erase(it);
+    return;
+  }
 
   TransactionList::iterator it =
       std::find(entry->readers.begin(), entry->readers.end(), trans);
@@ -1100,6 +1169,52 @@ void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
   ProcessPendingQueue(entry);
 }
 
+void HttpCache::MakeEntryShareable(ActiveEntry* entry) {
+  DCHECK(entry->writer);
+  DCHECK(entry->readers.empty());
+  entry->shareable = true;
+
+  // The writer is in the middle of its own work, so the pending transactions
+  // are resumed from a separate task, as ProcessPendingQueue does.
+  if (entry->pending_queue.empty())
+    return;
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE, base::Bind(&HttpCache::OnEntryShareable, GetWeakPtr(),
+                            entry->disk_entry->GetKey()));
+}
+
+bool HttpCache::HandOffWriting(ActiveEntry* entry, Transaction* writer) {
+  DCHECK_EQ(writer, entry->writer);
+  if (!writer->CanHandOffWriting())
+    return false;
+
+  for (TransactionList::iterator it = entry->shared_readers.begin();
+       it != entry->shared_readers.end(); ++it) {
+    Transaction* trans = *it;
+    if (!trans->CanTakeOverWriting())
+      continue;
+    entry->shared_readers.erase(it);
+    entry->writer = trans;
+    trans->TakeOverWriting(writer);
+    return true;
+  }
+  return false;
+}
+
+void HttpCache::NotifySharedReaders(ActiveEntry* entry) {
+  for (TransactionList::iterator it = entry->shared_readers.begin();
+       it != entry->shared_readers.end(); ++it) {
+    (*it)->OnWriterProgress();
+  }
+}
+
+void HttpCache::FailSharedReaders(ActiveEntry* entry) {
+  for (TransactionList::iterator it = entry->shared_readers.begin();
+       it != entry->shared_readers.end(); ++it) {
+    (*it)->OnWriterFailed();
+  }
+}
+
 LoadState HttpCache::GetLoadStateForPendingTransaction(
       const Transaction* trans) {
   ActiveEntriesMap::const_iterator i = active_entries_.find(trans->key());
@@ -1262,6 +1377,33 @@ void HttpCache::OnProcessPendingQueue(ActiveEntry* entry) {
   }
 }
 
+void HttpCache::OnEntryShareable(const std::string& key) {
+  // The entry may be gone, or be written by another transaction by now.
+  ActiveEntry* entry = FindActiveEntry(key);
+  if (!entry || !entry->writer || !entry->shareable)
+    return;
+
+  // Let the pending transactions that can read the response as it arrives
+  // join the entry. The rest keep waiting for the writer to finish.
+  std::vector<CompletionCallback> callbacks;
+  TransactionList::iterator it = entry->pending_queue.begin();
+  while (it != entry->pending_queue.end()) {
+    Transaction* trans = *it;
+    if (!trans->CanReadWhileWriting()) {
+      ++it;
+      continue;
+    }
+    entry->shared_readers.push_back(trans);
+    callbacks.push_back(trans->io_callback());
+    it = entry->pending_queue.erase(it);
+  }
+
+  // Running a callback may destroy other transactions, so don't use them past
+  // this point (the callbacks are bound to weak pointers).
+  for (size_t i = 0; i < callbacks.size(); i++)
+    callbacks[i].Run(OK);
+}
+
 void HttpCache::OnIOComplete(int result, PendingOp* pending_op) {
   WorkItemOperation op = pending_op->writer->operation();
 
@@ -42,6 +42,7 @@ class SingleThreadTaskRunner;
 
 namespace disk_cache {
 class Backend;
+class CacheTraceRecorder;
 class Entry;
 }  // namespace disk_cache
 
@@ -113,6 +114,11 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     // Returns a factory for an in-memory cache.
     static BackendFactory* InMemory(int max_bytes);
 
+    // Makes the backends created afterwards record their operations to
+    // |recorder|, so that they can be replayed against other backends.
+    void set_trace_recorder(
+        const scoped_refptr<disk_cache::CacheTraceRecorder>& recorder);
+
     // BackendFactory implementation.
     int CreateBackend(NetLog* net_log,
                       scoped_ptr<disk_cache::Backend>* backend,
@@ -124,6 +130,7 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     const base::FilePath path_;
     int max_bytes_;
     scoped_refptr<base::SingleThreadTaskRunner> thread_;
+    scoped_refptr<disk_cache::CacheTraceRecorder> trace_recorder_;
   };
 
   // The disk cache is initialized lazily (by CreateTransaction) in this case.
@@ -261,9 +268,15 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     disk_cache::Entry* disk_entry;
     Transaction*       writer;
     TransactionList    readers;
+    // Transactions that read the response while |writer| is still storing
+    // it, instead of waiting in |pending_queue| for the writer to finish.
+    TransactionList    shared_readers;
     TransactionList    pending_queue;
     bool               will_process_pending_queue;
     bool               doomed;
+    // True when |writer| stores a full response that other transactions can
+    // read as it arrives.
+    bool               shareable;
   };
 
   typedef base::hash_map<std::string, ActiveEntry*> ActiveEntriesMap;
@@ -366,6 +379,27 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   // transactions can start reading from this entry.
   void ConvertWriterToReader(ActiveEntry* entry);
 
+  // Called by the writer of |entry| once the response headers are stored and
+  // the body follows. From this point on, the transactions that can read the
+  // response while it is being written join |entry| right away, instead of
+  // waiting for the writer to finish. The ones already waiting join from a
+  // separate task.
+  void MakeEntryShareable(ActiveEntry* entry);
+
+  // Called when |writer|, the writer of |entry|, is cancelled. Hands its
+  // network transaction to one of the transactions reading |entry| while it is
+  // being written, which becomes the writer. Returns false if |writer| cannot
+  // hand off its network transaction, or no transaction can take it.
+  bool HandOffWriting(ActiveEntry* entry, Transaction* writer);
+
+  // Wakes up the transactions reading |entry| while it is being written. Called
+  // after appending data to the response body, and when the writer is done.
+  void NotifySharedReaders(ActiveEntry* entry);
+
+  // Tells the transactions reading |entry| while it is being written that the
+  // writer will not store the rest of the response.
+  void FailSharedReaders(ActiveEntry* entry);
+
   // Returns the LoadState of the provided pending transaction.
   LoadState GetLoadStateForPendingTransaction(const Transaction* trans);
 
@@ -400,6 +434,10 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
 
   void OnProcessPendingQueue(ActiveEntry* entry);
 
+  // Lets the pending transactions of the active entry for |key| that can read
+  // the response while it is being written join the entry.
+  void OnEntryShareable(const std::string& key);
+
   // Callbacks ----------------------------------------------------------------
 
   // Processes BackendCallback notifications.
@@ -0,0 +1,129 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/bind.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop/message_loop.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/http/http_transaction.h"
+#include "net/http/http_transaction_test_util.h"
+#include "net/http/mock_http_cache.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kBodySize = 4 * 1024 * 1024;
+const int kReadSize = 16 * 1024;
+const int kNumTransactions = 20;
+
+// Reads the whole response of a request for |trans_info|, and records when
+// the first byte of the body arrives.
+class CacheClient {
+ public:
+  CacheClient() : done_(false) {}
+
+  void Start(MockHttpCache* cache, const MockTransaction& trans_info) {
+    request_.reset(new MockHttpRequest(trans_info));
+    ASSERT_EQ(net::OK, cache->CreateTransaction(&trans_));
+    start_time_ = base::TimeTicks::Now();
+    int rv = trans_->Start(
+        request_.get(),
+        base::Bind(&CacheClient::OnStartComplete, base::Unretained(this)),
+        net::BoundNetLog());
+    if (rv != net::ERR_IO_PENDING)
+      OnStartComplete(rv);
+  }
+
+  bool done() const { return done_; }
+  base::TimeDelta time_to_first_byte() const {
+    return first_byte_time_ - start_time_;
+  }
+
+ private:
+  void OnStartComplete(int result) {
+    ASSERT_EQ(net::OK, result);
+    buf_ = new net::IOBuffer(kReadSize);
+    Read();
+  }
+
+  void Read() {
+    for (;;) {
+      int rv = trans_->Read(
+          buf_.get(), kReadSize,
+          base::Bind(&CacheClient::OnReadComplete, base::Unretained(this)));
+      if (rv == net::ERR_IO_PENDING || !HandleRead(rv))
+        return;
+    }
+  }
+
+  void OnReadComplete(int result) {
+    if (HandleRead(result))
+      Read();
+  }
+
+  // Returns true if there is more to read.
+  bool HandleRead(int result) {
+    EXPECT_LE(0, result);
+    if (result <= 0) {
+      done_ = true;
+      return false;
+    }
+    if (first_byte_time_.is_null())
+      first_byte_time_ = base::TimeTicks::Now();
+    return true;
+  }
+
+  scoped_ptr<MockHttpRequest> request_;
+  scoped_ptr<net::HttpTransaction> trans_;
+  scoped_refptr<net::IOBuffer> buf_;
+  base::TimeTicks start_time_;
+  base::TimeTicks first_byte_time_;
+  bool done_;
+
+  DISALLOW_COPY_AND_ASSIGN(CacheClient);
+};
+
+// Measures how long a burst of requests for the same uncached resource takes
+// to start receiving data, while the first request fetches it from the
+// network and stores it.
+TEST(HttpCachePerfTest, ConcurrentRequests) {
+  base::MessageLoopForIO message_loop;
+  MockHttpCache cache;
+  std::string body(kBodySize, 'a');
+  ScopedMockTransaction trans_info(kSimpleGET_Transaction);
+  trans_info.data = body.c_str();
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  ScopedVector<CacheClient> clients;
+  for (int i = 0; i < kNumTransactions; i++) {
+    clients.push_back(new CacheClient());
+    clients.back()->Start(&cache, trans_info);
+  }
+  base::MessageLoop::current()->RunUntilIdle();
+  base::TimeDelta total_time = base::TimeTicks::Now() - start;
+
+  base::TimeDelta first_byte_time;
+  for (size_t i = 0; i < clients.size(); i++) {
+    ASSERT_TRUE(clients[i]->done());
+    first_byte_time += clients[i]->time_to_first_byte();
+  }
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+
+  base::LogPerfResult("HttpCache_concurrent_requests_time_to_first_byte",
+                      first_byte_time.InMillisecondsF() / clients.size(),
+                      "ms");
+  base::LogPerfResult("HttpCache_concurrent_requests_total_time",
+                      total_time.InMillisecondsF(), "ms");
+}
+
+}  // namespace
@@ -330,6 +330,10 @@ HttpCache::Transaction::Transaction(
       vary_mismatch_(false),
       couldnt_conditionalize_request_(false),
       bypass_lock_for_test_(false),
+      shared_read_(false),
+      shared_read_allowed_(true),
+      waiting_for_writer_(false),
+      writer_failed_(false),
       io_buf_len_(0),
       read_offset_(0),
       effective_load_flags_(0),
@@ -362,6 +366,11 @@ HttpCache::Transaction::~Transaction() {
         }
       }
 
+      // We may have taken over writing the entry, without reading from the
+      // network yet.
+      if (entry_->writer == this && mode_ == READ)
+        mode_ = WRITE;
+
       cache_->DoneWithEntry(entry_, this, cancel_request);
     } else if (cache_pending_) {
       cache_->RemovePendingTransaction(this);
@@ -414,6 +423,56 @@ LoadState HttpCache::Transaction::GetWriterLoadState() const {
   return LOAD_STATE_WAITING_FOR_CACHE;
 }
 
+bool HttpCache::Transaction::CanReadWhileWriting() const {
+  // Byte range requests, and requests that cannot use the stored response as
+  // it is, have to wait for the writer to finish.
+  return shared_read_allowed_ && (mode_ & READ_DATA) && !partial_.get() &&
+         request_->method == "GET";
+}
+
+void HttpCache::Transaction::OnWriterProgress() {
+  if (!waiting_for_writer_)
+    return;
+
+  // The writer may be in the middle of its own IO, so resume the read from a
+  // separate task.
+  waiting_for_writer_ = false;
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE,
+      base::Bind(&Transaction::OnIOComplete, weak_factory_.GetWeakPtr(), OK));
+}
+
+void HttpCache::Transaction::OnWriterFailed() {
+  writer_failed_ = true;
+  OnWriterProgress();
+}
+
+bool HttpCache::Transaction::CanHandOffWriting() const {
+  if (!network_trans_.get() || partial_.get() || done_reading_ || truncated_)
+    return false;
+
+  // The network transaction must stand where the stored data ends, so it
+  // cannot be handed off while we read from it or store what we read.
+  return next_state_ != STATE_NETWORK_READ_COMPLETE &&
+         next_state_ != STATE_CACHE_WRITE_DATA_COMPLETE;
+}
+
+bool HttpCache::Transaction::CanTakeOverWriting() const {
+  // We must be committed to the stored response, without a network
+  // transaction of our own.
+  return shared_read_ && mode_ == READ && !network_trans_.get() &&
+         !writer_failed_ && response_.headers.get();
+}
+
+void HttpCache::Transaction::TakeOverWriting(Transaction* writer) {
+  DCHECK_EQ(this, entry_->writer);
+  network_trans_ = writer->network_trans_.Pass();
+
+  // If we are waiting for more data, we are at the end of what is stored, and
+  // can move on to the network.
+  OnWriterProgress();
+}
+
 const BoundNetLog& HttpCache::Transaction::net_log() const {
   return net_log_;
 }
@@ -577,8 +636,10 @@ void HttpCache::Transaction::StopCaching() {
   // TODO(mmenke):  This doesn't release the lock on the cache entry, so a
   //                future request for the resource will be blocked on this one.
   //                Fix this.
+  // Other transactions may be reading the response as we write it, so we keep
+  // caching for their sake.
   if (cache_.get() && entry_ && (mode_ & WRITE) && network_trans_.get() &&
-      !is_sparse_ && !range_requested_) {
+      !is_sparse_ && !range_requested_ && entry_->shared_readers.empty()) {
     mode_ = NONE;
   }
 }
@@ -625,6 +686,10 @@ const HttpResponseInfo* HttpCache::Transaction::GetResponseInfo() const {
 }
 
 LoadState HttpCache::Transaction::GetLoadState() const {
+  // While we wait for more data, the writer is the one doing the work.
+  if (waiting_for_writer_ && entry_ && entry_->writer)
+    return entry_->writer->GetWriterLoadState();
+
   LoadState state = GetWriterLoadState();
   if (state != LOAD_STATE_WAITING_FOR_CACHE)
     return state;
@@ -1427,8 +1492,10 @@ int HttpCache::Transaction::DoAddToEntryComplete(int result) {
   DCHECK(new_entry_);
   cache_pending_ = false;
 
-  if (result == OK)
+  if (result == OK) {
     entry_ = new_entry_;
+    shared_read_ = entry_->writer && entry_->writer != this;
+  }
 
   // If there is a failure, the cache should have taken care of new_entry_.
   new_entry_ = NULL;
@@ -1638,8 +1705,12 @@ int HttpCache::Transaction::DoPartialHeadersReceived() {
       entry_->disk_entry->GetDataSize(kMetadataIndex))
     next_state_ = STATE_CACHE_READ_METADATA;
 
-  if (!partial_.get())
+  if (!partial_.get()) {
+    // Other transactions can read the body of the response as we store it.
+    if (entry_ && mode_ == WRITE && request_->method == "GET")
+      cache_->MakeEntryShareable(entry_);
     return OK;
+  }
 
   if (reading_) {
     if (network_trans_.get()) {
@@ -1675,6 +1746,19 @@ int HttpCache::Transaction::DoCacheReadResponseComplete(int result) {
     return OnCacheReadError(result, true);
   }
 
+  if (shared_read_ && entry_->writer != this) {
+    if (!CanUseSharedResponse())
+      return WaitForWriter();
+
+    // Hold on to the headers until the writer stores some data, so that we
+    // can still go to the network if the writer gives up right away.
+    if (!entry_->disk_entry->GetDataSize(kResponseContentIndex)) {
+      waiting_for_writer_ = true;
+      next_state_ = STATE_CACHE_READ_RESPONSE;
+      return ERR_IO_PENDING;
+    }
+  }
+
   // cert_cache() will be null if the CertCacheTrial field trial is disabled.
   if (cache_->cert_cache() && response_.ssl_info.is_valid())
     ReadCertChain();
@@ -1826,6 +1910,26 @@ int HttpCache::Transaction::DoCacheReadDataComplete(int result) {
   if (result > 0) {
     read_offset_ += result;
   } else if (result == 0) {  // End of file.
+    if (shared_read_ && entry_->writer == this) {
+      // We took over the network transaction of the writer, which stands
+      // where the stored data ends.
+      mode_ = WRITE;
+      next_state_ = STATE_NETWORK_READ;
+      return OK;
+    }
+    if (shared_read_ && entry_->writer) {
+      // The writer has not stored the rest of the response yet.
+      next_state_ = STATE_CACHE_READ_DATA;
+      if (entry_->disk_entry->GetDataSize(kResponseContentIndex) > read_offset_)
+        return OK;
+      waiting_for_writer_ = true;
+      return ERR_IO_PENDING;
+    }
+    if (writer_failed_) {
+      // The rest of the response is not coming, and there is no way to tell
+      // the caller about it other than failing the read.
+      return ERR_CACHE_READ_FAILURE;
+    }
     RecordHistograms();
     cache_->DoneReadingFromEntry(entry_, this);
     entry_ = NULL;
@@ -1871,6 +1975,9 @@ int HttpCache::Transaction::DoCacheWriteDataComplete(int result) {
       done_reading_ = true;
   }
 
+  if (entry_ && result > 0)
+    cache_->NotifySharedReaders(entry_);
+
   if (partial_.get()) {
     // This may be the last request.
     if (!(result == 0 && !truncated_ &&
@@ -2603,7 +2710,10 @@ int HttpCache::Transaction::SetupEntryForRead() {
       partial_.reset();
     }
   }
-  cache_->ConvertWriterToReader(entry_);
+  // A transaction that joined the entry while it was being written is a
+  // reader already.
+  if (!shared_read_)
+    cache_->ConvertWriterToReader(entry_);
   mode_ = READ;
 
   if (request_->method == "HEAD")
@@ -2754,6 +2864,32 @@ void HttpCache::Transaction::OnAddToEntryTimeout(base::TimeTicks start_time) {
   OnIOComplete(ERR_CACHE_LOCK_TIMEOUT);
 }
 
+bool HttpCache::Transaction::CanUseSharedResponse() {
+  // The writer may be gone already, or the stored response may be incomplete.
+  if (!entry_->writer || truncated_)
+    return false;
+
+  if (mode_ == READ)
+    return true;
+
+  // We cannot validate the response, or update the entry, while it is being
+  // written. That includes a Vary mismatch.
+  return RequiresValidation() == VALIDATION_NONE;
+}
+
+int HttpCache::Transaction::WaitForWriter() {
+  cache_->DoneWithEntry(entry_, this, false);
+  entry_ = NULL;
+  shared_read_ = false;
+  shared_read_allowed_ = false;
+  writer_failed_ = false;
+  truncated_ = false;
+  vary_mismatch_ = false;
+  response_ = HttpResponseInfo();
+  next_state_ = STATE_INIT_ENTRY;
+  return OK;
+}
+
 void HttpCache::Transaction::DoomPartialEntry(bool delete_object) {
   DVLOG(2) << "DoomPartialEntry";
   int rv = cache_->DoomEntry(cache_key_, NULL);
@@ -94,6 +94,34 @@ class HttpCache::Transaction : public HttpTransaction {
 
   HttpCache::ActiveEntry* entry() { return entry_; }
 
+  // Returns true if the response stored in the entry is incomplete.
+  bool truncated() const { return truncated_; }
+
+  // Returns true if this transaction can use the response of an entry while
+  // another transaction is still writing it, reading the body as it arrives.
+  bool CanReadWhileWriting() const;
+
+  // Called by the cache when the writer of the entry that this transaction
+  // reads appends data to the response body, or stops writing it.
+  void OnWriterProgress();
+
+  // Called by the cache when the writer of the entry that this transaction
+  // reads stops before storing the whole response body.
+  void OnWriterFailed();
+
+  // Returns true if this transaction, the writer of its entry, can give its
+  // network transaction to another transaction to finish storing the response.
+  bool CanHandOffWriting() const;
+
+  // Returns true if this transaction, which reads the response while it is
+  // being written, can take over the network transaction of the writer.
+  bool CanTakeOverWriting() const;
+
+  // Makes this transaction the writer of its entry, with the network
+  // transaction of |writer|. The rest of the response is read from the network
+  // once the data stored so far is read.
+  void TakeOverWriting(Transaction* writer);
+
   // Returns the LoadState of the writer transaction of a given ActiveEntry. In
   // other words, returns the LoadState of this transaction without asking the
   // http cache, because this transaction should be the one currently writing
@@ -369,6 +397,16 @@ class HttpCache::Transaction : public HttpTransaction {
   // Called when the cache lock timeout fires.
   void OnAddToEntryTimeout(base::TimeTicks start_time);
 
+  // Returns true if the response that is being written to the entry can be
+  // used as it is, so that this transaction doesn't have to wait for the
+  // writer to finish.
+  bool CanUseSharedResponse();
+
+  // Leaves the entry that is being written by another transaction, and starts
+  // over waiting for the writer to finish, like any other transaction that may
+  // have to validate or update the entry.
+  int WaitForWriter();
+
   // Deletes the current partial cache entry (sparse), and optionally removes
   // the control object (partial_).
   void DoomPartialEntry(bool delete_object);
@@ -432,6 +470,10 @@ class HttpCache::Transaction : public HttpTransaction {
   bool vary_mismatch_;  // The request doesn't match the stored vary data.
   bool couldnt_conditionalize_request_;
   bool bypass_lock_for_test_;  // A test is exercising the cache lock.
+  bool shared_read_;  // We read the entry while another transaction writes it.
+  bool shared_read_allowed_;  // We may join an entry that is being written.
+  bool waiting_for_writer_;  // We wait for the writer to append more data.
+  bool writer_failed_;  // The writer didn't store the whole response.
   scoped_refptr<IOBuffer> read_buf_;
   int io_buf_len_;
   int read_offset_;
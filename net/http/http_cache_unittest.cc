@@ -24,6 +24,7 @@
 #include "net/base/upload_bytes_element_reader.h"
 #include "net/cert/cert_status_flags.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/tracing/cache_trace.h"
 #include "net/http/http_byte_range.h"
 #include "net/http/http_request_headers.h"
 #include "net/http/http_request_info.h"
@@ -558,6 +559,50 @@ TEST(HttpCache, GetBackend) {
   EXPECT_EQ(net::OK, cb.GetResult(rv));
 }
 
+// Tests that a backend created by a factory with a trace recorder records the
+// operations of the cache.
+TEST(HttpCache, TraceRecorder) {
+  scoped_refptr<disk_cache::CacheTraceRecorder> recorder(
+      new disk_cache::CacheTraceRecorder);
+  net::HttpCache::DefaultBackend* factory =
+      new net::HttpCache::DefaultBackend(net::MEMORY_CACHE,
+                                         net::CACHE_BACKEND_DEFAULT,
+                                         base::FilePath(), 0, NULL);
+  factory->set_trace_recorder(recorder);
+  MockHttpCache cache(factory);
+
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+
+  int lookups = 0;
+  int hits = 0;
+  int writes = 0;
+  int reads = 0;
+  const std::vector<disk_cache::CacheTraceRecord>& records =
+      recorder->records();
+  for (size_t i = 0; i < records.size(); ++i) {
+    switch (records[i].operation) {
+      case disk_cache::CacheTraceRecord::OPEN:
+        ++lookups;
+        if (records[i].result == net::OK)
+          ++hits;
+        break;
+      case disk_cache::CacheTraceRecord::WRITE:
+        ++writes;
+        break;
+      case disk_cache::CacheTraceRecord::READ:
+        ++reads;
+        break;
+      default:
+        break;
+    }
+  }
+  EXPECT_EQ(2, lookups);
+  EXPECT_EQ(1, hits);
+  EXPECT_LT(0, writes);
+  EXPECT_LT(0, reads);
+}
+
 TEST(HttpCache, SimpleGET) {
   MockHttpCache cache;
   net::CapturingBoundNetLog log;
@@ -1374,11 +1419,12 @@ TEST(HttpCache, SimpleGET_RacingReaders) {
   c->result = c->callback.WaitForResult();
   ReadAndVerifyTransaction(c->trans.get(), kSimpleGET_Transaction);
 
-  // Now we have 2 active readers and two queued transactions.
+  // Now we have 4 active readers: the queued transactions joined the entry
+  // while the first one was writing it.
 
   EXPECT_EQ(net::LOAD_STATE_IDLE,
             context_list[2]->trans->GetLoadState());
-  EXPECT_EQ(net::LOAD_STATE_WAITING_FOR_CACHE,
+  EXPECT_EQ(net::LOAD_STATE_IDLE,
             context_list[3]->trans->GetLoadState());
 
   c = context_list[1];
@@ -1387,10 +1433,8 @@ TEST(HttpCache, SimpleGET_RacingReaders) {
   if (c->result == net::OK)
     ReadAndVerifyTransaction(c->trans.get(), kSimpleGET_Transaction);
 
-  // At this point we have one reader, two pending transactions and a task on
-  // the queue to move to the next transaction. Now we cancel the request that
-  // is the current reader, and expect the queued task to be able to start the
-  // next request.
+  // Now we cancel one of the readers, and expect the rest of the requests to
+  // complete.
 
   c = context_list[2];
   c->trans.reset();
@@ -1415,6 +1459,190 @@ TEST(HttpCache, SimpleGET_RacingReaders) {
   }
 }
 
+// Tests that a transaction can read a response while another transaction is
+// still writing it to the cache.
+TEST(HttpCache, SimpleGET_ReadWhileWriting) {
+  MockHttpCache cache;
+  MockHttpRequest request(kSimpleGET_Transaction);
+  const std::string kData(kSimpleGET_Transaction.data);
+  const int kFirstPart = 10;
+
+  Context writer;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&writer.trans));
+  writer.result = writer.trans->Start(&request, writer.callback.callback(),
+                                      net::BoundNetLog());
+  ASSERT_EQ(net::OK, writer.callback.GetResult(writer.result));
+
+  // Store the first part of the body.
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kFirstPart));
+  net::TestCompletionCallback callback;
+  int rv = writer.trans->Read(buf.get(), kFirstPart, callback.callback());
+  ASSERT_EQ(kFirstPart, callback.GetResult(rv));
+
+  Context reader;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&reader.trans));
+  reader.result = reader.trans->Start(&request, reader.callback.callback(),
+                                      net::BoundNetLog());
+  ASSERT_EQ(net::OK, reader.callback.GetResult(reader.result));
+
+  // The reader gets what is stored so far, and then waits for the writer.
+  scoped_refptr<net::IOBuffer> reader_buf(new net::IOBuffer(256));
+  rv = reader.trans->Read(reader_buf.get(), 256, callback.callback());
+  ASSERT_EQ(kFirstPart, callback.GetResult(rv));
+  EXPECT_EQ(kData.substr(0, kFirstPart),
+            std::string(reader_buf->data(), kFirstPart));
+
+  rv = reader.trans->Read(reader_buf.get(), 256, reader.callback.callback());
+  ASSERT_EQ(net::ERR_IO_PENDING, rv);
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_FALSE(reader.callback.have_result());
+
+  std::string content;
+  EXPECT_EQ(net::OK, ReadTransaction(writer.trans.get(), &content));
+  EXPECT_EQ(kData.substr(kFirstPart), content);
+
+  rv = reader.callback.WaitForResult();
+  ASSERT_LT(0, rv);
+  content.assign(reader_buf->data(), rv);
+  std::string rest;
+  EXPECT_EQ(net::OK, ReadTransaction(reader.trans.get(), &rest));
+  EXPECT_EQ(kData.substr(kFirstPart), content + rest);
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that a transaction reading a response while it is being written takes
+// over the network transaction of the writer if the writer goes away.
+TEST(HttpCache, SimpleGET_ReadWhileWriting_CancelWriter) {
+  MockHttpCache cache;
+  MockHttpRequest request(kSimpleGET_Transaction);
+  const std::string kData(kSimpleGET_Transaction.data);
+  const int kFirstPart = 10;
+
+  Context writer;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&writer.trans));
+  writer.result = writer.trans->Start(&request, writer.callback.callback(),
+                                      net::BoundNetLog());
+  ASSERT_EQ(net::OK, writer.callback.GetResult(writer.result));
+
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kFirstPart));
+  net::TestCompletionCallback callback;
+  int rv = writer.trans->Read(buf.get(), kFirstPart, callback.callback());
+  ASSERT_EQ(kFirstPart, callback.GetResult(rv));
+
+  Context reader;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&reader.trans));
+  reader.result = reader.trans->Start(&request, reader.callback.callback(),
+                                      net::BoundNetLog());
+  ASSERT_EQ(net::OK, reader.callback.GetResult(reader.result));
+
+  scoped_refptr<net::IOBuffer> reader_buf(new net::IOBuffer(256));
+  rv = reader.trans->Read(reader_buf.get(), 256, callback.callback());
+  ASSERT_EQ(kFirstPart, callback.GetResult(rv));
+  rv = reader.trans->Read(reader_buf.get(), 256, reader.callback.callback());
+  ASSERT_EQ(net::ERR_IO_PENDING, rv);
+
+  writer.trans.reset();
+  rv = reader.callback.WaitForResult();
+  ASSERT_LT(0, rv);
+  std::string content(reader_buf->data(), rv);
+  std::string rest;
+  EXPECT_EQ(net::OK, ReadTransaction(reader.trans.get(), &rest));
+  EXPECT_EQ(kData.substr(kFirstPart), content + rest);
+  reader.trans.reset();
+
+  // The whole response was stored.
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that a transaction reading a response while it is being written fails
+// if the writer goes away in the middle of a network read, as the data of that
+// read is lost.
+TEST(HttpCache, SimpleGET_ReadWhileWriting_CancelReadingWriter) {
+  MockHttpCache cache;
+  MockHttpRequest request(kSimpleGET_Transaction);
+  const int kFirstPart = 10;
+
+  Context writer;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&writer.trans));
+  writer.result = writer.trans->Start(&request, writer.callback.callback(),
+                                      net::BoundNetLog());
+  ASSERT_EQ(net::OK, writer.callback.GetResult(writer.result));
+
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kFirstPart));
+  net::TestCompletionCallback callback;
+  int rv = writer.trans->Read(buf.get(), kFirstPart, callback.callback());
+  ASSERT_EQ(kFirstPart, callback.GetResult(rv));
+
+  Context reader;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&reader.trans));
+  reader.result = reader.trans->Start(&request, reader.callback.callback(),
+                                      net::BoundNetLog());
+  ASSERT_EQ(net::OK, reader.callback.GetResult(reader.result));
+
+  scoped_refptr<net::IOBuffer> reader_buf(new net::IOBuffer(256));
+  rv = reader.trans->Read(reader_buf.get(), 256, callback.callback());
+  ASSERT_EQ(kFirstPart, callback.GetResult(rv));
+  rv = reader.trans->Read(reader_buf.get(), 256, reader.callback.callback());
+  ASSERT_EQ(net::ERR_IO_PENDING, rv);
+
+  net::TestCompletionCallback writer_callback;
+  rv = writer.trans->Read(buf.get(), kFirstPart, writer_callback.callback());
+  ASSERT_EQ(net::ERR_IO_PENDING, rv);
+  writer.trans.reset();
+  EXPECT_EQ(net::ERR_CACHE_READ_FAILURE, reader.callback.WaitForResult());
+  reader.trans.reset();
+
+  // The next request goes to the network.
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+}
+
+// Tests that a transaction that cannot use the response being written waits
+// for the writer to finish.
+TEST(HttpCache, SimpleGET_ReadWhileWriting_Validate) {
+  MockHttpCache cache;
+  MockHttpRequest request(kSimpleGET_Transaction);
+  MockHttpRequest validate_request(kSimpleGET_Transaction);
+  validate_request.load_flags |= net::LOAD_VALIDATE_CACHE;
+  const int kFirstPart = 10;
+
+  Context writer;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&writer.trans));
+  writer.result = writer.trans->Start(&request, writer.callback.callback(),
+                                      net::BoundNetLog());
+  ASSERT_EQ(net::OK, writer.callback.GetResult(writer.result));
+
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kFirstPart));
+  net::TestCompletionCallback callback;
+  int rv = writer.trans->Read(buf.get(), kFirstPart, callback.callback());
+  ASSERT_EQ(kFirstPart, callback.GetResult(rv));
+
+  Context reader;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&reader.trans));
+  reader.result = reader.trans->Start(&validate_request,
+                                      reader.callback.callback(),
+                                      net::BoundNetLog());
+  ASSERT_EQ(net::ERR_IO_PENDING, reader.result);
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_FALSE(reader.callback.have_result());
+
+  std::string content;
+  EXPECT_EQ(net::OK, ReadTransaction(writer.trans.get(), &content));
+
+  EXPECT_EQ(net::OK, reader.callback.WaitForResult());
+  ReadAndVerifyTransaction(reader.trans.get(), kSimpleGET_Transaction);
+
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
 // Tests that we can doom an entry with pending transactions and delete one of
 // the pending transactions before the first one completes.
 // See http://code.google.com/p/chromium/issues/detail?id=25588
@@ -44,6 +44,8 @@
 
 #include "net/http/http_chunked_decoder.h"
 
+#include <string.h>
+
 #include <algorithm>
 
 #include "base/logging.h"
@@ -69,15 +71,22 @@ HttpChunkedDecoder::HttpChunkedDecoder()
 int HttpChunkedDecoder::FilterBuf(char* buf, int buf_len) {
   int result = 0;
 
+  // Chunk data is moved down to the end of the data decoded so far, as it is
+  // found, so that each byte of the buffer is moved at most once.
+  const char* in = buf;
+
   while (buf_len) {
     if (chunk_remaining_) {
       int num = std::min(chunk_remaining_, buf_len);
 
+      if (in != buf + result)
+        memmove(buf + result, in, num);
+
       buf_len -= num;
       chunk_remaining_ -= num;
 
       result += num;
-      buf += num;
+      in += num;
 
       // After each chunk's data there should be a CRLF
       if (!chunk_remaining_)
@@ -88,13 +97,12 @@ int HttpChunkedDecoder::FilterBuf(char* buf, int buf_len) {
       break;  // Done!
     }
 
-    int bytes_consumed = ScanForChunkRemaining(buf, buf_len);
+    int bytes_consumed = ScanForChunkRemaining(in, buf_len);
     if (bytes_consumed < 0)
       return bytes_consumed; // Error
 
     buf_len -= bytes_consumed;
-    if (buf_len)
-      memmove(buf, buf + bytes_consumed, buf_len);
+    in += bytes_consumed;
   }
 
   return result;
@@ -106,12 +114,13 @@ int HttpChunkedDecoder::ScanForChunkRemaining(const char* buf, int buf_len) {
 
   int bytes_consumed = 0;
 
-  size_t index_of_lf = base::StringPiece(buf, buf_len).find('\n');
-  if (index_of_lf != base::StringPiece::npos) {
-    buf_len = static_cast<int>(index_of_lf);
+  const char* lf = static_cast<const char*>(memchr(buf, '\n', buf_len));
+  if (lf) {
+    int index_of_lf = static_cast<int>(lf - buf);
+    buf_len = index_of_lf;
     if (buf_len && buf[buf_len - 1] == '\r')  // Eliminate a preceding CR.
       buf_len--;
-    bytes_consumed = static_cast<int>(index_of_lf) + 1;
+    bytes_consumed = index_of_lf + 1;
 
     // Make buf point to the full line buffer to parse.
     if (!line_buf_.empty()) {
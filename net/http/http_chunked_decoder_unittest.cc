@@ -6,6 +6,7 @@
 
 #include "base/basictypes.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/strings/stringprintf.h"
 #include "net/base/net_errors.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -324,6 +325,25 @@ TEST(HttpChunkedDecoderTest, MultipleExtraDataBlocks) {
   RunTest(inputs, arraysize(inputs), "hello", true, 11);
 }
 
+// Many small chunks in one buffer, with data after the last chunk.
+TEST(HttpChunkedDecoderTest, ManySmallChunks) {
+  std::string input;
+  std::string expected_output;
+  for (int i = 0; i < 1000; ++i) {
+    std::string data(i % 7 + 1, static_cast<char>('a' + i % 26));
+    input.append(base::StringPrintf("%X\r\n", static_cast<int>(data.size())));
+    input.append(data);
+    input.append("\r\n");
+    expected_output.append(data);
+  }
+  input.append("0\r\n\r\nextra");
+
+  const char* inputs[] = {
+    input.c_str()
+  };
+  RunTest(inputs, arraysize(inputs), expected_output.c_str(), true, 5);
+}
+
 // Test when the line with the chunk length is too long.
 TEST(HttpChunkedDecoderTest, LongChunkLengthLine) {
   int big_chunk_length = HttpChunkedDecoder::kMaxLineBufLen;
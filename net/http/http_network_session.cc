@@ -13,6 +13,7 @@
 #include "base/strings/string_util.h"
 #include "base/values.h"
 #include "net/http/http_auth_handler_factory.h"
+#include "net/http/http_preconnect_predictor.h"
 #include "net/http/http_response_body_drainer.h"
 #include "net/http/http_stream_factory_impl.h"
 #include "net/http/url_security_manager.h"
@@ -99,7 +100,8 @@ HttpNetworkSession::Params::Params()
       quic_max_packet_length(kDefaultMaxPacketSize),
       enable_user_alternate_protocol_ports(false),
       quic_crypto_client_stream_factory(NULL),
-      proxy_delegate(NULL) {
+      proxy_delegate(NULL),
+      enable_preconnect_predictor(false) {
   quic_supported_versions.push_back(QUIC_VERSION_23);
 }
 
@@ -192,6 +194,11 @@ HttpNetworkSession::HttpNetworkSession(const Params& params)
     huffman_aggregator_.reset(new HpackHuffmanAggregator());
   }
 
+  if (params.enable_preconnect_predictor) {
+    preconnect_predictor_.reset(new HttpPreconnectPredictor(
+        this, HttpPreconnectPredictor::Params()));
+  }
+
   http_server_properties_->SetAlternateProtocolProbabilityThreshold(
       params.alternate_protocol_probability_threshold);
 }
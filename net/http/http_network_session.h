@@ -38,6 +38,7 @@ class HostResolver;
 class HpackHuffmanAggregator;
 class HttpAuthHandlerFactory;
 class HttpNetworkSessionPeer;
+class HttpPreconnectPredictor;
 class HttpProxyClientSocketPool;
 class HttpResponseBodyDrainer;
 class HttpServerProperties;
@@ -125,6 +126,8 @@ class NET_EXPORT HttpNetworkSession
     QuicVersionVector quic_supported_versions;
     QuicTagVector quic_connection_options;
     ProxyDelegate* proxy_delegate;
+    // Keeps warm connections to origins that get many requests.
+    bool enable_preconnect_predictor;
   };
 
   enum SocketPoolType {
@@ -176,6 +179,10 @@ class NET_EXPORT HttpNetworkSession
   HttpStreamFactory* http_stream_factory_for_websocket() {
     return http_stream_factory_for_websocket_.get();
   }
+  // Returns NULL unless |enable_preconnect_predictor| is set.
+  HttpPreconnectPredictor* preconnect_predictor() {
+    return preconnect_predictor_.get();
+  }
   NetLog* net_log() {
     return net_log_;
   }
@@ -235,6 +242,7 @@ class NET_EXPORT HttpNetworkSession
   SpdySessionPool spdy_session_pool_;
   scoped_ptr<HttpStreamFactory> http_stream_factory_;
   scoped_ptr<HttpStreamFactory> http_stream_factory_for_websocket_;
+  scoped_ptr<HttpPreconnectPredictor> preconnect_predictor_;
   std::set<HttpResponseBodyDrainer*> response_drainers_;
 
   // TODO(jgraettinger): Remove when Huffman collection is complete.
@@ -37,6 +37,7 @@
 #include "net/http/http_basic_stream.h"
 #include "net/http/http_chunked_decoder.h"
 #include "net/http/http_network_session.h"
+#include "net/http/http_preconnect_predictor.h"
 #include "net/http/http_proxy_client_socket.h"
 #include "net/http/http_proxy_client_socket_pool.h"
 #include "net/http/http_request_headers.h"
@@ -766,6 +767,11 @@ int HttpNetworkTransaction::DoInitStream() {
 int HttpNetworkTransaction::DoInitStreamComplete(int result) {
   if (result == OK) {
     next_state_ = STATE_GENERATE_PROXY_AUTH_TOKEN;
+    if (session_->preconnect_predictor() && !ForWebSocketHandshake()) {
+      session_->preconnect_predictor()->OnStreamInitialized(
+          *request_, server_ssl_config_, proxy_ssl_config_,
+          stream_->IsConnectionReused());
+    }
   } else {
     if (result < 0)
       result = HandleIOError(result);
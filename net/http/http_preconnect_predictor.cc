@@ -0,0 +1,172 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_preconnect_predictor.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/message_loop/message_loop.h"
+#include "base/metrics/histogram.h"
+#include "base/time/default_tick_clock.h"
+#include "net/base/request_priority.h"
+#include "net/http/http_network_session.h"
+#include "net/http/http_request_info.h"
+#include "net/http/http_server_properties.h"
+#include "net/http/http_stream_factory.h"
+#include "net/socket/client_socket_pool.h"
+#include "net/ssl/ssl_config.h"
+
+namespace net {
+
+namespace {
+
+// Number of origins whose warm streams are tracked.
+const int kMaxOriginStates = 1000;
+
+}  // namespace
+
+HttpPreconnectPredictor::Params::Params()
+    : min_request_rate(1),
+      warm_seconds(1),
+      max_streams_per_origin(6),
+      budget(64),
+      budget_interval(base::TimeDelta::FromSeconds(10)) {}
+
+HttpPreconnectPredictor::HttpPreconnectPredictor(HttpNetworkSession* session,
+                                                 const Params& params)
+    : session_(session),
+      params_(params),
+      tick_clock_(new base::DefaultTickClock()),
+      origin_states_(kMaxOriginStates),
+      budget_used_(0),
+      weak_factory_(this) {
+  DCHECK_GE(params_.max_streams_per_origin, 1);
+}
+
+HttpPreconnectPredictor::~HttpPreconnectPredictor() {}
+
+void HttpPreconnectPredictor::OnStreamInitialized(
+    const HttpRequestInfo& request_info,
+    const SSLConfig& server_ssl_config,
+    const SSLConfig& proxy_ssl_config,
+    bool connection_reused) {
+  base::WeakPtr<HttpServerProperties> http_server_properties =
+      session_->http_server_properties();
+  if (!http_server_properties)
+    return;
+
+  const HostPortPair origin = HostPortPair::FromURL(request_info.url);
+  base::TimeTicks now = tick_clock_->NowTicks();
+  http_server_properties->RecordServerConnectionUsage(origin,
+                                                      connection_reused, now);
+  RecordWarmStreamUse(origin, connection_reused, now);
+
+  // Only cold connections are worth preventing.  SPDY servers multiplex
+  // requests over a single connection, so they don't need warm streams.
+  if (connection_reused || http_server_properties->SupportsSpdy(origin))
+    return;
+
+  const ServerConnectionUsage* usage =
+      http_server_properties->GetServerConnectionUsage(origin);
+  DCHECK(usage);
+  int target_streams = GetTargetStreams(*usage);
+  if (target_streams <= 1)
+    return;
+
+  // The stream this request got counts towards |target_streams|.
+  int wanted_streams = target_streams - 1;
+  int warm_streams = TakeFromBudget(wanted_streams, now);
+  UMA_HISTOGRAM_BOOLEAN("Net.PreconnectPredictor.BudgetExhausted",
+                        warm_streams < wanted_streams);
+  if (warm_streams == 0)
+    return;
+  UMA_HISTOGRAM_COUNTS_100("Net.PreconnectPredictor.WarmStreams",
+                           warm_streams);
+
+  OriginStateMap::iterator it = origin_states_.Get(origin);
+  if (it == origin_states_.end())
+    it = origin_states_.Put(origin, OriginState());
+  it->second.preconnect_time = now;
+  it->second.warm_streams = warm_streams;
+
+  HttpRequestInfo preconnect_info;
+  preconnect_info.url = request_info.url.GetOrigin();
+  preconnect_info.method = "GET";
+  preconnect_info.privacy_mode = request_info.privacy_mode;
+
+  // Don't start new connect jobs from within the stream request's callbacks.
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE,
+      base::Bind(&HttpPreconnectPredictor::Preconnect,
+                 weak_factory_.GetWeakPtr(),
+                 1 + warm_streams,
+                 preconnect_info,
+                 server_ssl_config,
+                 proxy_ssl_config));
+}
+
+int HttpPreconnectPredictor::GetTargetStreams(
+    const ServerConnectionUsage& usage) const {
+  if (usage.request_rate < params_.min_request_rate)
+    return 0;
+  double streams = 1 + std::ceil(usage.request_rate * params_.warm_seconds);
+  return static_cast<int>(
+      std::min(streams, static_cast<double>(params_.max_streams_per_origin)));
+}
+
+int HttpPreconnectPredictor::TakeFromBudget(int num_streams,
+                                            base::TimeTicks now) {
+  if (budget_interval_start_.is_null() ||
+      now - budget_interval_start_ >= params_.budget_interval) {
+    budget_interval_start_ = now;
+    budget_used_ = 0;
+  }
+  int granted = std::max(0, std::min(num_streams,
+                                     params_.budget - budget_used_));
+  budget_used_ += granted;
+  return granted;
+}
+
+void HttpPreconnectPredictor::SetTickClockForTesting(
+    scoped_ptr<base::TickClock> tick_clock) {
+  tick_clock_ = tick_clock.Pass();
+}
+
+void HttpPreconnectPredictor::RecordWarmStreamUse(const HostPortPair& origin,
+                                                  bool connection_reused,
+                                                  base::TimeTicks now) {
+  OriginStateMap::iterator it = origin_states_.Peek(origin);
+  if (it == origin_states_.end() || it->second.warm_streams == 0)
+    return;
+
+  OriginState& state = it->second;
+  if (now - state.preconnect_time >=
+      ClientSocketPool::unused_idle_socket_timeout()) {
+    // The socket pools have closed the warm streams nobody used by now.
+    UMA_HISTOGRAM_COUNTS_100("Net.PreconnectPredictor.WastedStreams",
+                             state.warm_streams);
+    state.warm_streams = 0;
+    return;
+  }
+
+  // A reused connection may also be one left over from an earlier request,
+  // so this overestimates the hit rate when the origin is also kept alive.
+  UMA_HISTOGRAM_BOOLEAN("Net.PreconnectPredictor.WarmStreamHit",
+                        connection_reused);
+  if (connection_reused)
+    state.warm_streams--;
+}
+
+void HttpPreconnectPredictor::Preconnect(int num_streams,
+                                         const HttpRequestInfo& request_info,
+                                         const SSLConfig& server_ssl_config,
+                                         const SSLConfig& proxy_ssl_config) {
+  session_->http_stream_factory()->PreconnectStreams(
+      num_streams, request_info, IDLE, server_ssl_config, proxy_ssl_config);
+}
+
+}  // namespace net
@@ -0,0 +1,114 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_HTTP_HTTP_PRECONNECT_PREDICTOR_H_
+#define NET_HTTP_HTTP_PRECONNECT_PREDICTOR_H_
+
+#include "base/basictypes.h"
+#include "base/containers/mru_cache.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
+#include "net/base/host_port_pair.h"
+#include "net/base/net_export.h"
+
+namespace base {
+class TickClock;
+}
+
+namespace net {
+
+class HttpNetworkSession;
+struct HttpRequestInfo;
+struct ServerConnectionUsage;
+struct SSLConfig;
+
+// Learns which origins are hot from the streams HttpNetworkTransactions get,
+// and keeps warm connections open to them.
+//
+// Every stream is recorded in the session's HttpServerProperties, which keeps
+// each origin's request rate and how often its requests reused a connection.
+// When a request to a hot origin had to wait for a new connection, the
+// predictor asks the HttpStreamFactory to preconnect enough streams to cover
+// the origin's request rate.  Preconnects go through the socket pools'
+// RequestSockets(), so for https origins the sockets come out of the
+// SSLClientSocketPool with the TLS handshake done.  The number of streams
+// preconnected is limited by a budget shared by all origins.
+class NET_EXPORT_PRIVATE HttpPreconnectPredictor {
+ public:
+  struct NET_EXPORT_PRIVATE Params {
+    Params();
+
+    // Origins getting fewer requests per second are never preconnected to.
+    double min_request_rate;
+    // Hot origins are given enough warm streams for this many seconds of
+    // requests.
+    double warm_seconds;
+    // Maximum number of streams, in use or warm, to keep per origin.
+    int max_streams_per_origin;
+    // Maximum number of warm streams to preconnect, over all origins, per
+    // |budget_interval|.
+    int budget;
+    base::TimeDelta budget_interval;
+  };
+
+  HttpPreconnectPredictor(HttpNetworkSession* session, const Params& params);
+  ~HttpPreconnectPredictor();
+
+  // Called when the stream for |request_info| has been initialized.
+  // |connection_reused| is true if the stream didn't have to wait for a new
+  // connection.
+  void OnStreamInitialized(const HttpRequestInfo& request_info,
+                           const SSLConfig& server_ssl_config,
+                           const SSLConfig& proxy_ssl_config,
+                           bool connection_reused);
+
+  // Returns the number of streams, in use or warm, an origin with |usage|
+  // should have.  Returns 0 if the origin isn't hot.
+  int GetTargetStreams(const ServerConnectionUsage& usage) const;
+
+  // Takes up to |num_streams| streams out of the budget at time |now|, and
+  // returns how many were granted.
+  int TakeFromBudget(int num_streams, base::TimeTicks now);
+
+  void SetTickClockForTesting(scoped_ptr<base::TickClock> tick_clock);
+
+ private:
+  // The warm streams last preconnected for an origin.
+  struct OriginState {
+    OriginState() : warm_streams(0) {}
+
+    base::TimeTicks preconnect_time;
+    // Warm streams that no request has been seen to use yet.
+    int warm_streams;
+  };
+  typedef base::MRUCache<HostPortPair, OriginState> OriginStateMap;
+
+  // Records whether a request to an origin with warm streams got one.
+  void RecordWarmStreamUse(const HostPortPair& origin,
+                           bool connection_reused,
+                           base::TimeTicks now);
+
+  void Preconnect(int num_streams,
+                  const HttpRequestInfo& request_info,
+                  const SSLConfig& server_ssl_config,
+                  const SSLConfig& proxy_ssl_config);
+
+  HttpNetworkSession* const session_;
+  const Params params_;
+  scoped_ptr<base::TickClock> tick_clock_;
+
+  OriginStateMap origin_states_;
+
+  base::TimeTicks budget_interval_start_;
+  int budget_used_;
+
+  base::WeakPtrFactory<HttpPreconnectPredictor> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpPreconnectPredictor);
+};
+
+}  // namespace net
+
+#endif  // NET_HTTP_HTTP_PRECONNECT_PREDICTOR_H_
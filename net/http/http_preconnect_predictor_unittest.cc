@@ -0,0 +1,209 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_preconnect_predictor.h"
+
+#include "base/memory/ref_counted.h"
+#include "base/run_loop.h"
+#include "base/test/histogram_tester.h"
+#include "base/test/simple_test_tick_clock.h"
+#include "net/http/http_network_session.h"
+#include "net/http/http_request_info.h"
+#include "net/http/http_server_properties.h"
+#include "net/socket/client_socket_pool.h"
+#include "net/socket/socket_test_util.h"
+#include "net/socket/transport_client_socket_pool.h"
+#include "net/spdy/spdy_test_util_common.h"
+#include "net/ssl/ssl_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+TEST(HttpPreconnectPredictorTest, GetTargetStreams) {
+  HttpPreconnectPredictor::Params params;
+  params.min_request_rate = 1;
+  params.warm_seconds = 0.5;
+  params.max_streams_per_origin = 6;
+  HttpPreconnectPredictor predictor(NULL, params);
+
+  ServerConnectionUsage usage;
+  usage.request_rate = 0.9;
+  EXPECT_EQ(0, predictor.GetTargetStreams(usage));
+
+  // One stream in use, plus half a second of requests.
+  usage.request_rate = 1;
+  EXPECT_EQ(2, predictor.GetTargetStreams(usage));
+  usage.request_rate = 4.5;
+  EXPECT_EQ(4, predictor.GetTargetStreams(usage));
+
+  usage.request_rate = 100;
+  EXPECT_EQ(6, predictor.GetTargetStreams(usage));
+}
+
+TEST(HttpPreconnectPredictorTest, TakeFromBudget) {
+  HttpPreconnectPredictor::Params params;
+  params.budget = 10;
+  params.budget_interval = base::TimeDelta::FromSeconds(10);
+  HttpPreconnectPredictor predictor(NULL, params);
+
+  base::TimeTicks now = base::TimeTicks::Now();
+  EXPECT_EQ(4, predictor.TakeFromBudget(4, now));
+  EXPECT_EQ(4, predictor.TakeFromBudget(4, now));
+  EXPECT_EQ(2, predictor.TakeFromBudget(4, now));
+  EXPECT_EQ(0, predictor.TakeFromBudget(4, now));
+
+  // The budget is refilled once the interval is over.
+  now += base::TimeDelta::FromSeconds(9);
+  EXPECT_EQ(0, predictor.TakeFromBudget(1, now));
+  now += base::TimeDelta::FromSeconds(1);
+  EXPECT_EQ(10, predictor.TakeFromBudget(20, now));
+}
+
+const char kUrl[] = "http://www.example.org/";
+const char kGroupName[] = "www.example.org:80";
+
+// Reports streams to the predictor of an HttpNetworkSession, whose sockets
+// come from a MockClientSocketFactory.
+class HttpPreconnectPredictorSessionTest : public testing::Test {
+ protected:
+  HttpPreconnectPredictorSessionTest()
+      : session_deps_(kProtoSPDY31), clock_(new base::SimpleTestTickClock()) {
+    HttpNetworkSession::Params params =
+        SpdySessionDependencies::CreateSessionParams(&session_deps_);
+    params.enable_preconnect_predictor = true;
+    session_ = new HttpNetworkSession(params);
+    predictor()->SetTickClockForTesting(make_scoped_ptr(clock_));
+    clock_->Advance(base::TimeDelta::FromSeconds(1));
+
+    request_info_.method = "GET";
+    request_info_.url = GURL(kUrl);
+
+    // One for each stream the predictor may preconnect.
+    for (size_t i = 0; i < arraysize(data_); ++i)
+      session_deps_.socket_factory->AddSocketDataProvider(&data_[i]);
+  }
+
+  HttpPreconnectPredictor* predictor() {
+    return session_->preconnect_predictor();
+  }
+
+  // Reports |num_requests| streams to |kUrl|, at the current time, and waits
+  // for any preconnect.
+  void OnStreamsInitialized(int num_requests, bool connection_reused) {
+    for (int i = 0; i < num_requests; ++i) {
+      predictor()->OnStreamInitialized(request_info_, ssl_config_,
+                                       ssl_config_, connection_reused);
+    }
+    base::RunLoop().RunUntilIdle();
+  }
+
+  // Makes |kUrl| hot enough for three streams.
+  void MakeOriginHot() {
+    OnStreamsInitialized(40, true);
+    const ServerConnectionUsage* usage =
+        session_->http_server_properties()->GetServerConnectionUsage(
+            HostPortPair::FromURL(request_info_.url));
+    ASSERT_TRUE(usage);
+    ASSERT_EQ(3, predictor()->GetTargetStreams(*usage));
+  }
+
+  int IdleSocketCount() {
+    return session_->GetTransportSocketPool(
+        HttpNetworkSession::NORMAL_SOCKET_POOL)->IdleSocketCountInGroup(
+            kGroupName);
+  }
+
+  SpdySessionDependencies session_deps_;
+  StaticSocketDataProvider data_[6];
+  scoped_refptr<HttpNetworkSession> session_;
+  // Owned by the predictor.
+  base::SimpleTestTickClock* clock_;
+  HttpRequestInfo request_info_;
+  SSLConfig ssl_config_;
+};
+
+// A request to a hot origin that had to wait for a new connection has the
+// predictor preconnect the streams the origin is missing.
+TEST_F(HttpPreconnectPredictorSessionTest, PreconnectsToHotOrigin) {
+  base::HistogramTester histograms;
+  MakeOriginHot();
+
+  // Requests that reused a connection don't need more streams.
+  EXPECT_EQ(0, IdleSocketCount());
+  histograms.ExpectTotalCount("Net.PreconnectPredictor.WarmStreams", 0);
+
+  OnStreamsInitialized(1, false);
+  EXPECT_EQ(3, IdleSocketCount());
+  histograms.ExpectUniqueSample("Net.PreconnectPredictor.WarmStreams", 2, 1);
+  histograms.ExpectUniqueSample("Net.PreconnectPredictor.BudgetExhausted",
+                                false, 1);
+}
+
+// A cold origin isn't preconnected to.
+TEST_F(HttpPreconnectPredictorSessionTest, NoPreconnectToColdOrigin) {
+  base::HistogramTester histograms;
+  OnStreamsInitialized(1, false);
+  OnStreamsInitialized(1, false);
+  EXPECT_EQ(0, IdleSocketCount());
+  histograms.ExpectTotalCount("Net.PreconnectPredictor.BudgetExhausted", 0);
+}
+
+// Only the streams left in the budget are preconnected.
+TEST_F(HttpPreconnectPredictorSessionTest, BudgetExhausted) {
+  base::HistogramTester histograms;
+  MakeOriginHot();
+
+  HttpPreconnectPredictor::Params params;
+  EXPECT_EQ(params.budget - 1,
+            predictor()->TakeFromBudget(params.budget - 1,
+                                        clock_->NowTicks()));
+  OnStreamsInitialized(1, false);
+  EXPECT_EQ(2, IdleSocketCount());
+  histograms.ExpectUniqueSample("Net.PreconnectPredictor.WarmStreams", 1, 1);
+  histograms.ExpectUniqueSample("Net.PreconnectPredictor.BudgetExhausted",
+                                true, 1);
+
+  // Nothing is left for the next cold request.
+  OnStreamsInitialized(1, false);
+  EXPECT_EQ(2, IdleSocketCount());
+  histograms.ExpectTotalCount("Net.PreconnectPredictor.WarmStreams", 1);
+  histograms.ExpectBucketCount("Net.PreconnectPredictor.BudgetExhausted",
+                               true, 2);
+
+  // Until the next interval.
+  clock_->Advance(params.budget_interval);
+  OnStreamsInitialized(1, false);
+  histograms.ExpectBucketCount("Net.PreconnectPredictor.WarmStreams", 2, 1);
+  histograms.ExpectBucketCount("Net.PreconnectPredictor.BudgetExhausted",
+                               false, 1);
+}
+
+// The requests that follow a preconnect tell whether the warm streams were
+// used, until the socket pools close them.
+TEST_F(HttpPreconnectPredictorSessionTest, WarmStreamUse) {
+  base::HistogramTester histograms;
+  MakeOriginHot();
+  OnStreamsInitialized(1, false);
+  histograms.ExpectTotalCount("Net.PreconnectPredictor.WarmStreamHit", 0);
+
+  OnStreamsInitialized(1, true);
+  histograms.ExpectUniqueSample("Net.PreconnectPredictor.WarmStreamHit",
+                                true, 1);
+
+  // The other warm stream is never used.
+  clock_->Advance(ClientSocketPool::unused_idle_socket_timeout());
+  OnStreamsInitialized(1, true);
+  histograms.ExpectUniqueSample("Net.PreconnectPredictor.WastedStreams", 1, 1);
+  histograms.ExpectTotalCount("Net.PreconnectPredictor.WarmStreamHit", 1);
+
+  // And is only reported once.
+  OnStreamsInitialized(1, true);
+  histograms.ExpectTotalCount("Net.PreconnectPredictor.WastedStreams", 1);
+}
+
+}  // namespace
+
+}  // namespace net
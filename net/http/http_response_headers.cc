@@ -12,9 +12,11 @@
 #include <algorithm>
 
 #include "base/format_macros.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/metrics/histogram.h"
 #include "base/pickle.h"
+#include "base/stl_util.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_piece.h"
 #include "base/strings/string_util.h"
@@ -109,6 +111,98 @@ bool ShouldUpdateHeader(const std::string::const_iterator& name_begin,
   return true;
 }
 
+// These headers get an entry in HttpResponseHeaders::known_headers_, so they
+// can be found without scanning all the headers. Most of them are looked up
+// for every response by the network stack or the cache.
+struct KnownHeader {
+  const char* name;
+  size_t length;
+};
+
+#define KNOWN_HEADER(name) { name, sizeof(name) - 1 }
+
+const KnownHeader kKnownHeaders[] = {
+  KNOWN_HEADER("accept-ranges"),
+  KNOWN_HEADER("age"),
+  KNOWN_HEADER("cache-control"),
+  KNOWN_HEADER("connection"),
+  KNOWN_HEADER("content-disposition"),
+  KNOWN_HEADER("content-encoding"),
+  KNOWN_HEADER("content-length"),
+  KNOWN_HEADER("content-location"),
+  KNOWN_HEADER("content-range"),
+  KNOWN_HEADER("content-type"),
+  KNOWN_HEADER("date"),
+  KNOWN_HEADER("etag"),
+  KNOWN_HEADER("expires"),
+  KNOWN_HEADER("keep-alive"),
+  KNOWN_HEADER("last-modified"),
+  KNOWN_HEADER("location"),
+  KNOWN_HEADER("pragma"),
+  KNOWN_HEADER("proxy-authenticate"),
+  KNOWN_HEADER("proxy-connection"),
+  KNOWN_HEADER("set-cookie"),
+  KNOWN_HEADER("transfer-encoding"),
+  KNOWN_HEADER("vary"),
+  KNOWN_HEADER("www-authenticate"),
+  KNOWN_HEADER("x-content-type-options"),
+};
+
+#undef KNOWN_HEADER
+
+const int kUnknownHeader = -1;
+
+// The number of slots of KnownHeaderTable. Must be a power of two larger than
+// the number of known headers.
+const size_t kKnownHeaderSlots = 64;
+
+size_t HashKnownHeaderName(const StringPiece& name) {
+  // Names are hashed by length, first and last letter, which is enough to
+  // tell most of the known headers apart.
+  return (name.size() * 31 + base::ToLowerASCII(name[0]) * 7 +
+          base::ToLowerASCII(name[name.size() - 1])) & (kKnownHeaderSlots - 1);
+}
+
+// An open addressing hash table of the positions in kKnownHeaders.
+struct KnownHeaderTable {
+  KnownHeaderTable() {
+    COMPILE_ASSERT(arraysize(kKnownHeaders) < kKnownHeaderSlots,
+                   known_header_table_too_small);
+    std::fill(slots, slots + kKnownHeaderSlots, kUnknownHeader);
+    for (size_t i = 0; i < arraysize(kKnownHeaders); ++i) {
+      size_t slot = HashKnownHeaderName(kKnownHeaders[i].name);
+      while (slots[slot] != kUnknownHeader)
+        slot = (slot + 1) & (kKnownHeaderSlots - 1);
+      slots[slot] = static_cast<int>(i);
+    }
+  }
+
+  int slots[kKnownHeaderSlots];
+};
+
+base::LazyInstance<KnownHeaderTable>::Leaky g_known_header_table =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Returns the position of |name| in kKnownHeaders, or kUnknownHeader.
+int GetKnownHeaderId(const StringPiece& name) {
+  if (name.empty())
+    return kUnknownHeader;
+  const int* slots = g_known_header_table.Get().slots;
+  for (size_t slot = HashKnownHeaderName(name); slots[slot] != kUnknownHeader;
+       slot = (slot + 1) & (kKnownHeaderSlots - 1)) {
+    const KnownHeader& header = kKnownHeaders[slots[slot]];
+    if (name.size() == header.length &&
+        LowerCaseEqualsASCII(name.begin(), name.end(), header.name)) {
+      return slots[slot];
+    }
+  }
+  return kUnknownHeader;
+}
+
+// The number of offsets that describe a header line in the index written by
+// HttpResponseHeaders::PersistIndex().
+const size_t kIndexEntrySize = 4;
+
 void CheckDoesNotHaveEmbededNulls(const std::string& str) {
   // Care needs to be taken when adding values to the raw headers string to
   // make sure it does not contain embeded NULLs. Any embeded '\0' may be
@@ -129,6 +223,10 @@ struct HttpResponseHeaders::ParsedHeader {
   std::string::const_iterator name_end;
   std::string::const_iterator value_begin;
   std::string::const_iterator value_end;
+
+  // The position of the name in kKnownHeaders, or kUnknownHeader. Always
+  // kUnknownHeader for continuations.
+  int name_id;
 };
 
 //-----------------------------------------------------------------------------
@@ -159,17 +257,75 @@ HttpResponseHeaders::HttpResponseHeaders(const std::string& raw_input)
 HttpResponseHeaders::HttpResponseHeaders(const Pickle& pickle,
                                          PickleIterator* iter)
     : response_code_(-1) {
+  ResetKnownHeaders();
   std::string raw_input;
   if (pickle.ReadString(iter, &raw_input))
     Parse(raw_input);
 }
 
+HttpResponseHeaders::HttpResponseHeaders(const Pickle& pickle,
+                                         PickleIterator* iter,
+                                         PickleIterator* index_iter)
+    : response_code_(-1) {
+  ResetKnownHeaders();
+  std::string raw_input;
+  if (!pickle.ReadString(iter, &raw_input))
+    return;
+
+  // A missing or bad index is not fatal: the headers are still there.
+  int response_code;
+  const char* index;
+  int index_len;
+  if (!pickle.ReadInt(index_iter, &response_code) ||
+      !pickle.ReadData(index_iter, &index, &index_len) ||
+      !InitFromIndex(&raw_input, response_code, index, index_len)) {
+    Parse(raw_input);
+  }
+}
+
 void HttpResponseHeaders::Persist(Pickle* pickle, PersistOptions options) {
   if (options == PERSIST_RAW) {
     pickle->WriteString(raw_headers_);
     return;  // Done.
   }
 
+  std::string blob;
+  GetPersistedHeaders(options, &blob, NULL);
+  pickle->WriteString(blob);
+}
+
+void HttpResponseHeaders::PersistWithIndex(Pickle* pickle,
+                                           PersistOptions options,
+                                           std::vector<uint32>* index) {
+  index->clear();
+  std::string blob;
+  GetPersistedHeaders(options, &blob, index);
+  pickle->WriteString(blob);
+}
+
+void HttpResponseHeaders::PersistIndex(Pickle* pickle,
+                                       const std::vector<uint32>& index) const {
+  pickle->WriteInt(response_code_);
+  pickle->WriteData(reinterpret_cast<const char*>(vector_as_array(&index)),
+                    static_cast<int>(index.size() * sizeof(index[0])));
+}
+
+void HttpResponseHeaders::GetPersistedHeaders(
+    PersistOptions options,
+    std::string* blob,
+    std::vector<uint32>* index) const {
+  if (index)
+    index->reserve(parsed_.size() * kIndexEntrySize);
+
+  if (options == PERSIST_RAW) {
+    blob->assign(raw_headers_);
+    if (index) {
+      for (size_t i = 0; i < parsed_.size(); ++i)
+        AppendToIndex(parsed_[i], 0, index);
+    }
+    return;
+  }
+
   HeaderSet filter_headers;
 
   // Construct set of headers to filter out based on options.
@@ -191,13 +347,12 @@ void HttpResponseHeaders::Persist(Pickle* pickle, PersistOptions options) {
   if ((options & PERSIST_SANS_SECURITY_STATE) == PERSIST_SANS_SECURITY_STATE)
     AddSecurityStateHeaders(&filter_headers);
 
-  std::string blob;
-  blob.reserve(raw_headers_.size());
+  blob->reserve(raw_headers_.size());
 
   // This copies the status line w/ terminator null.
   // Note raw_headers_ has embedded nulls instead of \n,
   // so this just copies the first header line.
-  blob.assign(raw_headers_.c_str(), strlen(raw_headers_.c_str()) + 1);
+  blob->assign(raw_headers_.c_str(), strlen(raw_headers_.c_str()) + 1);
 
   for (size_t i = 0; i < parsed_.size(); ++i) {
     DCHECK(!parsed_[i].is_continuation());
@@ -211,16 +366,37 @@ void HttpResponseHeaders::Persist(Pickle* pickle, PersistOptions options) {
     base::StringToLowerASCII(&header_name);
 
     if (filter_headers.find(header_name) == filter_headers.end()) {
+      if (index) {
+        // The lines of this header move to the end of |blob|.
+        size_t removed =
+            (parsed_[i].name_begin - raw_headers_.begin()) - blob->size();
+        for (size_t j = i; j <= k; ++j)
+          AppendToIndex(parsed_[j], removed, index);
+      }
+
       // Make sure there is a null after the value.
-      blob.append(parsed_[i].name_begin, parsed_[k].value_end);
-      blob.push_back('\0');
+      blob->append(parsed_[i].name_begin, parsed_[k].value_end);
+      blob->push_back('\0');
     }
 
     i = k;
   }
-  blob.push_back('\0');
+  blob->push_back('\0');
+}
 
-  pickle->WriteString(blob);
+void HttpResponseHeaders::AppendToIndex(const ParsedHeader& header,
+                                        size_t removed,
+                                        std::vector<uint32>* index) const {
+  // Continuations are stored with an empty name at offset 0.
+  if (header.is_continuation()) {
+    index->push_back(0);
+    index->push_back(0);
+  } else {
+    index->push_back(header.name_begin - raw_headers_.begin() - removed);
+    index->push_back(header.name_end - raw_headers_.begin() - removed);
+  }
+  index->push_back(header.value_begin - raw_headers_.begin() - removed);
+  index->push_back(header.value_end - raw_headers_.begin() - removed);
 }
 
 void HttpResponseHeaders::Update(const HttpResponseHeaders& new_headers) {
@@ -396,6 +572,7 @@ void HttpResponseHeaders::UpdateWithNewRange(
 }
 
 void HttpResponseHeaders::Parse(const std::string& raw_input) {
+  ResetKnownHeaders();
   raw_headers_.reserve(raw_input.size());
 
   // ParseStatusLine adds a normalized status line to raw_headers_
@@ -448,6 +625,71 @@ void HttpResponseHeaders::Parse(const std::string& raw_input) {
   DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 1]);
 }
 
+bool HttpResponseHeaders::InitFromIndex(std::string* raw_input,
+                                        int response_code,
+                                        const char* index,
+                                        int index_len) {
+  const size_t kEntryLen = kIndexEntrySize * sizeof(uint32);
+  if (response_code < 0 || index_len < 0 || index_len % kEntryLen)
+    return false;
+
+  // The headers must look like the output of Parse(): a status line and the
+  // header lines, each one followed by a null, and an empty line at the end.
+  const std::string& raw = *raw_input;
+  if (raw.size() < 2 || raw[raw.size() - 2] != '\0' ||
+      raw[raw.size() - 1] != '\0') {
+    return false;
+  }
+  size_t status_line_len = raw.find('\0');
+
+  // The lines must follow the status line and each other without overlapping,
+  // and end before the empty line, as the headers are later copied from the
+  // start of a header to the end of its last continuation.
+  const uint32* offsets = reinterpret_cast<const uint32*>(index);
+  size_t num_lines = index_len / kEntryLen;
+  size_t previous_end = status_line_len;
+  for (size_t i = 0; i < num_lines; ++i) {
+    const uint32* line = offsets + i * kIndexEntrySize;
+    if (line[0] == 0 && line[1] == 0) {
+      // A continuation of the previous header.
+      if (i == 0 || line[2] < previous_end)
+        return false;
+    } else if (line[0] <= previous_end || line[0] >= line[1] ||
+               line[1] > line[2]) {
+      return false;
+    }
+    if (line[2] > line[3] || line[3] > raw.size() - 2)
+      return false;
+    previous_end = line[3];
+  }
+
+  HttpVersion version =
+      ParseVersion(raw.begin(), raw.begin() + status_line_len);
+  if (version != HttpVersion(0, 9) && version != HttpVersion(1, 0) &&
+      version != HttpVersion(1, 1)) {
+    return false;
+  }
+
+  raw_headers_.swap(*raw_input);
+  response_code_ = response_code;
+  http_version_ = version;
+  parsed_http_version_ = version;
+
+  parsed_.reserve(num_lines);
+  std::string::const_iterator begin = raw_headers_.begin();
+  for (size_t i = 0; i < num_lines; ++i) {
+    const uint32* line = offsets + i * kIndexEntrySize;
+    if (line[0] == line[1]) {
+      AddToParsed(raw_headers_.end(), raw_headers_.end(), begin + line[2],
+                  begin + line[3]);
+    } else {
+      AddToParsed(begin + line[0], begin + line[1], begin + line[2],
+                  begin + line[3]);
+    }
+  }
+  return true;
+}
+
 // Append all of our headers to the final output string.
 void HttpResponseHeaders::GetNormalizedHeaders(std::string* output) const {
   // copy up to the null byte.  this just copies the status line.
@@ -615,6 +857,7 @@ bool HttpResponseHeaders::HasHeader(const base::StringPiece& name) const {
 }
 
 HttpResponseHeaders::HttpResponseHeaders() : response_code_(-1) {
+  ResetKnownHeaders();
 }
 
 HttpResponseHeaders::~HttpResponseHeaders() {
@@ -739,8 +982,21 @@ void HttpResponseHeaders::ParseStatusLine(
 
 size_t HttpResponseHeaders::FindHeader(size_t from,
                                        const base::StringPiece& search) const {
+  int id = GetKnownHeaderId(search);
+  if (id != kUnknownHeader) {
+    if (known_headers_[id] == kuint32max)
+      return std::string::npos;
+    for (size_t i = std::max<size_t>(from, known_headers_[id]);
+         i < parsed_.size(); ++i) {
+      if (parsed_[i].name_id == id)
+        return i;
+    }
+    return std::string::npos;
+  }
+
   for (size_t i = from; i < parsed_.size(); ++i) {
-    if (parsed_[i].is_continuation())
+    // Lines of known headers can't match |search|.
+    if (parsed_[i].is_continuation() || parsed_[i].name_id != kUnknownHeader)
       continue;
     const std::string::const_iterator& name_begin = parsed_[i].name_begin;
     const std::string::const_iterator& name_end = parsed_[i].name_end;
@@ -806,9 +1062,24 @@ void HttpResponseHeaders::AddToParsed(std::string::const_iterator name_begin,
   header.name_end = name_end;
   header.value_begin = value_begin;
   header.value_end = value_end;
+  header.name_id = kUnknownHeader;
+  if (!header.is_continuation()) {
+    header.name_id = GetKnownHeaderId(StringPiece(name_begin, name_end));
+    if (header.name_id != kUnknownHeader &&
+        known_headers_[header.name_id] == kuint32max) {
+      known_headers_[header.name_id] = static_cast<uint32>(parsed_.size());
+    }
+  }
   parsed_.push_back(header);
 }
 
+void HttpResponseHeaders::ResetKnownHeaders() {
+  COMPILE_ASSERT(arraysize(kKnownHeaders) ==
+                     static_cast<size_t>(kNumKnownHeaders),
+                 known_headers_mismatch);
+  std::fill(known_headers_, known_headers_ + kNumKnownHeaders, kuint32max);
+}
+
 void HttpResponseHeaders::AddNonCacheableHeaders(HeaderSet* result) const {
   // Add server specified transients.  Any 'cache-control: no-cache="foo,bar"'
   // headers present in the response specify additional headers that we should
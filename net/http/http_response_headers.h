@@ -74,10 +74,28 @@ class NET_EXPORT HttpResponseHeaders
   // be passed to the pickle's various Read* methods.
   HttpResponseHeaders(const Pickle& pickle, PickleIterator* pickle_iter);
 
+  // Like the above, but the location of each header is read at |index_iter|,
+  // as written by PersistIndex(), so the headers don't have to be parsed
+  // again.
+  HttpResponseHeaders(const Pickle& pickle,
+                      PickleIterator* pickle_iter,
+                      PickleIterator* index_iter);
+
   // Appends a representation of this object to the given pickle.
   // The options argument can be a combination of PersistOptions.
   void Persist(Pickle* pickle, PersistOptions options);
 
+  // Same as Persist(), and stores the location of each header within the
+  // persisted data in |index|, for PersistIndex().
+  void PersistWithIndex(Pickle* pickle,
+                        PersistOptions options,
+                        std::vector<uint32>* index);
+
+  // Appends |index|, from PersistWithIndex(), to the given pickle. It doesn't
+  // have to follow the headers, so that readers that don't know about the
+  // index can still find what follows them.
+  void PersistIndex(Pickle* pickle, const std::vector<uint32>& index) const;
+
   // Performs header merging as described in 13.5.3 of RFC 2616.
   void Update(const HttpResponseHeaders& new_headers);
 
@@ -314,12 +332,39 @@ class NET_EXPORT HttpResponseHeaders
   struct ParsedHeader;
   typedef std::vector<ParsedHeader> HeaderList;
 
+  // The number of header names that are looked up through known_headers_.
+  static const int kNumKnownHeaders = 24;
+
   HttpResponseHeaders();
   ~HttpResponseHeaders();
 
   // Initializes from the given raw headers.
   void Parse(const std::string& raw_input);
 
+  // Initializes this object from |raw_input|, as persisted by
+  // PersistWithIndex(), and the location of each header line in |index|.
+  // Returns false if |index| doesn't match |raw_input|.
+  bool InitFromIndex(std::string* raw_input,
+                     int response_code,
+                     const char* index,
+                     int index_len);
+
+  // Builds the persisted form of the headers in |blob|, without the headers
+  // filtered out by |options|. If |index| is not NULL, it receives the
+  // location of each header line within |blob|.
+  void GetPersistedHeaders(PersistOptions options,
+                           std::string* blob,
+                           std::vector<uint32>* index) const;
+
+  // Appends the location of |header| to |index|, for headers persisted
+  // without the |removed| bytes that precede it in raw_headers_.
+  void AppendToIndex(const ParsedHeader& header,
+                     size_t removed,
+                     std::vector<uint32>* index) const;
+
+  // Marks all the known headers as not present.
+  void ResetKnownHeaders();
+
   // Helper function for ParseStatusLine.
   // Tries to extract the "HTTP/X.Y" from a status line formatted like:
   //    HTTP/1.1 200 OK
@@ -393,6 +438,11 @@ class NET_EXPORT HttpResponseHeaders
   // header-value pairs within raw_headers_.
   HeaderList parsed_;
 
+  // For each known header name, the index of its first line in parsed_, or
+  // kuint32max if the header is not present. This saves scanning parsed_
+  // for the headers that are looked up all the time.
+  uint32 known_headers_[kNumKnownHeaders];
+
   // The raw_headers_ consists of the normalized status line (terminated with a
   // null byte) and then followed by the raw null-terminated headers from the
   // input that was passed to our constructor.  We preserve the input [*] to
@@ -0,0 +1,236 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_vector.h"
+#include "base/pickle.h"
+#include "base/test/perf_time_logger.h"
+#include "base/time/time.h"
+#include "net/http/http_response_headers.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kIterations = 20000;
+
+// Response headers as they are sent by popular sites and CDNs, for a mix of
+// documents, scripts, images and redirects.
+const char* const kHeaderCorpus[] = {
+  "HTTP/1.1 200 OK\n"
+  "Date: Tue, 03 Mar 2015 18:41:21 GMT\n"
+  "Expires: -1\n"
+  "Cache-Control: private, max-age=0\n"
+  "Content-Type: text/html; charset=UTF-8\n"
+  "Content-Encoding: gzip\n"
+  "Server: gws\n"
+  "X-XSS-Protection: 1; mode=block\n"
+  "X-Frame-Options: SAMEORIGIN\n"
+  "Alternate-Protocol: 443:quic,p=0.08\n"
+  "Transfer-Encoding: chunked\n"
+  "Set-Cookie: PREF=ID=1111111111111111:FF=0:TM=1425408081:LM=1425408081:"
+      "S=abcdefghijklmnop; expires=Thu, 02-Mar-2017 18:41:21 GMT; path=/; "
+      "domain=.example.com\n",
+
+  "HTTP/1.1 200 OK\n"
+  "Accept-Ranges: bytes\n"
+  "Vary: Accept-Encoding\n"
+  "Content-Encoding: gzip\n"
+  "Content-Type: application/javascript\n"
+  "Last-Modified: Mon, 02 Mar 2015 22:10:31 GMT\n"
+  "Date: Tue, 03 Mar 2015 17:25:02 GMT\n"
+  "Expires: Wed, 02 Mar 2016 17:25:02 GMT\n"
+  "X-Content-Type-Options: nosniff\n"
+  "Server: sffe\n"
+  "Content-Length: 34761\n"
+  "Cache-Control: public, max-age=31536000\n"
+  "Age: 4579\n",
+
+  "HTTP/1.1 200 OK\n"
+  "Server: Apache\n"
+  "ETag: \"8f2d7a3b6b1c1e4d5f6a7b8c9d0e1f2a:1424981234\"\n"
+  "Last-Modified: Thu, 26 Feb 2015 19:53:54 GMT\n"
+  "Accept-Ranges: bytes\n"
+  "Content-Length: 18342\n"
+  "Content-Type: image/jpeg\n"
+  "Cache-Control: max-age=604800\n"
+  "Expires: Tue, 10 Mar 2015 18:41:21 GMT\n"
+  "Date: Tue, 03 Mar 2015 18:41:21 GMT\n"
+  "Connection: keep-alive\n"
+  "Access-Control-Allow-Origin: *\n"
+  "Timing-Allow-Origin: *\n",
+
+  "HTTP/1.1 301 Moved Permanently\n"
+  "Location: https://www.example.org/\n"
+  "Content-Type: text/html; charset=iso-8859-1\n"
+  "Content-Length: 231\n"
+  "Date: Tue, 03 Mar 2015 18:41:22 GMT\n"
+  "Server: nginx\n"
+  "Connection: keep-alive\n"
+  "Cache-Control: max-age=3600\n"
+  "Expires: Tue, 03 Mar 2015 19:41:22 GMT\n",
+
+  "HTTP/1.1 200 OK\n"
+  "Content-Type: text/html; charset=utf-8\n"
+  "Cache-Control: no-cache, no-store, must-revalidate\n"
+  "Pragma: no-cache\n"
+  "Expires: Sat, 01 Jan 2000 00:00:00 GMT\n"
+  "Strict-Transport-Security: max-age=15552000; preload\n"
+  "Public-Key-Pins: max-age=500; "
+      "pin-sha256=\"WoiWRyIOVNa9ihaBciRSC7XHjliYS9VwUGOIud4PB18=\"; "
+      "pin-sha256=\"r/mIkG3eEpVdm+u/ko/cwxzOMo1bk4TyHIlByibiA5E=\"\n"
+  "Vary: Accept-Encoding\n"
+  "Content-Encoding: gzip\n"
+  "X-Content-Type-Options: nosniff\n"
+  "X-Frame-Options: DENY\n"
+  "X-XSS-Protection: 0\n"
+  "X-FB-Debug: Ohz2bkOEN9Yl0NTLUf3C3bcfbgs9Tz5z8aw0lrIO2Xc=\n"
+  "Date: Tue, 03 Mar 2015 18:41:23 GMT\n"
+  "Transfer-Encoding: chunked\n"
+  "Connection: keep-alive\n",
+
+  "HTTP/1.1 304 Not Modified\n"
+  "Date: Tue, 03 Mar 2015 18:41:24 GMT\n"
+  "Connection: keep-alive\n"
+  "ETag: \"54f5e4b2-1b3c\"\n"
+  "Expires: Tue, 10 Mar 2015 18:41:24 GMT\n"
+  "Cache-Control: max-age=604800\n",
+
+  "HTTP/1.1 200 OK\n"
+  "x-amz-id-2: kwgKwK8DkSBW8ZXrG2tnUnuGN1rlhmh5XmIxO5p1mTBnGQ0RDBS3e4DDsF\n"
+  "x-amz-request-id: 6A3BC18E3C14DE3E\n"
+  "Date: Tue, 03 Mar 2015 18:41:25 GMT\n"
+  "Last-Modified: Fri, 13 Feb 2015 01:12:33 GMT\n"
+  "ETag: \"2ae8d3c2e7a5e2b9d4c2f2b9f0e1a3d4\"\n"
+  "Accept-Ranges: bytes\n"
+  "Content-Type: text/css\n"
+  "Content-Length: 89012\n"
+  "Server: AmazonS3\n"
+  "X-Cache: Hit from cloudfront\n"
+  "Via: 1.1 abcdef0123456789.cloudfront.net (CloudFront)\n"
+  "X-Amz-Cf-Id: 0ahY0z5rPq8Cq3oY7Wl6XZ1V9nCkL7v0W8hO2lUj3gHkUQ7E1lRp8w==\n"
+  "Age: 81234\n",
+};
+
+// Returns the corpus in the raw format HttpResponseHeaders expects.
+std::vector<std::string> GetRawCorpus() {
+  std::vector<std::string> corpus;
+  for (size_t i = 0; i < arraysize(kHeaderCorpus); ++i) {
+    std::string raw(kHeaderCorpus[i]);
+    std::replace(raw.begin(), raw.end(), '\n', '\0');
+    raw.push_back('\0');
+    corpus.push_back(raw);
+  }
+  return corpus;
+}
+
+// The lookups done on every response by the network stack and the cache.
+int DoCommonLookups(const HttpResponseHeaders& headers) {
+  int found = 0;
+  base::TimeDelta delta;
+  base::Time time;
+  std::string value;
+  found += headers.GetContentLength() >= 0;
+  found += headers.GetMaxAgeValue(&delta);
+  found += headers.GetDateValue(&time);
+  found += headers.GetExpiresValue(&time);
+  found += headers.GetLastModifiedValue(&time);
+  found += headers.HasHeaderValue("cache-control", "no-store");
+  found += headers.HasHeaderValue("pragma", "no-cache");
+  found += headers.HasHeader("vary");
+  found += headers.IsKeepAlive();
+  found += headers.IsChunkEncoded();
+  found += headers.GetMimeType(&value);
+  return found;
+}
+
+}  // namespace
+
+TEST(HttpResponseHeadersPerfTest, Parse) {
+  std::vector<std::string> corpus = GetRawCorpus();
+  base::PerfTimeLogger timer("Parse response headers");
+  for (int i = 0; i < kIterations; ++i) {
+    for (size_t j = 0; j < corpus.size(); ++j) {
+      scoped_refptr<HttpResponseHeaders> headers(
+          new HttpResponseHeaders(corpus[j]));
+      EXPECT_NE(-1, headers->response_code());
+    }
+  }
+  timer.Done();
+}
+
+TEST(HttpResponseHeadersPerfTest, Lookups) {
+  std::vector<std::string> corpus = GetRawCorpus();
+  std::vector<scoped_refptr<HttpResponseHeaders> > parsed;
+  for (size_t i = 0; i < corpus.size(); ++i)
+    parsed.push_back(new HttpResponseHeaders(corpus[i]));
+
+  int found = 0;
+  base::PerfTimeLogger timer("Look up common response headers");
+  for (int i = 0; i < kIterations; ++i) {
+    for (size_t j = 0; j < parsed.size(); ++j)
+      found += DoCommonLookups(*parsed[j].get());
+  }
+  timer.Done();
+  EXPECT_LT(0, found);
+}
+
+// Reads the headers back from the pickles written for the cache, with and
+// without the location of each header.
+TEST(HttpResponseHeadersPerfTest, Unpickle) {
+  std::vector<std::string> corpus = GetRawCorpus();
+  const HttpResponseHeaders::PersistOptions kOptions =
+      HttpResponseHeaders::PERSIST_SANS_COOKIES |
+      HttpResponseHeaders::PERSIST_SANS_CHALLENGES |
+      HttpResponseHeaders::PERSIST_SANS_HOP_BY_HOP |
+      HttpResponseHeaders::PERSIST_SANS_NON_CACHEABLE |
+      HttpResponseHeaders::PERSIST_SANS_RANGES |
+      HttpResponseHeaders::PERSIST_SANS_SECURITY_STATE;
+
+  for (int with_index = 0; with_index < 2; ++with_index) {
+    ScopedVector<Pickle> pickles;
+    for (size_t i = 0; i < corpus.size(); ++i) {
+      scoped_refptr<HttpResponseHeaders> headers(
+          new HttpResponseHeaders(corpus[i]));
+      pickles.push_back(new Pickle());
+      if (with_index) {
+        std::vector<uint32> index;
+        headers->PersistWithIndex(pickles.back(), kOptions, &index);
+        headers->PersistIndex(pickles.back(), index);
+      } else {
+        headers->Persist(pickles.back(), kOptions);
+      }
+    }
+
+    base::PerfTimeLogger timer(with_index ?
+        "Unpickle response headers with index" :
+        "Unpickle response headers");
+    for (int i = 0; i < kIterations; ++i) {
+      for (size_t j = 0; j < pickles.size(); ++j) {
+        PickleIterator iter(*pickles[j]);
+        scoped_refptr<HttpResponseHeaders> headers;
+        if (with_index) {
+          // Skip the headers to get to the index, as HttpResponseInfo does.
+          PickleIterator index_iter(*pickles[j]);
+          int headers_len;
+          ASSERT_TRUE(index_iter.ReadLength(&headers_len));
+          ASSERT_TRUE(index_iter.SkipBytes(headers_len));
+          headers = new HttpResponseHeaders(*pickles[j], &iter, &index_iter);
+        } else {
+          headers = new HttpResponseHeaders(*pickles[j], &iter);
+        }
+        EXPECT_NE(-1, headers->response_code());
+      }
+    }
+    timer.Done();
+  }
+}
+
+}  // namespace net
@@ -353,6 +353,59 @@ TEST_P(PersistenceTest, Persist) {
   EXPECT_EQ(std::string(test.expected_headers), h2);
 }
 
+// Headers persisted with the location of each header read back the same as
+// headers that are parsed again.
+TEST_P(PersistenceTest, PersistWithIndex) {
+  const PersistData test = GetParam();
+
+  std::string headers = test.raw_headers;
+  HeadersToRaw(&headers);
+  scoped_refptr<net::HttpResponseHeaders> parsed1(
+      new net::HttpResponseHeaders(headers));
+
+  Pickle pickle;
+  std::vector<uint32> index;
+  parsed1->PersistWithIndex(&pickle, test.options, &index);
+  parsed1->PersistIndex(&pickle, index);
+  Pickle parsed_pickle;
+  parsed1->Persist(&parsed_pickle, test.options);
+
+  PickleIterator iter(pickle);
+  PickleIterator index_iter(pickle);
+  std::string skipped;
+  ASSERT_TRUE(index_iter.ReadString(&skipped));
+  scoped_refptr<net::HttpResponseHeaders> parsed2(
+      new net::HttpResponseHeaders(pickle, &iter, &index_iter));
+  PickleIterator parsed_iter(parsed_pickle);
+  scoped_refptr<net::HttpResponseHeaders> parsed3(
+      new net::HttpResponseHeaders(parsed_pickle, &parsed_iter));
+
+  std::string h2;
+  parsed2->GetNormalizedHeaders(&h2);
+  EXPECT_EQ(std::string(test.expected_headers), h2);
+  EXPECT_EQ(parsed3->raw_headers(), parsed2->raw_headers());
+  EXPECT_EQ(parsed3->response_code(), parsed2->response_code());
+  EXPECT_EQ(parsed3->GetHttpVersion(), parsed2->GetHttpVersion());
+
+  void* lines2 = NULL;
+  void* lines3 = NULL;
+  std::string name2, name3, value2, value3;
+  while (parsed3->EnumerateHeaderLines(&lines3, &name3, &value3)) {
+    ASSERT_TRUE(parsed2->EnumerateHeaderLines(&lines2, &name2, &value2));
+    EXPECT_EQ(name3, name2);
+    EXPECT_EQ(value3, value2);
+
+    void* values2 = NULL;
+    void* values3 = NULL;
+    while (parsed3->EnumerateHeader(&values3, name3, &value3)) {
+      EXPECT_TRUE(parsed2->EnumerateHeader(&values2, name3, &value2));
+      EXPECT_EQ(value3, value2);
+    }
+    EXPECT_FALSE(parsed2->EnumerateHeader(&values2, name3, &value2));
+  }
+  EXPECT_FALSE(parsed2->EnumerateHeaderLines(&lines2, &name2, &value2));
+}
+
 const struct PersistData persistence_tests[] = {
   { net::HttpResponseHeaders::PERSIST_ALL,
     "HTTP/1.1 200 OK\n"
@@ -521,6 +574,159 @@ INSTANTIATE_TEST_CASE_P(HttpResponseHeaders,
                         PersistenceTest,
                         testing::ValuesIn(persistence_tests));
 
+TEST(HttpResponseHeadersTest, PersistRawWithIndex) {
+  std::string headers =
+      "HTTP/1.1 200 OK\n"
+      "Cache-control: private, max-age=10\n"
+      "not a header\n"
+      "Set-Cookie: a=b\n"
+      "Server: blah\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<net::HttpResponseHeaders> parsed1(
+      new net::HttpResponseHeaders(headers));
+
+  // The headers are written as by Persist(), and the index can come after
+  // other data.
+  Pickle pickle;
+  std::vector<uint32> index;
+  parsed1->PersistWithIndex(&pickle, net::HttpResponseHeaders::PERSIST_RAW,
+                            &index);
+  pickle.WriteInt(42);
+  parsed1->PersistIndex(&pickle, index);
+  pickle.WriteInt(43);
+
+  PickleIterator old_iter(pickle);
+  scoped_refptr<net::HttpResponseHeaders> parsed_again(
+      new net::HttpResponseHeaders(pickle, &old_iter));
+  EXPECT_EQ(parsed1->raw_headers(), parsed_again->raw_headers());
+  int value;
+  EXPECT_TRUE(old_iter.ReadInt(&value));
+  EXPECT_EQ(42, value);
+
+  PickleIterator iter(pickle);
+  PickleIterator index_iter = old_iter;
+  scoped_refptr<net::HttpResponseHeaders> parsed2(
+      new net::HttpResponseHeaders(pickle, &iter, &index_iter));
+  EXPECT_EQ(parsed1->raw_headers(), parsed2->raw_headers());
+  EXPECT_EQ(200, parsed2->response_code());
+  EXPECT_TRUE(parsed2->HasHeaderValue("cache-control", "max-age=10"));
+  EXPECT_TRUE(parsed2->HasHeaderValue("set-cookie", "a=b"));
+  EXPECT_TRUE(parsed2->HasHeaderValue("server", "blah"));
+
+  // The headers and the whole index were consumed.
+  EXPECT_TRUE(iter.ReadInt(&value));
+  EXPECT_EQ(42, value);
+  EXPECT_TRUE(index_iter.ReadInt(&value));
+  EXPECT_EQ(43, value);
+}
+
+// A bad index is ignored, and the headers are parsed again.
+TEST(HttpResponseHeadersTest, PersistWithBadIndex) {
+  std::string headers =
+      "HTTP/1.1 200 OK\n"
+      "Content-Length: 100\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<net::HttpResponseHeaders> parsed1(
+      new net::HttpResponseHeaders(headers));
+
+  const uint32 kBadIndex[] = { 17, 31, 33, 1000 };
+  Pickle pickle;
+  pickle.WriteString(parsed1->raw_headers());
+  pickle.WriteInt(200);
+  pickle.WriteData(reinterpret_cast<const char*>(kBadIndex),
+                   sizeof(kBadIndex));
+  pickle.WriteInt(42);
+
+  PickleIterator iter(pickle);
+  PickleIterator index_iter(pickle);
+  std::string skipped;
+  ASSERT_TRUE(index_iter.ReadString(&skipped));
+  scoped_refptr<net::HttpResponseHeaders> parsed2(
+      new net::HttpResponseHeaders(pickle, &iter, &index_iter));
+  EXPECT_EQ(parsed1->raw_headers(), parsed2->raw_headers());
+  EXPECT_EQ(100, parsed2->GetContentLength());
+
+  int value;
+  EXPECT_TRUE(index_iter.ReadInt(&value));
+  EXPECT_EQ(42, value);
+
+  // So is a missing one.
+  PickleIterator iter2(pickle);
+  PickleIterator end_iter = index_iter;
+  scoped_refptr<net::HttpResponseHeaders> parsed3(
+      new net::HttpResponseHeaders(pickle, &iter2, &end_iter));
+  EXPECT_EQ(parsed1->raw_headers(), parsed3->raw_headers());
+  EXPECT_EQ(100, parsed3->GetContentLength());
+}
+
+// An index whose lines are out of order is ignored too, as the headers could
+// not be persisted again from it.
+TEST(HttpResponseHeadersTest, PersistWithUnorderedIndex) {
+  std::string headers =
+      "HTTP/1.1 200 OK\n"
+      "Content-Length: 100\n"
+      "X-Foo: 1\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<net::HttpResponseHeaders> parsed1(
+      new net::HttpResponseHeaders(headers));
+
+  // The offsets of each line are right, but X-Foo comes first.
+  const uint32 kUnorderedIndex[] = { 36, 41, 43, 44, 16, 30, 32, 35 };
+  Pickle pickle;
+  pickle.WriteString(parsed1->raw_headers());
+  pickle.WriteInt(200);
+  pickle.WriteData(reinterpret_cast<const char*>(kUnorderedIndex),
+                   sizeof(kUnorderedIndex));
+
+  PickleIterator iter(pickle);
+  PickleIterator index_iter(pickle);
+  std::string skipped;
+  ASSERT_TRUE(index_iter.ReadString(&skipped));
+  scoped_refptr<net::HttpResponseHeaders> parsed2(
+      new net::HttpResponseHeaders(pickle, &iter, &index_iter));
+  EXPECT_EQ(parsed1->raw_headers(), parsed2->raw_headers());
+  EXPECT_EQ(100, parsed2->GetContentLength());
+
+  Pickle pickle2;
+  parsed2->Persist(&pickle2, net::HttpResponseHeaders::PERSIST_ALL);
+  PickleIterator iter2(pickle2);
+  scoped_refptr<net::HttpResponseHeaders> parsed3(
+      new net::HttpResponseHeaders(pickle2, &iter2));
+  EXPECT_TRUE(parsed3->HasHeaderValue("x-foo", "1"));
+  EXPECT_EQ(100, parsed3->GetContentLength());
+}
+
+// Well known headers are found regardless of case, and after the headers
+// change.
+TEST(HttpResponseHeadersTest, KnownHeaders) {
+  std::string headers =
+      "HTTP/1.1 200 OK\n"
+      "X-Foo: 1\n"
+      "cache-CONTROL: private\n"
+      "Content-Length: 100\n"
+      "Cache-Control: no-store\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<net::HttpResponseHeaders> parsed(
+      new net::HttpResponseHeaders(headers));
+
+  void* iter = NULL;
+  std::string value;
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "Cache-Control", &value));
+  EXPECT_EQ("private", value);
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "Cache-Control", &value));
+  EXPECT_EQ("no-store", value);
+  EXPECT_FALSE(parsed->EnumerateHeader(&iter, "Cache-Control", &value));
+  EXPECT_FALSE(parsed->HasHeader("Content-Type"));
+
+  parsed->RemoveHeader("Cache-Control");
+  EXPECT_FALSE(parsed->HasHeader("cache-control"));
+  EXPECT_EQ(100, parsed->GetContentLength());
+
+  parsed->AddHeader("CONTENT-TYPE: text/html");
+  EXPECT_TRUE(parsed->HasHeaderValue("content-type", "text/html"));
+  EXPECT_TRUE(parsed->HasHeaderValue("x-foo", "1"));
+}
+
 TEST(HttpResponseHeadersTest, EnumerateHeader_Coalesced) {
   // Ensure that commas in quoted strings are not regarded as value separators.
   // Ensure that whitespace following a value is trimmed properly.
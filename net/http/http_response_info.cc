@@ -91,6 +91,10 @@ enum {
   // This bit is set if ssl_info has SCTs.
   RESPONSE_INFO_HAS_SIGNED_CERTIFICATE_TIMESTAMPS = 1 << 20,
 
+  // This bit is set if the location of each response header follows all the
+  // other fields, so that the headers don't have to be parsed again.
+  RESPONSE_INFO_HAS_HEADERS_INDEX = 1 << 21,
+
   // TODO(darin): Add other bits to indicate alternate request methods.
   // For now, we don't support storing those.
 };
@@ -181,10 +185,19 @@ bool HttpResponseInfo::InitFromPickle(const Pickle& pickle,
     return false;
   response_time = Time::FromInternalValue(time_val);
 
-  // Read response-headers
-  headers = new HttpResponseHeaders(pickle, &iter);
-  if (headers->response_code() == -1)
-    return false;
+  // Read response-headers. With an index, they are read once the index,
+  // which comes last, is found.
+  PickleIterator headers_iter = iter;
+  if (flags & RESPONSE_INFO_HAS_HEADERS_INDEX) {
+    // Skip the headers string: its length, then its data.
+    int headers_len;
+    if (!iter.ReadLength(&headers_len) || !iter.SkipBytes(headers_len))
+      return false;
+  } else {
+    headers = new HttpResponseHeaders(pickle, &iter);
+    if (headers->response_code() == -1)
+      return false;
+  }
 
   // Read ssl-info
   if (flags & RESPONSE_INFO_HAS_CERT) {
@@ -277,13 +290,20 @@ bool HttpResponseInfo::InitFromPickle(const Pickle& pickle,
 
   did_use_http_auth = (flags & RESPONSE_INFO_USE_HTTP_AUTHENTICATION) != 0;
 
+  // Read the response headers, with their index.
+  if (flags & RESPONSE_INFO_HAS_HEADERS_INDEX) {
+    headers = new HttpResponseHeaders(pickle, &headers_iter, &iter);
+    if (headers->response_code() == -1)
+      return false;
+  }
+
   return true;
 }
 
 void HttpResponseInfo::Persist(Pickle* pickle,
                                bool skip_transient_headers,
                                bool response_truncated) const {
-  int flags = RESPONSE_INFO_VERSION;
+  int flags = RESPONSE_INFO_VERSION | RESPONSE_INFO_HAS_HEADERS_INDEX;
   if (ssl_info.is_valid()) {
     flags |= RESPONSE_INFO_HAS_CERT;
     flags |= RESPONSE_INFO_HAS_CERT_STATUS;
@@ -328,7 +348,8 @@ void HttpResponseInfo::Persist(Pickle* pickle,
         net::HttpResponseHeaders::PERSIST_SANS_SECURITY_STATE;
   }
 
-  headers->Persist(pickle, persist_options);
+  std::vector<uint32> headers_index;
+  headers->PersistWithIndex(pickle, persist_options, &headers_index);
 
   if (ssl_info.is_valid()) {
     ssl_info.cert->Persist(pickle);
@@ -359,6 +380,10 @@ void HttpResponseInfo::Persist(Pickle* pickle,
 
   if (connection_info != CONNECTION_INFO_UNKNOWN)
     pickle->WriteInt(static_cast<int>(connection_info));
+
+  // The index goes after everything else, where the readers that don't know
+  // about it don't look.
+  headers->PersistIndex(pickle, headers_index);
 }
 
 HttpResponseInfo::ConnectionInfo HttpResponseInfo::ConnectionInfoFromNextProto(
@@ -128,10 +128,26 @@ struct NET_EXPORT SupportsQuic {
   std::string address;
 };
 
+// How requests to a server use connections.  |request_rate| is the number
+// of requests per second, averaged over the last half minute or so with
+// exponential decay.
+struct NET_EXPORT ServerConnectionUsage {
+  ServerConnectionUsage()
+      : request_rate(0), requests(0), reused_connection_requests(0) {}
+
+  double request_rate;
+  base::TimeTicks last_request_time;
+  int64 requests;
+  // Requests that were sent on a connection that was already open.
+  int64 reused_connection_requests;
+};
+
 typedef base::MRUCache<
     HostPortPair, AlternateProtocolInfo> AlternateProtocolMap;
 typedef base::MRUCache<HostPortPair, SettingsMap> SpdySettingsMap;
 typedef std::map<HostPortPair, SupportsQuic> SupportsQuicMap;
+typedef base::MRUCache<
+    HostPortPair, ServerConnectionUsage> ServerConnectionUsageMap;
 
 extern const char kAlternateProtocolHeader[];
 
@@ -239,6 +255,16 @@ class NET_EXPORT HttpServerProperties {
   virtual const NetworkStats* GetServerNetworkStats(
       const HostPortPair& host_port_pair) const = 0;
 
+  // Records that a request to |host_port_pair| got a stream at time |now|, and
+  // whether the stream's connection had been used before.
+  virtual void RecordServerConnectionUsage(const HostPortPair& host_port_pair,
+                                           bool connection_reused,
+                                           base::TimeTicks now) = 0;
+
+  // Returns NULL if no request to |host_port_pair| was recorded.
+  virtual const ServerConnectionUsage* GetServerConnectionUsage(
+      const HostPortPair& host_port_pair) = 0;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(HttpServerProperties);
 };
@@ -4,6 +4,9 @@
 
 #include "net/http/http_server_properties_impl.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "base/bind.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
@@ -18,12 +21,19 @@ namespace {
 
 const uint64 kBrokenAlternateProtocolDelaySecs = 300;
 
+// Number of servers whose connection usage is remembered.
+const int kMaxServerConnectionUsageEntries = 1000;
+
+// Time constant of the decaying average of a server's request rate.
+const double kServerConnectionUsageDecaySecs = 30;
+
 }  // namespace
 
 HttpServerPropertiesImpl::HttpServerPropertiesImpl()
     : spdy_servers_map_(SpdyServerHostPortMap::NO_AUTO_EVICT),
       alternate_protocol_map_(AlternateProtocolMap::NO_AUTO_EVICT),
       spdy_settings_map_(SpdySettingsMap::NO_AUTO_EVICT),
+      server_connection_usage_map_(kMaxServerConnectionUsageEntries),
       alternate_protocol_probability_threshold_(1),
       weak_ptr_factory_(this) {
   canonical_suffixes_.push_back(".c.youtube.com");
@@ -165,6 +175,7 @@ void HttpServerPropertiesImpl::Clear() {
   canonical_host_to_origin_map_.clear();
   spdy_settings_map_.Clear();
   supports_quic_map_.clear();
+  server_connection_usage_map_.Clear();
 }
 
 bool HttpServerPropertiesImpl::SupportsSpdy(
@@ -436,6 +447,42 @@ HttpServerPropertiesImpl::GetServerNetworkStats(
   return &it->second;
 }
 
+void HttpServerPropertiesImpl::RecordServerConnectionUsage(
+    const HostPortPair& host_port_pair,
+    bool connection_reused,
+    base::TimeTicks now) {
+  ServerConnectionUsageMap::iterator it =
+      server_connection_usage_map_.Get(host_port_pair);
+  if (it == server_connection_usage_map_.end()) {
+    it = server_connection_usage_map_.Put(host_port_pair,
+                                          ServerConnectionUsage());
+  }
+  ServerConnectionUsage& usage = it->second;
+
+  // Each request adds 1 / decay to a rate that decays by e every decay
+  // seconds, so a steady stream of requests converges on its actual rate.
+  if (usage.requests > 0) {
+    double elapsed = std::max(
+        0.0, (now - usage.last_request_time).InSecondsF());
+    usage.request_rate *= std::exp(-elapsed / kServerConnectionUsageDecaySecs);
+  }
+  usage.request_rate += 1 / kServerConnectionUsageDecaySecs;
+  usage.last_request_time = now;
+  usage.requests++;
+  if (connection_reused)
+    usage.reused_connection_requests++;
+}
+
+const ServerConnectionUsage*
+HttpServerPropertiesImpl::GetServerConnectionUsage(
+    const HostPortPair& host_port_pair) {
+  ServerConnectionUsageMap::iterator it =
+      server_connection_usage_map_.Peek(host_port_pair);
+  if (it == server_connection_usage_map_.end())
+    return NULL;
+  return &it->second;
+}
+
 void HttpServerPropertiesImpl::SetAlternateProtocolProbabilityThreshold(
     double threshold) {
   alternate_protocol_probability_threshold_ = threshold;
@@ -149,6 +149,14 @@ class NET_EXPORT HttpServerPropertiesImpl
   const NetworkStats* GetServerNetworkStats(
       const HostPortPair& host_port_pair) const override;
 
+  // Methods for ServerConnectionUsage.
+  void RecordServerConnectionUsage(const HostPortPair& host_port_pair,
+                                   bool connection_reused,
+                                   base::TimeTicks now) override;
+
+  const ServerConnectionUsage* GetServerConnectionUsage(
+      const HostPortPair& host_port_pair) override;
+
  private:
   // |spdy_servers_map_| has flattened representation of servers (host, port)
   // that either support or not support SPDY protocol.
@@ -183,6 +191,7 @@ class NET_EXPORT HttpServerPropertiesImpl
   SpdySettingsMap spdy_settings_map_;
   SupportsQuicMap supports_quic_map_;
   ServerNetworkStatsMap server_network_stats_map_;
+  ServerConnectionUsageMap server_connection_usage_map_;
   // Contains a map of servers which could share the same alternate protocol.
   // Map from a Canonical host/port (host is some postfix of host names) to an
   // actual origin, which has a plausible alternate protocol mapping.
@@ -714,6 +714,36 @@ TEST_F(SupportsQuicServerPropertiesTest, SetSupportsQuic) {
   EXPECT_FALSE(supports_quic2.used_quic);
   EXPECT_EQ("", supports_quic2.address);
 }
+
+typedef HttpServerPropertiesImplTest ServerConnectionUsagePropertiesTest;
+
+TEST_F(ServerConnectionUsagePropertiesTest, RecordServerConnectionUsage) {
+  HostPortPair test_host_port_pair("foo", 443);
+  EXPECT_EQ(NULL, impl_.GetServerConnectionUsage(test_host_port_pair));
+
+  // Ten requests per second, for five minutes, every other one on a reused
+  // connection.
+  base::TimeTicks now = base::TimeTicks::Now();
+  for (int i = 0; i < 3000; ++i) {
+    impl_.RecordServerConnectionUsage(test_host_port_pair, i % 2 == 1, now);
+    now += base::TimeDelta::FromMilliseconds(100);
+  }
+  const ServerConnectionUsage* usage =
+      impl_.GetServerConnectionUsage(test_host_port_pair);
+  ASSERT_TRUE(usage);
+  EXPECT_NEAR(10, usage->request_rate, 0.5);
+  EXPECT_EQ(3000, usage->requests);
+  EXPECT_EQ(1500, usage->reused_connection_requests);
+
+  // The rate decays once requests stop.
+  now += base::TimeDelta::FromMinutes(5);
+  impl_.RecordServerConnectionUsage(test_host_port_pair, false, now);
+  EXPECT_LT(usage->request_rate, 0.1);
+
+  impl_.Clear();
+  EXPECT_EQ(NULL, impl_.GetServerConnectionUsage(test_host_port_pair));
+}
+
 }  // namespace
 
 }  // namespace net
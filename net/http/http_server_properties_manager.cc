@@ -291,6 +291,23 @@ HttpServerPropertiesManager::GetServerNetworkStats(
   return http_server_properties_impl_->GetServerNetworkStats(host_port_pair);
 }
 
+void HttpServerPropertiesManager::RecordServerConnectionUsage(
+    const net::HostPortPair& host_port_pair,
+    bool connection_reused,
+    base::TimeTicks now) {
+  DCHECK(network_task_runner_->RunsTasksOnCurrentThread());
+  http_server_properties_impl_->RecordServerConnectionUsage(
+      host_port_pair, connection_reused, now);
+}
+
+const net::ServerConnectionUsage*
+HttpServerPropertiesManager::GetServerConnectionUsage(
+    const net::HostPortPair& host_port_pair) {
+  DCHECK(network_task_runner_->RunsTasksOnCurrentThread());
+  return http_server_properties_impl_->GetServerConnectionUsage(
+      host_port_pair);
+}
+
 //
 // Update the HttpServerPropertiesImpl's cache with data from preferences.
 //
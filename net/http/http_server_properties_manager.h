@@ -159,6 +159,13 @@ class NET_EXPORT HttpServerPropertiesManager : public HttpServerProperties {
   const NetworkStats* GetServerNetworkStats(
       const HostPortPair& host_port_pair) const override;
 
+  void RecordServerConnectionUsage(const HostPortPair& host_port_pair,
+                                   bool connection_reused,
+                                   base::TimeTicks now) override;
+
+  const ServerConnectionUsage* GetServerConnectionUsage(
+      const HostPortPair& host_port_pair) override;
+
  protected:
   // --------------------
   // SPDY related methods
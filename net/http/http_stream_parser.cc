@@ -4,6 +4,8 @@
 
 #include "net/http/http_stream_parser.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/compiler_specific.h"
 #include "base/logging.h"
@@ -12,7 +14,9 @@
 #include "base/values.h"
 #include "net/base/io_buffer.h"
 #include "net/base/ip_endpoint.h"
+#include "net/base/upload_bytes_element_reader.h"
 #include "net/base/upload_data_stream.h"
+#include "net/base/upload_element_reader.h"
 #include "net/http/http_chunked_decoder.h"
 #include "net/http/http_request_headers.h"
 #include "net/http/http_request_info.h"
@@ -20,6 +24,7 @@
 #include "net/http/http_util.h"
 #include "net/socket/client_socket_handle.h"
 #include "net/socket/ssl_client_socket.h"
+#include "net/socket/stream_socket.h"
 
 namespace net {
 
@@ -184,6 +189,7 @@ HttpStreamParser::HttpStreamParser(ClientSocketHandle* connection,
       request_(request),
       request_headers_(NULL),
       request_headers_length_(0),
+      request_segment_index_(0),
       read_buf_(read_buffer),
       read_buf_unused_offset_(0),
       response_header_start_offset_(-1),
@@ -234,6 +240,27 @@ int HttpStreamParser::SendRequest(const std::string& request_line,
   std::string request = request_line + headers.ToString();
   request_headers_length_ = request.size();
 
+  io_state_ = STATE_SEND_HEADERS;
+
+  // If the socket can gather writes, an in-memory body is sent along with the
+  // headers, without going through the body send buffer.
+  if (ShouldGatherRequestHeadersAndBody(request_->upload_data_stream,
+                                        connection_->socket())) {
+    BuildRequestSegments(request);
+    net_log_.AddEvent(
+        NetLog::TYPE_HTTP_TRANSACTION_SEND_REQUEST_BODY,
+        base::Bind(&NetLogSendRequestBodyCallback,
+                   request_->upload_data_stream->size(),
+                   false, /* not chunked */
+                   true /* merged */));
+
+    result = DoLoop(OK);
+    if (result == ERR_IO_PENDING)
+      callback_ = callback;
+
+    return result > 0 ? OK : result;
+  }
+
   if (request_->upload_data_stream != NULL) {
     request_body_send_buf_ = new SeekableIOBuffer(kRequestBodyBufferSize);
     if (request_->upload_data_stream->is_chunked()) {
@@ -247,8 +274,6 @@ int HttpStreamParser::SendRequest(const std::string& request_line,
     }
   }
 
-  io_state_ = STATE_SEND_HEADERS;
-
   // If we have a small request body, then we'll merge with the headers into a
   // single write.
   bool did_merge = false;
@@ -437,7 +462,6 @@ int HttpStreamParser::DoLoop(int result) {
 
 int HttpStreamParser::DoSendHeaders() {
   int bytes_remaining = request_headers_->BytesRemaining();
-  DCHECK_GT(bytes_remaining, 0);
 
   // Record our best estimate of the 'request time' as the time when we send
   // out the first bytes of the request headers.
@@ -445,6 +469,20 @@ int HttpStreamParser::DoSendHeaders() {
     response_->request_time = base::Time::Now();
 
   io_state_ = STATE_SEND_HEADERS_COMPLETE;
+
+  if (!request_segments_.empty()) {
+    DCHECK_LT(request_segment_index_, request_segments_.size());
+    std::vector<scoped_refptr<IOBuffer> > bufs;
+    std::vector<int> buf_lens;
+    for (size_t i = request_segment_index_; i < request_segments_.size();
+         ++i) {
+      bufs.push_back(request_segments_[i]);
+      buf_lens.push_back(request_segments_[i]->BytesRemaining());
+    }
+    return connection_->socket()->WriteV(bufs, buf_lens, io_callback_);
+  }
+
+  DCHECK_GT(bytes_remaining, 0);
   return connection_->socket()
       ->Write(request_headers_.get(), bytes_remaining, io_callback_);
 }
@@ -463,6 +501,15 @@ int HttpStreamParser::DoSendHeadersComplete(int result) {
     return result;
   }
 
+  if (!request_segments_.empty()) {
+    ConsumeRequestSegments(result);
+    if (request_segment_index_ < request_segments_.size())
+      io_state_ = STATE_SEND_HEADERS;
+    // Otherwise the body, if any, went out with the headers, and the request
+    // has been sent.
+    return OK;
+  }
+
   request_headers_->DidConsume(result);
   if (request_headers_->BytesRemaining() > 0) {
     io_state_ = STATE_SEND_HEADERS;
@@ -559,6 +606,52 @@ int HttpStreamParser::DoSendRequestReadBodyComplete(int result) {
   return result;
 }
 
+void HttpStreamParser::BuildRequestSegments(const std::string& request) {
+  DCHECK(request_segments_.empty());
+
+  scoped_refptr<StringIOBuffer> headers_io_buf(new StringIOBuffer(request));
+  request_headers_ =
+      new DrainableIOBuffer(headers_io_buf.get(), headers_io_buf->size());
+  request_segments_.push_back(request_headers_);
+
+  // The bytes of the elements belong to the caller, and may go away with the
+  // request while the socket still holds the buffers of a pending write, so
+  // they are copied into a buffer that the segment owns. This is the one copy
+  // that reading the body through the upload stream makes as well.
+  const uint64 body_size = request_->upload_data_stream->size();
+  DCHECK_LE(body_size, static_cast<uint64>(kint32max));
+  scoped_refptr<IOBufferWithSize> body_io_buf(
+      new IOBufferWithSize(static_cast<int>(body_size)));
+  int body_offset = 0;
+  const ScopedVector<UploadElementReader>& readers =
+      *request_->upload_data_stream->GetElementReaders();
+  for (size_t i = 0; i < readers.size(); ++i) {
+    const UploadBytesElementReader* reader = readers[i]->AsBytesReader();
+    DCHECK_LE(reader->length(),
+              static_cast<uint64>(body_io_buf->size() - body_offset));
+    memcpy(body_io_buf->data() + body_offset, reader->bytes(),
+           static_cast<size_t>(reader->length()));
+    body_offset += static_cast<int>(reader->length());
+  }
+  DCHECK_EQ(body_io_buf->size(), body_offset);
+  request_segments_.push_back(
+      new DrainableIOBuffer(body_io_buf.get(), body_io_buf->size()));
+  request_segment_index_ = 0;
+}
+
+void HttpStreamParser::ConsumeRequestSegments(int bytes) {
+  while (bytes > 0) {
+    DCHECK_LT(request_segment_index_, request_segments_.size());
+    DrainableIOBuffer* segment =
+        request_segments_[request_segment_index_].get();
+    int consumed = std::min(bytes, segment->BytesRemaining());
+    segment->DidConsume(consumed);
+    bytes -= consumed;
+    if (segment->BytesRemaining() == 0)
+      ++request_segment_index_;
+  }
+}
+
 int HttpStreamParser::DoReadHeaders() {
   io_state_ = STATE_READ_HEADERS_COMPLETE;
 
@@ -975,6 +1068,15 @@ UploadProgress HttpStreamParser::GetUploadProgress() const {
   if (!request_->upload_data_stream)
     return UploadProgress();
 
+  // A gathered body is sent without reading the stream, so its position does
+  // not move.
+  if (request_segments_.size() > 1) {
+    uint64 position = 0;
+    for (size_t i = 1; i < request_segments_.size(); ++i)
+      position += request_segments_[i]->BytesConsumed();
+    return UploadProgress(position, request_->upload_data_stream->size());
+  }
+
   return UploadProgress(request_->upload_data_stream->position(),
                         request_->upload_data_stream->size());
 }
@@ -1066,4 +1168,25 @@ bool HttpStreamParser::ShouldMergeRequestHeadersAndBody(
   return false;
 }
 
+// static
+bool HttpStreamParser::ShouldGatherRequestHeadersAndBody(
+    const UploadDataStream* request_body,
+    const StreamSocket* socket) {
+  // IsInMemory() ensures that the request body is not chunked.
+  if (request_body == NULL || !request_body->IsInMemory() ||
+      request_body->size() == 0 || !socket->SupportsWriteV()) {
+    return false;
+  }
+
+  const ScopedVector<UploadElementReader>* readers =
+      request_body->GetElementReaders();
+  if (!readers)
+    return false;
+  for (size_t i = 0; i < readers->size(); ++i) {
+    if (!(*readers)[i]->AsBytesReader())
+      return false;
+  }
+  return true;
+}
+
 }  // namespace net
@@ -6,6 +6,7 @@
 #define NET_HTTP_HTTP_STREAM_PARSER_H_
 
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/memory/ref_counted.h"
@@ -30,6 +31,7 @@ class IOBuffer;
 class IOBufferWithSize;
 class SSLCertRequestInfo;
 class SSLInfo;
+class StreamSocket;
 class UploadDataStream;
 
 class NET_EXPORT_PRIVATE HttpStreamParser {
@@ -99,6 +101,14 @@ class NET_EXPORT_PRIVATE HttpStreamParser {
       const std::string& request_headers,
       const UploadDataStream* request_body);
 
+  // Returns true if the request headers and body should be sent together with
+  // StreamSocket::WriteV(), straight from the body's in-memory elements (i.e.
+  // the body is in memory, made only of bytes elements, and |socket| can
+  // gather writes).
+  static bool ShouldGatherRequestHeadersAndBody(
+      const UploadDataStream* request_body,
+      const StreamSocket* socket);
+
   // The number of extra bytes required to encode a chunk.
   static const size_t kChunkHeaderFooterSize;
 
@@ -169,6 +179,13 @@ class NET_EXPORT_PRIVATE HttpStreamParser {
   // Examine the parsed headers to try to determine the response body size.
   void CalculateResponseBodySize();
 
+  // Fills |request_segments_| with the request headers in |request| followed
+  // by a copy of the in-memory request body.
+  void BuildRequestSegments(const std::string& request);
+
+  // Advances |request_segments_| past the |bytes| just written.
+  void ConsumeRequestSegments(int bytes);
+
   // Next state of the request, when the current one completes.
   State io_state_;
 
@@ -182,6 +199,16 @@ class NET_EXPORT_PRIVATE HttpStreamParser {
   // |request_headers_| if the body was merged with the headers.
   int request_headers_length_;
 
+  // The request headers, followed by the request body, when they are sent
+  // together with StreamSocket::WriteV(). The segments own their data, so it
+  // stays valid for as long as the socket holds on to them. The first segment
+  // is |request_headers_|.  Empty otherwise.
+  std::vector<scoped_refptr<DrainableIOBuffer> > request_segments_;
+
+  // Index of the first segment in |request_segments_| that has not been fully
+  // written.
+  size_t request_segment_index_;
+
   // Temporary buffer for reading.
   scoped_refptr<GrowableIOBuffer> read_buf_;
 
@@ -0,0 +1,99 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_time_logger.h"
+#include "net/http/http_chunked_decoder.h"
+#include "net/http/http_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kIterations = 100000;
+const int kChunkedIterations = 200;
+
+// A typical response, as HttpStreamParser receives it from the socket.
+const char kResponse[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Date: Tue, 03 Mar 2015 18:41:21 GMT\r\n"
+    "Expires: -1\r\n"
+    "Cache-Control: private, max-age=0\r\n"
+    "Content-Type: text/html; charset=UTF-8\r\n"
+    "Content-Encoding: gzip\r\n"
+    "Server: gws\r\n"
+    "X-XSS-Protection: 1; mode=block\r\n"
+    "X-Frame-Options: SAMEORIGIN\r\n"
+    "Alternate-Protocol: 443:quic,p=0.08\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "Set-Cookie: PREF=ID=1111111111111111:FF=0:TM=1425408081:LM=1425408081:"
+    "S=abcdefghijklmnop; expires=Thu, 02-Mar-2017 18:41:21 GMT; path=/; "
+    "domain=.example.com\r\n"
+    "\r\n"
+    "body";
+
+// Returns a chunked body of |num_chunks| chunks of |chunk_size| bytes.
+std::string MakeChunkedBody(int num_chunks, int chunk_size) {
+  std::string chunk = base::StringPrintf("%X\r\n", chunk_size);
+  chunk.append(chunk_size, 'a');
+  chunk.append("\r\n");
+  std::string body;
+  for (int i = 0; i < num_chunks; ++i)
+    body.append(chunk);
+  body.append("0\r\n\r\n");
+  return body;
+}
+
+void DecodeChunkedBody(const char* name, const std::string& body) {
+  std::string buf;
+  int total = 0;
+  base::PerfTimeLogger timer(name);
+  for (int i = 0; i < kChunkedIterations; ++i) {
+    HttpChunkedDecoder decoder;
+    buf = body;
+    total += decoder.FilterBuf(&buf[0], static_cast<int>(buf.size()));
+    EXPECT_TRUE(decoder.reached_eof());
+  }
+  timer.Done();
+  EXPECT_LT(0, total);
+}
+
+}  // namespace
+
+TEST(HttpStreamParserPerfTest, LocateEndOfHeaders) {
+  const int len = static_cast<int>(arraysize(kResponse) - 1);
+  int total = 0;
+  base::PerfTimeLogger timer("Locate end of response headers");
+  for (int i = 0; i < kIterations; ++i)
+    total += HttpUtil::LocateEndOfHeaders(kResponse, len);
+  timer.Done();
+  EXPECT_EQ(kIterations * (len - 4), total);
+}
+
+TEST(HttpStreamParserPerfTest, AssembleRawHeaders) {
+  const int len = static_cast<int>(arraysize(kResponse) - 1);
+  const int end_of_header_offset = HttpUtil::LocateEndOfHeaders(kResponse, len);
+  size_t total = 0;
+  base::PerfTimeLogger timer("Assemble raw response headers");
+  for (int i = 0; i < kIterations; ++i) {
+    std::string raw_headers =
+        HttpUtil::AssembleRawHeaders(kResponse, end_of_header_offset);
+    total += raw_headers.size();
+  }
+  timer.Done();
+  EXPECT_LT(0u, total);
+}
+
+TEST(HttpStreamParserPerfTest, DecodeChunked) {
+  DecodeChunkedBody("Decode 64 KB body in 16 KB chunks",
+                    MakeChunkedBody(4, 16 * 1024));
+  DecodeChunkedBody("Decode 64 KB body in 64 byte chunks",
+                    MakeChunkedBody(1024, 64));
+}
+
+}  // namespace net
@@ -28,6 +28,7 @@
 #include "net/http/http_response_info.h"
 #include "net/socket/client_socket_handle.h"
 #include "net/socket/socket_test_util.h"
+#include "net/socket/tcp_client_socket.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "url/gurl.h"
 
@@ -183,6 +184,49 @@ TEST(HttpStreamParser, ShouldMergeRequestHeadersAndBody_LargeBodyInMemory) {
       "some header", body.get()));
 }
 
+TEST(HttpStreamParser, ShouldGatherRequestHeadersAndBody_NoBody) {
+  TCPClientSocket socket(AddressList(), NULL, NetLog::Source());
+  ASSERT_FALSE(HttpStreamParser::ShouldGatherRequestHeadersAndBody(
+      NULL, &socket));
+}
+
+TEST(HttpStreamParser, ShouldGatherRequestHeadersAndBody_ChunkedBody) {
+  const std::string payload = "123";
+  scoped_ptr<ChunkedUploadDataStream> body(new ChunkedUploadDataStream(0));
+  body->AppendData(payload.data(), payload.size(), true);
+  ASSERT_EQ(OK, body->Init(TestCompletionCallback().callback()));
+  TCPClientSocket socket(AddressList(), NULL, NetLog::Source());
+  // Chunked bodies have to be encoded, so they are never gathered.
+  ASSERT_FALSE(HttpStreamParser::ShouldGatherRequestHeadersAndBody(
+      body.get(), &socket));
+}
+
+TEST(HttpStreamParser, ShouldGatherRequestHeadersAndBody_BodyInMemory) {
+  ScopedVector<UploadElementReader> element_readers;
+  const std::string payload1(10000, 'a');
+  const std::string payload2 = "123";
+  element_readers.push_back(new UploadBytesElementReader(
+      payload1.data(), payload1.size()));
+  element_readers.push_back(new UploadBytesElementReader(
+      payload2.data(), payload2.size()));
+
+  scoped_ptr<UploadDataStream> body(
+      new ElementsUploadDataStream(element_readers.Pass(), 0));
+  ASSERT_EQ(OK, body->Init(CompletionCallback()));
+
+  // Gathered regardless of size, if the socket supports it.
+  TCPClientSocket socket(AddressList(), NULL, NetLog::Source());
+  EXPECT_EQ(socket.SupportsWriteV(),
+            HttpStreamParser::ShouldGatherRequestHeadersAndBody(body.get(),
+                                                                &socket));
+
+  // Never gathered on sockets that can't do it.
+  MockTCPClientSocket mock_socket(AddressList(), NULL, NULL);
+  ASSERT_FALSE(mock_socket.SupportsWriteV());
+  EXPECT_FALSE(HttpStreamParser::ShouldGatherRequestHeadersAndBody(
+      body.get(), &mock_socket));
+}
+
 // Test to ensure the HttpStreamParser state machine does not get confused
 // when sending a request with a chunked body, where chunks become available
 // asynchronously, over a socket where writes may also complete
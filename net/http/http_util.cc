@@ -7,6 +7,17 @@
 
 #include "net/http/http_util.h"
 
+// Visual C++ defines _M_IX86_FP as 2 if the /arch:SSE2 compiler option is
+// specified.
+#if !defined(__SSE2__) && _M_IX86_FP == 2
+#define __SSE2__ 1
+#endif
+
+#if __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+#include <string.h>
+
 #include <algorithm>
 
 #include "base/basictypes.h"
@@ -18,6 +29,18 @@
 #include "base/strings/stringprintf.h"
 #include "base/time/time.h"
 
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+
+#pragma intrinsic(_BitScanForward)
+
+static int ffs(int i) {
+  unsigned long index;
+  return _BitScanForward(&index, i) ? index + 1 : 0;
+}
+#else
+#include <strings.h>
+#endif
 
 namespace net {
 
@@ -543,6 +566,35 @@ int HttpUtil::LocateStartOfStatusLine(const char* buf, int buf_len) {
 }
 
 int HttpUtil::LocateEndOfHeaders(const char* buf, int buf_len, int i) {
+  const int start = i;
+#if __SSE2__
+  // Look at 16 bytes at a time, and find every LF that is preceded by LF or
+  // by LF CR. Bytes before the current block only take part in the match
+  // through the overlap between blocks, so a block with no LF at all can be
+  // skipped entirely.
+  const __m128i lfs = _mm_set1_epi8('\n');
+  const __m128i crs = _mm_set1_epi8('\r');
+  while (i + 16 <= buf_len) {
+    __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + i));
+    int lf_msk = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, lfs));
+    if (lf_msk == 0) {
+      i += 16;
+      continue;
+    }
+    int cr_msk = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, crs));
+    int end_msk =
+        lf_msk & ((lf_msk << 1) | ((cr_msk << 1) & (lf_msk << 2)));
+    if (end_msk)
+      return i + ffs(end_msk);
+    // The last two bytes of the block may start a terminator which ends in
+    // the next one.
+    i += 14;
+  }
+  // Finish byte by byte, from the first position which may start a
+  // terminator that has not been looked at yet.
+  i = std::max(start, i - 2);
+#endif  // __SSE2__
   bool was_lf = false;
   char last_c = '\0';
   for (; i < buf_len; ++i) {
@@ -584,12 +636,44 @@ static bool IsLineSegmentContinuable(const char* begin, const char* end) {
   return true;
 }
 
-// Helper used by AssembleRawHeaders, to find the end of the status line.
-static const char* FindStatusLineEnd(const char* begin, const char* end) {
-  size_t i = base::StringPiece(begin, end - begin).find_first_of("\r\n");
-  if (i == base::StringPiece::npos)
-    return end;
-  return begin + i;
+// Helper used by AssembleRawHeaders, to find the end of a line. Returns the
+// first CR or LF in [begin, end), or |end| if there is none.
+static const char* FindLineEnd(const char* begin, const char* end) {
+  const char* cur = begin;
+#if __SSE2__
+  const __m128i lfs = _mm_set1_epi8('\n');
+  const __m128i crs = _mm_set1_epi8('\r');
+  for (; end - cur >= 16; cur += 16) {
+    __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur));
+    int msk = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, lfs),
+                                             _mm_cmpeq_epi8(bytes, crs)));
+    if (msk)
+      return cur + ffs(msk) - 1;
+  }
+#endif  // __SSE2__
+  for (; cur != end; ++cur) {
+    if (*cur == '\r' || *cur == '\n')
+      return cur;
+  }
+  return end;
+}
+
+// Helper used by AssembleRawHeaders, to copy [begin, end) to |output| without
+// any embedded '\0', which would otherwise be read as a line terminator.
+static void AppendWithoutNulls(const char* begin,
+                               const char* end,
+                               std::string* output) {
+  while (begin != end) {
+    const char* null =
+        static_cast<const char*>(memchr(begin, '\0', end - begin));
+    if (!null) {
+      output->append(begin, end);
+      return;
+    }
+    output->append(begin, null);
+    begin = null + 1;
+  }
 }
 
 // Helper used by AssembleRawHeaders, to skip past leading LWS.
@@ -615,48 +699,47 @@ std::string HttpUtil::AssembleRawHeaders(const char* input_begin,
     input_begin += status_begin_offset;
 
   // Copy the status line.
-  const char* status_line_end = FindStatusLineEnd(input_begin, input_end);
-  raw_headers.append(input_begin, status_line_end);
+  const char* status_line_end = FindLineEnd(input_begin, input_end);
+  AppendWithoutNulls(input_begin, status_line_end, &raw_headers);
 
   // After the status line, every subsequent line is a header line segment.
   // Should a segment start with LWS, it is a continuation of the previous
-  // line's field-value.
-
-  // TODO(ericroman): is this too permissive? (delimits on [\r\n]+)
-  base::CStringTokenizer lines(status_line_end, input_end, "\r\n");
+  // line's field-value. The output is built in a single pass, with '\0' as
+  // the line terminator.
 
   // This variable is true when the previous line was continuable.
   bool prev_line_continuable = false;
 
-  while (lines.GetNext()) {
-    const char* line_begin = lines.token_begin();
-    const char* line_end = lines.token_end();
+  const char* line_begin = status_line_end;
+  for (;;) {
+    // TODO(ericroman): is this too permissive? (delimits on [\r\n]+)
+    while (line_begin != input_end &&
+           (*line_begin == '\r' || *line_begin == '\n')) {
+      ++line_begin;
+    }
+    if (line_begin == input_end)
+      break;
+    const char* line_end = FindLineEnd(line_begin, input_end);
 
     if (prev_line_continuable && IsLWS(*line_begin)) {
       // Join continuation; reduce the leading LWS to a single SP.
       raw_headers.push_back(' ');
-      raw_headers.append(FindFirstNonLWS(line_begin, line_end), line_end);
+      AppendWithoutNulls(FindFirstNonLWS(line_begin, line_end), line_end,
+                         &raw_headers);
     } else {
       // Terminate the previous line.
-      raw_headers.push_back('\n');
+      raw_headers.push_back('\0');
 
       // Copy the raw data to output.
-      raw_headers.append(line_begin, line_end);
+      AppendWithoutNulls(line_begin, line_end, &raw_headers);
 
       // Check if the current line can be continued.
       prev_line_continuable = IsLineSegmentContinuable(line_begin, line_end);
     }
+    line_begin = line_end;
   }
 
-  raw_headers.append("\n\n", 2);
-
-  // Use '\0' as the canonical line terminator. If the input already contained
-  // any embeded '\0' characters we will strip them first to avoid interpreting
-  // them as line breaks.
-  raw_headers.erase(std::remove(raw_headers.begin(), raw_headers.end(), '\0'),
-                    raw_headers.end());
-  std::replace(raw_headers.begin(), raw_headers.end(), '\n', '\0');
-
+  raw_headers.append(2, '\0');
   return raw_headers;
 }
 
@@ -279,6 +279,38 @@ TEST(HttpUtilTest, LocateEndOfHeaders) {
   }
 }
 
+// The terminator may fall anywhere in the input, including across the blocks
+// that are scanned at once.
+TEST(HttpUtilTest, LocateEndOfHeaders_AnyOffset) {
+  const char* const kTerminators[] = { "\n\n", "\n\r\n", "\r\n\r\n" };
+  for (size_t i = 0; i < arraysize(kTerminators); ++i) {
+    for (int offset = 0; offset < 48; ++offset) {
+      std::string input(offset, 'a');
+      input.append(kTerminators[i]);
+      int expected_result = static_cast<int>(input.size());
+      input.append(20, 'b');
+      EXPECT_EQ(expected_result,
+                HttpUtil::LocateEndOfHeaders(input.data(), input.size()))
+          << "terminator " << i << " at " << offset;
+    }
+  }
+}
+
+TEST(HttpUtilTest, LocateEndOfHeaders_NotFound) {
+  // Line breaks which do not end the headers, spread over several blocks.
+  std::string input =
+      "HTTP/1.1 200 OK\r\nFoo: 1\r\r\nBar: 2\n\r\r\nBaz: 3\r\n\r";
+  EXPECT_EQ(-1, HttpUtil::LocateEndOfHeaders(input.data(), input.size()));
+
+  // Bytes before the start of the search are not part of a terminator.
+  input = "HTTP/1.1 200 OK\r\nFoo: 1\r\n\nBar: 2\r\n";
+  int start = static_cast<int>(input.find("\r\n\n")) + 3;
+  EXPECT_EQ(-1,
+            HttpUtil::LocateEndOfHeaders(input.data(), input.size(), start));
+  EXPECT_EQ(start, HttpUtil::LocateEndOfHeaders(input.data(), input.size(),
+                                                start - 2));
+}
+
 TEST(HttpUtilTest, AssembleRawHeaders) {
   struct {
     const char* input;  // with '|' representing '\0'
@@ -581,6 +613,19 @@ TEST(HttpUtilTest, AssembleRawHeaders) {
       "HTTP/1.0 200 OK\nFoo: 1|Foo2: 3\nBar: 2\n\n",
       "HTTP/1.0 200 OK|Foo: 1Foo2: 3|Bar: 2||"
     },
+
+    // Line breaks and NULLs past the first 16 bytes of long lines.
+    {
+      "HTTP/1.1 200 OK with a long reason phrase|\r\n"
+      "Content-Type: text/html; charset=utf-8\r"
+      "Set-Cookie: name=value; path=/; domain=.example.com|\r\n"
+      "\t   and a long continuation of the cookie line\r\n\r\n",
+
+      "HTTP/1.1 200 OK with a long reason phrase|"
+      "Content-Type: text/html; charset=utf-8|"
+      "Set-Cookie: name=value; path=/; domain=.example.com"
+      " and a long continuation of the cookie line||"
+    },
   };
   for (size_t i = 0; i < arraysize(tests); ++i) {
     std::string input = tests[i].input;
@@ -19,6 +19,8 @@
 
 #include "base/base64.h"
 #include "base/build_time.h"
+#include "base/containers/mru_cache.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/metrics/histogram.h"
@@ -81,10 +83,83 @@ bool AddHash(const char* sha1_hash,
   return true;
 }
 
+// The number of hosts each map of a LookupCache holds.
+const size_t kLookupCacheSize = 512;
+
 }  // namespace
 
+// PreloadResult is the result of resolving a specific name in the preloaded
+// data.
+struct PreloadResult {
+  uint32 pinset_id;
+  uint32 domain_id;
+  // hostname_offset contains the number of bytes from the start of the given
+  // hostname where the name of the matching entry starts.
+  size_t hostname_offset;
+  bool sts_include_subdomains;
+  bool pkp_include_subdomains;
+  bool force_https;
+  bool has_pins;
+};
+
+// LookupCache saves decoding the preloaded data, and hashing every label of
+// the host, for the hosts that are looked up over and over. Both maps are
+// bounded, and evict their least recently used hosts.
+class TransportSecurityState::LookupCache {
+ public:
+  // The result of decoding the preloaded data for a host. |result| is only
+  // valid if |found| is true.
+  struct StaticEntry {
+    bool found;
+    PreloadResult result;
+  };
+
+  LookupCache()
+      : static_entries_(kLookupCacheSize),
+        hosts_without_dynamic_state_(kLookupCacheSize) {}
+
+  // Returns the saved result of decoding the preloaded data for |host|, or
+  // NULL if there is none.
+  const StaticEntry* GetStaticEntry(const std::string& host) {
+    StaticEntryMap::iterator it = static_entries_.Get(host);
+    return it == static_entries_.end() ? NULL : &it->second;
+  }
+
+  const StaticEntry* PutStaticEntry(const std::string& host,
+                                    const StaticEntry& entry) {
+    return &static_entries_.Put(host, entry)->second;
+  }
+
+  // Returns true if no label of |host| was found in |enabled_hosts_| since
+  // the last call to ClearDynamicHosts().
+  bool HasNoDynamicState(const std::string& host) {
+    return hosts_without_dynamic_state_.Get(host) !=
+           hosts_without_dynamic_state_.end();
+  }
+
+  void PutHostWithoutDynamicState(const std::string& host) {
+    hosts_without_dynamic_state_.Put(host, true);
+  }
+
+  // Must be called whenever an entry is added to |enabled_hosts_|. Removing
+  // entries can't give state to a host that had none, so the hosts are kept
+  // then.
+  void ClearDynamicHosts() { hosts_without_dynamic_state_.Clear(); }
+
+ private:
+  typedef base::HashingMRUCache<std::string, StaticEntry> StaticEntryMap;
+
+  // The preloaded data never changes, so entries are only ever evicted.
+  StaticEntryMap static_entries_;
+  base::HashingMRUCache<std::string, bool> hosts_without_dynamic_state_;
+
+  DISALLOW_COPY_AND_ASSIGN(LookupCache);
+};
+
 TransportSecurityState::TransportSecurityState()
-    : delegate_(NULL), enable_static_pins_(true) {
+    : delegate_(NULL),
+      enable_static_pins_(true),
+      lookup_cache_(new LookupCache) {
 // Static pinning is only enabled for official builds to make sure that
 // others don't end up with pins that cannot be easily updated.
 #if !defined(OFFICIAL_BUILD) || defined(OS_ANDROID) || defined(OS_IOS)
@@ -180,6 +255,7 @@ void TransportSecurityState::EnableHost(const std::string& host,
   state_copy.domain.clear();
 
   enabled_hosts_[HashHost(canonicalized_host)] = state_copy;
+  lookup_cache_->ClearDynamicHosts();
   DirtyNotify();
 }
 
@@ -277,25 +353,45 @@ class BitReader {
       : bytes_(bytes),
         num_bits_(num_bits),
         num_bytes_((num_bits + 7) / 8),
-        current_byte_index_(0),
-        num_bits_used_(8) {}
+        current_bit_(0) {}
 
   // Next sets |*out| to the next bit from the input. It returns false if no
   // more bits are available or true otherwise.
   bool Next(bool* out) {
-    if (num_bits_used_ == 8) {
-      if (current_byte_index_ >= num_bytes_) {
-        return false;
-      }
-      current_byte_ = bytes_[current_byte_index_++];
-      num_bits_used_ = 0;
+    if (current_bit_ >= num_bytes_ * 8) {
+      return false;
     }
 
-    *out = 1 & (current_byte_ >> (7 - num_bits_used_));
-    num_bits_used_++;
+    *out = 1 & (bytes_[current_bit_ / 8] >> (7 - current_bit_ % 8));
+    current_bit_++;
     return true;
   }
 
+  // Peek sets |*out| to the next eight bits from the input, without consuming
+  // them, and returns how many of those bits are available. The bits past the
+  // end of the input are zero.
+  unsigned Peek(uint8* out) const {
+    const size_t end = num_bytes_ * 8;
+    if (current_bit_ >= end) {
+      *out = 0;
+      return 0;
+    }
+
+    const size_t index = current_bit_ / 8;
+    uint32 bits = static_cast<uint32>(bytes_[index]) << 8;
+    if (index + 1 < num_bytes_)
+      bits |= bytes_[index + 1];
+    *out = static_cast<uint8>(bits >> (8 - current_bit_ % 8));
+    return static_cast<unsigned>(std::min<size_t>(8, end - current_bit_));
+  }
+
+  // Skip consumes the next |num_bits| bits, which Peek must have reported as
+  // available.
+  void Skip(unsigned num_bits) {
+    DCHECK_LE(current_bit_ + num_bits, num_bytes_ * 8);
+    current_bit_ += num_bits;
+  }
+
   // Read sets the |num_bits| least-significant bits of |*out| to the value of
   // the next |num_bits| bits from the input. It returns false if there are
   // insufficient bits in the input or true otherwise.
@@ -303,12 +399,15 @@ class BitReader {
     DCHECK_LE(num_bits, 32u);
 
     uint32 ret = 0;
-    for (unsigned i = 0; i < num_bits; ++i) {
-      bool bit;
-      if (!Next(&bit)) {
+    while (num_bits > 0) {
+      const unsigned chunk = std::min(num_bits, 8u);
+      uint8 bits;
+      if (Peek(&bits) < chunk) {
         return false;
       }
-      ret |= static_cast<uint32>(bit) << (num_bits - 1 - i);
+      ret = (ret << chunk) | (bits >> (8 - chunk));
+      Skip(chunk);
+      num_bits -= chunk;
     }
 
     *out = ret;
@@ -322,14 +421,23 @@ class BitReader {
     size_t ret = 0;
 
     for (;;) {
-      bool bit;
-      if (!Next(&bit)) {
-        return false;
+      uint8 bits;
+      const unsigned available = Peek(&bits);
+      unsigned ones = 0;
+      while (ones < available && (bits & (0x80 >> ones))) {
+        ones++;
       }
-      if (!bit) {
+      if (ones < available) {
+        // Also consume the terminating zero.
+        Skip(ones + 1);
+        ret += ones;
         break;
       }
-      ret++;
+      if (available == 0) {
+        return false;
+      }
+      Skip(ones);
+      ret += ones;
     }
 
     *out = ret;
@@ -343,9 +451,7 @@ class BitReader {
     if (offset >= num_bits_) {
       return false;
     }
-    current_byte_index_ = offset / 8;
-    current_byte_ = bytes_[current_byte_index_++];
-    num_bits_used_ = offset % 8;
+    current_bit_ = offset;
     return true;
   }
 
@@ -353,13 +459,8 @@ class BitReader {
   const uint8* const bytes_;
   const size_t num_bits_;
   const size_t num_bytes_;
-  // current_byte_index_ contains the current byte offset in |bytes_|.
-  size_t current_byte_index_;
-  // current_byte_ contains the current byte of the input.
-  uint8 current_byte_;
-  // num_bits_used_ contains the number of bits of |current_byte_| that have
-  // been read.
-  unsigned num_bits_used_;
+  // current_bit_ contains the offset, in bits, of the next bit of |bytes_|.
+  size_t current_bit_;
 };
 
 // HuffmanDecoder is a very simple Huffman reader. The input Huffman tree is
@@ -368,15 +469,37 @@ class BitReader {
 // either has the MSB set, in which case the bottom 7 bits are the value for
 // that position, or else the bottom seven bits contain the index of a node.
 //
-// The tree is decoded by walking rather than a table-driven approach.
+// Rather than walking the tree bit by bit, the decoder looks the next eight
+// bits of the input up in a table built from the tree, which decodes any code
+// of up to eight bits at once. Longer codes are finished by walking the tree
+// from the node the table gives.
 class HuffmanDecoder {
  public:
   HuffmanDecoder(const uint8* tree, size_t tree_bytes)
       : tree_(tree),
-        tree_bytes_(tree_bytes) {}
+        tree_bytes_(tree_bytes) {
+    for (size_t i = 0; i < arraysize(table_); ++i)
+      table_[i] = BuildTableEntry(static_cast<uint8>(i));
+  }
 
-  bool Decode(BitReader* reader, char* out) {
-    const uint8* current = &tree_[tree_bytes_-2];
+  bool Decode(BitReader* reader, char* out) const {
+    uint8 bits;
+    const unsigned available = reader->Peek(&bits);
+    const TableEntry& entry = table_[bits];
+    if (entry.length > 0) {
+      if (entry.length > available) {
+        return false;
+      }
+      reader->Skip(entry.length);
+      *out = static_cast<char>(entry.value);
+      return true;
+    }
+
+    if (entry.node == kInvalidNode || available < 8) {
+      return false;
+    }
+    reader->Skip(8);
+    const uint8* current = &tree_[entry.node];
 
     for (;;) {
       bool bit;
@@ -401,26 +524,66 @@ class HuffmanDecoder {
   }
 
  private:
+  // TableEntry describes the code that a value of the next eight bits of the
+  // input starts with.
+  struct TableEntry {
+    // length is the number of bits of the code, or zero if the code is longer
+    // than eight bits.
+    uint8 length;
+    // value is the decoded value if |length| is not zero.
+    uint8 value;
+    // node is the offset in |tree_| of the node reached after eight bits if
+    // |length| is zero, or kInvalidNode if the tree is malformed.
+    uint16 node;
+  };
+
+  static const uint16 kInvalidNode = 0xffff;
+
+  TableEntry BuildTableEntry(uint8 bits) const {
+    TableEntry entry = {0, 0, kInvalidNode};
+    size_t offset = tree_bytes_ - 2;
+
+    for (unsigned i = 0; i < 8; ++i) {
+      const uint8 b = tree_[offset + (1 & (bits >> (7 - i)))];
+      if (b & 0x80) {
+        entry.length = static_cast<uint8>(i + 1);
+        entry.value = b & 0x7f;
+        return entry;
+      }
+
+      offset = static_cast<size_t>(b) * 2;
+      if (offset >= tree_bytes_) {
+        return entry;
+      }
+    }
+
+    entry.node = static_cast<uint16>(offset);
+    return entry;
+  }
+
   const uint8* const tree_;
   const size_t tree_bytes_;
+  TableEntry table_[256];
 };
 
 #include "net/http/transport_security_state_static.h"
 
-// PreloadResult is the result of resolving a specific name in the preloaded
-// data.
-struct PreloadResult {
-  uint32 pinset_id;
-  uint32 domain_id;
-  // hostname_offset contains the number of bytes from the start of the given
-  // hostname where the name of the matching entry starts.
-  size_t hostname_offset;
-  bool sts_include_subdomains;
-  bool pkp_include_subdomains;
-  bool force_https;
-  bool has_pins;
+namespace {
+
+// PreloadHuffmanDecoder decodes the characters of the preloaded data.
+class PreloadHuffmanDecoder : public HuffmanDecoder {
+ public:
+  PreloadHuffmanDecoder()
+      : HuffmanDecoder(kHSTSHuffmanTree, sizeof(kHSTSHuffmanTree)) {}
 };
 
+// The table of the decoder is built on the first lookup, and shared by every
+// TransportSecurityState.
+base::LazyInstance<PreloadHuffmanDecoder>::Leaky g_preload_huffman_decoder =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
 // DecodeHSTSPreloadRaw resolves |hostname| in the preloaded data. It returns
 // false on internal error and true otherwise. After a successful return,
 // |*out_found| is true iff a relevant entry has been found. If so, |*out|
@@ -449,7 +612,7 @@ struct PreloadResult {
 bool DecodeHSTSPreloadRaw(const std::string& hostname,
                           bool* out_found,
                           PreloadResult* out) {
-  HuffmanDecoder huffman(kHSTSHuffmanTree, sizeof(kHSTSHuffmanTree));
+  const HuffmanDecoder& huffman = g_preload_huffman_decoder.Get();
   BitReader reader(kPreloadedHSTSData, kPreloadedHSTSBits);
   size_t bit_offset = kHSTSRootPosition;
   static const char kEndOfString = 0;
@@ -771,9 +934,15 @@ bool TransportSecurityState::GetStaticDomainState(const std::string& host,
   if (!IsBuildTimely())
     return false;
 
-  PreloadResult result;
-  if (!DecodeHSTSPreload(host, &result))
+  const LookupCache::StaticEntry* cached = lookup_cache_->GetStaticEntry(host);
+  if (!cached) {
+    LookupCache::StaticEntry entry;
+    entry.found = DecodeHSTSPreload(host, &entry.result);
+    cached = lookup_cache_->PutStaticEntry(host, entry);
+  }
+  if (!cached->found)
     return false;
+  const PreloadResult& result = cached->result;
 
   out->domain = host.substr(result.hostname_offset);
   out->sts.include_subdomains = result.sts_include_subdomains;
@@ -816,6 +985,9 @@ bool TransportSecurityState::GetDynamicDomainState(const std::string& host,
                                                    DomainState* result) {
   DCHECK(CalledOnValidThread());
 
+  if (lookup_cache_->HasNoDynamicState(host))
+    return false;
+
   DomainState state;
   const std::string canonicalized_host = CanonicalizeHost(host);
   if (canonicalized_host.empty())
@@ -852,6 +1024,7 @@ bool TransportSecurityState::GetDynamicDomainState(const std::string& host,
     return false;
   }
 
+  lookup_cache_->PutHostWithoutDynamicState(host);
   return false;
 }
 
@@ -859,6 +1032,7 @@ void TransportSecurityState::AddOrUpdateEnabledHosts(
     const std::string& hashed_host, const DomainState& state) {
   DCHECK(CalledOnValidThread());
   enabled_hosts_[hashed_host] = state;
+  lookup_cache_->ClearDynamicHosts();
 }
 
 TransportSecurityState::DomainState::DomainState() {
@@ -11,7 +11,9 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
 #include "base/gtest_prod_util.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/threading/non_thread_safe.h"
 #include "base/time/time.h"
 #include "net/base/net_export.h"
@@ -141,6 +143,12 @@ class NET_EXPORT TransportSecurityState
     std::string domain;
   };
 
+ private:
+  // The dynamic DomainStates, by HashHost(CanonicalizeHost(host)). Iteration
+  // order is unspecified.
+  typedef base::hash_map<std::string, DomainState> DomainStateMap;
+
+ public:
   class NET_EXPORT Iterator {
    public:
     explicit Iterator(const TransportSecurityState& state);
@@ -152,8 +160,8 @@ class NET_EXPORT TransportSecurityState
     const DomainState& domain_state() const { return iterator_->second; }
 
    private:
-    std::map<std::string, DomainState>::const_iterator iterator_;
-    std::map<std::string, DomainState>::const_iterator end_;
+    DomainStateMap::const_iterator iterator_;
+    DomainStateMap::const_iterator end_;
   };
 
   // These functions search for static and dynamic DomainStates, and invoke the
@@ -264,7 +272,7 @@ class NET_EXPORT TransportSecurityState
   FRIEND_TEST_ALL_PREFIXES(HttpSecurityHeadersTest, UpdateDynamicPKPMaxAge0);
   FRIEND_TEST_ALL_PREFIXES(HttpSecurityHeadersTest, NoClobberPins);
 
-  typedef std::map<std::string, DomainState> DomainStateMap;
+  class LookupCache;
 
   // Send an UMA report on pin validation failure, if the host is in a
   // statically-defined list of domains.
@@ -309,6 +317,10 @@ class NET_EXPORT TransportSecurityState
   // True if static pins should be used.
   bool enable_static_pins_;
 
+  // Remembers the results of recent lookups of the preloaded data, and the
+  // hosts recently found to have no dynamic state.
+  scoped_ptr<LookupCache> lookup_cache_;
+
   DISALLOW_COPY_AND_ASSIGN(TransportSecurityState);
 };
 
@@ -0,0 +1,111 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/test/perf_time_logger.h"
+#include "base/time/time.h"
+#include "net/http/transport_security_state.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// The number of distinct hosts looked up, and of hosts with dynamic state.
+const size_t kNumHosts = 20000;
+const size_t kNumDynamicHosts = 2000;
+
+// The number of hosts most requests go to.
+const size_t kNumHotHosts = 200;
+
+const int kIterations = 10;
+
+// Preloaded domains, which are looked up with and without subdomains.
+const char* const kPreloadedHosts[] = {
+  "paypal.com",
+  "www.paypal.com",
+  "mail.google.com",
+  "chrome.google.com",
+  "market.android.com",
+  "accounts.google.com",
+  "twitter.com",
+  "www.dropbox.com",
+  "lastpass.com",
+  "www.torproject.org",
+};
+
+// Returns the |i|th host of the list, which mixes preloaded domains,
+// subdomains of them, and hosts that are not preloaded.
+std::string MakeHost(size_t i) {
+  const std::string index = base::SizeTToString(i);
+  switch (i % 4) {
+    case 0:
+      return kPreloadedHosts[(i / 4) % arraysize(kPreloadedHosts)];
+    case 1:
+      return "static" + index + "." +
+             kPreloadedHosts[(i / 4) % arraysize(kPreloadedHosts)];
+    case 2:
+      return "www.site" + index + ".example.com";
+    default:
+      return "cdn" + index + ".images.example.net";
+  }
+}
+
+class TransportSecurityStatePerfTest : public testing::Test {
+ public:
+  void SetUp() override {
+    const base::Time expiry =
+        base::Time::Now() + base::TimeDelta::FromDays(365);
+    for (size_t i = 0; i < kNumDynamicHosts; ++i)
+      state_.AddHSTS("dynamic" + base::SizeTToString(i) + ".example.org",
+                     expiry, i % 2 == 0);
+  }
+
+ protected:
+  // Looks up each of |hosts| as a request to it would, |kIterations| times.
+  void LookUpHosts(const std::vector<std::string>& hosts, const char* name) {
+    size_t upgraded = 0;
+    base::PerfTimeLogger timer(name);
+    for (int i = 0; i < kIterations; ++i) {
+      for (size_t j = 0; j < hosts.size(); ++j) {
+        if (state_.ShouldUpgradeToSSL(hosts[j]))
+          upgraded++;
+        state_.HasPublicKeyPins(hosts[j]);
+      }
+    }
+    timer.Done();
+    EXPECT_LT(0u, upgraded);
+  }
+
+  TransportSecurityState state_;
+};
+
+}  // namespace
+
+// Every host is looked up once per iteration, so no result is cached.
+TEST_F(TransportSecurityStatePerfTest, DistinctHosts) {
+  std::vector<std::string> hosts;
+  for (size_t i = 0; i < kNumHosts; ++i)
+    hosts.push_back(MakeHost(i));
+  LookUpHosts(hosts, "TransportSecurityState distinct hosts");
+}
+
+// Most lookups are of a few hosts, as when pages load many resources from the
+// same origins.
+TEST_F(TransportSecurityStatePerfTest, HotHosts) {
+  std::vector<std::string> hosts;
+  for (size_t i = 0; i < kNumHosts; ++i) {
+    if (i % 10 == 0)
+      hosts.push_back(MakeHost(i));
+    else
+      hosts.push_back(MakeHost(i % kNumHotHosts));
+  }
+  LookUpHosts(hosts, "TransportSecurityState hot hosts");
+}
+
+}  // namespace net
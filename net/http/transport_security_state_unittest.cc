@@ -193,6 +193,59 @@ TEST_F(TransportSecurityStateTest, DeleteDynamicDataForHost) {
   EXPECT_FALSE(state.GetDynamicDomainState("yahoo.com", &domain_state));
 }
 
+// Checks that hosts found to have no dynamic state are looked up again once
+// an entry is added for one of their parent domains.
+TEST_F(TransportSecurityStateTest, RepeatedDynamicLookups) {
+  TransportSecurityState state;
+  TransportSecurityState::DomainState domain_state;
+  const base::Time current_time(base::Time::Now());
+  const base::Time expiry = current_time + base::TimeDelta::FromSeconds(1000);
+
+  EXPECT_FALSE(state.GetDynamicDomainState("foo.yahoo.com", &domain_state));
+  EXPECT_FALSE(state.GetDynamicDomainState("foo.yahoo.com", &domain_state));
+  state.AddHSTS("yahoo.com", expiry, true);
+  EXPECT_TRUE(state.GetDynamicDomainState("foo.yahoo.com", &domain_state));
+  EXPECT_EQ("yahoo.com", domain_state.domain);
+
+  EXPECT_FALSE(state.GetDynamicDomainState("example.com", &domain_state));
+  state.AddOrUpdateEnabledHosts(
+      crypto::SHA256HashString(std::string("\007example\003com", 13)),
+      domain_state);
+  EXPECT_TRUE(state.GetDynamicDomainState("example.com", &domain_state));
+
+  EXPECT_TRUE(state.DeleteDynamicDataForHost("yahoo.com"));
+  EXPECT_FALSE(state.GetDynamicDomainState("foo.yahoo.com", &domain_state));
+}
+
+// Checks that repeated lookups of the preloaded data, which are served from a
+// cache, give the same results as the first ones.
+TEST_F(TransportSecurityStateTest, RepeatedStaticLookups) {
+  TransportSecurityState state;
+  TransportSecurityState::DomainState domain_state;
+
+  for (int i = 0; i < 2; ++i) {
+    EnableStaticPins(&state);
+    EXPECT_TRUE(GetStaticDomainState(&state, "www.paypal.com", &domain_state));
+    EXPECT_EQ("www.paypal.com", domain_state.domain);
+    EXPECT_FALSE(domain_state.sts.include_subdomains);
+    EXPECT_FALSE(GetStaticDomainState(&state, "a.www.paypal.com",
+                                      &domain_state));
+    EXPECT_TRUE(GetStaticDomainState(&state, "sub.market.android.com",
+                                     &domain_state));
+    EXPECT_EQ("market.android.com", domain_state.domain);
+    EXPECT_TRUE(GetStaticDomainState(&state, "chrome.google.com",
+                                     &domain_state));
+    EXPECT_FALSE(domain_state.pkp.spki_hashes.empty());
+
+    // The cached results don't depend on whether static pins are enabled.
+    DisableStaticPins(&state);
+    TransportSecurityState::DomainState unpinned_state;
+    EXPECT_TRUE(GetStaticDomainState(&state, "chrome.google.com",
+                                     &unpinned_state));
+    EXPECT_TRUE(unpinned_state.pkp.spki_hashes.empty());
+  }
+}
+
 TEST_F(TransportSecurityStateTest, EnableStaticPins) {
   TransportSecurityState state;
   TransportSecurityState::DomainState domain_state;
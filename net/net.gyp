@@ -815,9 +815,16 @@
         'net_test_support',
       ],
       'sources': [
+        'cert/crl_set_perftest.cc',
         'cookies/cookie_monster_perftest.cc',
         'disk_cache/blockfile/disk_cache_perftest.cc',
+        'disk_cache/blockfile/disk_cache_v3_perftest.cc',
+        'http/http_cache_perftest.cc',
+        'http/http_response_headers_perftest.cc',
+        'http/http_stream_parser_perftest.cc',
+        'http/transport_security_state_perftest.cc',
         'proxy/proxy_resolver_perftest.cc',
+        'socket/client_socket_pool_base_perftest.cc',
         'websockets/websocket_frame_perftest.cc',
       ],
       'conditions': [
@@ -894,6 +901,8 @@
         'disk_cache/disk_cache_test_base.h',
         'disk_cache/disk_cache_test_util.cc',
         'disk_cache/disk_cache_test_util.h',
+        'disk_cache/tracing/cache_trace_replayer.cc',
+        'disk_cache/tracing/cache_trace_replayer.h',
         'dns/dns_test_util.cc',
         'dns/dns_test_util.h',
         'dns/mock_host_resolver.cc',
@@ -1331,6 +1340,18 @@
           # TODO(jschuh): crbug.com/167187 fix size_t to int truncations.
           'msvs_disabled_warnings': [4267, ],
         },
+        {
+          'target_name': 'disk_cache_trace_replay',
+          'type': 'executable',
+          'dependencies': [
+            '../base/base.gyp:base',
+            'net',
+            'net_test_support',
+          ],
+          'sources': [
+            'tools/disk_cache_trace_replay/disk_cache_trace_replay.cc',
+          ],
+        },
         {
           'target_name': 'tld_cleanup',
           'type': 'executable',
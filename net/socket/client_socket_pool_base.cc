@@ -31,7 +31,8 @@ bool g_cleanup_timer_enabled = true;
 //
 // Note: It's important to close idle sockets that have received data as soon
 // as possible because the received data may cause BSOD on Windows XP under
-// some conditions.  See http://crbug.com/4606.
+// some conditions.  See http://crbug.com/4606.  That is why the timer still
+// checks every idle socket on Windows, rather than only the timed out ones.
 const int kCleanupInterval = 10;  // DO NOT INCREASE THIS TIMEOUT.
 
 // Indicate whether or not we should establish a new transport layer connection
@@ -178,6 +179,9 @@ ClientSocketPoolBaseHelper::~ClientSocketPoolBaseHelper() {
   // cleaned up prior to |this| being destroyed.
   FlushWithError(ERR_ABORTED);
   DCHECK(group_map_.empty());
+  DCHECK(pending_groups_.empty());
+  DCHECK(unused_idle_sockets_.empty());
+  DCHECK(used_idle_sockets_.empty());
   DCHECK(pending_callback_map_.empty());
   DCHECK_EQ(0, connecting_socket_count_);
   CHECK(higher_pools_.empty());
@@ -224,12 +228,7 @@ bool ClientSocketPoolBaseHelper::IsStalled() const {
   // |max_sockets_per_group_|.  (If the number of sockets is equal to
   // |max_sockets_per_group_|, then the request is stalled on the group limit,
   // which does not count.)
-  for (GroupMap::const_iterator it = group_map_.begin();
-       it != group_map_.end(); ++it) {
-    if (it->second->IsStalledOnPoolMaxSockets(max_sockets_per_group_))
-      return true;
-  }
-  return false;
+  return FindTopStalledGroup(NULL, NULL);
 }
 
 void ClientSocketPoolBaseHelper::AddLowerLayeredPool(
@@ -262,7 +261,7 @@ int ClientSocketPoolBaseHelper::RequestSocket(
 
   // Cleanup any timed-out idle sockets if no timer is used.
   if (!use_cleanup_timer_)
-    CleanupIdleSockets(false);
+    CleanupTimedOutIdleSockets();
 
   request->net_log().BeginEvent(NetLog::TYPE_SOCKET_POOL);
   Group* group = GetOrCreateGroup(group_name);
@@ -274,6 +273,7 @@ int ClientSocketPoolBaseHelper::RequestSocket(
     request.reset();
   } else {
     group->InsertPendingRequest(request.Pass());
+    UpdatePendingGroup(group);
     // Have to do this asynchronously, as closing sockets in higher level pools
     // call back in to |this|, which will cause all sorts of fun and exciting
     // re-entrancy issues if the socket pool is doing something else at the
@@ -298,7 +298,7 @@ void ClientSocketPoolBaseHelper::RequestSockets(
 
   // Cleanup any timed out idle sockets if no timer is used.
   if (!use_cleanup_timer_)
-    CleanupIdleSockets(false);
+    CleanupTimedOutIdleSockets();
 
   if (num_sockets > max_sockets_per_group_) {
     num_sockets = max_sockets_per_group_;
@@ -449,9 +449,8 @@ bool ClientSocketPoolBaseHelper::AssignIdleSocketToRequest(
   for (std::list<IdleSocket>::iterator it = idle_sockets->begin();
        it != idle_sockets->end();) {
     if (!it->IsUsable()) {
-      DecrementIdleCount();
       delete it->socket;
-      it = idle_sockets->erase(it);
+      it = RemoveIdleSocket(group, it);
       continue;
     }
 
@@ -470,11 +469,10 @@ bool ClientSocketPoolBaseHelper::AssignIdleSocketToRequest(
     idle_socket_it = idle_sockets->begin();
 
   if (idle_socket_it != idle_sockets->end()) {
-    DecrementIdleCount();
     base::TimeDelta idle_time =
         base::TimeTicks::Now() - idle_socket_it->start_time;
     IdleSocket idle_socket = *idle_socket_it;
-    idle_sockets->erase(idle_socket_it);
+    RemoveIdleSocket(group, idle_socket_it);
     // TODO(davidben): If |idle_time| is under some low watermark, consider
     // treating as UNUSED rather than UNUSED_IDLE. This will avoid
     // HttpNetworkTransaction retrying on some errors.
@@ -526,6 +524,7 @@ void ClientSocketPoolBaseHelper::CancelRequest(
   scoped_ptr<const Request> request =
       group->FindAndRemovePendingRequest(handle);
   if (request) {
+    UpdatePendingGroup(group);
     request->net_log().AddEvent(NetLog::TYPE_CANCELLED);
     request->net_log().EndEvent(NetLog::TYPE_SOCKET_POOL);
 
@@ -682,8 +681,7 @@ void ClientSocketPoolBaseHelper::CleanupIdleSockets(bool force) {
           used_idle_socket_timeout_ : unused_idle_socket_timeout_;
       if (force || j->ShouldCleanup(now, timeout)) {
         delete j->socket;
-        j = group->mutable_idle_sockets()->erase(j);
-        DecrementIdleCount();
+        j = RemoveIdleSocket(group, j);
       } else {
         ++j;
       }
@@ -698,12 +696,61 @@ void ClientSocketPoolBaseHelper::CleanupIdleSockets(bool force) {
   }
 }
 
+void ClientSocketPoolBaseHelper::CleanupTimedOutIdleSockets() {
+  if (idle_socket_count_ == 0)
+    return;
+
+  base::TimeTicks now = base::TimeTicks::Now();
+  CleanupTimedOutIdleSocketsInQueue(&unused_idle_sockets_,
+                                    unused_idle_socket_timeout_, now);
+  CleanupTimedOutIdleSocketsInQueue(&used_idle_sockets_,
+                                    used_idle_socket_timeout_, now);
+}
+
+void ClientSocketPoolBaseHelper::CleanupTimedOutIdleSocketsInQueue(
+    IdleSocketQueue* queue,
+    base::TimeDelta timeout,
+    base::TimeTicks now) {
+  while (!queue->empty() && now - queue->front().start_time >= timeout) {
+    Group* group = queue->front().group;
+    StreamSocket* socket = queue->front().socket;
+
+    // Groups hold few idle sockets, so finding this one is cheap.
+    std::list<IdleSocket>::iterator it =
+        group->mutable_idle_sockets()->begin();
+    while (it->socket != socket)
+      ++it;
+    delete it->socket;
+    RemoveIdleSocket(group, it);
+
+    if (group->IsEmpty())
+      RemoveGroup(group->group_name());
+  }
+}
+
+void ClientSocketPoolBaseHelper::OnCleanupTimerFired() {
+#if defined(OS_WIN)
+  CleanupIdleSockets(false);
+#else
+  CleanupTimedOutIdleSockets();
+#endif
+}
+
+std::list<ClientSocketPoolBaseHelper::IdleSocket>::iterator
+ClientSocketPoolBaseHelper::RemoveIdleSocket(
+    Group* group,
+    std::list<IdleSocket>::iterator it) {
+  it->queue->erase(it->queue_it);
+  DecrementIdleCount();
+  return group->mutable_idle_sockets()->erase(it);
+}
+
 ClientSocketPoolBaseHelper::Group* ClientSocketPoolBaseHelper::GetOrCreateGroup(
     const std::string& group_name) {
   GroupMap::iterator it = group_map_.find(group_name);
   if (it != group_map_.end())
     return it->second;
-  Group* group = new Group;
+  Group* group = new Group(group_name);
   group_map_[group_name] = group;
   return group;
 }
@@ -716,8 +763,30 @@ void ClientSocketPoolBaseHelper::RemoveGroup(const std::string& group_name) {
 }
 
 void ClientSocketPoolBaseHelper::RemoveGroup(GroupMap::iterator it) {
-  delete it->second;
+  Group* group = it->second;
+  if (group->in_pending_groups())
+    pending_groups_.erase(group);
   group_map_.erase(it);
+  delete group;
+}
+
+void ClientSocketPoolBaseHelper::UpdatePendingGroup(Group* group) {
+  if (group->in_pending_groups()) {
+    pending_groups_.erase(group);
+    group->set_pending_groups_priority(false, IDLE);
+  }
+  if (group->has_pending_requests()) {
+    group->set_pending_groups_priority(true, group->TopPendingPriority());
+    pending_groups_.insert(group);
+  }
+}
+
+bool ClientSocketPoolBaseHelper::PendingGroupOrder::operator()(
+    const Group* a,
+    const Group* b) const {
+  if (a->pending_groups_priority() != b->pending_groups_priority())
+    return a->pending_groups_priority() > b->pending_groups_priority();
+  return a->group_name() < b->group_name();
 }
 
 // static
@@ -826,41 +895,26 @@ void ClientSocketPoolBaseHelper::CheckForStalledSocketGroups() {
 
 // Search for the highest priority pending request, amongst the groups that
 // are not at the |max_sockets_per_group_| limit. Note: for requests with
-// the same priority, the winner is based on group hash ordering (and not
+// the same priority, the winner is the group whose name sorts first (and not
 // insertion order).
 bool ClientSocketPoolBaseHelper::FindTopStalledGroup(
     Group** group,
     std::string* group_name) const {
   CHECK((group && group_name) || (!group && !group_name));
-  Group* top_group = NULL;
-  const std::string* top_group_name = NULL;
-  bool has_stalled_group = false;
-  for (GroupMap::const_iterator i = group_map_.begin();
-       i != group_map_.end(); ++i) {
-    Group* curr_group = i->second;
-    if (!curr_group->has_pending_requests())
-      continue;
+  // |pending_groups_| is sorted by priority, so the first stalled group wins.
+  for (PendingGroupSet::const_iterator it = pending_groups_.begin();
+       it != pending_groups_.end(); ++it) {
+    Group* curr_group = *it;
+    DCHECK(curr_group->has_pending_requests());
     if (curr_group->IsStalledOnPoolMaxSockets(max_sockets_per_group_)) {
-      if (!group)
-        return true;
-      has_stalled_group = true;
-      bool has_higher_priority = !top_group ||
-          curr_group->TopPendingPriority() > top_group->TopPendingPriority();
-      if (has_higher_priority) {
-        top_group = curr_group;
-        top_group_name = &i->first;
+      if (group) {
+        *group = curr_group;
+        *group_name = curr_group->group_name();
       }
+      return true;
     }
   }
-
-  if (top_group) {
-    CHECK(group);
-    *group = top_group;
-    *group_name = *top_group_name;
-  } else {
-    CHECK(!has_stalled_group);
-  }
-  return has_stalled_group;
+  return false;
 }
 
 void ClientSocketPoolBaseHelper::OnConnectJobComplete(
@@ -885,6 +939,7 @@ void ClientSocketPoolBaseHelper::OnConnectJobComplete(
     DCHECK(socket.get());
     RemoveConnectJob(job, group);
     scoped_ptr<const Request> request = group->PopNextPendingRequest();
+    UpdatePendingGroup(group);
     if (request) {
       LogBoundConnectJobToRequest(job_log.source(), *request);
       HandOutSocket(
@@ -902,6 +957,7 @@ void ClientSocketPoolBaseHelper::OnConnectJobComplete(
     // up so that the caller can retrieve it.
     bool handed_out_socket = false;
     scoped_ptr<const Request> request = group->PopNextPendingRequest();
+    UpdatePendingGroup(group);
     if (request) {
       LogBoundConnectJobToRequest(job_log.source(), *request);
       job->GetAdditionalErrorState(request->handle());
@@ -963,6 +1019,7 @@ void ClientSocketPoolBaseHelper::ProcessPendingRequest(
   if (rv != ERR_IO_PENDING) {
     scoped_ptr<const Request> request = group->PopNextPendingRequest();
     DCHECK(request);
+    UpdatePendingGroup(group);
     if (group->IsEmpty())
       RemoveGroup(group_name);
 
@@ -1009,6 +1066,15 @@ void ClientSocketPoolBaseHelper::AddIdleSocket(
   idle_socket.socket = socket.release();
   idle_socket.start_time = base::TimeTicks::Now();
 
+  IdleSocketQueueEntry entry;
+  entry.group = group;
+  entry.socket = idle_socket.socket;
+  entry.start_time = idle_socket.start_time;
+  idle_socket.queue = idle_socket.socket->WasEverUsed() ?
+      &used_idle_sockets_ : &unused_idle_sockets_;
+  idle_socket.queue_it =
+      idle_socket.queue->insert(idle_socket.queue->end(), entry);
+
   group->mutable_idle_sockets()->push_back(idle_socket);
   IncrementIdleCount();
 }
@@ -1042,6 +1108,7 @@ void ClientSocketPoolBaseHelper::CancelAllRequestsWithError(int error) {
         break;
       InvokeUserCallbackLater(request->handle(), request->callback(), error);
     }
+    UpdatePendingGroup(group);
 
     // Delete group if no longer needed.
     if (group->IsEmpty()) {
@@ -1076,24 +1143,41 @@ bool ClientSocketPoolBaseHelper::CloseOneIdleSocketExceptInGroup(
     const Group* exception_group) {
   CHECK_GT(idle_socket_count(), 0);
 
-  for (GroupMap::iterator i = group_map_.begin(); i != group_map_.end(); ++i) {
-    Group* group = i->second;
-    if (exception_group == group)
-      continue;
-    std::list<IdleSocket>* idle_sockets = group->mutable_idle_sockets();
-
-    if (!idle_sockets->empty()) {
-      delete idle_sockets->front().socket;
-      idle_sockets->pop_front();
-      DecrementIdleCount();
-      if (group->IsEmpty())
-        RemoveGroup(i);
-
-      return true;
-    }
+  // Close the socket that has been idle the longest.  Both queues are ordered
+  // by idle time, so it is the first socket outside |exception_group| in one
+  // of them.
+  IdleSocketQueue::iterator unused = unused_idle_sockets_.begin();
+  while (unused != unused_idle_sockets_.end() &&
+         unused->group == exception_group) {
+    ++unused;
+  }
+  IdleSocketQueue::iterator used = used_idle_sockets_.begin();
+  while (used != used_idle_sockets_.end() && used->group == exception_group)
+    ++used;
+
+  IdleSocketQueue::iterator oldest;
+  if (unused == unused_idle_sockets_.end()) {
+    if (used == used_idle_sockets_.end())
+      return false;
+    oldest = used;
+  } else if (used == used_idle_sockets_.end() ||
+             unused->start_time <= used->start_time) {
+    oldest = unused;
+  } else {
+    oldest = used;
   }
 
-  return false;
+  Group* group = oldest->group;
+  StreamSocket* socket = oldest->socket;
+  std::list<IdleSocket>::iterator it = group->mutable_idle_sockets()->begin();
+  while (it->socket != socket)
+    ++it;
+  delete it->socket;
+  RemoveIdleSocket(group, it);
+  if (group->IsEmpty())
+    RemoveGroup(group->group_name());
+
+  return true;
 }
 
 bool ClientSocketPoolBaseHelper::CloseOneIdleConnectionInHigherLayeredPool() {
@@ -1142,10 +1226,13 @@ void ClientSocketPoolBaseHelper::TryToCloseSocketsInLayeredPools() {
   }
 }
 
-ClientSocketPoolBaseHelper::Group::Group()
-    : unassigned_job_count_(0),
+ClientSocketPoolBaseHelper::Group::Group(const std::string& group_name)
+    : group_name_(group_name),
+      unassigned_job_count_(0),
       pending_requests_(NUM_PRIORITIES),
-      active_socket_count_(0) {}
+      active_socket_count_(0),
+      in_pending_groups_(false),
+      pending_groups_priority_(IDLE) {}
 
 ClientSocketPoolBaseHelper::Group::~Group() {
   DCHECK_EQ(0u, unassigned_job_count_);
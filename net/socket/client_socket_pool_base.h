@@ -31,6 +31,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/containers/flat_hash_map.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/weak_ptr.h"
@@ -300,14 +301,15 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
   static bool set_cleanup_timer_enabled(bool enabled);
 
   // Closes all idle sockets if |force| is true.  Else, only closes idle
-  // sockets that timed out or can't be reused.  Made public for testing.
+  // sockets that timed out or can't be reused.  Walks every idle socket.
+  // Made public for testing.
   void CleanupIdleSockets(bool force);
 
-  // Closes one idle socket.  Picks the first one encountered.
-  // TODO(willchan): Consider a better algorithm for doing this.  Perhaps we
-  // should keep an ordered list of idle sockets, and close them in order.
-  // Requires maintaining more state.  It's not clear if it's worth it since
-  // I'm not sure if we hit this situation often.
+  // Closes the idle sockets that timed out, without looking at the others.
+  // Made public for testing.
+  void CleanupTimedOutIdleSockets();
+
+  // Closes the idle socket that has been idle the longest.
   bool CloseOneIdleSocket();
 
   // Checks higher layered pools to see if they can close an idle connection.
@@ -335,9 +337,21 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
  private:
   friend class base::RefCounted<ClientSocketPoolBaseHelper>;
 
+  class Group;
+
+  // An idle socket in one of the pool-wide queues of idle sockets.  Sockets
+  // are appended to a queue when they become idle, so each queue is ordered
+  // by |start_time|.
+  struct IdleSocketQueueEntry {
+    Group* group;
+    StreamSocket* socket;
+    base::TimeTicks start_time;
+  };
+  typedef std::list<IdleSocketQueueEntry> IdleSocketQueue;
+
   // Entry for a persistent socket which became idle at time |start_time|.
   struct IdleSocket {
-    IdleSocket() : socket(NULL) {}
+    IdleSocket() : socket(NULL), queue(NULL) {}
 
     // An idle socket can't be used if it is disconnected or has been used
     // before and has received data unexpectedly (hence no longer idle).  The
@@ -356,6 +370,9 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
 
     StreamSocket* socket;
     base::TimeTicks start_time;
+    // The queue that holds this socket, and its position in it.
+    IdleSocketQueue* queue;
+    IdleSocketQueue::iterator queue_it;
   };
 
   typedef PriorityQueue<const Request*> RequestQueue;
@@ -366,9 +383,11 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
   // |active_socket_count| tracks the number of sockets held by clients.
   class Group {
    public:
-    Group();
+    explicit Group(const std::string& group_name);
     ~Group();
 
+    const std::string& group_name() const { return group_name_; }
+
     bool IsEmpty() const {
       return active_socket_count_ == 0 && idle_sockets_.empty() &&
           jobs_.empty() && pending_requests_.empty();
@@ -453,6 +472,18 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
     int active_socket_count() const { return active_socket_count_; }
     std::list<IdleSocket>* mutable_idle_sockets() { return &idle_sockets_; }
 
+    // Whether the group is in the pool's |pending_groups_|, and the priority
+    // it was filed under.
+    bool in_pending_groups() const { return in_pending_groups_; }
+    RequestPriority pending_groups_priority() const {
+      return pending_groups_priority_;
+    }
+    void set_pending_groups_priority(bool in_pending_groups,
+                                     RequestPriority priority) {
+      in_pending_groups_ = in_pending_groups;
+      pending_groups_priority_ = priority;
+    }
+
    private:
     // Returns the iterator's pending request after removing it from
     // the queue.
@@ -468,6 +499,8 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
     // ConnectJobs.
     void SanityCheck();
 
+    const std::string group_name_;
+
     // Total number of ConnectJobs that have never been assigned to a Request.
     // Since jobs use late binding to requests, which ConnectJobs have or have
     // not been assigned to a request are not tracked.  This is incremented on
@@ -482,9 +515,18 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
     int active_socket_count_;  // number of active sockets used by clients
     // A timer for when to start the backup job.
     base::OneShotTimer<Group> backup_job_timer_;
+    bool in_pending_groups_;
+    RequestPriority pending_groups_priority_;
   };
 
-  typedef std::map<std::string, Group*> GroupMap;
+  typedef base::FlatHashMap<std::string, Group*> GroupMap;
+
+  // Orders groups by the priority of their top pending request, highest
+  // first, and then by name.
+  struct PendingGroupOrder {
+    bool operator()(const Group* a, const Group* b) const;
+  };
+  typedef std::set<Group*, PendingGroupOrder> PendingGroupSet;
 
   typedef std::set<ConnectJob*> ConnectJobSet;
 
@@ -504,6 +546,10 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
   void RemoveGroup(const std::string& group_name);
   void RemoveGroup(GroupMap::iterator it);
 
+  // Moves |group| to its place in |pending_groups_|.  Must be called whenever
+  // a request is added to or removed from |group|.
+  void UpdatePendingGroup(Group* group);
+
   // Called when the number of idle sockets changes.
   void IncrementIdleCount();
   void DecrementIdleCount();
@@ -511,17 +557,26 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
   // Start cleanup timer for idle sockets.
   void StartIdleSocketTimer();
 
-  // Scans the group map for groups which have an available socket slot and
-  // at least one pending request. Returns true if any groups are stalled, and
-  // if so (and if both |group| and |group_name| are not NULL), fills |group|
-  // and |group_name| with data of the stalled group having highest priority.
+  // Scans the groups with pending requests for groups which have an available
+  // socket slot. Returns true if any groups are stalled, and if so (and if
+  // both |group| and |group_name| are not NULL), fills |group| and
+  // |group_name| with data of the stalled group having highest priority.
   bool FindTopStalledGroup(Group** group, std::string* group_name) const;
 
-  // Called when timer_ fires.  This method scans the idle sockets removing
-  // sockets that timed out or can't be reused.
-  void OnCleanupTimerFired() {
-    CleanupIdleSockets(false);
-  }
+  // Called when timer_ fires.  Removes the idle sockets that timed out.
+  void OnCleanupTimerFired();
+
+  // Closes the sockets at the front of |queue| that have been idle for
+  // |timeout| or longer at time |now|.
+  void CleanupTimedOutIdleSocketsInQueue(IdleSocketQueue* queue,
+                                         base::TimeDelta timeout,
+                                         base::TimeTicks now);
+
+  // Removes the idle socket at |it| from |group| and from its queue, and
+  // returns the next idle socket of |group|.  Doesn't delete the socket.
+  std::list<IdleSocket>::iterator RemoveIdleSocket(
+      Group* group,
+      std::list<IdleSocket>::iterator it);
 
   // Removes |job| from |group|, which must already own |job|.
   void RemoveConnectJob(ConnectJob* job, Group* group);
@@ -595,6 +650,17 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
 
   GroupMap group_map_;
 
+  // The groups that have pending requests.  A group is stalled if it is
+  // below |max_sockets_per_group_| and has more requests than ConnectJobs, so
+  // stalled groups are looked up here instead of in |group_map_|.
+  PendingGroupSet pending_groups_;
+
+  // Idle sockets that were never used and that were used, in the order they
+  // became idle.  Since all sockets in a queue share a timeout, the sockets
+  // that timed out are always at the front.
+  IdleSocketQueue unused_idle_sockets_;
+  IdleSocketQueue used_idle_sockets_;
+
   // Map of the ClientSocketHandles for which we have a pending Task to invoke a
   // callback.  This is necessary since, before we invoke said callback, it's
   // possible that the request is cancelled.
@@ -813,6 +879,10 @@ class ClientSocketPoolBase {
     return helper_.CleanupIdleSockets(force);
   }
 
+  void CleanupTimedOutIdleSockets() {
+    return helper_.CleanupTimedOutIdleSockets();
+  }
+
   base::DictionaryValue* GetInfoAsValue(const std::string& name,
                                         const std::string& type) const {
     return helper_.GetInfoAsValue(name, type);
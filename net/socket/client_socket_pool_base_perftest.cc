@@ -0,0 +1,200 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/socket/client_socket_pool_base.h"
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_time_logger.h"
+#include "net/base/completion_callback.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/request_priority.h"
+#include "net/socket/client_socket_handle.h"
+#include "net/socket/client_socket_pool.h"
+#include "net/socket/client_socket_pool_histograms.h"
+#include "net/socket/stream_socket.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kNumGroups = 50000;
+const int kIterations = 200000;
+const int kCleanupIterations = 10000;
+
+class PerfSocketParams : public base::RefCounted<PerfSocketParams> {
+ public:
+  PerfSocketParams() {}
+
+  bool ignore_limits() { return false; }
+
+ private:
+  friend class base::RefCounted<PerfSocketParams>;
+  ~PerfSocketParams() {}
+
+  DISALLOW_COPY_AND_ASSIGN(PerfSocketParams);
+};
+typedef ClientSocketPoolBase<PerfSocketParams> PerfClientSocketPoolBase;
+
+// A socket that is always connected and idle, and never used to convey data.
+class PerfClientSocket : public StreamSocket {
+ public:
+  PerfClientSocket() {}
+
+  // Socket implementation.
+  int Read(IOBuffer* buf,
+           int len,
+           const CompletionCallback& callback) override {
+    return ERR_UNEXPECTED;
+  }
+  int Write(IOBuffer* buf,
+            int len,
+            const CompletionCallback& callback) override {
+    return ERR_UNEXPECTED;
+  }
+  int SetReceiveBufferSize(int32 size) override { return OK; }
+  int SetSendBufferSize(int32 size) override { return OK; }
+
+  // StreamSocket implementation.
+  int Connect(const CompletionCallback& callback) override { return OK; }
+  void Disconnect() override {}
+  bool IsConnected() const override { return true; }
+  bool IsConnectedAndIdle() const override { return true; }
+  int GetPeerAddress(IPEndPoint* address) const override {
+    return ERR_UNEXPECTED;
+  }
+  int GetLocalAddress(IPEndPoint* address) const override {
+    return ERR_UNEXPECTED;
+  }
+  const BoundNetLog& NetLog() const override { return net_log_; }
+  void SetSubresourceSpeculation() override {}
+  void SetOmniboxSpeculation() override {}
+  bool WasEverUsed() const override { return false; }
+  bool UsingTCPFastOpen() const override { return false; }
+  bool WasNpnNegotiated() const override { return false; }
+  NextProto GetNegotiatedProtocol() const override { return kProtoUnknown; }
+  bool GetSSLInfo(SSLInfo* ssl_info) override { return false; }
+
+ private:
+  BoundNetLog net_log_;
+
+  DISALLOW_COPY_AND_ASSIGN(PerfClientSocket);
+};
+
+// A ConnectJob that connects synchronously.
+class PerfConnectJob : public ConnectJob {
+ public:
+  PerfConnectJob(const std::string& group_name,
+                 const PerfClientSocketPoolBase::Request& request,
+                 ConnectJob::Delegate* delegate)
+      : ConnectJob(group_name, base::TimeDelta(), request.priority(), delegate,
+                   BoundNetLog()) {}
+
+  LoadState GetLoadState() const override { return LOAD_STATE_IDLE; }
+
+ private:
+  int ConnectInternal() override {
+    SetSocket(scoped_ptr<StreamSocket>(new PerfClientSocket()));
+    return OK;
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(PerfConnectJob);
+};
+
+class PerfConnectJobFactory
+    : public PerfClientSocketPoolBase::ConnectJobFactory {
+ public:
+  PerfConnectJobFactory() {}
+  ~PerfConnectJobFactory() override {}
+
+  scoped_ptr<ConnectJob> NewConnectJob(
+      const std::string& group_name,
+      const PerfClientSocketPoolBase::Request& request,
+      ConnectJob::Delegate* delegate) const override {
+    return scoped_ptr<ConnectJob>(
+        new PerfConnectJob(group_name, request, delegate));
+  }
+
+  base::TimeDelta ConnectionTimeout() const override {
+    return base::TimeDelta();
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PerfConnectJobFactory);
+};
+
+class ClientSocketPoolBasePerfTest : public testing::Test {
+ protected:
+  ClientSocketPoolBasePerfTest()
+      : params_(new PerfSocketParams()),
+        histograms_("ClientSocketPoolPerfTest"),
+        // The pool is exactly large enough for one socket per group, so every
+        // release happens at the pool's socket limit.
+        pool_(NULL,
+              kNumGroups,
+              6,
+              &histograms_,
+              ClientSocketPool::unused_idle_socket_timeout(),
+              ClientSocketPool::used_idle_socket_timeout(),
+              new PerfConnectJobFactory()) {
+    for (int i = 0; i < kNumGroups; ++i)
+      group_names_.push_back(base::StringPrintf("host%d.example.com:443", i));
+  }
+
+  // Gives every group one idle socket.
+  void PreconnectAllGroups() {
+    for (int i = 0; i < kNumGroups; ++i)
+      pool_.RequestSockets(group_names_[i], params_, 1, BoundNetLog());
+    ASSERT_EQ(kNumGroups, pool_.idle_socket_count());
+  }
+
+  base::MessageLoopForIO message_loop_;
+  scoped_refptr<PerfSocketParams> params_;
+  ClientSocketPoolHistograms histograms_;
+  PerfClientSocketPoolBase pool_;
+  std::vector<std::string> group_names_;
+};
+
+// Takes an idle socket from a group and releases it back, with every group of
+// the pool holding a socket.
+TEST_F(ClientSocketPoolBasePerfTest, RequestAndReleaseSocket) {
+  PreconnectAllGroups();
+
+  base::PerfTimeLogger timer("ClientSocketPoolBase_RequestAndReleaseSocket");
+  for (int i = 0; i < kIterations; ++i) {
+    const std::string& group_name = group_names_[(i * 7919) % kNumGroups];
+    ClientSocketHandle handle;
+    ASSERT_EQ(OK, pool_.RequestSocket(group_name, params_, DEFAULT_PRIORITY,
+                                      &handle, CompletionCallback(),
+                                      BoundNetLog()));
+    int id = handle.id();
+    pool_.ReleaseSocket(group_name, handle.PassSocket(), id);
+  }
+  timer.Done();
+  EXPECT_EQ(kNumGroups, pool_.idle_socket_count());
+}
+
+// Looks for timed out idle sockets when none of them has timed out yet.
+TEST_F(ClientSocketPoolBasePerfTest, CleanupTimedOutIdleSockets) {
+  PreconnectAllGroups();
+
+  base::PerfTimeLogger timer(
+      "ClientSocketPoolBase_CleanupTimedOutIdleSockets");
+  for (int i = 0; i < kCleanupIterations; ++i)
+    pool_.CleanupTimedOutIdleSockets();
+  timer.Done();
+  EXPECT_EQ(kNumGroups, pool_.idle_socket_count());
+}
+
+}  // namespace
+
+}  // namespace net
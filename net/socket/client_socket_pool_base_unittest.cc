@@ -583,7 +583,7 @@ class TestClientSocketPool : public ClientSocketPool {
     return base_.HasGroup(group_name);
   }
 
-  void CleanupTimedOutIdleSockets() { base_.CleanupIdleSockets(false); }
+  void CleanupTimedOutIdleSockets() { base_.CleanupTimedOutIdleSockets(); }
 
   void EnableConnectBackupJobs() { base_.EnableConnectBackupJobs(); }
 
@@ -2380,6 +2380,45 @@ TEST_F(ClientSocketPoolBaseTest, CleanupTimedOutIdleSockets) {
       entries, 1, NetLog::TYPE_SOCKET_POOL_REUSED_AN_EXISTING_SOCKET));
 }
 
+// Make sure that timing out the last idle socket of a group removes the group,
+// while groups whose sockets haven't timed out are left alone.
+TEST_F(ClientSocketPoolBaseTest, CleanupTimedOutIdleSocketsRemovesGroups) {
+  CreatePoolWithIdleTimeouts(
+      kDefaultMaxSockets, kDefaultMaxSocketsPerGroup,
+      base::TimeDelta(),  // Time out unused sockets immediately.
+      base::TimeDelta::FromDays(1));  // Don't time out used sockets.
+
+  ClientSocketHandle handle_a;
+  TestCompletionCallback callback_a;
+  EXPECT_EQ(OK, handle_a.Init("a",
+                              params_,
+                              LOWEST,
+                              callback_a.callback(),
+                              pool_.get(),
+                              BoundNetLog()));
+  ClientSocketHandle handle_b;
+  TestCompletionCallback callback_b;
+  EXPECT_EQ(OK, handle_b.Init("b",
+                              params_,
+                              LOWEST,
+                              callback_b.callback(),
+                              pool_.get(),
+                              BoundNetLog()));
+
+  // Use only the socket in "b".
+  EXPECT_EQ(1, handle_b.socket()->Write(NULL, 1, CompletionCallback()));
+  handle_a.Reset();
+  handle_b.Reset();
+  base::MessageLoop::current()->RunUntilIdle();
+  ASSERT_EQ(2, pool_->IdleSocketCount());
+
+  pool_->CleanupTimedOutIdleSockets();
+  EXPECT_EQ(1, pool_->IdleSocketCount());
+  EXPECT_FALSE(pool_->HasGroup("a"));
+  ASSERT_TRUE(pool_->HasGroup("b"));
+  EXPECT_EQ(1, pool_->IdleSocketCountInGroup("b"));
+}
+
 // Make sure that we process all pending requests even when we're stalling
 // because of multiple releasing disconnected sockets.
 TEST_F(ClientSocketPoolBaseTest, MultipleReleasingDisconnectedSockets) {
@@ -3581,8 +3620,8 @@ TEST_F(ClientSocketPoolBaseTest, PreconnectClosesIdleSocketRemovesGroup) {
   CreatePool(kMaxTotalSockets, kMaxSocketsPerGroup);
   connect_job_factory_->set_job_type(TestConnectJob::kMockPendingJob);
 
-  // Note that group name ordering matters here.  "a" comes before "b", so
-  // CloseOneIdleSocket() will try to close "a"'s idle socket.
+  // Note that idle ordering matters here.  "a"'s socket goes idle before "b"'s,
+  // so CloseOneIdleSocket() will try to close "a"'s idle socket.
 
   // Set up one idle socket in "a".
   ClientSocketHandle handle1;
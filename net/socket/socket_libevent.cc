@@ -5,9 +5,12 @@
 #include "net/socket/socket_libevent.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 
+#include <algorithm>
+
 #include "base/callback_helpers.h"
 #include "base/logging.h"
 #include "base/posix/eintr_wrapper.h"
@@ -269,6 +272,45 @@ int SocketLibevent::Write(IOBuffer* buf,
   return rv;
 }
 
+int SocketLibevent::WriteV(const std::vector<scoped_refptr<IOBuffer> >& bufs,
+                           const std::vector<int>& buf_lens,
+                           const CompletionCallback& callback) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  DCHECK_NE(kInvalidSocket, socket_fd_);
+  DCHECK(!waiting_connect_);
+  CHECK(write_callback_.is_null());
+  // Synchronous operation not supported
+  DCHECK(!callback.is_null());
+  DCHECK_EQ(bufs.size(), buf_lens.size());
+  DCHECK(!bufs.empty());
+
+  size_t count = std::min(bufs.size(), static_cast<size_t>(IOV_MAX));
+  write_iov_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    DCHECK_LT(0, buf_lens[i]);
+    write_iov_[i].iov_base = bufs[i]->data();
+    write_iov_[i].iov_len = buf_lens[i];
+  }
+
+  int rv = DoWriteV();
+  if (rv != ERR_IO_PENDING) {
+    write_iov_.clear();
+    return rv;
+  }
+
+  if (!base::MessageLoopForIO::current()->WatchFileDescriptor(
+          socket_fd_, true, base::MessageLoopForIO::WATCH_WRITE,
+          &write_socket_watcher_, this)) {
+    PLOG(ERROR) << "WatchFileDescriptor failed on write, errno " << errno;
+    write_iov_.clear();
+    return MapSystemError(errno);
+  }
+
+  write_bufs_.assign(bufs.begin(), bufs.begin() + count);
+  write_callback_ = callback;
+  return ERR_IO_PENDING;
+}
+
 int SocketLibevent::WaitForWrite(IOBuffer* buf,
                                  int buf_len,
                                  const CompletionCallback& callback) {
@@ -438,8 +480,14 @@ int SocketLibevent::DoWrite(IOBuffer* buf, int buf_len) {
   return rv >= 0 ? rv : MapSystemError(errno);
 }
 
+int SocketLibevent::DoWriteV() {
+  int rv = HANDLE_EINTR(writev(socket_fd_, &write_iov_[0], write_iov_.size()));
+  return rv >= 0 ? rv : MapSystemError(errno);
+}
+
 void SocketLibevent::WriteCompleted() {
-  int rv = DoWrite(write_buf_.get(), write_buf_len_);
+  int rv = write_iov_.empty() ? DoWrite(write_buf_.get(), write_buf_len_)
+                              : DoWriteV();
   if (rv == ERR_IO_PENDING)
     return;
 
@@ -447,6 +495,8 @@ void SocketLibevent::WriteCompleted() {
   DCHECK(ok);
   write_buf_ = NULL;
   write_buf_len_ = 0;
+  write_bufs_.clear();
+  write_iov_.clear();
   base::ResetAndReturn(&write_callback_).Run(rv);
 }
 
@@ -472,6 +522,8 @@ void SocketLibevent::StopWatchingAndCleanUp() {
   if (!write_callback_.is_null()) {
     write_buf_ = NULL;
     write_buf_len_ = 0;
+    write_bufs_.clear();
+    write_iov_.clear();
     write_callback_.Reset();
   }
 
@@ -5,6 +5,8 @@
 #ifndef NET_SOCKET_SOCKET_LIBEVENT_H_
 #define NET_SOCKET_SOCKET_LIBEVENT_H_
 
+#include <vector>
+
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
 #include "base/macros.h"
@@ -13,6 +15,7 @@
 #include "base/message_loop/message_loop.h"
 #include "base/threading/thread_checker.h"
 #include "net/base/completion_callback.h"
+#include "net/base/iovec.h"
 #include "net/base/net_util.h"
 #include "net/socket/socket_descriptor.h"
 
@@ -62,6 +65,13 @@ class NET_EXPORT_PRIVATE SocketLibevent
   int Read(IOBuffer* buf, int buf_len, const CompletionCallback& callback);
   int Write(IOBuffer* buf, int buf_len, const CompletionCallback& callback);
 
+  // Like Write(), but writes the first |buf_lens[i]| bytes of each buffer in
+  // |bufs| with a single writev().  At most IOV_MAX buffers are written per
+  // call.
+  int WriteV(const std::vector<scoped_refptr<IOBuffer> >& bufs,
+             const std::vector<int>& buf_lens,
+             const CompletionCallback& callback);
+
   // Waits for next write event. This is called by TCPsocketLibevent for TCP
   // fastopen after sending first data. Returns ERR_IO_PENDING if it starts
   // waiting for write event successfully. Otherwise, returns a net error code.
@@ -94,6 +104,7 @@ class NET_EXPORT_PRIVATE SocketLibevent
   void ReadCompleted();
 
   int DoWrite(IOBuffer* buf, int buf_len);
+  int DoWriteV();
   void WriteCompleted();
 
   void StopWatchingAndCleanUp();
@@ -113,6 +124,10 @@ class NET_EXPORT_PRIVATE SocketLibevent
   base::MessageLoopForIO::FileDescriptorWatcher write_socket_watcher_;
   scoped_refptr<IOBuffer> write_buf_;
   int write_buf_len_;
+  // Buffers of a pending WriteV(), and the iovecs pointing into them.  Empty
+  // unless a WriteV() is pending.
+  std::vector<scoped_refptr<IOBuffer> > write_bufs_;
+  std::vector<struct iovec> write_iov_;
   // External callback; called when write or connect is complete.
   CompletionCallback write_callback_;
 
@@ -11,6 +11,7 @@
 #include "net/base/completion_callback.h"
 #include "net/base/load_flags.h"
 #include "net/base/net_errors.h"
+#include "net/socket/ssl_session_store.h"
 #include "net/socket/ssl_socket.h"
 #include "net/socket/stream_socket.h"
 
@@ -149,6 +150,21 @@ class NET_EXPORT SSLClientSocket : public SSLSocket {
   // sessions.
   static void ClearSessionCache();
 
+#if defined(USE_OPENSSL)
+  // SetSessionStore makes the SSL session cache save the sessions of
+  // connections in |ssl_session_cache_shard| to |store|, after adding
+  // |sessions|, which |store| saved earlier, to the cache. This lets sessions
+  // be resumed after a restart. Each shard has its own store. |store| is not
+  // owned, and may be NULL to stop saving the sessions of the shard; it must
+  // be reset before |store| is destroyed. Clearing the session cache clears
+  // the stores of all shards.
+  //
+  // The NSS session cache is not persisted.
+  static void SetSessionStore(SSLSessionStore* store,
+                              const std::string& ssl_session_cache_shard,
+                              const SSLSessionStore::SessionMap& sessions);
+#endif
+
   virtual bool set_was_npn_negotiated(bool negotiated);
 
   virtual bool was_spdy_negotiated() const;
@@ -12,6 +12,8 @@
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
+#include <map>
+
 #include "base/bind.h"
 #include "base/callback_helpers.h"
 #include "base/environment.h"
@@ -140,6 +142,88 @@ int LogErrorCallback(const char* str, size_t len, void* context) {
   return 1;
 }
 
+// How a handshake used the session cache. These values are used in a
+// histogram, so new values must be added at the end.
+enum SessionResumption {
+  // No good session was cached for the server.
+  SESSION_RESUMPTION_NO_SESSION = 0,
+  // The cached session was resumed.
+  SESSION_RESUMPTION_RESUMED = 1,
+  // The cached session, imported from a SSLSessionStore, was resumed.
+  SESSION_RESUMPTION_RESUMED_IMPORTED = 2,
+  // The server refused to resume the cached session.
+  SESSION_RESUMPTION_REFUSED = 3,
+  SESSION_RESUMPTION_MAX
+};
+
+// Forwards the sessions of each session cache shard to the SSLSessionStore
+// set for that shard, if any.
+class ShardedSessionStore : public SSLSessionStore {
+ public:
+  ShardedSessionStore() {}
+  ~ShardedSessionStore() override {}
+
+  // Returns the shard of |key|, as returned by GetSessionCacheKey(). The
+  // shards of privacy mode connections are prefixed with "pm/", so their
+  // sessions don't go to the store of the shard.
+  static std::string GetShard(const std::string& key) {
+    size_t slash = key.find('/');
+    if (slash == std::string::npos)
+      return std::string();
+    return key.substr(slash + 1);
+  }
+
+  // Sets the store of |shard|, or removes it if |store| is NULL. Returns true
+  // if any shard has a store.
+  bool SetShardStore(const std::string& shard, SSLSessionStore* store) {
+    base::AutoLock lock(lock_);
+    if (store)
+      stores_[shard] = store;
+    else
+      stores_.erase(shard);
+    return !stores_.empty();
+  }
+
+  // SSLSessionStore implementation.
+  void SaveSession(const std::string& key, const std::string& data) override {
+    base::AutoLock lock(lock_);
+    SSLSessionStore* store = GetStore(key);
+    if (store)
+      store->SaveSession(key, data);
+  }
+
+  void RemoveSession(const std::string& key) override {
+    base::AutoLock lock(lock_);
+    SSLSessionStore* store = GetStore(key);
+    if (store)
+      store->RemoveSession(key);
+  }
+
+  void RemoveAllSessions() override {
+    base::AutoLock lock(lock_);
+    for (StoreMap::const_iterator it = stores_.begin(); it != stores_.end();
+         ++it) {
+      it->second->RemoveAllSessions();
+    }
+  }
+
+ private:
+  typedef std::map<std::string, SSLSessionStore*> StoreMap;
+
+  SSLSessionStore* GetStore(const std::string& key) const {
+    lock_.AssertAcquired();
+    StoreMap::const_iterator it = stores_.find(GetShard(key));
+    return it == stores_.end() ? NULL : it->second;
+  }
+
+  // Protects |stores_|, which SetSessionStore() changes while sockets on
+  // other threads use the session cache.
+  mutable base::Lock lock_;
+  StoreMap stores_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedSessionStore);
+};
+
 bool IsOCSPStaplingSupported() {
 #if defined(OS_WIN)
   // CERT_OCSP_RESPONSE_PROP_ID is only implemented on Vista+, but it can be
@@ -173,6 +257,28 @@ class SSLClientSocketOpenSSL::SSLContext {
     return SSL_set_ex_data(ssl, ssl_socket_data_index_, socket) != 0;
   }
 
+  void SetSessionStore(SSLSessionStore* store,
+                       const std::string& ssl_session_cache_shard,
+                       const SSLSessionStore::SessionMap& sessions) {
+    // Sessions are only serialized for the cache while some shard has a
+    // store.
+    bool has_stores =
+        session_store_.SetShardStore(ssl_session_cache_shard, store);
+    session_cache_.SetStore(has_stores ? &session_store_ : NULL);
+    if (!store)
+      return;
+
+    SSLSessionStore::SessionMap shard_sessions;
+    for (SSLSessionStore::SessionMap::const_iterator it = sessions.begin();
+         it != sessions.end(); ++it) {
+      if (ShardedSessionStore::GetShard(it->first) == ssl_session_cache_shard)
+        shard_sessions.insert(*it);
+    }
+    size_t imported = session_cache_.ImportSessions(shard_sessions);
+    UMA_HISTOGRAM_COUNTS_10000("Net.SSLSessionCacheImported",
+                               static_cast<int>(imported));
+  }
+
  private:
   friend struct DefaultSingletonTraits<SSLContext>;
 
@@ -243,7 +349,10 @@ class SSLClientSocketOpenSSL::SSLContext {
   int ssl_socket_data_index_;
 
   crypto::ScopedOpenSSL<SSL_CTX, SSL_CTX_free>::Type ssl_ctx_;
-  // |session_cache_| must be destroyed before |ssl_ctx_|.
+  // Sends what |session_cache_| saves to the stores set by SetSessionStore().
+  ShardedSessionStore session_store_;
+  // |session_cache_| must be destroyed before |ssl_ctx_| and
+  // |session_store_|.
   SSLSessionCacheOpenSSL session_cache_;
 };
 
@@ -344,6 +453,15 @@ void SSLClientSocket::ClearSessionCache() {
   context->session_cache()->Flush();
 }
 
+// static
+void SSLClientSocket::SetSessionStore(
+    SSLSessionStore* store,
+    const std::string& ssl_session_cache_shard,
+    const SSLSessionStore::SessionMap& sessions) {
+  SSLClientSocketOpenSSL::SSLContext::GetInstance()->SetSessionStore(
+      store, ssl_session_cache_shard, sessions);
+}
+
 SSLClientSocketOpenSSL::SSLClientSocketOpenSSL(
     scoped_ptr<ClientSocketHandle> transport_socket,
     const HostPortPair& host_and_port,
@@ -924,6 +1042,18 @@ int SSLClientSocketOpenSSL::DoHandshake() {
                << " is: " << (SSL_session_reused(ssl_) ? "Success" : "Fail");
     }
 
+    SessionResumption resumption = SESSION_RESUMPTION_NO_SESSION;
+    if (trying_cached_session_) {
+      if (!SSL_session_reused(ssl_))
+        resumption = SESSION_RESUMPTION_REFUSED;
+      else if (SSLSessionCacheOpenSSL::GetImportedPeerCertChain(ssl_))
+        resumption = SESSION_RESUMPTION_RESUMED_IMPORTED;
+      else
+        resumption = SESSION_RESUMPTION_RESUMED;
+    }
+    UMA_HISTOGRAM_ENUMERATION("Net.SSLSessionResumption", resumption,
+                              SESSION_RESUMPTION_MAX);
+
     if (ssl_config_.version_fallback &&
         ssl_config_.version_max < ssl_config_.version_fallback_min) {
       return ERR_SSL_FALLBACK_BEYOND_MINIMUM_VERSION;
@@ -1177,7 +1307,12 @@ void SSLClientSocketOpenSSL::DoConnectCallback(int rv) {
 }
 
 void SSLClientSocketOpenSSL::UpdateServerCert() {
-  server_cert_chain_->Reset(SSL_get_peer_cert_chain(ssl_));
+  STACK_OF(X509)* chain = SSL_get_peer_cert_chain(ssl_);
+  // OpenSSL doesn't keep the peer's chain in serialized sessions, so the
+  // chain of an imported session was saved with it.
+  if (!chain && SSL_session_reused(ssl_))
+    chain = SSLSessionCacheOpenSSL::GetImportedPeerCertChain(ssl_);
+  server_cert_chain_->Reset(chain);
   server_cert_ = server_cert_chain_->AsOSChain();
 
   if (server_cert_.get()) {
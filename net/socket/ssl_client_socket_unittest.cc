@@ -2351,6 +2351,90 @@ TEST(SSLClientSocket, ClearSessionCache) {
   SSLClientSocket::ClearSessionCache();
 }
 
+#if defined(USE_OPENSSL)
+// A SSLSessionStore that keeps its sessions in memory.
+class TestSSLSessionStore : public SSLSessionStore {
+ public:
+  TestSSLSessionStore() {}
+  ~TestSSLSessionStore() override {}
+
+  const SessionMap& sessions() const { return sessions_; }
+
+  // SSLSessionStore implementation.
+  void SaveSession(const std::string& key, const std::string& data) override {
+    sessions_[key] = data;
+  }
+  void RemoveSession(const std::string& key) override { sessions_.erase(key); }
+  void RemoveAllSessions() override { sessions_.clear(); }
+
+ private:
+  SessionMap sessions_;
+
+  DISALLOW_COPY_AND_ASSIGN(TestSSLSessionStore);
+};
+
+// Test that a session saved to a SSLSessionStore is resumed, with the server's
+// certificate, after being imported into an empty session cache.
+TEST_F(SSLClientSocketTest, SessionStoreResumption) {
+  SpawnedTestServer::SSLOptions ssl_options;
+  ASSERT_TRUE(StartTestServer(ssl_options));
+
+  // Use a shard of its own, so that other sessions don't reach the store.
+  context_.ssl_session_cache_shard = "session_store_test";
+  SSLClientSocket::ClearSessionCache();
+  TestSSLSessionStore store;
+  SSLClientSocket::SetSessionStore(&store, context_.ssl_session_cache_shard,
+                                   SSLSessionStore::SessionMap());
+  // The store of another shard doesn't replace it.
+  TestSSLSessionStore other_store;
+  SSLClientSocket::SetSessionStore(&other_store, "other_session_store_test",
+                                   SSLSessionStore::SessionMap());
+
+  SSLConfig ssl_config;
+  TestCompletionCallback callback;
+  scoped_ptr<StreamSocket> transport(
+      new TCPClientSocket(addr(), &log_, NetLog::Source()));
+  ASSERT_EQ(OK, callback.GetResult(transport->Connect(callback.callback())));
+  scoped_ptr<SSLClientSocket> sock = CreateSSLClientSocket(
+      transport.Pass(), test_server()->host_port_pair(), ssl_config);
+  ASSERT_EQ(OK, callback.GetResult(sock->Connect(callback.callback())));
+  sock.reset();
+  ASSERT_EQ(1u, store.sessions().size());
+  EXPECT_TRUE(other_store.sessions().empty());
+
+  // Simulate a restart: empty the cache but not the store, then import the
+  // saved session back.
+  SSLSessionStore::SessionMap saved_sessions = store.sessions();
+  SSLClientSocket::SetSessionStore(NULL, context_.ssl_session_cache_shard,
+                                   SSLSessionStore::SessionMap());
+  SSLClientSocket::ClearSessionCache();
+  SSLClientSocket::SetSessionStore(&store, context_.ssl_session_cache_shard,
+                                   saved_sessions);
+
+  transport.reset(new TCPClientSocket(addr(), &log_, NetLog::Source()));
+  ASSERT_EQ(OK, callback.GetResult(transport->Connect(callback.callback())));
+  sock = CreateSSLClientSocket(
+      transport.Pass(), test_server()->host_port_pair(), ssl_config);
+  ASSERT_EQ(OK, callback.GetResult(sock->Connect(callback.callback())));
+
+  SSLInfo ssl_info;
+  ASSERT_TRUE(sock->GetSSLInfo(&ssl_info));
+  EXPECT_EQ(SSLInfo::HANDSHAKE_RESUME, ssl_info.handshake_type);
+  EXPECT_TRUE(ssl_info.cert.get());
+  sock.reset();
+
+  // Clearing the session cache clears the stores as well.
+  other_store.SaveSession("other", "session");
+  SSLClientSocket::ClearSessionCache();
+  EXPECT_TRUE(store.sessions().empty());
+  EXPECT_TRUE(other_store.sessions().empty());
+  SSLClientSocket::SetSessionStore(NULL, context_.ssl_session_cache_shard,
+                                   SSLSessionStore::SessionMap());
+  SSLClientSocket::SetSessionStore(NULL, "other_session_store_test",
+                                   SSLSessionStore::SessionMap());
+}
+#endif  // defined(USE_OPENSSL)
+
 // Test that the server certificates are properly retrieved from the underlying
 // SSL stack.
 TEST_F(SSLClientSocketTest, VerifyServerChainProperlyOrdered) {
@@ -9,16 +9,29 @@
 
 #include <openssl/rand.h>
 #include <openssl/ssl.h>
+#include <openssl/x509.h>
 
 #include "base/containers/hash_tables.h"
 #include "base/lazy_instance.h"
 #include "base/logging.h"
+#include "base/pickle.h"
 #include "base/synchronization/lock.h"
+#include "crypto/scoped_openssl_types.h"
 
 namespace net {
 
 namespace {
 
+// Version of the serialized sessions given to a SSLSessionStore.
+const int kSerializedSessionVersion = 1;
+
+void FreeX509Stack(STACK_OF(X509)* ptr) {
+  sk_X509_pop_free(ptr, X509_free);
+}
+
+typedef crypto::ScopedOpenSSL<STACK_OF(X509), FreeX509Stack>::Type
+    ScopedX509Stack;
+
 // A helper class to lazily create a new EX_DATA index to map SSL_CTX handles
 // to their corresponding SSLSessionCacheOpenSSLImpl object.
 class SSLContextExIndex {
@@ -28,14 +41,30 @@ public:
     DCHECK_NE(-1, context_index_);
     session_index_ = SSL_SESSION_get_ex_new_index(0, NULL, NULL, NULL, NULL);
     DCHECK_NE(-1, session_index_);
+    chain_index_ =
+        SSL_SESSION_get_ex_new_index(0, NULL, NULL, NULL, ChainFree);
+    DCHECK_NE(-1, chain_index_);
   }
 
   int context_index() const { return context_index_; }
   int session_index() const { return session_index_; }
+  int chain_index() const { return chain_index_; }
 
  private:
+  // Called to destroy the peer certificate chain of an imported session.
+  static void ChainFree(void* parent,
+                        void* ptr,
+                        CRYPTO_EX_DATA* ad,
+                        int index,
+                        long argl,
+                        void* argp) {
+    if (ptr)
+      FreeX509Stack(reinterpret_cast<STACK_OF(X509)*>(ptr));
+  }
+
   int context_index_;
   int session_index_;
+  int chain_index_;
 };
 
 // static
@@ -54,6 +83,89 @@ static int GetSSLSessionExIndex() {
   return s_ssl_context_ex_instance.Get().session_index();
 }
 
+// Retrieve the global EX_DATA index, created lazily on first call, used to
+// attach their peer certificate chain to imported sessions.
+static int GetSSLSessionChainExIndex() {
+  return s_ssl_context_ex_instance.Get().chain_index();
+}
+
+// Return the time at which |session| expires.
+long GetSessionExpiry(const SSL_SESSION* session) {
+  return session->time + session->timeout;
+}
+
+// Serialize |session| and the peer certificate |chain| it was established
+// with into |*data|. Return true on success.
+bool SerializeSession(SSL_SESSION* session,
+                      STACK_OF(X509)* chain,
+                      std::string* data) {
+  if (!chain || sk_X509_num(chain) == 0)
+    return false;
+
+  uint8_t* session_der;
+  size_t session_der_len;
+  if (!SSL_SESSION_to_bytes(session, &session_der, &session_der_len))
+    return false;
+  crypto::ScopedOpenSSLBytes free_session_der(session_der);
+
+  Pickle pickle;
+  pickle.WriteInt(kSerializedSessionVersion);
+  pickle.WriteData(reinterpret_cast<const char*>(session_der),
+                   static_cast<int>(session_der_len));
+  pickle.WriteInt(static_cast<int>(sk_X509_num(chain)));
+  for (size_t i = 0; i < sk_X509_num(chain); ++i) {
+    uint8_t* cert_der = NULL;
+    int cert_der_len = i2d_X509(sk_X509_value(chain, i), &cert_der);
+    if (cert_der_len <= 0)
+      return false;
+    crypto::ScopedOpenSSLBytes free_cert_der(cert_der);
+    pickle.WriteData(reinterpret_cast<const char*>(cert_der), cert_der_len);
+  }
+
+  data->assign(reinterpret_cast<const char*>(pickle.data()), pickle.size());
+  return true;
+}
+
+// Parse a session serialized by SerializeSession(), with its peer certificate
+// chain attached. Return NULL on failure.
+SSL_SESSION* DeserializeSession(const std::string& data) {
+  Pickle pickle(data.data(), static_cast<int>(data.size()));
+  PickleIterator iter(pickle);
+
+  int version;
+  const char* session_der;
+  int session_der_len;
+  int num_certs;
+  if (!iter.ReadInt(&version) || version != kSerializedSessionVersion ||
+      !iter.ReadData(&session_der, &session_der_len) ||
+      !iter.ReadInt(&num_certs) || num_certs <= 0) {
+    return NULL;
+  }
+
+  ScopedX509Stack chain(sk_X509_new_null());
+  for (int i = 0; i < num_certs; ++i) {
+    const char* cert_der;
+    int cert_der_len;
+    if (!iter.ReadData(&cert_der, &cert_der_len))
+      break;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(cert_der);
+    X509* cert = d2i_X509(NULL, &p, cert_der_len);
+    if (!cert)
+      break;
+    sk_X509_push(chain.get(), cert);
+  }
+  if (static_cast<int>(sk_X509_num(chain.get())) != num_certs)
+    return NULL;
+
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(session_der);
+  SSL_SESSION* session = d2i_SSL_SESSION(NULL, &p, session_der_len);
+  if (!session)
+    return NULL;
+  SSL_SESSION_set_ex_data(session, GetSSLSessionChainExIndex(),
+                          chain.release());
+  return session;
+}
+
 // Helper struct used to store session IDs in a SessionIdIndex container
 // (see definition below). To save memory each entry only holds a pointer
 // to the session ID buffer, which must outlive the entry itself. On the
@@ -128,6 +240,10 @@ namespace net {
 //   of |key_index_|. If is used to efficiently remove sessions from the cache,
 //   as well as check for the existence of a session ID value in the cache.
 //
+//   |expiry_index_| is a multimap of SSL_SESSION handles ordered by their
+//   expiration time. It is used to find expired sessions without scanning
+//   the whole cache.
+//
 //   SSL_SESSION objects are reference-counted, and owned by the cache. This
 //   means that their reference count is incremented when they are added, and
 //   decremented when they are removed.
@@ -140,10 +256,11 @@ namespace net {
 //    + 24   (std::string header/minimum size)
 //    +  8   (key_index_ node, excluding the 2 lines above for the key).
 //    + 20   (id_index_ node)
+//    + 24   (expiry_index_ node)
 //  --------
-//     164   bytes/node
+//     188   bytes/node
 //
-// Hence, 41 KiB for a full cache with a maximum of 1024 entries, excluding
+// Hence, 47 KiB for a full cache with a maximum of 1024 entries, excluding
 // the size of SSL_SESSION objects and heap fragmentation.
 //
 
@@ -155,7 +272,7 @@ class SSLSessionCacheOpenSSLImpl {
   // string, according to the client's preferences.
   SSLSessionCacheOpenSSLImpl(SSL_CTX* ctx,
                              const SSLSessionCacheOpenSSL::Config& config)
-      : ctx_(ctx), config_(config), expiration_check_(0) {
+      : ctx_(ctx), config_(config), store_(NULL), expiration_check_(0) {
     DCHECK(ctx);
 
     // NO_INTERNAL_STORE disables OpenSSL's builtin cache, and
@@ -177,6 +294,8 @@ class SSLSessionCacheOpenSSLImpl {
 
   // Destroy this instance. Must happen before |ctx_| is destroyed.
   ~SSLSessionCacheOpenSSLImpl() {
+    // The sessions are only dropped from memory, the store keeps them.
+    SetStore(NULL);
     Flush();
     SSL_CTX_set_ex_data(ctx_, GetSSLContextExIndex(), NULL);
     SSL_CTX_sess_set_new_cb(ctx_, NULL);
@@ -257,21 +376,85 @@ class SSLSessionCacheOpenSSLImpl {
     SSL_SESSION* session = SSL_get_session(ssl);
     CHECK(session);
 
+    base::AutoLock locked(lock_);
+    bool was_good =
+        SSL_SESSION_get_ex_data(session, GetSSLSessionExIndex()) != NULL;
+
     // Mark the session as good, allowing it to be used for future connections.
     SSL_SESSION_set_ex_data(
         session, GetSSLSessionExIndex(), reinterpret_cast<void*>(1));
+
+    // Resumed sessions were saved when they first became good.
+    if (!store_ || was_good || session->session_id_length == 0)
+      return;
+
+    // The session may have been replaced or evicted in the meantime.
+    SessionIdIndex::iterator it = id_index_.find(SessionId(session));
+    if (it == id_index_.end())
+      return;
+
+    std::string data;
+    if (SerializeSession(session, SSL_get_peer_cert_chain(ssl), &data))
+      store_->SaveSession(it->second->first, data);
   }
 
-  // Flush all entries from the cache.
+  // Flush all entries from the cache, and from the store.
   void Flush() {
     base::AutoLock lock(lock_);
     id_index_.clear();
     key_index_.clear();
+    expiry_index_.clear();
     while (!ordering_.empty()) {
       SSL_SESSION* session = ordering_.front();
       ordering_.pop_front();
       SSL_SESSION_free(session);
     }
+    if (store_)
+      store_->RemoveAllSessions();
+  }
+
+  void SetStore(SSLSessionStore* store) {
+    base::AutoLock locked(lock_);
+    store_ = store;
+  }
+
+  // Add the sessions of |sessions| whose keys have no session yet, and remove
+  // those that can't be used from the store. Return the number of sessions
+  // added.
+  size_t ImportSessions(const SSLSessionStore::SessionMap& sessions) {
+    base::AutoLock locked(lock_);
+    long now = static_cast<long>(::time(NULL));
+    size_t imported = 0;
+    for (SSLSessionStore::SessionMap::const_iterator it = sessions.begin();
+         it != sessions.end(); ++it) {
+      if (it->first.empty() || key_index_.find(it->first) != key_index_.end())
+        continue;
+
+      SSL_SESSION* session = DeserializeSession(it->second);
+      if (session && (session->session_id_length == 0 ||
+                      GetSessionExpiry(session) <= now ||
+                      id_index_.find(SessionId(session)) != id_index_.end())) {
+        SSL_SESSION_free(session);
+        session = NULL;
+      }
+      if (!session) {
+        // Don't keep unusable sessions in the store.
+        if (store_)
+          store_->RemoveSession(it->first);
+        continue;
+      }
+
+      // The session was validated before it was saved.
+      SSL_SESSION_set_ex_data(
+          session, GetSSLSessionExIndex(), reinterpret_cast<void*>(1));
+      DVLOG(2) << "Import session " << session << " for " << it->first;
+      AddSessionLocked(it->first, session);
+      ++imported;
+    }
+
+    if (key_index_.size() > config_.max_entries)
+      ShrinkCacheLocked();
+    return imported;
   }
 
  private:
@@ -281,6 +464,8 @@ class SSLSessionCacheOpenSSLImpl {
   typedef base::hash_map<std::string, MRUSessionList::iterator> KeyIndex;
   // Type for a dictionary from SessionId values to key index nodes.
   typedef base::hash_map<SessionId, KeyIndex::iterator> SessionIdIndex;
+  // Type for SSL_SESSION handles ordered by expiration time.
+  typedef std::multimap<long, SSL_SESSION*> ExpiryIndex;
 
   // Return the key associated with a given session, or the empty string if
   // none exist. This shall only be used for debugging.
@@ -313,13 +498,32 @@ class SSLSessionCacheOpenSSLImpl {
     DCHECK(key_it != key_index_.end());
     DCHECK_EQ(session, *key_it->second);
 
+    if (store_)
+      store_->RemoveSession(key_it->first);
+
     id_index_.erase(session_id);
     ordering_.erase(key_it->second);
     key_index_.erase(key_it);
+    RemoveExpiryLocked(session);
 
     SSL_SESSION_free(session);
 
     DCHECK_EQ(key_index_.size(), id_index_.size());
+    DCHECK_EQ(key_index_.size(), expiry_index_.size());
+  }
+
+  // Remove the |expiry_index_| entry of |session|. Lock must be held.
+  void RemoveExpiryLocked(SSL_SESSION* session) {
+    lock_.AssertAcquired();
+    std::pair<ExpiryIndex::iterator, ExpiryIndex::iterator> range =
+        expiry_index_.equal_range(GetSessionExpiry(session));
+    for (ExpiryIndex::iterator it = range.first; it != range.second; ++it) {
+      if (it->second == session) {
+        expiry_index_.erase(it);
+        return;
+      }
+    }
+    NOTREACHED() << "Session missing from the expiry index: " << session;
   }
 
   // Used internally to flush expired sessions. Lock must be held.
@@ -329,18 +533,16 @@ class SSLSessionCacheOpenSSLImpl {
     // Unfortunately, OpenSSL initializes |session->time| with a time()
     // timestamps, which makes mocking / unit testing difficult.
     long timeout_secs = static_cast<long>(::time(NULL));
-    MRUSessionList::iterator it = ordering_.begin();
-    while (it != ordering_.end()) {
-      SSL_SESSION* session = *it++;
-
-      // Important, use <= instead of < here to allow unit testing to
-      // work properly. That's because unit tests that check the expiration
-      // behaviour will use a session timeout of 0 seconds.
-      if (session->time + session->timeout <= timeout_secs) {
-        DVLOG(2) << "Expiring session " << session << " for "
-                 << SessionKey(session);
-        RemoveSessionLocked(session);
-      }
+
+    // Important, use <= instead of < here to allow unit testing to
+    // work properly. That's because unit tests that check the expiration
+    // behaviour will use a session timeout of 0 seconds.
+    while (!expiry_index_.empty() &&
+           expiry_index_.begin()->first <= timeout_secs) {
+      SSL_SESSION* session = expiry_index_.begin()->second;
+      DVLOG(2) << "Expiring session " << session << " for "
+               << SessionKey(session);
+      RemoveSessionLocked(session);
     }
   }
 
@@ -393,14 +595,26 @@ class SSLSessionCacheOpenSSLImpl {
     return 1;
   }
 
-  // Add |session| to the cache in association with |cache_key|. If a session
-  // already exists, it is replaced with the new one. This assumes that the
-  // caller already incremented the session's reference count.
+  // Add |session| to the cache in association with the cache key of |ssl|.
+  // If a session already exists, it is replaced with the new one. This
+  // assumes that the caller already incremented the session's reference count.
   void OnSessionAdded(SSL* ssl, SSL_SESSION* session) {
     base::AutoLock locked(lock_);
     DCHECK(ssl);
+    AddSessionLocked(config_.key_func(ssl), session);
+
+    if (key_index_.size() > config_.max_entries)
+      ShrinkCacheLocked();
+
+    DCHECK_LE(key_index_.size(), config_.max_entries);
+  }
+
+  // Add |session| to the cache in association with |cache_key|, replacing any
+  // existing session, and take ownership of the caller's reference to it.
+  // Doesn't shrink the cache. Lock must be held.
+  void AddSessionLocked(const std::string& cache_key, SSL_SESSION* session) {
+    lock_.AssertAcquired();
     DCHECK_GT(session->session_id_length, 0U);
-    std::string cache_key = config_.key_func(ssl);
     KeyIndex::iterator it = key_index_.find(cache_key);
     if (it == key_index_.end()) {
       DVLOG(2) << "Add session " << session << " for " << cache_key;
@@ -411,14 +625,21 @@ class SSLSessionCacheOpenSSLImpl {
       DCHECK(ret.second);
       it = ret.first;
       DCHECK(it != key_index_.end());
+      expiry_index_.insert(std::make_pair(GetSessionExpiry(session), session));
     } else {
       // An existing session exists for this key, so replace it if needed.
       DVLOG(2) << "Replace session " << *it->second << " with " << session
                << " for " << cache_key;
       SSL_SESSION* old_session = *it->second;
       if (old_session != session) {
+        // The new session is saved to the store once it is good.
+        if (store_)
+          store_->RemoveSession(cache_key);
         id_index_.erase(SessionId(old_session));
+        RemoveExpiryLocked(old_session);
         SSL_SESSION_free(old_session);
+        expiry_index_.insert(
+            std::make_pair(GetSessionExpiry(session), session));
       }
       ordering_.erase(it->second);
       ordering_.push_front(session);
@@ -427,11 +648,8 @@ class SSLSessionCacheOpenSSLImpl {
 
     id_index_[SessionId(session)] = it;
 
-    if (key_index_.size() > config_.max_entries)
-      ShrinkCacheLocked();
-
     DCHECK_EQ(key_index_.size(), id_index_.size());
-    DCHECK_LE(key_index_.size(), config_.max_entries);
+    DCHECK_EQ(key_index_.size(), expiry_index_.size());
   }
 
   // Shrink the cache to ensure no more than config_.max_entries entries,
@@ -491,6 +709,10 @@ class SSLSessionCacheOpenSSLImpl {
   MRUSessionList ordering_;
   KeyIndex key_index_;
   SessionIdIndex id_index_;
+  ExpiryIndex expiry_index_;
+
+  // Not owned. May be NULL.
+  SSLSessionStore* store_;
 
   size_t expiration_check_;
 };
@@ -527,4 +749,23 @@ void SSLSessionCacheOpenSSL::MarkSSLSessionAsGood(SSL* ssl) {
 
 void SSLSessionCacheOpenSSL::Flush() { impl_->Flush(); }
 
+void SSLSessionCacheOpenSSL::SetStore(SSLSessionStore* store) {
+  impl_->SetStore(store);
+}
+
+size_t SSLSessionCacheOpenSSL::ImportSessions(
+    const SSLSessionStore::SessionMap& sessions) {
+  return impl_->ImportSessions(sessions);
+}
+
+// static
+stack_st_X509* SSLSessionCacheOpenSSL::GetImportedPeerCertChain(
+    const SSL* ssl) {
+  SSL_SESSION* session = SSL_get_session(ssl);
+  if (!session)
+    return NULL;
+  return reinterpret_cast<STACK_OF(X509)*>(
+      SSL_SESSION_get_ex_data(session, GetSSLSessionChainExIndex()));
+}
+
 }  // namespace net
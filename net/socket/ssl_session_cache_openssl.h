@@ -9,10 +9,12 @@
 
 #include "base/basictypes.h"
 #include "net/base/net_export.h"
+#include "net/socket/ssl_session_store.h"
 
 // Avoid including OpenSSL headers here.
 typedef struct ssl_ctx_st SSL_CTX;
 typedef struct ssl_st SSL;
+struct stack_st_X509;
 
 namespace net {
 
@@ -44,6 +46,10 @@ class SSLSessionCacheOpenSSLImpl;
 //  - Clients can call Flush() to remove all sessions from the cache, this is
 //    useful when the system's certificate store has changed.
 //
+//  - Optionally, clients can call SetStore() to save good sessions to a
+//    SSLSessionStore, and ImportSessions() to add the sessions saved by a
+//    previous run back to the cache.
+//
 // This class is thread-safe. There shouldn't be any issue with multiple
 // SSL connections being performed in parallel in multiple threads.
 class NET_EXPORT SSLSessionCacheOpenSSL {
@@ -124,10 +130,28 @@ class NET_EXPORT SSLSessionCacheOpenSSL {
   // only validated sessions are resumed.
   void MarkSSLSessionAsGood(SSL* ssl);
 
-  // Flush removes all entries from the cache. This is typically called when
-  // the system's certificate store has changed.
+  // Flush removes all entries from the cache, and from its store if any. This
+  // is typically called when the system's certificate store has changed.
   void Flush();
 
+  // Set the store that sessions are saved to once they are marked good, and
+  // removed from when they leave the cache. |store| is not owned and may be
+  // NULL; it must be reset before |store| is destroyed.
+  void SetStore(SSLSessionStore* store);
+
+  // Add the sessions of |sessions|, as saved to a SSLSessionStore, to the
+  // cache. Sessions that have expired or can't be parsed are skipped, and
+  // removed from the store if one is set. Keys that already have a session in
+  // the cache are skipped too. Imported sessions are good, and resumable right
+  // away. Return the number of sessions imported.
+  size_t ImportSessions(const SSLSessionStore::SessionMap& sessions);
+
+  // Return the peer certificate chain saved with the session of |ssl| if the
+  // session was imported, or NULL otherwise. OpenSSL doesn't serialize the
+  // chain with the session, so connections resuming imported sessions must
+  // use this one.
+  static stack_st_X509* GetImportedPeerCertChain(const SSL* ssl);
+
   // TODO(digit): Move to client code.
   static const int kDefaultTimeoutSeconds = 60 * 60;
   static const size_t kMaxEntries = 1024;
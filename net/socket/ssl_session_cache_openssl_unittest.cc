@@ -6,6 +6,8 @@
 
 #include <openssl/ssl.h>
 
+#include <vector>
+
 #include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/strings/stringprintf.h"
@@ -104,6 +106,29 @@ class SSLKeyHelper {
   int ex_index_;
 };
 
+// A SSLSessionStore that records the sessions removed from it.
+class RemovalRecordingStore : public SSLSessionStore {
+ public:
+  RemovalRecordingStore() : remove_all_count_(0) {}
+  ~RemovalRecordingStore() override {}
+
+  const std::vector<std::string>& removed_keys() const {
+    return removed_keys_;
+  }
+  int remove_all_count() const { return remove_all_count_; }
+
+  // SSLSessionStore implementation.
+  void SaveSession(const std::string& key, const std::string& data) override {}
+  void RemoveSession(const std::string& key) override {
+    removed_keys_.push_back(key);
+  }
+  void RemoveAllSessions() override { remove_all_count_++; }
+
+ private:
+  std::vector<std::string> removed_keys_;
+  int remove_all_count_;
+};
+
 }  // namespace
 
 class SSLSessionCacheOpenSSLTest : public testing::Test {
@@ -377,4 +402,38 @@ TEST_F(SSLSessionCacheOpenSSLTest, CheckExpiration) {
   EXPECT_EQ(1U, cache_.size());
 }
 
+// Check that sessions leaving the cache are removed from its store, and that
+// sessions which can't be parsed aren't imported.
+TEST_F(SSLSessionCacheOpenSSLTest, StoreRemovals) {
+  SSLSessionCacheOpenSSL::Config config = kDefaultConfig;
+  config.max_entries = 2;
+  ResetConfig(config);
+  RemovalRecordingStore store;
+  cache_.SetStore(&store);
+
+  // Adding a third session evicts the first one.
+  for (int n = 1; n <= 3; ++n) {
+    ScopedSSL ssl(NewSSL(base::StringPrintf("%d", n)));
+    AddToCache(ssl.get());
+  }
+  EXPECT_EQ(2U, cache_.size());
+  ASSERT_EQ(1U, store.removed_keys().size());
+  EXPECT_EQ("1", store.removed_keys()[0]);
+
+  SSLSessionStore::SessionMap sessions;
+  sessions["bad"] = "not a session";
+  EXPECT_EQ(0U, cache_.ImportSessions(sessions));
+  EXPECT_EQ(2U, cache_.size());
+  ASSERT_EQ(2U, store.removed_keys().size());
+  EXPECT_EQ("bad", store.removed_keys()[1]);
+
+  cache_.Flush();
+  EXPECT_EQ(0U, cache_.size());
+  EXPECT_EQ(1, store.remove_all_count());
+
+  // Destroying the cache doesn't touch the store.
+  ResetConfig(config);
+  EXPECT_EQ(1, store.remove_all_count());
+}
+
 }  // namespace net
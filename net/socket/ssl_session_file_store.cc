@@ -0,0 +1,107 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/socket/ssl_session_file_store.h"
+
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "base/sequenced_task_runner.h"
+
+namespace net {
+
+namespace {
+
+// Version of the file format.
+const int kFileVersion = 1;
+
+}  // namespace
+
+SSLSessionFileStore::SSLSessionFileStore(
+    const base::FilePath& path,
+    const scoped_refptr<base::SequencedTaskRunner>& background_runner,
+    const SessionMap& sessions)
+    : sessions_(sessions),
+      writer_(path, background_runner) {}
+
+SSLSessionFileStore::~SSLSessionFileStore() {
+  DCHECK(CalledOnValidThread());
+
+  if (writer_.HasPendingWrite())
+    writer_.DoScheduledWrite();
+}
+
+// static
+bool SSLSessionFileStore::ReadSessions(const base::FilePath& path,
+                                       SessionMap* sessions) {
+  std::string data;
+  if (!base::ReadFileToString(path, &data))
+    return false;
+  return Deserialize(data, sessions);
+}
+
+// static
+bool SSLSessionFileStore::Deserialize(const std::string& data,
+                                      SessionMap* sessions) {
+  Pickle pickle(data.data(), static_cast<int>(data.size()));
+  PickleIterator iter(pickle);
+
+  int version;
+  int num_sessions;
+  if (!iter.ReadInt(&version) || version != kFileVersion ||
+      !iter.ReadInt(&num_sessions) || num_sessions < 0) {
+    return false;
+  }
+
+  SessionMap result;
+  for (int i = 0; i < num_sessions; ++i) {
+    std::string key;
+    std::string session;
+    if (!iter.ReadString(&key) || !iter.ReadString(&session))
+      return false;
+    result[key] = session;
+  }
+
+  sessions->swap(result);
+  return true;
+}
+
+void SSLSessionFileStore::SaveSession(const std::string& key,
+                                      const std::string& data) {
+  DCHECK(CalledOnValidThread());
+  sessions_[key] = data;
+  writer_.ScheduleWrite(this);
+}
+
+void SSLSessionFileStore::RemoveSession(const std::string& key) {
+  DCHECK(CalledOnValidThread());
+  if (sessions_.erase(key))
+    writer_.ScheduleWrite(this);
+}
+
+void SSLSessionFileStore::RemoveAllSessions() {
+  DCHECK(CalledOnValidThread());
+  if (sessions_.empty())
+    return;
+  sessions_.clear();
+  writer_.ScheduleWrite(this);
+}
+
+bool SSLSessionFileStore::SerializeData(std::string* data) {
+  DCHECK(CalledOnValidThread());
+
+  Pickle pickle;
+  pickle.WriteInt(kFileVersion);
+  pickle.WriteInt(static_cast<int>(sessions_.size()));
+  for (SessionMap::const_iterator it = sessions_.begin();
+       it != sessions_.end(); ++it) {
+    pickle.WriteString(it->first);
+    pickle.WriteString(it->second);
+  }
+
+  data->assign(reinterpret_cast<const char*>(pickle.data()), pickle.size());
+  return true;
+}
+
+}  // namespace net
@@ -0,0 +1,71 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_SOCKET_SSL_SESSION_FILE_STORE_H_
+#define NET_SOCKET_SSL_SESSION_FILE_STORE_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/files/important_file_writer.h"
+#include "base/memory/ref_counted.h"
+#include "base/threading/non_thread_safe.h"
+#include "net/base/net_export.h"
+#include "net/socket/ssl_session_store.h"
+
+namespace base {
+class SequencedTaskRunner;
+}
+
+namespace net {
+
+// A SSLSessionStore that keeps its sessions in a file, so that they can be
+// resumed after a restart. Changes are written to the file in batches by a
+// base::ImportantFileWriter.
+//
+// Typical use is to read the file with ReadSessions() on a thread that allows
+// blocking IO, then to create the store with the sessions read, on the thread
+// the sockets use, and pass both to the session cache.
+class NET_EXPORT SSLSessionFileStore
+    : public SSLSessionStore,
+      public base::ImportantFileWriter::DataSerializer,
+      NON_EXPORTED_BASE(public base::NonThreadSafe) {
+ public:
+  // |sessions| are the sessions the file at |path| holds. The file is written
+  // on |background_runner|.
+  SSLSessionFileStore(
+      const base::FilePath& path,
+      const scoped_refptr<base::SequencedTaskRunner>& background_runner,
+      const SessionMap& sessions);
+  ~SSLSessionFileStore() override;
+
+  // Reads the sessions of the file at |path| into |*sessions|. Returns false
+  // if the file is missing or corrupt. This does blocking file IO.
+  static bool ReadSessions(const base::FilePath& path, SessionMap* sessions);
+
+  // Parses |data|, as written by SerializeData(), into |*sessions|.
+  static bool Deserialize(const std::string& data, SessionMap* sessions);
+
+  const SessionMap& sessions() const { return sessions_; }
+
+  // SSLSessionStore implementation.
+  void SaveSession(const std::string& key, const std::string& data) override;
+  void RemoveSession(const std::string& key) override;
+  void RemoveAllSessions() override;
+
+  // ImportantFileWriter::DataSerializer implementation.
+  bool SerializeData(std::string* data) override;
+
+ private:
+  SessionMap sessions_;
+
+  base::ImportantFileWriter writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(SSLSessionFileStore);
+};
+
+}  // namespace net
+
+#endif  // NET_SOCKET_SSL_SESSION_FILE_STORE_H_
@@ -0,0 +1,95 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/socket/ssl_session_file_store.h"
+
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+class SSLSessionFileStoreTest : public testing::Test {
+ public:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("SSLSessions");
+  }
+
+  ~SSLSessionFileStoreTest() override {
+    base::MessageLoopForIO::current()->RunUntilIdle();
+  }
+
+  scoped_ptr<SSLSessionFileStore> CreateStore(
+      const SSLSessionStore::SessionMap& sessions) {
+    return make_scoped_ptr(new SSLSessionFileStore(
+        path_, base::MessageLoopForIO::current()->message_loop_proxy(),
+        sessions));
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+  base::FilePath path_;
+};
+
+TEST_F(SSLSessionFileStoreTest, SerializeData) {
+  SSLSessionStore::SessionMap sessions;
+  sessions["www.example.com:443/"] = std::string("session\0data", 12);
+  sessions["[::1]:8443/"] = "other session";
+  scoped_ptr<SSLSessionFileStore> store = CreateStore(sessions);
+
+  std::string data;
+  ASSERT_TRUE(store->SerializeData(&data));
+  SSLSessionStore::SessionMap parsed;
+  ASSERT_TRUE(SSLSessionFileStore::Deserialize(data, &parsed));
+  EXPECT_EQ(sessions, parsed);
+
+  EXPECT_FALSE(SSLSessionFileStore::Deserialize(data.substr(0, data.size() / 2),
+                                                &parsed));
+  EXPECT_FALSE(SSLSessionFileStore::Deserialize("garbage", &parsed));
+}
+
+TEST_F(SSLSessionFileStoreTest, SaveAndRemoveSessions) {
+  scoped_ptr<SSLSessionFileStore> store =
+      CreateStore(SSLSessionStore::SessionMap());
+
+  store->SaveSession("a:443/", "first");
+  store->SaveSession("b:443/", "second");
+  store->SaveSession("a:443/", "third");
+  EXPECT_EQ(2u, store->sessions().size());
+  EXPECT_EQ("third", store->sessions().find("a:443/")->second);
+
+  store->RemoveSession("b:443/");
+  store->RemoveSession("unknown:443/");
+  EXPECT_EQ(1u, store->sessions().size());
+
+  store->RemoveAllSessions();
+  EXPECT_TRUE(store->sessions().empty());
+}
+
+// Checks that the sessions of a store are written to its file, and read back.
+TEST_F(SSLSessionFileStoreTest, ReadSessions) {
+  SSLSessionStore::SessionMap sessions;
+  EXPECT_FALSE(SSLSessionFileStore::ReadSessions(path_, &sessions));
+
+  scoped_ptr<SSLSessionFileStore> store = CreateStore(sessions);
+  store->SaveSession("www.example.com:443/", "session");
+  // Destroying the store writes the pending changes.
+  store.reset();
+  base::MessageLoopForIO::current()->RunUntilIdle();
+
+  ASSERT_TRUE(SSLSessionFileStore::ReadSessions(path_, &sessions));
+  ASSERT_EQ(1u, sessions.size());
+  EXPECT_EQ("session", sessions["www.example.com:443/"]);
+}
+
+}  // namespace
+
+}  // namespace net
@@ -0,0 +1,45 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_SOCKET_SSL_SESSION_STORE_H_
+#define NET_SOCKET_SSL_SESSION_STORE_H_
+
+#include <map>
+#include <string>
+
+#include "net/base/net_export.h"
+
+namespace net {
+
+// Interface of a backing store for the SSL session cache, used to keep
+// sessions across restarts, or to share them with other processes. The cache
+// saves each session once it has been validated, and removes it from the
+// store when it is evicted, expires or is flushed.
+//
+// Sessions hold the master secrets of their connections, so stores should
+// keep them with the same care as cookies.
+//
+// The cache calls into the store with its own lock held, so implementations
+// must not call back into the cache.
+class NET_EXPORT SSLSessionStore {
+ public:
+  // Serialized sessions, by session cache key.
+  typedef std::map<std::string, std::string> SessionMap;
+
+  virtual ~SSLSessionStore() {}
+
+  // Saves |data|, the serialized session for |key|, replacing any session
+  // previously saved for it.
+  virtual void SaveSession(const std::string& key, const std::string& data) = 0;
+
+  // Removes the session saved for |key|, if any.
+  virtual void RemoveSession(const std::string& key) = 0;
+
+  // Removes all saved sessions.
+  virtual void RemoveAllSessions() = 0;
+};
+
+}  // namespace net
+
+#endif  // NET_SOCKET_SSL_SESSION_STORE_H_
@@ -8,9 +8,20 @@
 #include "base/metrics/histogram.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/values.h"
+#include "net/base/net_errors.h"
 
 namespace net {
 
+bool StreamSocket::SupportsWriteV() const {
+  return false;
+}
+
+int StreamSocket::WriteV(const std::vector<scoped_refptr<IOBuffer> >& bufs,
+                         const std::vector<int>& buf_lens,
+                         const CompletionCallback& callback) {
+  return ERR_NOT_IMPLEMENTED;
+}
+
 StreamSocket::UseHistory::UseHistory()
     : was_ever_connected_(false),
       was_used_to_convey_data_(false),
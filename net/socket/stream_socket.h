@@ -5,6 +5,9 @@
 #ifndef NET_SOCKET_STREAM_SOCKET_H_
 #define NET_SOCKET_STREAM_SOCKET_H_
 
+#include <vector>
+
+#include "base/memory/ref_counted.h"
 #include "net/base/net_log.h"
 #include "net/socket/next_proto.h"
 #include "net/socket/socket.h"
@@ -12,6 +15,7 @@
 namespace net {
 
 class AddressList;
+class IOBuffer;
 class IPEndPoint;
 class SSLInfo;
 
@@ -95,6 +99,19 @@ class NET_EXPORT_PRIVATE StreamSocket : public Socket {
   // SSL was not used by this socket.
   virtual bool GetSSLInfo(SSLInfo* ssl_info) = 0;
 
+  // Returns true if WriteV() can be used on this socket.
+  virtual bool SupportsWriteV() const;
+
+  // Writes the first |buf_lens[i]| bytes of each buffer in |bufs|, in order,
+  // with a single gathering write.  Otherwise behaves like Write(): data may
+  // be written partially, the number of bytes written is returned, and the
+  // socket holds a reference to the buffers while the write is pending.
+  // Sockets for which SupportsWriteV() returns false return
+  // ERR_NOT_IMPLEMENTED.
+  virtual int WriteV(const std::vector<scoped_refptr<IOBuffer> >& bufs,
+                     const std::vector<int>& buf_lens,
+                     const CompletionCallback& callback);
+
  protected:
   // The following class is only used to gather statistics about the history of
   // a socket.  It is only instantiated and used in basic sockets, such as
@@ -242,6 +242,33 @@ bool TCPClientSocket::GetSSLInfo(SSLInfo* ssl_info) {
   return false;
 }
 
+bool TCPClientSocket::SupportsWriteV() const {
+#if defined(OS_POSIX)
+  return true;
+#else
+  return false;
+#endif
+}
+
+int TCPClientSocket::WriteV(const std::vector<scoped_refptr<IOBuffer> >& bufs,
+                            const std::vector<int>& buf_lens,
+                            const CompletionCallback& callback) {
+#if defined(OS_POSIX)
+  DCHECK(!callback.is_null());
+
+  // See Write() for why base::Unretained() is safe here.
+  CompletionCallback write_callback = base::Bind(
+      &TCPClientSocket::DidCompleteReadWrite, base::Unretained(this), callback);
+  int result = socket_->WriteV(bufs, buf_lens, write_callback);
+  if (result > 0)
+    use_history_.set_was_used_to_convey_data();
+
+  return result;
+#else
+  return StreamSocket::WriteV(bufs, buf_lens, callback);
+#endif
+}
+
 int TCPClientSocket::Read(IOBuffer* buf,
                           int buf_len,
                           const CompletionCallback& callback) {
@@ -53,6 +53,10 @@ class NET_EXPORT TCPClientSocket : public StreamSocket {
   bool WasNpnNegotiated() const override;
   NextProto GetNegotiatedProtocol() const override;
   bool GetSSLInfo(SSLInfo* ssl_info) override;
+  bool SupportsWriteV() const override;
+  int WriteV(const std::vector<scoped_refptr<IOBuffer> >& bufs,
+             const std::vector<int>& buf_lens,
+             const CompletionCallback& callback) override;
 
   // Socket implementation.
   // Multiple outstanding requests are not supported.
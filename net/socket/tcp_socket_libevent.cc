@@ -8,6 +8,8 @@
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/logging.h"
 #include "base/metrics/histogram.h"
@@ -298,6 +300,29 @@ int TCPSocketLibevent::Write(IOBuffer* buf,
   return rv;
 }
 
+int TCPSocketLibevent::WriteV(
+    const std::vector<scoped_refptr<IOBuffer> >& bufs,
+    const std::vector<int>& buf_lens,
+    const CompletionCallback& callback) {
+  DCHECK(socket_);
+  DCHECK(!callback.is_null());
+  DCHECK(!bufs.empty());
+
+  // The first write on a TCP FastOpen socket also connects it, and is done
+  // with sendto(), which does not gather. Writing only the first buffer is a
+  // valid partial write.
+  if (use_tcp_fastopen_ && !tcp_fastopen_write_attempted_)
+    return Write(bufs[0].get(), buf_lens[0], callback);
+
+  CompletionCallback write_callback =
+      base::Bind(&TCPSocketLibevent::WriteVCompleted, base::Unretained(this),
+                 bufs, buf_lens, callback);
+  int rv = socket_->WriteV(bufs, buf_lens, write_callback);
+  if (rv != ERR_IO_PENDING)
+    rv = HandleWriteVCompleted(bufs, buf_lens, rv);
+  return rv;
+}
+
 int TCPSocketLibevent::GetLocalAddress(IPEndPoint* address) const {
   DCHECK(address);
 
@@ -636,6 +661,35 @@ int TCPSocketLibevent::HandleWriteCompleted(IOBuffer* buf, int rv) {
   return rv;
 }
 
+void TCPSocketLibevent::WriteVCompleted(
+    const std::vector<scoped_refptr<IOBuffer> >& bufs,
+    const std::vector<int>& buf_lens,
+    const CompletionCallback& callback,
+    int rv) {
+  DCHECK_NE(ERR_IO_PENDING, rv);
+  callback.Run(HandleWriteVCompleted(bufs, buf_lens, rv));
+}
+
+int TCPSocketLibevent::HandleWriteVCompleted(
+    const std::vector<scoped_refptr<IOBuffer> >& bufs,
+    const std::vector<int>& buf_lens,
+    int rv) {
+  if (rv < 0)
+    return HandleWriteCompleted(bufs[0].get(), rv);
+
+  base::StatsCounter write_bytes("tcp.write_bytes");
+  write_bytes.Add(rv);
+  // Log the bytes of each buffer separately, since they are not contiguous.
+  int remaining = rv;
+  for (size_t i = 0; i < bufs.size() && remaining > 0; ++i) {
+    int len = std::min(remaining, buf_lens[i]);
+    net_log_.AddByteTransferEvent(NetLog::TYPE_SOCKET_BYTES_SENT, len,
+                                  bufs[i]->data());
+    remaining -= len;
+  }
+  return rv;
+}
+
 int TCPSocketLibevent::TcpFastOpenWrite(
     IOBuffer* buf,
     int buf_len,
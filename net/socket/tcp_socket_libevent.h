@@ -5,9 +5,12 @@
 #ifndef NET_SOCKET_TCP_SOCKET_LIBEVENT_H_
 #define NET_SOCKET_TCP_SOCKET_LIBEVENT_H_
 
+#include <vector>
+
 #include "base/basictypes.h"
 #include "base/callback.h"
 #include "base/compiler_specific.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "net/base/address_family.h"
 #include "net/base/completion_callback.h"
@@ -45,6 +48,9 @@ class NET_EXPORT TCPSocketLibevent {
   // Full duplex mode (reading and writing at the same time) is supported.
   int Read(IOBuffer* buf, int buf_len, const CompletionCallback& callback);
   int Write(IOBuffer* buf, int buf_len, const CompletionCallback& callback);
+  int WriteV(const std::vector<scoped_refptr<IOBuffer> >& bufs,
+             const std::vector<int>& buf_lens,
+             const CompletionCallback& callback);
 
   int GetLocalAddress(IPEndPoint* address) const;
   int GetPeerAddress(IPEndPoint* address) const;
@@ -180,6 +186,13 @@ class NET_EXPORT TCPSocketLibevent {
                       const CompletionCallback& callback,
                       int rv);
   int HandleWriteCompleted(IOBuffer* buf, int rv);
+  void WriteVCompleted(const std::vector<scoped_refptr<IOBuffer> >& bufs,
+                       const std::vector<int>& buf_lens,
+                       const CompletionCallback& callback,
+                       int rv);
+  int HandleWriteVCompleted(const std::vector<scoped_refptr<IOBuffer> >& bufs,
+                            const std::vector<int>& buf_lens,
+                            int rv);
   int TcpFastOpenWrite(IOBuffer* buf,
                        int buf_len,
                        const CompletionCallback& callback);
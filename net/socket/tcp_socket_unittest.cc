@@ -6,6 +6,7 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -282,5 +283,75 @@ TEST_F(TCPSocketTest, ReadWrite) {
   ASSERT_EQ(message, received_message);
 }
 
+#if defined(OS_POSIX)
+TEST_F(TCPSocketTest, ReadWriteV) {
+  ASSERT_NO_FATAL_FAILURE(SetUpListenIPv4());
+
+  TestCompletionCallback connect_callback;
+  TCPSocket connecting_socket(NULL, NetLog::Source());
+  int result = connecting_socket.Open(ADDRESS_FAMILY_IPV4);
+  ASSERT_EQ(OK, result);
+  connecting_socket.Connect(local_address_, connect_callback.callback());
+
+  TestCompletionCallback accept_callback;
+  scoped_ptr<TCPSocket> accepted_socket;
+  IPEndPoint accepted_address;
+  result = socket_.Accept(&accepted_socket, &accepted_address,
+                          accept_callback.callback());
+  ASSERT_EQ(OK, accept_callback.GetResult(result));
+  ASSERT_TRUE(accepted_socket.get());
+  EXPECT_EQ(OK, connect_callback.WaitForResult());
+
+  const char* const kPieces[] = { "test ", "gathered ", "message" };
+  const std::string message("test gathered message");
+
+  std::vector<scoped_refptr<DrainableIOBuffer> > pieces;
+  for (size_t i = 0; i < arraysize(kPieces); ++i) {
+    scoped_refptr<StringIOBuffer> piece(new StringIOBuffer(kPieces[i]));
+    pieces.push_back(new DrainableIOBuffer(piece.get(), piece->size()));
+  }
+
+  size_t bytes_written = 0;
+  size_t first = 0;
+  while (bytes_written < message.size()) {
+    std::vector<scoped_refptr<IOBuffer> > bufs;
+    std::vector<int> buf_lens;
+    for (size_t i = first; i < pieces.size(); ++i) {
+      bufs.push_back(pieces[i]);
+      buf_lens.push_back(pieces[i]->BytesRemaining());
+    }
+
+    TestCompletionCallback write_callback;
+    int write_result =
+        accepted_socket->WriteV(bufs, buf_lens, write_callback.callback());
+    write_result = write_callback.GetResult(write_result);
+    ASSERT_GT(write_result, 0);
+    bytes_written += write_result;
+    ASSERT_LE(bytes_written, message.size());
+
+    while (write_result > 0) {
+      int consumed = std::min(write_result, pieces[first]->BytesRemaining());
+      pieces[first]->DidConsume(consumed);
+      write_result -= consumed;
+      if (pieces[first]->BytesRemaining() == 0)
+        ++first;
+    }
+  }
+
+  std::string received_message;
+  while (received_message.size() < message.size()) {
+    scoped_refptr<IOBufferWithSize> read_buffer(
+        new IOBufferWithSize(message.size() - received_message.size()));
+    TestCompletionCallback read_callback;
+    int read_result = connecting_socket.Read(
+        read_buffer.get(), read_buffer->size(), read_callback.callback());
+    read_result = read_callback.GetResult(read_result);
+    ASSERT_GT(read_result, 0);
+    received_message.append(read_buffer->data(), read_result);
+  }
+  ASSERT_EQ(message, received_message);
+}
+#endif  // defined(OS_POSIX)
+
 }  // namespace
 }  // namespace net
@@ -0,0 +1,173 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Replays a trace of disk cache operations, recorded by a TracingCacheBackend,
+// against a backend, and reports the latencies of the operations, the hit rate,
+// the bytes written and the peak memory of the process.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/process/process_metrics.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/thread.h"
+#include "net/base/cache_type.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/tracing/cache_trace.h"
+#include "net/disk_cache/tracing/cache_trace_replayer.h"
+
+namespace disk_cache {
+namespace {
+
+const char kTraceSwitch[] = "trace";
+const char kBackendSwitch[] = "backend";
+const char kCacheDirSwitch[] = "cache-dir";
+const char kMaxSizeSwitch[] = "max-size";
+
+const char kBlockFileBackendType[] = "block_file";
+const char kSimpleBackendType[] = "simple";
+const char kMemoryBackendType[] = "memory";
+
+const char* const kOperationNames[] = {
+  "Open", "Create", "Doom", "DoomAll", "Close", "DoomEntry", "Read", "Write",
+  "ReadSparse", "WriteSparse",
+};
+COMPILE_ASSERT(arraysize(kOperationNames) == CacheTraceRecord::OPERATION_COUNT,
+               one_name_per_operation);
+
+void PrintUsage(std::ostream* stream) {
+  *stream << "Usage: disk_cache_trace_replay "
+          << "--trace=<path> "
+          << "--backend=<backend_type> "
+          << "[--cache-dir=<path>] "
+          << "[--max-size=<bytes>]" << std::endl
+          << "  with <backend_type>='block_file'|'simple'|'memory'"
+          << std::endl
+          << "  --cache-dir is required unless the backend is 'memory'."
+          << std::endl;
+}
+
+void PrintResults(const CacheTraceReplayer::Results& results) {
+  for (int i = 0; i < CacheTraceRecord::OPERATION_COUNT; ++i) {
+    const CacheTraceRecord::Operation operation =
+        static_cast<CacheTraceRecord::Operation>(i);
+    if (results.latencies[operation].empty())
+      continue;
+    std::cout << base::StringPrintf(
+        "%-12s count %8d  p50 %8" PRId64 " us  p99 %8" PRId64 " us",
+        kOperationNames[i],
+        static_cast<int>(results.latencies[operation].size()),
+        results.GetLatencyPercentile(operation, 50).InMicroseconds(),
+        results.GetLatencyPercentile(operation, 99).InMicroseconds())
+              << std::endl;
+  }
+  std::cout << base::StringPrintf("Hit rate: %.2f%% of %d lookups",
+                                  results.GetHitRate(), results.lookups)
+            << std::endl
+            << "Bytes written: " << results.bytes_written << std::endl
+            << "Skipped operations: " << results.skipped_operations
+            << std::endl;
+
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(
+          base::GetCurrentProcessHandle()));
+  std::cout << "Peak memory: " << metrics->GetPeakWorkingSetSize() / 1024
+            << " kB" << std::endl;
+}
+
+bool Main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  base::MessageLoopForIO message_loop;
+  base::CommandLine::Init(argc, argv);
+  const base::CommandLine& command_line =
+      *base::CommandLine::ForCurrentProcess();
+  if (command_line.HasSwitch("help")) {
+    PrintUsage(&std::cout);
+    return true;
+  }
+
+  const std::string backend_type =
+      command_line.GetSwitchValueASCII(kBackendSwitch);
+  net::CacheType cache_type = net::DISK_CACHE;
+  net::BackendType backend = net::CACHE_BACKEND_DEFAULT;
+  if (backend_type == kBlockFileBackendType) {
+    backend = net::CACHE_BACKEND_BLOCKFILE;
+  } else if (backend_type == kSimpleBackendType) {
+    backend = net::CACHE_BACKEND_SIMPLE;
+  } else if (backend_type == kMemoryBackendType) {
+    cache_type = net::MEMORY_CACHE;
+  } else {
+    PrintUsage(&std::cerr);
+    return false;
+  }
+  const base::FilePath cache_dir =
+      command_line.GetSwitchValuePath(kCacheDirSwitch);
+  if (!command_line.HasSwitch(kTraceSwitch) ||
+      (cache_type != net::MEMORY_CACHE && cache_dir.empty())) {
+    PrintUsage(&std::cerr);
+    return false;
+  }
+  int max_size = 0;
+  if (command_line.HasSwitch(kMaxSizeSwitch) &&
+      !base::StringToInt(command_line.GetSwitchValueASCII(kMaxSizeSwitch),
+                         &max_size)) {
+    PrintUsage(&std::cerr);
+    return false;
+  }
+
+  std::vector<CacheTraceRecord> trace;
+  const base::FilePath trace_path =
+      command_line.GetSwitchValuePath(kTraceSwitch);
+  if (!ReadCacheTrace(trace_path, &trace)) {
+    LOG(ERROR) << "Could not read the trace " << trace_path.LossyDisplayName();
+    return false;
+  }
+
+  base::Thread cache_thread("CacheThread");
+  if (!cache_thread.StartWithOptions(
+          base::Thread::Options(base::MessageLoop::TYPE_IO, 0))) {
+    return false;
+  }
+  scoped_ptr<Backend> cache;
+  net::TestCompletionCallback cb;
+  int rv = CreateCacheBackend(cache_type, backend, cache_dir, max_size, true,
+                              cache_thread.task_runner(), NULL, &cache,
+                              cb.callback());
+  if (cb.GetResult(rv) != net::OK) {
+    LOG(ERROR) << "Could not create the " << backend_type << " backend";
+    return false;
+  }
+
+  CacheTraceReplayer::Results results;
+  {
+    CacheTraceReplayer replayer(cache.get());
+    replayer.Replay(trace, &results);
+  }
+  cache.reset();
+  if (backend == net::CACHE_BACKEND_SIMPLE)
+    SimpleBackendImpl::FlushWorkerPoolForTesting();
+  message_loop.RunUntilIdle();
+
+  PrintResults(results);
+  return true;
+}
+
+}  // namespace
+}  // namespace disk_cache
+
+int main(int argc, char** argv) {
+  return !disk_cache::Main(argc, argv);
+}
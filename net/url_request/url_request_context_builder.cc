@@ -16,6 +16,9 @@
 #include "net/base/net_errors.h"
 #include "net/base/network_delegate.h"
 #include "net/cert/cert_verifier.h"
+#include "net/cert/cert_verify_proc.h"
+#include "net/cert/cert_verify_result_persister.h"
+#include "net/cert/multi_threaded_cert_verifier.h"
 #include "net/cookies/cookie_monster.h"
 #include "net/dns/host_resolver.h"
 #include "net/ftp/ftp_network_layer.h"
@@ -162,6 +165,11 @@ class BasicURLRequestContext : public URLRequestContext {
     transport_security_persister = transport_security_persister.Pass();
   }
 
+  void set_cert_verify_result_persister(
+      scoped_ptr<CertVerifyResultPersister> cert_verify_result_persister) {
+    cert_verify_result_persister_ = cert_verify_result_persister.Pass();
+  }
+
  protected:
   ~BasicURLRequestContext() override { AssertNoURLRequests(); }
 
@@ -172,6 +180,8 @@ class BasicURLRequestContext : public URLRequestContext {
 
   URLRequestContextStorage storage_;
   scoped_ptr<TransportSecurityPersister> transport_security_persister_;
+  // Must be destroyed before the cert verifier in |storage_|.
+  scoped_ptr<CertVerifyResultPersister> cert_verify_result_persister_;
 
   DISALLOW_COPY_AND_ASSIGN(BasicURLRequestContext);
 };
@@ -317,7 +327,18 @@ URLRequestContext* URLRequestContextBuilder::Build() {
   storage->set_http_server_properties(
       scoped_ptr<net::HttpServerProperties>(
           new net::HttpServerPropertiesImpl()));
-  storage->set_cert_verifier(CertVerifier::CreateDefault());
+  if (!cert_verify_result_persister_path_.empty()) {
+    MultiThreadedCertVerifier* cert_verifier =
+        new MultiThreadedCertVerifier(CertVerifyProc::CreateDefault());
+    storage->set_cert_verifier(cert_verifier);
+    context->set_cert_verify_result_persister(
+        make_scoped_ptr(new CertVerifyResultPersister(
+            cert_verifier,
+            cert_verify_result_persister_path_,
+            context->GetFileThread()->message_loop_proxy())));
+  } else {
+    storage->set_cert_verifier(CertVerifier::CreateDefault());
+  }
 
   if (throttling_enabled_)
     storage->set_throttler_manager(new URLRequestThrottlerManager());
@@ -160,6 +160,13 @@ class NET_EXPORT URLRequestContextBuilder {
     transport_security_persister_path_ = transport_security_persister_path;
   }
 
+  // Sets the file in which successful certificate verification results are
+  // kept across restarts.
+  void set_cert_verify_result_persister_path(
+      const base::FilePath& cert_verify_result_persister_path) {
+    cert_verify_result_persister_path_ = cert_verify_result_persister_path;
+  }
+
   // Adjust |http_network_session_params_.next_protos| to enable SPDY and QUIC.
   void SetSpdyAndQuicEnabled(bool spdy_enabled,
                              bool quic_enabled);
@@ -204,6 +211,7 @@ class NET_EXPORT URLRequestContextBuilder {
   HttpCacheParams http_cache_params_;
   HttpNetworkSessionParams http_network_session_params_;
   base::FilePath transport_security_persister_path_;
+  base::FilePath cert_verify_result_persister_path_;
   scoped_ptr<NetLog> net_log_;
   scoped_ptr<HostResolver> host_resolver_;
   scoped_ptr<ProxyConfigService> proxy_config_service_;